@@ -114,6 +114,8 @@
 //*	Dec 28,	2020	<MLS> Finished making all Alpaca error messages uniform
 //*	Jan 10,	2020	<MLS> Changed SendSupportedActions() to Get_SupportedActions()
 //*	Jan 10,	2020	<MLS> Pushed build 74 up to github
+//*	Feb 26,	2021	<MLS> Added -H command line option, huge pages for the image pool
+//*	Mar  8,	2021	<MLS> Added gDeviceStateChangeCnt
 //*****************************************************************************
 
 #include	<stdio.h>
@@ -165,7 +167,11 @@ uint32_t	gClientTransactionID	=	0;
 uint32_t	gServerTransactionID	=	0;		//*	we are the server, we will increment this each time a transaction occurs
 bool		gErrorLogging			=	false;	//*	write errors to log file if true
 bool		gConformLogging			=	false;	//*	log all commands to log file to match up with Conform
+uint32_t	gDeviceStateChangeCnt	=	0;		//*	bumped when a device changes something that goes in the image header
 
+#ifdef _ENABLE_CAMERA_
+	#include	"imagepool.h"
+#endif
 #if defined(_ENABLE_CAMERA_) && defined(_ENABLE_ASI_)
 	#include	"cameradriver_ASI.h"
 #endif
@@ -2582,12 +2588,15 @@ char	*stringPtr;
 //*****************************************************************************
 static void	PrintHelp(const char *appName)
 {
-	printf("usage: %s [-acdehlqvt]\r\n", appName);
+	printf("usage: %s [-acdehHlqvt]\r\n", appName);
 	printf("\ta\tAuto exposure\r\n");
 	printf("\tc\tConform logging, log ALL commands to disk\r\n");
 	printf("\td\tDisplay images as they are taken\r\n");
 	printf("\te\tError logging, log errors commands to disk\r\n");
 	printf("\th\tThis help message\r\n");
+#ifdef _ENABLE_CAMERA_
+	printf("\tH\tUse huge pages for image buffers\r\n");
+#endif
 	printf("\tl\tLive mode\r\n");
 	printf("\tq\tquiet (less console messages)\r\n");
 	printf("\tv\tverbose (more console messages default)\r\n");
@@ -2634,6 +2643,13 @@ char	theChar;
 					exit(0);
 					break;
 
+			#ifdef _ENABLE_CAMERA_
+				//	"-H" means use huge pages for the image buffer pool
+				case 'H':
+					ImagePool_EnableHugePages(true);
+					break;
+			#endif
+
 				//	"-l" means live view
 				case 'l':
 				#ifdef _USE_OPENCV_
@@ -27,6 +27,7 @@
 //*	Sep  1,	2020	<MLS> Added _INCLUDE_EXIT_COMMAND_
 //*	Dec  5,	2020	<MLS> Added cDriverVersion so that different drivers can have different versions
 //*	Dec 11,	2020	<MLS> Added GENERATE_ALPACAPI_ERRMSG() macro to make error messages consistent
+//*	Mar  8,	2021	<MLS> Added gDeviceStateChangeCnt
 //*****************************************************************************
 //#include	"alpacadriver.h"
 
@@ -274,6 +275,7 @@ extern	char			gDefaultTelescopeRefID[kDefaultRefIdMaxLen];
 
 extern	bool			gErrorLogging;		//*	write errors to log file if true
 extern	bool			gConformLogging;	//*	log all commands to log file to match up with Conform
+extern	uint32_t		gDeviceStateChangeCnt;	//*	filter wheel, focuser, rotator changes, see TYPE_FITS_SNAPSHOT
 extern	char			gFullVersionString[];
 
 #ifdef __cplusplus
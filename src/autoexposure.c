@@ -0,0 +1,303 @@
+//**************************************************************************
+//*	Name:			autoexposure.c
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Predictive auto exposure from a subsample of the pixels
+//*
+//*					The old AutoAdjustExposure() looked at the max pixel and the
+//*					saturation count of the whole frame and stepped the exposure by
+//*					a fixed amount or percentage. Under changing light (twilight flats,
+//*					all sky cameras) it was always a step behind and hunted.
+//*
+//*					Statistics
+//*						Every stride'th pixel of every stride'th row, about
+//*						kAutoExp_TargetSamples in all. The stride is odd so that RAW
+//*						Bayer data gets all four colors. The percentile comes from a
+//*						4096 bin histogram of the samples, interpolated inside the bin.
+//*						Cheap enough to run on every frame, including video.
+//*
+//*					Model
+//*						The sensor is linear, the value at the percentile is
+//*							ADU = rate * exposure
+//*						so one frame is enough to know the exposure that puts it on
+//*						the target. The rate itself changes when the light does, the
+//*						change per frame is tracked (smoothed, in the log domain) and
+//*						the next frame is predicted with it. Frames where the exposure
+//*						changed by more than 2x are not used for the trend, the sensor
+//*						offset would show up as a change in the light.
+//*
+//*						Inside the dead band nothing is changed, this is what stops
+//*						the hunting. If the percentile pixel is clipped, the real value
+//*						is not known and the exposure is cut by the maximum step.
+//*
+//*						In video mode the frames that are already on their way were
+//*						taken with the old exposure, dividing their ADU by the new one
+//*						would give the wrong rate. settleFrames of them are skipped
+//*						after every change.
+//*
+//*					Converges in 1 to 3 frames depending on the offset.
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Mar 16,	2021	<MLS> Created autoexposure.c
+//*	Mar 30,	2021	<MLS> Frames taken before a change are skipped (settleFrames)
+//*	Mar 30,	2021	<MLS> Changes smaller than minStep_us are not made
+//*****************************************************************************
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<math.h>
+
+#include	"autoexposure.h"
+
+//*****************************************************************************
+void	AutoExposure_Init(TYPE_AUTOEXPOSURE *autoExp)
+{
+	memset(autoExp, 0, sizeof(TYPE_AUTOEXPOSURE));
+	autoExp->targetPercentile	=	99.0;
+	autoExp->targetLevel		=	0.75;
+	autoExp->deadBand			=	0.05;
+	autoExp->maxStepRatio		=	8.0;
+	autoExp->minExposure_us		=	1;
+	autoExp->maxExposure_us		=	10 * 60 * 1000 * 1000;		//*	10 minutes
+	autoExp->minStep_us			=	1;
+	autoExp->settleFrames		=	0;
+}
+
+//*****************************************************************************
+//*	forget what has been learned, the settings are kept
+//*****************************************************************************
+void	AutoExposure_Reset(TYPE_AUTOEXPOSURE *autoExp)
+{
+	autoExp->frameCnt			=	0;
+	autoExp->lastValid			=	false;
+	autoExp->lastRate			=	0.0;
+	autoExp->lastExposure_us	=	0;
+	autoExp->logTrend			=	0.0;
+	autoExp->nextExposure_us	=	0;
+	autoExp->skipFrames			=	0;
+	memset(&autoExp->lastStats, 0, sizeof(TYPE_AUTOEXP_STATS));
+}
+
+//*****************************************************************************
+bool	AutoExposure_SampleImage(	const void			*imageData,
+									const int			width,
+									const int			height,
+									const int			bytesPerPixel,
+									const int			planes,
+									const double		percentile,
+									TYPE_AUTOEXP_STATS	*stats)
+{
+uint32_t		histogram[kAutoExp_HistogramBins];
+const uint8_t	*data8;
+const uint16_t	*data16;
+int				stride;
+int				binShift;
+int				binCnt;
+int				xxx;
+int				yyy;
+int				ppp;
+long			pixelIdx;
+int				pixelValue;
+int				sampleValue;
+double			pixelSum;
+double			targetCnt;
+uint32_t		runningCnt;
+int				ii;
+
+	memset(stats, 0, sizeof(TYPE_AUTOEXP_STATS));
+	if ((imageData == NULL) || (width <= 0) || (height <= 0) ||
+		((bytesPerPixel != 1) && (bytesPerPixel != 2)) || ((planes != 1) && (planes != 3)))
+	{
+		return(false);
+	}
+
+	stride	=	sqrt(((double)width * height) / kAutoExp_TargetSamples) + 0.999;
+	if (stride < 1)
+	{
+		stride	=	1;
+	}
+	if ((stride & 1) == 0)
+	{
+		stride++;
+	}
+	if (bytesPerPixel == 2)
+	{
+		binShift		=	4;
+		binCnt			=	kAutoExp_HistogramBins;
+		stats->fullScale	=	65535.0;
+	}
+	else
+	{
+		binShift		=	0;
+		binCnt			=	256;
+		stats->fullScale	=	255.0;
+	}
+	memset(histogram, 0, sizeof(histogram));
+
+	data8		=	(const uint8_t *)imageData;
+	data16		=	(const uint16_t *)imageData;
+	pixelSum	=	0.0;
+	for (yyy=0; yyy<height; yyy+=stride)
+	{
+		for (xxx=0; xxx<width; xxx+=stride)
+		{
+			pixelIdx	=	(((long)yyy * width) + xxx) * planes;
+			//*	color uses the brightest of the 3, that is the one that clips first
+			sampleValue	=	0;
+			for (ppp=0; ppp<planes; ppp++)
+			{
+				pixelValue	=	(bytesPerPixel == 2) ? data16[pixelIdx + ppp] : data8[pixelIdx + ppp];
+				if (pixelValue > sampleValue)
+				{
+					sampleValue	=	pixelValue;
+				}
+			}
+			histogram[sampleValue >> binShift]++;
+			pixelSum	+=	sampleValue;
+			stats->sampleCnt++;
+		}
+	}
+	stats->stride		=	stride;
+	stats->saturatedCnt	=	histogram[binCnt - 1];
+	stats->meanADU		=	pixelSum / stats->sampleCnt;
+
+	targetCnt	=	(stats->sampleCnt * percentile) / 100.0;
+	runningCnt	=	0;
+	for (ii=0; ii<binCnt; ii++)
+	{
+		if ((histogram[ii] > 0) && ((runningCnt + histogram[ii]) >= targetCnt))
+		{
+			stats->percentileADU	=	(ii + ((targetCnt - runningCnt) / histogram[ii])) * (1 << binShift);
+			break;
+		}
+		runningCnt	+=	histogram[ii];
+	}
+	return(true);
+}
+
+//*****************************************************************************
+//*	returns the exposure for the next frame
+//*****************************************************************************
+int32_t	AutoExposure_Predict(	TYPE_AUTOEXPOSURE			*autoExp,
+								const int32_t				exposure_us,
+								const TYPE_AUTOEXP_STATS	*stats)
+{
+double	newExposure_us;
+double	targetADU;
+double	signalADU;
+double	saturatedPrct;
+double	rate;
+double	maxLogStep;
+double	errorRatio;
+
+	if ((stats->sampleCnt == 0) || (exposure_us <= 0))
+	{
+		return(exposure_us);
+	}
+	autoExp->lastStats	=	*stats;
+	if (autoExp->skipFrames > 0)
+	{
+		//*	taken before the last change, exposure_us is not what this frame had
+		autoExp->skipFrames--;
+		return(exposure_us);
+	}
+	newExposure_us		=	exposure_us;
+	targetADU			=	autoExp->targetLevel * stats->fullScale;
+	maxLogStep			=	log(autoExp->maxStepRatio);
+	saturatedPrct		=	(100.0 * stats->saturatedCnt) / stats->sampleCnt;
+
+	if (saturatedPrct > (100.0 - autoExp->targetPercentile))
+	{
+		//*	the percentile pixel is clipped, there is nothing to learn from this frame
+		newExposure_us		=	exposure_us / autoExp->maxStepRatio;
+		autoExp->lastValid	=	false;
+		autoExp->logTrend	=	0.0;
+	}
+	else
+	{
+		signalADU	=	(stats->percentileADU > 1.0) ? stats->percentileADU : 1.0;
+		rate		=	signalADU / (exposure_us / 1000000.0);
+
+		//*	big jumps (the first frames) are not used for the trend
+		if (autoExp->lastValid &&
+			(exposure_us <= (2 * autoExp->lastExposure_us)) && ((2 * exposure_us) >= autoExp->lastExposure_us))
+		{
+			autoExp->logTrend	=	(0.5 * autoExp->logTrend) + (0.5 * log(rate / autoExp->lastRate));
+		}
+		else
+		{
+			autoExp->logTrend	*=	0.5;
+		}
+		if (autoExp->logTrend > maxLogStep)
+		{
+			autoExp->logTrend	=	maxLogStep;
+		}
+		if (autoExp->logTrend < -maxLogStep)
+		{
+			autoExp->logTrend	=	-maxLogStep;
+		}
+
+		errorRatio	=	signalADU / targetADU;
+		if ((fabs(errorRatio - 1.0) > autoExp->deadBand) ||
+			(fabs(autoExp->logTrend) > (autoExp->deadBand / 2.0)))
+		{
+			newExposure_us	=	(targetADU / (rate * exp(autoExp->logTrend))) * 1000000.0;
+		}
+		autoExp->lastValid	=	true;
+		autoExp->lastRate	=	rate;
+	}
+
+	if (newExposure_us > (exposure_us * autoExp->maxStepRatio))
+	{
+		newExposure_us	=	exposure_us * autoExp->maxStepRatio;
+	}
+	if (newExposure_us < (exposure_us / autoExp->maxStepRatio))
+	{
+		newExposure_us	=	exposure_us / autoExp->maxStepRatio;
+	}
+	if (newExposure_us > autoExp->maxExposure_us)
+	{
+		newExposure_us	=	autoExp->maxExposure_us;
+	}
+	if (newExposure_us < autoExp->minExposure_us)
+	{
+		newExposure_us	=	autoExp->minExposure_us;
+	}
+	if (newExposure_us < 1.0)
+	{
+		newExposure_us	=	1.0;
+	}
+	if (fabs(newExposure_us - exposure_us) < autoExp->minStep_us)
+	{
+		newExposure_us	=	exposure_us;
+	}
+	if ((int32_t)newExposure_us != exposure_us)
+	{
+		autoExp->skipFrames	=	autoExp->settleFrames;
+	}
+
+	autoExp->lastExposure_us	=	exposure_us;
+	autoExp->nextExposure_us	=	newExposure_us;
+	autoExp->frameCnt++;
+	return(autoExp->nextExposure_us);
+}
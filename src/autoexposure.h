@@ -0,0 +1,86 @@
+//**************************************************************************
+//*	Name:			autoexposure.h
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Predictive auto exposure from a subsample of the pixels
+//*
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Mar 16,	2021	<MLS> Created autoexposure.h
+//*	Mar 30,	2021	<MLS> Added minStep_us and settleFrames
+//*****************************************************************************
+//#include	"autoexposure.h"
+
+#ifndef _AUTOEXPOSURE_H_
+#define	_AUTOEXPOSURE_H_
+
+#include	<stdint.h>
+#include	<stdbool.h>
+
+#define	kAutoExp_TargetSamples		65536		//*	about this many pixels are looked at
+#define	kAutoExp_HistogramBins		4096
+
+//*****************************************************************************
+typedef struct
+{
+	uint32_t	sampleCnt;
+	uint32_t	saturatedCnt;			//*	samples in the top bin
+	int			stride;					//*	every stride'th pixel of every stride'th row
+	double		fullScale;				//*	255 or 65535
+	double		percentileADU;			//*	value of the controlled percentile
+	double		meanADU;
+} TYPE_AUTOEXP_STATS;
+
+//*****************************************************************************
+typedef struct
+{
+	//*	settings
+	double				targetPercentile;		//*	99.0 = the pixel brighter than 99% of the samples
+	double				targetLevel;			//*	where that pixel should be, fraction of full scale
+	double				deadBand;				//*	no change while within this fraction of the target
+	double				maxStepRatio;			//*	largest change up or down in one frame
+	int32_t				minExposure_us;
+	int32_t				maxExposure_us;
+	int32_t				minStep_us;				//*	smaller changes are not made
+	int					settleFrames;			//*	frames after a change that were taken with the old exposure
+
+	//*	model
+	int					frameCnt;
+	bool				lastValid;				//*	last frame was not saturated at the percentile
+	double				lastRate;				//*	ADU per second at the percentile
+	int32_t				lastExposure_us;
+	double				logTrend;				//*	smoothed log of the rate change per frame
+	int32_t				nextExposure_us;
+	int					skipFrames;				//*	left to ignore after the last change
+	TYPE_AUTOEXP_STATS	lastStats;
+} TYPE_AUTOEXPOSURE;
+
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+void	AutoExposure_Init(TYPE_AUTOEXPOSURE *autoExp);
+void	AutoExposure_Reset(TYPE_AUTOEXPOSURE *autoExp);
+
+bool	AutoExposure_SampleImage(	const void			*imageData,
+									const int			width,
+									const int			height,
+									const int			bytesPerPixel,		//*	1 or 2
+									const int			planes,				//*	1 or 3, interleaved
+									const double		percentile,
+									TYPE_AUTOEXP_STATS	*stats);
+
+int32_t	AutoExposure_Predict(	TYPE_AUTOEXPOSURE			*autoExp,
+								const int32_t				exposure_us,
+								const TYPE_AUTOEXP_STATS	*stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//	_AUTOEXPOSURE_H_
@@ -0,0 +1,1119 @@
+//**************************************************************************
+//*	Name:			calibration.c
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Library of master bias/dark/flat frames applied at readout
+//*
+//*					Each master is a file in the library directory, a small header
+//*					followed by float data. The directory is scanned at startup and
+//*					the headers are kept in memory as the index. The masters that match
+//*					the current light frame settings are memory mapped.
+//*
+//*					Matching
+//*						dark:	same gain, binning and size, exposure within 2%,
+//*								temperature within 2 deg C (closest temperature wins)
+//*						bias:	used when there is no matching dark, same gain, binning, size
+//*						flat:	same filter, binning and size
+//*
+//*					Calibration is applied in place in one pass over the data,
+//*					(raw - dark) * flatGain, followed by replacing hot pixels (found
+//*					from the dark master) with the average of the nearest pixels
+//*					of the same color.
+//*
+//*					New calibration frames are averaged into a running mean and the
+//*					master file is rewritten every few frames, so the library is always
+//*					up to date. The rewrite is done on a thread from a copy of the mean,
+//*					the frame that triggers it only pays for the copy. Bias and dark captures continue from an existing master
+//*					with the same settings, so more frames can be added at any time.
+//*					Flats are stored as a normalized gain map and are rebuilt from scratch.
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb 14,	2021	<MLS> Created calibration.c
+//*	Feb 14,	2021	<MLS> Added memory mapped masters and in place calibration
+//*	Feb 15,	2021	<MLS> Added incremental master building
+//*	Feb 15,	2021	<MLS> Added hot pixel list from the dark master
+//*	Mar 30,	2021	<MLS> File names are bounded, kCalib_FileNameLen raised to 128
+//*	Mar 30,	2021	<MLS> The periodic master save runs on a thread, off the capture path
+//*	Mar 30,	2021	<MLS> Added ApplyToData16() and ApplyToData8(), they vectorize at -O3
+//*****************************************************************************
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<strings.h>
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<math.h>
+#include	<unistd.h>
+#include	<fcntl.h>
+#include	<dirent.h>
+#include	<sys/mman.h>
+#include	<sys/stat.h>
+#include	<sys/time.h>
+
+#define _ENABLE_CONSOLE_DEBUG_
+#include	"ConsoleDebug.h"
+
+#include	"calibration.h"
+
+#define	kCalibMagic				"ALPCALIB"
+#define	kCalibVersion			1
+#define	kCalibFileExtension		".calib"
+#define	kDarkExposureTolerance	0.02
+#define	kDarkTempTolerance		2.0
+#define	kHotPixelSigma			10.0
+#define	kMaxHotPixelFraction	100		//*	never more than 1 in 100 pixels
+#define	kBackgroundSamples		20000
+
+//*****************************************************************************
+//*	this is what is at the beginning of each master file
+typedef struct
+{
+	char		magic[8];
+	int32_t		version;
+	int32_t		calibType;
+	int32_t		exposure_us;
+	int32_t		gain;
+	double		temperature;
+	int32_t		binning;
+	int32_t		width;
+	int32_t		height;
+	uint32_t	frameCount;
+	char		filterName[kCalib_FilterNameLen];
+} TYPE_CALIB_FILEHDR;
+
+static void	LoadHotPixels(TYPE_CALIB_LIBRARY *calibLib);
+
+//*****************************************************************************
+const char	*Calib_GetTypeName(TYPE_CALIB_TYPE calibType)
+{
+	switch(calibType)
+	{
+		case kCalib_Bias:	return("bias");
+		case kCalib_Dark:	return("dark");
+		case kCalib_Flat:	return("flat");
+		default:			return("unknown");
+	}
+}
+
+//*****************************************************************************
+static void	UnmapMaster(TYPE_CALIB_MAPPED *mappedMaster)
+{
+	if (mappedMaster->mapAddress != NULL)
+	{
+		munmap(mappedMaster->mapAddress, mappedMaster->mapLength);
+	}
+	mappedMaster->mapAddress	=	NULL;
+	mappedMaster->mapLength		=	0;
+	mappedMaster->data			=	NULL;
+	mappedMaster->entryIdx		=	-1;
+}
+
+//*****************************************************************************
+static bool	MapMaster(TYPE_CALIB_LIBRARY *calibLib, TYPE_CALIB_MAPPED *mappedMaster, const int entryIdx)
+{
+char		filePath[256];
+int			fileDesc;
+struct stat	fileStatus;
+size_t		expectedLen;
+void		*mapAddress;
+
+	if (mappedMaster->entryIdx == entryIdx)
+	{
+		return(mappedMaster->data != NULL);
+	}
+	UnmapMaster(mappedMaster);
+	if ((entryIdx < 0) || (entryIdx >= calibLib->entryCnt))
+	{
+		return(false);
+	}
+
+	snprintf(filePath, sizeof(filePath), "%s/%s", calibLib->libraryDir, calibLib->entries[entryIdx].fileName);
+	expectedLen	=	kCalib_HeaderSize +
+					((size_t)calibLib->entries[entryIdx].key.width *
+					calibLib->entries[entryIdx].key.height * sizeof(float));
+	fileDesc	=	open(filePath, O_RDONLY);
+	if (fileDesc >= 0)
+	{
+		if ((fstat(fileDesc, &fileStatus) == 0) && ((size_t)fileStatus.st_size >= expectedLen))
+		{
+			mapAddress	=	mmap(NULL, expectedLen, PROT_READ, MAP_SHARED, fileDesc, 0);
+			if (mapAddress != MAP_FAILED)
+			{
+				mappedMaster->mapAddress	=	mapAddress;
+				mappedMaster->mapLength		=	expectedLen;
+				mappedMaster->data			=	(const float *)((char *)mapAddress + kCalib_HeaderSize);
+				mappedMaster->entryIdx		=	entryIdx;
+			}
+			else
+			{
+				CONSOLE_DEBUG_W_STR("mmap failed on", filePath);
+			}
+		}
+		close(fileDesc);
+	}
+	return(mappedMaster->data != NULL);
+}
+
+//*****************************************************************************
+static bool	ReadMasterHeader(const char *filePath, TYPE_CALIB_FILEHDR *fileHeader)
+{
+FILE	*filePointer;
+size_t	bytesRead;
+
+	bytesRead	=	0;
+	filePointer	=	fopen(filePath, "r");
+	if (filePointer != NULL)
+	{
+		bytesRead	=	fread(fileHeader, 1, sizeof(TYPE_CALIB_FILEHDR), filePointer);
+		fclose(filePointer);
+	}
+	return((bytesRead == sizeof(TYPE_CALIB_FILEHDR)) &&
+			(strncmp(fileHeader->magic, kCalibMagic, 8) == 0) &&
+			(fileHeader->version == kCalibVersion));
+}
+
+//*****************************************************************************
+//*	rebuilds the index from the headers of the files in the directory
+//*****************************************************************************
+static void	ScanLibrary(TYPE_CALIB_LIBRARY *calibLib)
+{
+DIR					*directory;
+struct dirent		*dirEntry;
+char				filePath[256];
+TYPE_CALIB_FILEHDR	fileHeader;
+TYPE_CALIB_ENTRY	*entry;
+int					nameLen;
+int					extLen;
+
+	UnmapMaster(&calibLib->darkMaster);
+	UnmapMaster(&calibLib->flatMaster);
+	LoadHotPixels(calibLib);
+	calibLib->entryCnt	=	0;
+
+	directory	=	opendir(calibLib->libraryDir);
+	if (directory != NULL)
+	{
+		extLen	=	strlen(kCalibFileExtension);
+		while (((dirEntry = readdir(directory)) != NULL) && (calibLib->entryCnt < kCalib_MaxEntries))
+		{
+			nameLen	=	strlen(dirEntry->d_name);
+			if ((nameLen <= extLen) || (nameLen >= kCalib_FileNameLen) ||
+				(strcmp(&dirEntry->d_name[nameLen - extLen], kCalibFileExtension) != 0))
+			{
+				continue;
+			}
+			snprintf(filePath, sizeof(filePath), "%s/%s", calibLib->libraryDir, dirEntry->d_name);
+			if (ReadMasterHeader(filePath, &fileHeader))
+			{
+				entry					=	&calibLib->entries[calibLib->entryCnt];
+				memset(entry, 0, sizeof(TYPE_CALIB_ENTRY));
+				entry->key.calibType	=	(TYPE_CALIB_TYPE)fileHeader.calibType;
+				entry->key.exposure_us	=	fileHeader.exposure_us;
+				entry->key.gain			=	fileHeader.gain;
+				entry->key.temperature	=	fileHeader.temperature;
+				entry->key.binning		=	fileHeader.binning;
+				entry->key.width		=	fileHeader.width;
+				entry->key.height		=	fileHeader.height;
+				memcpy(entry->key.filterName, fileHeader.filterName, (kCalib_FilterNameLen - 1));
+				entry->frameCount		=	fileHeader.frameCount;
+				snprintf(entry->fileName, sizeof(entry->fileName), "%s", dirEntry->d_name);
+				calibLib->entryCnt++;
+			}
+		}
+		closedir(directory);
+	}
+	CONSOLE_DEBUG_W_NUM("Calibration masters found\t=", calibLib->entryCnt);
+}
+
+//*****************************************************************************
+void	Calib_OpenLibrary(TYPE_CALIB_LIBRARY *calibLib, const char *libraryDir)
+{
+	memset(calibLib, 0, sizeof(TYPE_CALIB_LIBRARY));
+	pthread_mutex_init(&calibLib->libMutex, NULL);
+	calibLib->darkMaster.entryIdx	=	-1;
+	calibLib->flatMaster.entryIdx	=	-1;
+	calibLib->captureEntryIdx		=	-1;
+	strncpy(calibLib->libraryDir, libraryDir, (sizeof(calibLib->libraryDir) - 1));
+	mkdir(calibLib->libraryDir, 0744);
+
+	ScanLibrary(calibLib);
+}
+
+//*****************************************************************************
+void	Calib_ScanLibrary(TYPE_CALIB_LIBRARY *calibLib)
+{
+	pthread_mutex_lock(&calibLib->libMutex);
+	ScanLibrary(calibLib);
+	pthread_mutex_unlock(&calibLib->libMutex);
+}
+
+//*****************************************************************************
+void	Calib_CloseLibrary(TYPE_CALIB_LIBRARY *calibLib)
+{
+	Calib_StopCapture(calibLib);
+	pthread_mutex_lock(&calibLib->libMutex);
+	UnmapMaster(&calibLib->darkMaster);
+	UnmapMaster(&calibLib->flatMaster);
+	if (calibLib->hotPixelList != NULL)
+	{
+		free(calibLib->hotPixelList);
+		calibLib->hotPixelList	=	NULL;
+	}
+	calibLib->hotPixelCnt	=	0;
+	pthread_mutex_unlock(&calibLib->libMutex);
+	pthread_mutex_destroy(&calibLib->libMutex);
+}
+
+//*****************************************************************************
+static bool	SameFrameFormat(const TYPE_CALIB_KEY *key1, const TYPE_CALIB_KEY *key2)
+{
+	return((key1->binning == key2->binning) &&
+			(key1->width == key2->width) &&
+			(key1->height == key2->height));
+}
+
+//*****************************************************************************
+static int	FindBestMaster(TYPE_CALIB_LIBRARY *calibLib, const TYPE_CALIB_KEY *lightKey, TYPE_CALIB_TYPE calibType)
+{
+TYPE_CALIB_KEY	*entryKey;
+int				bestIdx;
+double			bestTempDiff;
+double			tempDiff;
+double			exposureDiff;
+int				ii;
+
+	bestIdx			=	-1;
+	bestTempDiff	=	1000.0;
+	for (ii=0; ii<calibLib->entryCnt; ii++)
+	{
+		entryKey	=	&calibLib->entries[ii].key;
+		if ((entryKey->calibType != calibType) || (SameFrameFormat(entryKey, lightKey) == false))
+		{
+			continue;
+		}
+		switch(calibType)
+		{
+			case kCalib_Bias:
+				if (entryKey->gain == lightKey->gain)
+				{
+					bestIdx	=	ii;
+				}
+				break;
+
+			case kCalib_Dark:
+				exposureDiff	=	fabs((double)entryKey->exposure_us - lightKey->exposure_us);
+				tempDiff		=	fabs(entryKey->temperature - lightKey->temperature);
+				if ((entryKey->gain == lightKey->gain) &&
+					(exposureDiff <= (kDarkExposureTolerance * lightKey->exposure_us)) &&
+					(tempDiff <= kDarkTempTolerance) &&
+					(tempDiff < bestTempDiff))
+				{
+					bestIdx			=	ii;
+					bestTempDiff	=	tempDiff;
+				}
+				break;
+
+			case kCalib_Flat:
+				if (strcasecmp(entryKey->filterName, lightKey->filterName) == 0)
+				{
+					bestIdx	=	ii;
+				}
+				break;
+
+			default:
+				break;
+		}
+	}
+	return(bestIdx);
+}
+
+//*****************************************************************************
+//*	noise statistics of a float image from a sample of the pixels
+//*****************************************************************************
+static int	CompareFloats(const void *e1, const void *e2)
+{
+float	value1	=	*((float *)e1);
+float	value2	=	*((float *)e2);
+
+	if (value1 < value2)
+	{
+		return(-1);
+	}
+	else if (value1 > value2)
+	{
+		return(1);
+	}
+	return(0);
+}
+
+//*****************************************************************************
+static void	CalcMedianSigma(const float *imageData, const long pixelCount, float *median, float *sigma)
+{
+float	*samples;
+long	stride;
+long	sampleCnt;
+long	ii;
+
+	*median	=	0.0;
+	*sigma	=	0.0;
+	samples	=	(float *)malloc(kBackgroundSamples * sizeof(float));
+	if (samples != NULL)
+	{
+		stride		=	(pixelCount / kBackgroundSamples) + 1;
+		sampleCnt	=	0;
+		for (ii=0; (ii < pixelCount) && (sampleCnt < kBackgroundSamples); ii += stride)
+		{
+			samples[sampleCnt++]	=	imageData[ii];
+		}
+		if (sampleCnt > 0)
+		{
+			qsort(samples, sampleCnt, sizeof(float), CompareFloats);
+			*median	=	samples[sampleCnt / 2];
+			for (ii=0; ii<sampleCnt; ii++)
+			{
+				samples[ii]	=	fabsf(samples[ii] - *median);
+			}
+			qsort(samples, sampleCnt, sizeof(float), CompareFloats);
+			*sigma	=	1.4826 * samples[sampleCnt / 2];
+		}
+		free(samples);
+	}
+}
+
+//*****************************************************************************
+//*	hot pixels come from the dark master, nothing is done for a bias
+//*****************************************************************************
+static void	LoadHotPixels(TYPE_CALIB_LIBRARY *calibLib)
+{
+const TYPE_CALIB_KEY	*darkKey;
+const float				*darkData;
+long					pixelCount;
+long					maxHotPixels;
+long					ii;
+float					median;
+float					sigma;
+float					threshold;
+
+	calibLib->hotPixelCnt	=	0;
+	darkData				=	calibLib->darkMaster.data;
+	if ((darkData == NULL) || (calibLib->darkMaster.entryIdx < 0))
+	{
+		return;
+	}
+	darkKey	=	&calibLib->entries[calibLib->darkMaster.entryIdx].key;
+	if (darkKey->calibType != kCalib_Dark)
+	{
+		return;
+	}
+	pixelCount		=	(long)darkKey->width * darkKey->height;
+	maxHotPixels	=	pixelCount / kMaxHotPixelFraction;
+	if (calibLib->hotPixelList != NULL)
+	{
+		free(calibLib->hotPixelList);
+	}
+	calibLib->hotPixelList	=	(uint32_t *)malloc(maxHotPixels * sizeof(uint32_t));
+	if (calibLib->hotPixelList != NULL)
+	{
+		CalcMedianSigma(darkData, pixelCount, &median, &sigma);
+		if (sigma < 1.0)
+		{
+			sigma	=	1.0;
+		}
+		threshold	=	median + (kHotPixelSigma * sigma);
+		for (ii=0; (ii < pixelCount) && (calibLib->hotPixelCnt < maxHotPixels); ii++)
+		{
+			if (darkData[ii] > threshold)
+			{
+				calibLib->hotPixelList[calibLib->hotPixelCnt++]	=	ii;
+			}
+		}
+	}
+	CONSOLE_DEBUG_W_NUM("Hot pixels\t=", calibLib->hotPixelCnt);
+}
+
+//*****************************************************************************
+//*	maps the masters that go with these light frame settings
+//*	returns true if there is anything to apply
+//*****************************************************************************
+bool	Calib_SelectMasters(TYPE_CALIB_LIBRARY *calibLib, const TYPE_CALIB_KEY *lightKey)
+{
+int		darkIdx;
+int		flatIdx;
+bool	mastersFound;
+
+	pthread_mutex_lock(&calibLib->libMutex);
+	darkIdx	=	FindBestMaster(calibLib, lightKey, kCalib_Dark);
+	if (darkIdx < 0)
+	{
+		darkIdx	=	FindBestMaster(calibLib, lightKey, kCalib_Bias);
+	}
+	flatIdx	=	FindBestMaster(calibLib, lightKey, kCalib_Flat);
+
+	if (darkIdx != calibLib->darkMaster.entryIdx)
+	{
+		MapMaster(calibLib, &calibLib->darkMaster, darkIdx);
+		LoadHotPixels(calibLib);
+	}
+	if (flatIdx != calibLib->flatMaster.entryIdx)
+	{
+		MapMaster(calibLib, &calibLib->flatMaster, flatIdx);
+	}
+	mastersFound	=	(calibLib->darkMaster.data != NULL) || (calibLib->flatMaster.data != NULL);
+	pthread_mutex_unlock(&calibLib->libMutex);
+	return(mastersFound);
+}
+
+//*****************************************************************************
+static void	FixHotPixels(TYPE_CALIB_LIBRARY *calibLib, void *imageData, const int width, const int bytesPerPixel, const bool bayerData)
+{
+uint8_t		*data8;
+uint16_t	*data16;
+long		pixelIdx;
+long		leftIdx;
+long		rightIdx;
+int			xxx;
+int			step;
+int			ii;
+
+	data8	=	(uint8_t *)imageData;
+	data16	=	(uint16_t *)imageData;
+	step	=	bayerData ? 2 : 1;
+	for (ii=0; ii<calibLib->hotPixelCnt; ii++)
+	{
+		pixelIdx	=	calibLib->hotPixelList[ii];
+		xxx			=	pixelIdx % width;
+		leftIdx		=	(xxx >= step) ? (pixelIdx - step) : (pixelIdx + step);
+		rightIdx	=	(xxx < (width - step)) ? (pixelIdx + step) : (pixelIdx - step);
+		if (bytesPerPixel == 2)
+		{
+			data16[pixelIdx]	=	(data16[leftIdx] + data16[rightIdx]) / 2;
+		}
+		else
+		{
+			data8[pixelIdx]		=	(data8[leftIdx] + data8[rightIdx]) / 2;
+		}
+	}
+}
+
+//*****************************************************************************
+//*	(raw - dark) * flatGain, in place.
+//*	called with constants for useDark and useFlat, once inlined each variant is
+//*	a loop with no branches and it vectorizes
+//*****************************************************************************
+static inline void	ApplyToData16(	uint16_t *__restrict__		data16,
+									const float *__restrict__	darkData,
+									const float *__restrict__	flatData,
+									const long					pixelCount,
+									const bool					useDark,
+									const bool					useFlat)
+{
+long	ii;
+float	pixelValue;
+
+	for (ii=0; ii<pixelCount; ii++)
+	{
+		pixelValue	=	data16[ii];
+		if (useDark)
+		{
+			pixelValue	-=	darkData[ii];
+		}
+		if (useFlat)
+		{
+			pixelValue	*=	flatData[ii];
+		}
+		//*	rounded before the clamp, rounding after it keeps the loop from vectorizing
+		pixelValue	+=	0.5f;
+		pixelValue	=	(pixelValue < 0.0f) ? 0.0f : ((pixelValue > 65535.0f) ? 65535.0f : pixelValue);
+		data16[ii]	=	(int)pixelValue;
+	}
+}
+
+//*****************************************************************************
+static inline void	ApplyToData8(	uint8_t *__restrict__		data8,
+									const float *__restrict__	darkData,
+									const float *__restrict__	flatData,
+									const long					pixelCount,
+									const bool					useDark,
+									const bool					useFlat)
+{
+long	ii;
+float	pixelValue;
+
+	for (ii=0; ii<pixelCount; ii++)
+	{
+		pixelValue	=	data8[ii];
+		if (useDark)
+		{
+			pixelValue	-=	darkData[ii];
+		}
+		if (useFlat)
+		{
+			pixelValue	*=	flatData[ii];
+		}
+		pixelValue	+=	0.5f;
+		pixelValue	=	(pixelValue < 0.0f) ? 0.0f : ((pixelValue > 255.0f) ? 255.0f : pixelValue);
+		data8[ii]	=	(int)pixelValue;
+	}
+}
+
+//*****************************************************************************
+//*	(raw - dark) * flatGain, in place, one pass
+//*****************************************************************************
+void	Calib_ApplyFrame(	TYPE_CALIB_LIBRARY	*calibLib,
+							void				*imageData,
+							const int			width,
+							const int			height,
+							const int			bytesPerPixel,
+							const bool			bayerData)
+{
+const float		*darkData;
+const float		*flatData;
+const TYPE_CALIB_KEY	*masterKey;
+long			pixelCount;
+struct timeval	startTime;
+struct timeval	endTime;
+
+	gettimeofday(&startTime, NULL);
+	pthread_mutex_lock(&calibLib->libMutex);
+	darkData	=	calibLib->darkMaster.data;
+	flatData	=	calibLib->flatMaster.data;
+	//*	make sure the masters are the right size for this data
+	if (darkData != NULL)
+	{
+		masterKey	=	&calibLib->entries[calibLib->darkMaster.entryIdx].key;
+		if ((masterKey->width != width) || (masterKey->height != height))
+		{
+			darkData	=	NULL;
+		}
+	}
+	if (flatData != NULL)
+	{
+		masterKey	=	&calibLib->entries[calibLib->flatMaster.entryIdx].key;
+		if ((masterKey->width != width) || (masterKey->height != height))
+		{
+			flatData	=	NULL;
+		}
+	}
+
+	if ((imageData != NULL) && ((darkData != NULL) || (flatData != NULL)))
+	{
+		pixelCount	=	(long)width * height;
+		if (bytesPerPixel == 2)
+		{
+			if ((darkData != NULL) && (flatData != NULL))
+			{
+				ApplyToData16((uint16_t *)imageData, darkData, flatData, pixelCount, true, true);
+			}
+			else if (darkData != NULL)
+			{
+				ApplyToData16((uint16_t *)imageData, darkData, flatData, pixelCount, true, false);
+			}
+			else
+			{
+				ApplyToData16((uint16_t *)imageData, darkData, flatData, pixelCount, false, true);
+			}
+		}
+		else
+		{
+			if ((darkData != NULL) && (flatData != NULL))
+			{
+				ApplyToData8((uint8_t *)imageData, darkData, flatData, pixelCount, true, true);
+			}
+			else if (darkData != NULL)
+			{
+				ApplyToData8((uint8_t *)imageData, darkData, flatData, pixelCount, true, false);
+			}
+			else
+			{
+				ApplyToData8((uint8_t *)imageData, darkData, flatData, pixelCount, false, true);
+			}
+		}
+		if (darkData != NULL)
+		{
+			FixHotPixels(calibLib, imageData, width, bytesPerPixel, bayerData);
+		}
+		calibLib->framesCalibrated++;
+	}
+	pthread_mutex_unlock(&calibLib->libMutex);
+	gettimeofday(&endTime, NULL);
+	calibLib->lastApplyTime_us	=	((endTime.tv_sec - startTime.tv_sec) * 1000000) +
+									(endTime.tv_usec - startTime.tv_usec);
+}
+
+#pragma mark -
+
+//*****************************************************************************
+//*	two masters are the same if a new frame for one would go into the other
+//*****************************************************************************
+static bool	SameMaster(const TYPE_CALIB_KEY *key1, const TYPE_CALIB_KEY *key2)
+{
+	if ((key1->calibType != key2->calibType) || (SameFrameFormat(key1, key2) == false))
+	{
+		return(false);
+	}
+	switch(key1->calibType)
+	{
+		case kCalib_Bias:
+			return(key1->gain == key2->gain);
+
+		case kCalib_Dark:
+			return((key1->gain == key2->gain) &&
+					(key1->exposure_us == key2->exposure_us) &&
+					(lround(key1->temperature) == lround(key2->temperature)));
+
+		case kCalib_Flat:
+			return(strcasecmp(key1->filterName, key2->filterName) == 0);
+
+		default:
+			return(false);
+	}
+}
+
+//*****************************************************************************
+static void	BuildFileName(const TYPE_CALIB_KEY *captureKey, char *fileName, const size_t fileNameSize)
+{
+char	filterName[kCalib_FilterNameLen];
+int		ii;
+
+	switch(captureKey->calibType)
+	{
+		case kCalib_Dark:
+			snprintf(fileName, fileNameSize, "dark_g%d_b%d_%dus_%ldC_%dx%d%s",
+								captureKey->gain,
+								captureKey->binning,
+								captureKey->exposure_us,
+								lround(captureKey->temperature),
+								captureKey->width,
+								captureKey->height,
+								kCalibFileExtension);
+			break;
+
+		case kCalib_Flat:
+			//*	keep the filter name safe for a file name
+			strncpy(filterName, captureKey->filterName, (kCalib_FilterNameLen - 1));
+			filterName[kCalib_FilterNameLen - 1]	=	0;
+			for (ii=0; filterName[ii] != 0; ii++)
+			{
+				if ((filterName[ii] == '/') || (filterName[ii] == ' '))
+				{
+					filterName[ii]	=	'-';
+				}
+			}
+			snprintf(fileName, fileNameSize, "flat_%s_b%d_%dx%d%s",
+								((strlen(filterName) > 0) ? filterName : "none"),
+								captureKey->binning,
+								captureKey->width,
+								captureKey->height,
+								kCalibFileExtension);
+			break;
+
+		case kCalib_Bias:
+		default:
+			snprintf(fileName, fileNameSize, "bias_g%d_b%d_%dx%d%s",
+								captureKey->gain,
+								captureKey->binning,
+								captureKey->width,
+								captureKey->height,
+								kCalibFileExtension);
+			break;
+	}
+}
+
+//*****************************************************************************
+//*	flats are stored as gain = mean / (flat - bias)
+//*	called without the lock, it is only held while the bias is being mapped
+//*****************************************************************************
+static float	*NormalizeFlat(TYPE_CALIB_LIBRARY *calibLib, const TYPE_CALIB_KEY *flatKey, const float *flatData)
+{
+TYPE_CALIB_MAPPED	biasMaster;
+float				*gainData;
+long				pixelCount;
+long				ii;
+double				levelSum;
+float				meanLevel;
+float				pixelValue;
+int					biasIdx;
+
+	pixelCount	=	(long)flatKey->width * flatKey->height;
+	gainData	=	(float *)malloc(pixelCount * sizeof(float));
+	if (gainData != NULL)
+	{
+		memset(&biasMaster, 0, sizeof(TYPE_CALIB_MAPPED));
+		biasMaster.entryIdx	=	-1;
+		biasIdx				=	-1;
+
+		//*	the mapping stays good after the unlock, even if the file gets replaced
+		pthread_mutex_lock(&calibLib->libMutex);
+		for (ii=0; ii<calibLib->entryCnt; ii++)
+		{
+			if ((calibLib->entries[ii].key.calibType == kCalib_Bias) &&
+				SameFrameFormat(&calibLib->entries[ii].key, flatKey))
+			{
+				biasIdx	=	ii;
+			}
+		}
+		MapMaster(calibLib, &biasMaster, biasIdx);
+		pthread_mutex_unlock(&calibLib->libMutex);
+
+		levelSum	=	0.0;
+		for (ii=0; ii<pixelCount; ii++)
+		{
+			gainData[ii]	=	flatData[ii];
+			if (biasMaster.data != NULL)
+			{
+				gainData[ii]	-=	biasMaster.data[ii];
+			}
+			levelSum	+=	gainData[ii];
+		}
+		UnmapMaster(&biasMaster);
+
+		meanLevel	=	levelSum / pixelCount;
+		for (ii=0; ii<pixelCount; ii++)
+		{
+			pixelValue	=	gainData[ii];
+			//*	dead or nearly dead pixels are left alone
+			gainData[ii]	=	(pixelValue > (meanLevel * 0.05)) ? (meanLevel / pixelValue) : 1.0;
+		}
+	}
+	return(gainData);
+}
+
+//*****************************************************************************
+//*	called without the lock, meanData belongs to the caller (a copy or a capture
+//*	that has been stopped), the lock is only taken to update the index
+//*****************************************************************************
+static void	SaveMaster(	TYPE_CALIB_LIBRARY		*calibLib,
+						const TYPE_CALIB_KEY	*saveKey,
+						const float				*meanData,
+						const uint32_t			frameCount)
+{
+TYPE_CALIB_FILEHDR	fileHeader;
+char				headerBuffer[kCalib_HeaderSize];
+char				fileName[kCalib_FileNameLen];
+char				filePath[256];
+char				tempPath[264];
+FILE				*filePointer;
+const float			*saveData;
+float				*gainData;
+long				pixelCount;
+size_t				bytesWritten;
+int					entryIdx;
+int					ii;
+
+	if ((meanData == NULL) || (frameCount == 0))
+	{
+		return;
+	}
+	pixelCount	=	(long)saveKey->width * saveKey->height;
+	gainData	=	NULL;
+	saveData	=	meanData;
+	if (saveKey->calibType == kCalib_Flat)
+	{
+		gainData	=	NormalizeFlat(calibLib, saveKey, meanData);
+		saveData	=	gainData;
+	}
+	if (saveData == NULL)
+	{
+		return;
+	}
+
+	memset(&fileHeader, 0, sizeof(TYPE_CALIB_FILEHDR));
+	memcpy(fileHeader.magic, kCalibMagic, 8);
+	fileHeader.version		=	kCalibVersion;
+	fileHeader.calibType	=	saveKey->calibType;
+	fileHeader.exposure_us	=	saveKey->exposure_us;
+	fileHeader.gain			=	saveKey->gain;
+	fileHeader.temperature	=	saveKey->temperature;
+	fileHeader.binning		=	saveKey->binning;
+	fileHeader.width		=	saveKey->width;
+	fileHeader.height		=	saveKey->height;
+	fileHeader.frameCount	=	frameCount;
+	memcpy(fileHeader.filterName, saveKey->filterName, (kCalib_FilterNameLen - 1));
+	memset(headerBuffer, 0, sizeof(headerBuffer));
+	memcpy(headerBuffer, &fileHeader, sizeof(TYPE_CALIB_FILEHDR));
+
+	BuildFileName(saveKey, fileName, sizeof(fileName));
+	snprintf(filePath, sizeof(filePath), "%s/%s", calibLib->libraryDir, fileName);
+	snprintf(tempPath, sizeof(tempPath), "%s.tmp", filePath);
+
+	//*	write to a temp file and rename it, anyone that has the old one mapped keeps it
+	bytesWritten	=	0;
+	filePointer		=	fopen(tempPath, "w");
+	if (filePointer != NULL)
+	{
+		bytesWritten	=	fwrite(headerBuffer, 1, kCalib_HeaderSize, filePointer);
+		bytesWritten	+=	fwrite(saveData, sizeof(float), pixelCount, filePointer) * sizeof(float);
+		fclose(filePointer);
+	}
+	if (bytesWritten == (kCalib_HeaderSize + (pixelCount * sizeof(float))))
+	{
+		pthread_mutex_lock(&calibLib->libMutex);
+		rename(tempPath, filePath);
+
+		//*	update the index, the library may have been rescanned since the capture started
+		entryIdx	=	-1;
+		for (ii=0; ii<calibLib->entryCnt; ii++)
+		{
+			if (SameMaster(&calibLib->entries[ii].key, saveKey))
+			{
+				entryIdx	=	ii;
+			}
+		}
+		if ((entryIdx < 0) && (calibLib->entryCnt < kCalib_MaxEntries))
+		{
+			entryIdx	=	calibLib->entryCnt++;
+		}
+		if (entryIdx >= 0)
+		{
+			calibLib->entries[entryIdx].key			=	*saveKey;
+			calibLib->entries[entryIdx].frameCount	=	frameCount;
+			snprintf(calibLib->entries[entryIdx].fileName, sizeof(calibLib->entries[entryIdx].fileName), "%s", fileName);
+			if (calibLib->captureActive && SameMaster(&calibLib->captureKey, saveKey))
+			{
+				calibLib->captureEntryIdx	=	entryIdx;
+			}
+
+			//*	the mapped copies are now out of date, force a re-map on the next frame
+			if (calibLib->darkMaster.entryIdx == entryIdx)
+			{
+				UnmapMaster(&calibLib->darkMaster);
+				calibLib->hotPixelCnt	=	0;
+			}
+			if (calibLib->flatMaster.entryIdx == entryIdx)
+			{
+				UnmapMaster(&calibLib->flatMaster);
+			}
+		}
+		pthread_mutex_unlock(&calibLib->libMutex);
+	}
+	else
+	{
+		CONSOLE_DEBUG_W_STR("Failed to write calibration master", tempPath);
+		unlink(tempPath);
+	}
+	if (gainData != NULL)
+	{
+		free(gainData);
+	}
+}
+
+//*****************************************************************************
+static void	*SaveMasterThread(void *arg)
+{
+TYPE_CALIB_LIBRARY	*calibLib;
+
+	calibLib	=	(TYPE_CALIB_LIBRARY *)arg;
+	SaveMaster(calibLib, &calibLib->saveKey, calibLib->saveMean, calibLib->saveCount);
+
+	pthread_mutex_lock(&calibLib->libMutex);
+	calibLib->saveDone	=	true;
+	pthread_mutex_unlock(&calibLib->libMutex);
+	return(NULL);
+}
+
+//*****************************************************************************
+//*	called with the lock held, if the last save is still running this one is
+//*	skipped, the next interval (or the stop) picks up the frames
+//*****************************************************************************
+static void	StartBackgroundSave(TYPE_CALIB_LIBRARY *calibLib)
+{
+long	pixelCount;
+int		threadErr;
+
+	if (calibLib->saveThreadActive)
+	{
+		if (calibLib->saveDone == false)
+		{
+			return;
+		}
+		//*	it has finished, this does not wait
+		pthread_join(calibLib->saveThreadID, NULL);
+		calibLib->saveThreadActive	=	false;
+	}
+	pixelCount	=	(long)calibLib->captureKey.width * calibLib->captureKey.height;
+	if (calibLib->saveMean == NULL)
+	{
+		calibLib->saveMean	=	(float *)malloc(pixelCount * sizeof(float));
+	}
+	if (calibLib->saveMean != NULL)
+	{
+		memcpy(calibLib->saveMean, calibLib->captureMean, pixelCount * sizeof(float));
+		calibLib->saveKey	=	calibLib->captureKey;
+		calibLib->saveCount	=	calibLib->captureCount;
+		calibLib->saveDone	=	false;
+		threadErr			=	pthread_create(&calibLib->saveThreadID, NULL, &SaveMasterThread, calibLib);
+		calibLib->saveThreadActive	=	(threadErr == 0);
+	}
+}
+
+//*****************************************************************************
+//*	called without the lock, the save thread needs it to finish
+//*****************************************************************************
+static void	WaitForBackgroundSave(TYPE_CALIB_LIBRARY *calibLib)
+{
+bool	threadActive;
+
+	pthread_mutex_lock(&calibLib->libMutex);
+	threadActive				=	calibLib->saveThreadActive;
+	calibLib->saveThreadActive	=	false;
+	pthread_mutex_unlock(&calibLib->libMutex);
+	if (threadActive)
+	{
+		pthread_join(calibLib->saveThreadID, NULL);
+	}
+	if (calibLib->saveMean != NULL)
+	{
+		free(calibLib->saveMean);
+		calibLib->saveMean	=	NULL;
+	}
+}
+
+//*****************************************************************************
+bool	Calib_StartCapture(TYPE_CALIB_LIBRARY *calibLib, const TYPE_CALIB_KEY *captureKey)
+{
+TYPE_CALIB_MAPPED	existingMaster;
+long				pixelCount;
+int					ii;
+bool				captureOK;
+
+	Calib_StopCapture(calibLib);
+
+	pthread_mutex_lock(&calibLib->libMutex);
+	captureOK	=	false;
+	pixelCount	=	(long)captureKey->width * captureKey->height;
+	if (pixelCount > 0)
+	{
+		calibLib->captureMean	=	(float *)calloc(pixelCount, sizeof(float));
+	}
+	if (calibLib->captureMean != NULL)
+	{
+		calibLib->captureKey		=	*captureKey;
+		calibLib->captureCount		=	0;
+		calibLib->captureEntryIdx	=	-1;
+		for (ii=0; ii<calibLib->entryCnt; ii++)
+		{
+			if (SameMaster(&calibLib->entries[ii].key, captureKey))
+			{
+				calibLib->captureEntryIdx	=	ii;
+			}
+		}
+
+		//*	bias and dark pick up where the existing master left off
+		if ((calibLib->captureEntryIdx >= 0) && (captureKey->calibType != kCalib_Flat))
+		{
+			memset(&existingMaster, 0, sizeof(TYPE_CALIB_MAPPED));
+			existingMaster.entryIdx	=	-1;
+			if (MapMaster(calibLib, &existingMaster, calibLib->captureEntryIdx))
+			{
+				memcpy(calibLib->captureMean, existingMaster.data, pixelCount * sizeof(float));
+				calibLib->captureCount	=	calibLib->entries[calibLib->captureEntryIdx].frameCount;
+				UnmapMaster(&existingMaster);
+			}
+		}
+		calibLib->captureActive	=	true;
+		captureOK				=	true;
+	}
+	pthread_mutex_unlock(&calibLib->libMutex);
+	return(captureOK);
+}
+
+//*****************************************************************************
+void	Calib_AddCaptureFrame(	TYPE_CALIB_LIBRARY	*calibLib,
+								const void			*imageData,
+								const int			width,
+								const int			height,
+								const int			bytesPerPixel)
+{
+const uint8_t	*data8;
+const uint16_t	*data16;
+float			*meanData;
+float			newCount;
+long			pixelCount;
+long			ii;
+
+	pthread_mutex_lock(&calibLib->libMutex);
+	if (calibLib->captureActive && (imageData != NULL) &&
+		(width == calibLib->captureKey.width) && (height == calibLib->captureKey.height))
+	{
+		calibLib->captureCount++;
+		newCount	=	calibLib->captureCount;
+		pixelCount	=	(long)width * height;
+		meanData	=	calibLib->captureMean;
+		data8		=	(const uint8_t *)imageData;
+		data16		=	(const uint16_t *)imageData;
+		if (bytesPerPixel == 2)
+		{
+			for (ii=0; ii<pixelCount; ii++)
+			{
+				meanData[ii]	+=	(data16[ii] - meanData[ii]) / newCount;
+			}
+		}
+		else
+		{
+			for (ii=0; ii<pixelCount; ii++)
+			{
+				meanData[ii]	+=	(data8[ii] - meanData[ii]) / newCount;
+			}
+		}
+		if ((calibLib->captureCount % kCalib_SaveInterval) == 0)
+		{
+			StartBackgroundSave(calibLib);
+		}
+	}
+	pthread_mutex_unlock(&calibLib->libMutex);
+}
+
+//*****************************************************************************
+//*	the final save is done here, on the command thread, not in the capture path
+//*****************************************************************************
+void	Calib_StopCapture(TYPE_CALIB_LIBRARY *calibLib)
+{
+TYPE_CALIB_KEY	finalKey;
+float			*finalMean;
+uint32_t		finalCount;
+
+	WaitForBackgroundSave(calibLib);
+
+	//*	take the mean away from the capture, then save it without the lock
+	pthread_mutex_lock(&calibLib->libMutex);
+	finalMean	=	NULL;
+	finalCount	=	0;
+	if (calibLib->captureActive)
+	{
+		finalMean	=	calibLib->captureMean;
+		finalKey	=	calibLib->captureKey;
+		finalCount	=	calibLib->captureCount;
+		calibLib->captureMean	=	NULL;
+		calibLib->captureActive	=	false;
+	}
+	if (calibLib->captureMean != NULL)
+	{
+		free(calibLib->captureMean);
+		calibLib->captureMean	=	NULL;
+	}
+	pthread_mutex_unlock(&calibLib->libMutex);
+
+	if (finalMean != NULL)
+	{
+		SaveMaster(calibLib, &finalKey, finalMean, finalCount);
+		free(finalMean);
+	}
+}
@@ -0,0 +1,141 @@
+//**************************************************************************
+//*	Name:			calibration.h
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Library of master bias/dark/flat frames applied at readout
+//*
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb 14,	2021	<MLS> Created calibration.h
+//*	Mar 30,	2021	<MLS> The periodic master save is done on its own thread
+//*****************************************************************************
+//#include	"calibration.h"
+
+#ifndef _CALIBRATION_H_
+#define	_CALIBRATION_H_
+
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<stddef.h>
+
+#ifndef _PTHREAD_H
+	#include	<pthread.h>
+#endif // _PTHREAD_H
+
+//*****************************************************************************
+typedef enum
+{
+	kCalib_Bias	=	0,
+	kCalib_Dark,
+	kCalib_Flat,
+
+	kCalib_last
+} TYPE_CALIB_TYPE;
+
+#define	kCalib_MaxEntries			64
+#define	kCalib_FilterNameLen		48		//*	same as the filter wheel name
+#define	kCalib_FileNameLen			128
+#define	kCalib_HeaderSize			256		//*	the float data starts here in the master file
+#define	kCalib_SaveInterval			5		//*	masters are rewritten every n frames while capturing
+
+//*****************************************************************************
+//*	what a master was taken with, also what a light frame is matched against
+typedef struct
+{
+	TYPE_CALIB_TYPE	calibType;
+	int32_t			exposure_us;
+	int				gain;
+	double			temperature;			//*	deg C
+	int				binning;
+	char			filterName[kCalib_FilterNameLen];
+	int				width;
+	int				height;
+} TYPE_CALIB_KEY;
+
+//*****************************************************************************
+typedef struct
+{
+	TYPE_CALIB_KEY	key;
+	uint32_t		frameCount;				//*	number of frames that went into the master
+	char			fileName[kCalib_FileNameLen];
+} TYPE_CALIB_ENTRY;
+
+//*****************************************************************************
+//*	a master file, memory mapped read only
+typedef struct
+{
+	int				entryIdx;				//*	-1 if nothing is mapped
+	void			*mapAddress;
+	size_t			mapLength;
+	const float		*data;
+} TYPE_CALIB_MAPPED;
+
+//*****************************************************************************
+typedef struct
+{
+	pthread_mutex_t		libMutex;			//*	commands come in on a different thread than the frames
+	char				libraryDir[128];
+	TYPE_CALIB_ENTRY	entries[kCalib_MaxEntries];
+	int					entryCnt;
+
+	//*	masters selected for the current light frames
+	TYPE_CALIB_MAPPED	darkMaster;			//*	dark if there is a match, otherwise bias
+	TYPE_CALIB_MAPPED	flatMaster;			//*	stored as a normalized gain map (mean / flat)
+	uint32_t			*hotPixelList;		//*	pixel indexes, found from the dark master
+	int					hotPixelCnt;
+
+	//*	building a master from incoming frames
+	bool				captureActive;
+	TYPE_CALIB_KEY		captureKey;
+	float				*captureMean;
+	uint32_t			captureCount;
+	int					captureEntryIdx;
+
+	//*	the periodic save works on a copy so the frames do not wait for the disk
+	bool				saveThreadActive;
+	bool				saveDone;
+	pthread_t			saveThreadID;
+	TYPE_CALIB_KEY		saveKey;
+	uint32_t			saveCount;
+	float				*saveMean;
+
+	//*	statistics
+	uint32_t			framesCalibrated;
+	uint32_t			lastApplyTime_us;
+} TYPE_CALIB_LIBRARY;
+
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+void		Calib_OpenLibrary(		TYPE_CALIB_LIBRARY *calibLib, const char *libraryDir);
+void		Calib_CloseLibrary(		TYPE_CALIB_LIBRARY *calibLib);
+void		Calib_ScanLibrary(		TYPE_CALIB_LIBRARY *calibLib);
+bool		Calib_SelectMasters(	TYPE_CALIB_LIBRARY *calibLib, const TYPE_CALIB_KEY *lightKey);
+void		Calib_ApplyFrame(		TYPE_CALIB_LIBRARY	*calibLib,
+									void				*imageData,
+									const int			width,
+									const int			height,
+									const int			bytesPerPixel,
+									const bool			bayerData);
+
+bool		Calib_StartCapture(		TYPE_CALIB_LIBRARY *calibLib, const TYPE_CALIB_KEY *captureKey);
+void		Calib_AddCaptureFrame(	TYPE_CALIB_LIBRARY	*calibLib,
+									const void			*imageData,
+									const int			width,
+									const int			height,
+									const int			bytesPerPixel);
+void		Calib_StopCapture(		TYPE_CALIB_LIBRARY *calibLib);
+
+const char	*Calib_GetTypeName(TYPE_CALIB_TYPE calibType);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//	_CALIBRATION_H_
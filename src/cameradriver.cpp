@@ -127,6 +127,44 @@
 //*	Jan 18,	2021	<MLS> Added Send_imagearray_rgb24() & Send_imagearray_raw8()
 //*	Jan 20,	2021	<MLS> Added Send_imagearray_raw16()
 //*	Jan 20,	2021	<MLS> CONFORM-camera -> PASSED!!!!!!!!!!!!!!!!!!!!!
+//*	Feb  3,	2021	<MLS> Put_StartVideo() no longer creates an AVI, video is written as SER
+//*	Feb  3,	2021	<MLS> Added "directio" option to startvideo, dropped frames in readall
+//*	Feb  7,	2021	<MLS> Added livestack and livestackimage commands
+//*	Feb 10,	2021	<MLS> RAW color images are now debayered for rgbarray
+//*	Feb 10,	2021	<MLS> Added "Debayer" option (bilinear/edge) to startexposure
+//*	Feb 12,	2021	<MLS> Added preview command (binned / max dimension, json, imagebytes, jpeg)
+//*	Feb 15,	2021	<MLS> Added calibration command, masters are applied right after readout
+//*	Feb 17,	2021	<MLS> Added stars command (star detection, HFR/FWHM)
+//*	Feb 19,	2021	<MLS> Added autofocus command
+//*	Feb 22,	2021	<MLS> Added frametiming command, per frame latency timeline
+//*	Feb 24,	2021	<MLS> Exposures are now waited on and read out by the capture thread
+//*	Feb 26,	2021	<MLS> Camera and debayer buffers now come from the image pool
+//*	Feb 28,	2021	<MLS> Added Rice compressed imagearray (Compression=rice)
+//*	Mar  2,	2021	<MLS> Added roistream command for high rate ROI streaming
+//*	Mar  6,	2021	<MLS> Added fitscompression to filenameoptions and readall
+//*	Mar  8,	2021	<MLS> FITS header snapshot is captured at exposure start
+//*	Mar 10,	2021	<MLS> filelist now comes from the image catalog, paged and filtered
+//*	Mar 12,	2021	<MLS> Added thumbnail command, JPEG thumbnails served with ETag
+//*	Mar 14,	2021	<MLS> Added sequence command, pipelined step sequencer
+//*	Mar 14,	2021	<MLS> Gain changes now update the FITS header snapshot
+//*	Mar 16,	2021	<MLS> Put_AutoExposure() accepts Percentile and Target
+//*	Mar 20,	2021	<MLS> Added mjpeg command, MJPEG live view stream
+//*	Mar 26,	2021	<MLS> Added quality command, per frame quality metrics
+//*	Mar 28,	2021	<MLS> Temperature and cooler endpoints serve cached telemetry (cTelemetry)
+//*	Mar 28,	2021	<MLS> Get_Imagearray() and Get_Readall() no longer read the sensor temp
+//*	Mar 30,	2021	<MLS> The preview cache and debayer buffer are used under cPreviewMutex
+//*	Mar 30,	2021	<MLS> The destructor waits for the thumbnail thread
+//*	Mar 30,	2021	<MLS> The FITS snapshot is only touched under cFitsSnapshotMutex
+//*	Mar 30,	2021	<MLS> Get_LiveStackImage() copies the stack under the mutex and sends without it
+//*	Mar 30,	2021	<MLS> livestack-jpeg is only reported once the file has been written
+//*	Mar 30,	2021	<MLS> Added cCameraDataMutex, Get_Imagearray() sends a copy of the camera buffer
+//*	Mar 30,	2021	<MLS> Abort and stop wake the capture thread
+//*	Mar 30,	2021	<MLS> Get_Stars() only reports the analysis done by the state machine
+//*	Mar 30,	2021	<MLS> Get_RGBarray() sends a copy, the mutexes are not held while sending
+//*	Mar 30,	2021	<MLS> Compressed downloads are sent from a copy, compression on readout times out
+//*	Mar 30,	2021	<MLS> Sensor telemetry is not read while the capture thread is reading out
+//*	Mar 30,	2021	<MLS> The image pool is trimmed when the camera buffer has to grow
+//*	Mar 30,	2021	<MLS> The FITS snapshot thread is stopped in the destructor
 //*****************************************************************************
 //*	Jan  1,	2119	<TODO> ----------------------------------------
 //*	Jun 26,	2119	<TODO> Add support for sub frames
@@ -197,6 +235,7 @@ const char	*gCameraStateStrings[]	=
 	"TakingPicture",
 	"StartVideo",
 	"TakingVideo",
+	"ROIstream",
 	"undefined"
 };
 
@@ -269,6 +308,8 @@ const TYPE_CmdEntry	gCameraCmdTable[]	=
 	//*	items added by MLS
 	{	"--extras",					kCmd_Camera_Extras,					kCmdType_GET	},
 	{	"autoexposure",				kCmd_Camera_autoexposure,			kCmdType_BOTH	},
+	{	"autofocus",				kCmd_Camera_autofocus,				kCmdType_BOTH	},
+	{	"calibration",				kCmd_Camera_calibration,			kCmdType_BOTH	},
 	{	"displayimage",				kCmd_Camera_displayimage,			kCmdType_BOTH	},
 	{	"exposuretime",				kCmd_Camera_exposuretime,			kCmdType_BOTH	},
 #ifdef _ENABLE_FITS_
@@ -277,15 +318,25 @@ const TYPE_CmdEntry	gCameraCmdTable[]	=
 	{	"filelist",					kCmd_Camera_filelist,				kCmdType_GET	},
 	{	"filenameoptions",			kCmd_Camera_filenameoptions,		kCmdType_PUT	},
 	{	"framerate",				kCmd_Camera_framerate,				kCmdType_GET	},
+	{	"frametiming",				kCmd_Camera_frametiming,			kCmdType_BOTH	},
 	{	"livemode",					kCmd_Camera_livemode,				kCmdType_BOTH	},
+	{	"livestack",				kCmd_Camera_livestack,				kCmdType_BOTH	},
+	{	"livestackimage",			kCmd_Camera_livestackimage,			kCmdType_GET	},
+	{	"mjpeg",					kCmd_Camera_mjpeg,					kCmdType_GET	},
+	{	"preview",					kCmd_Camera_preview,				kCmdType_GET	},
+	{	"quality",					kCmd_Camera_quality,				kCmdType_BOTH	},
 	{	"rgbarray",					kCmd_Camera_rgbarray,				kCmdType_GET	},
+	{	"roistream",				kCmd_Camera_roistream,				kCmdType_BOTH	},
 	{	"savenextimage",			kCmd_Camera_savenextimage,			kCmdType_PUT	},
+	{	"sequence",					kCmd_Camera_sequence,				kCmdType_BOTH	},
+	{	"stars",					kCmd_Camera_stars,					kCmdType_BOTH	},
 	{	"settelescopeinfo",			kCmd_Camera_settelescopeinfo,		kCmdType_PUT	},
 	{	"sidebar",					kCmd_Camera_sidebar,				kCmdType_BOTH	},
 	{	"startsequence",			kCmd_Camera_startsequence,			kCmdType_PUT	},
 
 	{	"startvideo",				kCmd_Camera_startvideo,				kCmdType_PUT	},
 	{	"stopvideo",				kCmd_Camera_stopvideo,				kCmdType_PUT	},
+	{	"thumbnail",				kCmd_Camera_thumbnail,				kCmdType_GET	},
 
 	{	"readall",					kCmd_Camera_readall,				kCmdType_GET	},
 #endif // _INCLUDE_ALPACA_EXTRAS_
@@ -299,7 +350,8 @@ const TYPE_CmdEntry	gCameraCmdTable[]	=
 CameraDriver::CameraDriver(void)
 	:AlpacaDriver(kDeviceType_Camera)
 {
-int	iii;
+int					iii;
+pthread_mutexattr_t	previewMutexAttr;
 
 	CONSOLE_DEBUG(__FUNCTION__);
 	//*	set all of the class data to known states
@@ -320,6 +372,8 @@ int	iii;
 	cTempReadSupported				=	false;
 	cCameraTemp_Dbl					=	0.0;
 	cCoolerPowerLevel				=	0;
+	memset(&cTelemetry, 0, sizeof(TYPE_SENSOR_TELEMETRY));
+	pthread_mutex_init(&cTelemetryMutex, NULL);
 	cLastCameraErrMsg[0]			=	0;
 	cDeviceName[0]					=	0;
 	cSensorName[0]					=	0;
@@ -381,10 +435,47 @@ int	iii;
 	cTotalFramesSaved				=	0;
 	cFramesRead						=	0;
 	cFrameRate						=	0.0;
+	cSERwriter						=	NULL;
+	cVideoUseDirectIO				=	false;
+	cVideoFramesDropped				=	0;
+	LiveStack_Init(&cLiveStack);
+	cCalibrationEnabled				=	false;
+	memset(&cStarAnalysis, 0, sizeof(TYPE_STAR_ANALYSIS));
+	pthread_mutex_init(&cStarMutex, NULL);
+	cStarDetectEnabled				=	false;
+	cStarDetectSigma				=	5.0;
+	cStarMonoBuffer					=	NULL;
+	cStarMonoBufLen					=	0;
+	memset(&cAutoFocus, 0, sizeof(TYPE_AUTOFOCUS));
+	memset(&cPipeline, 0, sizeof(TYPE_PIPELINE_SEQUENCE));
+	FrameTiming_Init(&cFrameTiming);
+	InitCaptureThread();
+	InitROIstream();
+	InitMJPEGstream();
+	InitQualityMetrics();
+	memset(&cThumbnailJob, 0, sizeof(TYPE_THUMBNAIL_JOB));
+	memset(&cCompressedImage, 0, sizeof(TYPE_COMPRESSED_IMAGE));
+	pthread_mutex_init(&cCompressMutex, NULL);
+	cCompressOnReadout				=	false;
+	cCompressUnusedCnt				=	0;
+	Calib_OpenLibrary(&cCalibLibrary, "calibration");
 	//*	init the data buffers to nothing
 	cInternalCameraState			=	kCameraState_Idle;
 	cCameraDataBuffer				=	NULL;
 	cCameraBGRbuffer				=	NULL;
+	cDebayerBuffer					=	NULL;
+	cDebayerBufLen					=	0;
+	cDebayerValid					=	false;
+	cDebayerBGR						=	false;
+	cDebayerMethod					=	kDebayer_EdgeAware;
+	memset(cPreviewCache, 0, sizeof(cPreviewCache));
+	pthread_mutexattr_init(&previewMutexAttr);
+	pthread_mutexattr_settype(&previewMutexAttr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&cPreviewMutex, &previewMutexAttr);
+	pthread_mutex_init(&cCameraDataMutex, &previewMutexAttr);
+	pthread_mutexattr_destroy(&previewMutexAttr);
+	memset(&cImagePyramid, 0, sizeof(cImagePyramid));
+	cPreviewUseCounter				=	0;
 	cLastexposure_StartTime.tv_sec	=	0;
 	cLastexposure_EndTime.tv_sec	=	0;
 	cLastexposure_duration_us		=	0;
@@ -399,6 +490,7 @@ int	iii;
 	cCameraDataBuffLen				=	0;
 	cAutoAdjustExposure				=	gAutoExposure;
 	cAutoAdjustStepSz_us			=	5;
+	AutoExposure_Init(&cAutoExposure);
 	cSequenceDelay_us				=	0;
 	cSeqDeltaExposure_us			=	0;
 	cCameraAutoExposure				=	false;
@@ -465,6 +557,7 @@ int	iii;
 	cFN_includeManuf			=	true;	//*	include Manufacturer in FileName
 	cFN_includeFilter			=	true;
 	cFN_includeRefID			=	true;
+	cFitsCompression			=	kFitsCompress_None;
 
 	strcpy(cTelescopeModel,		"");
 	strcpy(cObjectName,			"unknown");
@@ -479,6 +572,10 @@ int	iii;
 	{
 		GetTelescopeSettingsByRefID(NULL, 0, &cTS_info);
 	}
+	if (strlen(cTS_info.fitsCompression) > 0)
+	{
+		SetFitsCompression(cTS_info.fitsCompression);
+	}
 
 	if ((strlen(cTS_info.telescp_manufacturer) > 0) || (strlen(cTS_info.telescp_model) > 0))
 	{
@@ -515,9 +612,12 @@ int	iii;
 	{
 		strcpy(cFitsHeader[iii].fitsRec, "");
 	}
+	InitFitsSnapshot();
 #endif // _ENABLE_FITS_
 
 	mkdir(kImageDataDir, 0744);
+	mkdir(kImageDataDir "/" kThumbnailDir, 0744);
+	ImageCatalog_Init(kImageDataDir);
 
 	SendDiscoveryQuery();
 }
@@ -527,7 +627,45 @@ int	iii;
 //**************************************************************************************
 CameraDriver::~CameraDriver(void)
 {
+int		ii;
+
 	CONSOLE_DEBUG(__FUNCTION__);
+	StopROIstream();
+	ImagePool_Release(cROIstream.frameBuffer);
+	StopMJPEGstream();
+	StopQualityMetrics();
+	WaitForThumbnailThread();
+	StopCaptureThread();
+#ifdef _ENABLE_FITS_
+	StopFitsSnapshotThread();
+#endif
+	LiveStack_Release(&cLiveStack);
+	Calib_CloseLibrary(&cCalibLibrary);
+	if (cStarMonoBuffer != NULL)
+	{
+		free(cStarMonoBuffer);
+		cStarMonoBuffer	=	NULL;
+	}
+	ImagePool_Release(cDebayerBuffer);
+	cDebayerBuffer	=	NULL;
+	ImagePool_Release(cCameraDataBuffer);
+	cCameraDataBuffer	=	NULL;
+#ifdef _USE_OPENCV_
+	ReleasePooledOpenCVImage(&cOpenCV_Image);
+#endif
+	ImageCompress_Free(&cCompressedImage);
+	for (ii=0; ii<kMaxPreviewCache; ii++)
+	{
+		if (cPreviewCache[ii].imageData != NULL)
+		{
+			free(cPreviewCache[ii].imageData);
+		}
+		if (cPreviewCache[ii].jpegData != NULL)
+		{
+			free(cPreviewCache[ii].jpegData);
+		}
+	}
+	ImagePyramid_Release(&cImagePyramid);
 }
 
 
@@ -624,7 +762,10 @@ int					cmdType;
 int					myDeviceNum;
 int					mySocket;
 bool				httpHeaderSent;
+bool				binaryDataSent;
 char				httpHeader[500];
+uint64_t			downloadStart_us;
+char				compressionString[32];
 
 //	CONSOLE_DEBUG(__FUNCTION__);
 
@@ -655,6 +796,7 @@ char				httpHeader[500];
 	}
 
 	httpHeaderSent	=	false;
+	binaryDataSent	=	false;
 
 
 	//*	set up the json response
@@ -821,6 +963,7 @@ char				httpHeader[500];
 
 		case kCmd_Camera_ccdtemperature:		//*	Returns the current CCD temperature
 			alpacaErrCode	=	Get_CCDtemperature(reqData, alpacaErrMsg, gValueString);
+			AddSensorTelemetryAge(reqData);
 			break;
 
 		case kCmd_Camera_cooleron:				//*	GET- Returns the current cooler on/off state.
@@ -828,6 +971,7 @@ char				httpHeader[500];
 			if (reqData->get_putIndicator == 'G')
 			{
 				alpacaErrCode	=	Get_Cooleron(reqData, alpacaErrMsg, gValueString);
+				AddSensorTelemetryAge(reqData);
 			}
 			else if (reqData->get_putIndicator == 'P')
 			{
@@ -837,6 +981,7 @@ char				httpHeader[500];
 
 		case kCmd_Camera_coolerpower:			//*	Returns the present cooler power level
 			alpacaErrCode	=	Get_CoolerPowerLevel(reqData, alpacaErrMsg, gValueString);
+			AddSensorTelemetryAge(reqData);
 			break;
 
 		case kCmd_Camera_electronsperadu:		//*	Returns the gain of the camera
@@ -950,12 +1095,21 @@ char				httpHeader[500];
 
 		case kCmd_Camera_imagearray:			//*	Returns an array of integers containing the exposure pixel values
 		case kCmd_Camera_imagearrayvariant:		//*	Returns an array of int containing the exposure pixel values
-			if (reqData->get_putIndicator == 'G')
+			if ((reqData->get_putIndicator == 'G') &&
+				GetKeyWordArgument(reqData->contentData, "Compression", compressionString, (sizeof(compressionString) -1)))
+			{
+				downloadStart_us	=	FrameTiming_GetMonotonic_us();
+				alpacaErrCode	=	Get_ImagearrayCompressed(reqData, alpacaErrMsg, compressionString, &binaryDataSent);
+				FrameTiming_RecordDownload(&cFrameTiming, cFramesRead, downloadStart_us, FrameTiming_GetMonotonic_us());
+			}
+			else if (reqData->get_putIndicator == 'G')
 			{
 				JsonResponse_FinishHeader(httpHeader, "");
 				JsonResponse_SendTextBuffer(mySocket, httpHeader);
 				httpHeaderSent	=	true;
+				downloadStart_us	=	FrameTiming_GetMonotonic_us();
 				alpacaErrCode	=	Get_Imagearray(reqData, alpacaErrMsg);
+				FrameTiming_RecordDownload(&cFrameTiming, cFramesRead, downloadStart_us, FrameTiming_GetMonotonic_us());
 			}
 			else if (reqData->get_putIndicator == 'P')
 			{
@@ -1220,6 +1374,42 @@ char				httpHeader[500];
 			}
 			break;
 
+		case kCmd_Camera_livestack:
+			if (reqData->get_putIndicator == 'G')
+			{
+				alpacaErrCode	=	Get_LiveStack(reqData, alpacaErrMsg);
+			}
+			else if (reqData->get_putIndicator == 'P')
+			{
+				alpacaErrCode	=	Put_LiveStack(reqData, alpacaErrMsg);
+			}
+			else
+			{
+				CONSOLE_DEBUG("invalid request")
+			}
+			break;
+
+		case kCmd_Camera_preview:
+			alpacaErrCode	=	Get_Preview(reqData, alpacaErrMsg, &httpHeaderSent, &binaryDataSent);
+			break;
+
+		case kCmd_Camera_thumbnail:
+			alpacaErrCode	=	Get_Thumbnail(reqData, alpacaErrMsg, &binaryDataSent);
+			break;
+
+		case kCmd_Camera_mjpeg:
+			alpacaErrCode	=	Get_MJPEGstream(reqData, alpacaErrMsg, &binaryDataSent);
+			break;
+
+		case kCmd_Camera_livestackimage:
+			//*	binary (ImageBytes) response, on success nothing else gets sent
+			alpacaErrCode	=	Get_LiveStackImage(reqData, alpacaErrMsg);
+			if (alpacaErrCode == kASCOM_Err_Success)
+			{
+				binaryDataSent	=	true;
+			}
+			break;
+
 #ifdef _USE_OPENCV_
 		case kCmd_Camera_sidebar:
 			if (reqData->get_putIndicator == 'G')
@@ -1249,6 +1439,54 @@ char				httpHeader[500];
 			}
 			break;
 
+		case kCmd_Camera_sequence:
+			if (reqData->get_putIndicator == 'G')
+			{
+				alpacaErrCode	=	Get_Sequence(reqData, alpacaErrMsg);
+			}
+			else if (reqData->get_putIndicator == 'P')
+			{
+				alpacaErrCode	=	Put_Sequence(reqData, alpacaErrMsg);
+			}
+			else
+			{
+				CONSOLE_DEBUG("invalid request")
+				alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+			}
+			break;
+
+		case kCmd_Camera_quality:
+			if (reqData->get_putIndicator == 'G')
+			{
+				alpacaErrCode	=	Get_Quality(reqData, alpacaErrMsg);
+			}
+			else if (reqData->get_putIndicator == 'P')
+			{
+				alpacaErrCode	=	Put_Quality(reqData, alpacaErrMsg);
+			}
+			else
+			{
+				CONSOLE_DEBUG("invalid request")
+				alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+			}
+			break;
+
+		case kCmd_Camera_stars:
+			if (reqData->get_putIndicator == 'G')
+			{
+				alpacaErrCode	=	Get_Stars(reqData, alpacaErrMsg);
+			}
+			else if (reqData->get_putIndicator == 'P')
+			{
+				alpacaErrCode	=	Put_Stars(reqData, alpacaErrMsg);
+			}
+			else
+			{
+				CONSOLE_DEBUG("invalid request")
+				alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+			}
+			break;
+
 		case kCmd_Camera_startsequence:
 			if (reqData->get_putIndicator == 'P')
 			{
@@ -1277,9 +1515,41 @@ char				httpHeader[500];
 			}
 			break;
 
+		case kCmd_Camera_roistream:
+			if (reqData->get_putIndicator == 'G')
+			{
+				alpacaErrCode	=	Get_ROIstream(reqData, alpacaErrMsg, &binaryDataSent);
+			}
+			else if (reqData->get_putIndicator == 'P')
+			{
+				alpacaErrCode	=	Put_ROIstream(reqData, alpacaErrMsg);
+			}
+			else
+			{
+				CONSOLE_DEBUG("invalid request")
+				alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+			}
+			break;
+
 		case kCmd_Camera_framerate:
 			break;
 
+		case kCmd_Camera_frametiming:
+			if (reqData->get_putIndicator == 'G')
+			{
+				alpacaErrCode	=	Get_FrameTiming(reqData, alpacaErrMsg, &httpHeaderSent, &binaryDataSent);
+			}
+			else if (reqData->get_putIndicator == 'P')
+			{
+				alpacaErrCode	=	Put_FrameTiming(reqData, alpacaErrMsg);
+			}
+			else
+			{
+				CONSOLE_DEBUG("invalid request")
+				alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+			}
+			break;
+
 		case kCmd_Camera_filelist:
 			alpacaErrCode	=	Get_Filelist(reqData, alpacaErrMsg);
 			break;
@@ -1300,6 +1570,38 @@ char				httpHeader[500];
 			}
 			break;
 
+		case kCmd_Camera_autofocus:
+			if (reqData->get_putIndicator == 'G')
+			{
+				alpacaErrCode	=	Get_AutoFocus(reqData, alpacaErrMsg);
+			}
+			else if (reqData->get_putIndicator == 'P')
+			{
+				alpacaErrCode	=	Put_AutoFocus(reqData, alpacaErrMsg);
+			}
+			else
+			{
+				CONSOLE_DEBUG("invalid request")
+				alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+			}
+			break;
+
+		case kCmd_Camera_calibration:
+			if (reqData->get_putIndicator == 'G')
+			{
+				alpacaErrCode	=	Get_Calibration(reqData, alpacaErrMsg);
+			}
+			else if (reqData->get_putIndicator == 'P')
+			{
+				alpacaErrCode	=	Put_Calibration(reqData, alpacaErrMsg);
+			}
+			else
+			{
+				CONSOLE_DEBUG("invalid request")
+				alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+			}
+			break;
+
 		case kCmd_Camera_displayimage:
 			if (reqData->get_putIndicator == 'G')
 			{
@@ -1352,7 +1654,9 @@ char				httpHeader[500];
 				JsonResponse_SendTextBuffer(mySocket, httpHeader);
 //				CONSOLE_DEBUG_W_STR("httpHeader\t=", httpHeader);
 				httpHeaderSent	=	true;
+				downloadStart_us	=	FrameTiming_GetMonotonic_us();
 				alpacaErrCode	=	Get_RGBarray(reqData, alpacaErrMsg);
+				FrameTiming_RecordDownload(&cFrameTiming, cFramesRead, downloadStart_us, FrameTiming_GetMonotonic_us());
 			}
 			else if (reqData->get_putIndicator == 'P')
 			{
@@ -1376,6 +1680,11 @@ char				httpHeader[500];
 
 	}
 	RecordCmdStats(cmdEnumValue, reqData->get_putIndicator, alpacaErrCode);
+	if (binaryDataSent)
+	{
+		strcpy(reqData->alpacaErrMsg, alpacaErrMsg);
+		return(alpacaErrCode);
+	}
 
 	//*	send the response information
 	JsonResponse_Add_Int32(		mySocket,
@@ -1467,6 +1776,7 @@ bool	durationFound;
 char	duarationString[32];
 double	myExposureDuration_secs;
 double	myExposure_usecs;
+char	debayerString[32];
 
 //	CONSOLE_DEBUG(__FUNCTION__);
 	if (reqData != NULL)
@@ -1478,6 +1788,20 @@ double	myExposure_usecs;
 //		CONSOLE_DEBUG_W_STR("Suffix", cFileNameSuffix);
 
 
+		if (GetKeyWordArgument(reqData->contentData, "Debayer", debayerString, (sizeof(debayerString) -1)))
+		{
+			if (strcasecmp(debayerString, "bilinear") == 0)
+			{
+				cDebayerMethod	=	kDebayer_Bilinear;
+			}
+			else
+			{
+				cDebayerMethod	=	kDebayer_EdgeAware;
+			}
+			//*	also invalidates the debayered image
+			ClearPreviewCache();
+		}
+
 		durationFound		=	GetKeyWordArgument(	reqData->contentData,
 													"Duration",
 													duarationString,
@@ -1621,6 +1945,7 @@ char				gainString[32];
 				if (alpacaErrCode == kASCOM_Err_Success)
 				{
 					cGain	=	newGainValue;
+					gDeviceStateChangeCnt++;
 				}
 			}
 			else
@@ -2066,24 +2391,28 @@ char				errorString[64];
 }
 
 
+//*****************************************************************************
+//*	the value comes from cTelemetry, the camera is not asked
 //*****************************************************************************
 TYPE_ASCOM_STATUS	CameraDriver::Get_CCDtemperature(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg, const char *responseString)
 {
 TYPE_ASCOM_STATUS		alpacaErrCode;
+TYPE_SENSOR_TELEMETRY	telemetry;
 
 //	CONSOLE_DEBUG(__FUNCTION__);
 	if (reqData != NULL)
 	{
 		if (cTempReadSupported)
 		{
-			alpacaErrCode	=	Read_SensorTemp();
+			GetSensorTelemetry(&telemetry);
+			alpacaErrCode	=	telemetry.ccdTempErr;
 			if (alpacaErrCode == 0)
 			{
 				JsonResponse_Add_Double(reqData->socket,
 										reqData->jsonTextBuffer,
 										kMaxJsonBuffLen,
 										responseString,
-										cCameraTemp_Dbl,
+										telemetry.ccdTemp_degC,
 										INCLUDE_COMMA);
 
 //				JsonResponse_Add_String(reqData->socket,
@@ -2097,7 +2426,7 @@ TYPE_ASCOM_STATUS		alpacaErrCode;
 			else
 			{
 				GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to read temperature:");
-				strcat(alpacaErrMsg, cLastCameraErrMsg);
+				strcat(alpacaErrMsg, telemetry.lastErrMsg);
 				CONSOLE_DEBUG(alpacaErrMsg);
 			}
 		}
@@ -2118,8 +2447,9 @@ TYPE_ASCOM_STATUS		alpacaErrCode;
 //*****************************************************************************
 TYPE_ASCOM_STATUS	CameraDriver::Get_Cooleron(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg, const char *responseString)
 {
-TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_NotImplemented;
-bool				coolerState;
+TYPE_ASCOM_STATUS		alpacaErrCode	=	kASCOM_Err_NotImplemented;
+bool					coolerState;
+TYPE_SENSOR_TELEMETRY	telemetry;
 
 //	CONSOLE_DEBUG(__FUNCTION__);
 
@@ -2127,7 +2457,9 @@ bool				coolerState;
 	{
 		if (cIsCoolerCam)
 		{
-			alpacaErrCode	=	Read_CoolerState(&coolerState);
+			GetSensorTelemetry(&telemetry);
+			alpacaErrCode	=	telemetry.coolerStateErr;
+			coolerState		=	telemetry.coolerOn;
 			if (alpacaErrCode == 0)
 			{
 		//		CONSOLE_DEBUG(__FUNCTION__);
@@ -2136,14 +2468,14 @@ bool				coolerState;
 			{
 				coolerState	=	false;
 				GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Not implemented:");
-				strcat(alpacaErrMsg, cLastCameraErrMsg);
+				strcat(alpacaErrMsg, telemetry.lastErrMsg);
 		//		CONSOLE_DEBUG(alpacaErrMsg);
 			}
 			else
 			{
 				coolerState	=	false;
 				GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to read cooler state:");
-				strcat(alpacaErrMsg, cLastCameraErrMsg);
+				strcat(alpacaErrMsg, telemetry.lastErrMsg);
 		//		CONSOLE_DEBUG(alpacaErrMsg);
 			}
 			JsonResponse_Add_Bool(	reqData->socket,
@@ -2200,6 +2532,10 @@ bool				foundKeyWord;
 				{
 					GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, cLastCameraErrMsg);
 				}
+				//*	so cooleron reflects the change without waiting for the next sample
+				pthread_mutex_lock(&cTelemetryMutex);
+				cTelemetry.refreshNeeded	=	true;
+				pthread_mutex_unlock(&cTelemetryMutex);
 			}
 			else
 			{
@@ -2225,27 +2561,28 @@ bool				foundKeyWord;
 //*****************************************************************************
 TYPE_ASCOM_STATUS	CameraDriver::Get_CoolerPowerLevel(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg, const char *responseString)
 {
-TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_InternalError;
+TYPE_ASCOM_STATUS		alpacaErrCode	=	kASCOM_Err_InternalError;
+TYPE_SENSOR_TELEMETRY	telemetry;
 
-	cLastCameraErrMsg[0]	=	0;
 	if (reqData != NULL)
 	{
 		if (cIsCoolerCam)
 		{
-			alpacaErrCode		=	Read_CoolerPowerLevel();
+			GetSensorTelemetry(&telemetry);
+			alpacaErrCode		=	telemetry.coolerPowerErr;
 			if (alpacaErrCode == 0)
 			{
 				JsonResponse_Add_Int32(	reqData->socket,
 										reqData->jsonTextBuffer,
 										kMaxJsonBuffLen,
 										responseString,
-										cCoolerPowerLevel,
+										telemetry.coolerPower,
 										INCLUDE_COMMA);
 			}
 			else
 			{
 				GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to read cooler level:, Camera Err=");
-				strcat(alpacaErrMsg, cLastCameraErrMsg);
+				strcat(alpacaErrMsg, telemetry.lastErrMsg);
 			}
 		}
 		else
@@ -2661,7 +2998,12 @@ double				myExposure_usecs;
 		CONSOLE_DEBUG_W_STR("contentData\t=",	reqData->contentData);
 
 		//*	first we are going to check a bunch of stuff to make CONFORM happy
-		if ((cStartX >= 0) && (cStartX < cCameraXsize) && (cStartY >= 0) && (cStartY < cCameraYsize) &&
+		if (cInternalCameraState == kCameraState_ROIstream)
+		{
+			alpacaErrCode	=	kASCOM_Err_CameraBusy;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "ROI stream in progress");
+		}
+		else if ((cStartX >= 0) && (cStartX < cCameraXsize) && (cStartY >= 0) && (cStartY < cCameraYsize) &&
 			(cNumX >= 1) && (cNumX <= cCameraXsize) && (cNumY >= 1) && (cNumY <= cCameraYsize) &&
 			(cCurrentBinX >= 1) && (cCurrentBinX <= cMaxbinX) &&
 			(cCurrentBinY >= 1) && (cCurrentBinY <= cMaxbinY))
@@ -2705,6 +3047,10 @@ double				myExposure_usecs;
 																//*	this really belongs in Start_CameraExposure, but just in case
 				//======================================================================================
 
+				FrameTiming_StartFrame(&cFrameTiming, cCurrentExposure_us);
+			#ifdef _ENABLE_FITS_
+				CaptureFitsSnapshot();
+			#endif
 				alpacaErrCode				=	Start_CameraExposure(cCurrentExposure_us);
 				GenerateFileNameRoot();
 
@@ -2771,6 +3117,7 @@ TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_NotImplemented;
 //	CONSOLE_DEBUG(__FUNCTION__);
 
 	alpacaErrCode	=	Stop_Exposure();
+	SignalCaptureEvent();
 
 	return(alpacaErrCode);
 }
@@ -2781,10 +3128,16 @@ TYPE_ASCOM_STATUS	CameraDriver::Put_AbortExposure(TYPE_GetPutRequestData *reqDat
 TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
 
 //	CONSOLE_DEBUG(__FUNCTION__);
-	if (cCanAbortExposure)
+	if (cInternalCameraState == kCameraState_ROIstream)
 	{
+		StopROIstream();
+	}
+	else if (cCanAbortExposure)
+	{
+		Pipeline_Stop("Aborted");
 		cInternalCameraState		=	kCameraState_Idle;
 		cImageMode					=	kImageMode_Single;
+		SignalCaptureEvent();		//*	the capture thread may be asleep for the rest of the exposure
 	}
 	else
 	{
@@ -2939,6 +3292,10 @@ int					iii;
 int					mySocket;
 char				imageTimeString[64];
 double				exposureTimeSecs;
+TYPE_SENSOR_TELEMETRY	telemetry;
+int32_t				telemetryAge_ms;
+int					bytesPerPixel;
+unsigned char		*imageCopy;
 
 	CONSOLE_DEBUG(__FUNCTION__);
 
@@ -2966,14 +3323,23 @@ double				exposureTimeSecs;
 							INCLUDE_COMMA);
 
 	//========================================================================================
-	//*	record the sensor temp
-	alpacaErrCode	=	Read_SensorTemp();
-	JsonResponse_Add_Double(mySocket,
-							reqData->jsonTextBuffer,
-							kMaxJsonBuffLen,
-							"ccdtemperature",
-							cCameraTemp_Dbl,
-							INCLUDE_COMMA);
+	//*	record the sensor temp, from the telemetry, the camera is not asked before the download
+	telemetryAge_ms	=	GetSensorTelemetry(&telemetry);
+	if (telemetry.ccdTempErr == kASCOM_Err_Success)
+	{
+		JsonResponse_Add_Double(mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"ccdtemperature",
+								telemetry.ccdTemp_degC,
+								INCLUDE_COMMA);
+		JsonResponse_Add_Int32(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"telemetry-age-ms",
+								telemetryAge_ms,
+								INCLUDE_COMMA);
+	}
 
 
 	//*	get the ROI information which has the current image type
@@ -2984,7 +3350,19 @@ double				exposureTimeSecs;
 	CONSOLE_DEBUG_W_NUM("pixelCount\t=", pixelCount);
 
 	CONSOLE_DEBUG_W_NUM("cImageReady\t=", cImageReady);
-	if (cImageReady && (cCameraDataBuffer != NULL))
+	switch(cLastExposure_ROIinfo.currentROIimageType)
+	{
+		case kImageType_RAW16:	bytesPerPixel	=	2;	break;
+		case kImageType_RGB24:	bytesPerPixel	=	3;	break;
+		default:				bytesPerPixel	=	1;	break;
+	}
+	//*	the capture thread may read out the next frame while this is being sent
+	imageCopy	=	NULL;
+	if (cImageReady)
+	{
+		imageCopy	=	CopyCameraData((long)pixelCount * bytesPerPixel);
+	}
+	if (imageCopy != NULL)
 	{
 		//========================================================================================
 		//*	record the image type
@@ -3040,7 +3418,7 @@ double				exposureTimeSecs;
 			case kImageType_RAW8:
 			case kImageType_Y8:
 				Send_imagearray_raw8(	mySocket,
-										cCameraDataBuffer,
+										imageCopy,
 										cLastExposure_ROIinfo.currentROIheight,		//*	# of rows
 										cLastExposure_ROIinfo.currentROIwidth,		//*	# of columns
 										pixelCount);
@@ -3048,7 +3426,7 @@ double				exposureTimeSecs;
 
 			case kImageType_RAW16:
 				Send_imagearray_raw16(	mySocket,
-										cCameraDataBuffer,
+										imageCopy,
 										cLastExposure_ROIinfo.currentROIheight,		//*	# of rows
 										cLastExposure_ROIinfo.currentROIwidth,		//*	# of columns
 										pixelCount);
@@ -3056,7 +3434,7 @@ double				exposureTimeSecs;
 
 			case kImageType_RGB24:
 				Send_imagearray_rgb24(	mySocket,
-										cCameraDataBuffer,
+										imageCopy,
 										cLastExposure_ROIinfo.currentROIheight,		//*	# of rows
 										cLastExposure_ROIinfo.currentROIwidth,		//*	# of columns
 										pixelCount);
@@ -3068,6 +3446,8 @@ double				exposureTimeSecs;
 		}
 
 
+		ImagePool_Release(imageCopy);
+
 		JsonResponse_Add_ArrayEnd(	mySocket,
 									reqData->jsonTextBuffer,
 									kMaxJsonBuffLen,
@@ -3086,6 +3466,122 @@ double				exposureTimeSecs;
 }
 
 
+//*****************************************************************************
+//*	compresses the current image if it has not been done yet for this frame
+//*	called from the state machine right after readout and from the download
+//*****************************************************************************
+bool	CameraDriver::CompressImageData(void)
+{
+int		bytesPerSample;
+int		planes;
+bool	compressOK;
+
+	switch(cLastExposure_ROIinfo.currentROIimageType)
+	{
+		case kImageType_RAW16:
+			bytesPerSample	=	2;
+			planes			=	1;
+			break;
+
+		case kImageType_RGB24:
+			bytesPerSample	=	1;
+			planes			=	3;
+			break;
+
+		case kImageType_RAW8:
+		case kImageType_Y8:
+		default:
+			bytesPerSample	=	1;
+			planes			=	1;
+			break;
+	}
+
+	pthread_mutex_lock(&cCompressMutex);
+	compressOK	=	true;
+	if ((cCompressedImage.valid == false) || (cCompressedImage.frameNumber != (uint32_t)cFramesRead))
+	{
+		pthread_mutex_lock(&cCameraDataMutex);
+		compressOK	=	ImageCompress_Rice(	&cCompressedImage,
+											cCameraDataBuffer,
+											cLastExposure_ROIinfo.currentROIwidth,
+											cLastExposure_ROIinfo.currentROIheight,
+											bytesPerSample,
+											planes,
+											cFramesRead);
+		pthread_mutex_unlock(&cCameraDataMutex);
+	}
+	pthread_mutex_unlock(&cCompressMutex);
+	return(compressOK);
+}
+
+//*****************************************************************************
+//*	imagearray?Compression=rice
+//*	the whole image is sent as one binary block, see imagecompress.h for the format
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Get_ImagearrayCompressed(	TYPE_GetPutRequestData	*reqData,
+															char					*alpacaErrMsg,
+															const char				*compressionString,
+															bool					*binaryDataSent)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+int					bytesWritten;
+unsigned char		*compressedCopy;
+size_t				compressedLen;
+
+	if (strcasecmp(compressionString, "rice") != 0)
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Compression must be rice");
+	}
+	else if ((cImageReady == false) || (cCameraDataBuffer == NULL))
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "No image to get");
+	}
+	else
+	{
+		//*	from now on, compress each frame as it comes in
+		cCompressOnReadout	=	true;
+		cCompressUnusedCnt	=	0;
+		//*	sent from a copy, the state machine can compress the next frame meanwhile
+		compressedCopy	=	NULL;
+		compressedLen	=	0;
+		if (CompressImageData())
+		{
+			pthread_mutex_lock(&cCompressMutex);
+			compressedCopy	=	(unsigned char *)ImagePool_Alloc(cCompressedImage.dataLen);
+			if (compressedCopy != NULL)
+			{
+				memcpy(compressedCopy, cCompressedImage.data, cCompressedImage.dataLen);
+				compressedLen	=	cCompressedImage.dataLen;
+			}
+			pthread_mutex_unlock(&cCompressMutex);
+			if (compressedCopy == NULL)
+			{
+				alpacaErrCode	=	kASCOM_Err_InternalError;
+				GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to allocate memory");
+			}
+		}
+		else
+		{
+			alpacaErrCode	=	kASCOM_Err_InternalError;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to compress image");
+		}
+		if (compressedCopy != NULL)
+		{
+			SendBinaryHttpHeader(reqData->socket, kImageCompress_ContentType, compressedLen);
+			bytesWritten	=	write(reqData->socket, compressedCopy, compressedLen);
+			*binaryDataSent	=	true;
+			if (bytesWritten <= 0)
+			{
+				CONSOLE_DEBUG("Failed to send compressed image");
+			}
+			ImagePool_Release(compressedCopy);
+		}
+	}
+	return(alpacaErrCode);
+}
+
 //*****************************************************************************
 void	CameraDriver::Send_imagearray_rgb24(	const int		socketFD,
 												unsigned char	*pixelPtr,
@@ -3254,6 +3750,75 @@ int				totalValuesWritten;
 }
 
 
+//*****************************************************************************
+bool	CameraDriver::IsRawColorImage(void)
+{
+	return(cIsColorCam &&
+			((cROIinfo.currentROIimageType == kImageType_RAW8) ||
+			(cROIinfo.currentROIimageType == kImageType_RAW16)));
+}
+
+//*****************************************************************************
+//*	returns the current image as 8 bit interleaved color, RGB or BGR order
+//*	this is the one place RAW color data gets debayered, it is only done
+//*	once per frame no matter how many things want the color image
+//*	returns NULL if the current image is not RAW color
+//*	the caller holds cPreviewMutex for as long as it uses the buffer
+//*****************************************************************************
+unsigned char	*CameraDriver::GetDebayeredImage(const bool bgrOrder)
+{
+int		width;
+int		height;
+long	bufferSize;
+bool	debayerOK;
+
+	if ((cCameraDataBuffer == NULL) || (IsRawColorImage() == false))
+	{
+		return(NULL);
+	}
+	if (cDebayerValid && (cDebayerBGR == bgrOrder) && (cDebayerBuffer != NULL))
+	{
+		return(cDebayerBuffer);
+	}
+
+	width	=	cROIinfo.currentROIwidth;
+	height	=	cROIinfo.currentROIheight;
+	if ((width <= 0) || (height <= 0))
+	{
+		width	=	cCameraXsize;
+		height	=	cCameraYsize;
+	}
+	bufferSize	=	(long)width * height * 3;
+	if (cDebayerBufLen < bufferSize)
+	{
+		ImagePool_Release(cDebayerBuffer);
+		cDebayerBuffer	=	(unsigned char *)ImagePool_Alloc(bufferSize);
+		cDebayerBufLen	=	(cDebayerBuffer != NULL) ? bufferSize : 0;
+	}
+	cDebayerValid	=	false;
+	if (cDebayerBuffer != NULL)
+	{
+		SETUP_TIMING();
+		pthread_mutex_lock(&cCameraDataMutex);
+		debayerOK	=	Debayer_Image(	cCameraDataBuffer,
+										width,
+										height,
+										((cROIinfo.currentROIimageType == kImageType_RAW16) ? 2 : 1),
+										cBayerPattern,
+										cDebayerMethod,
+										bgrOrder,
+										cDebayerBuffer);
+		pthread_mutex_unlock(&cCameraDataMutex);
+		DEBUG_TIMING("Time to debayer (ms)	=");
+		if (debayerOK)
+		{
+			cDebayerValid	=	true;
+			cDebayerBGR		=	bgrOrder;
+		}
+	}
+	return(cDebayerValid ? cDebayerBuffer : NULL);
+}
+
 //*****************************************************************************
 //*	this always returns 24 bit pixels, in hex they are 0x00RRGGBB
 //*	if the image is b/w, it converts the pixel to the RGB grey scale equivalent
@@ -3266,11 +3831,17 @@ int					pixelLimit;
 int					iii;
 int					mySocket;
 unsigned char		*pixelPtr;
+unsigned char		*debayerPtr;
+unsigned char		*sourcePtr;
+unsigned char		*imageCopy;
+long				sourceLen;
+TYPE_IMAGE_TYPE		imageType;
 uint32_t			pixelValue;
 char				lineBuff[256];
 char				imageTimeString[256];
 double				exposureTimeSecs;
-TYPE_ASCOM_STATUS	tempSensorErr;
+TYPE_SENSOR_TELEMETRY	telemetry;
+int32_t				telemetryAge_ms;
 //-int					bufLen;
 //-int					bytesWritten;
 //-char				longBuffer[1024];
@@ -3306,16 +3877,21 @@ TYPE_ASCOM_STATUS	tempSensorErr;
 
 	//========================================================================================
 	//*	record the sensor temp
-	tempSensorErr	=	Read_SensorTemp();
-	if (tempSensorErr == kASCOM_Err_Success)
+	telemetryAge_ms	=	GetSensorTelemetry(&telemetry);
+	if (telemetry.ccdTempErr == kASCOM_Err_Success)
 	{
 		JsonResponse_Add_Double(mySocket,
 								reqData->jsonTextBuffer,
 								kBuffSize_MaxSpeed,
 								"ccdtemperature",
-								cCameraTemp_Dbl,
+								telemetry.ccdTemp_degC,
+								INCLUDE_COMMA);
+		JsonResponse_Add_Int32(	mySocket,
+								reqData->jsonTextBuffer,
+								kBuffSize_MaxSpeed,
+								"telemetry-age-ms",
+								telemetryAge_ms,
 								INCLUDE_COMMA);
-
 
 	}
 	//*	get the ROI information which has the current image type
@@ -3376,25 +3952,84 @@ TYPE_ASCOM_STATUS	tempSensorErr;
 		//*	Flush the json buffer
 		JsonResponse_SendTextBuffer(mySocket, reqData->jsonTextBuffer);
 
-		//====================================================================
-		//*	this is broken up the way it is to increase transmission speed
-		iii		=	0;
+		//*	color sensors in RAW mode get debayered, 0x00RRGGBB needs RGB order
+		//*	the data is copied under the mutexes and sent from the copy
+		pthread_mutex_lock(&cPreviewMutex);
+		pthread_mutex_lock(&cCameraDataMutex);
+		sourcePtr	=	cCameraDataBuffer;
+		debayerPtr	=	NULL;
+		if (IsRawColorImage())
+		{
+			debayerPtr	=	GetDebayeredImage(false);
+		}
 		switch(cROIinfo.currentROIimageType)
 		{
-			//====================================================================
-			case kImageType_RGB24:
+			case kImageType_RGB24:	sourceLen	=	pixelCount * 3;	break;
+			case kImageType_RAW16:	sourceLen	=	pixelCount * 2;	break;
+			default:				sourceLen	=	pixelCount;		break;
+		}
+		if (debayerPtr != NULL)
+		{
+			sourcePtr	=	debayerPtr;
+			sourceLen	=	pixelCount * 3;
+		}
+		imageCopy	=	NULL;
+		if ((sourcePtr != NULL) && (sourceLen > 0))
+		{
+			imageCopy	=	(unsigned char *)ImagePool_Alloc(sourceLen);
+			if (imageCopy != NULL)
+			{
+				memcpy(imageCopy, sourcePtr, sourceLen);
+			}
+		}
+		pthread_mutex_unlock(&cCameraDataMutex);
+		pthread_mutex_unlock(&cPreviewMutex);
+		imageType	=	cROIinfo.currentROIimageType;
+		if (imageCopy == NULL)
+		{
+			CONSOLE_DEBUG("Failed to allocate image copy");
+			imageType	=	kImageType_Invalid;
+		}
+		if (debayerPtr != NULL)
+		{
+			debayerPtr	=	imageCopy;
+		}
+		else
+		{
+			pixelPtr	=	imageCopy;
+		}
+
+		//====================================================================
+		//*	this is broken up the way it is to increase transmission speed
+		iii		=	0;
+		switch(imageType)
+		{
+			//====================================================================
+			case kImageType_RGB24:
 				Send_RGBarray_rgb24(mySocket, pixelPtr, pixelCount);
 				break;
 
 			//====================================================================
 			case kImageType_RAW8:
 				CONSOLE_DEBUG("kImageType_RAW8");
-				Send_RGBarray_raw8(mySocket, pixelPtr, pixelCount);
+				if (IsRawColorImage() && (debayerPtr != NULL))
+				{
+					Send_RGBarray_rgb24(mySocket, debayerPtr, pixelCount);
+				}
+				else
+				{
+					Send_RGBarray_raw8(mySocket, pixelPtr, pixelCount);
+				}
 				break;
 
 			//====================================================================
 			case kImageType_RAW16:
 				CONSOLE_DEBUG("kImageType_RAW16");
+				if (IsRawColorImage() && (debayerPtr != NULL))
+				{
+					Send_RGBarray_rgb24(mySocket, debayerPtr, pixelCount);
+					break;
+				}
 				pixelLimit	=	pixelCount - 1;
 				iii	=	0;
 				while (iii < pixelLimit)
@@ -3454,6 +4089,10 @@ TYPE_ASCOM_STATUS	tempSensorErr;
 				break;
 
 		}
+		if (imageCopy != NULL)
+		{
+			ImagePool_Release(imageCopy);
+		}
 
 
 		JsonResponse_Add_ArrayEnd(	mySocket,
@@ -3697,6 +4336,14 @@ char				myRefID[32];
 		if (refIDFound)
 		{
 			GetTelescopeSettingsByRefID(myRefID, 0, &cTS_info);
+			if (strlen(cTS_info.fitsCompression) > 0)
+			{
+				SetFitsCompression(cTS_info.fitsCompression);
+			}
+		#ifdef _ENABLE_FITS_
+			//*	the telescope info is part of the header snapshot
+			InvalidateFitsSnapshot();
+		#endif
 	//		CONSOLE_DEBUG_W_STR("cTS_info.refID\t\t=",		cTS_info.refID);
 	//		CONSOLE_DEBUG_W_STR("cTS_info.manufacturer\t=",	cTS_info.telescp_manufacturer);
 	//		CONSOLE_DEBUG_W_STR("cTS_info.model\t\t=",		cTS_info.telescp_model);
@@ -4111,6 +4758,7 @@ bool			successFlag;
 
 //	CONSOLE_DEBUG(__FUNCTION__);
 
+	pthread_mutex_lock(&cCameraDataMutex);
 	if ((cCameraDataBuffer != NULL) && (bufferSize <= cCameraDataBuffLen))
 	{
 		//*	everything is OK
@@ -4121,9 +4769,11 @@ bool			successFlag;
 	{
 		if (cCameraDataBuffer != NULL)
 		{
-			CONSOLE_DEBUG("Freeing existing buffer");
-			//*	buffer is not big enough, free it so we can allocate a new one
-			free(cCameraDataBuffer);
+			CONSOLE_DEBUG("Releasing existing buffer");
+			//*	buffer is not big enough, give it back to the pool so we can get a bigger one.
+			//*	the frame size went up, the unused smaller buffers are given back to the system
+			ImagePool_Release(cCameraDataBuffer);
+			ImagePool_Trim();
 			cCameraDataBuffer	=	NULL;
 			cCameraDataBuffLen	=	0;
 		}
@@ -4137,7 +4787,7 @@ bool			successFlag;
 			myBufferSize	=	cCameraXsize * cCameraYsize * 4;
 		}
 		CONSOLE_DEBUG_W_NUM("myBufferSize\t=", myBufferSize);
-		cCameraDataBuffer	=	(unsigned char *)malloc(myBufferSize + 128);
+		cCameraDataBuffer	=	(unsigned char *)ImagePool_Alloc(myBufferSize + 128);
 		if (cCameraDataBuffer != NULL)
 		{
 			CONSOLE_DEBUG("cCameraDataBuffer allocated");
@@ -4151,10 +4801,33 @@ bool			successFlag;
 			successFlag			=	false;
 		}
 	}
+	pthread_mutex_unlock(&cCameraDataMutex);
 //	CONSOLE_DEBUG(__FUNCTION__);
 	return(successFlag);
 }
 
+//*****************************************************************************
+//*	copy of the first dataLen bytes of the camera buffer, made under cCameraDataMutex
+//*	so a download never overlaps a readout. The caller releases it with ImagePool_Release()
+//*****************************************************************************
+unsigned char	*CameraDriver::CopyCameraData(const long dataLen)
+{
+unsigned char	*dataCopy;
+
+	dataCopy	=	NULL;
+	pthread_mutex_lock(&cCameraDataMutex);
+	if ((cCameraDataBuffer != NULL) && (dataLen > 0) && (dataLen <= cCameraDataBuffLen))
+	{
+		dataCopy	=	(unsigned char *)ImagePool_Alloc(dataLen);
+		if (dataCopy != NULL)
+		{
+			memcpy(dataCopy, cCameraDataBuffer, dataLen);
+		}
+	}
+	pthread_mutex_unlock(&cCameraDataMutex);
+	return(dataCopy);
+}
+
 
 
 #pragma mark -
@@ -4165,11 +4838,8 @@ TYPE_ASCOM_STATUS	CameraDriver::Put_StartVideo(TYPE_GetPutRequestData *reqData,
 TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_NotImplemented;
 char				recordTimeStr[32];
 bool				recTimeFound;
-#ifdef _USE_OPENCV_
-	int		videoIsColor;
-	int		fourCC;
-	char	filePath[128];
-#endif // _USE_OPENCV_
+char				directIOstr[32];
+bool				directIOfound;
 
 	CONSOLE_DEBUG(__FUNCTION__);
 	if (reqData != NULL)
@@ -4183,6 +4853,15 @@ bool				recTimeFound;
 												"recordtime",
 												recordTimeStr,
 												(sizeof(recordTimeStr) -1));
+
+		directIOfound	=	GetKeyWordArgument(	reqData->contentData,
+												"directio",
+												directIOstr,
+												(sizeof(directIOstr) -1));
+		if (directIOfound)
+		{
+			cVideoUseDirectIO	=	IsTrueFalse(directIOstr);
+		}
 //		CONSOLE_DEBUG_W_NUM("cInternalCameraState\t=", cInternalCameraState);
 
 		switch(cInternalCameraState)
@@ -4191,6 +4870,7 @@ bool				recTimeFound;
 				CONSOLE_DEBUG("kCameraState_Idle");
 				cNumFramesSaved			=	0;		//*	start video
 				cNumVideoFramesSaved	=	0;
+				cVideoFramesDropped		=	0;
 				cFrameRate				=	0;
 
 				if (recTimeFound)
@@ -4206,72 +4886,12 @@ bool				recTimeFound;
 				CONSOLE_DEBUG_W_DBL("cVideoDuration_secs\t=", cVideoDuration_secs);
 				CONSOLE_DEBUG_W_NUM("cNumFramesToSave\t=", cNumFramesToSave);
 
+				//*	Feb  3,	2021	<MLS> Video is now recorded as SER, the file is opened by Start_Video()
+				cAVIfourcc				=	0;
 				alpacaErrCode			=	Start_Video();
-				if (alpacaErrCode == 0)
+				if (alpacaErrCode != kASCOM_Err_Success)
 				{
-			#ifdef _USE_OPENCV_
-					videoIsColor		=	1;
-					GenerateFileNameRoot();
-					strcpy(filePath, kImageDataDir);
-					strcat(filePath, "/");
-					strcat(filePath, cFileNameRoot);
-					strcat(filePath, ".avi");
-
-					//	http://www.fourcc.org/codecs.php
-					switch(cROIinfo.currentROIimageType)
-					{
-						case kImageType_RGB24:
-						//	CV_FOURCC_DEFAULT,
-						//	CV_FOURCC('M', 'J', 'L', 'S'),
-						//	CV_FOURCC('M', 'J', 'P', 'G'),		//*	MJPG -> motion jpeg
-						//	CV_FOURCC('P', 'I', 'M', '1'),		//*	MPEG-1
-						//
-						//	-1,									//*	user selectable dialog box
-						//	fourCC	=	CV_FOURCC('R', 'G', 'B', '2');
-							fourCC	=	CV_FOURCC('M', 'P', '4', '2');		//*	MP42 -> MPEG-4  WORKS!!
-							videoIsColor		=	1;
-							break;
-
-						default:
-							fourCC	=	CV_FOURCC('Y', '8', '0', '0');		//*	writes, but cant be read
-							videoIsColor		=	0;
-							break;
-					}
-				//	fourCC	=	-1;
-					CONSOLE_DEBUG_W_HEX("fourCC\t=", fourCC);
-					cAVIfourcc			=	fourCC;
-					cOpenCV_videoWriter	=	cvCreateVideoWriter(	filePath,
-																	fourCC,
-																	30.0,
-																	cvSize(cCameraXsize, cCameraYsize),
-																	videoIsColor);
-					if (cOpenCV_videoWriter == NULL)
-					{
-						CONSOLE_DEBUG("Failed to create video writer");
-						cInternalCameraState	=	kCameraState_Idle;
-						alpacaErrCode			=	kASCOM_Err_FailedToTakePicture;
-						GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to create video writer (openCv)");
-						exit(0);
-
-					}
-					//=============================================
-					if (cVideoCreateTimeStampFile)
-					{
-						GenerateFileNameRoot();
-						strcpy(filePath, kImageDataDir);
-						strcat(filePath, "/");
-						strcat(filePath, cFileNameRoot);
-						strcat(filePath, ".csv");
-
-						cVideoTimeStampFilePtr	=	fopen(filePath, "w");
-						if (cVideoTimeStampFilePtr != NULL)
-						{
-						//	fprintf(cVideoTimeStampFilePtr, "#Time Stamp File:%s\r\n", filePath);
-						//	fprintf(cVideoTimeStampFilePtr, "#------------------------------------\r\n");
-							fprintf(cVideoTimeStampFilePtr, "#FrameNum,TimeStamp\r\n");
-						}
-					}
-			#endif // _USE_OPENCV_
+					GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, cLastCameraErrMsg);
 				}
 				break;
 
@@ -4291,6 +4911,11 @@ bool				recTimeFound;
 				GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Video exposure in progress");
 				break;
 
+			case kCameraState_ROIstream:
+				alpacaErrCode	=	kASCOM_Err_CameraBusy;
+				GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "ROI stream in progress");
+				break;
+
 			default:
 				break;
 		}
@@ -4613,132 +5238,943 @@ char	lineBuffer[512];
 
 
 #pragma mark -
-#pragma mark Virtual functions
+#pragma mark Live stacking
 //*****************************************************************************
-int	CameraDriver::GetImage_ROI_info(void)
+//*	Action=start|stop|reset
+//*	Mode=mean|sigma		(start only, default mean)
+//*	Kappa=2.5			(sigma clip rejection threshold)
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Put_LiveStack(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
 {
-	memset(&cROIinfo, 0, sizeof(TYPE_IMAGE_ROI_Info));
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+char				actionString[32];
+char				modeString[32];
+char				kappaString[32];
+TYPE_LIVESTACK_MODE	stackMode;
+double				sigmaKappa;
+int					bayerPattern;
+bool				threadOK;
 
-	cROIinfo.currentROIimageType	=	kImageType_RAW8;
-	cROIinfo.currentROIwidth		=	cCameraXsize;
-	cROIinfo.currentROIheight		=	cCameraYsize;
-	cROIinfo.currentROIbin			=	1;
-	return(-1);
+	CONSOLE_DEBUG(__FUNCTION__);
+	if (GetKeyWordArgument(reqData->contentData, "Action", actionString, (sizeof(actionString) -1)))
+	{
+		if (strcasecmp(actionString, "start") == 0)
+		{
+			stackMode	=	kLiveStack_Mean;
+			if (GetKeyWordArgument(reqData->contentData, "Mode", modeString, (sizeof(modeString) -1)))
+			{
+				if (strncasecmp(modeString, "sigma", 5) == 0)
+				{
+					stackMode	=	kLiveStack_SigmaClip;
+				}
+			}
+			sigmaKappa	=	2.5;
+			if (GetKeyWordArgument(reqData->contentData, "Kappa", kappaString, (sizeof(kappaString) -1)))
+			{
+				sigmaKappa	=	atof(kappaString);
+			}
+			if (sigmaKappa < 1.0)
+			{
+				sigmaKappa	=	1.0;
+			}
+
+			//*	raw data from a color sensor is debayered by the stacking thread
+			bayerPattern	=	kLiveStack_NoBayer;
+			if (cIsColorCam &&
+				((cROIinfo.currentROIimageType == kImageType_RAW8) ||
+				(cROIinfo.currentROIimageType == kImageType_RAW16)))
+			{
+				bayerPattern	=	cBayerPattern;
+			}
+
+			//*	restart it if it is already running, the settings may have changed
+			LiveStack_Stop(&cLiveStack);
+			threadOK	=	LiveStack_Start(&cLiveStack,
+											stackMode,
+											sigmaKappa,
+											bayerPattern,
+											kImageDataDir "/livestack.jpg");
+			if (threadOK == false)
+			{
+				alpacaErrCode	=	kASCOM_Err_FailedUnknown;
+				GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to start live stack thread");
+			}
+		}
+		else if (strcasecmp(actionString, "stop") == 0)
+		{
+			LiveStack_Stop(&cLiveStack);
+		}
+		else if (strcasecmp(actionString, "reset") == 0)
+		{
+			LiveStack_Reset(&cLiveStack);
+		}
+		else
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Action must be start, stop or reset");
+		}
+	}
+	else
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "'Action' argument not found");
+	}
+	return(alpacaErrCode);
 }
 
 //*****************************************************************************
-TYPE_ASCOM_STATUS	CameraDriver::SetImageTypeCameraOpen(TYPE_IMAGE_TYPE newImageType)
+TYPE_ASCOM_STATUS	CameraDriver::Get_LiveStack(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
 {
-TYPE_ASCOM_STATUS		alpacaErrCode	=	kASCOM_Err_NotImplemented;
+int		mySocket;
 
-//	CONSOLE_DEBUG(__FUNCTION__);
+	mySocket	=	reqData->socket;
 
-	strcpy(cLastCameraErrMsg, "AlpacaPi: Not implemented-");
-	strcat(cLastCameraErrMsg, __FILE__);
-	strcat(cLastCameraErrMsg, ":");
-	strcat(cLastCameraErrMsg, __FUNCTION__);
-	return(alpacaErrCode);
+	JsonResponse_Add_Bool(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"livestack-active",			cLiveStack.threadActive,			INCLUDE_COMMA);
+	JsonResponse_Add_String(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"livestack-mode",
+								((cLiveStack.stackMode == kLiveStack_SigmaClip) ? "sigma" : "mean"),
+								INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"livestack-kappa",			cLiveStack.sigmaKappa,				INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"livestack-offered",		cLiveStack.framesOffered,			INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"livestack-stacked",		cLiveStack.framesStacked,			INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"livestack-rejected",		cLiveStack.framesRejected,			INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"livestack-skipped",		cLiveStack.framesSkipped,			INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"livestack-stars",			cLiveStack.lastStarCnt,				INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"livestack-offsetX",		cLiveStack.lastOffsetX,				INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"livestack-offsetY",		cLiveStack.lastOffsetY,				INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"livestack-stacktime-ms",	cLiveStack.lastStackTime_ms,		INCLUDE_COMMA);
+	if (cLiveStack.jpegWritten)
+	{
+		JsonResponse_Add_String(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+									"livestack-jpeg",		cLiveStack.jpegFilePath,			INCLUDE_COMMA);
+	}
+	return(kASCOM_Err_Success);
 }
 
-
 //*****************************************************************************
-TYPE_ASCOM_STATUS	CameraDriver::Write_Gain(const int newGainValue)
+//*	Action=enable|disable|capture|stop|rescan
+//*	capture also takes Type=bias|dark|flat, the frames that follow are averaged into
+//*	the master for the current camera settings until stop is sent
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Put_Calibration(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
 {
-TYPE_ASCOM_STATUS		alpacaErrCode	=	kASCOM_Err_NotImplemented;
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+char				actionString[32];
+char				typeString[32];
+TYPE_CALIB_KEY		captureKey;
+TYPE_CALIB_TYPE		calibType;
 
-//	CONSOLE_DEBUG(__FUNCTION__);
+	if (GetKeyWordArgument(reqData->contentData, "Action", actionString, (sizeof(actionString) -1)))
+	{
+		if (strcasecmp(actionString, "enable") == 0)
+		{
+			cCalibrationEnabled	=	true;
+		}
+		else if (strcasecmp(actionString, "disable") == 0)
+		{
+			cCalibrationEnabled	=	false;
+		}
+		else if (strcasecmp(actionString, "capture") == 0)
+		{
+			if (GetKeyWordArgument(reqData->contentData, "Type", typeString, (sizeof(typeString) -1)))
+			{
+				calibType	=	kCalib_last;
+				if (strcasecmp(typeString, "bias") == 0)
+				{
+					calibType	=	kCalib_Bias;
+				}
+				else if (strcasecmp(typeString, "dark") == 0)
+				{
+					calibType	=	kCalib_Dark;
+				}
+				else if (strcasecmp(typeString, "flat") == 0)
+				{
+					calibType	=	kCalib_Flat;
+				}
 
-	strcpy(cLastCameraErrMsg, "AlpacaPi: Not implemented-");
-	strcat(cLastCameraErrMsg, __FILE__);
-	strcat(cLastCameraErrMsg, ":");
-	strcat(cLastCameraErrMsg, __FUNCTION__);
+				if (calibType != kCalib_last)
+				{
+					BuildCalibrationKey(&captureKey, calibType);
+					if (Calib_StartCapture(&cCalibLibrary, &captureKey) == false)
+					{
+						alpacaErrCode	=	kASCOM_Err_InternalError;
+						GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to start calibration capture");
+					}
+				}
+				else
+				{
+					alpacaErrCode	=	kASCOM_Err_InvalidValue;
+					GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Type must be bias, dark or flat");
+				}
+			}
+			else
+			{
+				alpacaErrCode	=	kASCOM_Err_InvalidValue;
+				GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "'Type' argument not found");
+			}
+		}
+		else if (strcasecmp(actionString, "stop") == 0)
+		{
+			Calib_StopCapture(&cCalibLibrary);
+		}
+		else if (strcasecmp(actionString, "rescan") == 0)
+		{
+			Calib_ScanLibrary(&cCalibLibrary);
+		}
+		else
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Action must be enable, disable, capture, stop or rescan");
+		}
+	}
+	else
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "'Action' argument not found");
+	}
 	return(alpacaErrCode);
 }
 
 //*****************************************************************************
-TYPE_ASCOM_STATUS	CameraDriver::Read_Gain(int *cameraGainValue)
+TYPE_ASCOM_STATUS	CameraDriver::Get_Calibration(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
 {
-TYPE_ASCOM_STATUS		alpacaErrCode	=	kASCOM_Err_NotImplemented;
+int			mySocket;
+int			entryIdx;
+const char	*darkFileName;
+const char	*flatFileName;
 
-//	CONSOLE_DEBUG(__FUNCTION__);
+	mySocket	=	reqData->socket;
 
-	strcpy(cLastCameraErrMsg, "AlpacaPi: Not implemented-");
-	strcat(cLastCameraErrMsg, __FILE__);
-	strcat(cLastCameraErrMsg, ":");
-	strcat(cLastCameraErrMsg, __FUNCTION__);
-	return(alpacaErrCode);
+	entryIdx		=	cCalibLibrary.darkMaster.entryIdx;
+	darkFileName	=	(entryIdx >= 0) ? cCalibLibrary.entries[entryIdx].fileName : "none";
+	entryIdx		=	cCalibLibrary.flatMaster.entryIdx;
+	flatFileName	=	(entryIdx >= 0) ? cCalibLibrary.entries[entryIdx].fileName : "none";
+
+	JsonResponse_Add_Bool(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"calibration-enabled",		cCalibrationEnabled,					INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"calibration-masters",		cCalibLibrary.entryCnt,				INCLUDE_COMMA);
+	JsonResponse_Add_String(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"calibration-dark",			darkFileName,						INCLUDE_COMMA);
+	JsonResponse_Add_String(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"calibration-flat",			flatFileName,						INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"calibration-hotpixels",	cCalibLibrary.hotPixelCnt,			INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"calibration-frames",		cCalibLibrary.framesCalibrated,		INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"calibration-applytime-us",	cCalibLibrary.lastApplyTime_us,		INCLUDE_COMMA);
+	JsonResponse_Add_Bool(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"calibration-capturing",	cCalibLibrary.captureActive,		INCLUDE_COMMA);
+	if (cCalibLibrary.captureActive)
+	{
+		JsonResponse_Add_String(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+									"calibration-capturetype",
+									Calib_GetTypeName(cCalibLibrary.captureKey.calibType),
+									INCLUDE_COMMA);
+		JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+									"calibration-capturecount",	cCalibLibrary.captureCount,		INCLUDE_COMMA);
+	}
+	return(kASCOM_Err_Success);
 }
 
 //*****************************************************************************
-static TYPE_IMAGE_TYPE	GetInternalImageType(const char *imageTypeString)
+//*	Action=enable|disable, enable runs the star detector on every frame
+//*	Sigma=n sets the detection threshold (noise above the background)
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Put_Stars(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
 {
-TYPE_IMAGE_TYPE	myImageType;
-
-//	CONSOLE_DEBUG_W_STR("imageTypeString:", imageTypeString);
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+char				argumentString[32];
+bool				foundArgument;
+double				newSigma;
 
-	if (strcasecmp(imageTypeString, "RAW8") == 0)
-	{
-		myImageType	=	kImageType_RAW8;
-	}
-	else if (strcasecmp(imageTypeString, "RAW16") == 0)
+	foundArgument	=	false;
+	if (GetKeyWordArgument(reqData->contentData, "Sigma", argumentString, (sizeof(argumentString) -1)))
 	{
-		myImageType	=	kImageType_RAW16;
-	}
-	else if (strcasecmp(imageTypeString, "RGB24") == 0)
-	{
-		myImageType	=	kImageType_RGB24;
+		foundArgument	=	true;
+		newSigma		=	atof(argumentString);
+		if ((newSigma >= 1.0) && (newSigma <= 100.0))
+		{
+			cStarDetectSigma	=	newSigma;
+		}
+		else
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Sigma must be between 1 and 100");
+		}
 	}
-	else if (strcasecmp(imageTypeString, "Y8") == 0)
+	if (GetKeyWordArgument(reqData->contentData, "Action", argumentString, (sizeof(argumentString) -1)))
 	{
-		myImageType	=	kImageType_Y8;
+		foundArgument	=	true;
+		if (strcasecmp(argumentString, "enable") == 0)
+		{
+			cStarDetectEnabled	=	true;
+		}
+		else if (strcasecmp(argumentString, "disable") == 0)
+		{
+			cStarDetectEnabled	=	false;
+		}
+		else
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Action must be enable or disable");
+		}
 	}
-	else
+	if (foundArgument == false)
 	{
-		myImageType	=	kImageType_Invalid;
-		CONSOLE_DEBUG_W_STR("Unsupported image type:", imageTypeString);
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "'Action' or 'Sigma' argument not found");
 	}
-	CONSOLE_DEBUG_W_NUM("myImageType:", myImageType);
-
-	return(myImageType);
+	return(alpacaErrCode);
 }
 
-
 //*****************************************************************************
-//*	this routine takes an index and image type string and sets it up in the array
-//*	The array has the corresponding internal enum for that image type
-//*
-//*	Each sub class must call this for each supported image type so that the alpaca
-//*	image type commands work
+//*	reports the last analysis done by the state machine, the detector is not run
+//*	here because it would race the state machine on the same buffers
+//*	MaxStars=n limits the star list (default 50), the summary is always sent
 //*****************************************************************************
-void	CameraDriver::SetImageTypeIndex(const int alpacaImgTypeIdx, const char *imageTypeString)
+TYPE_ASCOM_STATUS	CameraDriver::Get_Stars(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
 {
-//	CONSOLE_DEBUG(__FUNCTION__);
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+int					mySocket;
+char				argumentString[32];
+char				lineBuff[256];
+int					maxStars;
+int					ii;
+TYPE_STAR_ANALYSIS	*starAnalysis;
 
-	if ((alpacaImgTypeIdx >=0) && (alpacaImgTypeIdx < kMaxImageTypes))
-	{
-		strcpy(cSupportedImageTypes[alpacaImgTypeIdx].imageTypeString, imageTypeString);
-		cSupportedImageTypes[alpacaImgTypeIdx].internalImgageType	=	GetInternalImageType(imageTypeString);
-		cSupportedImageTypes[alpacaImgTypeIdx].isValid				=	true;
+	mySocket	=	reqData->socket;
 
-		CONSOLE_DEBUG_W_NUM("alpacaImgTypeIdx\t=",	alpacaImgTypeIdx);
-		CONSOLE_DEBUG_W_NUM("internal\t=",			cSupportedImageTypes[alpacaImgTypeIdx].internalImgageType);
-		CONSOLE_DEBUG_W_STR("name\t\t=",			cSupportedImageTypes[alpacaImgTypeIdx].imageTypeString);
-	}
-	else
+	starAnalysis	=	(TYPE_STAR_ANALYSIS *)malloc(sizeof(TYPE_STAR_ANALYSIS));
+	if (starAnalysis == NULL)
 	{
-		CONSOLE_DEBUG_W_NUM("alpacaImgTypeIdx is out of bounds\t=",	alpacaImgTypeIdx);
-		exit(0);
+		alpacaErrCode	=	kASCOM_Err_FailedUnknown;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to allocate memory");
+		return(alpacaErrCode);
 	}
+	pthread_mutex_lock(&cStarMutex);
+	memcpy(starAnalysis, &cStarAnalysis, sizeof(TYPE_STAR_ANALYSIS));
+	pthread_mutex_unlock(&cStarMutex);
+
+	if (starAnalysis->valid == false)
+	{
+		free(starAnalysis);
+		alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "No star analysis, enable it with Action=enable");
+		return(alpacaErrCode);
+	}
+	maxStars	=	50;
+	if (GetKeyWordArgument(reqData->contentData, "MaxStars", argumentString, (sizeof(argumentString) -1)))
+	{
+		maxStars	=	atoi(argumentString);
+	}
+	if ((maxStars < 0) || (maxStars > starAnalysis->starCnt))
+	{
+		maxStars	=	starAnalysis->starCnt;
+	}
+
+	JsonResponse_Add_Bool(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"stars-enabled",		cStarDetectEnabled,					INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"stars-frame",			starAnalysis->frameNumber,			INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"stars-sigma",			starAnalysis->threshold_sigma,		INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"stars-background",		starAnalysis->background,			INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"stars-noise",			starAnalysis->noise,				INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"stars-components",		starAnalysis->componentCnt,			INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"stars-count",			starAnalysis->starCnt,				INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"stars-hfr",			starAnalysis->medianHFR,			INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"stars-fwhm",			starAnalysis->medianFWHM,			INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"stars-eccentricity",	starAnalysis->medianEccentricity,	INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"stars-time-us",		starAnalysis->analysisTime_us,		INCLUDE_COMMA);
+
+	JsonResponse_Add_ArrayStart(mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,	"stars");
+	for (ii=0; ii<maxStars; ii++)
+	{
+		sprintf(lineBuff,	"%s{\"x\":%1.2f,\"y\":%1.2f,\"hfr\":%1.2f,\"fwhm\":%1.2f,\"ecc\":%1.3f,"
+							"\"flux\":%1.0f,\"peak\":%u,\"pixels\":%d}",
+							((ii > 0) ? "," : ""),
+							starAnalysis->stars[ii].xCenter,
+							starAnalysis->stars[ii].yCenter,
+							starAnalysis->stars[ii].hfr,
+							starAnalysis->stars[ii].fwhm,
+							starAnalysis->stars[ii].eccentricity,
+							starAnalysis->stars[ii].flux,
+							starAnalysis->stars[ii].peakValue,
+							starAnalysis->stars[ii].pixelCnt);
+		JsonResponse_Add_RawText(mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,	lineBuff);
+	}
+	JsonResponse_Add_ArrayEnd(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,	INCLUDE_COMMA);
+	free(starAnalysis);
+	return(alpacaErrCode);
 }
 
 //*****************************************************************************
-//*	Translate Alpaca image index to internal image type index (TYPE_IMAGE_TYPE)
+//*	Format=json (default) or csv
+//*	json has the percentile summary for each stage and the last n frames (Frames=n, default 20)
+//*	csv has one line per frame for the whole history window
+//*	all times are micro seconds, stages that did not run are 0 (-1 in the json frame list)
 //*****************************************************************************
-TYPE_IMAGE_TYPE	CameraDriver::XlateAlpacaImgIdxToIntImgType(const int alpacaImgTypeIdx)
+TYPE_ASCOM_STATUS	CameraDriver::Get_FrameTiming(	TYPE_GetPutRequestData	*reqData,
+													char					*alpacaErrMsg,
+													bool					*httpHeaderSent,
+													bool					*binaryDataSent)
 {
-TYPE_IMAGE_TYPE	internalImgType;
+TYPE_ASCOM_STATUS		alpacaErrCode	=	kASCOM_Err_Success;
+int						mySocket;
+char					argumentString[32];
+char					lineBuff[256];
+char					valueBuff[32];
+TYPE_FRAME_STAGE_STATS	stageStats[kFrameStage_last];
+TYPE_FRAME_TIMELINE		*timeLines;
+int						frameCnt;
+int						maxFrames;
+int						firstFrame;
+int						stage;
+int						ii;
+char					*csvBuffer;
+long					csvLen;
+int						bytesWritten;
+
+	mySocket	=	reqData->socket;
+	timeLines	=	(TYPE_FRAME_TIMELINE *)malloc(kFrameTiming_HistoryLen * sizeof(TYPE_FRAME_TIMELINE));
+	if (timeLines == NULL)
+	{
+		alpacaErrCode	=	kASCOM_Err_InternalError;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to allocate memory");
+		return(alpacaErrCode);
+	}
+	frameCnt	=	FrameTiming_GetHistory(&cFrameTiming, timeLines, kFrameTiming_HistoryLen);
+
+	strcpy(argumentString, "json");
+	GetKeyWordArgument(reqData->contentData, "Format", argumentString, (sizeof(argumentString) -1));
+	if (strcasecmp(argumentString, "csv") == 0)
+	{
+		//*	header + one line per frame, each value is at most 11 chars
+		csvBuffer	=	(char *)malloc((frameCnt + 1) * (kFrameStage_last + 3) * 12);
+		if (csvBuffer != NULL)
+		{
+			strcpy(csvBuffer, "frame,start_us,requested_us");
+			for (stage=0; stage<kFrameStage_last; stage++)
+			{
+				strcat(csvBuffer, ",");
+				strcat(csvBuffer, FrameTiming_GetStageName((TYPE_FRAME_STAGE)stage));
+			}
+			strcat(csvBuffer, "\n");
+			csvLen	=	strlen(csvBuffer);
+			for (ii=0; ii<frameCnt; ii++)
+			{
+				csvLen	+=	sprintf(&csvBuffer[csvLen],	"%u,%llu,%d",
+														timeLines[ii].frameNumber,
+														(unsigned long long)timeLines[ii].stageStart_us[kFrameStage_Exposure],
+														timeLines[ii].exposureRequested_us);
+				for (stage=0; stage<kFrameStage_last; stage++)
+				{
+					csvLen	+=	sprintf(&csvBuffer[csvLen], ",%u", FrameTiming_StageDuration(&timeLines[ii], (TYPE_FRAME_STAGE)stage));
+				}
+				csvBuffer[csvLen++]	=	'\n';
+			}
+			SendBinaryHttpHeader(mySocket, "text/csv", csvLen);
+			bytesWritten	=	write(mySocket, csvBuffer, csvLen);
+			if (bytesWritten <= 0)
+			{
+				CONSOLE_DEBUG("Failed to send csv data");
+			}
+			*binaryDataSent	=	true;
+			free(csvBuffer);
+		}
+		else
+		{
+			alpacaErrCode	=	kASCOM_Err_InternalError;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to allocate memory");
+		}
+	}
+	else
+	{
+		maxFrames	=	20;
+		if (GetKeyWordArgument(reqData->contentData, "Frames", argumentString, (sizeof(argumentString) -1)))
+		{
+			maxFrames	=	atoi(argumentString);
+		}
+		if ((maxFrames < 0) || (maxFrames > frameCnt))
+		{
+			maxFrames	=	frameCnt;
+		}
+		firstFrame	=	frameCnt - maxFrames;
+
+		FrameTiming_ComputeStats(&cFrameTiming, stageStats);
+		JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+									"frametiming-frames",		frameCnt,						INCLUDE_COMMA);
+
+		JsonResponse_Add_ArrayStart(mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,	"frametiming-stats");
+		for (stage=0; stage<kFrameStage_last; stage++)
+		{
+			sprintf(lineBuff,	"%s{\"stage\":\"%s\",\"count\":%u,\"min\":%u,\"p50\":%u,"
+								"\"p90\":%u,\"p99\":%u,\"max\":%u,\"mean\":%1.0f}",
+								((stage > 0) ? "," : ""),
+								FrameTiming_GetStageName((TYPE_FRAME_STAGE)stage),
+								stageStats[stage].count,
+								stageStats[stage].min_us,
+								stageStats[stage].p50_us,
+								stageStats[stage].p90_us,
+								stageStats[stage].p99_us,
+								stageStats[stage].max_us,
+								stageStats[stage].mean_us);
+			JsonResponse_Add_RawText(mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,	lineBuff);
+		}
+		JsonResponse_Add_ArrayEnd(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,	INCLUDE_COMMA);
+
+		JsonResponse_Add_ArrayStart(mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,	"frametiming-list");
+		for (ii=firstFrame; ii<frameCnt; ii++)
+		{
+			sprintf(lineBuff,	"%s{\"frame\":%u,\"start\":%llu,\"requested\":%d",
+								((ii > firstFrame) ? "," : ""),
+								timeLines[ii].frameNumber,
+								(unsigned long long)timeLines[ii].stageStart_us[kFrameStage_Exposure],
+								timeLines[ii].exposureRequested_us);
+			for (stage=0; stage<kFrameStage_last; stage++)
+			{
+				if (timeLines[ii].stageStart_us[stage] != 0)
+				{
+					sprintf(valueBuff, ",\"%s\":%u",	FrameTiming_GetStageName((TYPE_FRAME_STAGE)stage),
+														FrameTiming_StageDuration(&timeLines[ii], (TYPE_FRAME_STAGE)stage));
+				}
+				else
+				{
+					sprintf(valueBuff, ",\"%s\":-1",	FrameTiming_GetStageName((TYPE_FRAME_STAGE)stage));
+				}
+				strcat(lineBuff, valueBuff);
+			}
+			strcat(lineBuff, "}");
+			JsonResponse_Add_RawText(mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,	lineBuff);
+		}
+		JsonResponse_Add_ArrayEnd(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,	INCLUDE_COMMA);
+	}
+	free(timeLines);
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+//*	Action=reset clears the history window, useful before a regression run
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Put_FrameTiming(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+char				argumentString[32];
+
+	if (GetKeyWordArgument(reqData->contentData, "Action", argumentString, (sizeof(argumentString) -1)))
+	{
+		if (strcasecmp(argumentString, "reset") == 0)
+		{
+			FrameTiming_Reset(&cFrameTiming);
+		}
+		else
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Action must be reset");
+		}
+	}
+	else
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "'Action' argument not found");
+	}
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+//*	sends the current stack as ImageBytes (ASCOM Alpaca binary image format)
+//*	element type is double, transmitted as single precision float
+//*	the data order is the same as imagearray, X is the outer loop
+//*	the stack is copied (already in transmission order) under stackMutex,
+//*	the socket writes are done without it so a slow client cannot stall stacking
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Get_LiveStackImage(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+long				dataLen;
+long				dataIdx;
+long				bytesSent;
+int					width;
+int					height;
+int					planes;
+int					xxx;
+int					yyy;
+int					ppp;
+float				*stackCopy;
+int					bytesWritten;
+
+	if (cLiveStack.threadActive == false)
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Live stacking is not running");
+		return(alpacaErrCode);
+	}
+
+	stackCopy	=	NULL;
+	dataLen		=	0;
+	pthread_mutex_lock(&cLiveStack.stackMutex);
+	width	=	cLiveStack.width;
+	height	=	cLiveStack.height;
+	planes	=	cLiveStack.planes;
+	if ((cLiveStack.meanBuffer != NULL) && (cLiveStack.framesStacked > 0))
+	{
+		dataLen		=	(long)width * height * planes * sizeof(float);
+		stackCopy	=	(float *)malloc(dataLen);
+		if (stackCopy != NULL)
+		{
+			dataIdx	=	0;
+			for (xxx=0; xxx < width; xxx++)
+			{
+				for (yyy=0; yyy<height; yyy++)
+				{
+					for (ppp=0; ppp<planes; ppp++)
+					{
+						stackCopy[dataIdx++]	=	cLiveStack.meanBuffer[(((long)yyy * width) + xxx) * planes + ppp];
+					}
+				}
+			}
+		}
+		else
+		{
+			alpacaErrCode	=	kASCOM_Err_InternalError;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to allocate memory");
+		}
+	}
+	else
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "No frames have been stacked yet");
+	}
+	pthread_mutex_unlock(&cLiveStack.stackMutex);
+
+	if (stackCopy != NULL)
+	{
+		SendImageBytesHeader(	reqData->socket,
+								3,			//*	ImageElementType, Double
+								4,			//*	TransmissionElementType, Single
+								width,
+								height,
+								planes,
+								dataLen);
+		bytesSent	=	0;
+		while (bytesSent < dataLen)
+		{
+			bytesWritten	=	write(reqData->socket, ((char *)stackCopy) + bytesSent, (dataLen - bytesSent));
+			if (bytesWritten <= 0)
+			{
+				break;
+			}
+			bytesSent	+=	bytesWritten;
+		}
+		free(stackCopy);
+	}
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+void	CameraDriver::SendBinaryHttpHeader(const int socketFD, const char *contentType, const long contentLength)
+{
+char	httpHeader[256];
+char	lineBuff[64];
+int		bytesWritten;
+
+	httpHeader[0]	=	0;
+	strcat(httpHeader,	"HTTP/1.0 200 200 OK\r\n");
+	sprintf(lineBuff,	"Content-Length: %ld\r\n", contentLength);
+	strcat(httpHeader,	lineBuff);
+	sprintf(lineBuff,	"Content-type: %s\r\n", contentType);
+	strcat(httpHeader,	lineBuff);
+	strcat(httpHeader,	"Server: AlpacaPi\r\n");
+	strcat(httpHeader,	"\r\n");
+	bytesWritten	=	write(socketFD, httpHeader, strlen(httpHeader));
+	if (bytesWritten <= 0)
+	{
+		CONSOLE_DEBUG("Failed to send http header");
+	}
+}
+
+//*****************************************************************************
+//*	ASCOM Alpaca ImageBytes, the 44 byte metadata block goes first,
+//*	the data follows with X as the outer loop (same as imagearray)
+//*	element types:	2 = Int32, 3 = Double, 4 = Single, 6 = Byte, 8 = UInt16
+//*****************************************************************************
+void	CameraDriver::SendImageBytesHeader(	const int	socketFD,
+											const int	imageElementType,
+											const int	transmissionElementType,
+											const int	width,
+											const int	height,
+											const int	planes,
+											const long	dataLength)
+{
+int32_t		imageBytesHdr[11];
+int			bytesWritten;
+
+	imageBytesHdr[0]	=	1;							//*	MetadataVersion
+	imageBytesHdr[1]	=	kASCOM_Err_Success;			//*	ErrorNumber
+	imageBytesHdr[2]	=	gClientTransactionID;
+	imageBytesHdr[3]	=	gServerTransactionID;
+	imageBytesHdr[4]	=	sizeof(imageBytesHdr);		//*	DataStart
+	imageBytesHdr[5]	=	imageElementType;
+	imageBytesHdr[6]	=	transmissionElementType;
+	imageBytesHdr[7]	=	(planes > 1) ? 3 : 2;		//*	Rank
+	imageBytesHdr[8]	=	width;
+	imageBytesHdr[9]	=	height;
+	imageBytesHdr[10]	=	(planes > 1) ? planes : 0;
+
+	SendBinaryHttpHeader(socketFD, "application/imagebytes", (sizeof(imageBytesHdr) + dataLength));
+	bytesWritten	=	write(socketFD, imageBytesHdr, sizeof(imageBytesHdr));
+	if (bytesWritten <= 0)
+	{
+		CONSOLE_DEBUG("Failed to send ImageBytes header");
+	}
+}
+
+//*****************************************************************************
+//*	hands the frame that was just read to the stacking thread (copy only)
+//*****************************************************************************
+void	CameraDriver::OfferFrameToLiveStack(void)
+{
+int		width;
+int		height;
+int		bytesPerPixel;
+int		planes;
+
+	width	=	cROIinfo.currentROIwidth;
+	height	=	cROIinfo.currentROIheight;
+	if ((width <= 0) || (height <= 0))
+	{
+		width	=	cCameraXsize;
+		height	=	cCameraYsize;
+	}
+	bytesPerPixel	=	1;
+	planes			=	1;
+	switch(cROIinfo.currentROIimageType)
+	{
+		case kImageType_RAW16:
+			bytesPerPixel	=	2;
+			break;
+
+		case kImageType_RGB24:
+			planes			=	3;
+			break;
+
+		default:
+			break;
+	}
+	LiveStack_AddFrame(&cLiveStack, cCameraDataBuffer, width, height, bytesPerPixel, planes);
+}
+
+//*****************************************************************************
+//*	the current camera settings, used to match masters and to label new ones
+//*****************************************************************************
+void	CameraDriver::BuildCalibrationKey(TYPE_CALIB_KEY *calibKey, TYPE_CALIB_TYPE calibType)
+{
+	memset(calibKey, 0, sizeof(TYPE_CALIB_KEY));
+	calibKey->calibType		=	calibType;
+	calibKey->exposure_us	=	cCurrentExposure_us;
+	calibKey->gain			=	cGain;
+	calibKey->temperature	=	cCameraTemp_Dbl;
+	calibKey->binning		=	cCurrentBinX;
+	calibKey->width			=	cROIinfo.currentROIwidth;
+	calibKey->height		=	cROIinfo.currentROIheight;
+	if ((calibKey->width <= 0) || (calibKey->height <= 0))
+	{
+		calibKey->width		=	cCameraXsize;
+		calibKey->height	=	cCameraYsize;
+	}
+#ifdef _ENABLE_FILTERWHEEL_
+	strcpy(calibKey->filterName, cFilterWheelCurrName);
+#endif
+}
+
+//*****************************************************************************
+//*	called right after the image data has been read from the camera
+//*	only RAW data is calibrated, the masters are per pixel of the sensor
+//*****************************************************************************
+void	CameraDriver::ApplyCalibration(void)
+{
+TYPE_CALIB_KEY	lightKey;
+int				bytesPerPixel;
+
+	if ((cCameraDataBuffer == NULL) ||
+		((cROIinfo.currentROIimageType != kImageType_RAW8) &&
+		(cROIinfo.currentROIimageType != kImageType_RAW16)))
+	{
+		return;
+	}
+	bytesPerPixel	=	(cROIinfo.currentROIimageType == kImageType_RAW16) ? 2 : 1;
+	BuildCalibrationKey(&lightKey, kCalib_last);
+
+	//*	calibration is done in place, a download must not see half of it
+	pthread_mutex_lock(&cCameraDataMutex);
+	if (cCalibLibrary.captureActive)
+	{
+		//*	this is a calibration frame, it goes into the master, not through it
+		Calib_AddCaptureFrame(&cCalibLibrary, cCameraDataBuffer, lightKey.width, lightKey.height, bytesPerPixel);
+	}
+	else if (cCalibrationEnabled)
+	{
+		if (Calib_SelectMasters(&cCalibLibrary, &lightKey))
+		{
+			Calib_ApplyFrame(	&cCalibLibrary,
+								cCameraDataBuffer,
+								lightKey.width,
+								lightKey.height,
+								bytesPerPixel,
+								cIsColorCam);
+		}
+	}
+	pthread_mutex_unlock(&cCameraDataMutex);
+}
+
+
+#pragma mark -
+#pragma mark Virtual functions
+//*****************************************************************************
+int	CameraDriver::GetImage_ROI_info(void)
+{
+	memset(&cROIinfo, 0, sizeof(TYPE_IMAGE_ROI_Info));
+
+	cROIinfo.currentROIimageType	=	kImageType_RAW8;
+	cROIinfo.currentROIwidth		=	cCameraXsize;
+	cROIinfo.currentROIheight		=	cCameraYsize;
+	cROIinfo.currentROIbin			=	1;
+	return(-1);
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::SetImageTypeCameraOpen(TYPE_IMAGE_TYPE newImageType)
+{
+TYPE_ASCOM_STATUS		alpacaErrCode	=	kASCOM_Err_NotImplemented;
+
+//	CONSOLE_DEBUG(__FUNCTION__);
+
+	strcpy(cLastCameraErrMsg, "AlpacaPi: Not implemented-");
+	strcat(cLastCameraErrMsg, __FILE__);
+	strcat(cLastCameraErrMsg, ":");
+	strcat(cLastCameraErrMsg, __FUNCTION__);
+	return(alpacaErrCode);
+}
+
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Write_Gain(const int newGainValue)
+{
+TYPE_ASCOM_STATUS		alpacaErrCode	=	kASCOM_Err_NotImplemented;
+
+//	CONSOLE_DEBUG(__FUNCTION__);
+
+	strcpy(cLastCameraErrMsg, "AlpacaPi: Not implemented-");
+	strcat(cLastCameraErrMsg, __FILE__);
+	strcat(cLastCameraErrMsg, ":");
+	strcat(cLastCameraErrMsg, __FUNCTION__);
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Read_Gain(int *cameraGainValue)
+{
+TYPE_ASCOM_STATUS		alpacaErrCode	=	kASCOM_Err_NotImplemented;
+
+//	CONSOLE_DEBUG(__FUNCTION__);
+
+	strcpy(cLastCameraErrMsg, "AlpacaPi: Not implemented-");
+	strcat(cLastCameraErrMsg, __FILE__);
+	strcat(cLastCameraErrMsg, ":");
+	strcat(cLastCameraErrMsg, __FUNCTION__);
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+static TYPE_IMAGE_TYPE	GetInternalImageType(const char *imageTypeString)
+{
+TYPE_IMAGE_TYPE	myImageType;
+
+//	CONSOLE_DEBUG_W_STR("imageTypeString:", imageTypeString);
+
+	if (strcasecmp(imageTypeString, "RAW8") == 0)
+	{
+		myImageType	=	kImageType_RAW8;
+	}
+	else if (strcasecmp(imageTypeString, "RAW16") == 0)
+	{
+		myImageType	=	kImageType_RAW16;
+	}
+	else if (strcasecmp(imageTypeString, "RGB24") == 0)
+	{
+		myImageType	=	kImageType_RGB24;
+	}
+	else if (strcasecmp(imageTypeString, "Y8") == 0)
+	{
+		myImageType	=	kImageType_Y8;
+	}
+	else
+	{
+		myImageType	=	kImageType_Invalid;
+		CONSOLE_DEBUG_W_STR("Unsupported image type:", imageTypeString);
+	}
+	CONSOLE_DEBUG_W_NUM("myImageType:", myImageType);
+
+	return(myImageType);
+}
+
+
+//*****************************************************************************
+//*	this routine takes an index and image type string and sets it up in the array
+//*	The array has the corresponding internal enum for that image type
+//*
+//*	Each sub class must call this for each supported image type so that the alpaca
+//*	image type commands work
+//*****************************************************************************
+void	CameraDriver::SetImageTypeIndex(const int alpacaImgTypeIdx, const char *imageTypeString)
+{
+//	CONSOLE_DEBUG(__FUNCTION__);
 
-	internalImgType	=	kImageType_Invalid;
+	if ((alpacaImgTypeIdx >=0) && (alpacaImgTypeIdx < kMaxImageTypes))
+	{
+		strcpy(cSupportedImageTypes[alpacaImgTypeIdx].imageTypeString, imageTypeString);
+		cSupportedImageTypes[alpacaImgTypeIdx].internalImgageType	=	GetInternalImageType(imageTypeString);
+		cSupportedImageTypes[alpacaImgTypeIdx].isValid				=	true;
+
+		CONSOLE_DEBUG_W_NUM("alpacaImgTypeIdx\t=",	alpacaImgTypeIdx);
+		CONSOLE_DEBUG_W_NUM("internal\t=",			cSupportedImageTypes[alpacaImgTypeIdx].internalImgageType);
+		CONSOLE_DEBUG_W_STR("name\t\t=",			cSupportedImageTypes[alpacaImgTypeIdx].imageTypeString);
+	}
+	else
+	{
+		CONSOLE_DEBUG_W_NUM("alpacaImgTypeIdx is out of bounds\t=",	alpacaImgTypeIdx);
+		exit(0);
+	}
+}
+
+//*****************************************************************************
+//*	Translate Alpaca image index to internal image type index (TYPE_IMAGE_TYPE)
+//*****************************************************************************
+TYPE_IMAGE_TYPE	CameraDriver::XlateAlpacaImgIdxToIntImgType(const int alpacaImgTypeIdx)
+{
+TYPE_IMAGE_TYPE	internalImgType;
+
+	internalImgType	=	kImageType_Invalid;
 	if ((alpacaImgTypeIdx >=0) && (alpacaImgTypeIdx < kMaxImageTypes))
 	{
 		if (cSupportedImageTypes[alpacaImgTypeIdx].isValid)
@@ -4899,6 +6335,123 @@ TYPE_ASCOM_STATUS		alpacaErrCode	=	kASCOM_Err_NotImplemented;
 	return(alpacaErrCode);
 }
 
+//**************************************************************************
+bool	CameraDriver::SensorTelemetryIsStale(void)
+{
+int32_t		age_ms;
+bool		refreshNeeded;
+
+	pthread_mutex_lock(&cTelemetryMutex);
+	refreshNeeded	=	cTelemetry.refreshNeeded;
+	pthread_mutex_unlock(&cTelemetryMutex);
+
+	age_ms	=	GetSensorTelemetry(NULL);
+	return(refreshNeeded || (age_ms < 0) || (age_ms >= kTelemetry_Interval_ms));
+}
+
+//**************************************************************************
+//*	called from RunStateMachine(), the device calls are made without the lock,
+//*	only the finished sample is copied in
+//**************************************************************************
+void	CameraDriver::UpdateSensorTelemetry(void)
+{
+TYPE_SENSOR_TELEMETRY	newTelemetry;
+struct timeval			startTime;
+bool					coolerOn;
+
+	memset(&newTelemetry, 0, sizeof(TYPE_SENSOR_TELEMETRY));
+	gettimeofday(&startTime, NULL);
+
+	newTelemetry.ccdTempErr		=	kASCOM_Err_NotImplemented;
+	newTelemetry.coolerStateErr	=	kASCOM_Err_NotImplemented;
+	newTelemetry.coolerPowerErr	=	kASCOM_Err_NotImplemented;
+	if (cTempReadSupported)
+	{
+		newTelemetry.ccdTempErr		=	Read_SensorTemp();
+		newTelemetry.ccdTemp_degC	=	cCameraTemp_Dbl;
+		if (newTelemetry.ccdTempErr != kASCOM_Err_Success)
+		{
+			strcpy(newTelemetry.lastErrMsg, cLastCameraErrMsg);
+		}
+	}
+	if (cIsCoolerCam)
+	{
+		coolerOn						=	false;
+		newTelemetry.coolerStateErr		=	Read_CoolerState(&coolerOn);
+		newTelemetry.coolerOn			=	coolerOn;
+		if (newTelemetry.coolerStateErr != kASCOM_Err_Success)
+		{
+			strcpy(newTelemetry.lastErrMsg, cLastCameraErrMsg);
+		}
+		newTelemetry.coolerPowerErr		=	Read_CoolerPowerLevel();
+		newTelemetry.coolerPower		=	cCoolerPowerLevel;
+		if (newTelemetry.coolerPowerErr != kASCOM_Err_Success)
+		{
+			strcpy(newTelemetry.lastErrMsg, cLastCameraErrMsg);
+		}
+	}
+	gettimeofday(&newTelemetry.sampleTime, NULL);
+	newTelemetry.sample_us	=	((newTelemetry.sampleTime.tv_sec - startTime.tv_sec) * 1000000) +
+								(newTelemetry.sampleTime.tv_usec - startTime.tv_usec);
+	newTelemetry.valid		=	true;
+
+	pthread_mutex_lock(&cTelemetryMutex);
+	newTelemetry.sampleCnt	=	cTelemetry.sampleCnt + 1;
+	cTelemetry				=	newTelemetry;
+	pthread_mutex_unlock(&cTelemetryMutex);
+}
+
+//**************************************************************************
+//*	copies the snapshot (telemetry can be NULL), returns its age in milliseconds,
+//*	-1 if nothing has been sampled yet, the error codes are set in that case
+//**************************************************************************
+int32_t	CameraDriver::GetSensorTelemetry(TYPE_SENSOR_TELEMETRY *telemetry)
+{
+struct timeval	currentTime;
+struct timeval	sampleTime;
+bool			valid;
+int32_t			age_ms;
+
+	pthread_mutex_lock(&cTelemetryMutex);
+	valid		=	cTelemetry.valid;
+	sampleTime	=	cTelemetry.sampleTime;
+	if (telemetry != NULL)
+	{
+		*telemetry	=	cTelemetry;
+	}
+	pthread_mutex_unlock(&cTelemetryMutex);
+
+	age_ms	=	-1;
+	if (valid)
+	{
+		gettimeofday(&currentTime, NULL);
+		age_ms	=	((currentTime.tv_sec - sampleTime.tv_sec) * 1000) +
+					((currentTime.tv_usec - sampleTime.tv_usec) / 1000);
+	}
+	else if (telemetry != NULL)
+	{
+		telemetry->ccdTempErr		=	kASCOM_Err_NotConnected;
+		telemetry->coolerStateErr	=	kASCOM_Err_NotConnected;
+		telemetry->coolerPowerErr	=	kASCOM_Err_NotConnected;
+		strcpy(telemetry->lastErrMsg, "Telemetry has not been sampled yet");
+	}
+	return(age_ms);
+}
+
+//**************************************************************************
+void	CameraDriver::AddSensorTelemetryAge(TYPE_GetPutRequestData *reqData)
+{
+	if (reqData != NULL)
+	{
+		JsonResponse_Add_Int32(	reqData->socket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"telemetry-age-ms",
+								GetSensorTelemetry(NULL),
+								INCLUDE_COMMA);
+	}
+}
+
 #pragma mark -
 #pragma mark Image data commands
 //**************************************************************************
@@ -4963,11 +6516,21 @@ uint32_t			elapsedMilliSecs;
 		#ifdef _ENABLE_FILTERWHEEL_
 			UpdateFilterwheelLink();
 		#endif
+		InvalidateFitsSnapshot();
 	#endif
 		cUpdateOtherDevices	=	false;
 	}
+#ifdef _ENABLE_FITS_
+	//*	do the device queries for the FITS header now, not when the image is saved
+	RefreshFitsSnapshot();
+#endif
 	alpacaErrCode	=	kASCOM_Err_Success;
 	delayMicroSecs	=	99999999;
+	if (cPipeline.active)
+	{
+		Pipeline_RunIdle();
+		delayMicroSecs	=	10000;
+	}
 	switch(cImageMode)
 	{
 		case kImageMode_Single:
@@ -4998,6 +6561,10 @@ uint32_t			elapsedMilliSecs;
 					//*	start next image
 					cCurrentExposure_us	+=	cSeqDeltaExposure_us;
 					cSaveNextImage		=	true;
+					FrameTiming_StartFrame(&cFrameTiming, cCurrentExposure_us);
+				#ifdef _ENABLE_FITS_
+					CaptureFitsSnapshot();
+				#endif
 					alpacaErrCode		=	Start_CameraExposure(cCurrentExposure_us);
 					GenerateFileNameRoot();
 					cImageSeqNumber++;
@@ -5014,6 +6581,10 @@ uint32_t			elapsedMilliSecs;
 
 		case kImageMode_Live:
 			{
+				FrameTiming_StartFrame(&cFrameTiming, cCurrentExposure_us);
+			#ifdef _ENABLE_FITS_
+				CaptureFitsSnapshot();
+			#endif
 				alpacaErrCode	=	Start_CameraExposure(cCurrentExposure_us);
 				GenerateFileNameRoot();
 				if (alpacaErrCode != 0)
@@ -5045,8 +6616,33 @@ int	CameraDriver::RunStateMachine_TakingPicture(void)
 {
 int					exposureState;
 TYPE_ASCOM_STATUS	alpacaErrCode;
+bool				nextExposureStarted;
 
-	exposureState	=	Check_Exposure(true);
+	alpacaErrCode			=	kASCOM_Err_Success;
+	nextExposureStarted		=	false;
+	if (cCaptureThreadActive)
+	{
+		//*	the capture thread waits on the SDK and reads out the image,
+		//*	kExposure_Working until it is done
+		RequestCapture();
+		pthread_mutex_lock(&cCaptureMutex);
+		exposureState	=	cCaptureResult;
+		alpacaErrCode	=	cCaptureReadErrCode;
+		pthread_mutex_unlock(&cCaptureMutex);
+	}
+	else
+	{
+		//*	exposures started from outside of the camera driver (multicam) still get a timeline,
+		//*	the start time is off by one pass through the state machine
+		if (cFrameTiming.currentActive == false)
+		{
+			FrameTiming_StartFrame(&cFrameTiming, cCurrentExposure_us);
+		#ifdef _ENABLE_FITS_
+			CaptureFitsSnapshot();
+		#endif
+		}
+		exposureState	=	Check_Exposure(true);
+	}
 //	CONSOLE_DEBUG_W_NUM("Taking picture: exposureState=", exposureState);
 	switch(exposureState)
 	{
@@ -5057,17 +6653,21 @@ TYPE_ASCOM_STATUS	alpacaErrCode;
 			break;
 
 		case kExposure_Working:
-			cWorkingLoopCnt++;
-			if (cWorkingLoopCnt > 70000)
+			//*	nothing to do until the capture thread is done
+			if (cCaptureThreadActive == false)
 			{
-				Check_Exposure(true);
-			//	CONSOLE_DEBUG_W_STR("Aborting.... Reseting to idle-", cDeviceManufAbrev);
-			//	cInternalCameraState	=	kCameraState_Idle;
-				cWorkingLoopCnt			=	0;
-			}
-			else
-			{
-			//	usleep(40);
+				cWorkingLoopCnt++;
+				if (cWorkingLoopCnt > 70000)
+				{
+					Check_Exposure(true);
+				//	CONSOLE_DEBUG_W_STR("Aborting.... Reseting to idle-", cDeviceManufAbrev);
+				//	cInternalCameraState	=	kCameraState_Idle;
+					cWorkingLoopCnt			=	0;
+				}
+				else
+				{
+				//	usleep(40);
+				}
 			}
 			break;
 
@@ -5079,16 +6679,72 @@ TYPE_ASCOM_STATUS	alpacaErrCode;
 			}
 
 			cWorkingLoopCnt		=	0;
-			//*	Extract Image
-			alpacaErrCode	=	Read_ImageData();
+			if (cCaptureThreadActive == false)
+			{
+				FrameTiming_StageEnd(&cFrameTiming, kFrameStage_Exposure);
+				//*	Extract Image
+				FrameTiming_StageBegin(&cFrameTiming, kFrameStage_Readout);
+				pthread_mutex_lock(&cCameraDataMutex);
+				alpacaErrCode	=	Read_ImageData();
+				pthread_mutex_unlock(&cCameraDataMutex);
+				FrameTiming_StageEnd(&cFrameTiming, kFrameStage_Readout);
+				//*	record the time the exposure ended
+				gettimeofday(&cLastexposure_EndTime, NULL);
+			}
 			if (alpacaErrCode != kASCOM_Err_Success)
 			{
 				CONSOLE_DEBUG_W_NUM("Read_ImageData returned error", alpacaErrCode);
 			}
-			//*	record the time the exposure ended
-			gettimeofday(&cLastexposure_EndTime, NULL);
+			//*	calibrate in place so everything after this gets the calibrated frame
+			if (alpacaErrCode == kASCOM_Err_Success)
+			{
+				FrameTiming_StageBegin(&cFrameTiming, kFrameStage_Calibration);
+				ApplyCalibration();
+				FrameTiming_StageEnd(&cFrameTiming, kFrameStage_Calibration);
+			}
+			//*	the pipelined sequencer gets the camera going again before the save
+			if (cPipeline.active && (alpacaErrCode == kASCOM_Err_Success))
+			{
+				nextExposureStarted	=	Pipeline_StartOverlapped();
+			}
 			cNewImageReadyToDisplay		=	true;
 			cImageReady					=	true;
+			ClearPreviewCache();			//*	and the debayered image
+
+			if ((cLiveStack.threadActive || cStarDetectEnabled) && (alpacaErrCode == kASCOM_Err_Success))
+			{
+				FrameTiming_StageBegin(&cFrameTiming, kFrameStage_Analysis);
+				if (cLiveStack.threadActive)
+				{
+					OfferFrameToLiveStack();
+				}
+				if (cStarDetectEnabled)
+				{
+					DetectStars();
+				}
+				FrameTiming_StageEnd(&cFrameTiming, kFrameStage_Analysis);
+			}
+			//*	live view clients, only costs something when someone is watching
+			if ((cMJPEGstream.subscriberCnt > 0) && (alpacaErrCode == kASCOM_Err_Success))
+			{
+				OfferFrameToMJPEG();
+			}
+
+			//*	once a client has asked for compressed images, have each one ready before it asks,
+			//*	until it has stopped asking for them
+			if (cCompressOnReadout && (alpacaErrCode == kASCOM_Err_Success))
+			{
+				cCompressUnusedCnt++;
+				if (cCompressUnusedCnt > kCompressMaxUnusedFrames)
+				{
+					CONSOLE_DEBUG("No compressed downloads, compression on readout turned off");
+					cCompressOnReadout	=	false;
+				}
+				else
+				{
+					CompressImageData();
+				}
+			}
 
 			if (cImageMode == kImageMode_Live)
 			{
@@ -5102,13 +6758,17 @@ TYPE_ASCOM_STATUS	alpacaErrCode;
 				cFrameRate	=	(cFramesRead * 1.0) / secondsOfExposure;
 			}
 		#ifdef _USE_OPENCV_
+			FrameTiming_StageBegin(&cFrameTiming, kFrameStage_OpenCV);
 			CreateOpenCVImage(cCameraDataBuffer);
+			FrameTiming_StageEnd(&cFrameTiming, kFrameStage_OpenCV);
 //			CONSOLE_DEBUG("Done with jpg and png");
 		#endif
 
 			if (cSaveNextImage || cSaveImages)
 			{
+				FrameTiming_StageBegin(&cFrameTiming, kFrameStage_Save);
 				SaveImageData();
+				FrameTiming_StageEnd(&cFrameTiming, kFrameStage_Save);
 			}
 			else
 			{
@@ -5120,8 +6780,21 @@ TYPE_ASCOM_STATUS	alpacaErrCode;
 			{
 				AutoAdjustExposure();
 			}
+			FrameTiming_CommitFrame(&cFrameTiming, cFramesRead);
 
-			cInternalCameraState	=	kCameraState_Idle;
+			if (cPipeline.active)
+			{
+				Pipeline_FrameDone(alpacaErrCode == kASCOM_Err_Success);
+			}
+			if (nextExposureStarted)
+			{
+				//*	back to the frame that is exposing, the camera stays in TakingPicture
+				Pipeline_RestoreFrameState(&cPipelineNextFrame);
+			}
+			else
+			{
+				cInternalCameraState	=	kCameraState_Idle;
+			}
 			break;
 
 		case kExposure_Failed:
@@ -5132,11 +6805,21 @@ TYPE_ASCOM_STATUS	alpacaErrCode;
 						NULL,
 						kASCOM_Err_FailedToTakePicture,
 						cLastCameraErrMsg);
+			cFrameTiming.currentActive	=	false;
 			cInternalCameraState	=	kCameraState_Idle;
+			if (cPipeline.active)
+			{
+				Pipeline_FrameDone(false);
+			}
 			CONSOLE_DEBUG(cLastCameraErrMsg);
 			ResetCamera();
 			break;
 	}
+	if (cCaptureThreadActive && (exposureState != kExposure_Working))
+	{
+		//*	we are done with this frame, the thread can wait for the next one
+		ClearCaptureResult();
+	}
 	return(exposureState);
 }
 
@@ -5152,6 +6835,20 @@ int32_t		delayMicroSecs;
 //	}
 	delayMicroSecs	=	99999999;
 
+	//*	started here rather than in the constructor so the sub class is fully set up
+	if (cCaptureThreadEnabled && (cCaptureThreadActive == false))
+	{
+		StartCaptureThread();
+	}
+
+	//*	the only place the temperature and cooler are read, the endpoints use the snapshot.
+	//*	postponed while the capture thread is reading out an image, the snapshot
+	//*	just gets a little older
+	if (SensorTelemetryIsStale() && (CaptureReadoutActive() == false))
+	{
+		UpdateSensorTelemetry();
+	}
+
 	switch(cInternalCameraState)
 	{
 		case kCameraState_Idle:
@@ -5173,6 +6870,10 @@ int32_t		delayMicroSecs;
 			delayMicroSecs	=	100;
 			break;
 
+		case kCameraState_ROIstream:
+			//*	the stream thread does all of the work
+			break;
+
 		default:
 			//*	we should never get here
 			break;
@@ -5201,6 +6902,14 @@ int32_t		delayMicroSecs;
 		}
 	}
 #endif // _USE_OPENCV_
+	if (cAutoFocus.state != kAutoFocus_Idle)
+	{
+		RunStateMachine_AutoFocus();
+		if (delayMicroSecs > 50000)
+		{
+			delayMicroSecs	=	50000;
+		}
+	}
 	CheckPulseGuiding();
 	RunStateMachine_Device();
 	return(delayMicroSecs);
@@ -5344,170 +7053,206 @@ char		fileNameDateString[64];
 #pragma mark -
 
 
-#define	_SORT_FILENAMES_
-#ifdef _SORT_FILENAMES_
-
-#define	kMaxFileCnt	200
 //*****************************************************************************
-typedef struct
-{
-	char	filename[128];
-} TYPE_FILE_ENTRY;
-
+//*	one file of the paged output, the full list is just names
 //*****************************************************************************
-int	DirSort(const void *e1, const void* e2)
+static void	FormatCatalogEntry(const TYPE_CATALOG_ENTRY *catalogEntry, const bool firstEntry, char *lineBuff)
 {
-int	retValue;
-TYPE_FILE_ENTRY	*file1;
-TYPE_FILE_ENTRY	*file2;
+char	exposureString[32];
 
-	file1		=	(TYPE_FILE_ENTRY *)e1;
-	file2		=	(TYPE_FILE_ENTRY *)e2;
-	retValue	=	strcmp(file1->filename, file2->filename);
-	return(retValue);
+	if (catalogEntry->exposure_us >= 0)
+	{
+		sprintf(exposureString, "%1.6f", (catalogEntry->exposure_us / 1000000.0));
+	}
+	else
+	{
+		strcpy(exposureString, "-1");
+	}
+	sprintf(lineBuff,	"%s\t\t\t{\"name\":\"%s\",\"size\":%lld,\"time\":%ld,"
+						"\"exposure\":%s,\"filter\":\"%s\",\"object\":\"%s\"}",
+						(firstEntry ? "\r\n" : ",\r\n"),
+						catalogEntry->fileName,
+						(long long)catalogEntry->fileSize,
+						(long)catalogEntry->timeStamp,
+						exposureString,
+						catalogEntry->filter,
+						catalogEntry->object);
 }
-#endif // _SORT_FILENAMES_
 
+//*****************************************************************************
+//*	The list comes from the image catalog (imagecatalog.c), not the directory.
+//*	With no arguments it is every file name, sorted, the way it always was.
+//*	Any of these turn on the paged output with the file details
+//*		Offset=n		first entry of the page
+//*		Count=n			entries per page, max kImageCatalog_MaxPageSize
+//*		Sort=name|time
+//*		Reverse=true	newest/last first
+//*		Ext=fits		Filter=Red		Object=M42		Since=unix time
 //*****************************************************************************
 TYPE_ASCOM_STATUS	CameraDriver::Get_Filelist(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
 {
 TYPE_ASCOM_STATUS	alpacaErrCode;
-DIR					*directory;
-struct dirent		*dir;
-int					errorCode;
-bool				keepGoing;
+TYPE_CATALOG_QUERY	query;
+TYPE_CATALOG_ENTRY	*results;
+int					resultCnt;
+bool				moreAvailable;
+bool				pagedOutput;
 bool				firstLine;
 int					mySocketFD;
-char				lineBuff[512];
-#ifdef _SORT_FILENAMES_
-TYPE_FILE_ENTRY		files[kMaxFileCnt];
-int					fileIdx	=	0;
 int					ii;
-#endif // _SORT_FILENAMES_
+char				argString[64];
+char				lineBuff[512];
 
 	CONSOLE_DEBUG_W_STR(__FUNCTION__, kImageDataDir);
 
 	mySocketFD	=	reqData->socket;
+	memset(&query, 0, sizeof(TYPE_CATALOG_QUERY));
+	pagedOutput	=	false;
+	if (GetKeyWordArgument(reqData->contentData, "Offset", argString, (sizeof(argString) -1)))
+	{
+		query.offset	=	atoi(argString);
+		pagedOutput		=	true;
+	}
+	if (GetKeyWordArgument(reqData->contentData, "Count", argString, (sizeof(argString) -1)))
+	{
+		query.count		=	atoi(argString);
+		pagedOutput		=	true;
+	}
+	if (GetKeyWordArgument(reqData->contentData, "Sort", argString, (sizeof(argString) -1)))
+	{
+		query.sortOrder	=	(strcasecmp(argString, "time") == 0) ? kCatalogSort_Time : kCatalogSort_Name;
+		pagedOutput		=	true;
+	}
+	if (GetKeyWordArgument(reqData->contentData, "Reverse", argString, (sizeof(argString) -1)))
+	{
+		query.reverse	=	IsTrueFalse(argString);
+		pagedOutput		=	true;
+	}
+	if (GetKeyWordArgument(reqData->contentData, "Ext", query.extension, (sizeof(query.extension) -1)))
+	{
+		pagedOutput		=	true;
+	}
+	if (GetKeyWordArgument(reqData->contentData, "Filter", query.filter, (sizeof(query.filter) -1)))
+	{
+		pagedOutput		=	true;
+	}
+	if (GetKeyWordArgument(reqData->contentData, "Object", query.object, (sizeof(query.object) -1)))
+	{
+		pagedOutput		=	true;
+	}
+	if (GetKeyWordArgument(reqData->contentData, "Since", argString, (sizeof(argString) -1)))
+	{
+		query.since		=	atol(argString);
+		pagedOutput		=	true;
+	}
+	if (query.offset < 0)
+	{
+		query.offset	=	0;
+	}
 
-	directory	=	opendir(kImageDataDir);
-	if (directory != NULL)
+	results	=	(TYPE_CATALOG_ENTRY *)malloc(kImageCatalog_MaxPageSize * sizeof(TYPE_CATALOG_ENTRY));
+	if (results != NULL)
 	{
+		alpacaErrCode	=	kASCOM_Err_Success;
 		JsonResponse_Add_String(mySocketFD,
 								reqData->jsonTextBuffer,
 								kMaxJsonBuffLen,
 								"Directory",
 								kImageDataDir,
 								INCLUDE_COMMA);
+		JsonResponse_Add_Int32(	mySocketFD,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"total",
+								ImageCatalog_GetCount(),
+								INCLUDE_COMMA);
 
-		JsonResponse_Add_ArrayStart(	mySocketFD,
+		if (pagedOutput)
+		{
+			resultCnt	=	ImageCatalog_Query(&query, results, kImageCatalog_MaxPageSize, &moreAvailable);
+
+			JsonResponse_Add_Int32(	mySocketFD,
+									reqData->jsonTextBuffer,
+									kMaxJsonBuffLen,
+									"offset",
+									query.offset,
+									INCLUDE_COMMA);
+			JsonResponse_Add_Int32(	mySocketFD,
+									reqData->jsonTextBuffer,
+									kMaxJsonBuffLen,
+									"count",
+									resultCnt,
+									INCLUDE_COMMA);
+			JsonResponse_Add_Bool(	mySocketFD,
+									reqData->jsonTextBuffer,
+									kMaxJsonBuffLen,
+									"more",
+									moreAvailable,
+									INCLUDE_COMMA);
+			JsonResponse_Add_ArrayStart(mySocketFD,
 										reqData->jsonTextBuffer,
 										kMaxJsonBuffLen,
 										gValueString);
-		alpacaErrCode	=	kASCOM_Err_Success;
-		keepGoing		=	true;
-		firstLine		=	true;
-		while (keepGoing)
+			for (ii=0; ii<resultCnt; ii++)
+			{
+				FormatCatalogEntry(&results[ii], (ii == 0), lineBuff);
+				JsonResponse_Add_RawText(	mySocketFD,
+											reqData->jsonTextBuffer,
+											kMaxJsonBuffLen,
+											lineBuff);
+			}
+			JsonResponse_Add_RawText(	mySocketFD,
+										reqData->jsonTextBuffer,
+										kMaxJsonBuffLen,
+										"\r\n");
+		}
+		else
 		{
-			dir	=	readdir(directory);
-			if (dir != NULL)
+			//*	the original output, every name, one page at a time out of the catalog
+			JsonResponse_Add_ArrayStart(mySocketFD,
+										reqData->jsonTextBuffer,
+										kMaxJsonBuffLen,
+										gValueString);
+			firstLine	=	true;
+			do
 			{
-			//	if ((strcmp(dir->d_name, ".") == 0) || (strcmp(dir->d_name, "..") == 0))
-				if (dir->d_name[0] == '.')
-				{
-					//*	ignore . and ..
-				}
-				else if (dir->d_type == DT_DIR)
-				{
-					//*	ignore directories
-				}
-				else
+				resultCnt	=	ImageCatalog_Query(&query, results, kImageCatalog_MaxPageSize, &moreAvailable);
+				for (ii=0; ii<resultCnt; ii++)
 				{
-				#ifdef _SORT_FILENAMES_
-					if (fileIdx < kMaxFileCnt)
-					{
-						strcpy(files[fileIdx].filename, dir->d_name);
-						fileIdx++;
-					}
-					else
-					{
-						CONSOLE_DEBUG("Exceeded file list max count!!!!!!");
-//+						keepGoing	=	false;
-					}
-				#else
-				//	printf("%2d\t%s\r\n", dir->d_type, dir->d_name);
+					lineBuff[0]	=	0;
 					if (firstLine)
 					{
-						strcpy(lineBuff, "\r\n\t\t\t\"");
+						strcpy(lineBuff, "\r\n");
 						firstLine	=	false;
 					}
-					else
-					{
-						strcpy(lineBuff, "\t\t\t\"");
-					}
-					strcat(lineBuff, dir->d_name);
+					strcat(lineBuff, "\t\t\t\"");
+					strcat(lineBuff, results[ii].fileName);
 					strcat(lineBuff, "\",");
 					strcat(lineBuff, "\r\n");
 					JsonResponse_Add_RawText(	mySocketFD,
 												reqData->jsonTextBuffer,
 												kMaxJsonBuffLen,
 												lineBuff);
-				#endif // _SORT_FILENAMES_
 				}
-			}
-			else
-			{
-				keepGoing	=	false;
-			}
-		}
-CONSOLE_DEBUG(__FUNCTION__);
-	#ifdef _SORT_FILENAMES_
-CONSOLE_DEBUG("sorting");
-		qsort(files, fileIdx, sizeof(TYPE_FILE_ENTRY), DirSort);
-		for (ii=0; ii<fileIdx; ii++)
-		{
-			lineBuff[0]	=	0;
-			if (firstLine)
-			{
-				strcpy(lineBuff, "\r\n");
-				firstLine	=	false;
-			}
-			strcat(lineBuff, "\t\t\t\"");
-			strcat(lineBuff, files[ii].filename);
-			strcat(lineBuff, "\",");
-			strcat(lineBuff, "\r\n");
+				query.offset	+=	resultCnt;
+			} while (moreAvailable && (resultCnt > 0));
+
 			JsonResponse_Add_RawText(	mySocketFD,
 										reqData->jsonTextBuffer,
 										kMaxJsonBuffLen,
-										lineBuff);
+										"\t\t\t\"END\"\r\n");
 		}
-		JsonResponse_Add_RawText(	mySocketFD,
-									reqData->jsonTextBuffer,
-									kMaxJsonBuffLen,
-									"\t\t\t\"END\"\r\n");
-	#endif // _SORT_FILENAMES_
-CONSOLE_DEBUG(__FUNCTION__);
 		JsonResponse_Add_ArrayEnd(	mySocketFD,
 									reqData->jsonTextBuffer,
 									kMaxJsonBuffLen,
 									INCLUDE_COMMA);
-		errorCode	=	closedir(directory);
-		if (errorCode != 0)
-		{
-			CONSOLE_DEBUG_W_NUM("closedir errorCode\t=", errorCode);
-			CONSOLE_DEBUG_W_NUM("errno\t=", errno);
-		}
+		free(results);
 	}
 	else
 	{
-		CONSOLE_DEBUG_W_STR("Failed to open", kImageDataDir);
-		CONSOLE_DEBUG_W_NUM("errno\t=", errno);
-		LogEvent(	"camera",
-					"Failure",
-					NULL,
-					kASCOM_Err_Success,
-					"Failed to open image data directory");
+		alpacaErrCode	=	kASCOM_Err_FailedUnknown;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to allocate memory for the file list");
 	}
-
 	return(alpacaErrCode);
 }
 
@@ -5532,6 +7277,41 @@ TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
 								"stepsize",
 								cAutoAdjustStepSz_us,
 								INCLUDE_COMMA);
+
+		JsonResponse_Add_Double(reqData->socket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"percentile",
+								cAutoExposure.targetPercentile,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Double(reqData->socket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"target",
+								(100.0 * cAutoExposure.targetLevel),
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Double(reqData->socket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"percentileADU",
+								cAutoExposure.lastStats.percentileADU,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Int32(	reqData->socket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"saturatedCount",
+								cAutoExposure.lastStats.saturatedCnt,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Int32(	reqData->socket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"sampleCount",
+								cAutoExposure.lastStats.sampleCnt,
+								INCLUDE_COMMA);
 	}
 	return(alpacaErrCode);
 }
@@ -5543,9 +7323,36 @@ TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_NotImplemented;
 char				argumentString[32];
 bool				foundKeyWord;
 
+double				newValue;
+
 //	CONSOLE_DEBUG(__FUNCTION__);
 	if (reqData != NULL)
 	{
+		//*	optional, which percentile of the pixels is controlled and where it should be
+		foundKeyWord	=	GetKeyWordArgument(	reqData->contentData,
+												"Percentile",
+												argumentString,
+												(sizeof(argumentString) -1));
+		if (foundKeyWord)
+		{
+			newValue	=	atof(argumentString);
+			if ((newValue >= 50.0) && (newValue <= 99.99))
+			{
+				cAutoExposure.targetPercentile	=	newValue;
+			}
+		}
+		foundKeyWord	=	GetKeyWordArgument(	reqData->contentData,
+												"Target",
+												argumentString,
+												(sizeof(argumentString) -1));
+		if (foundKeyWord)
+		{
+			newValue	=	atof(argumentString);
+			if ((newValue >= 5.0) && (newValue <= 95.0))
+			{
+				cAutoExposure.targetLevel	=	newValue / 100.0;
+			}
+		}
 
 		foundKeyWord	=	GetKeyWordArgument(	reqData->contentData,
 												"autoexposure",
@@ -5557,6 +7364,7 @@ bool				foundKeyWord;
 			if (strcmp(argumentString, "true") == 0)
 			{
 				cAutoAdjustExposure	=	true;
+				AutoExposure_Reset(&cAutoExposure);
 			}
 			else
 			{
@@ -5683,6 +7491,20 @@ bool				foundKeyWord;
 		{
 			cFN_includeRefID	=	IsTrueFalse(argumentString);
 		}
+
+		//*	FITS tile compression, none, rice or hcompress
+		foundKeyWord	=	GetKeyWordArgument(	reqData->contentData,
+												"fitscompression",
+												argumentString,
+												(sizeof(argumentString) -1));
+		if (foundKeyWord)
+		{
+			if (SetFitsCompression(argumentString) == false)
+			{
+				alpacaErrCode	=	kASCOM_Err_InvalidValue;
+				GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "fitscompression must be none, rice or hcompress");
+			}
+		}
 	}
 	else
 	{
@@ -5691,6 +7513,32 @@ bool				foundKeyWord;
 	return(alpacaErrCode);
 }
 
+//*****************************************************************************
+bool	CameraDriver::SetFitsCompression(const char *compressionString)
+{
+bool	validString;
+
+	validString	=	true;
+	if (strcasecmp(compressionString, "none") == 0)
+	{
+		cFitsCompression	=	kFitsCompress_None;
+	}
+	else if (strcasecmp(compressionString, "rice") == 0)
+	{
+		cFitsCompression	=	kFitsCompress_Rice;
+	}
+	else if (strcasecmp(compressionString, "hcompress") == 0)
+	{
+		cFitsCompression	=	kFitsCompress_HCompress;
+	}
+	else
+	{
+		CONSOLE_DEBUG_W_STR("Invalid FITS compression\t=", compressionString);
+		validString	=	false;
+	}
+	return(validString);
+}
+
 #ifdef _ENABLE_FITS_
 //*****************************************************************************
 TYPE_ASCOM_STATUS	CameraDriver::Get_FitsHeader(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
@@ -5751,8 +7599,11 @@ char				imageModeString[32];
 int					exposureState;
 char				exposureStateString[32];
 char				textBuffer[128];
-
-	alpacaErrCode	=	Read_SensorTemp();
+TYPE_FRAME_STAGE_STATS	stageStats[kFrameStage_last];
+char				timingKeyword[48];
+int					iii;
+TYPE_IMAGE_POOL_STATS	poolStats;
+char				fitsCompressString[16];
 
 	switch(cInternalCameraState)
 	{
@@ -5760,6 +7611,7 @@ char				textBuffer[128];
 		case kCameraState_TakingPicture:	strcpy(cameraStateString,	"TakingPicture");	break;
 		case kCameraState_StartVideo:		strcpy(cameraStateString,	"StartVideo");		break;
 		case kCameraState_TakingVideo:		strcpy(cameraStateString,	"TakingVideo");		break;
+		case kCameraState_ROIstream:		strcpy(cameraStateString,	"ROIstream");		break;
 		default:							strcpy(cameraStateString,	"UNKNOWN");			break;
 	}
 
@@ -5796,6 +7648,7 @@ char				textBuffer[128];
 		Get_CCDtemperature(			reqData, alpacaErrMsg, "ccdtemperature");
 		Get_Cooleron(				reqData, alpacaErrMsg, "cooleron");
 		Get_CoolerPowerLevel(		reqData, alpacaErrMsg, "coolerpower");
+		AddSensorTelemetryAge(		reqData);
 
 
 		//*	make local copies of the data structure to make the code easier to read
@@ -6008,6 +7861,220 @@ char				textBuffer[128];
 								cFramesRead,
 								INCLUDE_COMMA);
 
+		if (cSERwriter != NULL)
+		{
+			cVideoFramesDropped	=	cSERwriter->framesDropped;
+		}
+		JsonResponse_Add_Int32(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"videoframesdropped",
+								cVideoFramesDropped,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Bool(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"livestack-active",
+								cLiveStack.threadActive,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Int32(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"livestack-stacked",
+								cLiveStack.framesStacked,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Bool(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"calibration-enabled",
+								cCalibrationEnabled,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Int32(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"stars-count",
+								cStarAnalysis.starCnt,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Double(mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"stars-hfr",
+								cStarAnalysis.medianHFR,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Bool(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"quality-enabled",
+								cQualityMetrics.enabled,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Int32(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"quality-frames",
+								cQualityMetrics.framesAnalyzed,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_String(mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"imagecompression",
+								"rice",
+								INCLUDE_COMMA);
+
+		if (cCompressedImage.valid && (cCompressedImage.dataLen > 0))
+		{
+			JsonResponse_Add_Double(mySocket,
+									reqData->jsonTextBuffer,
+									kMaxJsonBuffLen,
+									"imagecompression-ratio",
+									((1.0 * cCompressedImage.rawLength) / cCompressedImage.dataLen),
+									INCLUDE_COMMA);
+
+			JsonResponse_Add_Int32(	mySocket,
+									reqData->jsonTextBuffer,
+									kMaxJsonBuffLen,
+									"imagecompression-us",
+									cCompressedImage.compress_us,
+									INCLUDE_COMMA);
+		}
+
+		switch(cFitsCompression)
+		{
+			case kFitsCompress_Rice:		strcpy(fitsCompressString,	"rice");		break;
+			case kFitsCompress_HCompress:	strcpy(fitsCompressString,	"hcompress");	break;
+			default:						strcpy(fitsCompressString,	"none");		break;
+		}
+		JsonResponse_Add_String(mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"fitscompression",
+								fitsCompressString,
+								INCLUDE_COMMA);
+
+		//*	ROI streaming
+		JsonResponse_Add_Bool(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"roistream-active",
+								cROIstream.active,
+								INCLUDE_COMMA);
+		if (cROIstream.active)
+		{
+			JsonResponse_Add_Double(mySocket,
+									reqData->jsonTextBuffer,
+									kMaxJsonBuffLen,
+									"roistream-fps",
+									cROIstream.framesPerSec,
+									INCLUDE_COMMA);
+
+			JsonResponse_Add_Int32(	mySocket,
+									reqData->jsonTextBuffer,
+									kMaxJsonBuffLen,
+									"roistream-subscribers",
+									cROIstream.subscriberCnt,
+									INCLUDE_COMMA);
+		}
+
+		//*	MJPEG live view
+		JsonResponse_Add_Int32(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"mjpeg-subscribers",
+								cMJPEGstream.subscriberCnt,
+								INCLUDE_COMMA);
+
+		//*	image buffer pool, shared by all of the cameras
+		ImagePool_GetStats(&poolStats);
+		JsonResponse_Add_Int32(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"imagepool-buffers",
+								poolStats.bufferCnt,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Int32(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"imagepool-buffersinuse",
+								poolStats.buffersInUse,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Double(mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"imagepool-allocated-mb",
+								(poolStats.bytesAllocated / (1024.0 * 1024.0)),
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Double(mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"imagepool-inuse-mb",
+								(poolStats.bytesInUse / (1024.0 * 1024.0)),
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Double(mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"imagepool-highwater-mb",
+								(poolStats.highWater_bytes / (1024.0 * 1024.0)),
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Int32(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"imagepool-requests",
+								poolStats.allocCnt,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Int32(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"imagepool-reused",
+								poolStats.reuseCnt,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Int32(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"imagepool-hugepages",
+								poolStats.hugePageCnt,
+								INCLUDE_COMMA);
+
+		JsonResponse_Add_Int32(	mySocket,
+								reqData->jsonTextBuffer,
+								kMaxJsonBuffLen,
+								"imagepool-overflow",
+								poolStats.overflowCnt,
+								INCLUDE_COMMA);
+
+		//*	latency summary, the full timeline is in the frametiming command
+		FrameTiming_ComputeStats(&cFrameTiming, stageStats);
+		for (iii=0; iii<kFrameStage_last; iii++)
+		{
+			sprintf(timingKeyword, "timing-%s-p50-us", FrameTiming_GetStageName((TYPE_FRAME_STAGE)iii));
+			JsonResponse_Add_Int32(	mySocket,
+									reqData->jsonTextBuffer,
+									kMaxJsonBuffLen,
+									timingKeyword,
+									stageStats[iii].p50_us,
+									INCLUDE_COMMA);
+			sprintf(timingKeyword, "timing-%s-p99-us", FrameTiming_GetStageName((TYPE_FRAME_STAGE)iii));
+			JsonResponse_Add_Int32(	mySocket,
+									reqData->jsonTextBuffer,
+									kMaxJsonBuffLen,
+									timingKeyword,
+									stageStats[iii].p99_us,
+									INCLUDE_COMMA);
+		}
+
 		JsonResponse_Add_Bool(	mySocket,
 								reqData->jsonTextBuffer,
 								kMaxJsonBuffLen,
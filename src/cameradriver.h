@@ -20,6 +20,35 @@
 //*	Mar  3,	2020	<MLS> Added TYPE_SUPPORTED_IMG_TYPE
 //*	Nov 29,	2020	<MLS> Updated return values to TYPE_ASCOM_STATUS
 //*	Dec 11,	2020	<MLS> Updating class variable names to match ASCOM property names
+//*	Feb  3,	2021	<MLS> Added SER video writer (cSERwriter)
+//*	Feb  7,	2021	<MLS> Added server side live stacking (cLiveStack)
+//*	Feb 10,	2021	<MLS> Added native debayer (GetDebayeredImage)
+//*	Feb 12,	2021	<MLS> Added binned/downscaled preview cache (cPreviewCache)
+//*	Feb 15,	2021	<MLS> Added calibration library (cCalibLibrary)
+//*	Feb 17,	2021	<MLS> Added star detection (cStarAnalysis)
+//*	Feb 19,	2021	<MLS> Added server side autofocus (cAutoFocus)
+//*	Feb 22,	2021	<MLS> Added per frame latency timeline (cFrameTiming)
+//*	Feb 24,	2021	<MLS> Added capture thread, replaces Check_Exposure() polling
+//*	Feb 26,	2021	<MLS> Image buffers now come from the image pool
+//*	Feb 28,	2021	<MLS> Added Rice compressed image cache (cCompressedImage)
+//*	Mar  2,	2021	<MLS> Added ROI streaming (cROIstream)
+//*	Mar  6,	2021	<MLS> Added tile compressed FITS option (cFitsCompression)
+//*	Mar  8,	2021	<MLS> Added TYPE_FITS_SNAPSHOT, FITS header cards built in the background
+//*	Mar 10,	2021	<MLS> Added CatalogSavedFile()
+//*	Mar 12,	2021	<MLS> Added thumbnail and stretched preview JPEGs (SaveThumbnails)
+//*	Mar 14,	2021	<MLS> Added pipelined step sequencer (cPipeline)
+//*	Mar 16,	2021	<MLS> Added predictive auto exposure (cAutoExposure)
+//*	Mar 18,	2021	<MLS> Added per frame image pyramid (cImagePyramid) for live view and previews
+//*	Mar 20,	2021	<MLS> Added MJPEG live view stream (cMJPEGstream)
+//*	Mar 26,	2021	<MLS> Added per frame quality metrics (cQualityMetrics), done in the background
+//*	Mar 28,	2021	<MLS> Added cached sensor telemetry (cTelemetry), sampled while idle
+//*	Mar 30,	2021	<MLS> Added cPreviewMutex, the preview cache is used from more than one thread
+//*	Mar 30,	2021	<MLS> Added cThumbnailJob, thumbnail JPEGs are encoded on a thread
+//*	Mar 30,	2021	<MLS> Added cFitsSnapshotMutex
+//*	Mar 30,	2021	<MLS> Added cCameraDataMutex, the capture thread reads out while downloads are running
+//*	Mar 30,	2021	<MLS> Added cStarMutex
+//*	Mar 30,	2021	<MLS> Added cCompressUnusedCnt
+//*	Mar 30,	2021	<MLS> Added the FITS snapshot thread
 //*****************************************************************************
 //#include	"cameradriver.h"
 
@@ -49,6 +78,32 @@
 		char	fitsRec[kMaxFitsRecLen];
 	} TYPE_FITS_RECORD;
 
+	#define	kFitsSnapshot_MaxRecords	128
+	#define	kFitsSnapshot_MaxAge_Secs	30		//*	moon and temperatures drift even if nothing reports a change
+	#define	kFitsSnapshot_MinAge_Secs	2		//*	limits rebuilds while a focuser is moving
+	#define	kFitsSnapshot_BuildWait_Secs	5		//*	how long the save waits for a build the frame asked for
+
+	//*****************************************************************************
+	//*	the header cards that describe everything except the camera and the frame,
+	//*	telescope, focuser, rotator, filter wheel, observatory, environment, moon.
+	//*	Rebuilt by the state machine while idle, copied at exposure start,
+	//*	written as is at save time
+	typedef struct
+	{
+		bool				valid;
+		uint32_t			deviceChangeCnt;	//*	gDeviceStateChangeCnt when it was built
+		time_t				siteEnvUpdate;		//*	gEnvData time stamps when it was built
+		time_t				domeEnvUpdate;
+		time_t				buildTime;
+		uint32_t			build_ms;
+		uint32_t			buildSeq;			//*	cFitsSnapshotBuildCnt when it was started
+		uint32_t			waitForBuild;		//*	frame copy only, the build it has to be replaced by, 0 if none
+		bool				ccdTempValid;
+		double				ccdTemp_degC;
+		int					recordCnt;
+		TYPE_FITS_RECORD	records[kFitsSnapshot_MaxRecords];
+	} TYPE_FITS_SNAPSHOT;
+
 #endif // _ENABLE_FITS_
 
 
@@ -56,6 +111,58 @@
 	#include	"alpacadriver.h"
 #endif
 
+#ifndef _SERFILE_H_
+	#include	"serfile.h"
+#endif
+
+#ifndef _LIVESTACK_H_
+	#include	"livestack.h"
+#endif
+
+#ifndef _DEBAYER_H_
+	#include	"debayer.h"
+#endif
+
+#ifndef _IMAGEBIN_H_
+	#include	"imagebin.h"
+#endif
+
+#ifndef _CALIBRATION_H_
+	#include	"calibration.h"
+#endif
+
+#ifndef _FRAMETIMING_H_
+	#include	"frametiming.h"
+#endif
+
+#ifndef _IMAGEPOOL_H_
+	#include	"imagepool.h"
+#endif
+
+#ifndef _IMAGECOMPRESS_H_
+	#include	"imagecompress.h"
+#endif
+
+#ifndef _ROISTREAM_H_
+	#include	"roistream.h"
+#endif
+
+#ifndef _IMAGECATALOG_H_
+	#include	"imagecatalog.h"
+#endif
+
+#ifndef _AUTOEXPOSURE_H_
+	#include	"autoexposure.h"
+#endif
+
+#ifndef _IMAGEPYRAMID_H_
+	#include	"imagepyramid.h"
+#endif
+
+#ifndef _MJPEGSTREAM_H_
+	#include	"mjpegstream.h"
+#endif
+
 #ifdef _USE_OPENCV_
 	#ifndef __OPENCV_OLD_HIGHGUI_H__
 		#include "opencv/highgui.h"
@@ -83,6 +190,7 @@
 #include	"alpaca_defs.h"
 
 #define	kImageDataDir	"imagedata"
+#define	kThumbnailDir	"thumbs"		//*	sub directory of kImageDataDir
 
 
 //*****************************************************************************
@@ -96,6 +204,7 @@ typedef enum
 	kCameraState_TakingPicture,
 	kCameraState_StartVideo,
 	kCameraState_TakingVideo,
+	kCameraState_ROIstream,
 
 	kCameraState_last
 } TYPE_CAMERA_STATE;
@@ -134,6 +243,17 @@ typedef enum
 	kExposure_Last
 } TYPE_EXPOSURE_STATUS;
 
+//*****************************************************************************
+//*	cfitsio tile compression for saved FITS files
+typedef enum
+{
+	kFitsCompress_None	=	0,
+	kFitsCompress_Rice,
+	kFitsCompress_HCompress,
+
+	kFitsCompress_last
+} TYPE_FITS_COMPRESSION;
+
 //*****************************************************************************
 typedef enum
 {
@@ -169,6 +289,250 @@ typedef struct
 	int				currentROIbin;
 } TYPE_IMAGE_ROI_Info;
 
+//*	compression on readout is turned off after this many frames without a compressed download
+#define	kCompressMaxUnusedFrames	10
+
+//*****************************************************************************
+//*	binned / downscaled copy of the last image, computed once per frame
+//*	color images (RGB24 or debayered RAW) are always stored in RGB order
+#define	kMaxPreviewCache	4
+typedef struct
+{
+	bool			valid;
+	int				binFactor;
+	bool			sumMode;
+	int				width;
+	int				height;
+	int				planes;
+	int				bitDepth;				//*	8 or 16, of the source data
+	uint16_t		*imageData;
+	long			imageBufLen;
+	unsigned char	*jpegData;				//*	compressed copy, made the first time it is asked for
+	unsigned long	jpegLen;
+	uint32_t		lastUsed;
+} TYPE_PREVIEW_IMAGE;
+
+//*****************************************************************************
+//*	results of the star detector, coordinates are in image pixels
+#define	kMaxDetectedStars	256
+typedef struct
+{
+	float			xCenter;				//*	intensity weighted centroid
+	float			yCenter;
+	float			hfr;					//*	half flux radius
+	float			fwhm;					//*	from the second moments
+	float			flux;					//*	background subtracted
+	uint32_t		peakValue;
+	int				pixelCnt;				//*	pixels above the detection threshold
+	float			eccentricity;			//*	from the second moments, 0 is round
+} TYPE_DETECTED_STAR;
+
+typedef struct
+{
+	bool				valid;
+	uint32_t			frameNumber;			//*	cFramesRead when this was done
+	int					width;
+	int					height;
+	double				threshold_sigma;
+	float				background;				//*	median over the tiles
+	float				noise;
+	int					componentCnt;			//*	everything above the threshold
+	int					starCnt;
+	float				medianHFR;
+	float				medianFWHM;
+	float				medianEccentricity;
+	uint32_t			analysisTime_us;
+	TYPE_DETECTED_STAR	stars[kMaxDetectedStars];	//*	brightest first
+} TYPE_STAR_ANALYSIS;
+
+//*****************************************************************************
+//*	per frame quality metrics, computed by a background thread from a copy of
+//*	each saved frame, so frames can be graded without reading them back
+#define	kQuality_QueueLen		4
+#define	kQuality_FitsKeyCnt		8			//*	header space reserved for the keywords added later
+typedef struct
+{
+	uint32_t			frameNumber;
+	struct timeval		exposureStart;
+	uint32_t			exposure_us;
+	char				fitsFileName[128];		//*	empty if there was no FITS file
+	int					starCnt;
+	float				medianHFR;
+	float				medianFWHM;
+	float				medianEccentricity;
+	float				background;
+	float				noise;
+	uint32_t			analysisTime_us;
+} TYPE_FRAME_QUALITY;
+
+typedef struct
+{
+	unsigned char		*imageData;				//*	copy, from the image pool
+	TYPE_IMAGE_TYPE		imageType;
+	int					width;
+	int					height;
+	bool				rawColor;
+	TYPE_FRAME_QUALITY	quality;
+} TYPE_QUALITY_JOB;
+
+typedef struct
+{
+	bool				enabled;
+	bool				keepRunning;
+	bool				threadActive;
+	pthread_t			threadID;
+	pthread_mutex_t		queueMutex;
+	pthread_cond_t		queueCond;
+	TYPE_QUALITY_JOB	queue[kQuality_QueueLen];
+	int					queueHead;
+	int					queueCnt;
+	uint16_t			*monoBuffer;			//*	the star detector's, not shared with the camera thread
+	long				monoBufLen;
+	char				sidecarFileName[64];	//*	one per session, in kImageDataDir
+	TYPE_FRAME_QUALITY	lastResult;
+	uint32_t			framesAnalyzed;
+	uint32_t			framesDropped;			//*	the queue was full
+} TYPE_QUALITY_METRICS;
+
+//*****************************************************************************
+//*	the stretched preview of the last saved image, waiting to be written as JPEGs
+typedef struct
+{
+	bool				threadActive;
+	pthread_t			threadID;
+	unsigned char		*previewData;			//*	8 bit, RGB order, owned by the thread
+	int					width;
+	int					height;
+	int					planes;
+	char				fileNameRoot[256];
+} TYPE_THUMBNAIL_JOB;
+
+#define	kTelemetry_Interval_ms	2000
+
+//*****************************************************************************
+//*	temperature and cooler readings, sampled by the state machine so the
+//*	endpoints (and the image download) do not talk to the camera
+typedef struct
+{
+	bool				valid;					//*	at least one sample has been taken
+	bool				refreshNeeded;			//*	the cooler was changed, sample on the next pass
+	struct timeval		sampleTime;
+	TYPE_ASCOM_STATUS	ccdTempErr;
+	double				ccdTemp_degC;
+	TYPE_ASCOM_STATUS	coolerStateErr;
+	bool				coolerOn;
+	TYPE_ASCOM_STATUS	coolerPowerErr;
+	long				coolerPower;
+	char				lastErrMsg[128];		//*	cLastCameraErrMsg from the last read that failed
+	uint32_t			sample_us;				//*	how long the device calls took
+	uint32_t			sampleCnt;
+} TYPE_SENSOR_TELEMETRY;
+
+//*****************************************************************************
+//*	server side autofocus, uses the linked focuser
+typedef enum
+{
+	kAutoFocus_Idle	=	0,
+	kAutoFocus_MoveFocuser,
+	kAutoFocus_WaitFocuser,
+	kAutoFocus_StartExposure,
+	kAutoFocus_WaitImage,
+	kAutoFocus_MoveToBest,
+	kAutoFocus_WaitBest,
+
+	kAutoFocus_last
+} TYPE_AUTOFOCUS_STATE;
+
+#define	kAutoFocus_MaxSteps		32
+
+typedef struct
+{
+	int32_t			position;
+	float			hfr;					//*	median of the stars in the ROI, 0 if none
+	float			fwhm;
+	int				starCnt;
+	uint32_t		elapsed_ms;				//*	since the run started
+} TYPE_AUTOFOCUS_STEP;
+
+typedef struct
+{
+	TYPE_AUTOFOCUS_STATE	state;
+	bool					useParabola;		//*	default is a hyperbola
+	bool					abortRequested;		//*	set by Action=abort, the state machine does the rest
+	int32_t					startPosition;
+	int32_t					firstPosition;
+	int32_t					maxPosition;		//*	from the focuser, no move goes past it
+	int32_t					stepSize;
+	int32_t					backlash;			//*	overshoot so all moves end going outward
+	bool					overshootFirst;
+	bool					overshootBest;
+	int32_t					targetPosition;
+	int32_t					exposure_us;
+	int						roiPercent;			//*	only stars in the center of the frame are used
+	int						stepCnt;
+	int						stepsDone;
+	uint32_t				frameAtExposure;
+	struct timeval			startTime;
+	struct timeval			stateTime;			//*	for time outs
+	TYPE_AUTOFOCUS_STEP		steps[kAutoFocus_MaxSteps];
+	bool					fitValid;
+	double					fitCenter;
+	double					fitMinHFR;
+	double					fitWidth;			//*	hyperbola b, parabola curvature
+	int32_t					bestPosition;
+	char					statusMsg[80];
+} TYPE_AUTOFOCUS;
+
+//*****************************************************************************
+//*	pipelined sequencer, the next exposure is started as soon as the last one
+//*	is read out, the save runs while the camera is exposing
+#define	kMaxSequenceSteps		16
+
+typedef struct
+{
+	int				frameCnt;
+	int32_t			exposure_us;
+	int				gain;					//*	-1 = leave it alone
+	int				filterPosition;			//*	-1 = leave it alone, 0 based like the Alpaca filter wheel
+} TYPE_SEQUENCE_STEP;
+
+typedef struct
+{
+	bool				active;
+	bool				filterMoving;
+	TYPE_SEQUENCE_STEP	steps[kMaxSequenceSteps];
+	int					stepCnt;
+	int					currentStep;
+	int					framesLeftInStep;		//*	not started yet
+	int					framesStarted;
+	int					framesCompleted;
+	int					framesTotal;
+	int					framesOverlapped;		//*	started before the previous frame was saved
+	int					exposureFailures;
+	uint64_t			startTime_us;			//*	first exposure started
+	uint64_t			endTime_us;				//*	last frame saved
+	uint64_t			exposureSum_us;			//*	completed frames
+	double				dutyCycle;				//*	exposure time / wall time
+	char				statusMsg[80];
+} TYPE_PIPELINE_SEQUENCE;
+
+//*****************************************************************************
+//*	everything the save path looks at that changes when an exposure is started
+typedef struct
+{
+	char				fileNameRoot[256];
+	struct timeval		exposureStartTime;
+	struct timeval		exposureEndTime;
+	int32_t				exposure_us;
+	TYPE_IMAGE_ROI_Info	roiInfo;
+	bool				saveNextImage;
+	TYPE_FRAME_TIMELINE	timeLine;
+	bool				timeLineActive;
+#ifdef _ENABLE_FITS_
+	TYPE_FITS_SNAPSHOT	fitsSnapshot;
+#endif
+} TYPE_SEQUENCE_FRAME_STATE;
+
 //*****************************************************************************
 #define	kImgTypeStrMaxLen	16
 typedef struct
@@ -281,6 +645,8 @@ enum
 	kCmd_Camera_Extras,
 
 	kCmd_Camera_autoexposure,
+	kCmd_Camera_autofocus,
+	kCmd_Camera_calibration,
 	kCmd_Camera_displayimage,
 
 	kCmd_Camera_exposuretime,
@@ -290,14 +656,24 @@ enum
 	kCmd_Camera_fitsheader,
 #endif
 	kCmd_Camera_framerate,
+	kCmd_Camera_frametiming,
 	kCmd_Camera_livemode,
+	kCmd_Camera_livestack,
+	kCmd_Camera_livestackimage,
+	kCmd_Camera_mjpeg,
+	kCmd_Camera_preview,
+	kCmd_Camera_quality,
 	kCmd_Camera_rgbarray,
+	kCmd_Camera_roistream,
 	kCmd_Camera_settelescopeinfo,
 	kCmd_Camera_sidebar,
 	kCmd_Camera_savenextimage,
+	kCmd_Camera_sequence,
+	kCmd_Camera_stars,
 	kCmd_Camera_startsequence,
 	kCmd_Camera_startvideo,
 	kCmd_Camera_stopvideo,
+	kCmd_Camera_thumbnail,
 
 	//*	keep this one last for consistency with other drivers
 	kCmd_Camera_readall,
@@ -324,6 +700,7 @@ class CameraDriver: public AlpacaDriver
 		virtual	int32_t	RunStateMachine(void);
 				int32_t	RunStateMachine_Idle(void);
 				int		RunStateMachine_TakingPicture(void);
+				void	RunStateMachine_AutoFocus(void);
 		virtual	void	RunStateMachine_Device(void);
 
 				void	ProcessExposureOptions(TYPE_GetPutRequestData *reqData);
@@ -334,6 +711,7 @@ class CameraDriver: public AlpacaDriver
 				void	SetInstrumentName(const char *newInstrumentName);
 				void	SetFileNamePrefix(const char *newFNprefix);
 				void	SetFileNameSuffix(const char *newFNprefix);
+				bool	SetFitsCompression(const char *compressionString);
 
 				void	SaveImageData(void);
 				void	SaveNextImage(void);
@@ -387,6 +765,10 @@ class CameraDriver: public AlpacaDriver
 		TYPE_ASCOM_STATUS	Get_ImageReady(			TYPE_GetPutRequestData *reqData, char *alpacaErrMsg,	const char *responseString);
 
 		TYPE_ASCOM_STATUS	Get_Imagearray(			TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+		TYPE_ASCOM_STATUS	Get_ImagearrayCompressed(	TYPE_GetPutRequestData	*reqData,
+														char					*alpacaErrMsg,
+														const char				*compressionString,
+														bool					*binaryDataSent);
 		TYPE_ASCOM_STATUS	Put_StartExposure(		TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
 		TYPE_ASCOM_STATUS	Put_StopExposure(		TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
 		TYPE_ASCOM_STATUS	Put_AbortExposure(		TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
@@ -427,9 +809,78 @@ class CameraDriver: public AlpacaDriver
 		TYPE_ASCOM_STATUS	Get_RGBarray(			TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
 		TYPE_ASCOM_STATUS	Get_Readall(			TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
 
+		TYPE_ASCOM_STATUS	Get_LiveStack(			TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+		TYPE_ASCOM_STATUS	Put_LiveStack(			TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+		TYPE_ASCOM_STATUS	Get_LiveStackImage(		TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+		TYPE_ASCOM_STATUS	Get_AutoFocus(			TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+		TYPE_ASCOM_STATUS	Put_AutoFocus(			TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+		TYPE_ASCOM_STATUS	Get_Calibration(		TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+		TYPE_ASCOM_STATUS	Put_Calibration(		TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+		TYPE_ASCOM_STATUS	Get_Stars(				TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+		TYPE_ASCOM_STATUS	Put_Stars(				TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+		TYPE_ASCOM_STATUS	Get_FrameTiming(		TYPE_GetPutRequestData	*reqData,
+													char					*alpacaErrMsg,
+													bool					*httpHeaderSent,
+													bool					*binaryDataSent);
+		TYPE_ASCOM_STATUS	Put_FrameTiming(		TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+		TYPE_ASCOM_STATUS	Get_ROIstream(			TYPE_GetPutRequestData	*reqData,
+													char					*alpacaErrMsg,
+													bool					*binaryDataSent);
+		TYPE_ASCOM_STATUS	Put_ROIstream(			TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+		TYPE_ASCOM_STATUS	Get_MJPEGstream(		TYPE_GetPutRequestData	*reqData,
+													char					*alpacaErrMsg,
+													bool					*binaryDataSent);
+		TYPE_ASCOM_STATUS	Get_Preview(			TYPE_GetPutRequestData	*reqData,
+													char					*alpacaErrMsg,
+													bool					*httpHeaderSent,
+													bool					*binaryDataSent);
+		TYPE_ASCOM_STATUS	Get_Thumbnail(			TYPE_GetPutRequestData	*reqData,
+													char					*alpacaErrMsg,
+													bool					*binaryDataSent);
+		TYPE_ASCOM_STATUS	Get_Sequence(			TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+		TYPE_ASCOM_STATUS	Put_Sequence(			TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+		TYPE_ASCOM_STATUS	Get_Quality(			TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+		TYPE_ASCOM_STATUS	Put_Quality(			TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
+
 				bool	AllcateImageBuffer(long bufferSize);
+				unsigned char	*CopyCameraData(const long dataLen);
 
 				void	WriteFireCaptureTextFile(void);
+				bool	OpenSERvideoFile(void);
+				void	CloseSERvideoFile(void);
+				void	OfferFrameToLiveStack(void);
+				void	BuildCalibrationKey(TYPE_CALIB_KEY *calibKey, TYPE_CALIB_TYPE calibType);
+				void	ApplyCalibration(void);
+				unsigned char	*GetDebayeredImage(const bool bgrOrder);
+				bool	IsRawColorImage(void);
+				void	SendBinaryHttpHeader(	const int socketFD, const char *contentType, const long contentLength);
+				void	SendImageBytesHeader(	const int	socketFD,
+												const int	imageElementType,
+												const int	transmissionElementType,
+												const int	width,
+												const int	height,
+												const int	planes,
+												const long	dataLength);
+				TYPE_PREVIEW_IMAGE	*GetPreviewImage(const int binFactor, const bool sumMode);
+				TYPE_PREVIEW_IMAGE	*BuildPreviewImage(const int binFactor, const bool sumMode);
+				bool	GetPreviewSource(	unsigned char	**sourceData,
+											int				*sourceWidth,
+											int				*sourceHeight,
+											int				*bytesPerPixel,
+											int				*planes,
+											bool			*swapRedBlue);
+				TYPE_IMAGE_PYRAMID	*GetImagePyramid(void);
+				void	ClearPreviewCache(void);
+				void	Send_imagearray_preview(const int socketFD, TYPE_PREVIEW_IMAGE *preview);
+				bool	CreatePreviewJpeg(TYPE_PREVIEW_IMAGE *preview);
+				void	SaveThumbnails(void);
+				void	GetThumbnailStretch(const int bitDepth, int *blackPoint, int *whitePoint);
+				void	GetThumbnailFilePath(	const char	*fileNameRoot,
+												const char	*suffix,
+												char		*filePath,
+												const int	filePathSize);
+				void	WaitForThumbnailThread(void);
+				bool	CompressImageData(void);
 				void	GenerateFileNameRoot(void);
 
 				void	SetImageTypeIndex(const int alpacaImgTypeIdx, const char *imageTypeString);
@@ -475,13 +926,35 @@ class CameraDriver: public AlpacaDriver
 				int		ExtractFitsHeader(fitsfile *fitsFilePtr);
 				TYPE_FITS_RECORD	cFitsHeader[kMaxFitsRecords];
 
+				void	InitFitsSnapshot(void);
+				void	StartFitsSnapshotThread(void);
+				void	StopFitsSnapshotThread(void);
+				bool	FitsSnapshotIsStale(void);
+				void	UpdateFitsSnapshot(TYPE_FITS_SNAPSHOT *snapshot);
+				void	BuildFitsSnapshot(void);
+				void	RefreshFitsSnapshot(void);
+				void	InvalidateFitsSnapshot(void);
+				void	CaptureFitsSnapshot(void);
+				void	ResolveFrameFitsSnapshot(void);
+				void	WriteFITS_Snapshot(fitsfile *fitsFilePtr);
+				pthread_t			cFitsSnapshotThreadID;
+				pthread_mutex_t		cFitsSnapshotMutex;		//*	the snapshot thread swaps it in, Put_StartExposure copies it
+				pthread_cond_t		cFitsSnapshotCond;
+				bool				cFitsSnapshotThreadEnabled;
+				bool				cFitsSnapshotThreadActive;
+				bool				cFitsSnapshotKeepRunning;
+				uint32_t			cFitsSnapshotBuildCnt;		//*	builds started
+				uint32_t			cFitsSnapshotBuildWanted;	//*	an exposure needs this build
+				TYPE_FITS_SNAPSHOT	cFitsSnapshot;			//*	kept up to date by the snapshot thread
+				TYPE_FITS_SNAPSHOT	cFrameFitsSnapshot;		//*	copy taken at the start of the exposure
+
 			#endif // _ENABLE_FITS_
 			#ifdef _ENABLE_JPEGLIB_
 				void	SaveUsingJpegLib(void);
 			#endif	//	_ENABLE_JPEGLIB_
 				void	SaveUsingPNGlib(void);
 
-				void	AutoAdjustExposure(void);
+				void	AutoAdjustExposure(const unsigned char *imageData = NULL, const int settleFrames = 0);
 				void	CheckPulseGuiding(void);
 
 	public:
@@ -490,6 +963,8 @@ class CameraDriver: public AlpacaDriver
 		void			DisplayLiveImage_wSideBar(void);
 		void			DrawSidebar(IplImage *imageDisplay);
 		int				CreateOpenCVImage(const unsigned char *imageDataPtr);
+		IplImage		*CreatePooledOpenCVImage(const int width, const int height, const int depth, const int channels);
+		void			ReleasePooledOpenCVImage(IplImage **openCVimage);
 		int				SaveOpenCVImage(void);
 		void			SetOpenCVcallbackFunction(const char *windowName);
 		void			ProcessMouseEvent(int event, int xxx, int yyy, int flags);
@@ -497,6 +972,7 @@ class CameraDriver: public AlpacaDriver
 		void			CreateHistogramGraph(IplImage *imageDisplay);
 		void			SetOpenCVcolors(IplImage *imageDisplay);
 		void			Draw3TextStrings(IplImage *theImage, const char *textStr1, const char *textStr2, const char *textStr3);
+		bool			CopyPyramidToOpenCV(IplImage *displayImage);
 
 	#endif	//	_USE_OPENCV_
 		//*****************************************************************************
@@ -518,6 +994,12 @@ class CameraDriver: public AlpacaDriver
 		virtual	TYPE_ASCOM_STATUS		Start_CameraExposure(int32_t exposureMicrosecs);
 		virtual	TYPE_ASCOM_STATUS		Stop_Exposure(void);
 		virtual	TYPE_EXPOSURE_STATUS	Check_Exposure(bool verboseFlag = false);
+		virtual	TYPE_EXPOSURE_STATUS	Wait_ExposureComplete(void);
+				void					RunCaptureThread(void);
+			#ifdef _ENABLE_FITS_
+				void					RunFitsSnapshotThread(void);
+			#endif
+				void					SignalCaptureEvent(void);
 
 		virtual	TYPE_ASCOM_STATUS	SetImageTypeCameraOpen(TYPE_IMAGE_TYPE newImageType);
 		virtual	TYPE_ASCOM_STATUS	SetImageType(TYPE_IMAGE_TYPE newImageType);
@@ -530,6 +1012,15 @@ class CameraDriver: public AlpacaDriver
 		virtual	TYPE_ASCOM_STATUS	Stop_Video(void);
 		virtual	TYPE_ASCOM_STATUS	Take_Video(void);
 
+		virtual	TYPE_ASCOM_STATUS	Start_ROIstream(void);
+		virtual	TYPE_ASCOM_STATUS	Read_ROIframe(const uint32_t timeout_ms);
+		virtual	TYPE_ASCOM_STATUS	Stop_ROIstream(void);
+				void				RunROIstreamThread(void);
+				void				RunMJPEGstreamThread(void);
+				void				RunQualityThread(void);
+				void				WriteThumbnailFiles(void);
+				void				PostROIframe(void);
+
 		virtual	TYPE_ALPACA_CAMERASTATE		Read_AlapcaCameraState(void);
 
 
@@ -541,6 +1032,10 @@ class CameraDriver: public AlpacaDriver
 		virtual	TYPE_ASCOM_STATUS	Read_SensorTemp(void);
 		virtual	TYPE_ASCOM_STATUS	Read_CoolerState(bool *coolerOnOff);
 		virtual	TYPE_ASCOM_STATUS	Read_CoolerPowerLevel(void);
+				bool				SensorTelemetryIsStale(void);
+				void				UpdateSensorTelemetry(void);
+				int32_t				GetSensorTelemetry(TYPE_SENSOR_TELEMETRY *telemetry);
+				void				AddSensorTelemetryAge(TYPE_GetPutRequestData *reqData);
 		virtual	TYPE_ASCOM_STATUS	Read_Readoutmodes(char *readOutModeString, bool includeQuotes=false);
 		virtual	TYPE_ASCOM_STATUS	Read_Fastreadout(void);
 		virtual	TYPE_ASCOM_STATUS	Read_ImageData(void);
@@ -644,6 +1139,8 @@ protected:
 	double		cCameraTemp_Dbl;			//*	deg C
 	long		cCoolerPowerLevel;
 	long		cCoolerState;
+	TYPE_SENSOR_TELEMETRY	cTelemetry;
+	pthread_mutex_t			cTelemetryMutex;
 	char		cLastCameraErrMsg[128];
 
 
@@ -685,6 +1182,27 @@ protected:
 	long				cCameraDataBuffLen;
 	unsigned char		*cCameraDataBuffer;
 	unsigned char		*cCameraBGRbuffer;			//*	Blue, Green, Red, for FITS
+	pthread_mutex_t		cCameraDataMutex;			//*	recursive, held while cCameraDataBuffer is written (readout,
+													//*	calibration) and by other threads while they read it
+
+	//*	debayered copy of cCameraDataBuffer, made on demand, one per frame
+	unsigned char		*cDebayerBuffer;
+	long				cDebayerBufLen;
+	bool				cDebayerValid;				//*	cleared every time a new frame is read
+	bool				cDebayerBGR;				//*	byte order of what is in cDebayerBuffer
+	TYPE_DEBAYER_METHOD	cDebayerMethod;
+
+	TYPE_PREVIEW_IMAGE	cPreviewCache[kMaxPreviewCache];
+	pthread_mutex_t		cPreviewMutex;				//*	recursive, the preview cache, the pyramid and the debayer buffer,
+													//*	held while a preview is built and copied, never while sending
+	uint32_t			cPreviewUseCounter;
+	TYPE_IMAGE_PYRAMID	cImagePyramid;				//*	built the first time it is asked for, each frame
+
+	//*	Rice compressed copy of the last frame, downloads come from the listen thread
+	TYPE_COMPRESSED_IMAGE	cCompressedImage;
+	pthread_mutex_t			cCompressMutex;
+	bool					cCompressOnReadout;			//*	set once a client asks for compression
+	int						cCompressUnusedCnt;			//*	frames compressed since the last download
 
 	int					cAVIfourcc;					//*	the fourCC mode used in the avi file
 
@@ -694,7 +1212,8 @@ protected:
 	int					cExposureFailureCnt;
 
 	bool				cAutoAdjustExposure;		//*	true if we are doing auto exposure
-	long				cAutoAdjustStepSz_us;		//*	step size in micro seconds
+	long				cAutoAdjustStepSz_us;		//*	smallest change auto exposure will make, micro seconds
+	TYPE_AUTOEXPOSURE	cAutoExposure;				//*	predictive model, see autoexposure.c
 	TYPE_IMAGE_MODE		cImageMode;
 	uint32_t			cSequenceDelay_us;			//*	sequence delay in microseconds
 	int32_t				cSeqDeltaExposure_us;
@@ -718,6 +1237,16 @@ protected:
 	uint32_t			cVideoStartTime;			//*	time video was started for frame rate calculations (seconds)
 	bool				cVideoCreateTimeStampFile;
 	FILE				*cVideoTimeStampFilePtr;
+	TYPE_SER_WRITER		*cSERwriter;				//*	NULL unless video is being recorded
+	bool				cVideoUseDirectIO;			//*	open the SER file with O_DIRECT
+	uint32_t			cVideoFramesDropped;		//*	frames the writer could not keep up with
+
+	//*	server side live stacking, runs on its own thread
+	TYPE_LIVESTACK		cLiveStack;
+
+	//*	master bias/dark/flat frames, applied to the image data as soon as it is read
+	TYPE_CALIB_LIBRARY	cCalibLibrary;
+	bool				cCalibrationEnabled;
 
 	//*	these items are stored on a per camera basis for the purpose of responding
 	//*	to some of the Alpaca requests
@@ -741,6 +1270,7 @@ protected:
 	bool				cFN_includeManuf;
 	bool				cFN_includeFilter;
 	bool				cFN_includeRefID;
+	TYPE_FITS_COMPRESSION	cFitsCompression;		//*	from the telescope settings or filenameoptions
 
 	char				cObjectName[kObjectNameMaxLen + 1];
 	char				cFileNameRoot[256];
@@ -829,6 +1359,7 @@ protected:
 	bool				cFilterWheelInfoValid;
 
 	void			AddToDataProductsList(const char *newDataProductName, const char *newDatacomment=NULL);
+	void			CatalogSavedFile(const char *fileName);
 	TYPE_FILENAME	cOtherDataProducts[kMaxDataProducts];
 	int				cOtherDataCnt;
 
@@ -837,6 +1368,8 @@ protected:
 	//*****************************************************************************
 	//*	image analysis data
 	void		CalculateHistogramArray(void);
+	void		CalculateHistogramFromPyramid(void);
+	void		FindHistogramPeaks(void);
 	void		SaveHistogramFile(void);
 
 	int32_t		cHistogramLum[256];
@@ -855,6 +1388,124 @@ protected:
 
 #endif // _INCLUDE_HISTOGRAM_
 
+	//*****************************************************************************
+	//*	star detection
+	bool				DetectStars(void);
+	bool				DetectStarsInImage(	const unsigned char		*imageData,
+											const TYPE_IMAGE_TYPE	imageType,
+											const int				imageWidth,
+											const int				imageHeight,
+											const bool				rawColor,
+											const uint32_t			frameNumber,
+											const int				maxJobs,
+											uint16_t				**monoBuffer,
+											long					*monoBufLen,
+											TYPE_STAR_ANALYSIS		*result);
+	const uint16_t		*GetStarDetectImage(const unsigned char		*imageData,
+											const TYPE_IMAGE_TYPE	imageType,
+											const bool				rawColor,
+											uint16_t				**monoBuffer,
+											long					*monoBufLen,
+											int						*width,
+											int						*height,
+											int						*scale);
+
+	TYPE_STAR_ANALYSIS	cStarAnalysis;
+	pthread_mutex_t		cStarMutex;					//*	DetectStars() writes cStarAnalysis under it
+	bool				cStarDetectEnabled;			//*	run on every frame
+	double				cStarDetectSigma;			//*	detection threshold above the background
+	uint16_t			*cStarMonoBuffer;			//*	16 bit mono copy when the data is not already
+	long				cStarMonoBufLen;
+
+	//*****************************************************************************
+	//*	autofocus
+	void				AutoFocus_Finish(const char *statusMsg, const bool moveToStart);
+	bool				AutoFocus_FitCurve(void);
+	float				AutoFocus_MeasureHFR(float *fwhm, int *starCnt);
+	TYPE_AUTOFOCUS		cAutoFocus;
+
+	//*****************************************************************************
+	//*	pipelined sequencer
+	TYPE_ASCOM_STATUS	Pipeline_Start(const char *stepsString, char *alpacaErrMsg);
+	void				Pipeline_Stop(const char *statusMsg);
+	bool				Pipeline_NextFrameNeedsSetup(void);
+	bool				Pipeline_SetupStep(void);
+	TYPE_ASCOM_STATUS	Pipeline_StartExposure(void);
+	void				Pipeline_RunIdle(void);
+	bool				Pipeline_StartOverlapped(void);
+	void				Pipeline_FrameDone(const bool frameOK);
+	void				Pipeline_SaveFrameState(TYPE_SEQUENCE_FRAME_STATE *frameState);
+	void				Pipeline_RestoreFrameState(TYPE_SEQUENCE_FRAME_STATE *frameState);
+
+	TYPE_PIPELINE_SEQUENCE		cPipeline;
+	TYPE_SEQUENCE_FRAME_STATE	cPipelineNextFrame;		//*	the exposure that is running while the last one is saved
+	TYPE_SEQUENCE_FRAME_STATE	cPipelineSavedFrame;
+
+	//*****************************************************************************
+	//*	latency timeline, monotonic time stamps for each stage of each frame
+	TYPE_FRAME_TIMING	cFrameTiming;
+
+	//*****************************************************************************
+	//*	capture thread, waits on the SDK and reads out the image
+	void				InitCaptureThread(void);
+	void				StartCaptureThread(void);
+	void				StopCaptureThread(void);
+	void				ClearCaptureResult(void);
+	void				RequestCapture(void);
+	bool				CaptureReadoutActive(void);
+
+	pthread_t				cCaptureThreadID;
+	pthread_mutex_t			cCaptureMutex;
+	pthread_cond_t			cCaptureCond;
+	bool					cCaptureThreadEnabled;
+	bool					cCaptureThreadActive;
+	bool					cCaptureKeepRunning;
+	bool					cCaptureEventDriven;		//*	the driver calls SignalCaptureEvent() when the image is ready
+	bool					cCaptureEventPending;		//*	set by SDK callbacks, abort and stop
+	bool					cCaptureRequested;			//*	set by the state machine, one per exposure
+	bool					cCaptureBusy;				//*	the thread is working on a request
+	bool					cCaptureReadingOut;			//*	exposure time is up, until Read_ImageData() is done
+	TYPE_EXPOSURE_STATUS	cCaptureResult;				//*	kExposure_Working until the thread posts a result
+	TYPE_ASCOM_STATUS		cCaptureReadErrCode;		//*	from Read_ImageData()
+
+	//*****************************************************************************
+	//*	ROI streaming, continuous capture of a small window pushed to subscribers
+	void				InitROIstream(void);
+	TYPE_ASCOM_STATUS	StartROIstream(char *alpacaErrMsg);
+	void				StopROIstream(void);
+	bool				AddROIsubscriber(const int socket);
+
+	TYPE_ROI_STREAM		cROIstream;
+
+	//*****************************************************************************
+	//*	MJPEG live view, each new image is encoded once and pushed to the subscribers
+	void				InitMJPEGstream(void);
+	void				StopMJPEGstream(void);
+	bool				AddMJPEGsubscriber(const int socket, const int binFactor);
+	void				OfferFrameToMJPEG(void);
+	void				ReleaseMJPEGscale(const int scaleIdx);
+
+	TYPE_MJPEG_STREAM	cMJPEGstream;
+
+	//*****************************************************************************
+	//*	frame quality metrics, a copy of each saved frame is analyzed by a background thread
+	void				InitQualityMetrics(void);
+	TYPE_ASCOM_STATUS	StartQualityMetrics(char *alpacaErrMsg);
+	void				StopQualityMetrics(void);
+	void				DisableQualityMetrics(void);
+	void				ReleaseQualityQueue(void);
+	void				QueueQualityAnalysis(void);
+	void				AnalyzeQualityJob(TYPE_QUALITY_JOB *qualityJob);
+	void				WriteQualitySidecar(const TYPE_FRAME_QUALITY *quality);
+	void				WriteQualityFitsKeywords(const TYPE_FRAME_QUALITY *quality);
+
+	TYPE_QUALITY_METRICS	cQualityMetrics;
+	char					cLastFitsFileName[128];		//*	the last FITS file saved, in kImageDataDir
+
+	//*****************************************************************************
+	//*	thumbnail and stretched preview JPEGs, written by a thread after each save
+	TYPE_THUMBNAIL_JOB		cThumbnailJob;
+
 };
 
 
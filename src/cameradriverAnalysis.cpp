@@ -44,12 +44,27 @@
 //*	Dec 26,	2019	<MLS> Added SaveHistogramFile()
 //*	Jan 12,	2020	<MLS> Added better limit checking to AutoAdjustExposure()
 //*	Feb 15,	2020	<MLS> Fixed negative exposure bug in AutoAdjustExposure()
+//*	Feb 17,	2021	<MLS> Added DetectStars(), tile background, connected components, HFR/FWHM
+//*	Feb 17,	2021	<MLS> Star detection runs on multiple threads
+//*	Mar 16,	2021	<MLS> AutoAdjustExposure() now uses the predictive model in autoexposure.c
+//*	Mar 18,	2021	<MLS> Added CalculateHistogramFromPyramid() for the live view side bar
+//*	Mar 26,	2021	<MLS> Added DetectStarsInImage(), works on any buffer, used by the quality thread
+//*	Mar 26,	2021	<MLS> Star eccentricity from the second moments
+//*	Mar 30,	2021	<MLS> CalculateHistogramFromPyramid() holds cPreviewMutex while it reads the pyramid
+//*	Mar 30,	2021	<MLS> AutoAdjustExposure() uses cAutoAdjustStepSz_us again, added settleFrames
+//*	Mar 30,	2021	<MLS> DetectStars() holds cStarMutex, Get_Stars() reads a copy
+//*	Mar 30,	2021	<MLS> CalculateHistogramFromPyramid() counts from a copy of the level
 //**************************************************************************
 
 #ifdef _ENABLE_CAMERA_
 
 #include	<stdio.h>
+#include	<stdlib.h>
 #include	<string.h>
+#include	<math.h>
+#include	<unistd.h>
+#include	<pthread.h>
+#include	<sys/time.h>
 
 #if defined(__arm__)
 	#include <wiringPi.h>
@@ -391,149 +406,63 @@ uint32_t		maxPixelValue;
 
 
 //*****************************************************************************
-void	CameraDriver::AutoAdjustExposure(void)
+//*	the statistics come from a subsample of the pixels, cheap enough to run on
+//*	every frame, video frames included.
+//*	imageData can be a video frame that is not in the image buffer,
+//*	NULL means use cCameraDataBuffer.
+//*	settleFrames is how many frames are already taken when the exposure is changed,
+//*	0 for single frames
+//*****************************************************************************
+void	CameraDriver::AutoAdjustExposure(const unsigned char *imageData, const int settleFrames)
 {
-//uint32_t	maxPixelValue;
-float			saturationPrct;
-float			histogrmMaxPrct;
-float			histogramErr;
-long			exposureAdjustment_us;	//*	micro-seconds
+TYPE_AUTOEXP_STATS	stats;
+int					bytesPerPixel;
+int					planes;
+bool				validStats;
 
 //	CONSOLE_DEBUG(__FUNCTION__);
 
-	saturationPrct	=	CalculateSaturation();
-	histogrmMaxPrct	=	CalculateHistogramMax();
-//	CONSOLE_DEBUG_W_DBL("saturationPrct\t=",	saturationPrct);
-
-	if ((histogrmMaxPrct >= 90.0) && (histogrmMaxPrct < 100.0))
+	if (imageData == NULL)
 	{
-		CONSOLE_DEBUG_W_DBL("PERFECT: Histogram %\t=",	histogrmMaxPrct);
+		imageData	=	cCameraDataBuffer;
 	}
-	else if (saturationPrct > 0.0)
+	switch(cROIinfo.currentROIimageType)
 	{
-		exposureAdjustment_us	=	1;
-		if (saturationPrct > 50.0)
-		{
-			//*	reduce by 1/2
-			exposureAdjustment_us	=	cCurrentExposure_us / 2;
-		}
-		else if (saturationPrct > 40.0)
-		{
-			//*	subtract 33%
-			exposureAdjustment_us	=	(cCurrentExposure_us / 3);
-		}
-		else if (saturationPrct > 20.0)
-		{
-			//*	subtract 25%
-			exposureAdjustment_us	=	(cCurrentExposure_us / 4);
-		}
-		else if (saturationPrct > 5.0)
-		{
-			//*	subtract 10%
-			exposureAdjustment_us	=	(cCurrentExposure_us / 10);
-		}
-		else if (saturationPrct > 1.0)
-		{
-			//*	subtract 5%
-			exposureAdjustment_us	=	(cCurrentExposure_us / 20);
-		}
-		else if (saturationPrct > 0.5)
-		{
-			//*	subtract 2%
-			exposureAdjustment_us	=	(cCurrentExposure_us / 50);
-		}
-		else if (saturationPrct > 0.1)
-		{
-			//*	subtract 1%
-			exposureAdjustment_us	=	(cCurrentExposure_us / 100);
-		}
-		else if (saturationPrct > 0.01)
-		{
-			//*	subtract 0.5%
-			exposureAdjustment_us	=	(cCurrentExposure_us / 200);
-		}
-		else if (saturationPrct > 0.001)
-		{
-			//*	subtract 0.2%
-			exposureAdjustment_us	=	(cCurrentExposure_us / 500);
-		}
-		else if (saturationPrct > 0.0001)
-		{
-			//*	subtract 0.1%
-			exposureAdjustment_us	=	(cCurrentExposure_us / 1000);
-		}
+		case kImageType_RAW16:
+			bytesPerPixel	=	2;
+			planes			=	1;
+			break;
 
+		case kImageType_RGB24:
+			bytesPerPixel	=	1;
+			planes			=	3;
+			break;
 
-		if (exposureAdjustment_us < cAutoAdjustStepSz_us)
-		{
-			exposureAdjustment_us	=	cAutoAdjustStepSz_us;
-		}
-//		CONSOLE_DEBUG_W_INT32("exposureAdjustment_us\t=",	exposureAdjustment_us);
-		cCurrentExposure_us	-=	exposureAdjustment_us;
-		if ((cCurrentExposure_us < cExposureMin_us) || (cCurrentExposure_us < 0))
-		{
-			cCurrentExposure_us	=	cExposureMin_us;
-			//*	now double check
-			if (cCurrentExposure_us < 1)
-			{
-				cCurrentExposure_us	=	1;
-			}
-		}
+		case kImageType_RAW8:
+		case kImageType_Y8:
+		default:
+			bytesPerPixel	=	1;
+			planes			=	1;
+			break;
 	}
-	else
-	{
-	double	curExposure_secs;
-	double	newExposure_secs;
-	double	deltaExposure_secs;
-
-		histogramErr	=	95.0 - histogrmMaxPrct;
-
-		if (histogramErr > 0.0)
-		{
-//			CONSOLE_DEBUG_W_DBL("histogrmMaxPrct\t=",	histogrmMaxPrct);
-//			CONSOLE_DEBUG_W_DBL("histogramErr\t=",	histogramErr);
-			curExposure_secs	=	(1.0 * cCurrentExposure_us) / 1000000.0;
-			deltaExposure_secs	=	(histogramErr / 100.0) * curExposure_secs;
-			newExposure_secs	=	curExposure_secs + deltaExposure_secs;
-//			CONSOLE_DEBUG_W_DBL("curExposure_secs\t=",	curExposure_secs);
-//			CONSOLE_DEBUG_W_DBL("newExposure_secs\t=",	newExposure_secs);
-			cCurrentExposure_us	=	newExposure_secs * 1000000;
-
-		}
-		else if (histogrmMaxPrct < 5.0)
-		{
-			//*	double
-			cCurrentExposure_us	+=	cCurrentExposure_us;
-		}
-		else if (histogrmMaxPrct < 30.0)
-		{
-			cCurrentExposure_us	+=	(5 * cAutoAdjustStepSz_us);
-		}
-		else if (histogrmMaxPrct < 85.0)
-		{
-			cCurrentExposure_us	+=	cAutoAdjustStepSz_us;
-		}
-
-		//*	check the limits
-		if (cCurrentExposure_us < cExposureMin_us)
-		{
-			cCurrentExposure_us	=	cExposureMin_us;
-		}
-		if (cCurrentExposure_us > cExposureMax_us)
-		{
-			cCurrentExposure_us	=	cExposureMax_us;
-		}
-
-		//*	now check the EXTREAME limits
-		if (cCurrentExposure_us < 0)
-		{
-			cCurrentExposure_us	=	100;
-		}
-		if (cCurrentExposure_us > (10 * 60 * 1000 * 1000))	//*	10 minutes
-		{
-			cCurrentExposure_us	=	10 * 60 * 1000 * 1000;
-		}
 
+	cAutoExposure.settleFrames		=	settleFrames;
+	cAutoExposure.minStep_us		=	(cAutoAdjustStepSz_us > 0) ? cAutoAdjustStepSz_us : 1;
+	cAutoExposure.minExposure_us	=	(cExposureMin_us > 0) ? cExposureMin_us : 1;
+	if ((cExposureMax_us > cAutoExposure.minExposure_us) && (cExposureMax_us < 0x7fffffff))
+	{
+		cAutoExposure.maxExposure_us	=	cExposureMax_us;
+	}
+	validStats	=	AutoExposure_SampleImage(	imageData,
+												cROIinfo.currentROIwidth,
+												cROIinfo.currentROIheight,
+												bytesPerPixel,
+												planes,
+												cAutoExposure.targetPercentile,
+												&stats);
+	if (validStats)
+	{
+		cCurrentExposure_us	=	AutoExposure_Predict(&cAutoExposure, cCurrentExposure_us, &stats);
 	}
 //	CONSOLE_DEBUG_W_INT32("cCurrentExposure_us\t=",	cCurrentExposure_us);
 }
@@ -553,9 +482,6 @@ int32_t			redValue;
 int32_t			grnValue;
 int32_t			bluValue;
 int32_t			lumValue;		//*	luminance value
-int32_t			peakPixelIdx;
-int32_t			peakPixelCount;
-bool			lookingForMin;
 
 	SETUP_TIMING();
 
@@ -657,66 +583,184 @@ bool			lookingForMin;
 				break;
 
 		}
-		//*	now go through the array and find the peak value and max value
-		peakPixelIdx		=	-1;
-		peakPixelCount		=	0;
-		lookingForMin		=	true;
-		for (ii=0; ii<256; ii++)
-		{
-			//*	find the minimum value
-			if (lookingForMin && (cHistogramLum[ii] > 0))
-			{
-				cMinHistogramValue	=	ii;
-				lookingForMin		=	false;
-			}
-			//*	find the maximum value
-			if (cHistogramLum[ii] > 0)
-			{
-				cMaxHistogramValue	=	ii;
-			}
+		FindHistogramPeaks();
 
-			//*	find the peak value
-			if (cHistogramLum[ii] > peakPixelCount)
-			{
-				peakPixelIdx	=	ii;
-				peakPixelCount	=	cHistogramLum[ii];
-			}
+		DEBUG_TIMING("Time to save calculate histogram file (milliseconds)\t=");
+	}
+	else
+	{
+		CONSOLE_DEBUG("cCameraDataBuffer is NULL");
+	}
+}
 
+//*****************************************************************************
+//*	min, max and peak of the histogram arrays, the arrays must already be filled in
+//*****************************************************************************
+void	CameraDriver::FindHistogramPeaks(void)
+{
+int32_t			ii;
+int32_t			peakPixelIdx;
+int32_t			peakPixelCount;
+bool			lookingForMin;
 
+	//*	go through the array and find the peak value and max value
+	peakPixelIdx		=	-1;
+	peakPixelCount		=	0;
+	lookingForMin		=	true;
+	for (ii=0; ii<256; ii++)
+	{
+		//*	find the minimum value
+		if (lookingForMin && (cHistogramLum[ii] > 0))
+		{
+			cMinHistogramValue	=	ii;
+			lookingForMin		=	false;
+		}
+		//*	find the maximum value
+		if (cHistogramLum[ii] > 0)
+		{
+			cMaxHistogramValue	=	ii;
 		}
-		cPeakHistogramValue	=	peakPixelIdx;
 
-		//*	look for maximum pixel counts
-		//*	purposely skip the first and last
-		cMaxHistogramPixCnt	=	0;
+		//*	find the peak value
+		if (cHistogramLum[ii] > peakPixelCount)
+		{
+			peakPixelIdx	=	ii;
+			peakPixelCount	=	cHistogramLum[ii];
+		}
+
+
+	}
+	cPeakHistogramValue	=	peakPixelIdx;
+
+	//*	look for maximum pixel counts
+	//*	purposely skip the first and last
+	cMaxHistogramPixCnt	=	0;
 //		for (ii=5; ii<250; ii++)
 //		for (ii=1; ii<255; ii++)
-		for (ii=0; ii<256; ii++)
+	for (ii=0; ii<256; ii++)
+	{
+		if (cHistogramLum[ii] > cMaxHistogramPixCnt)
 		{
-			if (cHistogramLum[ii] > cMaxHistogramPixCnt)
-			{
-				cMaxHistogramPixCnt	=	cHistogramLum[ii];
-			}
-			if (cHistogramRed[ii] > cMaxHistogramPixCnt)
+			cMaxHistogramPixCnt	=	cHistogramLum[ii];
+		}
+		if (cHistogramRed[ii] > cMaxHistogramPixCnt)
+		{
+			cMaxHistogramPixCnt	=	cHistogramRed[ii];
+		}
+		if (cHistogramGrn[ii] > cMaxHistogramPixCnt)
+		{
+			cMaxHistogramPixCnt	=	cHistogramGrn[ii];
+		}
+		if (cHistogramBlu[ii] > cMaxHistogramPixCnt)
+		{
+			cMaxHistogramPixCnt	=	cHistogramBlu[ii];
+		}
+	}
+}
+
+//*****************************************************************************
+//*	same arrays as CalculateHistogramArray(), but from the first pyramid level.
+//*	1/4 of the pixels, good enough for the display and it does not touch the full frame.
+//*	the counts are 1/4 of the full frame counts
+//*****************************************************************************
+void	CameraDriver::CalculateHistogramFromPyramid(void)
+{
+TYPE_IMAGE_PYRAMID	*pyramid;
+const uint16_t		*levelPtr;
+uint16_t			*levelCopy;
+int					planes;
+long				pixelCnt;
+long				ii;
+int					shiftCount;
+int32_t				redValue;
+int32_t				grnValue;
+int32_t				bluValue;
+int32_t				lumValue;
+
+	//*	the pyramid can be rebuilt or freed by the other threads
+	pthread_mutex_lock(&cPreviewMutex);
+	pyramid	=	GetImagePyramid();
+	if (pyramid == NULL)
+	{
+		pthread_mutex_unlock(&cPreviewMutex);
+		CalculateHistogramArray();
+		return;
+	}
+	//*	the level is copied out, the counting runs without the mutex
+	planes		=	pyramid->planes;
+	pixelCnt	=	(long)pyramid->width[0] * pyramid->height[0];
+	shiftCount	=	pyramid->bitDepth - 8;
+	levelCopy	=	(uint16_t *)malloc(pixelCnt * planes * sizeof(uint16_t));
+	if (levelCopy != NULL)
+	{
+		memcpy(levelCopy, pyramid->levelData[0], (pixelCnt * planes * sizeof(uint16_t)));
+	}
+	pthread_mutex_unlock(&cPreviewMutex);
+	if (levelCopy == NULL)
+	{
+		CalculateHistogramArray();
+		return;
+	}
+
+	cPeakHistogramValue	=	0;
+	cMaxHistogramValue	=	0;
+	cMaxHistogramPixCnt	=	0;
+	cMaxRedValue		=	0;
+	cMaxGrnValue		=	0;
+	cMaxBluValue		=	0;
+	cMaxGryValue		=	0;
+
+	memset(cHistogramLum,	0,	sizeof(cHistogramLum));
+	memset(cHistogramRed,	0,	sizeof(cHistogramRed));
+	memset(cHistogramGrn,	0,	sizeof(cHistogramGrn));
+	memset(cHistogramBlu,	0,	sizeof(cHistogramBlu));
+
+	levelPtr	=	levelCopy;
+	if (planes == 3)
+	{
+		for (ii=0; ii<pixelCnt; ii++)
+		{
+			//*	the pyramid is in RGB order
+			redValue	=	(levelPtr[0] >> shiftCount) & 0x00ff;
+			grnValue	=	(levelPtr[1] >> shiftCount) & 0x00ff;
+			bluValue	=	(levelPtr[2] >> shiftCount) & 0x00ff;
+			cHistogramRed[redValue]++;
+			cHistogramGrn[grnValue]++;
+			cHistogramBlu[bluValue]++;
+			if (redValue > cMaxRedValue)
 			{
-				cMaxHistogramPixCnt	=	cHistogramRed[ii];
+				cMaxRedValue	=	redValue;
 			}
-			if (cHistogramGrn[ii] > cMaxHistogramPixCnt)
+			if (grnValue > cMaxGrnValue)
 			{
-				cMaxHistogramPixCnt	=	cHistogramGrn[ii];
+				cMaxGrnValue	=	grnValue;
 			}
-			if (cHistogramBlu[ii] > cMaxHistogramPixCnt)
+			if (bluValue > cMaxBluValue)
 			{
-				cMaxHistogramPixCnt	=	cHistogramBlu[ii];
+				cMaxBluValue	=	bluValue;
 			}
+			levelPtr	+=	3;
+		}
+		for (ii=0; ii<256; ii++)
+		{
+			lumValue			=	cHistogramRed[ii] + cHistogramGrn[ii] + cHistogramBlu[ii];
+			cHistogramLum[ii]	=	lumValue / 3;
 		}
-
-		DEBUG_TIMING("Time to save calculate histogram file (milliseconds)\t=");
 	}
 	else
 	{
-		CONSOLE_DEBUG("cCameraDataBuffer is NULL");
+		for (ii=0; ii<pixelCnt; ii++)
+		{
+			lumValue	=	(levelPtr[ii] >> shiftCount) & 0x00ff;
+			cHistogramLum[lumValue]++;
+			if (lumValue > cMaxGryValue)
+			{
+				cMaxGryValue	=	lumValue;
+			}
+		}
 	}
+	free(levelCopy);
+	FindHistogramPeaks();
 }
 
 //*****************************************************************************
@@ -768,6 +812,916 @@ FILE	*csvFile;
 
 #endif // _INCLUDE_HISTOGRAM_
 
+#pragma mark -
+#pragma mark Star detection
+//*****************************************************************************
+//*	Star detection
+//*
+//*	1) the image is split into tiles, the background and noise of each tile
+//*		is the median and MAD of a sample of its pixels
+//*	2) each row is scanned for runs of pixels above the tile threshold
+//*	3) the runs are joined into connected components (8 connected)
+//*	4) each component that looks like a star is measured around its peak,
+//*		centroid, half flux radius, FWHM and eccentricity (second moments), flux and peak
+//*
+//*	1, 2 and 4 are split across threads, 3 only looks at the runs so it is quick
+//*****************************************************************************
+#define	kStarTileSize			64
+#define	kStarTileSampleStep		4			//*	256 samples from a full tile
+#define	kStarMaxThreads			8
+#define	kStarMinPixels			3
+#define	kStarMaxPixels			2500
+#define	kStarMaxRunsPerJob		100000
+#define	kStarMinRadius			4
+#define	kStarMaxRadius			24
+
+//*****************************************************************************
+typedef struct
+{
+	int			row;
+	int			xStart;
+	int			xEnd;
+	int			parent;
+} TYPE_PIXEL_RUN;
+
+//*****************************************************************************
+typedef struct
+{
+	int			peakX;
+	int			peakY;
+	uint32_t	peakValue;
+	int			pixelCnt;
+	int			minX;
+	int			maxX;
+	int			minY;
+	int			maxY;
+} TYPE_STAR_CANDIDATE;
+
+enum
+{
+	kStarStage_Tiles	=	0,
+	kStarStage_Runs,
+	kStarStage_Measure
+};
+
+//*****************************************************************************
+typedef struct
+{
+	int					stage;
+	const uint16_t		*imageData;
+	int					width;
+	int					height;
+	int					tilesX;
+	float				*tileBackground;
+	float				*tileThreshold;
+	double				threshold_sigma;
+	//*	tile rows, pixel rows or candidates, depending on the stage
+	int					firstIdx;
+	int					lastIdx;
+	//*	kStarStage_Runs
+	TYPE_PIXEL_RUN		*runList;
+	int					runCnt;
+	int					runMax;
+	//*	kStarStage_Measure
+	TYPE_STAR_CANDIDATE	*candidates;
+	TYPE_DETECTED_STAR	*stars;
+} TYPE_STAR_JOB;
+
+//*****************************************************************************
+static int	CompareUint16(const void *e1, const void *e2)
+{
+	return(*((uint16_t *)e1) - *((uint16_t *)e2));
+}
+
+//*****************************************************************************
+static int	CompareFloat(const void *e1, const void *e2)
+{
+float	value1	=	*((float *)e1);
+float	value2	=	*((float *)e2);
+
+	return((value1 > value2) - (value1 < value2));
+}
+
+//*****************************************************************************
+//*	brightest first
+//*****************************************************************************
+static int	CompareCandidates(const void *e1, const void *e2)
+{
+uint32_t	peak1	=	((TYPE_STAR_CANDIDATE *)e1)->peakValue;
+uint32_t	peak2	=	((TYPE_STAR_CANDIDATE *)e2)->peakValue;
+
+	return((peak1 < peak2) - (peak1 > peak2));
+}
+
+//*****************************************************************************
+static void	StarJob_Tiles(TYPE_STAR_JOB *starJob)
+{
+uint16_t	samples[(kStarTileSize / kStarTileSampleStep) * (kStarTileSize / kStarTileSampleStep)];
+int			sampleCnt;
+int			tileX;
+int			tileY;
+int			tileIdx;
+int			xxx;
+int			yyy;
+int			xEnd;
+int			yEnd;
+uint16_t	median;
+float		noise;
+const uint16_t	*rowPtr;
+
+	for (tileY=starJob->firstIdx; tileY<starJob->lastIdx; tileY++)
+	{
+		yEnd	=	(tileY + 1) * kStarTileSize;
+		if (yEnd > starJob->height)
+		{
+			yEnd	=	starJob->height;
+		}
+		for (tileX=0; tileX<starJob->tilesX; tileX++)
+		{
+			xEnd	=	(tileX + 1) * kStarTileSize;
+			if (xEnd > starJob->width)
+			{
+				xEnd	=	starJob->width;
+			}
+			sampleCnt	=	0;
+			for (yyy=(tileY * kStarTileSize); yyy<yEnd; yyy += kStarTileSampleStep)
+			{
+				rowPtr	=	starJob->imageData + ((long)yyy * starJob->width);
+				for (xxx=(tileX * kStarTileSize); xxx<xEnd; xxx += kStarTileSampleStep)
+				{
+					samples[sampleCnt++]	=	rowPtr[xxx];
+				}
+			}
+			qsort(samples, sampleCnt, sizeof(uint16_t), CompareUint16);
+			median	=	samples[sampleCnt / 2];
+			for (xxx=0; xxx<sampleCnt; xxx++)
+			{
+				samples[xxx]	=	abs(samples[xxx] - median);
+			}
+			qsort(samples, sampleCnt, sizeof(uint16_t), CompareUint16);
+			noise	=	1.4826 * samples[sampleCnt / 2];
+			if (noise < 1.0)
+			{
+				noise	=	1.0;
+			}
+			tileIdx								=	(tileY * starJob->tilesX) + tileX;
+			starJob->tileBackground[tileIdx]	=	median;
+			starJob->tileThreshold[tileIdx]		=	median + (starJob->threshold_sigma * noise);
+		}
+	}
+}
+
+//*****************************************************************************
+static void	AddPixelRun(TYPE_STAR_JOB *starJob, const int row, const int xStart, const int xEnd)
+{
+TYPE_PIXEL_RUN	*newList;
+int				newMax;
+
+	if (starJob->runCnt >= starJob->runMax)
+	{
+		if (starJob->runMax >= kStarMaxRunsPerJob)
+		{
+			return;
+		}
+		newMax	=	(starJob->runMax > 0) ? (starJob->runMax * 2) : 1024;
+		newList	=	(TYPE_PIXEL_RUN *)realloc(starJob->runList, newMax * sizeof(TYPE_PIXEL_RUN));
+		if (newList == NULL)
+		{
+			return;
+		}
+		starJob->runList	=	newList;
+		starJob->runMax		=	newMax;
+	}
+	starJob->runList[starJob->runCnt].row		=	row;
+	starJob->runList[starJob->runCnt].xStart	=	xStart;
+	starJob->runList[starJob->runCnt].xEnd		=	xEnd;
+	starJob->runList[starJob->runCnt].parent	=	-1;
+	starJob->runCnt++;
+}
+
+//*****************************************************************************
+static void	StarJob_Runs(TYPE_STAR_JOB *starJob)
+{
+const uint16_t	*rowPtr;
+const float		*thresholdRow;
+int				yyy;
+int				xxx;
+int				tileX;
+int				xEnd;
+int				runStart;
+bool			inRun;
+float			threshold;
+
+	for (yyy=starJob->firstIdx; yyy<starJob->lastIdx; yyy++)
+	{
+		rowPtr			=	starJob->imageData + ((long)yyy * starJob->width);
+		thresholdRow	=	starJob->tileThreshold + ((yyy / kStarTileSize) * starJob->tilesX);
+		inRun			=	false;
+		runStart		=	0;
+		for (tileX=0; tileX<starJob->tilesX; tileX++)
+		{
+			threshold	=	thresholdRow[tileX];
+			xEnd		=	(tileX + 1) * kStarTileSize;
+			if (xEnd > starJob->width)
+			{
+				xEnd	=	starJob->width;
+			}
+			for (xxx=(tileX * kStarTileSize); xxx<xEnd; xxx++)
+			{
+				if (rowPtr[xxx] > threshold)
+				{
+					if (inRun == false)
+					{
+						runStart	=	xxx;
+						inRun		=	true;
+					}
+				}
+				else if (inRun)
+				{
+					AddPixelRun(starJob, yyy, runStart, (xxx - 1));
+					inRun	=	false;
+				}
+			}
+		}
+		if (inRun)
+		{
+			AddPixelRun(starJob, yyy, runStart, (starJob->width - 1));
+		}
+	}
+}
+
+//*****************************************************************************
+static void	MeasureStar(TYPE_STAR_JOB *starJob, const TYPE_STAR_CANDIDATE *candidate, TYPE_DETECTED_STAR *star)
+{
+const uint16_t	*rowPtr;
+float			background;
+float			noise;
+float			pixelValue;
+double			sumValue;
+double			sumX;
+double			sumY;
+double			sumDist;
+double			sumDist2;
+double			sumXX;
+double			sumYY;
+double			sumXY;
+double			momentXX;
+double			momentYY;
+double			momentXY;
+double			eigenAvg;
+double			eigenDiff;
+double			xCenter;
+double			yCenter;
+double			deltaX;
+double			deltaY;
+double			dist2;
+int				tileIdx;
+int				radius;
+int				xMin;
+int				xMax;
+int				yMin;
+int				yMax;
+int				xxx;
+int				yyy;
+
+	tileIdx		=	((candidate->peakY / kStarTileSize) * starJob->tilesX) + (candidate->peakX / kStarTileSize);
+	background	=	starJob->tileBackground[tileIdx];
+	noise		=	(starJob->tileThreshold[tileIdx] - background) / starJob->threshold_sigma;
+	radius		=	sqrt(candidate->pixelCnt) + 3;
+	if (radius < kStarMinRadius)
+	{
+		radius	=	kStarMinRadius;
+	}
+	if (radius > kStarMaxRadius)
+	{
+		radius	=	kStarMaxRadius;
+	}
+	xMin	=	(candidate->peakX > radius) ? (candidate->peakX - radius) : 0;
+	yMin	=	(candidate->peakY > radius) ? (candidate->peakY - radius) : 0;
+	xMax	=	candidate->peakX + radius;
+	yMax	=	candidate->peakY + radius;
+	if (xMax >= starJob->width)
+	{
+		xMax	=	starJob->width - 1;
+	}
+	if (yMax >= starJob->height)
+	{
+		yMax	=	starJob->height - 1;
+	}
+
+	//*	centroid, only from the pixels clearly above the noise
+	sumValue	=	0.0;
+	sumX		=	0.0;
+	sumY		=	0.0;
+	for (yyy=yMin; yyy<=yMax; yyy++)
+	{
+		rowPtr	=	starJob->imageData + ((long)yyy * starJob->width);
+		for (xxx=xMin; xxx<=xMax; xxx++)
+		{
+			pixelValue	=	rowPtr[xxx] - background;
+			if (pixelValue > (2.0 * noise))
+			{
+				sumValue	+=	pixelValue;
+				sumX		+=	pixelValue * xxx;
+				sumY		+=	pixelValue * yyy;
+			}
+		}
+	}
+	if (sumValue <= 0.0)
+	{
+		memset(star, 0, sizeof(TYPE_DETECTED_STAR));
+		return;
+	}
+	xCenter	=	sumX / sumValue;
+	yCenter	=	sumY / sumValue;
+
+	//*	half flux radius and second moments about the centroid
+	//*	all of the pixels are used, the noise below the background cancels the noise above it
+	sumValue	=	0.0;
+	sumDist		=	0.0;
+	sumDist2	=	0.0;
+	sumXX		=	0.0;
+	sumYY		=	0.0;
+	sumXY		=	0.0;
+	for (yyy=yMin; yyy<=yMax; yyy++)
+	{
+		rowPtr	=	starJob->imageData + ((long)yyy * starJob->width);
+		deltaY	=	yyy - yCenter;
+		for (xxx=xMin; xxx<=xMax; xxx++)
+		{
+			pixelValue	=	rowPtr[xxx] - background;
+			deltaX		=	xxx - xCenter;
+			dist2		=	(deltaX * deltaX) + (deltaY * deltaY);
+			if (dist2 <= (radius * radius))
+			{
+				sumValue	+=	pixelValue;
+				sumDist		+=	pixelValue * sqrt(dist2);
+				sumDist2	+=	pixelValue * dist2;
+				sumXX		+=	pixelValue * deltaX * deltaX;
+				sumYY		+=	pixelValue * deltaY * deltaY;
+				sumXY		+=	pixelValue * deltaX * deltaY;
+			}
+		}
+	}
+	star->xCenter	=	xCenter;
+	star->yCenter	=	yCenter;
+	star->flux		=	sumValue;
+	star->hfr		=	(sumValue > 0.0) ? (sumDist / sumValue) : 0.0;
+	star->fwhm		=	(sumValue > 0.0) ? (2.3548 * sqrt(sumDist2 / (2.0 * sumValue))) : 0.0;
+	star->peakValue	=	candidate->peakValue;
+	star->pixelCnt	=	candidate->pixelCnt;
+
+	//*	the eigen values of the second moments are the long and short axis squared
+	star->eccentricity	=	0.0;
+	if (sumValue > 0.0)
+	{
+		momentXX	=	sumXX / sumValue;
+		momentYY	=	sumYY / sumValue;
+		momentXY	=	sumXY / sumValue;
+		eigenAvg	=	(momentXX + momentYY) / 2.0;
+		eigenDiff	=	sqrt((((momentXX - momentYY) / 2.0) * ((momentXX - momentYY) / 2.0)) + (momentXY * momentXY));
+		if (((eigenAvg + eigenDiff) > 0.0) && ((eigenAvg - eigenDiff) >= 0.0))
+		{
+			star->eccentricity	=	sqrt(1.0 - ((eigenAvg - eigenDiff) / (eigenAvg + eigenDiff)));
+		}
+	}
+}
+
+//*****************************************************************************
+static void	*StarDetectThread(void *arg)
+{
+TYPE_STAR_JOB	*starJob;
+int				ii;
+
+	starJob	=	(TYPE_STAR_JOB *)arg;
+	switch(starJob->stage)
+	{
+		case kStarStage_Tiles:
+			StarJob_Tiles(starJob);
+			break;
+
+		case kStarStage_Runs:
+			StarJob_Runs(starJob);
+			break;
+
+		case kStarStage_Measure:
+			for (ii=starJob->firstIdx; ii<starJob->lastIdx; ii++)
+			{
+				MeasureStar(starJob, &starJob->candidates[ii], &starJob->stars[ii]);
+			}
+			break;
+	}
+	return(NULL);
+}
+
+//*****************************************************************************
+//*	splits itemCnt items across the jobs and runs them, the last one on this thread
+//*****************************************************************************
+static void	RunStarJobs(TYPE_STAR_JOB *jobList, int jobCnt, const int stage, const int itemCnt)
+{
+pthread_t	threadID[kStarMaxThreads];
+bool		threadOK[kStarMaxThreads];
+int			itemsPerJob;
+int			ii;
+
+	if (jobCnt > itemCnt)
+	{
+		jobCnt	=	(itemCnt > 0) ? itemCnt : 1;
+	}
+	itemsPerJob	=	(itemCnt + jobCnt - 1) / jobCnt;
+	for (ii=0; ii<kStarMaxThreads; ii++)
+	{
+		jobList[ii].stage		=	stage;
+		jobList[ii].firstIdx	=	ii * itemsPerJob;
+		jobList[ii].lastIdx		=	(ii + 1) * itemsPerJob;
+		if (jobList[ii].lastIdx > itemCnt)
+		{
+			jobList[ii].lastIdx	=	itemCnt;
+		}
+		if ((ii >= jobCnt) || (jobList[ii].firstIdx > itemCnt))
+		{
+			jobList[ii].firstIdx	=	itemCnt;
+			jobList[ii].lastIdx		=	itemCnt;
+		}
+	}
+	for (ii=0; ii<(jobCnt - 1); ii++)
+	{
+		threadOK[ii]	=	(pthread_create(&threadID[ii], NULL, &StarDetectThread, &jobList[ii]) == 0);
+		if (threadOK[ii] == false)
+		{
+			//*	do it here instead
+			StarDetectThread(&jobList[ii]);
+		}
+	}
+	StarDetectThread(&jobList[jobCnt - 1]);
+	for (ii=0; ii<(jobCnt - 1); ii++)
+	{
+		if (threadOK[ii])
+		{
+			pthread_join(threadID[ii], NULL);
+		}
+	}
+}
+
+//*****************************************************************************
+static int	FindRunRoot(TYPE_PIXEL_RUN *runList, int runIdx)
+{
+	while (runList[runIdx].parent != runIdx)
+	{
+		runList[runIdx].parent	=	runList[runList[runIdx].parent].parent;
+		runIdx					=	runList[runIdx].parent;
+	}
+	return(runIdx);
+}
+
+//*****************************************************************************
+//*	joins runs that touch (including diagonally) into components
+//*	the runs are in row order, the root of a component is its lowest index run
+//*****************************************************************************
+static void	JoinPixelRuns(TYPE_PIXEL_RUN *runList, const int runCnt)
+{
+int		prevStart;
+int		prevEnd;
+int		rowStart;
+int		rowEnd;
+int		firstOverlap;
+int		ii;
+int		jj;
+int		root1;
+int		root2;
+
+	prevStart	=	0;
+	prevEnd		=	0;
+	ii			=	0;
+	while (ii < runCnt)
+	{
+		rowStart	=	ii;
+		while ((ii < runCnt) && (runList[ii].row == runList[rowStart].row))
+		{
+			runList[ii].parent	=	ii;
+			ii++;
+		}
+		rowEnd	=	ii;
+		//*	only look at the previous row if it is directly above
+		if ((prevEnd > prevStart) && (runList[prevStart].row == (runList[rowStart].row - 1)))
+		{
+			firstOverlap	=	prevStart;
+			for (ii=rowStart; ii<rowEnd; ii++)
+			{
+				while ((firstOverlap < prevEnd) && (runList[firstOverlap].xEnd < (runList[ii].xStart - 1)))
+				{
+					firstOverlap++;
+				}
+				for (jj=firstOverlap; (jj < prevEnd) && (runList[jj].xStart <= (runList[ii].xEnd + 1)); jj++)
+				{
+					root1	=	FindRunRoot(runList, ii);
+					root2	=	FindRunRoot(runList, jj);
+					if (root1 < root2)
+					{
+						runList[root2].parent	=	root1;
+					}
+					else if (root2 < root1)
+					{
+						runList[root1].parent	=	root2;
+					}
+				}
+			}
+		}
+		prevStart	=	rowStart;
+		prevEnd		=	rowEnd;
+		ii			=	rowEnd;
+	}
+}
+
+//*****************************************************************************
+//*	returns a 16 bit mono image to look for stars in
+//*	RAW color data is binned 2x2 so the bayer pattern does not break up the stars
+//*	width and height are the size of imageData coming in, of the mono image going out
+//*****************************************************************************
+const uint16_t	*CameraDriver::GetStarDetectImage(	const unsigned char		*imageData,
+													const TYPE_IMAGE_TYPE	imageType,
+													const bool				rawColor,
+													uint16_t				**monoBuffer,
+													long					*monoBufLen,
+													int						*width,
+													int						*height,
+													int						*scale)
+{
+const uint16_t	*monoImage;
+const uint8_t	*srcData8;
+long			pixelCount;
+long			bufferLen;
+long			ii;
+int				bytesPerPixel;
+
+	monoImage	=	NULL;
+	*scale		=	1;
+	if (imageData == NULL)
+	{
+		return(NULL);
+	}
+	if ((imageType == kImageType_RAW16) && (rawColor == false))
+	{
+		//*	already what we need, no copy
+		return((const uint16_t *)imageData);
+	}
+
+	pixelCount	=	(long)(*width) * (*height);
+	bufferLen	=	pixelCount * sizeof(uint16_t);
+	if (*monoBufLen < bufferLen)
+	{
+		if (*monoBuffer != NULL)
+		{
+			free(*monoBuffer);
+		}
+		*monoBuffer	=	(uint16_t *)malloc(bufferLen);
+		*monoBufLen	=	(*monoBuffer != NULL) ? bufferLen : 0;
+	}
+	if (*monoBuffer == NULL)
+	{
+		return(NULL);
+	}
+
+	srcData8	=	(const uint8_t *)imageData;
+	if (rawColor)
+	{
+		bytesPerPixel	=	(imageType == kImageType_RAW16) ? 2 : 1;
+		if (ImageBin_Downsample(imageData, *width, *height, bytesPerPixel, 1, 2, false, *monoBuffer))
+		{
+			*width		=	*width / 2;
+			*height		=	*height / 2;
+			*scale		=	2;
+			monoImage	=	*monoBuffer;
+		}
+	}
+	else if (imageType == kImageType_RGB24)
+	{
+		for (ii=0; ii<pixelCount; ii++)
+		{
+			(*monoBuffer)[ii]	=	srcData8[0] + srcData8[1] + srcData8[2];
+			srcData8			+=	3;
+		}
+		monoImage	=	*monoBuffer;
+	}
+	else
+	{
+		for (ii=0; ii<pixelCount; ii++)
+		{
+			(*monoBuffer)[ii]	=	srcData8[ii];
+		}
+		monoImage	=	*monoBuffer;
+	}
+	return(monoImage);
+}
+
+//*****************************************************************************
+//*	puts the run lists from the jobs together, joins them into components
+//*	and returns the ones that look like stars, brightest first
+//*****************************************************************************
+static TYPE_STAR_CANDIDATE	*FindStarCandidates(TYPE_STAR_JOB	*jobList,
+												int				*candidateCnt,
+												int				*componentCnt)
+{
+TYPE_PIXEL_RUN		*runList;
+TYPE_STAR_CANDIDATE	*candidates;
+TYPE_STAR_CANDIDATE	*component;
+const uint16_t		*rowPtr;
+int					width;
+int					height;
+int					runCnt;
+int					root;
+int					xxx;
+int					ii;
+
+	*candidateCnt	=	0;
+	*componentCnt	=	0;
+	width			=	jobList[0].width;
+	height			=	jobList[0].height;
+
+	//*	the jobs are in row order, so putting the lists end to end keeps it that way
+	runCnt	=	0;
+	for (ii=0; ii<kStarMaxThreads; ii++)
+	{
+		runCnt	+=	jobList[ii].runCnt;
+	}
+	runList		=	(TYPE_PIXEL_RUN *)malloc((runCnt + 1) * sizeof(TYPE_PIXEL_RUN));
+	candidates	=	(TYPE_STAR_CANDIDATE *)malloc((runCnt + 1) * sizeof(TYPE_STAR_CANDIDATE));
+	if ((runList == NULL) || (candidates == NULL))
+	{
+		free(runList);
+		free(candidates);
+		return(NULL);
+	}
+	runCnt	=	0;
+	for (ii=0; ii<kStarMaxThreads; ii++)
+	{
+		if (jobList[ii].runCnt > 0)
+		{
+			memcpy(&runList[runCnt], jobList[ii].runList, (jobList[ii].runCnt * sizeof(TYPE_PIXEL_RUN)));
+			runCnt	+=	jobList[ii].runCnt;
+		}
+	}
+	JoinPixelRuns(runList, runCnt);
+
+	//*	the stats for each component are kept at the index of its root run
+	for (ii=0; ii<runCnt; ii++)
+	{
+		root		=	FindRunRoot(runList, ii);
+		component	=	&candidates[root];
+		if (root == ii)
+		{
+			memset(component, 0, sizeof(TYPE_STAR_CANDIDATE));
+			component->minX	=	runList[ii].xStart;
+			component->maxX	=	runList[ii].xEnd;
+			component->minY	=	runList[ii].row;
+			(*componentCnt)++;
+		}
+		component->pixelCnt	+=	(runList[ii].xEnd - runList[ii].xStart) + 1;
+		component->maxY		=	runList[ii].row;
+		if (runList[ii].xStart < component->minX)
+		{
+			component->minX	=	runList[ii].xStart;
+		}
+		if (runList[ii].xEnd > component->maxX)
+		{
+			component->maxX	=	runList[ii].xEnd;
+		}
+		rowPtr	=	jobList[0].imageData + ((long)runList[ii].row * width);
+		for (xxx=runList[ii].xStart; xxx<=runList[ii].xEnd; xxx++)
+		{
+			if (rowPtr[xxx] > component->peakValue)
+			{
+				component->peakValue	=	rowPtr[xxx];
+				component->peakX		=	xxx;
+				component->peakY		=	runList[ii].row;
+			}
+		}
+	}
+
+	//*	keep the ones that look like stars, packed at the front of the list
+	//*	not too small (hot pixels), not too big, not on the edge and not long and thin
+	for (ii=0; ii<runCnt; ii++)
+	{
+		if (runList[ii].parent != ii)
+		{
+			continue;
+		}
+		component	=	&candidates[ii];
+		if ((component->pixelCnt >= kStarMinPixels) &&
+			(component->pixelCnt <= kStarMaxPixels) &&
+			(component->minX > 0) && (component->maxX < (width - 1)) &&
+			(component->minY > 0) && (component->maxY < (height - 1)) &&
+			((component->maxX - component->minX) < (3 * (component->maxY - component->minY + 1))) &&
+			((component->maxY - component->minY) < (3 * (component->maxX - component->minX + 1))))
+		{
+			candidates[(*candidateCnt)++]	=	*component;
+		}
+	}
+	free(runList);
+	qsort(candidates, *candidateCnt, sizeof(TYPE_STAR_CANDIDATE), CompareCandidates);
+	return(candidates);
+}
+
+//*****************************************************************************
+static float	CalcMedianFloat(float *values, const int valueCnt)
+{
+	if (valueCnt <= 0)
+	{
+		return(0.0);
+	}
+	qsort(values, valueCnt, sizeof(float), CompareFloat);
+	return(values[valueCnt / 2]);
+}
+
+//*****************************************************************************
+//*	finds the stars in the current image, results go in cStarAnalysis
+//*	only called from the state machine thread, readers on other threads
+//*	must copy cStarAnalysis under cStarMutex
+//*****************************************************************************
+bool	CameraDriver::DetectStars(void)
+{
+int		width;
+int		height;
+bool	starsFound;
 
+	width	=	cROIinfo.currentROIwidth;
+	height	=	cROIinfo.currentROIheight;
+	if ((width <= 0) || (height <= 0))
+	{
+		width	=	cCameraXsize;
+		height	=	cCameraYsize;
+	}
+	pthread_mutex_lock(&cStarMutex);
+	pthread_mutex_lock(&cCameraDataMutex);
+	starsFound	=	DetectStarsInImage(	cCameraDataBuffer,
+										cROIinfo.currentROIimageType,
+										width,
+										height,
+										IsRawColorImage(),
+										cFramesRead,
+										kStarMaxThreads,
+										&cStarMonoBuffer,
+										&cStarMonoBufLen,
+										&cStarAnalysis);
+	pthread_mutex_unlock(&cCameraDataMutex);
+	pthread_mutex_unlock(&cStarMutex);
+	return(starsFound);
+}
+
+//*****************************************************************************
+//*	finds the stars in any image buffer, the result is copied to *result
+//*	maxJobs limits the number of threads, the background quality thread uses 1
+//*****************************************************************************
+bool	CameraDriver::DetectStarsInImage(	const unsigned char		*imageData,
+											const TYPE_IMAGE_TYPE	imageType,
+											const int				imageWidth,
+											const int				imageHeight,
+											const bool				rawColor,
+											const uint32_t			frameNumber,
+											const int				maxJobs,
+											uint16_t				**monoBuffer,
+											long					*monoBufLen,
+											TYPE_STAR_ANALYSIS		*result)
+{
+TYPE_STAR_JOB		jobList[kStarMaxThreads];
+TYPE_STAR_ANALYSIS	*analysis;
+TYPE_STAR_CANDIDATE	*candidates;
+const uint16_t		*monoImage;
+float				*tileBackground;
+float				*tileThreshold;
+float				*sortBuffer;
+struct timeval		startTime;
+struct timeval		endTime;
+int					width;
+int					height;
+int					scale;
+int					tilesX;
+int					tilesY;
+int					tileCnt;
+int					jobCnt;
+int					candidateCnt;
+int					starCnt;
+int					ii;
+double				thresholdSigma;
+bool				detectOK;
+
+	gettimeofday(&startTime, NULL);
+	//*	can be changed by a PUT while this runs on the quality thread
+	thresholdSigma	=	cStarDetectSigma;
+	width		=	imageWidth;
+	height		=	imageHeight;
+	monoImage	=	GetStarDetectImage(imageData, imageType, rawColor, monoBuffer, monoBufLen, &width, &height, &scale);
+	if ((monoImage == NULL) || (width < kStarTileSize) || (height < kStarTileSize))
+	{
+		return(false);
+	}
+
+	detectOK		=	false;
+	tilesX			=	(width + kStarTileSize - 1) / kStarTileSize;
+	tilesY			=	(height + kStarTileSize - 1) / kStarTileSize;
+	tileCnt			=	tilesX * tilesY;
+	tileBackground	=	(float *)malloc(tileCnt * sizeof(float));
+	tileThreshold	=	(float *)malloc(tileCnt * sizeof(float));
+	sortBuffer		=	(float *)malloc((tileCnt + kMaxDetectedStars) * sizeof(float));
+	analysis		=	(TYPE_STAR_ANALYSIS *)calloc(1, sizeof(TYPE_STAR_ANALYSIS));
+	memset(jobList, 0, sizeof(jobList));
+	if ((tileBackground != NULL) && (tileThreshold != NULL) && (sortBuffer != NULL) && (analysis != NULL))
+	{
+		jobCnt	=	sysconf(_SC_NPROCESSORS_ONLN);
+		if (jobCnt < 1)
+		{
+			jobCnt	=	1;
+		}
+		if (jobCnt > kStarMaxThreads)
+		{
+			jobCnt	=	kStarMaxThreads;
+		}
+		if ((maxJobs > 0) && (jobCnt > maxJobs))
+		{
+			jobCnt	=	maxJobs;
+		}
+		for (ii=0; ii<kStarMaxThreads; ii++)
+		{
+			jobList[ii].imageData		=	monoImage;
+			jobList[ii].width			=	width;
+			jobList[ii].height			=	height;
+			jobList[ii].tilesX			=	tilesX;
+			jobList[ii].tileBackground	=	tileBackground;
+			jobList[ii].tileThreshold	=	tileThreshold;
+			jobList[ii].threshold_sigma	=	thresholdSigma;
+		}
+
+		//*	background and threshold for each tile, then the runs above the threshold
+		RunStarJobs(jobList, jobCnt, kStarStage_Tiles, tilesY);
+		RunStarJobs(jobList, jobCnt, kStarStage_Runs, height);
+
+		candidates	=	FindStarCandidates(jobList, &candidateCnt, &analysis->componentCnt);
+		if (candidates != NULL)
+		{
+			starCnt	=	(candidateCnt < kMaxDetectedStars) ? candidateCnt : kMaxDetectedStars;
+			for (ii=0; ii<kStarMaxThreads; ii++)
+			{
+				jobList[ii].candidates	=	candidates;
+				jobList[ii].stars		=	analysis->stars;
+			}
+			RunStarJobs(jobList, jobCnt, kStarStage_Measure, starCnt);
+			free(candidates);
+
+			//*	back to image coordinates if the image was binned
+			for (ii=0; ii<starCnt; ii++)
+			{
+				analysis->stars[ii].xCenter	=	(analysis->stars[ii].xCenter * scale) + ((scale - 1) * 0.5);
+				analysis->stars[ii].yCenter	=	(analysis->stars[ii].yCenter * scale) + ((scale - 1) * 0.5);
+				analysis->stars[ii].hfr		*=	scale;
+				analysis->stars[ii].fwhm	*=	scale;
+			}
+
+			//*	overall numbers
+			memcpy(sortBuffer, tileBackground, (tileCnt * sizeof(float)));
+			analysis->background	=	CalcMedianFloat(sortBuffer, tileCnt);
+			for (ii=0; ii<tileCnt; ii++)
+			{
+				sortBuffer[ii]	=	(tileThreshold[ii] - tileBackground[ii]) / thresholdSigma;
+			}
+			analysis->noise	=	CalcMedianFloat(sortBuffer, tileCnt);
+			for (ii=0; ii<starCnt; ii++)
+			{
+				sortBuffer[ii]	=	analysis->stars[ii].hfr;
+			}
+			analysis->medianHFR	=	CalcMedianFloat(sortBuffer, starCnt);
+			for (ii=0; ii<starCnt; ii++)
+			{
+				sortBuffer[ii]	=	analysis->stars[ii].fwhm;
+			}
+			analysis->medianFWHM	=	CalcMedianFloat(sortBuffer, starCnt);
+			for (ii=0; ii<starCnt; ii++)
+			{
+				sortBuffer[ii]	=	analysis->stars[ii].eccentricity;
+			}
+			analysis->medianEccentricity	=	CalcMedianFloat(sortBuffer, starCnt);
+
+			gettimeofday(&endTime, NULL);
+			analysis->valid				=	true;
+			analysis->frameNumber		=	frameNumber;
+			analysis->width				=	width * scale;
+			analysis->height			=	height * scale;
+			analysis->threshold_sigma	=	thresholdSigma;
+			analysis->starCnt			=	starCnt;
+			analysis->analysisTime_us	=	((endTime.tv_sec - startTime.tv_sec) * 1000000) +
+											(endTime.tv_usec - startTime.tv_usec);
+			memcpy(result, analysis, sizeof(TYPE_STAR_ANALYSIS));
+			detectOK	=	true;
+		}
+	}
+	for (ii=0; ii<kStarMaxThreads; ii++)
+	{
+		free(jobList[ii].runList);
+	}
+	free(tileBackground);
+	free(tileThreshold);
+	free(sortBuffer);
+	free(analysis);
+	return(detectOK);
+}
 
 #endif	//	_ENABLE_CAMERA_
@@ -75,6 +75,12 @@
 //*	Jun 11,	2020	<MLS> Added timestamp option to video output
 //*	Jun 16,	2020	<MLS> Added timestamp text (csv) file for video output
 //*	Aug 11,	2020	<MLS> Added auto exposure to video output
+//*	Feb  3,	2021	<MLS> Video output is now SER via a separate writer thread
+//*	Feb  3,	2021	<MLS> Take_Video() reads directly into the SER frame queue
+//*	Mar  2,	2021	<MLS> Added ROI streaming (Start_ROIstream, Read_ROIframe, Stop_ROIstream)
+//*	Mar 16,	2021	<MLS> Video auto exposure runs on every frame and is applied to the camera
+//*	Mar 30,	2021	<MLS> Video auto exposure skips the frames taken before a change
+//*	Mar 30,	2021	<MLS> Opted in to the base class capture thread
 //*****************************************************************************
 //*	Length: unspecified [text/plain]
 //*	Saving to: "imagearray.1"
@@ -122,6 +128,7 @@
 
 
 #define	kMaxCameraCnt	5
+#define	kASI_VideoSettleFrames	2		//*	frames in flight when the video exposure is changed
 
 static int				gASIcameraCount	=	0;
 
@@ -181,6 +188,11 @@ CameraDriverASI::CameraDriverASI(const int deviceNum)
 //	CONSOLE_DEBUG(__FUNCTION__);
 	cCameraID	=	deviceNum;
 	strcpy(cDeviceManufAbrev,	"ZWO");
+#ifndef _USE_THREADS_FOR_ASI_CAMERA_
+	//*	the ASI SDK can be called from more than one thread,
+	//*	the old private CameraThread() does its own waiting if it is enabled
+	cCaptureThreadEnabled	=	true;
+#endif
 	ReadASIcameraInfo();
 
 	strcpy(cDeviceDescription, cDeviceManufacturer);
@@ -200,6 +212,8 @@ CameraDriverASI::CameraDriverASI(const int deviceNum)
 CameraDriverASI::~CameraDriverASI(void)
 {
 	CONSOLE_DEBUG(__FUNCTION__);
+	//*	has to be stopped while this is still an ASI camera
+	StopROIstream();
 }
 
 
@@ -903,11 +917,20 @@ ASI_BOOL			bAuto		=	ASI_FALSE;
 
 			gettimeofday(&cLastexposure_StartTime, NULL);
 
+			//*	the image buffer is used to drain frames when the writer falls behind
+			//*	and for the auto exposure calculations
+			GetImage_ROI_info();
+			AllcateImageBuffer(-1);
 
-		#ifdef _USE_OPENCV_
-			CreateOpenCVImage(NULL);
-		#endif
-			cInternalCameraState	=	kCameraState_TakingVideo;
+			if (OpenSERvideoFile())
+			{
+				cInternalCameraState	=	kCameraState_TakingVideo;
+			}
+			else
+			{
+				ASIStopVideoCapture(cCameraID);
+				alpacaErrCode	=	kASCOM_Err_FailedUnknown;
+			}
 		}
 		else
 		{
@@ -958,7 +981,9 @@ char				asiErrorMsgString[64];
 					Get_ASI_ErrorMsg(asiErrorCode, asiErrorMsgString);
 					strcat(cLastCameraErrMsg, asiErrorMsgString);
 				}
+				CloseSERvideoFile();
 				cInternalCameraState	=	kCameraState_Idle;
+				alpacaErrCode			=	kASCOM_Err_Success;
 				break;
 
 			default:
@@ -970,119 +995,82 @@ char				asiErrorMsgString[64];
 
 
 
+//*****************************************************************************
+//*	reads one video frame straight into the SER writer queue.
+//*	if the writer has fallen behind, the frame is still read (into the image buffer)
+//*	to keep the SDK from backing up, and it is counted as dropped
 //*****************************************************************************
 TYPE_ASCOM_STATUS	CameraDriverASI::Take_Video(void)
 {
-TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_InternalError;
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+ASI_ERROR_CODE		asiErrorCode;
+unsigned char		*frameBuffer;
+long				frameBufSize;
+bool				frameQueued;
 bool				timeToStop;
+int					deltaSecs;
+int32_t				previousExposure_us;
 
 //	CONSOLE_DEBUG(__FUNCTION__);
 
-#ifdef _USE_OPENCV_
-ASI_ERROR_CODE	asiErrorCode;
-int				deltaSecs;
-
-	deltaSecs	=	0;
-	if (cOpenCV_Image != NULL)
+	deltaSecs		=	0;
+	frameBuffer		=	NULL;
+	frameBufSize	=	0;
+	frameQueued		=	false;
+	if (cSERwriter != NULL)
 	{
-	int		videoWriteRC;
-
-		memset(cOpenCV_Image->imageData, 0, cOpenCV_Image->imageSize);
+		frameBuffer		=	SER_GetFrameBuffer(cSERwriter);
+		frameBufSize	=	cSERwriter->frameSize;
+	}
+	if (frameBuffer != NULL)
+	{
+		frameQueued		=	true;
+	}
+	else
+	{
+		frameBuffer		=	cCameraDataBuffer;
+		frameBufSize	=	cCameraDataBuffLen;
+	}
 
+	if (frameBuffer != NULL)
+	{
 		asiErrorCode	=	ASIGetVideoData(cCameraID,
-											(unsigned char*)cOpenCV_Image->imageData,
-											cOpenCV_Image->imageSize,
+											frameBuffer,
+											frameBufSize,
 											-1);
 		if (asiErrorCode == ASI_SUCCESS)
 		{
-			cNumVideoFramesSaved++;
-//#define _DEBUG_VIDEO_
-		#ifdef _DEBUG_VIDEO_
-			char	imageFilePath[64];
-			int		openCVerr;
-			int		quality[3] = {16, 200, 0};
+			//*	the time stamp goes into the SER trailer
+			gettimeofday(&cLastexposure_EndTime, NULL);
 
-			sprintf(imageFilePath, "%s/DEBUG_IMG%03d.jpg", kImageDataDir, cNumVideoFramesSaved);
-			CONSOLE_DEBUG(imageFilePath);
-			openCVerr	=	cvSaveImage(imageFilePath, cOpenCV_Image, quality);
+			//============================================================
+			//*	Aug 11,	2020	<MLS> Added auto exposure to video output
+			//*	Mar 16,	2021	<MLS> The subsampled statistics are cheap enough for every frame,
+			//*	they are taken straight from the frame buffer, no copy
+			//*	Mar 30,	2021	<MLS> The frames the SDK already has were taken with the old
+			//*	exposure, they are not used to predict the next one
+			if (cAutoAdjustExposure)
+			{
+				previousExposure_us	=	cCurrentExposure_us;
+				AutoAdjustExposure(frameBuffer, kASI_VideoSettleFrames);
+				if (cCurrentExposure_us != previousExposure_us)
+				{
+					ASISetControlValue(cCameraID, ASI_EXPOSURE, cCurrentExposure_us, ASI_FALSE);
+				}
+			}
 
-			CONSOLE_DEBUG_W_NUM("openCVerr\t=", openCVerr);
-		#endif // _DEBUG_VIDEO_
+			if (frameQueued)
+			{
+				SER_QueueFrame(cSERwriter, &cLastexposure_EndTime);
+				cNumVideoFramesSaved++;
+			}
 
 			//*	calculate frames per sec
-			gettimeofday(&cLastexposure_EndTime, NULL);
 			deltaSecs	=	cLastexposure_EndTime.tv_sec - cLastexposure_StartTime.tv_sec;
 			if (deltaSecs > 0)
 			{
 				cFrameRate	=	(cNumVideoFramesSaved * 1.0) / deltaSecs;
 			}
-			if (cOpenCV_videoWriter != NULL)
-			{
-				//*	if we want a time stamp
-				//*	change to preference/setting latter
-				//*	Jun 29,	2120	<TODO> Change video timestamp to an option
-				if (1)
-				{
-				CvPoint		point1;
-				CvRect		myCVrect;
-				char		timeStampString[256];
-				char		testDataString[256];
-
-					#define	kTextBoxHeight	35
-					//*	first erase the text area
-					myCVrect.x		=	0;
-					myCVrect.y		=	cOpenCV_Image->height - kTextBoxHeight;
-					myCVrect.width	=	cOpenCV_Image->width;
-					myCVrect.height	=	kTextBoxHeight;
-					cvRectangleR(	cOpenCV_Image,
-									myCVrect,
-									cSideBarBlk,				//	CvScalar color,
-									CV_FILLED,					//	int thickness CV_DEFAULT(1),
-									8,							//	int line_type CV_DEFAULT(8),
-									0);							//	int shift CV_DEFAULT(0));
-
-					FormatTimeStringISO8601(&cLastexposure_EndTime, timeStampString);
-					point1.x	=	5;
-					point1.y	=	cOpenCV_Image->height - 10;
-					cvPutText(	cOpenCV_Image,	timeStampString,	point1,	&cOverlayTextFont,	cVideoOverlayColor);
-
-					point1.x	=	cOpenCV_Image->width / 2;
-					sprintf(testDataString, "S-%s,%s", cObjectName, cAuxTextTag);
-					cvPutText(	cOpenCV_Image,	testDataString,	point1,	&cOverlayTextFont,	cVideoOverlayColor);
-
-					if (cVideoTimeStampFilePtr != NULL)
-					{
-					double	lastExposureTimeSecs;
-
-						lastExposureTimeSecs	=	cLastexposure_EndTime.tv_sec;
-						lastExposureTimeSecs	+=	cLastexposure_EndTime.tv_usec / 1000000.0;
-
-						fprintf(cVideoTimeStampFilePtr, "%d,%s,%1.3f\r\n",	cNumVideoFramesSaved,
-																			timeStampString,
-																			lastExposureTimeSecs);
-					}
-				}
-				videoWriteRC	=	cvWriteFrame(cOpenCV_videoWriter, cOpenCV_Image);
-				if (videoWriteRC != 1)
-				{
-					CONSOLE_DEBUG_W_NUM("videoWriteRC\t=", videoWriteRC);
-				}
-				//============================================================
-				//*	Aug 11,	2020	<MLS> Added auto exposure to video output
-				//*	check to see if we are in auto exposure adjustment
-				if (cAutoAdjustExposure)
-				{
-					if ((cNumVideoFramesSaved % 10) == 0)
-					{
-						AutoAdjustExposure();
-					}
-				}
-			}
-			else
-			{
-				CONSOLE_DEBUG("cOpenCV_videoWriter is NULL");
-//				exit(0);
-			}
 		}
 		else
 		{
@@ -1092,11 +1080,10 @@ int				deltaSecs;
 	}
 	else
 	{
-		CONSOLE_DEBUG("cOpenCV_Image == NULL");
-		cInternalCameraState	=	kCameraState_Idle;
-		exit(0);
+		CONSOLE_DEBUG("No buffer for video data");
+		alpacaErrCode	=	kASCOM_Err_FailedUnknown;
 	}
-	if ((cNumVideoFramesSaved % 100) == 0)
+	if (frameQueued && ((cNumVideoFramesSaved % 100) == 0))
 	{
 		CONSOLE_DEBUG_W_NUM("cNumVideoFramesSaved\t=", cNumVideoFramesSaved);
 	}
@@ -1112,7 +1099,11 @@ int				deltaSecs;
 			timeToStop	=	true;
 		}
 	}
-	if (deltaSecs >= cVideoDuration_secs)
+	if ((cVideoDuration_secs > 0) && (deltaSecs >= cVideoDuration_secs))
+	{
+		timeToStop	=	true;
+	}
+	if (alpacaErrCode != kASCOM_Err_Success)
 	{
 		timeToStop	=	true;
 	}
@@ -1124,33 +1115,120 @@ int				deltaSecs;
 
 		gettimeofday(&cLastexposure_EndTime, NULL);
 
-
-		//*	time to stop taking video
-		cvReleaseVideoWriter(&cOpenCV_videoWriter);
-//			CONSOLE_DEBUG_W_HEX("cOpenCV_videoWriter\t=", (unsigned long)cOpenCV_videoWriter);
-
-		cOpenCV_videoWriter	=	NULL;
-		CONSOLE_DEBUG("cOpenCV_videoWriter released");
+		//*	waits for the writer thread to finish the queue
+		CloseSERvideoFile();
 	#ifdef _ENABLE_FITS_
 		SaveImageAsFITS(SAVE_AVI);
 	#endif // _ENABLE_FITS_
 
-		if (cVideoTimeStampFilePtr != NULL)
-		{
-			fclose(cVideoTimeStampFilePtr);
-			cVideoTimeStampFilePtr	=	NULL;
-		}
 		cInternalCameraState	=	kCameraState_Idle;
 
 		WriteFireCaptureTextFile();
 	}
-#endif	//	_USE_OPENCV_
 	return(alpacaErrCode);
 }
 
 #endif //	_TEMP_DISABLE_
 
 #pragma mark -
+#pragma mark ROI stream
+
+//*****************************************************************************
+//*	video capture on the ROI, the full frame settings are put back by Stop_ROIstream()
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriverASI::Start_ROIstream(void)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_FailedUnknown;
+ASI_ERROR_CODE		asiErrorCode;
+ASI_IMG_TYPE		streamImageType;
+
+	CONSOLE_DEBUG(__FUNCTION__);
+	asiErrorCode	=	OpenASIcameraIfNeeded(cCameraID);
+	if (asiErrorCode == ASI_SUCCESS)
+	{
+		ASIGetROIFormat(cCameraID,	&cSavedROIwidth,
+									&cSavedROIheight,
+									&cSavedROIbin,
+									&cSavedASIimageType);
+		ASIGetStartPos(cCameraID, &cSavedStartX, &cSavedStartY);
+
+		streamImageType	=	(cROIstream.bytesPerPixel == 2) ? ASI_IMG_RAW16 : ASI_IMG_RAW8;
+		asiErrorCode	=	ASISetROIFormat(cCameraID,
+											cROIstream.width,
+											cROIstream.height,
+											1,
+											streamImageType);
+		if (asiErrorCode == ASI_SUCCESS)
+		{
+			asiErrorCode	=	ASISetStartPos(cCameraID, cROIstream.startX, cROIstream.startY);
+		}
+		if (asiErrorCode == ASI_SUCCESS)
+		{
+			asiErrorCode	=	ASISetControlValue(cCameraID, ASI_EXPOSURE, cROIstream.exposure_us, ASI_FALSE);
+		}
+		if (asiErrorCode == ASI_SUCCESS)
+		{
+			asiErrorCode	=	ASIStartVideoCapture(cCameraID);
+		}
+
+		if (asiErrorCode == ASI_SUCCESS)
+		{
+			alpacaErrCode	=	kASCOM_Err_Success;
+		}
+		else
+		{
+			CONSOLE_DEBUG_W_NUM("Failed to start ROI stream, asiErrorCode\t=", asiErrorCode);
+			strcpy(cLastCameraErrMsg, "Failed to start ROI stream");
+			ASISetROIFormat(cCameraID, cSavedROIwidth, cSavedROIheight, cSavedROIbin, cSavedASIimageType);
+			ASISetStartPos(cCameraID, cSavedStartX, cSavedStartY);
+		}
+	}
+	else
+	{
+		strcpy(cLastCameraErrMsg, "Failed to open ASI camera");
+		CONSOLE_DEBUG(cLastCameraErrMsg);
+	}
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriverASI::Read_ROIframe(const uint32_t timeout_ms)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_FailedUnknown;
+ASI_ERROR_CODE		asiErrorCode;
+long				frameLength;
+
+	frameLength		=	cROIstream.width * cROIstream.height * cROIstream.bytesPerPixel;
+	asiErrorCode	=	ASIGetVideoData(cCameraID,
+										cROIstream.frameBuffer,
+										frameLength,
+										timeout_ms);
+	if (asiErrorCode == ASI_SUCCESS)
+	{
+		cROIstream.frameTime_us	=	FrameTiming_GetMonotonic_us();
+		alpacaErrCode			=	kASCOM_Err_Success;
+	}
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriverASI::Stop_ROIstream(void)
+{
+ASI_ERROR_CODE		asiErrorCode;
+
+	CONSOLE_DEBUG(__FUNCTION__);
+	asiErrorCode	=	ASIStopVideoCapture(cCameraID);
+	if (asiErrorCode != ASI_SUCCESS)
+	{
+		CONSOLE_DEBUG_W_NUM("ASIStopVideoCapture() returned asiErrorCode\t=", asiErrorCode);
+	}
+	ASISetROIFormat(cCameraID, cSavedROIwidth, cSavedROIheight, cSavedROIbin, cSavedASIimageType);
+	ASISetStartPos(cCameraID, cSavedStartX, cSavedStartY);
+	GetImage_ROI_info();
+	return(kASCOM_Err_Success);
+}
+
+#pragma mark -
 
 
 
@@ -10,6 +10,7 @@
 //*****************************************************************************
 //*	Sep  3,	2019	<MLS> Created cameradriver_ASI.h
 //*	Nov 29,	2020	<MLS> Updated return values to TYPE_ASCOM_STATUS
+//*	Mar  2,	2021	<MLS> Added ROI stream functions
 //*****************************************************************************
 //#include	"cameradriver_ASI.h"
 
@@ -57,6 +58,10 @@ class CameraDriverASI: public CameraDriver
 		virtual	TYPE_ASCOM_STATUS		Stop_Video(void);
 		virtual	TYPE_ASCOM_STATUS		Take_Video(void);
 
+		virtual	TYPE_ASCOM_STATUS		Start_ROIstream(void);
+		virtual	TYPE_ASCOM_STATUS		Read_ROIframe(const uint32_t timeout_ms);
+		virtual	TYPE_ASCOM_STATUS		Stop_ROIstream(void);
+
 		virtual	int						GetImage_ROI_info(void);
 
 		virtual	TYPE_ASCOM_STATUS		Cooler_TurnOn(void);
@@ -82,6 +87,15 @@ class CameraDriverASI: public CameraDriver
 		//*	data for this specific camera type
 		int					asiDeviceNum;
 		ASI_IMG_TYPE		cCurrentASIimageType;
+
+		//*	full frame settings saved while the ROI stream is running
+		int					cSavedROIwidth;
+		int					cSavedROIheight;
+		int					cSavedROIbin;
+		ASI_IMG_TYPE		cSavedASIimageType;
+		int					cSavedStartX;
+		int					cSavedStartY;
+
 		ASI_SUPPORTED_MODE	supportedModes;
 		ASI_CAMERA_INFO		cAsiCameraInfo;
 		ASI_ID				cAsiSerialNum;
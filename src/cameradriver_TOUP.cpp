@@ -33,6 +33,9 @@
 //*	Jan 29,	2020	<MLS> Toupcam is working on NVIDIA Jetson board
 //*	Mar  5,	2020	<MLS> Working on Toupcam image readout modes
 //*	Jan 15,	2021	<PDB> Found bug in GetImage_ROI_info()
+//*	Feb 24,	2021	<MLS> TOUPCAM_EVENT_IMAGE now wakes up the capture thread
+//*	Mar  2,	2021	<MLS> Added ROI streaming, frames are pulled into the ROI stream buffer
+//*	Mar 30,	2021	<MLS> Opted in to the capture thread, frames are pulled under cCameraDataMutex
 //-----------------------------------------------------------------------------
 //*	Feb  4,	2120	<TODO> Add 16 bit readout to Toupcam
 //*	Feb 16,	2120	<TODO> Add gain setting to Toupcam
@@ -174,6 +177,10 @@ HRESULT			toupResult;
 
 	cCameraID			=	deviceNum;
 	cToupPicReady		=	false;
+
+	//*	the SDK calls back from its own thread when a frame is ready
+	cCaptureThreadEnabled	=	true;
+	cCaptureEventDriven		=	true;
 	cExposureMin_us		=	400;				//*	0.4 ms
 	cExposureMax_us		=	800 * 1000 *1000;	//*	800 seconds
 
@@ -205,6 +212,8 @@ HRESULT			toupResult;
 CameraDriverTOUP::~CameraDriverTOUP(void)
 {
 	CONSOLE_DEBUG(__FUNCTION__);
+	//*	has to be stopped while this is still a TOUP camera
+	StopROIstream();
 }
 
 
@@ -548,6 +557,59 @@ int		bAutoExposure;
 
 
 
+//*****************************************************************************
+//*	the camera is always in pull mode, the callback sends the frames to the stream
+//*	while the state is kCameraState_ROIstream
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriverTOUP::Start_ROIstream(void)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_FailedUnknown;
+HRESULT				toupResult;
+
+	CONSOLE_DEBUG(__FUNCTION__);
+	if (cToupCamH != NULL)
+	{
+		//*	frames are pulled as 8 bit gray
+		cROIstream.bytesPerPixel	=	1;
+		toupResult	=	Toupcam_put_Roi(cToupCamH,	cROIstream.startX,
+													cROIstream.startY,
+													cROIstream.width,
+													cROIstream.height);
+		if (SUCCEEDED(toupResult))
+		{
+			toupResult	=	Toupcam_put_ExpoTime(cToupCamH, cROIstream.exposure_us);
+		}
+		if (SUCCEEDED(toupResult))
+		{
+			alpacaErrCode	=	kASCOM_Err_Success;
+		}
+		else
+		{
+			CONSOLE_DEBUG_W_HEX("Failed to start ROI stream, toupResult = ", toupResult);
+			strcpy(cLastCameraErrMsg, "Failed to set ROI");
+			Toupcam_put_Roi(cToupCamH, 0, 0, 0, 0);
+		}
+	}
+	else
+	{
+		strcpy(cLastCameraErrMsg, "Camera not open");
+	}
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriverTOUP::Stop_ROIstream(void)
+{
+	CONSOLE_DEBUG(__FUNCTION__);
+	if (cToupCamH != NULL)
+	{
+		//*	all zeros puts it back to full resolution
+		Toupcam_put_Roi(cToupCamH, 0, 0, 0, 0);
+		Toupcam_put_ExpoTime(cToupCamH, cCurrentExposure_us);
+	}
+	return(kASCOM_Err_Success);
+}
+
 //*****************************************************************************
 //*	the camera must already be open when this is called
 //*****************************************************************************
@@ -869,10 +931,28 @@ HRESULT				toupResult;
 
 		case TOUPCAM_EVENT_IMAGE:			//*	live image arrived, use Toupcam_PullImage to get this image
 		//	CONSOLE_DEBUG("TOUPCAM_EVENT_IMAGE");
-			if ((cToupCamH != NULL) && (cCameraDataBuffer != NULL))
+			if ((cInternalCameraState == kCameraState_ROIstream) && (cToupCamH != NULL))
+			{
+				//*	if the stream thread is still busy with the last one, this frame is dropped
+				if ((cROIstream.framePosted == false) && (cROIstream.frameBuffer != NULL))
+				{
+					toupResult	=	Toupcam_PullImageV2(cToupCamH, cROIstream.frameBuffer, 8, &toupFrameInfo);
+					if (SUCCEEDED(toupResult))
+					{
+						PostROIframe();
+					}
+				}
+				else
+				{
+					Toupcam_PullImageV2(cToupCamH, NULL, 8, &toupFrameInfo);
+				}
+			}
+			else if ((cToupCamH != NULL) && (cCameraDataBuffer != NULL))
 			{
 				//*	we do not want to read the image if an image save is in progress
+				pthread_mutex_lock(&cCameraDataMutex);
 				toupResult	=	Toupcam_PullImageV2(cToupCamH, cCameraDataBuffer, 24, &toupFrameInfo);
+				pthread_mutex_unlock(&cCameraDataMutex);
 				if (SUCCEEDED(toupResult))
 				{
 				//	CONSOLE_DEBUG_W_HEX("toupFrameInfo.flag\t\t=",		toupFrameInfo.flag);
@@ -887,6 +967,8 @@ HRESULT				toupResult;
 					if (cInternalCameraState == kCameraState_TakingPicture)
 					{
 						cToupPicReady	=	true;
+						//*	wake up the capture thread
+						SignalCaptureEvent();
 					}
 					//*	get the frame rate: framerate (fps) = Frame * 1000.0 / nTime
 					unsigned	nFrame;
@@ -10,6 +10,7 @@
 //*****************************************************************************
 //*	Jan  9,	2020	<MLS> Created cameradriver_TOUP.h
 //*	Nov 29,	2020	<MLS> Updated return values to TYPE_ASCOM_STATUS
+//*	Mar  2,	2021	<MLS> Added ROI stream functions
 //*****************************************************************************
 //#include	"cameradriver_TOUP.h"
 
@@ -49,6 +50,9 @@ class CameraDriverTOUP: public CameraDriver
 
 		virtual	int		GetImage_ROI_info(void);
 
+		virtual	TYPE_ASCOM_STATUS		Start_ROIstream(void);
+		virtual	TYPE_ASCOM_STATUS		Stop_ROIstream(void);
+
 		virtual	TYPE_ASCOM_STATUS		Cooler_TurnOn(void);
 		virtual	TYPE_ASCOM_STATUS		Cooler_TurnOff(void);
 		virtual	TYPE_ASCOM_STATUS		Read_SensorTemp(void);
@@ -0,0 +1,706 @@
+//**************************************************************************
+//*	Name:			cameradriver_autofocus.cpp
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Server side autofocus using the linked focuser
+//*
+//*					The focuser is stepped through a range centered on its current
+//*					position, an exposure is taken at each step and the HFR is measured
+//*					here with DetectStars(), so no images go over the network.
+//*					When all of the steps are done a curve is fit to the HFR values and
+//*					the focuser is moved to the bottom of the curve.
+//*
+//*					Hyperbola (default)
+//*						hfr = a * sqrt(1 + ((x - c) / b)^2)
+//*						hfr^2 is a parabola in x, so it is fit with linear least squares
+//*					Parabola
+//*						fit directly to hfr, only good close to focus
+//*
+//*					Each step is logged as an event and the steps so far are returned
+//*					by GET autofocus, a client polling that sees the run as it happens.
+//*
+//*					Only the stars in the center ROI percent of the frame are used.
+//*					The hardware ROI is not set by the camera drivers yet, so the full
+//*					frame is read and the ROI is applied to the star list.
+//*
+//*	Usage:
+//*		PUT /api/v1/camera/0/autofocus	Action=start&StepSize=50
+//*										&Steps=9				(5 to 32)
+//*										&Exposure=2.0			(seconds)
+//*										&ROI=50					(percent of the frame)
+//*										&Backlash=100			(overshoot before the first step)
+//*										&Fit=hyperbola | parabola
+//*		PUT /api/v1/camera/0/autofocus	Action=abort
+//*		GET /api/v1/camera/0/autofocus
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb 19,	2021	<MLS> Created cameradriver_autofocus.cpp
+//*	Feb 20,	2021	<MLS> Added hyperbola fit
+//*	Mar 30,	2021	<MLS> Abort is done by the state machine, not the request thread
+//*	Mar 30,	2021	<MLS> The sweep and all moves are kept within the focuser max step
+//*****************************************************************************
+
+#ifdef _ENABLE_CAMERA_
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<math.h>
+#include	<sys/time.h>
+
+#define _ENABLE_CONSOLE_DEBUG_
+#include	"ConsoleDebug.h"
+
+#include	"JsonResponse.h"
+#include	"eventlogging.h"
+#include	"alpacadriver.h"
+#include	"alpacadriver_helper.h"
+#include	"cameradriver.h"
+
+#ifdef _ENABLE_FOCUSER_
+	#include	"focuserdriver.h"
+#endif
+
+#define	kAutoFocus_FocuserTimeout_ms	120000
+#define	kAutoFocus_MinFitPoints			5
+
+//*****************************************************************************
+static const char	*gAutoFocusStateNames[]	=
+{
+	"idle",
+	"movefocuser",
+	"waitfocuser",
+	"startexposure",
+	"waitimage",
+	"movetobest",
+	"waitbest"
+};
+
+#ifdef _ENABLE_FOCUSER_
+//*****************************************************************************
+static uint32_t	ElapsedMilliSecs(struct timeval *startTime)
+{
+struct timeval	currentTime;
+
+	gettimeofday(&currentTime, NULL);
+	return(Calc_millisFromTimeStruct(&currentTime) - Calc_millisFromTimeStruct(startTime));
+}
+#endif // _ENABLE_FOCUSER_
+
+//*****************************************************************************
+//*	least squares fit of yValue = p0 + p1 * x + p2 * x^2
+//*	x is centered and scaled first to keep the normal equations well behaved
+//*****************************************************************************
+static bool	FitQuadratic(	const double	*xValue,
+							const double	*yValue,
+							const int		pointCnt,
+							double			*p0,
+							double			*p1,
+							double			*p2)
+{
+double	xMean;
+double	xScale;
+double	sx[5];
+double	sxy[3];
+double	xx;
+double	xPower;
+double	det;
+double	a0;
+double	a1;
+double	a2;
+int		ii;
+int		jj;
+
+	if (pointCnt < 3)
+	{
+		return(false);
+	}
+	xMean	=	0.0;
+	for (ii=0; ii<pointCnt; ii++)
+	{
+		xMean	+=	xValue[ii];
+	}
+	xMean	=	xMean / pointCnt;
+	xScale	=	0.0;
+	for (ii=0; ii<pointCnt; ii++)
+	{
+		if (fabs(xValue[ii] - xMean) > xScale)
+		{
+			xScale	=	fabs(xValue[ii] - xMean);
+		}
+	}
+	if (xScale <= 0.0)
+	{
+		return(false);
+	}
+
+	memset(sx, 0, sizeof(sx));
+	memset(sxy, 0, sizeof(sxy));
+	for (ii=0; ii<pointCnt; ii++)
+	{
+		xx		=	(xValue[ii] - xMean) / xScale;
+		xPower	=	1.0;
+		for (jj=0; jj<5; jj++)
+		{
+			sx[jj]	+=	xPower;
+			if (jj < 3)
+			{
+				sxy[jj]	+=	xPower * yValue[ii];
+			}
+			xPower	*=	xx;
+		}
+	}
+
+	//*	Cramer's rule on the 3x3 normal equations
+	det	=	(sx[0] * ((sx[2] * sx[4]) - (sx[3] * sx[3]))) -
+			(sx[1] * ((sx[1] * sx[4]) - (sx[3] * sx[2]))) +
+			(sx[2] * ((sx[1] * sx[3]) - (sx[2] * sx[2])));
+	if (fabs(det) < 1.0e-12)
+	{
+		return(false);
+	}
+	a0	=	((sxy[0] * ((sx[2] * sx[4]) - (sx[3] * sx[3]))) -
+			(sx[1] * ((sxy[1] * sx[4]) - (sx[3] * sxy[2]))) +
+			(sx[2] * ((sxy[1] * sx[3]) - (sx[2] * sxy[2])))) / det;
+	a1	=	((sx[0] * ((sxy[1] * sx[4]) - (sx[3] * sxy[2]))) -
+			(sxy[0] * ((sx[1] * sx[4]) - (sx[3] * sx[2]))) +
+			(sx[2] * ((sx[1] * sxy[2]) - (sxy[1] * sx[2])))) / det;
+	a2	=	((sx[0] * ((sx[2] * sxy[2]) - (sxy[1] * sx[3]))) -
+			(sx[1] * ((sx[1] * sxy[2]) - (sxy[1] * sx[2]))) +
+			(sxy[0] * ((sx[1] * sx[3]) - (sx[2] * sx[2])))) / det;
+
+	//*	back to the original x
+	*p2	=	a2 / (xScale * xScale);
+	*p1	=	(a1 / xScale) - (2.0 * (*p2) * xMean);
+	*p0	=	a0 - (a1 * xMean / xScale) + ((*p2) * xMean * xMean);
+	return(true);
+}
+
+//*****************************************************************************
+//*	median HFR of the stars in the center of the frame
+//*****************************************************************************
+float	CameraDriver::AutoFocus_MeasureHFR(float *fwhm, int *starCnt)
+{
+float	hfrValues[kMaxDetectedStars];
+float	fwhmValues[kMaxDetectedStars];
+float	sortValue;
+float	xMin;
+float	xMax;
+float	yMin;
+float	yMax;
+int		roiCnt;
+int		ii;
+int		jj;
+
+	*fwhm		=	0.0;
+	*starCnt	=	0;
+	if (DetectStars() == false)
+	{
+		return(0.0);
+	}
+	xMin	=	cStarAnalysis.width * (100 - cAutoFocus.roiPercent) / 200.0;
+	xMax	=	cStarAnalysis.width - xMin;
+	yMin	=	cStarAnalysis.height * (100 - cAutoFocus.roiPercent) / 200.0;
+	yMax	=	cStarAnalysis.height - yMin;
+	roiCnt	=	0;
+	for (ii=0; ii<cStarAnalysis.starCnt; ii++)
+	{
+		if ((cStarAnalysis.stars[ii].xCenter >= xMin) && (cStarAnalysis.stars[ii].xCenter < xMax) &&
+			(cStarAnalysis.stars[ii].yCenter >= yMin) && (cStarAnalysis.stars[ii].yCenter < yMax) &&
+			(cStarAnalysis.stars[ii].hfr > 0.0))
+		{
+			hfrValues[roiCnt]	=	cStarAnalysis.stars[ii].hfr;
+			fwhmValues[roiCnt]	=	cStarAnalysis.stars[ii].fwhm;
+			roiCnt++;
+		}
+	}
+	if (roiCnt == 0)
+	{
+		return(0.0);
+	}
+	//*	the lists are short, a simple insertion sort is plenty
+	for (ii=1; ii<roiCnt; ii++)
+	{
+		for (jj=ii; (jj > 0) && (hfrValues[jj - 1] > hfrValues[jj]); jj--)
+		{
+			sortValue			=	hfrValues[jj];
+			hfrValues[jj]		=	hfrValues[jj - 1];
+			hfrValues[jj - 1]	=	sortValue;
+		}
+		for (jj=ii; (jj > 0) && (fwhmValues[jj - 1] > fwhmValues[jj]); jj--)
+		{
+			sortValue			=	fwhmValues[jj];
+			fwhmValues[jj]		=	fwhmValues[jj - 1];
+			fwhmValues[jj - 1]	=	sortValue;
+		}
+	}
+	*fwhm		=	fwhmValues[roiCnt / 2];
+	*starCnt	=	roiCnt;
+	return(hfrValues[roiCnt / 2]);
+}
+
+//*****************************************************************************
+//*	returns true if the fit has a minimum inside the range that was scanned
+//*****************************************************************************
+bool	CameraDriver::AutoFocus_FitCurve(void)
+{
+double	xValue[kAutoFocus_MaxSteps];
+double	yValue[kAutoFocus_MaxSteps];
+double	p0;
+double	p1;
+double	p2;
+double	minValue;
+double	lowLimit;
+double	highLimit;
+int		pointCnt;
+int		ii;
+
+	cAutoFocus.fitValid	=	false;
+	pointCnt			=	0;
+	for (ii=0; ii<cAutoFocus.stepsDone; ii++)
+	{
+		if ((cAutoFocus.steps[ii].starCnt > 0) && (cAutoFocus.steps[ii].hfr > 0.0))
+		{
+			xValue[pointCnt]	=	cAutoFocus.steps[ii].position;
+			yValue[pointCnt]	=	cAutoFocus.steps[ii].hfr;
+			if (cAutoFocus.useParabola == false)
+			{
+				yValue[pointCnt]	=	yValue[pointCnt] * yValue[pointCnt];
+			}
+			pointCnt++;
+		}
+	}
+	if ((pointCnt < kAutoFocus_MinFitPoints) || (FitQuadratic(xValue, yValue, pointCnt, &p0, &p1, &p2) == false))
+	{
+		strcpy(cAutoFocus.statusMsg, "Not enough steps with stars to fit");
+		return(false);
+	}
+	if (p2 <= 0.0)
+	{
+		strcpy(cAutoFocus.statusMsg, "Curve has no minimum");
+		return(false);
+	}
+	cAutoFocus.fitCenter	=	-p1 / (2.0 * p2);
+	minValue				=	p0 - ((p1 * p1) / (4.0 * p2));
+	if (cAutoFocus.useParabola)
+	{
+		cAutoFocus.fitMinHFR	=	minValue;
+		cAutoFocus.fitWidth		=	p2;
+	}
+	else
+	{
+		//*	hfr^2 = a^2 + (a^2 / b^2) * (x - c)^2
+		cAutoFocus.fitMinHFR	=	(minValue > 0.0) ? sqrt(minValue) : 0.0;
+		cAutoFocus.fitWidth		=	(minValue > 0.0) ? sqrt(minValue / p2) : 0.0;
+	}
+
+	lowLimit	=	cAutoFocus.firstPosition;
+	highLimit	=	cAutoFocus.firstPosition + ((cAutoFocus.stepCnt - 1) * cAutoFocus.stepSize);
+	if ((cAutoFocus.fitCenter < lowLimit) || (cAutoFocus.fitCenter > highLimit))
+	{
+		sprintf(cAutoFocus.statusMsg, "Best focus %1.0f is outside the range scanned", cAutoFocus.fitCenter);
+		return(false);
+	}
+	cAutoFocus.bestPosition	=	lround(cAutoFocus.fitCenter);
+	cAutoFocus.fitValid		=	true;
+	return(true);
+}
+
+//*****************************************************************************
+void	CameraDriver::AutoFocus_Finish(const char *statusMsg, const bool moveToStart)
+{
+#ifdef _ENABLE_FOCUSER_
+char	alpacaErrMsg[128];
+
+	if (moveToStart && (cConnectedFocuser != NULL) && (cAutoFocus.state != kAutoFocus_Idle))
+	{
+		cConnectedFocuser->SetFocuserPostion(cAutoFocus.startPosition, alpacaErrMsg);
+	}
+#endif // _ENABLE_FOCUSER_
+	strcpy(cAutoFocus.statusMsg, statusMsg);
+	cAutoFocus.state	=	kAutoFocus_Idle;
+	LogEvent(	"camera",
+				"AutoFocus",
+				cAutoFocus.statusMsg,
+				kASCOM_Err_Success,
+				"");
+}
+
+//*****************************************************************************
+//*	called from RunStateMachine() while an autofocus run is active
+//*****************************************************************************
+void	CameraDriver::RunStateMachine_AutoFocus(void)
+{
+#ifdef _ENABLE_FOCUSER_
+TYPE_ASCOM_STATUS	alpacaErrCode;
+TYPE_AUTOFOCUS_STEP	*currentStep;
+char				alpacaErrMsg[128];
+char				eventMsg[128];
+int32_t				focuserPosition;
+
+	if (cConnectedFocuser == NULL)
+	{
+		AutoFocus_Finish("Focuser is no longer connected", false);
+		return;
+	}
+	if (cAutoFocus.abortRequested)
+	{
+		AutoFocus_Finish("Aborted", true);
+		return;
+	}
+
+	switch(cAutoFocus.state)
+	{
+		case kAutoFocus_MoveFocuser:
+			if (cAutoFocus.overshootFirst)
+			{
+				//*	overshoot first so every step is approached from the same side
+				cAutoFocus.targetPosition	=	cAutoFocus.firstPosition - cAutoFocus.backlash;
+			}
+			else
+			{
+				cAutoFocus.targetPosition	=	cAutoFocus.firstPosition +
+												(cAutoFocus.stepsDone * cAutoFocus.stepSize);
+			}
+			if (cAutoFocus.targetPosition < 0)
+			{
+				cAutoFocus.targetPosition	=	0;
+			}
+			if (cAutoFocus.targetPosition > cAutoFocus.maxPosition)
+			{
+				cAutoFocus.targetPosition	=	cAutoFocus.maxPosition;
+			}
+			alpacaErrCode	=	cConnectedFocuser->SetFocuserPostion(cAutoFocus.targetPosition, alpacaErrMsg);
+			if (alpacaErrCode == kASCOM_Err_Success)
+			{
+				gettimeofday(&cAutoFocus.stateTime, NULL);
+				cAutoFocus.state	=	kAutoFocus_WaitFocuser;
+			}
+			else
+			{
+				AutoFocus_Finish("Focuser move failed", true);
+			}
+			break;
+
+		case kAutoFocus_WaitFocuser:
+		case kAutoFocus_WaitBest:
+			focuserPosition	=	cConnectedFocuser->GetFocuserPostion();
+			if ((cConnectedFocuser->GetFocuserIsMoving() == false) &&
+				(abs(focuserPosition - cAutoFocus.targetPosition) <= 1))
+			{
+				if (cAutoFocus.state == kAutoFocus_WaitBest)
+				{
+					if (cAutoFocus.overshootBest)
+					{
+						cAutoFocus.overshootBest	=	false;
+						cAutoFocus.state			=	kAutoFocus_MoveToBest;
+					}
+					else
+					{
+						sprintf(eventMsg, "Focus complete at %d, HFR %1.2f", cAutoFocus.bestPosition, cAutoFocus.fitMinHFR);
+						AutoFocus_Finish(eventMsg, false);
+					}
+				}
+				else if (cAutoFocus.overshootFirst)
+				{
+					cAutoFocus.overshootFirst	=	false;
+					cAutoFocus.state			=	kAutoFocus_MoveFocuser;
+				}
+				else
+				{
+					cAutoFocus.state	=	kAutoFocus_StartExposure;
+				}
+			}
+			else if (ElapsedMilliSecs(&cAutoFocus.stateTime) > kAutoFocus_FocuserTimeout_ms)
+			{
+				AutoFocus_Finish("Timed out waiting for the focuser", true);
+			}
+			break;
+
+		case kAutoFocus_StartExposure:
+			if (cInternalCameraState == kCameraState_Idle)
+			{
+				cImageReady					=	false;
+				cSaveNextImage				=	false;
+				cAutoFocus.frameAtExposure	=	cFramesRead;
+				GetImage_ROI_info();
+				cLastExposure_ROIinfo		=	cROIinfo;
+				cLastexposure_duration_us	=	cAutoFocus.exposure_us;
+				gettimeofday(&cLastexposure_StartTime, NULL);
+				FrameTiming_StartFrame(&cFrameTiming, cAutoFocus.exposure_us);
+				alpacaErrCode				=	Start_CameraExposure(cAutoFocus.exposure_us);
+				if (alpacaErrCode == kASCOM_Err_Success)
+				{
+					gettimeofday(&cAutoFocus.stateTime, NULL);
+					cAutoFocus.state	=	kAutoFocus_WaitImage;
+				}
+				else
+				{
+					AutoFocus_Finish("Failed to start exposure", true);
+				}
+			}
+			break;
+
+		case kAutoFocus_WaitImage:
+			if ((cInternalCameraState == kCameraState_Idle) && (cFramesRead != cAutoFocus.frameAtExposure))
+			{
+				currentStep				=	&cAutoFocus.steps[cAutoFocus.stepsDone];
+				currentStep->position	=	cAutoFocus.targetPosition;
+				currentStep->hfr		=	AutoFocus_MeasureHFR(&currentStep->fwhm, &currentStep->starCnt);
+				currentStep->elapsed_ms	=	ElapsedMilliSecs(&cAutoFocus.startTime);
+				cAutoFocus.stepsDone++;
+
+				sprintf(eventMsg, "Step %d/%d pos=%d HFR=%1.2f FWHM=%1.2f stars=%d",
+									cAutoFocus.stepsDone,
+									cAutoFocus.stepCnt,
+									currentStep->position,
+									currentStep->hfr,
+									currentStep->fwhm,
+									currentStep->starCnt);
+				strcpy(cAutoFocus.statusMsg, eventMsg);
+				LogEvent("camera", "AutoFocus", eventMsg, kASCOM_Err_Success, "");
+
+				if (cAutoFocus.stepsDone < cAutoFocus.stepCnt)
+				{
+					cAutoFocus.state	=	kAutoFocus_MoveFocuser;
+				}
+				else if (AutoFocus_FitCurve())
+				{
+					cAutoFocus.overshootBest	=	(cAutoFocus.backlash > 0);
+					cAutoFocus.state			=	kAutoFocus_MoveToBest;
+				}
+				else
+				{
+					//*	statusMsg has the reason
+					strcpy(eventMsg, cAutoFocus.statusMsg);
+					AutoFocus_Finish(eventMsg, true);
+				}
+			}
+			else if (ElapsedMilliSecs(&cAutoFocus.stateTime) > (uint32_t)((cAutoFocus.exposure_us / 1000) + 60000))
+			{
+				AutoFocus_Finish("Timed out waiting for the image", true);
+			}
+			break;
+
+		case kAutoFocus_MoveToBest:
+			//*	come in from the same side as the steps were taken
+			cAutoFocus.targetPosition	=	cAutoFocus.bestPosition;
+			if (cAutoFocus.overshootBest)
+			{
+				cAutoFocus.targetPosition	=	cAutoFocus.bestPosition - cAutoFocus.backlash;
+			}
+			if (cAutoFocus.targetPosition < 0)
+			{
+				cAutoFocus.targetPosition	=	0;
+			}
+			if (cAutoFocus.targetPosition > cAutoFocus.maxPosition)
+			{
+				cAutoFocus.targetPosition	=	cAutoFocus.maxPosition;
+			}
+			alpacaErrCode	=	cConnectedFocuser->SetFocuserPostion(cAutoFocus.targetPosition, alpacaErrMsg);
+			if (alpacaErrCode == kASCOM_Err_Success)
+			{
+				gettimeofday(&cAutoFocus.stateTime, NULL);
+				cAutoFocus.state	=	kAutoFocus_WaitBest;
+			}
+			else
+			{
+				AutoFocus_Finish("Focuser move to best focus failed", true);
+			}
+			break;
+
+		default:
+			cAutoFocus.state	=	kAutoFocus_Idle;
+			break;
+	}
+#else
+	cAutoFocus.state	=	kAutoFocus_Idle;
+#endif // _ENABLE_FOCUSER_
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Put_AutoFocus(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+char				argumentString[32];
+
+	if (GetKeyWordArgument(reqData->contentData, "Action", argumentString, (sizeof(argumentString) -1)) == false)
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "'Action' argument not found");
+		return(alpacaErrCode);
+	}
+
+	if (strcasecmp(argumentString, "abort") == 0)
+	{
+		//*	the focuser is moved back by the state machine, it owns the run
+		if (cAutoFocus.state != kAutoFocus_Idle)
+		{
+			cAutoFocus.abortRequested	=	true;
+		}
+	}
+	else if (strcasecmp(argumentString, "start") == 0)
+	{
+#ifdef _ENABLE_FOCUSER_
+		UpdateFocuserLink();
+		if (cConnectedFocuser == NULL)
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "No focuser found");
+			return(alpacaErrCode);
+		}
+		if ((cAutoFocus.state != kAutoFocus_Idle) ||
+			(cInternalCameraState != kCameraState_Idle) || (cImageMode != kImageMode_Single))
+		{
+			alpacaErrCode	=	kASCOM_Err_CameraBusy;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Camera is busy");
+			return(alpacaErrCode);
+		}
+
+		memset(&cAutoFocus, 0, sizeof(TYPE_AUTOFOCUS));
+		cAutoFocus.stepCnt		=	9;
+		cAutoFocus.roiPercent	=	50;
+		cAutoFocus.exposure_us	=	cCurrentExposure_us;
+		if (GetKeyWordArgument(reqData->contentData, "StepSize", argumentString, (sizeof(argumentString) -1)))
+		{
+			cAutoFocus.stepSize	=	atoi(argumentString);
+		}
+		if (GetKeyWordArgument(reqData->contentData, "Steps", argumentString, (sizeof(argumentString) -1)))
+		{
+			cAutoFocus.stepCnt	=	atoi(argumentString);
+		}
+		if (GetKeyWordArgument(reqData->contentData, "Exposure", argumentString, (sizeof(argumentString) -1)))
+		{
+			cAutoFocus.exposure_us	=	atof(argumentString) * 1000000.0;
+		}
+		if (GetKeyWordArgument(reqData->contentData, "ROI", argumentString, (sizeof(argumentString) -1)))
+		{
+			cAutoFocus.roiPercent	=	atoi(argumentString);
+		}
+		if (GetKeyWordArgument(reqData->contentData, "Backlash", argumentString, (sizeof(argumentString) -1)))
+		{
+			cAutoFocus.backlash	=	atoi(argumentString);
+		}
+		if (GetKeyWordArgument(reqData->contentData, "Fit", argumentString, (sizeof(argumentString) -1)))
+		{
+			cAutoFocus.useParabola	=	(strcasecmp(argumentString, "parabola") == 0);
+		}
+
+		if ((cAutoFocus.stepSize < 1) ||
+			(cAutoFocus.stepCnt < kAutoFocus_MinFitPoints) || (cAutoFocus.stepCnt > kAutoFocus_MaxSteps) ||
+			(cAutoFocus.roiPercent < 10) || (cAutoFocus.roiPercent > 100) ||
+			(cAutoFocus.exposure_us < cExposureMin_us) || (cAutoFocus.backlash < 0))
+		{
+			cAutoFocus.state	=	kAutoFocus_Idle;
+			alpacaErrCode		=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "StepSize, Steps, ROI, Exposure or Backlash is out of range");
+			return(alpacaErrCode);
+		}
+
+		cAutoFocus.maxPosition	=	cConnectedFocuser->GetFocuserMaxStep();
+		if (((cAutoFocus.stepCnt - 1) * cAutoFocus.stepSize) > cAutoFocus.maxPosition)
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Steps * StepSize is more than the focuser travel");
+			return(alpacaErrCode);
+		}
+
+		//*	centered on the current position, slid over to stay within 0 to max step
+		cAutoFocus.startPosition	=	cConnectedFocuser->GetFocuserPostion();
+		cAutoFocus.firstPosition	=	cAutoFocus.startPosition - ((cAutoFocus.stepCnt / 2) * cAutoFocus.stepSize);
+		if ((cAutoFocus.firstPosition + ((cAutoFocus.stepCnt - 1) * cAutoFocus.stepSize)) > cAutoFocus.maxPosition)
+		{
+			cAutoFocus.firstPosition	=	cAutoFocus.maxPosition - ((cAutoFocus.stepCnt - 1) * cAutoFocus.stepSize);
+		}
+		if (cAutoFocus.firstPosition < 0)
+		{
+			cAutoFocus.firstPosition	=	0;
+		}
+		cAutoFocus.overshootFirst	=	(cAutoFocus.backlash > 0);
+		gettimeofday(&cAutoFocus.startTime, NULL);
+		strcpy(cAutoFocus.statusMsg, "Running");
+		cAutoFocus.state	=	kAutoFocus_MoveFocuser;
+		LogEvent("camera", "AutoFocus", "Started", kASCOM_Err_Success, "");
+#else
+		alpacaErrCode	=	kASCOM_Err_NotImplemented;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Focuser support not enabled");
+#endif // _ENABLE_FOCUSER_
+	}
+	else
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Action must be start or abort");
+	}
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Get_AutoFocus(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
+{
+int		mySocket;
+char	lineBuff[160];
+int		ii;
+
+	mySocket	=	reqData->socket;
+
+	JsonResponse_Add_Bool(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"autofocus-active",		(cAutoFocus.state != kAutoFocus_Idle),	INCLUDE_COMMA);
+	JsonResponse_Add_String(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"autofocus-state",		gAutoFocusStateNames[cAutoFocus.state],	INCLUDE_COMMA);
+	JsonResponse_Add_String(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"autofocus-status",		cAutoFocus.statusMsg,					INCLUDE_COMMA);
+	JsonResponse_Add_String(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"autofocus-fit",		(cAutoFocus.useParabola ? "parabola" : "hyperbola"),
+								INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"autofocus-steps",		cAutoFocus.stepCnt,						INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"autofocus-stepsdone",	cAutoFocus.stepsDone,					INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"autofocus-start",		cAutoFocus.startPosition,				INCLUDE_COMMA);
+	JsonResponse_Add_Bool(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"autofocus-fitvalid",	cAutoFocus.fitValid,					INCLUDE_COMMA);
+	if (cAutoFocus.fitValid)
+	{
+		JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+									"autofocus-best",		cAutoFocus.bestPosition,			INCLUDE_COMMA);
+		JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+									"autofocus-minhfr",		cAutoFocus.fitMinHFR,				INCLUDE_COMMA);
+		JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+									"autofocus-fitwidth",	cAutoFocus.fitWidth,				INCLUDE_COMMA);
+	}
+
+	JsonResponse_Add_ArrayStart(mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,	"autofocus-data");
+	for (ii=0; ii<cAutoFocus.stepsDone; ii++)
+	{
+		sprintf(lineBuff,	"%s{\"position\":%d,\"hfr\":%1.3f,\"fwhm\":%1.3f,\"stars\":%d,\"ms\":%u}",
+							((ii > 0) ? "," : ""),
+							cAutoFocus.steps[ii].position,
+							cAutoFocus.steps[ii].hfr,
+							cAutoFocus.steps[ii].fwhm,
+							cAutoFocus.steps[ii].starCnt,
+							cAutoFocus.steps[ii].elapsed_ms);
+		JsonResponse_Add_RawText(mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,	lineBuff);
+	}
+	JsonResponse_Add_ArrayEnd(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,	INCLUDE_COMMA);
+	return(kASCOM_Err_Success);
+}
+
+#endif // _ENABLE_CAMERA_
@@ -0,0 +1,335 @@
+//**************************************************************************
+//*	Name:			cameradriver_capture.cpp
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Capture thread for the camera base class
+//*
+//*					The state machine used to call Check_Exposure() on every pass
+//*					of the main loop and count cWorkingLoopCnt while the exposure
+//*					was running, keeping every other device waiting on the SDK.
+//*
+//*					A driver whose SDK can be called from a second thread opts in by setting
+//*					cCaptureThreadEnabled in its constructor (ASI, ToupTek), all others
+//*					keep the old polling from the state machine.
+//*
+//*					The thread sleeps on cCaptureCond until the state machine sees the
+//*					camera in kCameraState_TakingPicture and posts a request (RequestCapture()).
+//*					It then blocks in Wait_ExposureComplete() until the SDK says the exposure
+//*					is done and calls Read_ImageData() under cCameraDataMutex to read it
+//*					out into the camera buffer. The result is posted for the state machine,
+//*					which does the rest (calibration, analysis, save) on the next pass.
+//*
+//*					The default Wait_ExposureComplete() sleeps once until the exposure should
+//*					be done (abort and stop wake it early). Drivers with a completion callback
+//*					(ToupTek, cCaptureEventDriven) then wait for SignalCaptureEvent(), the
+//*					others have no way to be told and poll Check_Exposure() for the readout,
+//*					backing off from 1 ms to kCapture_MaxReadoutPoll_us.
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb 24,	2021	<MLS> Created cameradriver_capture.cpp
+//*	Mar 30,	2021	<MLS> The thread waits for RequestCapture() instead of polling the state
+//*	Mar 30,	2021	<MLS> The capture thread is now opt in per driver (cCaptureThreadEnabled)
+//*	Mar 30,	2021	<MLS> One sleep for the exposure, SDK callback or backed off polling for the readout
+//*	Mar 30,	2021	<MLS> Read_ImageData() runs under cCameraDataMutex
+//*	Mar 30,	2021	<MLS> Added CaptureReadoutActive(), telemetry is not read during the readout
+//*****************************************************************************
+
+#ifdef _ENABLE_CAMERA_
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<time.h>
+#include	<sys/time.h>
+
+#define _ENABLE_CONSOLE_DEBUG_
+#include	"ConsoleDebug.h"
+
+#include	"alpacadriver.h"
+#include	"cameradriver.h"
+
+#define	kCapture_MinReadoutPoll_us	1000		//*	first poll once the exposure time is up
+#define	kCapture_MaxReadoutPoll_us	20000		//*	the poll interval doubles up to this
+#define	kCapture_EventTimeout_us	1000000		//*	callback drivers, check anyway if no event came
+
+//*****************************************************************************
+static void	TimedWait(pthread_cond_t *theCond, pthread_mutex_t *theMutex, const uint32_t waitTime_us)
+{
+struct timespec	wakeTime;
+
+	clock_gettime(CLOCK_MONOTONIC, &wakeTime);
+	wakeTime.tv_sec		+=	waitTime_us / 1000000;
+	wakeTime.tv_nsec	+=	(waitTime_us % 1000000) * 1000;
+	if (wakeTime.tv_nsec >= 1000000000)
+	{
+		wakeTime.tv_sec++;
+		wakeTime.tv_nsec	-=	1000000000;
+	}
+	pthread_cond_timedwait(theCond, theMutex, &wakeTime);
+}
+
+//*****************************************************************************
+static void	*CameraCaptureThread(void *arg)
+{
+CameraDriver	*cameraObj;
+
+	cameraObj	=	(CameraDriver *)arg;
+	cameraObj->RunCaptureThread();
+	return(NULL);
+}
+
+//*****************************************************************************
+//*	the mutex and condition are set up in the constructor so that SDK callbacks
+//*	can call SignalCaptureEvent() before the thread is running
+//*****************************************************************************
+void	CameraDriver::InitCaptureThread(void)
+{
+pthread_condattr_t	condAttr;
+
+	pthread_mutex_init(&cCaptureMutex, NULL);
+	pthread_condattr_init(&condAttr);
+	pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+	pthread_cond_init(&cCaptureCond, &condAttr);
+	pthread_condattr_destroy(&condAttr);
+
+	//*	the sub class turns it on if its SDK can be used from a second thread
+	cCaptureThreadEnabled	=	false;
+	cCaptureEventDriven		=	false;
+	cCaptureThreadActive	=	false;
+	cCaptureKeepRunning		=	false;
+	cCaptureEventPending	=	false;
+	cCaptureRequested		=	false;
+	cCaptureBusy			=	false;
+	cCaptureReadingOut		=	false;
+	cCaptureResult			=	kExposure_Working;
+	cCaptureReadErrCode		=	kASCOM_Err_Success;
+}
+
+//*****************************************************************************
+//*	started from the state machine, by then the sub class is fully constructed
+//*****************************************************************************
+void	CameraDriver::StartCaptureThread(void)
+{
+int		threadErr;
+
+	if (cCaptureThreadActive == false)
+	{
+		cCaptureKeepRunning	=	true;
+		cCaptureResult		=	kExposure_Working;
+		threadErr			=	pthread_create(&cCaptureThreadID, NULL, &CameraCaptureThread, this);
+		if (threadErr == 0)
+		{
+			cCaptureThreadActive	=	true;
+		}
+		else
+		{
+			//*	fall back to polling from the state machine
+			CONSOLE_DEBUG_W_NUM("Failed to create capture thread, err\t=", threadErr);
+			cCaptureKeepRunning		=	false;
+			cCaptureThreadEnabled	=	false;
+		}
+	}
+}
+
+//*****************************************************************************
+void	CameraDriver::StopCaptureThread(void)
+{
+	if (cCaptureThreadActive)
+	{
+		pthread_mutex_lock(&cCaptureMutex);
+		cCaptureKeepRunning	=	false;
+		pthread_cond_broadcast(&cCaptureCond);
+		pthread_mutex_unlock(&cCaptureMutex);
+
+		pthread_join(cCaptureThreadID, NULL);
+		cCaptureThreadActive	=	false;
+	}
+}
+
+//*****************************************************************************
+//*	called by drivers from their SDK callback when an image is ready
+//*****************************************************************************
+void	CameraDriver::SignalCaptureEvent(void)
+{
+	pthread_mutex_lock(&cCaptureMutex);
+	cCaptureEventPending	=	true;
+	pthread_cond_broadcast(&cCaptureCond);
+	pthread_mutex_unlock(&cCaptureMutex);
+}
+
+//*****************************************************************************
+//*	called by the state machine on every pass in kCameraState_TakingPicture,
+//*	wakes the thread once per exposure
+//*****************************************************************************
+void	CameraDriver::RequestCapture(void)
+{
+	pthread_mutex_lock(&cCaptureMutex);
+	if ((cCaptureRequested == false) && (cCaptureBusy == false) && (cCaptureResult == kExposure_Working))
+	{
+		cCaptureRequested		=	true;
+		pthread_cond_broadcast(&cCaptureCond);
+	}
+	pthread_mutex_unlock(&cCaptureMutex);
+}
+
+//*****************************************************************************
+//*	the state machine has finished with the posted result
+//*****************************************************************************
+void	CameraDriver::ClearCaptureResult(void)
+{
+	pthread_mutex_lock(&cCaptureMutex);
+	cCaptureResult	=	kExposure_Working;
+	pthread_mutex_unlock(&cCaptureMutex);
+}
+
+//*****************************************************************************
+//*	true from the end of the exposure time until the image has been read out.
+//*	The state machine does not make other SDK calls (temperature, cooler) then,
+//*	on some cameras they stall the USB transfer
+//*****************************************************************************
+bool	CameraDriver::CaptureReadoutActive(void)
+{
+bool	readingOut;
+
+	pthread_mutex_lock(&cCaptureMutex);
+	readingOut	=	cCaptureReadingOut;
+	pthread_mutex_unlock(&cCaptureMutex);
+	return(readingOut);
+}
+
+//*****************************************************************************
+//*	returns kExposure_Success, kExposure_Failed or kExposure_Idle (aborted)
+//*****************************************************************************
+TYPE_EXPOSURE_STATUS	CameraDriver::Wait_ExposureComplete(void)
+{
+TYPE_EXPOSURE_STATUS	exposureState;
+uint64_t				expectedEnd_us;
+uint64_t				currentTime_us;
+uint32_t				pollTime_us;
+
+	expectedEnd_us	=	cFrameTiming.current.stageStart_us[kFrameStage_Exposure] +
+						cFrameTiming.current.exposureRequested_us;
+
+	//*	nothing to ask the SDK until the exposure time is up, abort and stop signal the condition
+	pthread_mutex_lock(&cCaptureMutex);
+	currentTime_us	=	FrameTiming_GetMonotonic_us();
+	while (cCaptureKeepRunning && (cCaptureEventPending == false) &&
+			(cInternalCameraState == kCameraState_TakingPicture) &&
+			(currentTime_us < expectedEnd_us))
+	{
+		TimedWait(&cCaptureCond, &cCaptureMutex, (expectedEnd_us - currentTime_us));
+		currentTime_us	=	FrameTiming_GetMonotonic_us();
+	}
+	cCaptureReadingOut	=	cCaptureKeepRunning;
+	pthread_mutex_unlock(&cCaptureMutex);
+
+	pollTime_us		=	kCapture_MinReadoutPoll_us;
+	exposureState	=	kExposure_Working;
+	while (cCaptureKeepRunning && ((exposureState == kExposure_Working) || (exposureState == kExposure_Unknown)))
+	{
+		exposureState	=	Check_Exposure(false);
+		if ((exposureState == kExposure_Working) || (exposureState == kExposure_Unknown))
+		{
+			if (cInternalCameraState != kCameraState_TakingPicture)
+			{
+				//*	the exposure was aborted
+				exposureState	=	kExposure_Idle;
+			}
+			else
+			{
+				pthread_mutex_lock(&cCaptureMutex);
+				if ((cCaptureEventPending == false) && cCaptureKeepRunning)
+				{
+					TimedWait(	&cCaptureCond,
+								&cCaptureMutex,
+								(cCaptureEventDriven ? kCapture_EventTimeout_us : pollTime_us));
+				}
+				cCaptureEventPending	=	false;
+				pthread_mutex_unlock(&cCaptureMutex);
+				if (pollTime_us < kCapture_MaxReadoutPoll_us)
+				{
+					pollTime_us	*=	2;
+				}
+			}
+		}
+	}
+	if (cCaptureKeepRunning == false)
+	{
+		exposureState	=	kExposure_Idle;
+	}
+	return(exposureState);
+}
+
+//*****************************************************************************
+void	CameraDriver::RunCaptureThread(void)
+{
+TYPE_EXPOSURE_STATUS	exposureState;
+TYPE_ASCOM_STATUS		readErrCode;
+
+	CONSOLE_DEBUG_W_STR("Capture thread started for", cDeviceManufAbrev);
+	while (cCaptureKeepRunning)
+	{
+		//*	sleep until the state machine posts an exposure
+		pthread_mutex_lock(&cCaptureMutex);
+		while (cCaptureKeepRunning && (cCaptureRequested == false))
+		{
+			pthread_cond_wait(&cCaptureCond, &cCaptureMutex);
+		}
+		cCaptureRequested	=	false;
+		cCaptureBusy		=	cCaptureKeepRunning;
+		pthread_mutex_unlock(&cCaptureMutex);
+
+		if (cCaptureKeepRunning)
+		{
+			//*	exposures started from outside of the camera driver (multicam) still get a timeline
+			if (cFrameTiming.currentActive == false)
+			{
+				FrameTiming_StartFrame(&cFrameTiming, cCurrentExposure_us);
+			}
+
+			readErrCode		=	kASCOM_Err_Success;
+			exposureState	=	Wait_ExposureComplete();
+			if (exposureState == kExposure_Success)
+			{
+				FrameTiming_StageEnd(&cFrameTiming, kFrameStage_Exposure);
+				FrameTiming_StageBegin(&cFrameTiming, kFrameStage_Readout);
+				pthread_mutex_lock(&cCameraDataMutex);
+				readErrCode	=	Read_ImageData();
+				pthread_mutex_unlock(&cCameraDataMutex);
+				FrameTiming_StageEnd(&cFrameTiming, kFrameStage_Readout);
+				gettimeofday(&cLastexposure_EndTime, NULL);
+			}
+
+			//*	if the exposure was aborted, the state machine is not waiting for a result
+			pthread_mutex_lock(&cCaptureMutex);
+			if ((exposureState != kExposure_Idle) || (cInternalCameraState == kCameraState_TakingPicture))
+			{
+				cCaptureReadErrCode	=	readErrCode;
+				cCaptureResult		=	exposureState;
+			}
+			cCaptureBusy		=	false;
+			cCaptureReadingOut	=	false;
+			pthread_mutex_unlock(&cCaptureMutex);
+		}
+	}
+	CONSOLE_DEBUG("Capture thread -- exit --");
+}
+
+#endif	//	_ENABLE_CAMERA_
@@ -79,6 +79,18 @@
 //*	Dec 14,	2020	<MLS> Just discovered a new version of cfitsio (3.49)
 //*	Jan 19,	2021	<MLS> Added ROWORDER:BOTTOM-UP to FITS header
 //*	Jan 20,	2021	<MLS> Added ExtractFitsHeader()
+//*	Feb 10,	2021	<MLS> CreateFitsBGRimage() can use debayered RAW color data
+//*	Feb 17,	2021	<MLS> Added STARCNT, HFR, FWHM, SKYBKG, SKYNOISE from the star detector
+//*	Mar  6,	2021	<MLS> Added tile compressed output (Rice or HCOMPRESS), saved as .fits.fz
+//*	Mar  8,	2021	<MLS> Added UpdateFitsSnapshot(), CaptureFitsSnapshot(), WriteFITS_Snapshot()
+//*	Mar  8,	2021	<MLS> Device info is written from the snapshot, no device calls at save time
+//*	Mar 10,	2021	<MLS> Saved FITS files are added to the image catalog
+//*	Mar 26,	2021	<MLS> Header space is reserved for the quality keywords, added later
+//*	Mar 26,	2021	<MLS> Added ECCENTR from the star detector
+//*	Mar 28,	2021	<MLS> CCD-TEMP comes from the sensor telemetry, not from the camera
+//*	Mar 30,	2021	<MLS> The snapshot is built under cFitsSnapshotMutex, Put_StartExposure runs on the listen thread
+//*	Mar 30,	2021	<MLS> Removed the debayer path from CreateFitsBGRimage(), it is only called for RGB24
+//*	Mar 30,	2021	<MLS> The snapshot is rebuilt by its own thread, CaptureFitsSnapshot() only copies
 //*****************************************************************************
 
 #if defined(_ENABLE_CAMERA_) && defined(_ENABLE_FITS_)
@@ -89,6 +101,7 @@
 #include	<stdio.h>
 #include	<stdlib.h>
 #include	<string.h>
+#include	<time.h>
 
 #if defined(__arm__)
 	#include <wiringPi.h>
@@ -374,6 +387,8 @@ char			imageFilePath[128];
 char			errorString[64];
 int				fits_bitpix;
 int				fitsDataType;
+bool			compressImage;
+long			tileSize[3];
 uint32_t		startMillisecs;
 uint32_t		stopMillisecs;
 uint32_t		deltaMillisecs;
@@ -382,10 +397,21 @@ int				iii;
 	CONSOLE_DEBUG(__FUNCTION__);
 	startMillisecs	=	millis();
 
+	ResolveFrameFitsSnapshot();
+
+	//*	the header only file for video is tiny, it never gets compressed
+	compressImage	=	((cFitsCompression != kFitsCompress_None) && (headerOnly == false));
+
+	cLastFitsFileName[0]	=	0;
 	GenerateFileNameRoot();
 	strcpy(imageFileName, cFileNameRoot);
 	strcpy(imageFileName, cFileNameRoot);
 	strcat(imageFileName, ".fits");
+	if (compressImage)
+	{
+		//*	fpack naming convention
+		strcat(imageFileName, ".fz");
+	}
 
 	strcpy(imageFilePath, kImageDataDir);
 	strcat(imageFilePath, "/");
@@ -413,7 +439,8 @@ int				iii;
 
 		case kImageType_RAW16:
 //			CONSOLE_DEBUG("kImageType_RAW16");
-			fits_bitpix		=	SHORT_IMG;
+			//*	the compressor has to know the data is unsigned before the first pixel is written
+			fits_bitpix		=	compressImage ? USHORT_IMG : SHORT_IMG;
 			fitsDataType	=	TUSHORT;
 			bzero			=	32768.0;
 			break;
@@ -454,6 +481,35 @@ int				iii;
 	if (fitsRetCode == 0)
 	{
 		CONSOLE_DEBUG("fits_create_file = SUCCESS");
+		//************************************************************
+		//*	tile compression has to be set up before the image is created,
+		//*	the compression itself happens as the pixels are written
+		//************************************************************
+		if (compressImage)
+		{
+			//*	Rice works on one row at a time, HCOMPRESS needs 2 dimensional tiles
+			tileSize[0]	=	naxes[0];
+			tileSize[1]	=	1;
+			tileSize[2]	=	1;
+			fitsStatus	=	0;
+			if (cFitsCompression == kFitsCompress_HCompress)
+			{
+				tileSize[1]	=	16;
+				fits_set_compression_type(fitsFilePtr, HCOMPRESS_1, &fitsStatus);
+				//*	scale of 0 is lossless
+				fits_set_hcomp_scale(fitsFilePtr, 0.0, &fitsStatus);
+			}
+			else
+			{
+				fits_set_compression_type(fitsFilePtr, RICE_1, &fitsStatus);
+			}
+			fits_set_tile_dim(fitsFilePtr, axisCnt, tileSize, &fitsStatus);
+			if (fitsStatus != 0)
+			{
+				CONSOLE_DEBUG_W_NUM("Failed to set FITS compression, fitsStatus\t=", fitsStatus);
+			}
+		}
+
 		//************************************************************
 		//*	this MUST be first
 		//************************************************************
@@ -466,11 +522,22 @@ int				iii;
 		}
 		WriteFITS_Seperator(fitsFilePtr, "");
 
+		//*	USHORT_IMG already wrote these, update instead of adding a second copy
 		fitsStatus	=	0;
-		fits_write_key(fitsFilePtr, TFLOAT,		"BSCALE",		&bscale,		NULL, &fitsStatus);
+		fits_update_key(fitsFilePtr, TFLOAT,	"BSCALE",		&bscale,		NULL, &fitsStatus);
 
 		fitsStatus	=	0;
-		fits_write_key(fitsFilePtr, TFLOAT,		"BZERO",		&bzero,			NULL, &fitsStatus);
+		fits_update_key(fitsFilePtr, TFLOAT,	"BZERO",		&bzero,			NULL, &fitsStatus);
+
+		if (compressImage)
+		{
+			fitsStatus	=	0;
+			fits_write_key(fitsFilePtr, TSTRING,	"COMMENT",
+													(void *)((cFitsCompression == kFitsCompress_HCompress) ?
+																"Tile compressed, HCOMPRESS lossless" :
+																"Tile compressed, Rice"),
+													NULL, &fitsStatus);
+		}
 
 //		WriteFITS_Seperator(fitsFilePtr, NULL);
 
@@ -532,45 +599,64 @@ int				iii;
 		//*	Camera info
 		WriteFITS_CameraInfo(fitsFilePtr);
 
-		//************************************************************
-		//*	Telescope info
-		WriteFITS_TelescopeInfo(fitsFilePtr);
+		if (cFrameFitsSnapshot.valid)
+		{
+			//************************************************************
+			//*	Telescope through FITS version info, as it was at exposure start
+			WriteFITS_Snapshot(fitsFilePtr);
+		}
+		else
+		{
+			//*	video and anything else that did not go through exposure start
+			//************************************************************
+			//*	Telescope info
+			WriteFITS_TelescopeInfo(fitsFilePtr);
 
-		//************************************************************
-		//*	Focuser info
-		WriteFITS_FocuserInfo(fitsFilePtr);
+			//************************************************************
+			//*	Focuser info
+			WriteFITS_FocuserInfo(fitsFilePtr);
 
-		//************************************************************
-		//*	Rotator info
-		WriteFITS_RotatorInfo(fitsFilePtr);
+			//************************************************************
+			//*	Rotator info
+			WriteFITS_RotatorInfo(fitsFilePtr);
 
-		//************************************************************
-		//*	Filterwheel info
-		WriteFITS_FilterwheelInfo(fitsFilePtr);
+			//************************************************************
+			//*	Filterwheel info
+			WriteFITS_FilterwheelInfo(fitsFilePtr);
 
-		//************************************************************
-		//*	Observatory info
-		WriteFITS_ObservatoryInfo(fitsFilePtr);
+			//************************************************************
+			//*	Observatory info
+			WriteFITS_ObservatoryInfo(fitsFilePtr);
 
-		//************************************************************
-		//*	Environment/weather info
-		WriteFITS_EnvironmentInfo(fitsFilePtr);
+			//************************************************************
+			//*	Environment/weather info
+			WriteFITS_EnvironmentInfo(fitsFilePtr);
 
-		//************************************************************
-		//*	Moon information
-		WriteFITS_MoonInfo(fitsFilePtr);
+			//************************************************************
+			//*	Moon information
+			WriteFITS_MoonInfo(fitsFilePtr);
 
-		//************************************************************
-		//*	Software info
-		WriteFITS_SoftwareInfo(fitsFilePtr);
+			//************************************************************
+			//*	Software info
+			WriteFITS_SoftwareInfo(fitsFilePtr);
 
 
-		//************************************************************
-		//*	FITS version info
-		WriteFITS_VersionInfo(fitsFilePtr);
+			//************************************************************
+			//*	FITS version info
+			WriteFITS_VersionInfo(fitsFilePtr);
+		}
 
 
 		WriteFITS_Seperator(fitsFilePtr, "");
+
+		//*	the quality thread adds its keywords after the file is closed,
+		//*	with the space already there the header does not have to grow
+		if (cQualityMetrics.enabled && (headerOnly == false))
+		{
+			fitsStatus	=	0;
+			fits_set_hdrsize(fitsFilePtr, kQuality_FitsKeyCnt, &fitsStatus);
+		}
+
 		//------------------------------------------------------------------------
 		//*	now deal with the image data
 		if ((cCameraDataBuffer != NULL) && (headerOnly == false))
@@ -685,6 +771,8 @@ int				iii;
 		if (fitsRetCode == 0)
 		{
 			CONSOLE_DEBUG("fits_close_file = SUCCESS");
+			CatalogSavedFile(imageFileName);
+			strcpy(cLastFitsFileName, imageFileName);
 		}
 		else
 		{
@@ -706,6 +794,9 @@ int				iii;
 
 //	CONSOLE_DEBUG_W_STR(__FUNCTION__, "Exit");
 
+	//*	used up, the next exposure takes a new copy
+	cFrameFitsSnapshot.valid	=	false;
+
 	stopMillisecs	=	millis();
 	deltaMillisecs	=	stopMillisecs - startMillisecs;
 	CONSOLE_DEBUG_W_NUM("Time to save FITS file (milliseconds)\t=",	deltaMillisecs);
@@ -831,7 +922,9 @@ char	stringBuf[128];
 double	megaPixels;
 int		intValue;
 int		ccdTempErrCode;
+double	ccdTemp_degC;
 char	instrumentString[128];
+TYPE_SENSOR_TELEMETRY	telemetry;
 
 	CONSOLE_DEBUG(__FUNCTION__);
 
@@ -894,12 +987,23 @@ char	instrumentString[128];
 											stringBuf,
 											"Image mode from camera", &fitsStatus);
 
-	ccdTempErrCode	=	Read_SensorTemp();
+	//*	the snapshot read the temperature so the save does not have to talk to the camera
+	if (cFrameFitsSnapshot.valid)
+	{
+		ccdTempErrCode	=	(cFrameFitsSnapshot.ccdTempValid ? 0 : kASCOM_Err_NotImplemented);
+		ccdTemp_degC	=	cFrameFitsSnapshot.ccdTemp_degC;
+	}
+	else
+	{
+		GetSensorTelemetry(&telemetry);
+		ccdTempErrCode	=	telemetry.ccdTempErr;
+		ccdTemp_degC	=	telemetry.ccdTemp_degC;
+	}
 	if (ccdTempErrCode == 0)
 	{
 		fitsStatus	=	0;
 		fits_write_key(fitsFilePtr, TDOUBLE,	"CCD-TEMP",
-												&cCameraTemp_Dbl,
+												&ccdTemp_degC,
 												"Degrees C", &fitsStatus);
 	}
 
@@ -1032,7 +1136,7 @@ char	instrumentString[128];
 	//*	this was kept here so we dont have to read the CCD temperature twice
 	if (ccdTempErrCode == 0)
 	{
-		sprintf(stringBuf, "Image Sensor Temperature: %1.1f deg C, %1.1f deg F", cCameraTemp_Dbl, ((cCameraTemp_Dbl * 9.0/5.0) + 32.0));
+		sprintf(stringBuf, "Image Sensor Temperature: %1.1f deg C, %1.1f deg F", ccdTemp_degC, ((ccdTemp_degC * 9.0/5.0) + 32.0));
 	}
 	else
 	{
@@ -1672,6 +1776,24 @@ double			modifiedJulianDate;
 		fits_write_key(fitsFilePtr, TSTRING,	"COMMENT",
 												stringBuf,
 												NULL, &fitsStatus);
+
+		//---------------------------------------------------------------------------------------
+		//*	star detection, only if it was done on this frame
+		if (cStarAnalysis.valid && (cStarAnalysis.frameNumber == cFramesRead))
+		{
+			fitsStatus	=	0;
+			fits_write_key(fitsFilePtr, TINT,	"STARCNT",
+												&cStarAnalysis.starCnt,
+												"Number of stars detected", &fitsStatus);
+			if (cStarAnalysis.starCnt > 0)
+			{
+				WriteFitsFloatValue(fitsFilePtr,	"HFR",		cStarAnalysis.medianHFR,	"Median half flux radius (pixels)");
+				WriteFitsFloatValue(fitsFilePtr,	"FWHM",		cStarAnalysis.medianFWHM,	"Median star FWHM (pixels)");
+				WriteFitsFloatValue(fitsFilePtr,	"ECCENTR",	cStarAnalysis.medianEccentricity,	"Median star eccentricity");
+			}
+			WriteFitsFloatValue(fitsFilePtr,	"SKYBKG",	cStarAnalysis.background,	"Median sky background (ADU)");
+			WriteFitsFloatValue(fitsFilePtr,	"SKYNOISE",	cStarAnalysis.noise,		"Sky background noise (ADU)");
+		}
 	}
 }
 
@@ -2126,6 +2248,376 @@ char		moonPhaseStr[64];
 
 #pragma mark -
 
+//*****************************************************************************
+//*	same as the one in cameradriver_capture.cpp, the condition uses CLOCK_MONOTONIC
+//*****************************************************************************
+static void	TimedWait(pthread_cond_t *theCond, pthread_mutex_t *theMutex, const uint32_t waitTime_us)
+{
+struct timespec	wakeTime;
+
+	clock_gettime(CLOCK_MONOTONIC, &wakeTime);
+	wakeTime.tv_sec		+=	waitTime_us / 1000000;
+	wakeTime.tv_nsec	+=	(waitTime_us % 1000000) * 1000;
+	if (wakeTime.tv_nsec >= 1000000000)
+	{
+		wakeTime.tv_sec++;
+		wakeTime.tv_nsec	-=	1000000000;
+	}
+	pthread_cond_timedwait(theCond, theMutex, &wakeTime);
+}
+
+//*****************************************************************************
+static void	*FitsSnapshotThread(void *arg)
+{
+CameraDriver	*cameraObj;
+
+	cameraObj	=	(CameraDriver *)arg;
+	cameraObj->RunFitsSnapshotThread();
+	return(NULL);
+}
+
+//*****************************************************************************
+//*	called from the constructor
+//*****************************************************************************
+void	CameraDriver::InitFitsSnapshot(void)
+{
+pthread_condattr_t	condAttr;
+
+	memset(&cFitsSnapshot,		0,	sizeof(TYPE_FITS_SNAPSHOT));
+	memset(&cFrameFitsSnapshot,	0,	sizeof(TYPE_FITS_SNAPSHOT));
+	pthread_mutex_init(&cFitsSnapshotMutex, NULL);
+	pthread_condattr_init(&condAttr);
+	pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+	pthread_cond_init(&cFitsSnapshotCond, &condAttr);
+	pthread_condattr_destroy(&condAttr);
+
+	cFitsSnapshotThreadEnabled	=	true;
+	cFitsSnapshotThreadActive	=	false;
+	cFitsSnapshotKeepRunning	=	false;
+	cFitsSnapshotBuildCnt		=	0;
+	cFitsSnapshotBuildWanted	=	0;
+}
+
+//*****************************************************************************
+//*	started from the state machine, by then the sub class is fully constructed
+//*****************************************************************************
+void	CameraDriver::StartFitsSnapshotThread(void)
+{
+int		threadErr;
+
+	if (cFitsSnapshotThreadActive == false)
+	{
+		cFitsSnapshotKeepRunning	=	true;
+		threadErr					=	pthread_create(&cFitsSnapshotThreadID, NULL, &FitsSnapshotThread, this);
+		if (threadErr == 0)
+		{
+			cFitsSnapshotThreadActive	=	true;
+		}
+		else
+		{
+			//*	fall back to building it from the state machine
+			CONSOLE_DEBUG_W_NUM("Failed to create FITS snapshot thread, err\t=", threadErr);
+			cFitsSnapshotKeepRunning	=	false;
+			cFitsSnapshotThreadEnabled	=	false;
+		}
+	}
+}
+
+//*****************************************************************************
+void	CameraDriver::StopFitsSnapshotThread(void)
+{
+	if (cFitsSnapshotThreadActive)
+	{
+		pthread_mutex_lock(&cFitsSnapshotMutex);
+		cFitsSnapshotKeepRunning	=	false;
+		pthread_cond_broadcast(&cFitsSnapshotCond);
+		pthread_mutex_unlock(&cFitsSnapshotMutex);
+
+		pthread_join(cFitsSnapshotThreadID, NULL);
+		cFitsSnapshotThreadActive	=	false;
+	}
+}
+
+//*****************************************************************************
+//*	rebuilds the snapshot when it gets stale or when an exposure asks for it.
+//*	The device queries take as long as the devices take to answer, nobody
+//*	waits on the mutex while they run
+//*****************************************************************************
+void	CameraDriver::RunFitsSnapshotThread(void)
+{
+	CONSOLE_DEBUG(__FUNCTION__);
+	pthread_mutex_lock(&cFitsSnapshotMutex);
+	while (cFitsSnapshotKeepRunning)
+	{
+		if (FitsSnapshotIsStale() || (cFitsSnapshotBuildCnt < cFitsSnapshotBuildWanted))
+		{
+			pthread_mutex_unlock(&cFitsSnapshotMutex);
+			BuildFitsSnapshot();
+			pthread_mutex_lock(&cFitsSnapshotMutex);
+		}
+		else
+		{
+			TimedWait(&cFitsSnapshotCond, &cFitsSnapshotMutex, 1000000);
+		}
+	}
+	pthread_mutex_unlock(&cFitsSnapshotMutex);
+	CONSOLE_DEBUG_W_STR(__FUNCTION__, "Exit");
+}
+
+//*****************************************************************************
+//*	true if the snapshot needs to be rebuilt.
+//*	Device changes are held off for a couple of seconds so a moving focuser
+//*	does not cause a rebuild on every pass through the state machine.
+//*	the caller holds cFitsSnapshotMutex
+//*****************************************************************************
+bool	CameraDriver::FitsSnapshotIsStale(void)
+{
+bool	isStale;
+time_t	snapshotAge;
+
+	isStale	=	false;
+	if (cFitsSnapshot.valid == false)
+	{
+		isStale	=	true;
+	}
+	else
+	{
+		snapshotAge	=	time(NULL) - cFitsSnapshot.buildTime;
+		if (snapshotAge >= kFitsSnapshot_MaxAge_Secs)
+		{
+			isStale	=	true;
+		}
+		else if (snapshotAge >= kFitsSnapshot_MinAge_Secs)
+		{
+			if ((cFitsSnapshot.deviceChangeCnt != gDeviceStateChangeCnt) ||
+				(cFitsSnapshot.siteEnvUpdate != gEnvData.siteLastUpdate.tv_sec) ||
+				(cFitsSnapshot.domeEnvUpdate != gEnvData.domeLastUpdate.tv_sec))
+			{
+				isStale	=	true;
+			}
+		}
+	}
+	return(isStale);
+}
+
+//*****************************************************************************
+//*	Runs the normal FITS header routines into a memory file and keeps the cards.
+//*	This is where the focuser, filter wheel and rotator get queried and the
+//*	moon gets calculated, so none of it happens when the image is saved.
+//*	snapshot is private to the caller, no lock is held
+//*****************************************************************************
+void	CameraDriver::UpdateFitsSnapshot(TYPE_FITS_SNAPSHOT *snapshot)
+{
+fitsfile		*fitsFilePtr;
+int				fitsRetCode;
+int				fitsStatus;
+int				firstKey;
+int				keyCnt;
+int				moreKeys;
+int				keyIdx;
+char			card[FLEN_CARD];
+uint32_t		startMillisecs;
+TYPE_SENSOR_TELEMETRY	telemetry;
+
+	startMillisecs	=	millis();
+
+	//*	take the change counts first, a change during the build will cause another one
+	snapshot->deviceChangeCnt	=	gDeviceStateChangeCnt;
+	snapshot->siteEnvUpdate		=	gEnvData.siteLastUpdate.tv_sec;
+	snapshot->domeEnvUpdate		=	gEnvData.domeLastUpdate.tv_sec;
+	snapshot->buildTime			=	time(NULL);
+	snapshot->waitForBuild		=	0;
+	snapshot->recordCnt			=	0;
+	snapshot->valid				=	false;
+
+	GetSensorTelemetry(&telemetry);
+	snapshot->ccdTempValid		=	(telemetry.ccdTempErr == kASCOM_Err_Success);
+	snapshot->ccdTemp_degC		=	telemetry.ccdTemp_degC;
+
+	fitsStatus	=	0;
+	fitsRetCode	=	fits_create_file(&fitsFilePtr, "mem://", &fitsStatus);
+	if (fitsRetCode == 0)
+	{
+		//*	a header with no data, only so the required keywords can be skipped
+		fitsStatus	=	0;
+		fits_create_img(fitsFilePtr, BYTE_IMG, 0, NULL, &fitsStatus);
+		fitsStatus	=	0;
+		fits_get_hdrspace(fitsFilePtr, &firstKey, &moreKeys, &fitsStatus);
+
+		WriteFITS_TelescopeInfo(fitsFilePtr);
+		WriteFITS_FocuserInfo(fitsFilePtr);
+		WriteFITS_RotatorInfo(fitsFilePtr);
+		WriteFITS_FilterwheelInfo(fitsFilePtr);
+		WriteFITS_ObservatoryInfo(fitsFilePtr);
+		WriteFITS_EnvironmentInfo(fitsFilePtr);
+		WriteFITS_MoonInfo(fitsFilePtr);
+		WriteFITS_SoftwareInfo(fitsFilePtr);
+		WriteFITS_VersionInfo(fitsFilePtr);
+
+		fitsStatus	=	0;
+		fits_get_hdrspace(fitsFilePtr, &keyCnt, &moreKeys, &fitsStatus);
+		for (keyIdx = (firstKey + 1); keyIdx <= keyCnt; keyIdx++)
+		{
+			fitsStatus	=	0;
+			fits_read_record(fitsFilePtr, keyIdx, card, &fitsStatus);
+			if ((fitsStatus == 0) && (snapshot->recordCnt < kFitsSnapshot_MaxRecords))
+			{
+				strcpy(snapshot->records[snapshot->recordCnt].fitsRec, card);
+				snapshot->recordCnt++;
+			}
+		}
+		if (keyCnt > (firstKey + kFitsSnapshot_MaxRecords))
+		{
+			CONSOLE_DEBUG_W_NUM("FITS snapshot truncated, cards\t=", (keyCnt - firstKey));
+		}
+		fitsStatus	=	0;
+		fits_close_file(fitsFilePtr, &fitsStatus);
+		snapshot->valid	=	true;
+	}
+	else
+	{
+		CONSOLE_DEBUG_W_NUM("Failed to create FITS memory file, fitsStatus\t=", fitsStatus);
+	}
+	snapshot->build_ms	=	millis() - startMillisecs;
+	if (gVerbose)
+	{
+		CONSOLE_DEBUG_W_NUM("FITS snapshot built (milliseconds)\t=",	snapshot->build_ms);
+	}
+}
+
+//*****************************************************************************
+//*	builds a new snapshot outside of the lock and swaps it in.
+//*	the caller does not hold cFitsSnapshotMutex
+//*****************************************************************************
+void	CameraDriver::BuildFitsSnapshot(void)
+{
+TYPE_FITS_SNAPSHOT	newSnapshot;
+uint32_t			buildSeq;
+
+	pthread_mutex_lock(&cFitsSnapshotMutex);
+	cFitsSnapshotBuildCnt++;
+	buildSeq	=	cFitsSnapshotBuildCnt;
+	pthread_mutex_unlock(&cFitsSnapshotMutex);
+
+	UpdateFitsSnapshot(&newSnapshot);
+	newSnapshot.buildSeq	=	buildSeq;
+
+	pthread_mutex_lock(&cFitsSnapshotMutex);
+	cFitsSnapshot	=	newSnapshot;
+	pthread_cond_broadcast(&cFitsSnapshotCond);
+	pthread_mutex_unlock(&cFitsSnapshotMutex);
+}
+
+//*****************************************************************************
+//*	called from the state machine while idle
+//*****************************************************************************
+void	CameraDriver::RefreshFitsSnapshot(void)
+{
+bool	isStale;
+
+	if (cFitsSnapshotThreadEnabled)
+	{
+		StartFitsSnapshotThread();
+	}
+	if (cFitsSnapshotThreadActive == false)
+	{
+		pthread_mutex_lock(&cFitsSnapshotMutex);
+		isStale	=	FitsSnapshotIsStale();
+		pthread_mutex_unlock(&cFitsSnapshotMutex);
+		if (isStale)
+		{
+			BuildFitsSnapshot();
+		}
+	}
+}
+
+//*****************************************************************************
+//*	the snapshot thread rebuilds it right away
+//*****************************************************************************
+void	CameraDriver::InvalidateFitsSnapshot(void)
+{
+	pthread_mutex_lock(&cFitsSnapshotMutex);
+	cFitsSnapshot.valid	=	false;
+	pthread_cond_broadcast(&cFitsSnapshotCond);
+	pthread_mutex_unlock(&cFitsSnapshotMutex);
+}
+
+//*****************************************************************************
+//*	called as the exposure is started, the copy goes with this frame.
+//*	Put_StartExposure() runs on the listen thread, this only copies, it never
+//*	talks to the devices.
+//*	A filter wheel move right before the exposure is not allowed to go into the
+//*	header with the old filter, if a device changed since the last build the
+//*	frame asks for a build that starts after now and picks it up at save time
+//*****************************************************************************
+void	CameraDriver::CaptureFitsSnapshot(void)
+{
+	pthread_mutex_lock(&cFitsSnapshotMutex);
+	cFrameFitsSnapshot	=	cFitsSnapshot;
+	if ((cFitsSnapshot.valid == false) || (cFitsSnapshot.deviceChangeCnt != gDeviceStateChangeCnt))
+	{
+		cFitsSnapshotBuildWanted		=	cFitsSnapshotBuildCnt + 1;
+		cFrameFitsSnapshot.waitForBuild	=	cFitsSnapshotBuildWanted;
+		pthread_cond_broadcast(&cFitsSnapshotCond);
+	}
+	pthread_mutex_unlock(&cFitsSnapshotMutex);
+}
+
+//*****************************************************************************
+//*	called from SaveImageAsFITS(), the exposure is over by now so the build
+//*	it asked for is usually done. If not, wait a few seconds for it, after that
+//*	the copy from the start of the exposure is used
+//*****************************************************************************
+void	CameraDriver::ResolveFrameFitsSnapshot(void)
+{
+time_t	waitStartTime;
+
+	if (cFrameFitsSnapshot.waitForBuild == 0)
+	{
+		return;
+	}
+	if (cFitsSnapshotThreadActive == false)
+	{
+		BuildFitsSnapshot();
+	}
+	pthread_mutex_lock(&cFitsSnapshotMutex);
+	waitStartTime	=	time(NULL);
+	while (cFitsSnapshotThreadActive &&
+			(cFitsSnapshot.buildSeq < cFrameFitsSnapshot.waitForBuild) &&
+			((time(NULL) - waitStartTime) < kFitsSnapshot_BuildWait_Secs))
+	{
+		TimedWait(&cFitsSnapshotCond, &cFitsSnapshotMutex, 500000);
+	}
+	if ((cFitsSnapshot.buildSeq >= cFrameFitsSnapshot.waitForBuild) && cFitsSnapshot.valid)
+	{
+		cFrameFitsSnapshot	=	cFitsSnapshot;
+	}
+	else
+	{
+		CONSOLE_DEBUG("FITS snapshot build not done, using the one from the start of the exposure");
+	}
+	cFrameFitsSnapshot.waitForBuild	=	0;
+	pthread_mutex_unlock(&cFitsSnapshotMutex);
+}
+
+//*****************************************************************************
+void	CameraDriver::WriteFITS_Snapshot(fitsfile *fitsFilePtr)
+{
+int		fitsStatus;
+int		iii;
+
+	for (iii=0; iii<cFrameFitsSnapshot.recordCnt; iii++)
+	{
+		fitsStatus	=	0;
+		fits_write_record(fitsFilePtr, cFrameFitsSnapshot.records[iii].fitsRec, &fitsStatus);
+	}
+}
+
+#pragma mark -
+
+//*****************************************************************************
+//*	RGB24 data is split into 3 planes, B, G, R
+//*	RAW color frames are written as the bayer data, they never come here
 //*****************************************************************************
 void		CameraDriver::CreateFitsBGRimage(void)
 {
@@ -29,12 +29,16 @@
 //*	Jan 29,	2020	<MLS> Created cameradriver_jpeg.cpp
 //*	Jan 29,	2020	<MLS> Can save jpegs using libjpeg instead of opencv
 //*	Jan 29,	2020	<MLS> Successfully saving jpegs on NVidia/jetson
+//*	Feb 10,	2021	<MLS> RAW color images are debayered, monochrome saved as grayscale
+//*	Mar 30,	2021	<MLS> Holds cPreviewMutex while it uses the debayered image
+//*	Mar 30,	2021	<MLS> The image is copied under cPreviewMutex, the file is written from the copy
 //*****************************************************************************
 
 
 #ifdef _ENABLE_JPEGLIB_
 
 #include	<stdio.h>
+#include	<stdlib.h>
 #include	<string.h>
 
 
@@ -45,6 +49,7 @@
 #include	"ConsoleDebug.h"
 
 #include	"cameradriver.h"
+#include	"imagepool.h"
 
 
 //**************************************************************************************
@@ -57,9 +62,26 @@ JSAMPROW					row_pointer[1];
 int							row_stride;
 char						imageFileName[64];
 char						imageFilePath[128];
+int							width;
+int							height;
+int							ii;
+unsigned char				*imageDataPtr;
+unsigned char				*imageCopy;
+long						copyLen;
+unsigned char				*rowBuffer;
+uint16_t					*pixel16Ptr;
+bool						convert16;
 
 //	CONSOLE_DEBUG(__FUNCTION__);
 
+	width	=	cROIinfo.currentROIwidth;
+	height	=	cROIinfo.currentROIheight;
+	if ((width <= 0) || (height <= 0))
+	{
+		width	=	cCameraXsize;
+		height	=	cCameraYsize;
+	}
+
 	strcpy(imageFileName, cFileNameRoot);
 	strcat(imageFileName, ".jpg");
 
@@ -71,26 +93,92 @@ char						imageFilePath[128];
 
 	jpeg_create_compress(&jinfo);
 
-	outputFile	=	fopen(imageFilePath, "wb");
+	//*	figure out what we are going to write
+	pthread_mutex_lock(&cPreviewMutex);
+	imageDataPtr			=	cCameraDataBuffer;
+	jinfo.input_components	=	3;
+	jinfo.in_color_space	=	JCS_RGB;
+	convert16				=	false;
+	switch(cROIinfo.currentROIimageType)
+	{
+		case kImageType_RAW8:
+		case kImageType_RAW16:
+			if (IsRawColorImage())
+			{
+				imageDataPtr	=	GetDebayeredImage(false);
+			}
+			else
+			{
+				jinfo.input_components	=	1;
+				jinfo.in_color_space	=	JCS_GRAYSCALE;
+				convert16				=	(cROIinfo.currentROIimageType == kImageType_RAW16);
+			}
+			break;
+
+		case kImageType_Y8:
+			jinfo.input_components	=	1;
+			jinfo.in_color_space	=	JCS_GRAYSCALE;
+			break;
+
+		default:
+			break;
+	}
+	row_stride	=	width * jinfo.input_components;
+	//*	the file is written from a copy, the mutex is not held during the disk I/O
+	imageCopy	=	NULL;
+	if (imageDataPtr != NULL)
+	{
+		copyLen		=	(long)row_stride * height * (convert16 ? 2 : 1);
+		imageCopy	=	(unsigned char *)ImagePool_Alloc(copyLen);
+		if (imageCopy != NULL)
+		{
+			pthread_mutex_lock(&cCameraDataMutex);
+			memcpy(imageCopy, imageDataPtr, copyLen);
+			pthread_mutex_unlock(&cCameraDataMutex);
+		}
+	}
+	pthread_mutex_unlock(&cPreviewMutex);
+	imageDataPtr	=	imageCopy;
+
+	rowBuffer	=	NULL;
+	if (convert16)
+	{
+		rowBuffer	=	(unsigned char *)malloc(row_stride);
+	}
+
+	outputFile	=	NULL;
+	if ((imageDataPtr != NULL) && ((convert16 == false) || (rowBuffer != NULL)))
+	{
+		outputFile	=	fopen(imageFilePath, "wb");
+	}
 	if (outputFile != NULL)
 	{
 		jpeg_stdio_dest(&jinfo, outputFile);
 
-		jinfo.image_width		=	cCameraXsize;
-		jinfo.image_height		=	cCameraYsize;
-		jinfo.input_components	=	3;
-		jinfo.in_color_space	=	JCS_RGB;
+		jinfo.image_width		=	width;
+		jinfo.image_height		=	height;
 
 		jpeg_set_defaults(&jinfo);
 		jpeg_set_quality(&jinfo, 95, TRUE);
 
 		jpeg_start_compress(&jinfo, TRUE);
 
-		row_stride				=	cCameraXsize * 3;
-
 		while (jinfo.next_scanline < jinfo.image_height)
 		{
-			row_pointer[0]	=	&cCameraDataBuffer[jinfo.next_scanline * row_stride];
+			if (convert16)
+			{
+				//*	keep the high byte of each 16 bit pixel
+				pixel16Ptr	=	(uint16_t *)imageDataPtr + ((long)jinfo.next_scanline * width);
+				for (ii=0; ii<width; ii++)
+				{
+					rowBuffer[ii]	=	pixel16Ptr[ii] >> 8;
+				}
+				row_pointer[0]	=	rowBuffer;
+			}
+			else
+			{
+				row_pointer[0]	=	&imageDataPtr[(long)jinfo.next_scanline * row_stride];
+			}
 			jpeg_write_scanlines(&jinfo, row_pointer, 1);
 
 		}
@@ -105,6 +193,15 @@ char						imageFilePath[128];
 	{
 		CONSOLE_DEBUG("Failed to create file");
 	}
+	jpeg_destroy_compress(&jinfo);
+	if (imageCopy != NULL)
+	{
+		ImagePool_Release(imageCopy);
+	}
+	if (rowBuffer != NULL)
+	{
+		free(rowBuffer);
+	}
 }
 
 #endif	//	_ENABLE_JPEGLIB_
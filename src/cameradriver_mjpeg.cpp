@@ -0,0 +1,666 @@
+//**************************************************************************
+//*	Name:			cameradriver_mjpeg.cpp
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	MJPEG live view stream
+//*
+//*					Clients that want a live view used to poll /image.jpg, a new
+//*					connection and a file read for every frame and no way to know
+//*					when there was a new one.
+//*
+//*					GET /api/v1/camera/0/mjpeg?MaxDim=800
+//*
+//*					answers with multipart/x-mixed-replace and keeps the connection
+//*					open, every new image is pushed as one JPEG part. A browser can
+//*					show it with a plain <img src=...> tag.
+//*
+//*					Each frame is encoded once per preview size (from the image
+//*					pyramid, see GetPreviewImage()) no matter how many clients are
+//*					watching. The encoding is done by the camera state machine, the
+//*					sending is done by the stream thread. A client that has not taken
+//*					the last frame yet skips frames, it never holds up the camera
+//*					or the other clients.
+//*
+//*					The JPEGs come from CreatePreviewJpeg(), libjpeg or openCV.
+//*					A build with neither has nothing to send, the clients get
+//*					the multipart header and no frames.
+//*
+//*					The subscriber socket is detached from the listen thread, it
+//*					belongs to the stream thread until the client goes away.
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Mar 20,	2021	<MLS> Created cameradriver_mjpeg.cpp
+//*	Mar 30,	2021	<MLS> OfferFrameToMJPEG() holds cPreviewMutex while it uses the preview
+//*	Mar 30,	2021	<MLS> OfferFrameToMJPEG() copies the jpeg out, the two mutexes are no longer nested
+//*	Mar 30,	2021	<MLS> AddMJPEGsubscriber() decides on the join under streamMutex
+//*****************************************************************************
+
+#ifdef _ENABLE_CAMERA_
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<time.h>
+#include	<unistd.h>
+#include	<errno.h>
+#include	<sys/socket.h>
+#include	<sys/uio.h>
+#include	<sys/ioctl.h>
+#include	<netinet/in.h>
+#include	<netinet/tcp.h>
+#ifdef __linux__
+	#include	<linux/sockios.h>
+#endif
+
+#define _ENABLE_CONSOLE_DEBUG_
+#include	"ConsoleDebug.h"
+
+#include	"JsonResponse.h"
+#include	"alpacadriver.h"
+#include	"alpacadriver_helper.h"
+#include	"cameradriver.h"
+#include	"socket_listen.h"
+
+#define	kMJPEG_SendTimeout_ms	200
+#define	kMJPEG_MinSendBuffer	(512 * 1024)
+#define	kMJPEG_MinMaxDim		64
+
+//*****************************************************************************
+static void	*MJPEGstreamThread(void *arg)
+{
+CameraDriver	*cameraObj;
+
+	cameraObj	=	(CameraDriver *)arg;
+	cameraObj->RunMJPEGstreamThread();
+	return(NULL);
+}
+
+//*****************************************************************************
+static void	CloseMJPEGsubscriber(TYPE_MJPEG_SUBSCRIBER *subscriber)
+{
+	if (subscriber->socket >= 0)
+	{
+		shutdown(subscriber->socket, SHUT_RDWR);
+		close(subscriber->socket);
+	}
+	subscriber->socket			=	-1;
+	subscriber->scaleIdx		=	0;
+	subscriber->lastFrameSent	=	0;
+	subscriber->droppedFrames	=	0;
+	subscriber->framesSent		=	0;
+}
+
+//*****************************************************************************
+//*	returns false if the subscriber has gone away
+//*	frameSkipped is set if the client still had too much unread data
+//*****************************************************************************
+static bool	SendMJPEGframe(	const int				socket,
+							const unsigned char		*jpegData,
+							const unsigned long		jpegLen,
+							bool					*frameSkipped)
+{
+char			partHeader[128];
+struct iovec	ioVector[3];
+struct msghdr	message;
+ssize_t			bytesSent;
+size_t			packetLen;
+int				sendBufSize;
+int				bytesQueued;
+socklen_t		optionLen;
+bool			stillConnected;
+
+	stillConnected	=	true;
+	*frameSkipped	=	false;
+	sprintf(partHeader,	"--" kMJPEG_Boundary "\r\n"
+						"Content-Type: image/jpeg\r\n"
+						"Content-Length: %lu\r\n"
+						"\r\n",
+						jpegLen);
+	packetLen	=	strlen(partHeader) + jpegLen + 2;
+
+	//*	if the last frames are still sitting in the socket, this client is behind
+	sendBufSize		=	0;
+	bytesQueued		=	0;
+	optionLen		=	sizeof(sendBufSize);
+	getsockopt(socket, SOL_SOCKET, SO_SNDBUF, &sendBufSize, &optionLen);
+#ifdef SIOCOUTQ
+	ioctl(socket, SIOCOUTQ, &bytesQueued);
+#endif
+	if ((sendBufSize > 0) && (bytesQueued > 0) && ((size_t)(sendBufSize - bytesQueued) < packetLen))
+	{
+		*frameSkipped	=	true;
+	}
+	else
+	{
+		ioVector[0].iov_base	=	partHeader;
+		ioVector[0].iov_len		=	strlen(partHeader);
+		ioVector[1].iov_base	=	(void *)jpegData;
+		ioVector[1].iov_len		=	jpegLen;
+		ioVector[2].iov_base	=	(void *)"\r\n";
+		ioVector[2].iov_len		=	2;
+		memset(&message, 0, sizeof(message));
+		message.msg_iov			=	ioVector;
+		message.msg_iovlen		=	3;
+
+		bytesSent	=	sendmsg(socket, &message, MSG_NOSIGNAL);
+		if (bytesSent != (ssize_t)packetLen)
+		{
+			//*	an error, or a partial part after the send timeout, either way
+			//*	the stream is broken and the client has to reconnect
+			CONSOLE_DEBUG_W_NUM("MJPEG subscriber dropped, errno\t=", errno);
+			stillConnected	=	false;
+		}
+	}
+	return(stillConnected);
+}
+
+//*****************************************************************************
+//*	called from the constructor
+//*****************************************************************************
+void	CameraDriver::InitMJPEGstream(void)
+{
+pthread_condattr_t	condAttr;
+int					ii;
+
+	memset(&cMJPEGstream, 0, sizeof(TYPE_MJPEG_STREAM));
+	pthread_mutex_init(&cMJPEGstream.streamMutex, NULL);
+	pthread_condattr_init(&condAttr);
+	pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+	pthread_cond_init(&cMJPEGstream.frameCond, &condAttr);
+	pthread_condattr_destroy(&condAttr);
+
+	for (ii=0; ii<kMJPEG_MaxSubscribers; ii++)
+	{
+		cMJPEGstream.subscribers[ii].socket	=	-1;
+	}
+}
+
+//*****************************************************************************
+//*	called from the destructor
+//*****************************************************************************
+void	CameraDriver::StopMJPEGstream(void)
+{
+int		ii;
+
+	if (cMJPEGstream.threadActive)
+	{
+		pthread_mutex_lock(&cMJPEGstream.streamMutex);
+		cMJPEGstream.keepRunning	=	false;
+		pthread_cond_broadcast(&cMJPEGstream.frameCond);
+		pthread_mutex_unlock(&cMJPEGstream.streamMutex);
+
+		pthread_join(cMJPEGstream.threadID, NULL);
+		cMJPEGstream.threadActive	=	false;
+	}
+	for (ii=0; ii<kMJPEG_MaxScales; ii++)
+	{
+		if (cMJPEGstream.scales[ii].jpegData != NULL)
+		{
+			free(cMJPEGstream.scales[ii].jpegData);
+			cMJPEGstream.scales[ii].jpegData	=	NULL;
+		}
+	}
+}
+
+//*****************************************************************************
+//*	the connection has been answered with the http header, from here on the
+//*	socket belongs to the stream thread. Starts the thread if it is not running
+//*****************************************************************************
+bool	CameraDriver::AddMJPEGsubscriber(const int socket, const int binFactor)
+{
+int				ii;
+int				scaleIdx;
+int				sendBufSize;
+int				noDelay;
+int				threadErr;
+struct	timeval	sendTimeout;
+bool			added;
+
+	added	=	false;
+
+	pthread_mutex_lock(&cMJPEGstream.streamMutex);
+
+	//*	a thread that stopped because everyone left still has to be joined.
+	//*	threadDone is set with the mutex held and the thread never takes it again,
+	//*	so the join can not block on us. A thread that has not got that far
+	//*	sees the new subscriber before it decides to exit.
+	if (cMJPEGstream.threadActive && cMJPEGstream.threadDone)
+	{
+		pthread_join(cMJPEGstream.threadID, NULL);
+		cMJPEGstream.threadActive	=	false;
+	}
+	if (cMJPEGstream.threadActive && (cMJPEGstream.keepRunning == false))
+	{
+		//*	StopMJPEGstream() is shutting it down
+		pthread_mutex_unlock(&cMJPEGstream.streamMutex);
+		return(false);
+	}
+
+	//*	share the encoded frames with anyone that wants the same size
+	scaleIdx	=	-1;
+	for (ii=0; ii<kMJPEG_MaxScales; ii++)
+	{
+		if (cMJPEGstream.scales[ii].binFactor == binFactor)
+		{
+			scaleIdx	=	ii;
+			break;
+		}
+	}
+	for (ii=0; (ii<kMJPEG_MaxScales) && (scaleIdx < 0); ii++)
+	{
+		if (cMJPEGstream.scales[ii].binFactor == 0)
+		{
+			scaleIdx							=	ii;
+			cMJPEGstream.scales[ii].binFactor	=	binFactor;
+			cMJPEGstream.scales[ii].frameNumber	=	0;
+		}
+	}
+	if (scaleIdx < 0)
+	{
+		//*	all of the sizes are taken, this client gets the closest one
+		scaleIdx	=	0;
+		for (ii=1; ii<kMJPEG_MaxScales; ii++)
+		{
+			if (abs(cMJPEGstream.scales[ii].binFactor - binFactor) <
+				abs(cMJPEGstream.scales[scaleIdx].binFactor - binFactor))
+			{
+				scaleIdx	=	ii;
+			}
+		}
+	}
+
+	for (ii=0; (ii<kMJPEG_MaxSubscribers) && (added == false); ii++)
+	{
+		if (cMJPEGstream.subscribers[ii].socket < 0)
+		{
+			//*	room for a couple of frames, no Nagle delay, and never block the stream for long
+			sendBufSize				=	kMJPEG_MinSendBuffer;
+			noDelay					=	1;
+			sendTimeout.tv_sec		=	0;
+			sendTimeout.tv_usec		=	kMJPEG_SendTimeout_ms * 1000;
+			setsockopt(socket, SOL_SOCKET,	SO_SNDBUF,		&sendBufSize,	sizeof(sendBufSize));
+			setsockopt(socket, SOL_SOCKET,	SO_SNDTIMEO,	&sendTimeout,	sizeof(sendTimeout));
+			setsockopt(socket, IPPROTO_TCP,	TCP_NODELAY,	&noDelay,		sizeof(noDelay));
+
+			cMJPEGstream.subscribers[ii].socket			=	socket;
+			cMJPEGstream.subscribers[ii].scaleIdx		=	scaleIdx;
+			cMJPEGstream.subscribers[ii].lastFrameSent	=	0;
+			cMJPEGstream.subscribers[ii].droppedFrames	=	0;
+			cMJPEGstream.subscribers[ii].framesSent		=	0;
+			cMJPEGstream.subscriberCnt++;
+			added	=	true;
+		}
+	}
+
+	if (added && (cMJPEGstream.threadActive == false))
+	{
+		cMJPEGstream.keepRunning	=	true;
+		cMJPEGstream.threadDone		=	false;
+		threadErr					=	pthread_create(&cMJPEGstream.threadID, NULL, &MJPEGstreamThread, this);
+		if (threadErr == 0)
+		{
+			cMJPEGstream.threadActive	=	true;
+		}
+		else
+		{
+			CONSOLE_DEBUG_W_NUM("Failed to create MJPEG stream thread, err\t=", threadErr);
+			cMJPEGstream.keepRunning	=	false;
+			for (ii=0; ii<kMJPEG_MaxSubscribers; ii++)
+			{
+				if (cMJPEGstream.subscribers[ii].socket == socket)
+				{
+					//*	the caller still owns the socket
+					cMJPEGstream.subscribers[ii].socket	=	-1;
+					cMJPEGstream.subscriberCnt--;
+				}
+			}
+			added	=	false;
+		}
+	}
+	//*	the last frame goes out right away, the client does not have to wait for the next one
+	pthread_cond_broadcast(&cMJPEGstream.frameCond);
+	pthread_mutex_unlock(&cMJPEGstream.streamMutex);
+	return(added);
+}
+
+//*****************************************************************************
+//*	called by the state machine after a new image has been read.
+//*	encodes the image once for each size that someone is watching
+//*****************************************************************************
+void	CameraDriver::OfferFrameToMJPEG(void)
+{
+TYPE_PREVIEW_IMAGE	*preview;
+TYPE_MJPEG_SCALE	*scale;
+unsigned char		*newBuffer;
+unsigned char		*oldBuffer;
+unsigned long		newLen;
+int					binFactors[kMJPEG_MaxScales];
+int					ii;
+bool				frameEncoded;
+
+	if (cMJPEGstream.subscriberCnt <= 0)
+	{
+		return;
+	}
+	pthread_mutex_lock(&cMJPEGstream.streamMutex);
+	for (ii=0; ii<kMJPEG_MaxScales; ii++)
+	{
+		binFactors[ii]	=	cMJPEGstream.scales[ii].binFactor;
+	}
+	pthread_mutex_unlock(&cMJPEGstream.streamMutex);
+
+	frameEncoded	=	false;
+	for (ii=0; ii<kMJPEG_MaxScales; ii++)
+	{
+		if (binFactors[ii] <= 0)
+		{
+			continue;
+		}
+		//*	the preview keeps the jpeg, anyone else asking for it this frame gets it for free
+		//*	it is copied out under cPreviewMutex, the stream mutex is not taken while it is held
+		newBuffer	=	NULL;
+		newLen		=	0;
+		pthread_mutex_lock(&cPreviewMutex);
+		preview	=	GetPreviewImage(binFactors[ii], false);
+		if ((preview != NULL) && CreatePreviewJpeg(preview))
+		{
+			newBuffer	=	(unsigned char *)malloc(preview->jpegLen);
+			if (newBuffer != NULL)
+			{
+				memcpy(newBuffer, preview->jpegData, preview->jpegLen);
+				newLen	=	preview->jpegLen;
+			}
+		}
+		pthread_mutex_unlock(&cPreviewMutex);
+
+		if (newBuffer != NULL)
+		{
+			pthread_mutex_lock(&cMJPEGstream.streamMutex);
+			scale	=	&cMJPEGstream.scales[ii];
+			oldBuffer			=	scale->jpegData;
+			scale->jpegData		=	newBuffer;
+			scale->jpegBufLen	=	newLen;
+			scale->jpegLen		=	newLen;
+			scale->frameNumber	=	cMJPEGstream.frameCnt + 1;
+			frameEncoded		=	true;
+			pthread_mutex_unlock(&cMJPEGstream.streamMutex);
+			if (oldBuffer != NULL)
+			{
+				free(oldBuffer);
+			}
+		}
+	}
+	if (frameEncoded)
+	{
+		pthread_mutex_lock(&cMJPEGstream.streamMutex);
+		cMJPEGstream.frameCnt++;
+		pthread_cond_broadcast(&cMJPEGstream.frameCond);
+		pthread_mutex_unlock(&cMJPEGstream.streamMutex);
+	}
+}
+
+//*****************************************************************************
+//*	runs until the last subscriber is gone
+//*****************************************************************************
+void	CameraDriver::RunMJPEGstreamThread(void)
+{
+unsigned char		*sendBuffers[kMJPEG_MaxScales];
+unsigned long		sendBufLens[kMJPEG_MaxScales];
+unsigned long		sendLens[kMJPEG_MaxScales];
+uint32_t			sendFrameNums[kMJPEG_MaxScales];
+int					sendSockets[kMJPEG_MaxSubscribers];
+bool				subscriberGone[kMJPEG_MaxSubscribers];
+bool				frameSkipped;
+bool				framesPending;
+unsigned char		*newBuffer;
+TYPE_MJPEG_SUBSCRIBER	*subscriber;
+TYPE_MJPEG_SCALE	*scale;
+struct timespec		wakeTime;
+int					scaleIdx;
+int					ii;
+
+	CONSOLE_DEBUG_W_STR("MJPEG stream thread started for", cDeviceManufAbrev);
+	memset(sendBuffers, 0, sizeof(sendBuffers));
+	memset(sendBufLens, 0, sizeof(sendBufLens));
+
+	pthread_mutex_lock(&cMJPEGstream.streamMutex);
+	while (cMJPEGstream.keepRunning)
+	{
+		//*	who has not seen the latest frame of their size
+		framesPending	=	false;
+		memset(sendLens, 0, sizeof(sendLens));
+		for (ii=0; ii<kMJPEG_MaxSubscribers; ii++)
+		{
+			subscriber			=	&cMJPEGstream.subscribers[ii];
+			sendSockets[ii]		=	-1;
+			subscriberGone[ii]	=	false;
+			if (subscriber->socket >= 0)
+			{
+				scale	=	&cMJPEGstream.scales[subscriber->scaleIdx];
+				if ((scale->frameNumber != 0) && (scale->frameNumber != subscriber->lastFrameSent))
+				{
+					sendSockets[ii]	=	subscriber->socket;
+					framesPending	=	true;
+				}
+			}
+		}
+		if (framesPending == false)
+		{
+			clock_gettime(CLOCK_MONOTONIC, &wakeTime);
+			wakeTime.tv_sec	+=	1;
+			pthread_cond_timedwait(&cMJPEGstream.frameCond, &cMJPEGstream.streamMutex, &wakeTime);
+			continue;
+		}
+
+		//*	copy the frames out, the camera can encode the next one while these are sent
+		for (scaleIdx=0; scaleIdx<kMJPEG_MaxScales; scaleIdx++)
+		{
+			scale					=	&cMJPEGstream.scales[scaleIdx];
+			sendFrameNums[scaleIdx]	=	scale->frameNumber;
+			if ((scale->frameNumber != 0) && (scale->jpegLen > 0))
+			{
+				if (sendBufLens[scaleIdx] < scale->jpegLen)
+				{
+					newBuffer	=	(unsigned char *)realloc(sendBuffers[scaleIdx], scale->jpegLen);
+					if (newBuffer != NULL)
+					{
+						sendBuffers[scaleIdx]	=	newBuffer;
+						sendBufLens[scaleIdx]	=	scale->jpegLen;
+					}
+				}
+				if (sendBufLens[scaleIdx] >= scale->jpegLen)
+				{
+					memcpy(sendBuffers[scaleIdx], scale->jpegData, scale->jpegLen);
+					sendLens[scaleIdx]	=	scale->jpegLen;
+				}
+			}
+		}
+		pthread_mutex_unlock(&cMJPEGstream.streamMutex);
+
+		for (ii=0; ii<kMJPEG_MaxSubscribers; ii++)
+		{
+			if (sendSockets[ii] >= 0)
+			{
+				scaleIdx	=	cMJPEGstream.subscribers[ii].scaleIdx;
+				if (sendLens[scaleIdx] > 0)
+				{
+					subscriberGone[ii]	=	!SendMJPEGframe(	sendSockets[ii],
+																sendBuffers[scaleIdx],
+																sendLens[scaleIdx],
+																&frameSkipped);
+					if (frameSkipped)
+					{
+						cMJPEGstream.subscribers[ii].droppedFrames++;
+						cMJPEGstream.droppedCnt++;
+					}
+					else
+					{
+						cMJPEGstream.subscribers[ii].framesSent++;
+					}
+				}
+			}
+		}
+
+		pthread_mutex_lock(&cMJPEGstream.streamMutex);
+		for (ii=0; ii<kMJPEG_MaxSubscribers; ii++)
+		{
+			if (sendSockets[ii] >= 0)
+			{
+				subscriber	=	&cMJPEGstream.subscribers[ii];
+				//*	a skipped frame is not sent later, the client gets the next one
+				subscriber->lastFrameSent	=	sendFrameNums[subscriber->scaleIdx];
+				if (subscriberGone[ii])
+				{
+					scaleIdx	=	subscriber->scaleIdx;
+					CloseMJPEGsubscriber(subscriber);
+					cMJPEGstream.subscriberCnt--;
+					ReleaseMJPEGscale(scaleIdx);
+				}
+			}
+		}
+		//*	still holding the mutex, a subscriber added while the frames were
+		//*	being sent is counted here and keeps the thread going
+		if (cMJPEGstream.subscriberCnt <= 0)
+		{
+			cMJPEGstream.keepRunning	=	false;
+		}
+	}
+
+	//*	shutting down, or everyone has left
+	for (ii=0; ii<kMJPEG_MaxSubscribers; ii++)
+	{
+		if (cMJPEGstream.subscribers[ii].socket >= 0)
+		{
+			CloseMJPEGsubscriber(&cMJPEGstream.subscribers[ii]);
+		}
+	}
+	cMJPEGstream.subscriberCnt	=	0;
+	for (ii=0; ii<kMJPEG_MaxScales; ii++)
+	{
+		ReleaseMJPEGscale(ii);
+	}
+	cMJPEGstream.threadDone	=	true;
+	pthread_mutex_unlock(&cMJPEGstream.streamMutex);
+
+	for (ii=0; ii<kMJPEG_MaxScales; ii++)
+	{
+		if (sendBuffers[ii] != NULL)
+		{
+			free(sendBuffers[ii]);
+		}
+	}
+	CONSOLE_DEBUG_W_NUM("MJPEG stream thread -- exit --, frames\t=", cMJPEGstream.frameCnt);
+}
+
+//*****************************************************************************
+//*	frees up the size slot if nobody is using it any more, mutex must be held
+//*****************************************************************************
+void	CameraDriver::ReleaseMJPEGscale(const int scaleIdx)
+{
+int		ii;
+bool	inUse;
+
+	inUse	=	false;
+	for (ii=0; ii<kMJPEG_MaxSubscribers; ii++)
+	{
+		if ((cMJPEGstream.subscribers[ii].socket >= 0) && (cMJPEGstream.subscribers[ii].scaleIdx == scaleIdx))
+		{
+			inUse	=	true;
+		}
+	}
+	if (inUse == false)
+	{
+		//*	the buffer is kept for the next one
+		cMJPEGstream.scales[scaleIdx].binFactor		=	0;
+		cMJPEGstream.scales[scaleIdx].frameNumber	=	0;
+		cMJPEGstream.scales[scaleIdx].jpegLen		=	0;
+	}
+}
+
+//*****************************************************************************
+//*	mjpeg?MaxDim=800 turns this connection into the live view stream
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Get_MJPEGstream(	TYPE_GetPutRequestData	*reqData,
+													char					*alpacaErrMsg,
+													bool					*binaryDataSent)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+#ifdef _ENABLE_JPEGLIB_
+char				argumentString[32];
+char				httpHeader[256];
+int					mySocket;
+int					maxDimension;
+int					sourceWidth;
+int					sourceHeight;
+int					binFactor;
+int					bytesWritten;
+
+	mySocket		=	reqData->socket;
+	maxDimension	=	kMJPEG_DefaultMaxDim;
+	if (GetKeyWordArgument(reqData->contentData, "MaxDim", argumentString, (sizeof(argumentString) -1)))
+	{
+		maxDimension	=	atoi(argumentString);
+	}
+	if (maxDimension < kMJPEG_MinMaxDim)
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "MaxDim is too small");
+		return(alpacaErrCode);
+	}
+	if (cMJPEGstream.subscriberCnt >= kMJPEG_MaxSubscribers)
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Too many MJPEG stream subscribers");
+		return(alpacaErrCode);
+	}
+
+	//*	the size is picked from the full frame, so the client gets the same
+	//*	scale no matter what the current ROI is
+	sourceWidth		=	cCameraXsize;
+	sourceHeight	=	cCameraYsize;
+	binFactor		=	ImageBin_FactorForMaxDim(sourceWidth, sourceHeight, maxDimension);
+
+	//*	no content length, the stream runs until one side closes it
+	httpHeader[0]	=	0;
+	strcat(httpHeader,	"HTTP/1.0 200 OK\r\n");
+	strcat(httpHeader,	"Content-Type: multipart/x-mixed-replace; boundary=" kMJPEG_Boundary "\r\n");
+	strcat(httpHeader,	"Cache-Control: no-cache\r\n");
+	strcat(httpHeader,	"Pragma: no-cache\r\n");
+	strcat(httpHeader,	"Server: AlpacaPi\r\n");
+	strcat(httpHeader,	"\r\n");
+	bytesWritten	=	write(mySocket, httpHeader, strlen(httpHeader));
+	if ((bytesWritten > 0) && AddMJPEGsubscriber(mySocket, binFactor))
+	{
+		SocketListen_DetachSocket(mySocket);
+	}
+	else
+	{
+		CONSOLE_DEBUG("Failed to add MJPEG stream subscriber");
+	}
+	//*	the http header has gone out, no JSON from here on
+	*binaryDataSent	=	true;
+#else
+	alpacaErrCode	=	kASCOM_Err_NotImplemented;
+	GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "MJPEG stream requires JPEG support");
+#endif	//	_ENABLE_JPEGLIB_
+	return(alpacaErrCode);
+}
+
+#endif	//	_ENABLE_CAMERA_
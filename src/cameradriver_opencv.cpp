@@ -38,6 +38,9 @@
 //*	Apr 11,	2020	<MLS> Added frames saved to sidebar
 //*	Apr 16,	2020	<MLS> Switched to using commoncolor for background color selection
 //*	Apr 19,	2020	<MLS> Fixed cross hair location when using sidebar
+//*	Mar 18,	2021	<MLS> Live view is filled from the image pyramid instead of cvResize()
+//*	Mar 30,	2021	<MLS> CopyPyramidToOpenCV() holds cPreviewMutex while it reads the pyramid
+//*	Mar 30,	2021	<MLS> CopyPyramidToOpenCV() only holds it while it copies the level
 //*****************************************************************************
 
 #if defined(_ENABLE_CAMERA_) && defined(_USE_OPENCV_)
@@ -260,6 +263,131 @@ void	CameraDriver::SetOpenCVcallbackFunction(const char *windowName)
 }
 
 
+//*****************************************************************************
+//*	fills the image (or its ROI) from the pyramid level that is the same size.
+//*	returns false if there is no such level, the caller has to resize
+//*****************************************************************************
+bool	CameraDriver::CopyPyramidToOpenCV(IplImage *displayImage)
+{
+TYPE_IMAGE_PYRAMID	*pyramid;
+CvRect				destRect;
+int					level;
+int					shiftRight;
+int					shiftLeft;
+int					xxx;
+int					yyy;
+int					redValue;
+int					grnValue;
+int					bluValue;
+const uint16_t		*srcPtr;
+uint16_t			*levelCopy;
+long				levelLen;
+int					planes;
+unsigned char		*rowPtr;
+uint8_t				*dest8;
+uint16_t			*dest16;
+
+	if ((displayImage == NULL) ||
+		((displayImage->depth != IPL_DEPTH_8U) && (displayImage->depth != IPL_DEPTH_16U)) ||
+		((displayImage->nChannels != 1) && (displayImage->nChannels != 3)))
+	{
+		return(false);
+	}
+	//*	the pyramid can be rebuilt or freed by the other threads
+	pthread_mutex_lock(&cPreviewMutex);
+	pyramid	=	GetImagePyramid();
+	if (pyramid == NULL)
+	{
+		pthread_mutex_unlock(&cPreviewMutex);
+		return(false);
+	}
+	//*	color cannot go into a gray scale window
+	if ((pyramid->planes == 3) && (displayImage->nChannels == 1))
+	{
+		pthread_mutex_unlock(&cPreviewMutex);
+		return(false);
+	}
+	destRect	=	cvGetImageROI(displayImage);
+	level		=	ImagePyramid_LevelForSize(pyramid, destRect.width, destRect.height);
+	if (level < 0)
+	{
+		pthread_mutex_unlock(&cPreviewMutex);
+		return(false);
+	}
+	shiftRight	=	0;
+	shiftLeft	=	0;
+	if (pyramid->bitDepth > displayImage->depth)
+	{
+		shiftRight	=	pyramid->bitDepth - displayImage->depth;
+	}
+	else
+	{
+		shiftLeft	=	displayImage->depth - pyramid->bitDepth;
+	}
+	//*	the level is copied out, the conversion runs without the mutex
+	planes		=	pyramid->planes;
+	levelLen	=	(long)destRect.width * destRect.height * planes * sizeof(uint16_t);
+	levelCopy	=	(uint16_t *)malloc(levelLen);
+	if (levelCopy != NULL)
+	{
+		memcpy(levelCopy, pyramid->levelData[level], levelLen);
+	}
+	pthread_mutex_unlock(&cPreviewMutex);
+	if (levelCopy == NULL)
+	{
+		return(false);
+	}
+
+	srcPtr	=	levelCopy;
+	for (yyy=0; yyy<destRect.height; yyy++)
+	{
+		rowPtr	=	(unsigned char *)displayImage->imageData + ((long)(destRect.y + yyy) * displayImage->widthStep);
+		dest8	=	rowPtr + (destRect.x * displayImage->nChannels);
+		dest16	=	((uint16_t *)rowPtr) + (destRect.x * displayImage->nChannels);
+		for (xxx=0; xxx<destRect.width; xxx++)
+		{
+			if (planes == 3)
+			{
+				redValue	=	srcPtr[0];
+				grnValue	=	srcPtr[1];
+				bluValue	=	srcPtr[2];
+				srcPtr		+=	3;
+			}
+			else
+			{
+				redValue	=	srcPtr[0];
+				grnValue	=	redValue;
+				bluValue	=	redValue;
+				srcPtr++;
+			}
+			redValue	=	(redValue >> shiftRight) << shiftLeft;
+			grnValue	=	(grnValue >> shiftRight) << shiftLeft;
+			bluValue	=	(bluValue >> shiftRight) << shiftLeft;
+			//*	openCV is BGR
+			if (displayImage->depth == IPL_DEPTH_8U)
+			{
+				if (displayImage->nChannels == 3)
+				{
+					*dest8++	=	bluValue;
+					*dest8++	=	grnValue;
+				}
+				*dest8++	=	redValue;
+			}
+			else
+			{
+				if (displayImage->nChannels == 3)
+				{
+					*dest16++	=	bluValue;
+					*dest16++	=	grnValue;
+				}
+				*dest16++	=	redValue;
+			}
+		}
+	}
+	free(levelCopy);
+	return(true);
+}
+
 //*****************************************************************************
 void	CameraDriver::DisplayLiveImage(void)
 {
@@ -336,7 +464,10 @@ int			keyPressed;
 		CvPoint			point1;
 		char			imageNumBuff[32];
 
-			cvResize(cOpenCV_Image, cOpenCV_LiveDisplay, CV_INTER_LINEAR);
+			if (CopyPyramidToOpenCV(cOpenCV_LiveDisplay) == false)
+			{
+				cvResize(cOpenCV_Image, cOpenCV_LiveDisplay, CV_INTER_LINEAR);
+			}
 			if (cDisplayCrossHairs || cDrawRectangle)
 			{
 				DrawOpenCVoverlay();
@@ -508,8 +639,13 @@ CvRect		myCVrect;
 
 				CONSOLE_DEBUG_W_NUM("keyPointCnt\t=", keyPointCnt);
 			#endif // _JETSON_
+				//*	the pyramid level is already the right size, no resize needed
+				if (CopyPyramidToOpenCV(cOpenCV_LiveDisplay))
+				{
+					//*	done
+				}
 				//*	lets try to display gray scale on a color screen
-				if ((cOpenCV_Image->nChannels == 1) && (cOpenCV_Image->depth == 8))
+				else if ((cOpenCV_Image->nChannels == 1) && (cOpenCV_Image->depth == 8))
 				{
 				IplImage	*smallImg;
 
@@ -720,7 +856,7 @@ const int	deltaY	=	16;
 	roiRect.height	=	100;
 	cvSetImageROI(imageDisplay,  roiRect);
 
-	CalculateHistogramArray();
+	CalculateHistogramFromPyramid();
 	CreateHistogramGraph(imageDisplay);
 
 	cvResetImageROI(imageDisplay);
@@ -0,0 +1,739 @@
+//**************************************************************************
+//*	Name:			cameradriver_preview.cpp
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Binned / downscaled previews of the last image
+//*
+//*					For clients that only want a quick look (framing, flats checks,
+//*					SkyTravel overlays) without pulling the full resolution image.
+//*
+//*					Each binning factor is computed once per frame and kept until
+//*					the next image is read. The JPEG version is compressed the first
+//*					time it is asked for and also kept.
+//*
+//*					Averaged previews come from the image pyramid when the bin factor
+//*					has a power of 2 in it, only what is left over is binned here.
+//*
+//*					The endpoint runs on the listen thread and the cache is cleared
+//*					by the state machine at readout. Anything that uses a preview, the
+//*					pyramid or the debayered image holds cPreviewMutex from building
+//*					it until it is done with it (sent, saved, copied).
+//*
+//*	Usage:
+//*		GET /api/v1/camera/0/preview?Bin=2				2x2, 3x3 or 4x4
+//*		GET /api/v1/camera/0/preview?MaxDim=800			largest dimension <= 800
+//*			&Mode=sum									sum instead of average
+//*			&Format=json | imagebytes | jpeg			(default json)
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb 12,	2021	<MLS> Created cameradriver_preview.cpp
+//*	Mar 18,	2021	<MLS> Added GetImagePyramid(), averaged previews are made from the pyramid
+//*	Mar 30,	2021	<MLS> The cache is used under cPreviewMutex, the endpoint runs on the listen thread
+//*	Mar 30,	2021	<MLS> CreatePreviewJpeg() uses openCV when there is no libjpeg
+//*	Mar 30,	2021	<MLS> Previews and the pyramid are built under cCameraDataMutex
+//*	Mar 30,	2021	<MLS> Get_Preview() sends a copy, cPreviewMutex is not held while sending
+//*****************************************************************************
+
+#ifdef _ENABLE_CAMERA_
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<unistd.h>
+
+#ifdef _ENABLE_JPEGLIB_
+	#include	<jpeglib.h>
+#endif
+
+#define _ENABLE_CONSOLE_DEBUG_
+#include	"ConsoleDebug.h"
+
+#include	"JsonResponse.h"
+#include	"alpacadriver.h"
+#include	"alpacadriver_helper.h"
+#include	"cameradriver.h"
+
+//*****************************************************************************
+//*	called at readout, the debayered image goes with the previews
+//*****************************************************************************
+void	CameraDriver::ClearPreviewCache(void)
+{
+int		ii;
+
+	pthread_mutex_lock(&cPreviewMutex);
+	cDebayerValid	=	false;
+	for (ii=0; ii<kMaxPreviewCache; ii++)
+	{
+		cPreviewCache[ii].valid	=	false;
+		if (cPreviewCache[ii].jpegData != NULL)
+		{
+			free(cPreviewCache[ii].jpegData);
+			cPreviewCache[ii].jpegData	=	NULL;
+		}
+		cPreviewCache[ii].jpegLen	=	0;
+	}
+	cImagePyramid.valid	=	false;
+	pthread_mutex_unlock(&cPreviewMutex);
+}
+
+//*****************************************************************************
+//*	what the previews and the pyramid are made from, raw color gets debayered
+//*****************************************************************************
+bool	CameraDriver::GetPreviewSource(	unsigned char	**sourceData,
+										int				*sourceWidth,
+										int				*sourceHeight,
+										int				*bytesPerPixel,
+										int				*planes,
+										bool			*swapRedBlue)
+{
+	if ((cImageReady == false) || (cCameraDataBuffer == NULL))
+	{
+		return(false);
+	}
+	*sourceWidth	=	cROIinfo.currentROIwidth;
+	*sourceHeight	=	cROIinfo.currentROIheight;
+	if ((*sourceWidth <= 0) || (*sourceHeight <= 0))
+	{
+		*sourceWidth	=	cCameraXsize;
+		*sourceHeight	=	cCameraYsize;
+	}
+	*sourceData		=	cCameraDataBuffer;
+	*bytesPerPixel	=	1;
+	*planes			=	1;
+	*swapRedBlue	=	false;
+	if (IsRawColorImage())
+	{
+		*sourceData	=	GetDebayeredImage(false);
+		*planes		=	3;
+	}
+	else
+	{
+		switch(cROIinfo.currentROIimageType)
+		{
+			case kImageType_RAW16:
+				*bytesPerPixel	=	2;
+				break;
+
+			case kImageType_RGB24:
+				//*	RGB24 from the camera is in BGR order
+				*planes			=	3;
+				*swapRedBlue	=	true;
+				break;
+
+			default:
+				break;
+		}
+	}
+	return(*sourceData != NULL);
+}
+
+//*****************************************************************************
+//*	returns NULL if there is no image or it is too small for a pyramid
+//*	the caller holds cPreviewMutex for as long as it uses the pyramid
+//*****************************************************************************
+TYPE_IMAGE_PYRAMID	*CameraDriver::GetImagePyramid(void)
+{
+unsigned char	*sourceData;
+int				sourceWidth;
+int				sourceHeight;
+int				bytesPerPixel;
+int				planes;
+bool			swapRedBlue;
+bool			buildOK;
+
+	if (cImagePyramid.valid)
+	{
+		return(&cImagePyramid);
+	}
+	if (GetPreviewSource(&sourceData, &sourceWidth, &sourceHeight, &bytesPerPixel, &planes, &swapRedBlue) == false)
+	{
+		return(NULL);
+	}
+	SETUP_TIMING();
+	pthread_mutex_lock(&cCameraDataMutex);
+	buildOK	=	ImagePyramid_Build(	&cImagePyramid,
+									sourceData,
+									sourceWidth,
+									sourceHeight,
+									bytesPerPixel,
+									planes,
+									swapRedBlue);
+	pthread_mutex_unlock(&cCameraDataMutex);
+	DEBUG_TIMING("Time to build pyramid (ms)\t=");
+	return(buildOK ? &cImagePyramid : NULL);
+}
+
+//*****************************************************************************
+//*	returns the cached preview, creating it if needed
+//*	returns NULL if there is no image or it cannot be binned
+//*	the caller holds cPreviewMutex for as long as it uses the preview
+//*****************************************************************************
+TYPE_PREVIEW_IMAGE	*CameraDriver::GetPreviewImage(const int binFactor, const bool sumMode)
+{
+TYPE_PREVIEW_IMAGE	*preview;
+int					ii;
+
+	cPreviewUseCounter++;
+	for (ii=0; ii<kMaxPreviewCache; ii++)
+	{
+		if (cPreviewCache[ii].valid &&
+			(cPreviewCache[ii].binFactor == binFactor) &&
+			(cPreviewCache[ii].sumMode == sumMode))
+		{
+			cPreviewCache[ii].lastUsed	=	cPreviewUseCounter;
+			return(&cPreviewCache[ii]);
+		}
+	}
+
+	//*	the camera buffer must not be read out while it is being binned
+	pthread_mutex_lock(&cCameraDataMutex);
+	preview	=	BuildPreviewImage(binFactor, sumMode);
+	pthread_mutex_unlock(&cCameraDataMutex);
+	return(preview);
+}
+
+//*****************************************************************************
+//*	called with cPreviewMutex and cCameraDataMutex held
+//*****************************************************************************
+TYPE_PREVIEW_IMAGE	*CameraDriver::BuildPreviewImage(const int binFactor, const bool sumMode)
+{
+TYPE_PREVIEW_IMAGE	*preview;
+TYPE_IMAGE_PYRAMID	*pyramid;
+unsigned char		*sourceData;
+int					sourceWidth;
+int					sourceHeight;
+int					bytesPerPixel;
+int					planes;
+int					bitDepth;
+int					pyramidFactor;
+int					pyramidLevel;
+int					remainingFactor;
+bool				swapRedBlue;
+bool				fromPyramid;
+long				bufferSize;
+long				ii;
+uint16_t			*newBuffer;
+uint16_t			tempValue;
+int					slotIdx;
+bool				binOK;
+
+	//*	figure out what the source data looks like
+	if (GetPreviewSource(&sourceData, &sourceWidth, &sourceHeight, &bytesPerPixel, &planes, &swapRedBlue) == false)
+	{
+		return(NULL);
+	}
+	bitDepth	=	bytesPerPixel * 8;
+	if (((sourceWidth / binFactor) < 1) || ((sourceHeight / binFactor) < 1))
+	{
+		return(NULL);
+	}
+
+	//*	the sum has to come from the full frame, the average can start from the pyramid
+	remainingFactor	=	binFactor;
+	fromPyramid		=	false;
+	if (sumMode == false)
+	{
+		pyramidFactor	=	1;
+		while (((binFactor / pyramidFactor) % 2) == 0)
+		{
+			pyramidFactor	*=	2;
+		}
+		pyramid	=	(pyramidFactor > 1) ? GetImagePyramid() : NULL;
+		if (pyramid != NULL)
+		{
+			pyramidLevel	=	ImagePyramid_LevelForFactor(pyramid, pyramidFactor);
+			if (pyramidLevel >= 0)
+			{
+				sourceData		=	(unsigned char *)pyramid->levelData[pyramidLevel];
+				sourceWidth		=	pyramid->width[pyramidLevel];
+				sourceHeight	=	pyramid->height[pyramidLevel];
+				bytesPerPixel	=	2;
+				swapRedBlue		=	false;
+				remainingFactor	=	binFactor / pyramidFactor;
+				fromPyramid		=	true;
+			}
+		}
+	}
+
+	//*	pick a slot, an unused one or the least recently used one
+	slotIdx	=	0;
+	for (ii=0; ii<kMaxPreviewCache; ii++)
+	{
+		if (cPreviewCache[ii].valid == false)
+		{
+			slotIdx	=	ii;
+			break;
+		}
+		if (cPreviewCache[ii].lastUsed < cPreviewCache[slotIdx].lastUsed)
+		{
+			slotIdx	=	ii;
+		}
+	}
+	preview			=	&cPreviewCache[slotIdx];
+	preview->valid	=	false;
+	if (preview->jpegData != NULL)
+	{
+		free(preview->jpegData);
+		preview->jpegData	=	NULL;
+	}
+	preview->jpegLen	=	0;
+
+	bufferSize	=	(long)(sourceWidth / remainingFactor) * (sourceHeight / remainingFactor) * planes;
+	if (preview->imageBufLen < bufferSize)
+	{
+		newBuffer	=	(uint16_t *)realloc(preview->imageData, bufferSize * sizeof(uint16_t));
+		if (newBuffer == NULL)
+		{
+			CONSOLE_DEBUG("Failed to allocate preview buffer");
+			return(NULL);
+		}
+		preview->imageData		=	newBuffer;
+		preview->imageBufLen	=	bufferSize;
+	}
+
+	SETUP_TIMING();
+	if (fromPyramid && (remainingFactor == 1))
+	{
+		//*	exactly a pyramid level
+		memcpy(preview->imageData, sourceData, bufferSize * sizeof(uint16_t));
+		binOK	=	true;
+	}
+	else
+	{
+		binOK	=	ImageBin_Downsample(	sourceData,
+											sourceWidth,
+											sourceHeight,
+											bytesPerPixel,
+											planes,
+											remainingFactor,
+											sumMode,
+											preview->imageData);
+	}
+	DEBUG_TIMING("Time to bin (ms)\t=");
+	if (binOK == false)
+	{
+		return(NULL);
+	}
+	if (swapRedBlue)
+	{
+		for (ii=0; ii<bufferSize; ii+=3)
+		{
+			tempValue					=	preview->imageData[ii];
+			preview->imageData[ii]		=	preview->imageData[ii + 2];
+			preview->imageData[ii + 2]	=	tempValue;
+		}
+	}
+	preview->binFactor	=	binFactor;
+	preview->sumMode	=	sumMode;
+	preview->width		=	sourceWidth / remainingFactor;
+	preview->height		=	sourceHeight / remainingFactor;
+	preview->planes		=	planes;
+	preview->bitDepth	=	bitDepth;
+	preview->lastUsed	=	cPreviewUseCounter;
+	preview->valid		=	true;
+	return(preview);
+}
+
+//*****************************************************************************
+//*	same layout as imagearray, X is the outer array
+//*****************************************************************************
+void	CameraDriver::Send_imagearray_preview(const int socketFD, TYPE_PREVIEW_IMAGE *preview)
+{
+char		longBuffer[1024];
+char		lineBuff[64];
+int			xxx;
+int			yyy;
+long		pixelIdx;
+int			bytesWritten;
+
+	longBuffer[0]	=	0;
+	for (xxx=0; xxx < preview->width; xxx++)
+	{
+		strcat(longBuffer, "[");
+		for (yyy=0; yyy < preview->height; yyy++)
+		{
+			pixelIdx	=	(((long)yyy * preview->width) + xxx) * preview->planes;
+			if (preview->planes == 3)
+			{
+				sprintf(lineBuff, "[%d,%d,%d]",	preview->imageData[pixelIdx],
+													preview->imageData[pixelIdx + 1],
+													preview->imageData[pixelIdx + 2]);
+			}
+			else
+			{
+				sprintf(lineBuff, "%d", preview->imageData[pixelIdx]);
+			}
+			if (yyy < (preview->height - 1))
+			{
+				strcat(lineBuff, ",");
+			}
+			strcat(longBuffer, lineBuff);
+			if (strlen(longBuffer) > 900)
+			{
+				strcat(longBuffer, "\n");
+				bytesWritten	=	write(socketFD, longBuffer, strlen(longBuffer));
+				longBuffer[0]	=	0;
+			}
+		}
+		strcat(longBuffer, "]");
+		if (xxx < (preview->width - 1))
+		{
+			strcat(longBuffer, ",");
+		}
+		strcat(longBuffer, "\n");
+	}
+	bytesWritten	=	write(socketFD, longBuffer, strlen(longBuffer));
+	if (bytesWritten <= 0)
+	{
+		CONSOLE_DEBUG("Failed to send preview data");
+	}
+}
+
+//*****************************************************************************
+bool	CameraDriver::CreatePreviewJpeg(TYPE_PREVIEW_IMAGE *preview)
+{
+#ifdef _ENABLE_JPEGLIB_
+struct jpeg_compress_struct	jinfo;
+struct jpeg_error_mgr		jerr;
+JSAMPROW					row_pointer[1];
+unsigned char				*rowBuffer;
+unsigned char				*jpegData;
+unsigned long				jpegLen;
+int							rowLen;
+int							shiftCount;
+int							ii;
+long						pixelIdx;
+int							pixelValue;
+
+	if (preview->jpegData != NULL)
+	{
+		return(true);
+	}
+	rowLen		=	preview->width * preview->planes;
+	rowBuffer	=	(unsigned char *)malloc(rowLen);
+	if (rowBuffer == NULL)
+	{
+		return(false);
+	}
+	shiftCount	=	preview->bitDepth - 8;
+	jpegData	=	NULL;
+	jpegLen		=	0;
+
+	jinfo.err	=	jpeg_std_error(&jerr);
+	jpeg_create_compress(&jinfo);
+	jpeg_mem_dest(&jinfo, &jpegData, &jpegLen);
+
+	jinfo.image_width		=	preview->width;
+	jinfo.image_height		=	preview->height;
+	jinfo.input_components	=	preview->planes;
+	jinfo.in_color_space	=	(preview->planes == 3) ? JCS_RGB : JCS_GRAYSCALE;
+
+	jpeg_set_defaults(&jinfo);
+	jpeg_set_quality(&jinfo, 90, TRUE);
+	jpeg_start_compress(&jinfo, TRUE);
+
+	while (jinfo.next_scanline < jinfo.image_height)
+	{
+		pixelIdx	=	(long)jinfo.next_scanline * rowLen;
+		for (ii=0; ii<rowLen; ii++)
+		{
+			pixelValue		=	preview->imageData[pixelIdx + ii] >> shiftCount;
+			rowBuffer[ii]	=	(pixelValue > 255) ? 255 : pixelValue;
+		}
+		row_pointer[0]	=	rowBuffer;
+		jpeg_write_scanlines(&jinfo, row_pointer, 1);
+	}
+	jpeg_finish_compress(&jinfo);
+	jpeg_destroy_compress(&jinfo);
+	free(rowBuffer);
+
+	preview->jpegData	=	jpegData;
+	preview->jpegLen	=	jpegLen;
+	return(jpegData != NULL);
+#elif defined(_USE_OPENCV_)
+IplImage					*jpegImage;
+CvMat						*encodedImage;
+unsigned char				*dstPtr;
+uint16_t					*srcPtr;
+int							jpegParams[3];
+int							shiftCount;
+int							xxx;
+int							yyy;
+int							pixelValue;
+
+	if (preview->jpegData != NULL)
+	{
+		return(true);
+	}
+	jpegImage	=	cvCreateImage(cvSize(preview->width, preview->height), IPL_DEPTH_8U, preview->planes);
+	if (jpegImage == NULL)
+	{
+		return(false);
+	}
+	shiftCount	=	preview->bitDepth - 8;
+	srcPtr		=	preview->imageData;
+	for (yyy=0; yyy<preview->height; yyy++)
+	{
+		dstPtr	=	(unsigned char *)jpegImage->imageData + ((long)yyy * jpegImage->widthStep);
+		for (xxx=0; xxx<(preview->width * preview->planes); xxx++)
+		{
+			pixelValue	=	*srcPtr++ >> shiftCount;
+			dstPtr[xxx]	=	(pixelValue > 255) ? 255 : pixelValue;
+		}
+		if (preview->planes == 3)
+		{
+			//*	the preview is RGB, openCV is BGR
+			for (xxx=0; xxx<preview->width; xxx++)
+			{
+				pixelValue			=	dstPtr[0];
+				dstPtr[0]			=	dstPtr[2];
+				dstPtr[2]			=	pixelValue;
+				dstPtr				+=	3;
+			}
+		}
+	}
+	jpegParams[0]	=	CV_IMWRITE_JPEG_QUALITY;
+	jpegParams[1]	=	90;
+	jpegParams[2]	=	0;
+	encodedImage	=	cvEncodeImage(".jpg", jpegImage, jpegParams);
+	cvReleaseImage(&jpegImage);
+	if (encodedImage == NULL)
+	{
+		return(false);
+	}
+	//*	the cache frees it with free()
+	preview->jpegLen	=	(unsigned long)encodedImage->rows * encodedImage->cols;
+	preview->jpegData	=	(unsigned char *)malloc(preview->jpegLen);
+	if (preview->jpegData != NULL)
+	{
+		memcpy(preview->jpegData, encodedImage->data.ptr, preview->jpegLen);
+	}
+	else
+	{
+		preview->jpegLen	=	0;
+	}
+	cvReleaseMat(&encodedImage);
+	return(preview->jpegData != NULL);
+#else
+	//*	no JPEG encoder in this build
+	return(false);
+#endif
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Get_Preview(	TYPE_GetPutRequestData	*reqData,
+												char					*alpacaErrMsg,
+												bool					*httpHeaderSent,
+												bool					*binaryDataSent)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+char				argString[32];
+char				formatString[32];
+char				httpHeader[500];
+int					mySocket;
+int					binFactor;
+int					sourceWidth;
+int					sourceHeight;
+bool				sumMode;
+TYPE_PREVIEW_IMAGE	*preview;
+TYPE_PREVIEW_IMAGE	previewCopy;
+bool				jpegFormat;
+long				dataLen;
+uint16_t			*columnBuff;
+int					xxx;
+int					yyy;
+int					ppp;
+int					colIdx;
+int					bytesWritten;
+
+	mySocket	=	reqData->socket;
+
+	sourceWidth		=	cROIinfo.currentROIwidth;
+	sourceHeight	=	cROIinfo.currentROIheight;
+	if ((sourceWidth <= 0) || (sourceHeight <= 0))
+	{
+		sourceWidth		=	cCameraXsize;
+		sourceHeight	=	cCameraYsize;
+	}
+
+	binFactor	=	2;
+	if (GetKeyWordArgument(reqData->contentData, "MaxDim", argString, (sizeof(argString) -1)))
+	{
+		binFactor	=	ImageBin_FactorForMaxDim(sourceWidth, sourceHeight, atoi(argString));
+	}
+	else if (GetKeyWordArgument(reqData->contentData, "Bin", argString, (sizeof(argString) -1)))
+	{
+		binFactor	=	atoi(argString);
+		if ((binFactor < 2) || (binFactor > 4))
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Bin must be 2, 3 or 4");
+			return(alpacaErrCode);
+		}
+	}
+
+	sumMode	=	false;
+	if (GetKeyWordArgument(reqData->contentData, "Mode", argString, (sizeof(argString) -1)))
+	{
+		sumMode	=	(strcasecmp(argString, "sum") == 0);
+	}
+
+	strcpy(formatString, "json");
+	GetKeyWordArgument(reqData->contentData, "Format", formatString, (sizeof(formatString) -1));
+	if (strcasecmp(formatString, "jpeg") == 0)
+	{
+		//*	the jpeg is always made from the average
+		sumMode	=	false;
+	}
+
+	//*	the cache entry is copied under the mutex and sent from the copy,
+	//*	a slow client must not hold up the next readout
+	pthread_mutex_lock(&cPreviewMutex);
+	preview	=	GetPreviewImage(binFactor, sumMode);
+	if (preview == NULL)
+	{
+		pthread_mutex_unlock(&cPreviewMutex);
+		alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "No image available");
+		return(alpacaErrCode);
+	}
+	jpegFormat	=	(strcasecmp(formatString, "jpeg") == 0);
+	if (jpegFormat && (CreatePreviewJpeg(preview) == false))
+	{
+		pthread_mutex_unlock(&cPreviewMutex);
+		alpacaErrCode	=	kASCOM_Err_NotImplemented;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "JPEG preview not available");
+		return(alpacaErrCode);
+	}
+	previewCopy				=	*preview;
+	previewCopy.imageData	=	NULL;
+	previewCopy.jpegData	=	NULL;
+	if (jpegFormat)
+	{
+		previewCopy.jpegData	=	(unsigned char *)malloc(preview->jpegLen);
+		if (previewCopy.jpegData != NULL)
+		{
+			memcpy(previewCopy.jpegData, preview->jpegData, preview->jpegLen);
+		}
+	}
+	else
+	{
+		dataLen					=	(long)preview->width * preview->height * preview->planes * sizeof(uint16_t);
+		previewCopy.imageData	=	(uint16_t *)malloc(dataLen);
+		if (previewCopy.imageData != NULL)
+		{
+			memcpy(previewCopy.imageData, preview->imageData, dataLen);
+		}
+	}
+	pthread_mutex_unlock(&cPreviewMutex);
+	preview	=	&previewCopy;
+	if ((preview->jpegData == NULL) && (preview->imageData == NULL))
+	{
+		alpacaErrCode	=	kASCOM_Err_InternalError;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to allocate memory");
+		return(alpacaErrCode);
+	}
+
+	if (jpegFormat)
+	{
+		SendBinaryHttpHeader(mySocket, "image/jpeg", preview->jpegLen);
+		bytesWritten	=	write(mySocket, preview->jpegData, preview->jpegLen);
+		*binaryDataSent	=	true;
+	}
+	else if (strcasecmp(formatString, "imagebytes") == 0)
+	{
+		columnBuff	=	(uint16_t *)malloc(preview->height * preview->planes * sizeof(uint16_t));
+		if (columnBuff != NULL)
+		{
+			dataLen	=	(long)preview->width * preview->height * preview->planes * sizeof(uint16_t);
+			SendImageBytesHeader(	mySocket,
+									2,			//*	ImageElementType, Int32
+									8,			//*	TransmissionElementType, UInt16
+									preview->width,
+									preview->height,
+									preview->planes,
+									dataLen);
+			bytesWritten	=	1;
+			for (xxx=0; (xxx < preview->width) && (bytesWritten > 0); xxx++)
+			{
+				colIdx	=	0;
+				for (yyy=0; yyy<preview->height; yyy++)
+				{
+					for (ppp=0; ppp<preview->planes; ppp++)
+					{
+						columnBuff[colIdx++]	=	preview->imageData[((((long)yyy * preview->width) + xxx) * preview->planes) + ppp];
+					}
+				}
+				bytesWritten	=	write(mySocket, columnBuff, (colIdx * sizeof(uint16_t)));
+			}
+			free(columnBuff);
+			*binaryDataSent	=	true;
+		}
+		else
+		{
+			alpacaErrCode	=	kASCOM_Err_InternalError;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to allocate memory");
+		}
+	}
+	else
+	{
+		//*	json, same format as imagearray
+		JsonResponse_FinishHeader(httpHeader, "");
+		JsonResponse_SendTextBuffer(mySocket, httpHeader);
+		*httpHeaderSent	=	true;
+
+		JsonResponse_Add_Int32(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"xsize",	preview->width,		INCLUDE_COMMA);
+		JsonResponse_Add_Int32(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"ysize",	preview->height,	INCLUDE_COMMA);
+		JsonResponse_Add_Int32(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"binning",	preview->binFactor,	INCLUDE_COMMA);
+		//*	Type = 2  >> 32 bit interger
+		JsonResponse_Add_Int32(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"Type",		2,					INCLUDE_COMMA);
+		JsonResponse_Add_Int32(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"Rank",		((preview->planes > 1) ? 3 : 2),	INCLUDE_COMMA);
+
+		JsonResponse_Add_ArrayStart(	mySocket,
+										reqData->jsonTextBuffer,
+										kMaxJsonBuffLen,
+										gValueString);
+		//*	Flush the json buffer
+		JsonResponse_SendTextBuffer(mySocket, reqData->jsonTextBuffer);
+
+		Send_imagearray_preview(mySocket, preview);
+
+		JsonResponse_Add_ArrayEnd(	mySocket,
+									reqData->jsonTextBuffer,
+									kMaxJsonBuffLen,
+									INCLUDE_COMMA);
+	}
+	if (preview->jpegData != NULL)
+	{
+		free(preview->jpegData);
+	}
+	if (preview->imageData != NULL)
+	{
+		free(preview->imageData);
+	}
+	return(alpacaErrCode);
+}
+
+#endif	//	_ENABLE_CAMERA_
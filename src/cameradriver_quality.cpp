@@ -0,0 +1,512 @@
+//**************************************************************************
+//*	Name:			cameradriver_quality.cpp
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Per frame quality metrics
+//*
+//*					Frames used to be graded afterwards (star count, HFR, background,
+//*					noise, eccentricity) by a separate program that read every FITS
+//*					file back in. The camera already has each frame in memory.
+//*
+//*					PUT /api/v1/camera/0/quality	Action=enable|disable
+//*					GET /api/v1/camera/0/quality	the last result and the queue counts
+//*
+//*					When enabled, every saved frame is copied (image pool buffer) and
+//*					queued for the quality thread, which runs the star detector on one
+//*					core so it stays out of the way of the readout. If the thread falls
+//*					behind, frames are dropped from the analysis, never from the camera.
+//*
+//*					The results go to
+//*						a CSV sidecar, one per session, imagedata/quality-<date>.csv
+//*						the FITS header of the saved frame, space for the keywords is
+//*						reserved when the file is written so the update is done in place
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Mar 26,	2021	<MLS> Created cameradriver_quality.cpp
+//*	Mar 30,	2021	<MLS> Disable no longer joins the thread from the request handler
+//*	Mar 30,	2021	<MLS> StopQualityMetrics() releases the jobs that are still queued
+//*****************************************************************************
+
+#ifdef _ENABLE_CAMERA_
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<time.h>
+#include	<unistd.h>
+#include	<sys/time.h>
+
+#define _ENABLE_CONSOLE_DEBUG_
+#include	"ConsoleDebug.h"
+
+#include	"JsonResponse.h"
+#include	"alpacadriver.h"
+#include	"alpacadriver_helper.h"
+#include	"cameradriver.h"
+#include	"imagepool.h"
+
+#define	kQuality_CSVheader	"frame,filename,date-obs,exposure,stars,hfr,fwhm,eccentricity,background,noise,analysis-ms"
+
+//*****************************************************************************
+static void	*QualityThread(void *arg)
+{
+CameraDriver	*cameraObj;
+
+	cameraObj	=	(CameraDriver *)arg;
+	cameraObj->RunQualityThread();
+	return(NULL);
+}
+
+//*****************************************************************************
+//*	called from the constructor
+//*****************************************************************************
+void	CameraDriver::InitQualityMetrics(void)
+{
+	memset(&cQualityMetrics, 0, sizeof(TYPE_QUALITY_METRICS));
+	pthread_mutex_init(&cQualityMetrics.queueMutex, NULL);
+	pthread_cond_init(&cQualityMetrics.queueCond, NULL);
+	cLastFitsFileName[0]	=	0;
+}
+
+//*****************************************************************************
+//*	starts the thread and a new sidecar file
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::StartQualityMetrics(char *alpacaErrMsg)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+time_t				currentTime;
+struct tm			localTime;
+char				dateString[32];
+int					threadErr;
+
+	if (cQualityMetrics.threadActive && cQualityMetrics.keepRunning)
+	{
+		return(kASCOM_Err_Success);
+	}
+	//*	a thread that was disabled finishes its queue and exits on its own,
+	//*	it still has to be joined before there can be a new one
+	if (cQualityMetrics.threadActive)
+	{
+		pthread_join(cQualityMetrics.threadID, NULL);
+		cQualityMetrics.threadActive	=	false;
+	}
+	ReleaseQualityQueue();
+
+	currentTime	=	time(NULL);
+	localtime_r(&currentTime, &localTime);
+	strftime(dateString, sizeof(dateString), "%Y%m%d-%H%M%S", &localTime);
+	snprintf(cQualityMetrics.sidecarFileName, sizeof(cQualityMetrics.sidecarFileName), "quality-%s.csv", dateString);
+
+	cQualityMetrics.framesAnalyzed	=	0;
+	cQualityMetrics.framesDropped	=	0;
+	cQualityMetrics.keepRunning		=	true;
+	threadErr						=	pthread_create(&cQualityMetrics.threadID, NULL, &QualityThread, this);
+	if (threadErr == 0)
+	{
+		cQualityMetrics.threadActive	=	true;
+		pthread_mutex_lock(&cQualityMetrics.queueMutex);
+		cQualityMetrics.enabled			=	true;
+		pthread_mutex_unlock(&cQualityMetrics.queueMutex);
+	}
+	else
+	{
+		cQualityMetrics.keepRunning	=	false;
+		alpacaErrCode				=	kASCOM_Err_FailedUnknown;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to start the quality thread");
+	}
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+//*	from the request handler, no new frames are queued. The thread analyzes the
+//*	frames already queued and exits, StartQualityMetrics() joins it
+//*****************************************************************************
+void	CameraDriver::DisableQualityMetrics(void)
+{
+	pthread_mutex_lock(&cQualityMetrics.queueMutex);
+	cQualityMetrics.enabled		=	false;
+	cQualityMetrics.keepRunning	=	false;
+	pthread_cond_signal(&cQualityMetrics.queueCond);
+	pthread_mutex_unlock(&cQualityMetrics.queueMutex);
+}
+
+//*****************************************************************************
+//*	the image pool buffers of any jobs still in the queue go back
+//*****************************************************************************
+void	CameraDriver::ReleaseQualityQueue(void)
+{
+	pthread_mutex_lock(&cQualityMetrics.queueMutex);
+	while (cQualityMetrics.queueCnt > 0)
+	{
+		ImagePool_Release(cQualityMetrics.queue[cQualityMetrics.queueHead].imageData);
+		cQualityMetrics.queue[cQualityMetrics.queueHead].imageData	=	NULL;
+		cQualityMetrics.queueHead	=	(cQualityMetrics.queueHead + 1) % kQuality_QueueLen;
+		cQualityMetrics.queueCnt--;
+		cQualityMetrics.framesDropped++;
+	}
+	cQualityMetrics.queueHead	=	0;
+	pthread_mutex_unlock(&cQualityMetrics.queueMutex);
+}
+
+//*****************************************************************************
+//*	called from the destructor, the frames still queued are not analyzed
+//*****************************************************************************
+void	CameraDriver::StopQualityMetrics(void)
+{
+	DisableQualityMetrics();
+	ReleaseQualityQueue();
+	if (cQualityMetrics.threadActive)
+	{
+		pthread_join(cQualityMetrics.threadID, NULL);
+		cQualityMetrics.threadActive	=	false;
+	}
+	//*	anything queued while the thread was finishing its last frame
+	ReleaseQualityQueue();
+	if (cQualityMetrics.monoBuffer != NULL)
+	{
+		free(cQualityMetrics.monoBuffer);
+		cQualityMetrics.monoBuffer	=	NULL;
+		cQualityMetrics.monoBufLen	=	0;
+	}
+}
+
+//*****************************************************************************
+//*	called by SaveImageData() after the files have been written
+//*	the copy is the only cost to the camera, the next readout can overwrite
+//*	cCameraDataBuffer while the thread is still working on this one
+//*****************************************************************************
+void	CameraDriver::QueueQualityAnalysis(void)
+{
+TYPE_QUALITY_JOB	qualityJob;
+size_t				dataLength;
+int					bytesPerPixel;
+int					queueIdx;
+
+	if ((cQualityMetrics.enabled == false) || (cCameraDataBuffer == NULL))
+	{
+		return;
+	}
+	if (cQualityMetrics.queueCnt >= kQuality_QueueLen)
+	{
+		//*	no point in making the copy
+		cQualityMetrics.framesDropped++;
+		return;
+	}
+
+	memset(&qualityJob, 0, sizeof(TYPE_QUALITY_JOB));
+	qualityJob.imageType	=	cROIinfo.currentROIimageType;
+	qualityJob.width		=	cROIinfo.currentROIwidth;
+	qualityJob.height		=	cROIinfo.currentROIheight;
+	if ((qualityJob.width <= 0) || (qualityJob.height <= 0))
+	{
+		qualityJob.width	=	cCameraXsize;
+		qualityJob.height	=	cCameraYsize;
+	}
+	qualityJob.rawColor		=	IsRawColorImage();
+	switch(qualityJob.imageType)
+	{
+		case kImageType_RAW16:
+			bytesPerPixel	=	2;
+			break;
+
+		case kImageType_RGB24:
+			bytesPerPixel	=	3;
+			break;
+
+		default:
+			bytesPerPixel	=	1;
+			break;
+	}
+	dataLength				=	(size_t)qualityJob.width * qualityJob.height * bytesPerPixel;
+	qualityJob.imageData	=	(unsigned char *)ImagePool_Alloc(dataLength);
+	if (qualityJob.imageData == NULL)
+	{
+		cQualityMetrics.framesDropped++;
+		return;
+	}
+	memcpy(qualityJob.imageData, cCameraDataBuffer, dataLength);
+
+	qualityJob.quality.frameNumber		=	cFramesRead;
+	qualityJob.quality.exposureStart	=	cLastexposure_StartTime;
+	qualityJob.quality.exposure_us		=	cLastexposure_duration_us;
+	strcpy(qualityJob.quality.fitsFileName, cLastFitsFileName);
+
+	pthread_mutex_lock(&cQualityMetrics.queueMutex);
+	//*	enabled is checked again, the request handler can disable while the copy is made
+	if (cQualityMetrics.enabled && (cQualityMetrics.queueCnt < kQuality_QueueLen))
+	{
+		queueIdx							=	(cQualityMetrics.queueHead + cQualityMetrics.queueCnt) % kQuality_QueueLen;
+		cQualityMetrics.queue[queueIdx]		=	qualityJob;
+		cQualityMetrics.queueCnt++;
+		qualityJob.imageData				=	NULL;
+		pthread_cond_signal(&cQualityMetrics.queueCond);
+	}
+	pthread_mutex_unlock(&cQualityMetrics.queueMutex);
+
+	if (qualityJob.imageData != NULL)
+	{
+		//*	the queue filled up or it was disabled while the copy was being made
+		ImagePool_Release(qualityJob.imageData);
+		cQualityMetrics.framesDropped++;
+	}
+}
+
+//*****************************************************************************
+//*	runs until it is disabled, finishes what is in the queue first
+//*****************************************************************************
+void	CameraDriver::RunQualityThread(void)
+{
+TYPE_QUALITY_JOB	qualityJob;
+
+	CONSOLE_DEBUG_W_STR("Quality thread started for", cDeviceManufAbrev);
+	pthread_mutex_lock(&cQualityMetrics.queueMutex);
+	while (cQualityMetrics.keepRunning || (cQualityMetrics.queueCnt > 0))
+	{
+		if (cQualityMetrics.queueCnt == 0)
+		{
+			pthread_cond_wait(&cQualityMetrics.queueCond, &cQualityMetrics.queueMutex);
+			continue;
+		}
+		qualityJob					=	cQualityMetrics.queue[cQualityMetrics.queueHead];
+		cQualityMetrics.queueHead	=	(cQualityMetrics.queueHead + 1) % kQuality_QueueLen;
+		cQualityMetrics.queueCnt--;
+		pthread_mutex_unlock(&cQualityMetrics.queueMutex);
+
+		AnalyzeQualityJob(&qualityJob);
+		ImagePool_Release(qualityJob.imageData);
+		WriteQualitySidecar(&qualityJob.quality);
+		WriteQualityFitsKeywords(&qualityJob.quality);
+
+		pthread_mutex_lock(&cQualityMetrics.queueMutex);
+		cQualityMetrics.lastResult	=	qualityJob.quality;
+		cQualityMetrics.framesAnalyzed++;
+	}
+	pthread_mutex_unlock(&cQualityMetrics.queueMutex);
+	CONSOLE_DEBUG_W_NUM("Quality thread -- exit --, frames\t=", cQualityMetrics.framesAnalyzed);
+}
+
+//*****************************************************************************
+void	CameraDriver::AnalyzeQualityJob(TYPE_QUALITY_JOB *qualityJob)
+{
+TYPE_STAR_ANALYSIS	*analysis;
+TYPE_FRAME_QUALITY	*quality;
+bool				detectOK;
+
+	quality		=	&qualityJob->quality;
+	analysis	=	(TYPE_STAR_ANALYSIS *)calloc(1, sizeof(TYPE_STAR_ANALYSIS));
+	if (analysis != NULL)
+	{
+		detectOK	=	DetectStarsInImage(	qualityJob->imageData,
+												qualityJob->imageType,
+												qualityJob->width,
+												qualityJob->height,
+												qualityJob->rawColor,
+												quality->frameNumber,
+												1,
+												&cQualityMetrics.monoBuffer,
+												&cQualityMetrics.monoBufLen,
+												analysis);
+		if (detectOK)
+		{
+			quality->starCnt			=	analysis->starCnt;
+			quality->medianHFR			=	analysis->medianHFR;
+			quality->medianFWHM			=	analysis->medianFWHM;
+			quality->medianEccentricity	=	analysis->medianEccentricity;
+			quality->background			=	analysis->background;
+			quality->noise				=	analysis->noise;
+			quality->analysisTime_us	=	analysis->analysisTime_us;
+		}
+		free(analysis);
+	}
+}
+
+//*****************************************************************************
+//*	one line per frame, the header goes in when the file is new
+//*****************************************************************************
+void	CameraDriver::WriteQualitySidecar(const TYPE_FRAME_QUALITY *quality)
+{
+FILE			*filePointer;
+char			filePath[128];
+char			dateString[48];
+struct timeval	exposureStart;
+long			fileLength;
+
+	snprintf(filePath, sizeof(filePath), "%s/%s", kImageDataDir, cQualityMetrics.sidecarFileName);
+	filePointer	=	fopen(filePath, "a");
+	if (filePointer != NULL)
+	{
+		fseek(filePointer, 0, SEEK_END);
+		fileLength	=	ftell(filePointer);
+		if (fileLength == 0)
+		{
+			fprintf(filePointer, "%s\n", kQuality_CSVheader);
+		}
+		exposureStart	=	quality->exposureStart;
+		FormatTimeStringISO8601(&exposureStart, dateString);
+		fprintf(filePointer, "%u,%s,%s,%1.6f,%d,%1.3f,%1.3f,%1.3f,%1.1f,%1.2f,%1.1f\n",
+							quality->frameNumber,
+							quality->fitsFileName,
+							dateString,
+							(quality->exposure_us / 1000000.0),
+							quality->starCnt,
+							quality->medianHFR,
+							quality->medianFWHM,
+							quality->medianEccentricity,
+							quality->background,
+							quality->noise,
+							(quality->analysisTime_us / 1000.0));
+		fclose(filePointer);
+	}
+	else
+	{
+		CONSOLE_DEBUG_W_STR("Failed to open", filePath);
+	}
+}
+
+//*****************************************************************************
+//*	the header space was reserved by SaveImageAsFITS(), nothing has to move
+//*****************************************************************************
+void	CameraDriver::WriteQualityFitsKeywords(const TYPE_FRAME_QUALITY *quality)
+{
+#ifdef _ENABLE_FITS_
+fitsfile	*fitsFilePtr;
+char		filePath[256];
+int			fitsStatus;
+int			starCnt;
+float		floatValue;
+
+	if (strlen(quality->fitsFileName) == 0)
+	{
+		return;
+	}
+	snprintf(filePath, sizeof(filePath), "%s/%s", kImageDataDir, quality->fitsFileName);
+	fitsStatus	=	0;
+	if (fits_open_image(&fitsFilePtr, filePath, READWRITE, &fitsStatus) == 0)
+	{
+		starCnt		=	quality->starCnt;
+		fits_update_key(fitsFilePtr, TINT,		"STARCNT",	&starCnt,		"Number of stars detected", &fitsStatus);
+		if (starCnt > 0)
+		{
+			floatValue	=	quality->medianHFR;
+			fits_update_key(fitsFilePtr, TFLOAT,	"HFR",		&floatValue,	"Median half flux radius (pixels)", &fitsStatus);
+			floatValue	=	quality->medianFWHM;
+			fits_update_key(fitsFilePtr, TFLOAT,	"FWHM",		&floatValue,	"Median star FWHM (pixels)", &fitsStatus);
+			floatValue	=	quality->medianEccentricity;
+			fits_update_key(fitsFilePtr, TFLOAT,	"ECCENTR",	&floatValue,	"Median star eccentricity", &fitsStatus);
+		}
+		floatValue	=	quality->background;
+		fits_update_key(fitsFilePtr, TFLOAT,	"SKYBKG",	&floatValue,	"Median sky background (ADU)", &fitsStatus);
+		floatValue	=	quality->noise;
+		fits_update_key(fitsFilePtr, TFLOAT,	"SKYNOISE",	&floatValue,	"Sky background noise (ADU)", &fitsStatus);
+
+		//*	the header changed, so did the checksum
+		fits_write_chksum(fitsFilePtr, &fitsStatus);
+		if (fitsStatus != 0)
+		{
+			CONSOLE_DEBUG_W_NUM("Failed to update FITS quality keywords, fitsStatus\t=", fitsStatus);
+		}
+		fitsStatus	=	0;
+		fits_close_file(fitsFilePtr, &fitsStatus);
+	}
+	else
+	{
+		CONSOLE_DEBUG_W_STR("Failed to open", filePath);
+	}
+#endif	//	_ENABLE_FITS_
+}
+
+//*****************************************************************************
+//*	Action=enable|disable, a new sidecar file is started each time it is enabled
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Put_Quality(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+char				argumentString[32];
+
+	if (GetKeyWordArgument(reqData->contentData, "Action", argumentString, (sizeof(argumentString) -1)) == false)
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "'Action' argument not found");
+	}
+	else if (strcasecmp(argumentString, "enable") == 0)
+	{
+		alpacaErrCode	=	StartQualityMetrics(alpacaErrMsg);
+	}
+	else if (strcasecmp(argumentString, "disable") == 0)
+	{
+		//*	the thread is not joined here, it may still have frames to do
+		DisableQualityMetrics();
+	}
+	else
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Action must be enable or disable");
+	}
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Get_Quality(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
+{
+TYPE_FRAME_QUALITY	lastResult;
+int					mySocket;
+int					queueCnt;
+
+	mySocket	=	reqData->socket;
+
+	pthread_mutex_lock(&cQualityMetrics.queueMutex);
+	lastResult	=	cQualityMetrics.lastResult;
+	queueCnt	=	cQualityMetrics.queueCnt;
+	pthread_mutex_unlock(&cQualityMetrics.queueMutex);
+
+	JsonResponse_Add_Bool(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"quality-enabled",		cQualityMetrics.enabled,			INCLUDE_COMMA);
+	JsonResponse_Add_String(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"quality-sidecar",		cQualityMetrics.sidecarFileName,	INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"quality-analyzed",		cQualityMetrics.framesAnalyzed,		INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"quality-dropped",		cQualityMetrics.framesDropped,		INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"quality-queued",		queueCnt,							INCLUDE_COMMA);
+
+	//*	the last frame that was analyzed
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"quality-frame",		lastResult.frameNumber,				INCLUDE_COMMA);
+	JsonResponse_Add_String(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"quality-filename",		lastResult.fitsFileName,			INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"quality-stars",		lastResult.starCnt,					INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"quality-hfr",			lastResult.medianHFR,				INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"quality-fwhm",			lastResult.medianFWHM,				INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"quality-eccentricity",	lastResult.medianEccentricity,		INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"quality-background",	lastResult.background,				INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"quality-noise",		lastResult.noise,					INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"quality-time-us",		lastResult.analysisTime_us,			INCLUDE_COMMA);
+	return(kASCOM_Err_Success);
+}
+
+#endif	//	_ENABLE_CAMERA_
@@ -0,0 +1,839 @@
+//**************************************************************************
+//*	Name:			cameradriver_roistream.cpp
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	High rate region of interest streaming for focusing and guiding
+//*
+//*					Subframes set with startx/numx go through the normal single exposure
+//*					cycle, which is far too slow for guiding or for watching a star
+//*					while focusing.
+//*
+//*					In ROI stream mode the camera runs continuous (video) capture on a
+//*					small window. A stream thread reads each frame, measures the star
+//*					(background, noise, peak, centroid, flux) and pushes the frame to
+//*					every subscriber as a TYPE_ROI_FRAME_HEADER followed by the pixels.
+//*
+//*					PUT  roistream Action=start StartX StartY NumX NumY [Duration] [RecordTime] [ImageType]
+//*					PUT  roistream Action=stop
+//*					GET  roistream						status (JSON)
+//*					GET  roistream Subscribe=true		keeps the connection open and streams frames
+//*
+//*					The subscriber socket is detached from the listen thread, it belongs to
+//*					the stream thread until the stream stops or the client goes away.
+//*					A subscriber that can not keep up misses frames rather than slowing
+//*					down the stream for everyone else.
+//*
+//*					Drivers implement Start_ROIstream(), Read_ROIframe() and Stop_ROIstream().
+//*					Drivers with a frame callback (ToupTek) copy the frame into
+//*					cROIstream.frameBuffer and call PostROIframe(), the default
+//*					Read_ROIframe() waits for that.
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Mar  2,	2021	<MLS> Created cameradriver_roistream.cpp
+//*	Mar 30,	2021	<MLS> AddROIsubscriber() re-checks active under streamMutex
+//*	Mar 30,	2021	<MLS> A stream that ran out its record time is restarted for a new subscriber
+//*****************************************************************************
+
+#ifdef _ENABLE_CAMERA_
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<math.h>
+#include	<time.h>
+#include	<unistd.h>
+#include	<errno.h>
+#include	<sys/time.h>
+#include	<sys/socket.h>
+#include	<sys/uio.h>
+#include	<sys/ioctl.h>
+#include	<netinet/in.h>
+#include	<netinet/tcp.h>
+#ifdef __linux__
+	#include	<linux/sockios.h>
+#endif
+
+#define _ENABLE_CONSOLE_DEBUG_
+#include	"ConsoleDebug.h"
+
+#include	"JsonResponse.h"
+#include	"alpacadriver.h"
+#include	"alpacadriver_helper.h"
+#include	"cameradriver.h"
+#include	"socket_listen.h"
+
+#define	kROIstream_DefaultSize		256
+#define	kROIstream_ReadMargin_ms	500			//*	added to the exposure time for the read timeout
+#define	kROIstream_SendTimeout_ms	200
+#define	kROIstream_MinSendBuffer	(256 * 1024)
+#define	kROIstream_CentroidSigma	5.0
+
+//*****************************************************************************
+static void	*ROIstreamThread(void *arg)
+{
+CameraDriver	*cameraObj;
+
+	cameraObj	=	(CameraDriver *)arg;
+	cameraObj->RunROIstreamThread();
+	return(NULL);
+}
+
+//*****************************************************************************
+static void	CloseSubscriber(TYPE_ROI_SUBSCRIBER *subscriber)
+{
+	if (subscriber->socket >= 0)
+	{
+		shutdown(subscriber->socket, SHUT_RDWR);
+		close(subscriber->socket);
+	}
+	subscriber->socket			=	-1;
+	subscriber->droppedFrames	=	0;
+	subscriber->framesSent		=	0;
+}
+
+//*****************************************************************************
+//*	background and noise from a sigma clipped mean, then an intensity weighted
+//*	centroid in a box around the brightest pixel
+//*****************************************************************************
+static void	AnalyzeROIframe(const unsigned char		*pixelData,
+							const int				width,
+							const int				height,
+							const int				bytesPerPixel,
+							TYPE_ROI_FRAME_HEADER	*frameHeader)
+{
+const uint16_t	*pixels16;
+int				pixelCnt;
+int				ii;
+int				xx;
+int				yy;
+int				peakIdx;
+int				peakX;
+int				peakY;
+int				boxLeft;
+int				boxRight;
+int				boxTop;
+int				boxBottom;
+double			pixValue;
+double			peakValue;
+double			sum;
+double			sumSqrd;
+double			mean;
+double			sigma;
+double			clipLimit;
+long			clipCnt;
+double			threshold;
+double			weight;
+double			weightSum;
+double			weightX;
+double			weightY;
+uint32_t		starPixels;
+
+	pixels16	=	(const uint16_t *)pixelData;
+	pixelCnt	=	width * height;
+
+	//*	first pass, mean, noise and the peak
+	sum			=	0.0;
+	sumSqrd		=	0.0;
+	peakValue	=	-1.0;
+	peakIdx		=	0;
+	for (ii=0; ii<pixelCnt; ii++)
+	{
+		pixValue	=	(bytesPerPixel == 2) ? pixels16[ii] : pixelData[ii];
+		sum			+=	pixValue;
+		sumSqrd		+=	pixValue * pixValue;
+		if (pixValue > peakValue)
+		{
+			peakValue	=	pixValue;
+			peakIdx		=	ii;
+		}
+	}
+	mean	=	sum / pixelCnt;
+	sigma	=	sqrt(fabs((sumSqrd / pixelCnt) - (mean * mean)));
+
+	//*	second pass, leave the star out of the background
+	clipLimit	=	mean + (3.0 * sigma);
+	sum			=	0.0;
+	sumSqrd		=	0.0;
+	clipCnt		=	0;
+	for (ii=0; ii<pixelCnt; ii++)
+	{
+		pixValue	=	(bytesPerPixel == 2) ? pixels16[ii] : pixelData[ii];
+		if (pixValue <= clipLimit)
+		{
+			sum		+=	pixValue;
+			sumSqrd	+=	pixValue * pixValue;
+			clipCnt++;
+		}
+	}
+	if (clipCnt > 0)
+	{
+		mean	=	sum / clipCnt;
+		sigma	=	sqrt(fabs((sumSqrd / clipCnt) - (mean * mean)));
+	}
+
+	frameHeader->peakValue		=	peakValue;
+	frameHeader->background		=	mean;
+	frameHeader->noise			=	sigma;
+	frameHeader->centroidX		=	-1.0;
+	frameHeader->centroidY		=	-1.0;
+	frameHeader->flux			=	0.0;
+	frameHeader->starPixels		=	0;
+
+	threshold	=	mean + (kROIstream_CentroidSigma * sigma);
+	if (peakValue > threshold)
+	{
+		peakX		=	peakIdx % width;
+		peakY		=	peakIdx / width;
+		boxLeft		=	(peakX > kROIstream_CentroidBox) ? (peakX - kROIstream_CentroidBox) : 0;
+		boxTop		=	(peakY > kROIstream_CentroidBox) ? (peakY - kROIstream_CentroidBox) : 0;
+		boxRight	=	peakX + kROIstream_CentroidBox;
+		boxBottom	=	peakY + kROIstream_CentroidBox;
+		if (boxRight >= width)
+		{
+			boxRight	=	width - 1;
+		}
+		if (boxBottom >= height)
+		{
+			boxBottom	=	height - 1;
+		}
+
+		weightSum	=	0.0;
+		weightX		=	0.0;
+		weightY		=	0.0;
+		starPixels	=	0;
+		for (yy=boxTop; yy<=boxBottom; yy++)
+		{
+			for (xx=boxLeft; xx<=boxRight; xx++)
+			{
+				ii			=	(yy * width) + xx;
+				pixValue	=	(bytesPerPixel == 2) ? pixels16[ii] : pixelData[ii];
+				if (pixValue > threshold)
+				{
+					weight		=	pixValue - mean;
+					weightSum	+=	weight;
+					weightX		+=	weight * xx;
+					weightY		+=	weight * yy;
+					starPixels++;
+				}
+			}
+		}
+		if (weightSum > 0.0)
+		{
+			frameHeader->centroidX	=	frameHeader->startX + (weightX / weightSum);
+			frameHeader->centroidY	=	frameHeader->startY + (weightY / weightSum);
+			frameHeader->flux		=	weightSum;
+			frameHeader->starPixels	=	starPixels;
+		}
+	}
+}
+
+//*****************************************************************************
+//*	returns false if the subscriber has gone away
+//*****************************************************************************
+static bool	SendROIframe(	TYPE_ROI_SUBSCRIBER		*subscriber,
+							TYPE_ROI_FRAME_HEADER	*frameHeader,
+							const unsigned char		*pixelData)
+{
+struct iovec	ioVector[2];
+struct msghdr	message;
+ssize_t			bytesSent;
+size_t			packetLen;
+int				sendBufSize;
+int				bytesQueued;
+socklen_t		optionLen;
+bool			stillConnected;
+
+	stillConnected	=	true;
+	packetLen		=	sizeof(TYPE_ROI_FRAME_HEADER) + frameHeader->dataLength;
+
+	//*	if the last frames are still sitting in the socket, this client is behind
+	sendBufSize		=	0;
+	bytesQueued		=	0;
+	optionLen		=	sizeof(sendBufSize);
+	getsockopt(subscriber->socket, SOL_SOCKET, SO_SNDBUF, &sendBufSize, &optionLen);
+#ifdef SIOCOUTQ
+	ioctl(subscriber->socket, SIOCOUTQ, &bytesQueued);
+#endif
+	if ((sendBufSize > 0) && ((size_t)(sendBufSize - bytesQueued) < packetLen))
+	{
+		subscriber->droppedFrames++;
+	}
+	else
+	{
+		frameHeader->droppedFrames	=	subscriber->droppedFrames;
+
+		ioVector[0].iov_base	=	frameHeader;
+		ioVector[0].iov_len		=	sizeof(TYPE_ROI_FRAME_HEADER);
+		ioVector[1].iov_base	=	(void *)pixelData;
+		ioVector[1].iov_len		=	frameHeader->dataLength;
+		memset(&message, 0, sizeof(message));
+		message.msg_iov			=	ioVector;
+		message.msg_iovlen		=	2;
+
+		bytesSent	=	sendmsg(subscriber->socket, &message, MSG_NOSIGNAL);
+		if (bytesSent == (ssize_t)packetLen)
+		{
+			subscriber->framesSent++;
+		}
+		else
+		{
+			//*	an error, or a partial frame after the send timeout, either way the
+			//*	stream is out of sync and the client has to reconnect
+			CONSOLE_DEBUG_W_NUM("ROI subscriber dropped, errno\t=", errno);
+			stillConnected	=	false;
+		}
+	}
+	return(stillConnected);
+}
+
+//*****************************************************************************
+//*	called from the constructor
+//*****************************************************************************
+void	CameraDriver::InitROIstream(void)
+{
+pthread_condattr_t	condAttr;
+int					ii;
+
+	memset(&cROIstream, 0, sizeof(TYPE_ROI_STREAM));
+	pthread_mutex_init(&cROIstream.streamMutex, NULL);
+	pthread_condattr_init(&condAttr);
+	pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+	pthread_cond_init(&cROIstream.frameCond, &condAttr);
+	pthread_condattr_destroy(&condAttr);
+
+	for (ii=0; ii<kROIstream_MaxSubscribers; ii++)
+	{
+		cROIstream.subscribers[ii].socket	=	-1;
+	}
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::StartROIstream(char *alpacaErrMsg)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode;
+long				frameLength;
+int					threadErr;
+
+	CONSOLE_DEBUG(__FUNCTION__);
+	//*	a stream that ran out its record time still has to be joined
+	if (cROIstream.threadActive && (cROIstream.active == false))
+	{
+		pthread_join(cROIstream.threadID, NULL);
+		cROIstream.threadActive	=	false;
+	}
+
+	frameLength	=	cROIstream.width * cROIstream.height * cROIstream.bytesPerPixel;
+	if ((cROIstream.frameBuffer == NULL) || (cROIstream.frameBufLen < frameLength))
+	{
+		ImagePool_Release(cROIstream.frameBuffer);
+		cROIstream.frameBuffer	=	(unsigned char *)ImagePool_Alloc(frameLength);
+		cROIstream.frameBufLen	=	(cROIstream.frameBuffer != NULL) ? frameLength : 0;
+	}
+	if (cROIstream.frameBuffer == NULL)
+	{
+		alpacaErrCode	=	kASCOM_Err_FailedUnknown;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to allocate ROI frame buffer");
+		return(alpacaErrCode);
+	}
+
+	cROIstream.frameCnt		=	0;
+	cROIstream.readErrCnt	=	0;
+	cROIstream.framesPerSec	=	0.0;
+	cROIstream.framePosted	=	false;
+	memset(&cROIstream.lastFrame, 0, sizeof(TYPE_ROI_FRAME_HEADER));
+
+	//*	the state has to be set first, callback drivers check it
+	cInternalCameraState	=	kCameraState_ROIstream;
+	alpacaErrCode			=	Start_ROIstream();
+	if (alpacaErrCode == kASCOM_Err_Success)
+	{
+		cROIstream.active		=	true;
+		cROIstream.keepRunning	=	true;
+		cROIstream.startTime_us	=	FrameTiming_GetMonotonic_us();
+		threadErr				=	pthread_create(&cROIstream.threadID, NULL, &ROIstreamThread, this);
+		if (threadErr == 0)
+		{
+			cROIstream.threadActive	=	true;
+		}
+		else
+		{
+			CONSOLE_DEBUG_W_NUM("Failed to create ROI stream thread, err\t=", threadErr);
+			Stop_ROIstream();
+			cROIstream.active		=	false;
+			cROIstream.keepRunning	=	false;
+			cInternalCameraState	=	kCameraState_Idle;
+			alpacaErrCode			=	kASCOM_Err_FailedUnknown;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to create ROI stream thread");
+		}
+	}
+	else
+	{
+		cInternalCameraState	=	kCameraState_Idle;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, cLastCameraErrMsg);
+	}
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+void	CameraDriver::StopROIstream(void)
+{
+	if (cROIstream.threadActive)
+	{
+		pthread_mutex_lock(&cROIstream.streamMutex);
+		cROIstream.keepRunning	=	false;
+		pthread_cond_broadcast(&cROIstream.frameCond);
+		pthread_mutex_unlock(&cROIstream.streamMutex);
+
+		pthread_join(cROIstream.threadID, NULL);
+		cROIstream.threadActive	=	false;
+	}
+}
+
+//*****************************************************************************
+//*	the connection has been answered with the http header, from here on the
+//*	socket belongs to the stream thread.
+//*	A thread that stopped on its own (record time up) is joined and the stream
+//*	is started again with the same settings, the same as the MJPEG stream does.
+//*	active is checked again under the mutex, the thread may have exited since
+//*	the caller looked, a socket added after that would never be serviced or closed
+//*****************************************************************************
+bool	CameraDriver::AddROIsubscriber(const int socket)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode;
+char				restartErrMsg[256];
+int					ii;
+int					sendBufSize;
+int					noDelay;
+struct	timeval		sendTimeout;
+bool				added;
+
+	added	=	false;
+
+	if (cROIstream.threadActive && (cROIstream.active == false))
+	{
+		//*	StartROIstream() joins the old thread first
+		if (cInternalCameraState == kCameraState_Idle)
+		{
+			CONSOLE_DEBUG("Restarting the ROI stream for a new subscriber");
+			alpacaErrCode	=	StartROIstream(restartErrMsg);
+			if (alpacaErrCode != kASCOM_Err_Success)
+			{
+				CONSOLE_DEBUG(restartErrMsg);
+			}
+		}
+	}
+
+	pthread_mutex_lock(&cROIstream.streamMutex);
+	for (ii=0; (ii<kROIstream_MaxSubscribers) && (added == false) && cROIstream.active; ii++)
+	{
+		if (cROIstream.subscribers[ii].socket < 0)
+		{
+			//*	room for a few frames, no Nagle delay, and never block the stream for long
+			sendBufSize	=	4 * (sizeof(TYPE_ROI_FRAME_HEADER) + cROIstream.frameBufLen);
+			if (sendBufSize < kROIstream_MinSendBuffer)
+			{
+				sendBufSize	=	kROIstream_MinSendBuffer;
+			}
+			noDelay					=	1;
+			sendTimeout.tv_sec		=	0;
+			sendTimeout.tv_usec		=	kROIstream_SendTimeout_ms * 1000;
+			setsockopt(socket, SOL_SOCKET,	SO_SNDBUF,		&sendBufSize,	sizeof(sendBufSize));
+			setsockopt(socket, SOL_SOCKET,	SO_SNDTIMEO,	&sendTimeout,	sizeof(sendTimeout));
+			setsockopt(socket, IPPROTO_TCP,	TCP_NODELAY,	&noDelay,		sizeof(noDelay));
+
+			cROIstream.subscribers[ii].socket			=	socket;
+			cROIstream.subscribers[ii].droppedFrames	=	0;
+			cROIstream.subscribers[ii].framesSent		=	0;
+			cROIstream.subscriberCnt++;
+			added	=	true;
+		}
+	}
+	pthread_mutex_unlock(&cROIstream.streamMutex);
+	return(added);
+}
+
+//*****************************************************************************
+//*	called by drivers from their SDK callback after filling cROIstream.frameBuffer
+//*****************************************************************************
+void	CameraDriver::PostROIframe(void)
+{
+	pthread_mutex_lock(&cROIstream.streamMutex);
+	cROIstream.frameTime_us	=	FrameTiming_GetMonotonic_us();
+	cROIstream.framePosted	=	true;
+	pthread_cond_broadcast(&cROIstream.frameCond);
+	pthread_mutex_unlock(&cROIstream.streamMutex);
+}
+
+//*****************************************************************************
+//*	default for drivers with a frame callback, waits for PostROIframe()
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Read_ROIframe(const uint32_t timeout_ms)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode;
+struct timespec		wakeTime;
+
+	clock_gettime(CLOCK_MONOTONIC, &wakeTime);
+	wakeTime.tv_sec		+=	timeout_ms / 1000;
+	wakeTime.tv_nsec	+=	(timeout_ms % 1000) * 1000000;
+	if (wakeTime.tv_nsec >= 1000000000)
+	{
+		wakeTime.tv_sec++;
+		wakeTime.tv_nsec	-=	1000000000;
+	}
+
+	pthread_mutex_lock(&cROIstream.streamMutex);
+	while ((cROIstream.framePosted == false) && cROIstream.keepRunning)
+	{
+		if (pthread_cond_timedwait(&cROIstream.frameCond, &cROIstream.streamMutex, &wakeTime) == ETIMEDOUT)
+		{
+			break;
+		}
+	}
+	alpacaErrCode	=	cROIstream.framePosted ? kASCOM_Err_Success : kASCOM_Err_FailedUnknown;
+	pthread_mutex_unlock(&cROIstream.streamMutex);
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Start_ROIstream(void)
+{
+	strcpy(cLastCameraErrMsg, "ROI streaming is not supported by this camera");
+	return(kASCOM_Err_NotImplemented);
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Stop_ROIstream(void)
+{
+	return(kASCOM_Err_NotImplemented);
+}
+
+//*****************************************************************************
+void	CameraDriver::RunROIstreamThread(void)
+{
+TYPE_ASCOM_STATUS		readErrCode;
+TYPE_ROI_FRAME_HEADER	frameHeader;
+struct timeval			wallTime;
+uint64_t				currentTime_us;
+uint64_t				rateStart_us;
+uint32_t				rateFrameCnt;
+uint32_t				timeout_ms;
+int						ii;
+
+	CONSOLE_DEBUG_W_STR("ROI stream thread started for", cDeviceManufAbrev);
+	timeout_ms		=	(cROIstream.exposure_us / 1000) + kROIstream_ReadMargin_ms;
+	rateStart_us	=	FrameTiming_GetMonotonic_us();
+	rateFrameCnt	=	0;
+	while (cROIstream.keepRunning)
+	{
+		readErrCode	=	Read_ROIframe(timeout_ms);
+		if (readErrCode == kASCOM_Err_Success)
+		{
+			cROIstream.frameCnt++;
+			rateFrameCnt++;
+
+			memset(&frameHeader, 0, sizeof(TYPE_ROI_FRAME_HEADER));
+			memcpy(frameHeader.signature, kROIstream_Signature, 4);
+			frameHeader.headerLength	=	sizeof(TYPE_ROI_FRAME_HEADER);
+			frameHeader.frameNumber		=	cROIstream.frameCnt;
+			frameHeader.startX			=	cROIstream.startX;
+			frameHeader.startY			=	cROIstream.startY;
+			frameHeader.width			=	cROIstream.width;
+			frameHeader.height			=	cROIstream.height;
+			frameHeader.bytesPerPixel	=	cROIstream.bytesPerPixel;
+			frameHeader.exposure_us		=	cROIstream.exposure_us;
+			frameHeader.dataLength		=	cROIstream.width * cROIstream.height * cROIstream.bytesPerPixel;
+			frameHeader.monotonic_us	=	cROIstream.frameTime_us;
+
+			//*	wall clock time of the same moment
+			gettimeofday(&wallTime, NULL);
+			currentTime_us				=	FrameTiming_GetMonotonic_us();
+			frameHeader.timeStamp_us	=	((uint64_t)wallTime.tv_sec * 1000000) + wallTime.tv_usec;
+			if (currentTime_us > frameHeader.monotonic_us)
+			{
+				frameHeader.timeStamp_us	-=	(currentTime_us - frameHeader.monotonic_us);
+			}
+
+			AnalyzeROIframe(cROIstream.frameBuffer,
+							cROIstream.width,
+							cROIstream.height,
+							cROIstream.bytesPerPixel,
+							&frameHeader);
+
+			pthread_mutex_lock(&cROIstream.streamMutex);
+			for (ii=0; ii<kROIstream_MaxSubscribers; ii++)
+			{
+				if (cROIstream.subscribers[ii].socket >= 0)
+				{
+					if (SendROIframe(&cROIstream.subscribers[ii], &frameHeader, cROIstream.frameBuffer) == false)
+					{
+						CloseSubscriber(&cROIstream.subscribers[ii]);
+						cROIstream.subscriberCnt--;
+					}
+				}
+			}
+			cROIstream.lastFrame	=	frameHeader;
+			//*	callback drivers can fill the buffer again
+			cROIstream.framePosted	=	false;
+			pthread_mutex_unlock(&cROIstream.streamMutex);
+		}
+		else
+		{
+			cROIstream.readErrCnt++;
+		}
+
+		currentTime_us	=	FrameTiming_GetMonotonic_us();
+		if ((currentTime_us - rateStart_us) >= 1000000)
+		{
+			cROIstream.framesPerSec	=	(rateFrameCnt * 1000000.0) / (currentTime_us - rateStart_us);
+			rateStart_us			=	currentTime_us;
+			rateFrameCnt			=	0;
+		}
+		if ((cROIstream.duration_secs > 0.0) &&
+			((currentTime_us - cROIstream.startTime_us) >= (cROIstream.duration_secs * 1000000.0)))
+		{
+			CONSOLE_DEBUG("ROI stream record time is up");
+			cROIstream.keepRunning	=	false;
+		}
+	}
+
+	Stop_ROIstream();
+
+	pthread_mutex_lock(&cROIstream.streamMutex);
+	for (ii=0; ii<kROIstream_MaxSubscribers; ii++)
+	{
+		CloseSubscriber(&cROIstream.subscribers[ii]);
+	}
+	cROIstream.subscriberCnt	=	0;
+	cROIstream.active			=	false;
+	pthread_mutex_unlock(&cROIstream.streamMutex);
+
+	cInternalCameraState	=	kCameraState_Idle;
+	CONSOLE_DEBUG_W_NUM("ROI stream thread -- exit --, frames\t=", cROIstream.frameCnt);
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Put_ROIstream(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+char				argumentString[32];
+int					startX;
+int					startY;
+int					numX;
+int					numY;
+
+	if (GetKeyWordArgument(reqData->contentData, "Action", argumentString, (sizeof(argumentString) -1)) == false)
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Action must be start or stop");
+	}
+	else if (strcasecmp(argumentString, "stop") == 0)
+	{
+		if (cROIstream.threadActive)
+		{
+			StopROIstream();
+		}
+		else
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "ROI stream is not running");
+		}
+	}
+	else if (strcasecmp(argumentString, "start") == 0)
+	{
+		if (cInternalCameraState != kCameraState_Idle)
+		{
+			alpacaErrCode	=	kASCOM_Err_CameraBusy;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Camera is busy");
+			return(alpacaErrCode);
+		}
+
+		//*	default is a centered window
+		numX	=	kROIstream_DefaultSize;
+		numY	=	kROIstream_DefaultSize;
+		if (GetKeyWordArgument(reqData->contentData, "NumX", argumentString, (sizeof(argumentString) -1)))
+		{
+			numX	=	atoi(argumentString);
+		}
+		if (GetKeyWordArgument(reqData->contentData, "NumY", argumentString, (sizeof(argumentString) -1)))
+		{
+			numY	=	atoi(argumentString);
+		}
+		startX	=	(cCameraXsize - numX) / 2;
+		startY	=	(cCameraYsize - numY) / 2;
+		if (GetKeyWordArgument(reqData->contentData, "StartX", argumentString, (sizeof(argumentString) -1)))
+		{
+			startX	=	atoi(argumentString);
+		}
+		if (GetKeyWordArgument(reqData->contentData, "StartY", argumentString, (sizeof(argumentString) -1)))
+		{
+			startY	=	atoi(argumentString);
+		}
+
+		//*	most SDKs want the width a multiple of 8 and the height even,
+		//*	keep the start even so the bayer pattern does not change
+		numX	&=	~7;
+		numY	&=	~1;
+		startX	&=	~1;
+		startY	&=	~1;
+		if ((numX < kROIstream_MinSize) || (numX > kROIstream_MaxSize) ||
+			(numY < kROIstream_MinSize) || (numY > kROIstream_MaxSize) ||
+			(startX < 0) || ((startX + numX) > cCameraXsize) ||
+			(startY < 0) || ((startY + numY) > cCameraYsize))
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "ROI is out of range");
+			return(alpacaErrCode);
+		}
+
+		cROIstream.startX			=	startX;
+		cROIstream.startY			=	startY;
+		cROIstream.width			=	numX;
+		cROIstream.height			=	numY;
+		cROIstream.bytesPerPixel	=	2;
+		cROIstream.exposure_us		=	cCurrentExposure_us;
+		cROIstream.duration_secs	=	0.0;
+		if (GetKeyWordArgument(reqData->contentData, "ImageType", argumentString, (sizeof(argumentString) -1)))
+		{
+			if (strcasecmp(argumentString, "RAW8") == 0)
+			{
+				cROIstream.bytesPerPixel	=	1;
+			}
+		}
+		if (GetKeyWordArgument(reqData->contentData, "Duration", argumentString, (sizeof(argumentString) -1)))
+		{
+			cROIstream.exposure_us	=	atof(argumentString) * 1000000.0;
+		}
+		if (GetKeyWordArgument(reqData->contentData, "RecordTime", argumentString, (sizeof(argumentString) -1)))
+		{
+			cROIstream.duration_secs	=	atof(argumentString);
+		}
+		if ((cROIstream.exposure_us < cExposureMin_us) || (cROIstream.exposure_us <= 0))
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Invalid exposure time");
+			return(alpacaErrCode);
+		}
+		alpacaErrCode	=	StartROIstream(alpacaErrMsg);
+	}
+	else
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Action must be start or stop");
+	}
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+//*	roistream?Subscribe=true turns this connection into the frame stream
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Get_ROIstream(	TYPE_GetPutRequestData	*reqData,
+													char					*alpacaErrMsg,
+													bool					*binaryDataSent)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+char				argumentString[32];
+char				httpHeader[256];
+int					mySocket;
+bool				subscribe;
+int					bytesWritten;
+
+	mySocket	=	reqData->socket;
+	subscribe	=	false;
+	if (GetKeyWordArgument(reqData->contentData, "Subscribe", argumentString, (sizeof(argumentString) -1)))
+	{
+		subscribe	=	IsTrueFalse(argumentString);
+	}
+
+	if (subscribe)
+	{
+		//*	a stream whose record time ran out still has its thread, it gets restarted
+		if ((cROIstream.active == false) && (cROIstream.threadActive == false))
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "ROI stream is not running");
+		}
+		else if (cROIstream.subscriberCnt >= kROIstream_MaxSubscribers)
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Too many ROI stream subscribers");
+		}
+		else
+		{
+			//*	no content length, the stream runs until one side closes it
+			httpHeader[0]	=	0;
+			strcat(httpHeader,	"HTTP/1.0 200 200 OK\r\n");
+			strcat(httpHeader,	"Content-type: " kROIstream_ContentType "\r\n");
+			strcat(httpHeader,	"Cache-Control: no-cache\r\n");
+			strcat(httpHeader,	"Server: AlpacaPi\r\n");
+			strcat(httpHeader,	"\r\n");
+			bytesWritten	=	write(mySocket, httpHeader, strlen(httpHeader));
+			if ((bytesWritten > 0) && AddROIsubscriber(mySocket))
+			{
+				SocketListen_DetachSocket(mySocket);
+			}
+			else
+			{
+				CONSOLE_DEBUG("Failed to add ROI stream subscriber");
+			}
+			//*	the http header has gone out, no JSON from here on
+			*binaryDataSent	=	true;
+		}
+		return(alpacaErrCode);
+	}
+
+	pthread_mutex_lock(&cROIstream.streamMutex);
+	JsonResponse_Add_Bool(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"active",		cROIstream.active,						INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"startx",		cROIstream.startX,						INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"starty",		cROIstream.startY,						INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"numx",			cROIstream.width,						INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"numy",			cROIstream.height,						INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"bytesperpixel",	cROIstream.bytesPerPixel,			INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"exposure",		(cROIstream.exposure_us / 1000000.0),	INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"frames",		cROIstream.frameCnt,					INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"readerrors",	cROIstream.readErrCnt,					INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"fps",			cROIstream.framesPerSec,				INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"subscribers",	cROIstream.subscriberCnt,				INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"centroidx",	cROIstream.lastFrame.centroidX,			INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"centroidy",	cROIstream.lastFrame.centroidY,			INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"peak",			cROIstream.lastFrame.peakValue,			INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"flux",			cROIstream.lastFrame.flux,				INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"background",	cROIstream.lastFrame.background,		INCLUDE_COMMA);
+	pthread_mutex_unlock(&cROIstream.streamMutex);
+
+	return(alpacaErrCode);
+}
+
+#endif	//	_ENABLE_CAMERA_
@@ -30,6 +30,16 @@
 //*	Jan 30,	2020	<MLS> Added SaveImageData(), AddToDataProductsList()
 //*	Jan 30,	2020	<MLS> Added SaveOpenCVImage()
 //*	Jan 30,	2020	<MLS> Separated saving of opencv image from the creation part
+//*	Feb  3,	2021	<MLS> Added OpenSERvideoFile() & CloseSERvideoFile()
+//*	Feb  3,	2021	<MLS> FireCapture text file now reports SER output and dropped frames
+//*	Feb 10,	2021	<MLS> CreateOpenCVImage() debayers RAW color images for the live view
+//*	Feb 26,	2021	<MLS> cOpenCV_Image is now reused and its data comes from the image pool
+//*	Mar 10,	2021	<MLS> Added CatalogSavedFile(), saved files go in the image catalog
+//*	Mar 12,	2021	<MLS> SaveImageData() writes thumbnail and preview JPEGs
+//*	Mar 26,	2021	<MLS> SaveImageData() queues the frame for the quality metrics
+//*	Mar 28,	2021	<MLS> WriteFireCaptureTextFile() uses the sensor telemetry
+//*	Mar 30,	2021	<MLS> CreateOpenCVImage() holds cPreviewMutex while it uses the debayered image
+//*	Mar 30,	2021	<MLS> CatalogSavedFile() uses snprintf instead of strncpy
 //*****************************************************************************
 
 #ifdef _ENABLE_CAMERA_
@@ -38,6 +48,7 @@
 //#define	_ENABLE_PNG_
 
 #include	<stdio.h>
+#include	<stdlib.h>
 #include	<string.h>
 
 #define _ENABLE_CONSOLE_DEBUG_
@@ -61,6 +72,7 @@
 #include	"alpacadriver.h"
 #include	"alpacadriver_helper.h"
 #include	"cameradriver.h"
+#include	"eventlogging.h"
 
 //*****************************************************************************
 void	CameraDriver::SaveImageData(void)
@@ -86,6 +98,9 @@ int	ii;
 		SaveHistogramFile();
 	#endif // _INCLUDE_HISTOGRAM_
 
+		//*	uses the histogram for the stretch, must come after it
+		SaveThumbnails();
+
 
 	#ifdef _USE_OPENCV_
 		SaveOpenCVImage();
@@ -125,6 +140,15 @@ int	ii;
 			CONSOLE_DEBUG_W_NUM("cvSaveImage returned\t=", openCVerr);
 		}
 	#endif // _JETSON_
+
+		//*	FITS adds itself, everything else is in the data products list
+		for (ii=0; ii<cOtherDataCnt; ii++)
+		{
+			CatalogSavedFile(cOtherDataProducts[ii].filename);
+		}
+
+		//*	after the FITS save so the quality thread knows the file name
+		QueueQualityAnalysis();
 	}
 	else
 	{
@@ -159,6 +183,28 @@ int		fileNameLen;
 }
 
 
+//*****************************************************************************
+//*	the catalog would find the file through inotify anyway, but only we know
+//*	the exposure, filter and object
+//*****************************************************************************
+void	CameraDriver::CatalogSavedFile(const char *fileName)
+{
+TYPE_CATALOG_ENTRY	fileInfo;
+
+	memset(&fileInfo, 0, sizeof(TYPE_CATALOG_ENTRY));
+	fileInfo.exposure_us	=	cLastexposure_duration_us;
+	snprintf(fileInfo.object,	sizeof(fileInfo.object),	"%s",	cObjectName);
+	snprintf(fileInfo.filter,	sizeof(fileInfo.filter),	"%s",	cTS_info.filterName);
+#ifdef _ENABLE_FILTERWHEEL_
+	if (cConnectedFilterWheel != NULL)
+	{
+		//*	what the filter wheel driver last reported, not a call to the wheel
+		snprintf(fileInfo.filter,	sizeof(fileInfo.filter),	"%s",	cConnectedFilterWheel->cFilterWheelCurrName);
+	}
+#endif // _ENABLE_FILTERWHEEL_
+	ImageCatalog_AddFile(fileName, &fileInfo);
+}
+
 #if defined(_USE_OPENCV_)
 
 
@@ -166,16 +212,21 @@ int		fileNameLen;
 //*	wget http://192.168.0.201:6800/api/v1.0.0-oas3/camera/0/startexposure%20Content-Type:%20-dDuration=0.011&Light=true
 //*	wget http://192.168.0.201:6800/api/v1.0.0-oas3/camera/0/imagearray
 //*****************************************************************************
-int	CameraDriver::CreateOpenCVImage(const unsigned char *imageDataPtr)
+int	CameraDriver::CreateOpenCVImage(const unsigned char *rawImageDataPtr)
 {
-int				ii;
-int				returnCode	=	0;
-int				width;
-int				height;
-int				imageDataLen;
-int				openCVimageWidth;
-int				bytesPerPixel;
-int				bytesPerPixel2;	//*	calculated 2 different ways
+const unsigned char	*imageDataPtr;
+unsigned char		*debayerPtr;
+TYPE_IMAGE_TYPE		imageType;
+int					ii;
+int					returnCode	=	0;
+int					width;
+int					height;
+int					imageDataLen;
+int					openCVimageWidth;
+int					bytesPerPixel;
+int					bytesPerPixel2;	//*	calculated 2 different ways
+int					openCVdepth;
+int					openCVchannels;
 
 
 	SETUP_TIMING();
@@ -183,53 +234,73 @@ int				bytesPerPixel2;	//*	calculated 2 different ways
 //	CONSOLE_DEBUG(__FUNCTION__);
 	GenerateFileNameRoot();
 
-	if (cOpenCV_Image != NULL)
-	{
-		cvReleaseImage(&cOpenCV_Image);
-		cOpenCV_Image	=	NULL;
-	}
-	if (cOpenCV_Image != NULL)
-	{
-		cvReleaseImage(&cOpenCV_LiveDisplay);
-		cOpenCV_LiveDisplay	=	NULL;
-	}
-
 	width			=	cCameraXsize;
 	height			=	cCameraYsize;
 	GetImage_ROI_info();
+	imageDataPtr	=	rawImageDataPtr;
+	imageType		=	cROIinfo.currentROIimageType;
 
 //	CONSOLE_DEBUG_W_NUM("currentROIimageType\t=",	cROIinfo.currentROIimageType);
 //	CONSOLE_DEBUG_W_NUM("width\t=",		width);
 //	CONSOLE_DEBUG_W_NUM("height\t=",	height);
 //	CONSOLE_DEBUG_W_NUM("w * h\t=",		(width * height));
 
-	switch(cROIinfo.currentROIimageType)
+	//*	color sensors in RAW mode get debayered (OpenCV wants BGR)
+	//*	the debayered image is held until it has been copied
+	pthread_mutex_lock(&cPreviewMutex);
+	if (IsRawColorImage())
+	{
+		debayerPtr	=	GetDebayeredImage(true);
+		if ((debayerPtr != NULL) && (cDebayerBufLen >= (width * height * 3)))
+		{
+			imageDataPtr	=	debayerPtr;
+			imageType		=	kImageType_RGB24;
+		}
+	}
+
+	openCVdepth		=	0;
+	openCVchannels	=	0;
+	switch(imageType)
 	{
 		case kImageType_RAW8:
 		//	CONSOLE_DEBUG("kImageType_RAW8");
-			cOpenCV_Image	=	cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 1);
+			openCVdepth		=	IPL_DEPTH_8U;
+			openCVchannels	=	1;
 			imageDataLen	=	width * height;
 			break;
 
 		case kImageType_RAW16:
 		//	CONSOLE_DEBUG("kImageType_RAW16");
-			cOpenCV_Image	=	cvCreateImage(cvSize(width, height), IPL_DEPTH_16U, 1);
+			openCVdepth		=	IPL_DEPTH_16U;
+			openCVchannels	=	1;
 			imageDataLen	=	width * height * 2;
 			break;
 
 
 		case kImageType_RGB24:
 		//	CONSOLE_DEBUG("kImageType_RGB24");
-			cOpenCV_Image	=	cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 3);
+			openCVdepth		=	IPL_DEPTH_8U;
+			openCVchannels	=	3;
 			imageDataLen	=	width * height * 3;
 			break;
 
 		case kImageType_Y8:
 		default:
-			cOpenCV_Image	=	NULL;
 			break;
 
 	}
+
+	//*	the image from the last frame gets reused if it is the same size and type
+	if ((cOpenCV_Image != NULL) &&
+		((cOpenCV_Image->width != width) || (cOpenCV_Image->height != height) ||
+		(cOpenCV_Image->depth != openCVdepth) || (cOpenCV_Image->nChannels != openCVchannels)))
+	{
+		ReleasePooledOpenCVImage(&cOpenCV_Image);
+	}
+	if ((cOpenCV_Image == NULL) && (openCVchannels > 0))
+	{
+		cOpenCV_Image	=	CreatePooledOpenCVImage(width, height, openCVdepth, openCVchannels);
+	}
 	DEBUG_TIMING("Stop point 1 (milliseconds)\t=");
 
 	if (imageDataPtr != NULL)
@@ -298,11 +369,51 @@ int				bytesPerPixel2;	//*	calculated 2 different ways
 	{
 		CONSOLE_DEBUG("Image data is NULL");
 	}
+	pthread_mutex_unlock(&cPreviewMutex);
 	DEBUG_TIMING("Stop point 5 (milliseconds)\t=");
 
 	return(returnCode);
 }
 
+//*****************************************************************************
+//*	openCV image header wrapped around memory from the image pool
+//*****************************************************************************
+IplImage	*CameraDriver::CreatePooledOpenCVImage(	const int	width,
+													const int	height,
+													const int	depth,
+													const int	channels)
+{
+IplImage	*newImage;
+char		*imageData;
+
+	newImage	=	cvCreateImageHeader(cvSize(width, height), depth, channels);
+	if (newImage != NULL)
+	{
+		imageData	=	(char *)ImagePool_Alloc((size_t)newImage->widthStep * height);
+		if (imageData != NULL)
+		{
+			cvSetData(newImage, imageData, newImage->widthStep);
+		}
+		else
+		{
+			cvReleaseImageHeader(&newImage);
+			newImage	=	NULL;
+		}
+	}
+	return(newImage);
+}
+
+//*****************************************************************************
+void	CameraDriver::ReleasePooledOpenCVImage(IplImage **openCVimage)
+{
+	if (*openCVimage != NULL)
+	{
+		ImagePool_Release((*openCVimage)->imageData);
+		cvReleaseImageHeader(openCVimage);
+		*openCVimage	=	NULL;
+	}
+}
+
 //*****************************************************************************
 int	CameraDriver::SaveOpenCVImage(void)
 {
@@ -430,6 +541,7 @@ FILE	*filePointer;
 double	exposureTim_ms;
 double	imageDuration_secs;
 int		gainPercent;
+TYPE_SENSOR_TELEMETRY	telemetry;
 
 	CONSOLE_DEBUG(__FUNCTION__);
 
@@ -489,9 +601,17 @@ int		gainPercent;
 		fprintf(filePointer, "Frames captured=%d\r\n",			cNumFramesSaved);
 		fprintf(filePointer, "Video Frames captured=%d\r\n",	cNumVideoFramesSaved);
 
-		fprintf(filePointer, "File type=%s\r\n",				"AVI");
-		fprintf(filePointer, "Extended AVI mode=%s\r\n",		"false");
-		fprintf(filePointer, "CODEC=%s\r\n",					codecString);
+		fprintf(filePointer, "Dropped frames=%d\r\n",			cVideoFramesDropped);
+		if (cAVIfourcc != 0)
+		{
+			fprintf(filePointer, "File type=%s\r\n",				"AVI");
+			fprintf(filePointer, "Extended AVI mode=%s\r\n",		"false");
+			fprintf(filePointer, "CODEC=%s\r\n",					codecString);
+		}
+		else
+		{
+			fprintf(filePointer, "File type=%s\r\n",				"SER");
+		}
 
 //		fprintf(filePointer, "Compressed AVI=%s\r\n",			foo);false
 		fprintf(filePointer, "Binning=%s\r\n",					"no");
@@ -518,8 +638,8 @@ int		gainPercent;
 //		fprintf(filePointer, "Noise(avg.deviation)=%s\r\n",		foo);n/a
 		fprintf(filePointer, "Limit=%3.0f Seconds\r\n",			cVideoDuration_secs);	//	30 Seconds
 
-		Read_SensorTemp();
-		fprintf(filePointer, "Sensor temperature=%1.1f C\r\n",	cCameraTemp_Dbl);
+		GetSensorTelemetry(&telemetry);
+		fprintf(filePointer, "Sensor temperature=%1.1f C\r\n",	telemetry.ccdTemp_degC);
 
 		fprintf(filePointer, "Object=%s\r\n",					cObjectName);
 		if (strlen(cAuxTextTag) > 0)
@@ -540,4 +660,121 @@ int		gainPercent;
 
 
 
+#pragma mark -
+#pragma mark SER video
+//*****************************************************************************
+//*	creates the SER file and starts its writer thread
+//*	the ROI info must be current (GetImage_ROI_info()) before calling this
+//*****************************************************************************
+bool	CameraDriver::OpenSERvideoFile(void)
+{
+char	filePath[256];
+int		imageWidth;
+int		imageHeight;
+int		bitsPerPixel;
+int		serColorID;
+int		serRetCode;
+bool	successFlag;
+
+	successFlag	=	false;
+	CloseSERvideoFile();
+
+	imageWidth	=	cROIinfo.currentROIwidth;
+	imageHeight	=	cROIinfo.currentROIheight;
+	if ((imageWidth <= 0) || (imageHeight <= 0))
+	{
+		imageWidth	=	cCameraXsize;
+		imageHeight	=	cCameraYsize;
+	}
+
+	bitsPerPixel	=	8;
+	serColorID		=	kSER_COLOR_MONO;
+	switch(cROIinfo.currentROIimageType)
+	{
+		case kImageType_RAW16:
+			bitsPerPixel	=	16;
+			//*	fall through to get the bayer pattern
+		case kImageType_RAW8:
+			if (cIsColorCam)
+			{
+				switch(cBayerPattern)
+				{
+					case kBAYER_PAT_RG:	serColorID	=	kSER_COLOR_BAYER_RGGB;	break;
+					case kBAYER_PAT_BG:	serColorID	=	kSER_COLOR_BAYER_BGGR;	break;
+					case kBAYER_PAT_GR:	serColorID	=	kSER_COLOR_BAYER_GRBG;	break;
+					case kBAYER_PAT_GB:	serColorID	=	kSER_COLOR_BAYER_GBRG;	break;
+				}
+			}
+			break;
+
+		case kImageType_RGB24:
+			//*	the camera SDKs deliver the color planes in BGR order
+			serColorID	=	kSER_COLOR_BGR;
+			break;
+
+		case kImageType_Y8:
+		default:
+			break;
+	}
+
+	cSERwriter	=	(TYPE_SER_WRITER *)malloc(sizeof(TYPE_SER_WRITER));
+	if (cSERwriter != NULL)
+	{
+		GenerateFileNameRoot();
+		strcpy(filePath, kImageDataDir);
+		strcat(filePath, "/");
+		strcat(filePath, cFileNameRoot);
+		strcat(filePath, ".ser");
+
+		serRetCode	=	SER_Open(	cSERwriter,
+									filePath,
+									imageWidth,
+									imageHeight,
+									bitsPerPixel,
+									serColorID,
+									gObseratorySettings.Observer,
+									cDeviceName,
+									cTelescopeModel,
+									cVideoUseDirectIO);
+		if (serRetCode == 0)
+		{
+			successFlag	=	true;
+		}
+		else
+		{
+			free(cSERwriter);
+			cSERwriter	=	NULL;
+			strcpy(cLastCameraErrMsg, "Failed to create SER video file");
+			CONSOLE_DEBUG(cLastCameraErrMsg);
+		}
+	}
+	return(successFlag);
+}
+
+//*****************************************************************************
+//*	flushes the queued frames, writes the trailer and closes the file
+//*****************************************************************************
+void	CameraDriver::CloseSERvideoFile(void)
+{
+	if (cSERwriter != NULL)
+	{
+		SER_Close(cSERwriter);
+		cVideoFramesDropped	=	cSERwriter->framesDropped;
+		if (cVideoFramesDropped > 0)
+		{
+		char	droppedMsg[64];
+
+			sprintf(droppedMsg, "%d frames dropped", cVideoFramesDropped);
+			LogEvent(	"camera",
+						"SER video",
+						NULL,
+						kASCOM_Err_Success,
+						droppedMsg);
+		}
+		free(cSERwriter);
+		cSERwriter	=	NULL;
+	}
+}
+
+
 #endif	//	_ENABLE_CAMERA_
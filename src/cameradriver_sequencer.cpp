@@ -0,0 +1,618 @@
+//**************************************************************************
+//*	Name:			cameradriver_sequencer.cpp
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Pipelined exposure sequencer
+//*
+//*					startsequence runs exposure, readout, save strictly in order,
+//*					for short flats and lucky imaging runs the time between frames
+//*					is often longer than the exposure.
+//*
+//*					This sequencer starts exposure N+1 as soon as frame N has been
+//*					read out and calibrated. Analysis and saving of frame N then run
+//*					while the camera is exposing N+1.
+//*
+//*					The camera buffer, the file name root, the exposure times and the
+//*					FITS header snapshot all belong to "the current frame", so the
+//*					values for N+1 are set aside (cPipelineNextFrame) while N is saved
+//*					and put back when it is done. The readout of N+1 waits until the
+//*					save of N is finished, the capture thread does not pick up the next
+//*					exposure until the state machine has cleared the last result.
+//*
+//*					A gain or filter change cannot happen while the camera is exposing,
+//*					the first frame of a step that changes either one is started from
+//*					the idle state after the previous frame has been saved.
+//*
+//*					duty cycle = exposure time of the completed frames / wall time
+//*					since the first exposure started.
+//*
+//*	Usage:
+//*		PUT /api/v1/camera/0/sequence	Action=start
+//*										&Steps=count,exposure[,gain[,filter]];...
+//*											exposure is in seconds
+//*											gain and filter are optional, - leaves them alone
+//*											filter is a position (0 based) or a filter name
+//*											steps can also be separated by |
+//*		PUT /api/v1/camera/0/sequence	Action=abort
+//*		GET /api/v1/camera/0/sequence
+//*
+//*		Steps=20,0.01,100,Red;20,0.01,-,Green;20,0.01,-,Blue
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Mar 14,	2021	<MLS> Created cameradriver_sequencer.cpp
+//*****************************************************************************
+
+#ifdef _ENABLE_CAMERA_
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<ctype.h>
+#include	<sys/time.h>
+
+#define _ENABLE_CONSOLE_DEBUG_
+#include	"ConsoleDebug.h"
+
+#include	"JsonResponse.h"
+#include	"eventlogging.h"
+#include	"alpacadriver.h"
+#include	"alpacadriver_helper.h"
+#include	"cameradriver.h"
+
+#ifdef _ENABLE_FILTERWHEEL_
+	#include	"filterwheeldriver.h"
+#endif
+
+//*****************************************************************************
+//*	count,exposure[,gain[,filter]]
+//*	a filter given by name is returned in filterName, the position is looked up later
+//*****************************************************************************
+static bool	ParseSequenceStep(char *stepString, TYPE_SEQUENCE_STEP *step, char *filterName, const int maxNameLen)
+{
+char	*fieldPtr;
+char	*savePtr;
+int		fieldIdx;
+
+	step->frameCnt			=	0;
+	step->exposure_us		=	0;
+	step->gain				=	-1;
+	step->filterPosition	=	-1;
+	filterName[0]			=	0;
+	fieldIdx				=	0;
+	fieldPtr				=	strtok_r(stepString, ",:", &savePtr);
+	while (fieldPtr != NULL)
+	{
+		while (*fieldPtr == 0x20)
+		{
+			fieldPtr++;
+		}
+		switch(fieldIdx)
+		{
+			case 0:
+				step->frameCnt		=	atoi(fieldPtr);
+				break;
+
+			case 1:
+				step->exposure_us	=	atof(fieldPtr) * 1000000.0;
+				break;
+
+			case 2:
+				if ((*fieldPtr != '-') && (*fieldPtr != 0))
+				{
+					step->gain		=	atoi(fieldPtr);
+				}
+				break;
+
+			case 3:
+				if (isdigit(*fieldPtr))
+				{
+					step->filterPosition	=	atoi(fieldPtr);
+				}
+				else if ((*fieldPtr != '-') && (*fieldPtr != 0))
+				{
+					strncpy(filterName, fieldPtr, (maxNameLen - 1));
+					filterName[maxNameLen - 1]	=	0;
+				}
+				break;
+
+			default:
+				return(false);
+		}
+		fieldIdx++;
+		fieldPtr	=	strtok_r(NULL, ",:", &savePtr);
+	}
+	return(fieldIdx >= 2);
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Pipeline_Start(const char *stepsString, char *alpacaErrMsg)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+char				stepsBuffer[256];
+char				*stepPtr;
+char				*savePtr;
+char				filterName[48];
+TYPE_SEQUENCE_STEP	*step;
+int					filterCnt;
+#ifdef _ENABLE_FILTERWHEEL_
+int					ii;
+#endif
+
+	if (cPipeline.active || (cAutoFocus.state != kAutoFocus_Idle) ||
+		(cInternalCameraState != kCameraState_Idle) || (cImageMode != kImageMode_Single))
+	{
+		alpacaErrCode	=	kASCOM_Err_CameraBusy;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Camera is busy");
+		return(alpacaErrCode);
+	}
+
+	filterCnt	=	0;
+#ifdef _ENABLE_FILTERWHEEL_
+	UpdateFilterwheelLink();
+	if (cConnectedFilterWheel != NULL)
+	{
+		filterCnt	=	cConnectedFilterWheel->cNumberOfPostions;
+	}
+#endif // _ENABLE_FILTERWHEEL_
+
+	memset(&cPipeline, 0, sizeof(TYPE_PIPELINE_SEQUENCE));
+	strncpy(stepsBuffer, stepsString, (sizeof(stepsBuffer) - 1));
+	stepsBuffer[sizeof(stepsBuffer) - 1]	=	0;
+	stepPtr	=	strtok_r(stepsBuffer, ";|", &savePtr);
+	while ((stepPtr != NULL) && (alpacaErrCode == kASCOM_Err_Success))
+	{
+		if (cPipeline.stepCnt >= kMaxSequenceSteps)
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Too many steps");
+			break;
+		}
+		step	=	&cPipeline.steps[cPipeline.stepCnt];
+		if (ParseSequenceStep(stepPtr, step, filterName, sizeof(filterName)) == false)
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Steps must be count,exposure[,gain[,filter]]");
+			break;
+		}
+	#ifdef _ENABLE_FILTERWHEEL_
+		if ((filterName[0] != 0) && (cConnectedFilterWheel != NULL))
+		{
+			for (ii=0; ii<filterCnt; ii++)
+			{
+				if (strcasecmp(cConnectedFilterWheel->cFilterDef[ii].filterDesciption, filterName) == 0)
+				{
+					step->filterPosition	=	ii;
+					break;
+				}
+			}
+		}
+	#endif // _ENABLE_FILTERWHEEL_
+		if ((filterName[0] != 0) && (step->filterPosition < 0))
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Filter name not found");
+		}
+		else if ((step->frameCnt < 1) ||
+				(step->exposure_us < cExposureMin_us) || (step->exposure_us > cExposureMax_us))
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Count or exposure is out of range");
+		}
+		else if ((step->gain >= 0) && ((step->gain < cGainMin) || (step->gain > cGainMax)))
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Gain value outside of min/max");
+		}
+		else if (step->filterPosition >= filterCnt)
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Filter is out of range or there is no filter wheel");
+		}
+		else
+		{
+			cPipeline.framesTotal	+=	step->frameCnt;
+			cPipeline.stepCnt++;
+		}
+		stepPtr	=	strtok_r(NULL, ";|", &savePtr);
+	}
+	if ((alpacaErrCode == kASCOM_Err_Success) && (cPipeline.stepCnt == 0))
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "No steps specified");
+	}
+
+	if (alpacaErrCode == kASCOM_Err_Success)
+	{
+		cPipeline.currentStep		=	-1;
+		cPipeline.framesLeftInStep	=	0;
+		cNumFramesRequested			=	cPipeline.framesTotal;
+		cNumFramesSaved				=	0;
+		cImageSeqNumber				=	0;
+		strcpy(cPipeline.statusMsg, "Running");
+		cPipeline.active			=	true;
+		LogEvent("camera", "Sequence", "Started", kASCOM_Err_Success, stepsString);
+	}
+	else
+	{
+		memset(&cPipeline, 0, sizeof(TYPE_PIPELINE_SEQUENCE));
+	}
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+//*	the exposure in progress (if any) is allowed to finish and is saved
+//*****************************************************************************
+void	CameraDriver::Pipeline_Stop(const char *statusMsg)
+{
+	if (cPipeline.active)
+	{
+		cPipeline.active	=	false;
+		cPipeline.endTime_us	=	FrameTiming_GetMonotonic_us();
+		strncpy(cPipeline.statusMsg, statusMsg, (sizeof(cPipeline.statusMsg) - 1));
+		LogEvent("camera", "Sequence", statusMsg, kASCOM_Err_Success, "");
+		CONSOLE_DEBUG_W_STR("Sequence stopped:", statusMsg);
+	}
+}
+
+//*****************************************************************************
+//*	true if the next frame is the first one of a step that has to change the
+//*	gain or move the filter wheel, that can not be done while exposing
+//*****************************************************************************
+bool	CameraDriver::Pipeline_NextFrameNeedsSetup(void)
+{
+TYPE_SEQUENCE_STEP	*nextStep;
+bool				needsSetup;
+
+	needsSetup	=	false;
+	if ((cPipeline.framesLeftInStep <= 0) && ((cPipeline.currentStep + 1) < cPipeline.stepCnt))
+	{
+		nextStep	=	&cPipeline.steps[cPipeline.currentStep + 1];
+		if ((nextStep->gain >= 0) && (nextStep->gain != cGain))
+		{
+			needsSetup	=	true;
+		}
+	#ifdef _ENABLE_FILTERWHEEL_
+		if ((nextStep->filterPosition >= 0) &&
+			((cConnectedFilterWheel == NULL) || (nextStep->filterPosition != cConnectedFilterWheel->cFilterWheelCurrPos)))
+		{
+			needsSetup	=	true;
+		}
+	#endif // _ENABLE_FILTERWHEEL_
+	}
+	return(needsSetup);
+}
+
+//*****************************************************************************
+//*	moves on to the next step when the current one has started all of its frames
+//*	returns true if the next exposure can be started now
+//*****************************************************************************
+bool	CameraDriver::Pipeline_SetupStep(void)
+{
+TYPE_SEQUENCE_STEP	*step;
+TYPE_ASCOM_STATUS	alpacaErrCode;
+
+	if (cPipeline.framesLeftInStep > 0)
+	{
+		return(true);
+	}
+	cPipeline.currentStep++;
+	if (cPipeline.currentStep >= cPipeline.stepCnt)
+	{
+		return(false);
+	}
+	step						=	&cPipeline.steps[cPipeline.currentStep];
+	cPipeline.framesLeftInStep	=	step->frameCnt;
+
+	if ((step->gain >= 0) && (step->gain != cGain))
+	{
+		alpacaErrCode	=	Write_Gain(step->gain);
+		if (alpacaErrCode == kASCOM_Err_Success)
+		{
+			cGain	=	step->gain;
+			gDeviceStateChangeCnt++;
+		}
+		else
+		{
+			CONSOLE_DEBUG_W_NUM("Failed to set gain, err\t=", alpacaErrCode);
+		}
+	}
+
+#ifdef _ENABLE_FILTERWHEEL_
+	if ((step->filterPosition >= 0) && (cConnectedFilterWheel != NULL) &&
+		(step->filterPosition != cConnectedFilterWheel->cFilterWheelCurrPos))
+	{
+		alpacaErrCode	=	cConnectedFilterWheel->Set_CurrentFilterPositon(step->filterPosition);
+		if (alpacaErrCode == kASCOM_Err_Success)
+		{
+			cConnectedFilterWheel->cFilterWheelCurrPos	=	step->filterPosition;
+			gDeviceStateChangeCnt++;
+			cPipeline.filterMoving	=	true;
+			return(false);
+		}
+		else
+		{
+			Pipeline_Stop("Failed to move filter wheel");
+			return(false);
+		}
+	}
+#endif // _ENABLE_FILTERWHEEL_
+	return(true);
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Pipeline_StartExposure(void)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode;
+TYPE_SEQUENCE_STEP	*step;
+
+	step						=	&cPipeline.steps[cPipeline.currentStep];
+	cCurrentExposure_us			=	step->exposure_us;
+	cSaveNextImage				=	true;
+	GetImage_ROI_info();
+	cLastExposure_ROIinfo		=	cROIinfo;
+	cLastexposure_duration_us	=	cCurrentExposure_us;
+	gettimeofday(&cLastexposure_StartTime, NULL);
+
+	FrameTiming_StartFrame(&cFrameTiming, cCurrentExposure_us);
+#ifdef _ENABLE_FITS_
+	CaptureFitsSnapshot();
+#endif
+	alpacaErrCode	=	Start_CameraExposure(cCurrentExposure_us);
+	GenerateFileNameRoot();
+	if (alpacaErrCode == kASCOM_Err_Success)
+	{
+		if (cPipeline.framesStarted == 0)
+		{
+			cPipeline.startTime_us	=	cFrameTiming.current.stageStart_us[kFrameStage_Exposure];
+		}
+		cPipeline.framesStarted++;
+		cPipeline.framesLeftInStep--;
+		cImageSeqNumber++;
+	}
+	else
+	{
+		cFrameTiming.currentActive	=	false;
+		Pipeline_Stop("Failed to start exposure");
+	}
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+//*	called from RunStateMachine_Idle(), the first frame and the first frame of
+//*	a step that changes the gain or filter are started here
+//*****************************************************************************
+void	CameraDriver::Pipeline_RunIdle(void)
+{
+	if (cPipeline.filterMoving)
+	{
+	#ifdef _ENABLE_FILTERWHEEL_
+		if ((cConnectedFilterWheel != NULL) &&
+			(cConnectedFilterWheel->Read_CurrentFWstate() == kFilterWheelState_Moving))
+		{
+			return;
+		}
+		if (cConnectedFilterWheel != NULL)
+		{
+			cConnectedFilterWheel->Read_CurrentFilterName(cConnectedFilterWheel->cFilterWheelCurrName);
+		}
+	#endif // _ENABLE_FILTERWHEEL_
+		cPipeline.filterMoving	=	false;
+	}
+	if (cPipeline.framesStarted < cPipeline.framesTotal)
+	{
+		if (Pipeline_SetupStep())
+		{
+			Pipeline_StartExposure();
+		}
+	}
+	else if (cPipeline.framesCompleted >= cPipeline.framesTotal)
+	{
+		Pipeline_Stop("Complete");
+	}
+}
+
+//*****************************************************************************
+//*	called from RunStateMachine_TakingPicture() as soon as the frame is read out
+//*	starts the next exposure and puts the state of the frame we have back
+//*	returns true if the next exposure is running
+//*****************************************************************************
+bool	CameraDriver::Pipeline_StartOverlapped(void)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode;
+
+	if ((cPipeline.active == false) || (cPipeline.framesStarted >= cPipeline.framesTotal) ||
+		Pipeline_NextFrameNeedsSetup())
+	{
+		return(false);
+	}
+	Pipeline_SaveFrameState(&cPipelineSavedFrame);
+
+	Pipeline_SetupStep();
+	alpacaErrCode	=	Pipeline_StartExposure();
+
+	Pipeline_SaveFrameState(&cPipelineNextFrame);
+	Pipeline_RestoreFrameState(&cPipelineSavedFrame);
+	if (alpacaErrCode == kASCOM_Err_Success)
+	{
+		cPipeline.framesOverlapped++;
+		return(true);
+	}
+	return(false);
+}
+
+//*****************************************************************************
+//*	called with the state of the frame that was just saved (or failed)
+//*****************************************************************************
+void	CameraDriver::Pipeline_FrameDone(const bool frameOK)
+{
+uint64_t	wallTime_us;
+
+	cPipeline.framesCompleted++;
+	if (frameOK)
+	{
+		cPipeline.exposureSum_us	+=	cLastexposure_duration_us;
+	}
+	else
+	{
+		cPipeline.exposureFailures++;
+	}
+	wallTime_us	=	FrameTiming_GetMonotonic_us() - cPipeline.startTime_us;
+	if (wallTime_us > 0)
+	{
+		cPipeline.dutyCycle	=	(1.0 * cPipeline.exposureSum_us) / wallTime_us;
+	}
+	if (cPipeline.framesCompleted >= cPipeline.framesTotal)
+	{
+		Pipeline_Stop("Complete");
+	}
+}
+
+//*****************************************************************************
+void	CameraDriver::Pipeline_SaveFrameState(TYPE_SEQUENCE_FRAME_STATE *frameState)
+{
+	strcpy(frameState->fileNameRoot,	cFileNameRoot);
+	frameState->exposureStartTime	=	cLastexposure_StartTime;
+	frameState->exposureEndTime		=	cLastexposure_EndTime;
+	frameState->exposure_us			=	cLastexposure_duration_us;
+	frameState->roiInfo				=	cLastExposure_ROIinfo;
+	frameState->saveNextImage		=	cSaveNextImage;
+	frameState->timeLine			=	cFrameTiming.current;
+	frameState->timeLineActive		=	cFrameTiming.currentActive;
+#ifdef _ENABLE_FITS_
+	frameState->fitsSnapshot		=	cFrameFitsSnapshot;
+#endif
+}
+
+//*****************************************************************************
+void	CameraDriver::Pipeline_RestoreFrameState(TYPE_SEQUENCE_FRAME_STATE *frameState)
+{
+	strcpy(cFileNameRoot,	frameState->fileNameRoot);
+	cLastexposure_StartTime		=	frameState->exposureStartTime;
+	cLastexposure_EndTime		=	frameState->exposureEndTime;
+	cLastexposure_duration_us	=	frameState->exposure_us;
+	cLastExposure_ROIinfo		=	frameState->roiInfo;
+	cSaveNextImage				=	frameState->saveNextImage;
+	cFrameTiming.current		=	frameState->timeLine;
+	cFrameTiming.currentActive	=	frameState->timeLineActive;
+#ifdef _ENABLE_FITS_
+	cFrameFitsSnapshot			=	frameState->fitsSnapshot;
+#endif
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Put_Sequence(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+char				argumentString[32];
+char				stepsString[256];
+
+	if (GetKeyWordArgument(reqData->contentData, "Action", argumentString, (sizeof(argumentString) -1)) == false)
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "'Action' argument not found");
+		return(alpacaErrCode);
+	}
+
+	if (strcasecmp(argumentString, "abort") == 0)
+	{
+		Pipeline_Stop("Aborted");
+	}
+	else if (strcasecmp(argumentString, "start") == 0)
+	{
+		if (GetKeyWordArgument(reqData->contentData, "Steps", stepsString, (sizeof(stepsString) -1)))
+		{
+			alpacaErrCode	=	Pipeline_Start(stepsString, alpacaErrMsg);
+		}
+		else
+		{
+			alpacaErrCode	=	kASCOM_Err_InvalidValue;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "'Steps' argument not found");
+		}
+	}
+	else
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Action must be start or abort");
+	}
+	return(alpacaErrCode);
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Get_Sequence(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
+{
+int			mySocket;
+char		lineBuff[128];
+int			ii;
+uint64_t	wallTime_us;
+
+	mySocket	=	reqData->socket;
+
+	if (cPipeline.active)
+	{
+		wallTime_us	=	FrameTiming_GetMonotonic_us() - cPipeline.startTime_us;
+	}
+	else
+	{
+		wallTime_us	=	cPipeline.endTime_us - cPipeline.startTime_us;
+	}
+	if (cPipeline.framesStarted == 0)
+	{
+		wallTime_us	=	0;
+	}
+
+	JsonResponse_Add_Bool(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"sequence-active",		cPipeline.active,					INCLUDE_COMMA);
+	JsonResponse_Add_String(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"sequence-status",		cPipeline.statusMsg,				INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"sequence-step",		cPipeline.currentStep,				INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"sequence-frames",		cPipeline.framesTotal,				INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"sequence-started",		cPipeline.framesStarted,			INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"sequence-completed",	cPipeline.framesCompleted,			INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"sequence-overlapped",	cPipeline.framesOverlapped,			INCLUDE_COMMA);
+	JsonResponse_Add_Int32(		mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"sequence-failures",	cPipeline.exposureFailures,			INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"sequence-exposuretime",	(cPipeline.exposureSum_us / 1000000.0),	INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"sequence-walltime",	(wallTime_us / 1000000.0),			INCLUDE_COMMA);
+	JsonResponse_Add_Double(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,
+								"sequence-dutycycle",	cPipeline.dutyCycle,				INCLUDE_COMMA);
+
+	JsonResponse_Add_ArrayStart(mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,	"sequence-steps");
+	for (ii=0; ii<cPipeline.stepCnt; ii++)
+	{
+		sprintf(lineBuff,	"%s{\"count\":%d,\"exposure\":%1.6f,\"gain\":%d,\"filter\":%d}",
+							((ii > 0) ? "," : ""),
+							cPipeline.steps[ii].frameCnt,
+							(cPipeline.steps[ii].exposure_us / 1000000.0),
+							cPipeline.steps[ii].gain,
+							cPipeline.steps[ii].filterPosition);
+		JsonResponse_Add_RawText(mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,	lineBuff);
+	}
+	JsonResponse_Add_ArrayEnd(	mySocket,	reqData->jsonTextBuffer,	kMaxJsonBuffLen,	INCLUDE_COMMA);
+	return(kASCOM_Err_Success);
+}
+
+#endif // _ENABLE_CAMERA_
@@ -0,0 +1,662 @@
+//**************************************************************************
+//*	Name:			cameradriver_thumbnail.cpp
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Thumbnail and stretched preview JPEGs of every saved image
+//*
+//*					Browsing a nights worth of images over WiFi should not mean
+//*					pulling hundreds of megabytes of FITS files. When an image is
+//*					saved, two small JPEGs are written next to it, in the
+//*					imagedata/thumbs directory
+//*
+//*						<fileroot>-thumb.jpg		largest dimension 160
+//*						<fileroot>-preview.jpg		largest dimension 1024
+//*
+//*					Both are stretched using the black and white points from the
+//*					analysis histogram (the same one that goes in the histogram csv)
+//*					followed by a square root curve so faint detail shows up.
+//*					The binning comes from the preview cache, so a client asking for
+//*					a preview of the same frame later gets it for free.
+//*
+//*					Only the stretch is done when the image is saved, the binning
+//*					and the JPEG encoding are done by a thread so the next exposure
+//*					does not wait on them. The JPEGs are written with libjpeg, or
+//*					with openCV if there is no libjpeg. A build with neither does
+//*					not write thumbnails.
+//*
+//*					They are served with an ETag made from the file time and size,
+//*					a client that sends If-None-Match gets a 304 with no data.
+//*					Each one is written to <name>.tmp.jpg and renamed when it is
+//*					complete, a client never sees a partly written file.
+//*
+//*	Usage:
+//*		GET /api/v1/camera/0/thumbnail?File=<image file name>	any file name from filelist,
+//*																the extension is ignored
+//*			&Size=thumb | preview								(default thumb)
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Mar 12,	2021	<MLS> Created cameradriver_thumbnail.cpp
+//*	Mar 30,	2021	<MLS> Holds cPreviewMutex while it uses the preview
+//*	Mar 30,	2021	<MLS> The JPEGs are encoded on a thread, openCV is used without libjpeg
+//*	Mar 30,	2021	<MLS> The preview is copied under cPreviewMutex, the stretch runs on the copy
+//*	Mar 30,	2021	<MLS> The JPEGs are written to a temp file and renamed into place
+//*****************************************************************************
+
+#ifdef _ENABLE_CAMERA_
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<unistd.h>
+#include	<math.h>
+#include	<sys/stat.h>
+
+#ifdef _ENABLE_JPEGLIB_
+	#include	<jpeglib.h>
+#endif
+
+#define _ENABLE_CONSOLE_DEBUG_
+#include	"ConsoleDebug.h"
+
+#include	"JsonResponse.h"
+#include	"alpacadriver.h"
+#include	"alpacadriver_helper.h"
+#include	"cameradriver.h"
+#include	"imagebin.h"
+
+#define	kThumbnail_ThumbMaxDim		160
+#define	kThumbnail_PreviewMaxDim	1024
+#define	kThumbnail_JpegQuality		80
+#define	kThumbnail_BlackFraction	0.0025		//*	0.25 % of the pixels go to black
+#define	kThumbnail_WhiteFraction	0.999		//*	0.1 % of the pixels go to white
+
+//*****************************************************************************
+//*	imageData is 8 bit, RGB order if it is color
+//*	filePath is the temp file, WriteThumbnailJpeg() renames it
+//*****************************************************************************
+static bool	EncodeThumbnailJpeg(const char		*filePath,
+								unsigned char	*imageData,
+								const int		width,
+								const int		height,
+								const int		planes)
+{
+#if defined(_ENABLE_JPEGLIB_)
+struct jpeg_compress_struct	jinfo;
+struct jpeg_error_mgr		jerr;
+JSAMPROW					row_pointer[1];
+FILE						*filePointer;
+int							rowLen;
+bool						savedOK;
+
+	filePointer	=	fopen(filePath, "wb");
+	if (filePointer == NULL)
+	{
+		CONSOLE_DEBUG_W_STR("Failed to create", filePath);
+		return(false);
+	}
+	rowLen		=	width * planes;
+	jinfo.err	=	jpeg_std_error(&jerr);
+	jpeg_create_compress(&jinfo);
+	jpeg_stdio_dest(&jinfo, filePointer);
+
+	jinfo.image_width		=	width;
+	jinfo.image_height		=	height;
+	jinfo.input_components	=	planes;
+	jinfo.in_color_space	=	(planes == 3) ? JCS_RGB : JCS_GRAYSCALE;
+
+	jpeg_set_defaults(&jinfo);
+	jpeg_set_quality(&jinfo, kThumbnail_JpegQuality, TRUE);
+	jpeg_start_compress(&jinfo, TRUE);
+
+	while (jinfo.next_scanline < jinfo.image_height)
+	{
+		row_pointer[0]	=	&imageData[(long)jinfo.next_scanline * rowLen];
+		jpeg_write_scanlines(&jinfo, row_pointer, 1);
+	}
+	jpeg_finish_compress(&jinfo);
+	jpeg_destroy_compress(&jinfo);
+	savedOK	=	(ferror(filePointer) == 0);
+	if (fclose(filePointer) != 0)
+	{
+		savedOK	=	false;
+	}
+	if (savedOK == false)
+	{
+		CONSOLE_DEBUG_W_STR("Failed to write", filePath);
+	}
+	return(savedOK);
+#elif defined(_USE_OPENCV_)
+IplImage		*thumbImage;
+unsigned char	*srcPtr;
+unsigned char	*dstPtr;
+int				jpegParams[3];
+int				xxx;
+int				yyy;
+bool			savedOK;
+
+	thumbImage	=	cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, planes);
+	if (thumbImage == NULL)
+	{
+		return(false);
+	}
+	srcPtr	=	imageData;
+	for (yyy=0; yyy<height; yyy++)
+	{
+		dstPtr	=	(unsigned char *)thumbImage->imageData + ((long)yyy * thumbImage->widthStep);
+		if (planes == 3)
+		{
+			//*	openCV is BGR
+			for (xxx=0; xxx<width; xxx++)
+			{
+				dstPtr[0]	=	srcPtr[2];
+				dstPtr[1]	=	srcPtr[1];
+				dstPtr[2]	=	srcPtr[0];
+				dstPtr		+=	3;
+				srcPtr		+=	3;
+			}
+		}
+		else
+		{
+			memcpy(dstPtr, srcPtr, width);
+			srcPtr	+=	width;
+		}
+	}
+	jpegParams[0]	=	CV_IMWRITE_JPEG_QUALITY;
+	jpegParams[1]	=	kThumbnail_JpegQuality;
+	jpegParams[2]	=	0;
+	savedOK			=	(cvSaveImage(filePath, thumbImage, jpegParams) != 0);
+	if (savedOK == false)
+	{
+		CONSOLE_DEBUG_W_STR("Failed to create", filePath);
+	}
+	cvReleaseImage(&thumbImage);
+	return(savedOK);
+#else
+	//*	no JPEG encoder in this build
+	return(false);
+#endif
+}
+
+//*****************************************************************************
+//*	the thumbnails are served while new ones are written, the JPEG goes to a
+//*	temp file in the same directory and rename() swaps it in all at once
+//*****************************************************************************
+static bool	WriteThumbnailJpeg(	const char		*filePath,
+								unsigned char	*imageData,
+								const int		width,
+								const int		height,
+								const int		planes)
+{
+char	tempFilePath[512];
+bool	savedOK;
+
+	//*	ends in .jpg so openCV still knows what to write
+	snprintf(tempFilePath, sizeof(tempFilePath), "%s.tmp.jpg", filePath);
+	savedOK	=	EncodeThumbnailJpeg(tempFilePath, imageData, width, height, planes);
+	if (savedOK && (rename(tempFilePath, filePath) != 0))
+	{
+		CONSOLE_DEBUG_W_STR("Failed to rename", tempFilePath);
+		savedOK	=	false;
+	}
+	if (savedOK == false)
+	{
+		unlink(tempFilePath);
+	}
+	return(savedOK);
+}
+
+//*****************************************************************************
+static void	*ThumbnailThread(void *arg)
+{
+CameraDriver	*cameraObj;
+
+	cameraObj	=	(CameraDriver *)arg;
+	cameraObj->WriteThumbnailFiles();
+	return(NULL);
+}
+
+//*****************************************************************************
+//*	black and white points, in source pixel units, from the analysis histogram
+//*	the histogram has 256 bins, 16 bit data is binned by the upper 8 bits
+//*****************************************************************************
+void	CameraDriver::GetThumbnailStretch(const int bitDepth, int *blackPoint, int *whitePoint)
+{
+int		ii;
+int		blackIdx;
+int		whiteIdx;
+int		binWidth;
+double	histTotal;
+double	runningCnt;
+
+	histTotal	=	0;
+	for (ii=0; ii<256; ii++)
+	{
+		histTotal	+=	cHistogramLum[ii];
+	}
+	blackIdx	=	0;
+	whiteIdx	=	255;
+	if (histTotal > 0)
+	{
+		blackIdx	=	-1;
+		runningCnt	=	0;
+		for (ii=0; ii<256; ii++)
+		{
+			runningCnt	+=	cHistogramLum[ii];
+			if ((blackIdx < 0) && (runningCnt >= (histTotal * kThumbnail_BlackFraction)))
+			{
+				blackIdx	=	ii;
+			}
+			if (runningCnt >= (histTotal * kThumbnail_WhiteFraction))
+			{
+				whiteIdx	=	ii;
+				break;
+			}
+		}
+		if (blackIdx < 0)
+		{
+			blackIdx	=	0;
+		}
+	}
+	//*	a flat image still needs a usable range
+	if (whiteIdx <= blackIdx)
+	{
+		if (blackIdx >= 255)
+		{
+			blackIdx	=	254;
+		}
+		whiteIdx	=	blackIdx + 1;
+	}
+	binWidth		=	(bitDepth > 8) ? 256 : 1;
+	*blackPoint		=	blackIdx * binWidth;
+	*whitePoint		=	((whiteIdx + 1) * binWidth) - 1;
+}
+
+//*****************************************************************************
+void	CameraDriver::GetThumbnailFilePath(	const char	*fileNameRoot,
+											const char	*suffix,
+											char		*filePath,
+											const int	filePathSize)
+{
+	snprintf(filePath, filePathSize, "%s/%s/%s-%s.jpg", kImageDataDir, kThumbnailDir, fileNameRoot, suffix);
+}
+
+//*****************************************************************************
+//*	called from SaveImageData() after the histogram has been calculated.
+//*	only the stretch of the cached preview is done here, the thumbnail binning
+//*	and the JPEG encoding are done by the thumbnail thread
+//*****************************************************************************
+void	CameraDriver::SaveThumbnails(void)
+{
+#if defined(_ENABLE_JPEGLIB_) || defined(_USE_OPENCV_)
+TYPE_PREVIEW_IMAGE	*preview;
+TYPE_PREVIEW_IMAGE	previewCopy;
+int					sourceWidth;
+int					sourceHeight;
+int					binFactor;
+int					blackPoint;
+int					whitePoint;
+int					lutSize;
+int					ii;
+int					threadErr;
+long				pixelCnt;
+double				fraction;
+unsigned char		*stretchLUT;
+unsigned char		*previewData;
+
+	SETUP_TIMING();
+
+	//*	the last one has to be finished, there is only one job
+	WaitForThumbnailThread();
+
+	sourceWidth		=	cROIinfo.currentROIwidth;
+	sourceHeight	=	cROIinfo.currentROIheight;
+	if ((sourceWidth <= 0) || (sourceHeight <= 0))
+	{
+		sourceWidth		=	cCameraXsize;
+		sourceHeight	=	cCameraYsize;
+	}
+	binFactor	=	ImageBin_FactorForMaxDim(sourceWidth, sourceHeight, kThumbnail_PreviewMaxDim);
+
+	//*	only the copy is made under the mutex, the stretch runs on the copy
+	pthread_mutex_lock(&cPreviewMutex);
+	preview		=	GetPreviewImage(binFactor, false);
+	if (preview == NULL)
+	{
+		pthread_mutex_unlock(&cPreviewMutex);
+		CONSOLE_DEBUG("No preview image, thumbnails not saved");
+		return;
+	}
+	previewCopy				=	*preview;
+	pixelCnt				=	(long)preview->width * preview->height * preview->planes;
+	previewCopy.imageData	=	(uint16_t *)malloc(pixelCnt * sizeof(uint16_t));
+	if (previewCopy.imageData != NULL)
+	{
+		memcpy(previewCopy.imageData, preview->imageData, (pixelCnt * sizeof(uint16_t)));
+	}
+	pthread_mutex_unlock(&cPreviewMutex);
+	preview		=	&previewCopy;
+
+	//*	one lookup table does the black/white points and the curve
+	GetThumbnailStretch(preview->bitDepth, &blackPoint, &whitePoint);
+	lutSize		=	(preview->bitDepth > 8) ? 65536 : 256;
+	stretchLUT	=	(unsigned char *)malloc(lutSize);
+	previewData	=	(unsigned char *)malloc(pixelCnt);
+	if ((stretchLUT != NULL) && (previewData != NULL) && (preview->imageData != NULL))
+	{
+		for (ii=0; ii<lutSize; ii++)
+		{
+			if (ii <= blackPoint)
+			{
+				stretchLUT[ii]	=	0;
+			}
+			else if (ii >= whitePoint)
+			{
+				stretchLUT[ii]	=	255;
+			}
+			else
+			{
+				fraction		=	(double)(ii - blackPoint) / (whitePoint - blackPoint);
+				stretchLUT[ii]	=	(unsigned char)((255.0 * sqrt(fraction)) + 0.5);
+			}
+		}
+		for (ii=0; ii<pixelCnt; ii++)
+		{
+			previewData[ii]	=	stretchLUT[preview->imageData[ii] & (lutSize - 1)];
+		}
+		cThumbnailJob.previewData	=	previewData;
+		cThumbnailJob.width			=	preview->width;
+		cThumbnailJob.height		=	preview->height;
+		cThumbnailJob.planes		=	preview->planes;
+		previewData					=	NULL;
+	}
+	else
+	{
+		CONSOLE_DEBUG("Failed to allocate memory for thumbnails");
+	}
+	if (previewCopy.imageData != NULL)
+	{
+		free(previewCopy.imageData);
+	}
+
+	if (stretchLUT != NULL)
+	{
+		free(stretchLUT);
+	}
+	if (previewData != NULL)
+	{
+		free(previewData);
+	}
+
+	if (cThumbnailJob.previewData != NULL)
+	{
+		strcpy(cThumbnailJob.fileNameRoot, cFileNameRoot);
+		threadErr	=	pthread_create(&cThumbnailJob.threadID, NULL, &ThumbnailThread, this);
+		if (threadErr == 0)
+		{
+			cThumbnailJob.threadActive	=	true;
+		}
+		else
+		{
+			//*	do it here then
+			CONSOLE_DEBUG_W_NUM("Failed to create thumbnail thread, err\t=", threadErr);
+			WriteThumbnailFiles();
+		}
+	}
+	DEBUG_TIMING("Time to stretch thumbnails (ms)\t=");
+#endif	//	defined(_ENABLE_JPEGLIB_) || defined(_USE_OPENCV_)
+}
+
+//*****************************************************************************
+//*	runs on the thumbnail thread, owns cThumbnailJob until it returns
+//*****************************************************************************
+void	CameraDriver::WriteThumbnailFiles(void)
+{
+int					thumbFactor;
+int					thumbWidth;
+int					thumbHeight;
+long				pixelCnt;
+long				ii;
+unsigned char		*thumbData;
+uint16_t			*thumbData16;
+char				filePath[512];
+
+	if (cThumbnailJob.previewData == NULL)
+	{
+		return;
+	}
+	GetThumbnailFilePath(cThumbnailJob.fileNameRoot, "preview", filePath, sizeof(filePath));
+	WriteThumbnailJpeg(	filePath,
+						cThumbnailJob.previewData,
+						cThumbnailJob.width,
+						cThumbnailJob.height,
+						cThumbnailJob.planes);
+
+	//*	the thumbnail is binned from the stretched preview
+	thumbFactor	=	ImageBin_FactorForMaxDim(cThumbnailJob.width, cThumbnailJob.height, kThumbnail_ThumbMaxDim);
+	thumbWidth	=	cThumbnailJob.width / thumbFactor;
+	thumbHeight	=	cThumbnailJob.height / thumbFactor;
+	pixelCnt	=	(long)thumbWidth * thumbHeight * cThumbnailJob.planes;
+	thumbData16	=	(uint16_t *)malloc(pixelCnt * sizeof(uint16_t));
+	thumbData	=	(unsigned char *)malloc(pixelCnt);
+	if ((thumbData16 != NULL) && (thumbData != NULL) &&
+		ImageBin_Downsample(	cThumbnailJob.previewData,
+								cThumbnailJob.width,
+								cThumbnailJob.height,
+								1,
+								cThumbnailJob.planes,
+								thumbFactor,
+								false,
+								thumbData16))
+	{
+		for (ii=0; ii<pixelCnt; ii++)
+		{
+			thumbData[ii]	=	thumbData16[ii];
+		}
+		GetThumbnailFilePath(cThumbnailJob.fileNameRoot, "thumb", filePath, sizeof(filePath));
+		WriteThumbnailJpeg(filePath, thumbData, thumbWidth, thumbHeight, cThumbnailJob.planes);
+	}
+	if (thumbData16 != NULL)
+	{
+		free(thumbData16);
+	}
+	if (thumbData != NULL)
+	{
+		free(thumbData);
+	}
+	free(cThumbnailJob.previewData);
+	cThumbnailJob.previewData	=	NULL;
+}
+
+//*****************************************************************************
+//*	called before the next job is started and from the destructor
+//*****************************************************************************
+void	CameraDriver::WaitForThumbnailThread(void)
+{
+	if (cThumbnailJob.threadActive)
+	{
+		pthread_join(cThumbnailJob.threadID, NULL);
+		cThumbnailJob.threadActive	=	false;
+	}
+}
+
+//*****************************************************************************
+//*	looks for the header in the raw request, returns false if it is not there
+//*****************************************************************************
+static bool	GetHttpHeaderValue(const char *htmlData, const char *headerName, char *valueString, const int maxLen)
+{
+const char	*linePtr;
+const char	*valuePtr;
+int			nameLen;
+int			ccc;
+
+	nameLen	=	strlen(headerName);
+	linePtr	=	htmlData;
+	while ((linePtr != NULL) && (*linePtr != 0))
+	{
+		if ((strncasecmp(linePtr, headerName, nameLen) == 0) && (linePtr[nameLen] == ':'))
+		{
+			valuePtr	=	linePtr + nameLen + 1;
+			while (*valuePtr == 0x20)
+			{
+				valuePtr++;
+			}
+			ccc	=	0;
+			while ((valuePtr[ccc] >= 0x20) && (ccc < (maxLen - 1)))
+			{
+				valueString[ccc]	=	valuePtr[ccc];
+				ccc++;
+			}
+			valueString[ccc]	=	0;
+			return(true);
+		}
+		linePtr	=	strchr(linePtr, '\n');
+		if (linePtr != NULL)
+		{
+			linePtr++;
+		}
+	}
+	return(false);
+}
+
+//*****************************************************************************
+TYPE_ASCOM_STATUS	CameraDriver::Get_Thumbnail(	TYPE_GetPutRequestData	*reqData,
+													char					*alpacaErrMsg,
+													bool					*binaryDataSent)
+{
+TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_Success;
+char				fileNameRoot[kMaxFileNameLen];
+char				sizeString[32];
+char				filePath[kMaxFileNameLen + 64];
+char				eTagString[64];
+char				matchString[128];
+char				httpHeader[512];
+char				*extensionPtr;
+struct stat			fileStatus;
+unsigned char		*fileData;
+FILE				*filePointer;
+long				bytesRead;
+int					bytesWritten;
+
+	if (GetKeyWordArgument(reqData->contentData, "File", fileNameRoot, (sizeof(fileNameRoot) -1)) == false)
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "File not specified");
+		return(alpacaErrCode);
+	}
+	//*	only names out of the image directory, nothing with a path
+	if ((strchr(fileNameRoot, '/') != NULL) || (strstr(fileNameRoot, "..") != NULL))
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Invalid file name");
+		return(alpacaErrCode);
+	}
+
+	//*	strip the extension, .fits.fz has two
+	extensionPtr	=	strrchr(fileNameRoot, '.');
+	if ((extensionPtr != NULL) && (strcasecmp(extensionPtr, ".fz") == 0))
+	{
+		*extensionPtr	=	0;
+		extensionPtr	=	strrchr(fileNameRoot, '.');
+	}
+	if ((extensionPtr != NULL) &&	((strcasecmp(extensionPtr, ".fits") == 0) ||
+									(strcasecmp(extensionPtr, ".fit") == 0) ||
+									(strcasecmp(extensionPtr, ".jpg") == 0) ||
+									(strcasecmp(extensionPtr, ".png") == 0)))
+	{
+		*extensionPtr	=	0;
+	}
+
+	strcpy(sizeString, "thumb");
+	GetKeyWordArgument(reqData->contentData, "Size", sizeString, (sizeof(sizeString) -1));
+	if ((strcasecmp(sizeString, "thumb") != 0) && (strcasecmp(sizeString, "preview") != 0))
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Size must be thumb or preview");
+		return(alpacaErrCode);
+	}
+	GetThumbnailFilePath(	fileNameRoot,
+							((strcasecmp(sizeString, "preview") == 0) ? "preview" : "thumb"),
+							filePath,
+							sizeof(filePath));
+	if (stat(filePath, &fileStatus) != 0)
+	{
+		alpacaErrCode	=	kASCOM_Err_InvalidValue;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "No thumbnail for that file");
+		return(alpacaErrCode);
+	}
+
+	//*	the thumbnails never change once written, time and size is enough
+	sprintf(eTagString, "\"%lx-%lx\"", (long)fileStatus.st_mtime, (long)fileStatus.st_size);
+	if (GetHttpHeaderValue(reqData->htmlData, "If-None-Match", matchString, sizeof(matchString)) &&
+		((strcmp(matchString, eTagString) == 0) || (strcmp(matchString, "*") == 0)))
+	{
+		sprintf(httpHeader,	"HTTP/1.0 304 Not Modified\r\n"
+							"ETag: %s\r\n"
+							"Cache-Control: max-age=86400\r\n"
+							"Server: AlpacaPi\r\n"
+							"\r\n",
+							eTagString);
+		bytesWritten	=	write(reqData->socket, httpHeader, strlen(httpHeader));
+		*binaryDataSent	=	true;
+		return(alpacaErrCode);
+	}
+
+	fileData	=	(unsigned char *)malloc(fileStatus.st_size);
+	filePointer	=	fopen(filePath, "r");
+	if ((fileData != NULL) && (filePointer != NULL))
+	{
+		bytesRead	=	fread(fileData, 1, fileStatus.st_size, filePointer);
+		sprintf(httpHeader,	"HTTP/1.0 200 OK\r\n"
+							"Content-Length: %ld\r\n"
+							"Content-type: image/jpeg\r\n"
+							"ETag: %s\r\n"
+							"Cache-Control: max-age=86400\r\n"
+							"Server: AlpacaPi\r\n"
+							"\r\n",
+							bytesRead,
+							eTagString);
+		bytesWritten	=	write(reqData->socket, httpHeader, strlen(httpHeader));
+		if (bytesWritten > 0)
+		{
+			bytesWritten	=	write(reqData->socket, fileData, bytesRead);
+		}
+		if (bytesWritten <= 0)
+		{
+			CONSOLE_DEBUG("Failed to send thumbnail");
+		}
+		*binaryDataSent	=	true;
+	}
+	else
+	{
+		alpacaErrCode	=	kASCOM_Err_InternalError;
+		GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to read thumbnail");
+	}
+	if (filePointer != NULL)
+	{
+		fclose(filePointer);
+	}
+	if (fileData != NULL)
+	{
+		free(fileData);
+	}
+	return(alpacaErrCode);
+}
+
+#endif	//	_ENABLE_CAMERA_
@@ -223,6 +223,13 @@ class Controller
 												int			*uint32array,
 												int			arrayLength,
 												int			*actualValueCnt);
+				bool	AlpacaGetBinaryData(	const char	*alpacaDevice,
+												const int	alpacaDevNum,
+												const char	*alpacaCmd,
+												const char	*dataString,
+												const char	*expectedContentType,
+												uint8_t		**binaryData,
+												size_t		*binaryLength);
 
 
 		int			cDebugCounter;
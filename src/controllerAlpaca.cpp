@@ -28,6 +28,7 @@
 //*	Jan  9,	2021	<MLS> Added new version of AlpacaGetSupportedActions()
 //*	Jan 10,	2021	<MLS> Added new version of AlpacaSendPutCmdwResponse()
 //*	Jan 12,	2021	<MLS> Added AlpacaGetStringValue()
+//*	Feb 28,	2021	<MLS> Added AlpacaGetBinaryData() for compressed image downloads
 //*****************************************************************************
 
 
@@ -1254,6 +1255,161 @@ int				progressUpdateCnt;
 	return(validData);
 }
 
+//*****************************************************************************
+//*	AlpacaGetBinaryData
+//*		For responses that are not JSON (compressed image data)
+//*		The entire body is read into a malloc'd buffer, the caller has to free it.
+//*		Returns false if the server sent anything other than expectedContentType,
+//*		which is what an older server does (JSON) when it does not know the argument.
+//*****************************************************************************
+bool	Controller::AlpacaGetBinaryData(	const char	*alpacaDevice,
+											const int	alpacaDevNum,
+											const char	*alpacaCmd,
+											const char	*dataString,
+											const char	*expectedContentType,
+											uint8_t		**binaryData,
+											size_t		*binaryLength)
+{
+bool			validData;
+int				socket_desc;
+char			alpacaString[128];
+char			headerBuff[1024];
+char			*bodyPtr;
+char			*contentTypePtr;
+char			*contentLenPtr;
+uint8_t			*dataBuffer;
+size_t			contentLength;
+size_t			bytesInBuffer;
+int				headerLen;
+int				recvByteCnt;
+int				shutDownRetCode;
+int				closeRetCode;
+uint32_t		tStartMillisecs;
+uint32_t		tDeltaMillisecs;
+uint32_t		tLastUpdateMillisecs;
+
+	CONSOLE_DEBUG(__FUNCTION__);
+	validData		=	false;
+	*binaryData		=	NULL;
+	*binaryLength	=	0;
+	tStartMillisecs			=	millis();
+	tLastUpdateMillisecs	=	tStartMillisecs;
+
+	sprintf(alpacaString,	"/api/v1/%s/%d/%s", alpacaDevice, alpacaDevNum, alpacaCmd);
+	socket_desc	=	OpenSocketAndSendRequest(	&cDeviceAddress,
+												cPort,
+												"GET",	//*	must be either GET or PUT
+												alpacaString,
+												dataString);
+	strcpy(cLastAlpacaCmdString, alpacaString);
+	if (socket_desc >= 0)
+	{
+		//*	read until we have the entire http header
+		headerLen	=	0;
+		bodyPtr		=	NULL;
+		recvByteCnt	=	1;
+		while ((bodyPtr == NULL) && (recvByteCnt > 0) && (headerLen < (int)(sizeof(headerBuff) - 1)))
+		{
+			recvByteCnt	=	recv(socket_desc, &headerBuff[headerLen], (sizeof(headerBuff) - 1 - headerLen), MSG_NOSIGNAL);
+			if (recvByteCnt > 0)
+			{
+				headerLen				+=	recvByteCnt;
+				headerBuff[headerLen]	=	0;
+				bodyPtr					=	strstr(headerBuff, "\r\n\r\n");
+			}
+		}
+
+		contentTypePtr	=	NULL;
+		contentLenPtr	=	NULL;
+		if (bodyPtr != NULL)
+		{
+			*bodyPtr		=	0;
+			bodyPtr			+=	4;
+			contentTypePtr	=	strcasestr(headerBuff, "Content-type:");
+			contentLenPtr	=	strcasestr(headerBuff, "Content-Length:");
+		}
+		if ((contentTypePtr != NULL) && (contentLenPtr != NULL) &&
+			(strncasecmp((contentTypePtr + 13 + strspn(contentTypePtr + 13, " ")),
+							expectedContentType,
+							strlen(expectedContentType)) == 0))
+		{
+			contentLength	=	atol(contentLenPtr + 15);
+			dataBuffer		=	(uint8_t *)malloc(contentLength + 1);
+			if ((dataBuffer != NULL) && (contentLength > 0))
+			{
+				//*	whatever came in with the header is the start of the body
+				bytesInBuffer	=	headerLen - (bodyPtr - headerBuff);
+				if (bytesInBuffer > contentLength)
+				{
+					bytesInBuffer	=	contentLength;
+				}
+				memcpy(dataBuffer, bodyPtr, bytesInBuffer);
+				recvByteCnt	=	1;
+				while ((bytesInBuffer < contentLength) && (recvByteCnt > 0))
+				{
+					recvByteCnt	=	recv(socket_desc, &dataBuffer[bytesInBuffer], (contentLength - bytesInBuffer), MSG_NOSIGNAL);
+					if (recvByteCnt > 0)
+					{
+						bytesInBuffer	+=	recvByteCnt;
+					}
+					tDeltaMillisecs	=	millis() - tLastUpdateMillisecs;
+					if (tDeltaMillisecs > 700)
+					{
+						UpdateDownloadProgress((bytesInBuffer / 1024), (contentLength / 1024));
+						tLastUpdateMillisecs	=	millis();
+					}
+				}
+				UpdateDownloadProgress((bytesInBuffer / 1024), (contentLength / 1024));
+				if (bytesInBuffer == contentLength)
+				{
+					*binaryData		=	dataBuffer;
+					*binaryLength	=	contentLength;
+					validData		=	true;
+
+					tDeltaMillisecs				=	millis() - tStartMillisecs;
+					cLastDownload_Bytes			=	contentLength;
+					cLastDownload_Millisecs		=	tDeltaMillisecs;
+					cLastDownload_MegaBytesPerSec	=	0.0;
+					if (tDeltaMillisecs > 0)
+					{
+						cLastDownload_MegaBytesPerSec	=	(1000.0 * contentLength) / tDeltaMillisecs;
+					}
+				}
+				else
+				{
+					CONSOLE_DEBUG_W_NUM("Short read, bytesInBuffer\t=", (int)bytesInBuffer);
+					free(dataBuffer);
+				}
+			}
+			else if (dataBuffer != NULL)
+			{
+				free(dataBuffer);
+			}
+		}
+		else
+		{
+			CONSOLE_DEBUG_W_STR("Binary data not returned for", alpacaString);
+		}
+
+		shutDownRetCode	=	shutdown(socket_desc, SHUT_RDWR);
+		if (shutDownRetCode != 0)
+		{
+			CONSOLE_DEBUG_W_NUM("shutDownRetCode\t=", shutDownRetCode);
+		}
+		closeRetCode	=	close(socket_desc);
+		if (closeRetCode != 0)
+		{
+			CONSOLE_DEBUG("Close error");
+		}
+	}
+	else
+	{
+		CONSOLE_DEBUG("Failed");
+		cReadFailureCnt++;
+	}
+	return(validData);
+}
+
 //*****************************************************************************
 int	Controller::AlpacaCheckForErrors(	SJP_Parser_t	*jsonParser,
 										char			*errorMsg,
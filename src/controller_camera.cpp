@@ -46,6 +46,7 @@
 //*	Jan 15,	2021	<MLS> Added DownloadImage_rgbarray() & DownloadImage_imagearray()
 //*	Jan 16,	2021	<MLS> Now able to download monochrome image using "imagearray"
 //*	Jan 17,	2021	<MLS> Changed  UpdateReadAllStatus() to UpdateSupportedActions()
+//*	Feb 28,	2021	<MLS> Added DownloadImage_compressed(), uses Rice compression if the server has it
 //*****************************************************************************
 //*
 //*	todo
@@ -74,6 +75,7 @@
 #include	"sendrequest_lib.h"
 
 #include	"alpaca_defs.h"
+#include	"imagecompress.h"
 
 #define	_DEBUG_TIMING_
 #define _ENABLE_CONSOLE_DEBUG_
@@ -136,6 +138,7 @@ int		iii;
 	cHas_livemode			=	false;
 	cHas_rgbarray			=	false;
 	cHas_sidebar			=	false;
+	cHas_imagecompression	=	false;
 
 	cReadData8Bit			=	false;
 
@@ -913,6 +916,12 @@ void	ControllerCamera::AlpacaProcessReadAll(	const char	*deviceTypeStr,
 		cGain	=	atoi(valueString);
 		UpdateCameraGain();
 	}
+	else if (strcasecmp(keywordString, "imagecompression") == 0)
+	{
+		//=================================================================================
+		//*	compressed imagearray downloads
+		cHas_imagecompression	=	(strcasecmp(valueString, "rice") == 0);
+	}
 	else if (strcasecmp(keywordString, "imageready") == 0)
 	{
 		//=================================================================================
@@ -1717,6 +1726,97 @@ int			thePixValue;
 	return(myOpenCVimage);
 }
 
+//*****************************************************************************
+//*	imagearray with Compression=rice, the data comes back as one binary block
+//*	in row order (not X first like the JSON imagearray) and at the native bit depth
+//*****************************************************************************
+IplImage	*ControllerCamera::DownloadImage_compressed(void)
+{
+IplImage				*myOpenCVimage	=	NULL;
+TYPE_COMPRESS_HEADER	compHeader;
+bool					validData;
+uint8_t					*compData;
+size_t					compLen;
+uint8_t					*imageData;
+uint8_t					*rowPtr;
+int						xxx;
+int						yyy;
+int						ppp;
+int						thePixValue;
+size_t					srcIdx;
+
+	CONSOLE_DEBUG(__FUNCTION__);
+
+	compData	=	NULL;
+	compLen		=	0;
+	SETUP_TIMING();
+	validData	=	AlpacaGetBinaryData(	"camera",
+											cAlpacaDevNum,
+											"imagearray",
+											"Compression=rice",
+											kImageCompress_ContentType,
+											&compData,
+											&compLen);
+	DEBUG_TIMING("Compressed image downloading (ms)");
+	if (validData && ImageCompress_GetHeader(compData, compLen, &compHeader))
+	{
+		imageData	=	(uint8_t *)malloc(compHeader.rawLength);
+		if (imageData != NULL)
+		{
+			START_TIMING();
+			if (ImageCompress_Decode(compData, compLen, imageData, compHeader.rawLength))
+			{
+				DEBUG_TIMING("Image decompression (ms)");
+				myOpenCVimage	=	cvCreateImage(cvSize(compHeader.width, compHeader.height), IPL_DEPTH_8U, 3);
+			}
+			else
+			{
+				CONSOLE_DEBUG("Failed to decompress image");
+			}
+			if (myOpenCVimage != NULL)
+			{
+				//*	move the image data into the openCV image structure
+				srcIdx	=	0;
+				for (yyy=0; yyy<myOpenCVimage->height; yyy++)
+				{
+					rowPtr	=	(uint8_t *)myOpenCVimage->imageData + (yyy * myOpenCVimage->widthStep);
+					for (xxx=0; xxx<myOpenCVimage->width; xxx++)
+					{
+						for (ppp=0; ppp<3; ppp++)
+						{
+							if (compHeader.bytesPerSample == 2)
+							{
+								thePixValue	=	((uint16_t *)imageData)[srcIdx] >> 8;
+							}
+							else
+							{
+								thePixValue	=	imageData[srcIdx];
+							}
+							*rowPtr++	=	thePixValue;
+							//*	mono is copied to all 3 colors, RGB24 is already BGR
+							if ((compHeader.planes == 3) || (ppp == 2))
+							{
+								srcIdx++;
+							}
+						}
+					}
+				}
+				CONSOLE_DEBUG_W_NUM("Compression ratio x100	=", (int)((100.0 * compHeader.rawLength) / compLen));
+			}
+			free(imageData);
+		}
+		else
+		{
+			CONSOLE_DEBUG("Failed to allocate image buffer");
+		}
+	}
+	if (compData != NULL)
+	{
+		free(compData);
+	}
+	return(myOpenCVimage);
+}
+
 //*****************************************************************************
 IplImage	*ControllerCamera::DownloadImage(const bool force8BitRead)
 {
@@ -1727,6 +1827,12 @@ IplImage	*myOpenCVimage	=	NULL;
 //		myOpenCVimage	=	DownloadImage_rgbarray();
 //	}
 //	else
+	if (cHas_imagecompression)
+	{
+		//*	if it fails for any reason, fall back to the JSON imagearray
+		myOpenCVimage	=	DownloadImage_compressed();
+	}
+	if (myOpenCVimage == NULL)
 	{
 		myOpenCVimage	=	DownloadImage_imagearray(force8BitRead);
 	}
@@ -147,6 +147,7 @@ class ControllerCamera: public Controller
 				IplImage	*DownloadImage(const bool force8BitRead = false);
 				IplImage	*DownloadImage_rgbarray(void);
 				IplImage	*DownloadImage_imagearray(const bool force8BitRead = false);
+				IplImage	*DownloadImage_compressed(void);
 
 				//*	download options
 				bool					cReadData8Bit;
@@ -180,6 +181,7 @@ class ControllerCamera: public Controller
 				bool					cHas_livemode;
 				bool					cHas_rgbarray;
 				bool					cHas_sidebar;
+				bool					cHas_imagecompression;		//*	imagearray can be sent Rice compressed
 
 				//==========================================================
 				//*	File name information
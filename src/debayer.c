@@ -0,0 +1,805 @@
+//**************************************************************************
+//*	Name:			debayer.c
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Native debayer (demosaic) of RAW8/RAW16 color sensor data
+//*
+//*					This removes the need for the vendor RGB24 mode (which throws
+//*					away bit depth) or OpenCV just to get a color image.
+//*
+//*					It is done in 2 passes
+//*						1) a full resolution green plane is built
+//*						2) red and blue are filled in and the output is written
+//*
+//*					Bilinear:	plain average of the nearest samples of each color
+//*					Edge aware:	green is interpolated along the direction with the
+//*								smaller gradient (Hamilton-Adams), red and blue are
+//*								interpolated as color differences from green, which
+//*								keeps the colored fringes off of stars and edges
+//*
+//*					Both methods share the same code, bilinear is the edge aware code
+//*					with the green correction terms multiplied by 0.
+//*
+//*					The rows are split up into bands and each band runs on its own thread.
+//*					The interior of each row is done by a row kernel with no branches
+//*					(selects only) so the compiler can vectorize it, the Makefile builds
+//*					this file with $(VECTORFLAGS). The border pixels use the per pixel
+//*					helpers with the mirrored coordinates.
+//*					RAW8 is widened to 16 bits first so there is only one kernel.
+//*
+//*					Debayer_Image() writes 8 bits per color, Debayer_Image16() keeps
+//*					the full 16 bits (RAW8 comes out as 0-255) for code that does
+//*					its own scaling later, like live stacking.
+//*
+//*	Limitations:	The bayer pattern is assumed to start at pixel 0,0 of the data
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb  9,	2021	<MLS> Created debayer.c
+//*	Feb  9,	2021	<MLS> Added bilinear and edge aware methods
+//*	Feb 10,	2021	<MLS> Rows are now split across threads
+//*	Mar 30,	2021	<MLS> Added GreenRowInterior() and ColorRowInterior(), they vectorize at -O3
+//*	Mar 30,	2021	<MLS> RAW8 is widened to 16 bits, Sample() no longer has a branch
+//*	Mar 30,	2021	<MLS> Added Debayer_Image16(), 16 bit output
+//*****************************************************************************
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<unistd.h>
+#include	<pthread.h>
+
+#define _ENABLE_CONSOLE_DEBUG_
+#include	"ConsoleDebug.h"
+
+#include	"debayer.h"
+
+#define	kDebayer_MinRowsPerThread	32
+
+//*****************************************************************************
+//*	pixel types within the bayer cell
+enum
+{
+	kPixel_Red	=	0,
+	kPixel_Blue,
+	kPixel_GreenRedRow,
+	kPixel_GreenBlueRow
+};
+
+//*****************************************************************************
+typedef struct
+{
+	const uint16_t		*src16;			//*	RAW8 has been widened
+	uint16_t			*greenPlane;
+	uint16_t			*cellRow;		//*	one row each, per thread, for pass 2
+	uint16_t			*otherRow;
+	unsigned char		*outputData;
+	uint16_t			*outputData16;	//*	Debayer_Image16(), outputData is NULL then
+	int					width;
+	int					height;
+	int					redX;			//*	location of red in the 2x2 cell
+	int					redY;
+	int					edgeAware;		//*	1 = edge aware, 0 = bilinear
+	int					maxValue;
+	int					outputShift;
+	int					redOffset;		//*	byte offset in the output pixel
+	int					blueOffset;
+	int					pass;
+	int					rowStart;
+	int					rowEnd;
+} TYPE_DEBAYER_JOB;
+
+
+//*****************************************************************************
+static inline int	Sample(const TYPE_DEBAYER_JOB *job, const int xxx, const int yyy)
+{
+	return(job->src16[((long)yyy * job->width) + xxx]);
+}
+
+//*****************************************************************************
+static inline int	Green(const TYPE_DEBAYER_JOB *job, const int xxx, const int yyy)
+{
+	return(job->greenPlane[((long)yyy * job->width) + xxx]);
+}
+
+//*****************************************************************************
+static inline int	ClampValue(const int value, const int maxValue)
+{
+	if (value < 0)
+	{
+		return(0);
+	}
+	if (value > maxValue)
+	{
+		return(maxValue);
+	}
+	return(value);
+}
+
+//*****************************************************************************
+static inline int	AbsValue(const int value)
+{
+	return((value < 0) ? -value : value);
+}
+
+//*****************************************************************************
+//*	reflects around the edge, this keeps the bayer parity of the coordinate
+//*****************************************************************************
+static inline int	Mirror(const int value, const int limit)
+{
+	if (value < 0)
+	{
+		return(-value);
+	}
+	if (value >= limit)
+	{
+		return((2 * (limit - 1)) - value);
+	}
+	return(value);
+}
+
+//*****************************************************************************
+static inline int	PixelType(const TYPE_DEBAYER_JOB *job, const int xxx, const int yyy)
+{
+bool	redRow;
+bool	redCol;
+
+	redRow	=	((yyy & 1) == job->redY);
+	redCol	=	((xxx & 1) == job->redX);
+	if (redRow)
+	{
+		return(redCol ? kPixel_Red : kPixel_GreenRedRow);
+	}
+	return(redCol ? kPixel_GreenBlueRow : kPixel_Blue);
+}
+
+//*****************************************************************************
+//*	green at a red or blue location
+//*	the coordinates of the neighbors are passed in so the same code can be used
+//*	for the edges (mirrored) and for the interior
+//*****************************************************************************
+static inline int	InterpolateGreen(	const TYPE_DEBAYER_JOB *job,
+										const int xm2, const int xm1, const int xxx, const int xp1, const int xp2,
+										const int ym2, const int ym1, const int yyy, const int yp1, const int yp2)
+{
+int		center;
+int		gradH;
+int		gradV;
+int		lapH;
+int		lapV;
+int		greenH;
+int		greenV;
+int		greenValue;
+
+	center	=	Sample(job, xxx, yyy);
+	greenH	=	Sample(job, xm1, yyy) + Sample(job, xp1, yyy);
+	greenV	=	Sample(job, xxx, ym1) + Sample(job, xxx, yp1);
+	if (job->edgeAware)
+	{
+		lapH	=	(2 * center) - Sample(job, xm2, yyy) - Sample(job, xp2, yyy);
+		lapV	=	(2 * center) - Sample(job, xxx, ym2) - Sample(job, xxx, yp2);
+		gradH	=	AbsValue(Sample(job, xm1, yyy) - Sample(job, xp1, yyy)) + AbsValue(lapH);
+		gradV	=	AbsValue(Sample(job, xxx, ym1) - Sample(job, xxx, yp1)) + AbsValue(lapV);
+		//*	4 * the value for each direction
+		greenH	=	(2 * greenH) + lapH;
+		greenV	=	(2 * greenV) + lapV;
+		if (gradH < gradV)
+		{
+			greenValue	=	greenH / 4;
+		}
+		else if (gradV < gradH)
+		{
+			greenValue	=	greenV / 4;
+		}
+		else
+		{
+			greenValue	=	(greenH + greenV) / 8;
+		}
+	}
+	else
+	{
+		greenValue	=	(greenH + greenV) / 4;
+	}
+	return(ClampValue(greenValue, job->maxValue));
+}
+
+//*****************************************************************************
+static inline void	GreenPixel(const TYPE_DEBAYER_JOB *job, const int xxx, const int yyy, const bool mirror)
+{
+int		pixelType;
+int		greenValue;
+
+	pixelType	=	PixelType(job, xxx, yyy);
+	if ((pixelType == kPixel_Red) || (pixelType == kPixel_Blue))
+	{
+		if (mirror)
+		{
+			greenValue	=	InterpolateGreen(job,
+								Mirror(xxx - 2, job->width),	Mirror(xxx - 1, job->width),	xxx,
+								Mirror(xxx + 1, job->width),	Mirror(xxx + 2, job->width),
+								Mirror(yyy - 2, job->height),	Mirror(yyy - 1, job->height),	yyy,
+								Mirror(yyy + 1, job->height),	Mirror(yyy + 2, job->height));
+		}
+		else
+		{
+			greenValue	=	InterpolateGreen(job,	xxx - 2, xxx - 1, xxx, xxx + 1, xxx + 2,
+													yyy - 2, yyy - 1, yyy, yyy + 1, yyy + 2);
+		}
+	}
+	else
+	{
+		greenValue	=	Sample(job, xxx, yyy);
+	}
+	job->greenPlane[((long)yyy * job->width) + xxx]	=	greenValue;
+}
+
+//*****************************************************************************
+//*	average of the color difference (sample - green) of 2 neighbors,
+//*	for bilinear edgeAware is 0 and this is the plain average
+//*****************************************************************************
+static inline int	Average2(	const TYPE_DEBAYER_JOB *job,
+								const int x1, const int y1,
+								const int x2, const int y2)
+{
+int		sum;
+
+	sum	=	Sample(job, x1, y1) + Sample(job, x2, y2);
+	sum	-=	job->edgeAware * (Green(job, x1, y1) + Green(job, x2, y2));
+	return(sum / 2);
+}
+
+//*****************************************************************************
+static inline int	Average4(	const TYPE_DEBAYER_JOB *job,
+								const int xm1, const int xp1,
+								const int ym1, const int yp1)
+{
+int		sum;
+
+	sum	=	Sample(job, xm1, ym1) + Sample(job, xp1, ym1) +
+			Sample(job, xm1, yp1) + Sample(job, xp1, yp1);
+	sum	-=	job->edgeAware * (	Green(job, xm1, ym1) + Green(job, xp1, ym1) +
+								Green(job, xm1, yp1) + Green(job, xp1, yp1));
+	return(sum / 4);
+}
+
+//*****************************************************************************
+static inline void	ColorPixel(	const TYPE_DEBAYER_JOB *job,
+								const int xm1, const int xxx, const int xp1,
+								const int ym1, const int yyy, const int yp1)
+{
+int				greenValue;
+int				greenBase;
+int				redValue;
+int				blueValue;
+unsigned char	*outPtr;
+uint16_t		*outPtr16;
+
+	greenValue	=	Green(job, xxx, yyy);
+	greenBase	=	job->edgeAware * greenValue;
+	switch(PixelType(job, xxx, yyy))
+	{
+		case kPixel_Red:
+			redValue	=	Sample(job, xxx, yyy);
+			blueValue	=	greenBase + Average4(job, xm1, xp1, ym1, yp1);
+			break;
+
+		case kPixel_Blue:
+			blueValue	=	Sample(job, xxx, yyy);
+			redValue	=	greenBase + Average4(job, xm1, xp1, ym1, yp1);
+			break;
+
+		case kPixel_GreenRedRow:
+			redValue	=	greenBase + Average2(job, xm1, yyy, xp1, yyy);
+			blueValue	=	greenBase + Average2(job, xxx, ym1, xxx, yp1);
+			break;
+
+		case kPixel_GreenBlueRow:
+		default:
+			blueValue	=	greenBase + Average2(job, xm1, yyy, xp1, yyy);
+			redValue	=	greenBase + Average2(job, xxx, ym1, xxx, yp1);
+			break;
+	}
+	if (job->outputData16 != NULL)
+	{
+		outPtr16					=	job->outputData16 + ((((long)yyy * job->width) + xxx) * 3);
+		outPtr16[job->redOffset]	=	ClampValue(redValue, job->maxValue);
+		outPtr16[1]					=	greenValue;
+		outPtr16[job->blueOffset]	=	ClampValue(blueValue, job->maxValue);
+	}
+	else
+	{
+		outPtr						=	job->outputData + ((((long)yyy * job->width) + xxx) * 3);
+		outPtr[job->redOffset]		=	ClampValue(redValue, job->maxValue) >> job->outputShift;
+		outPtr[1]					=	greenValue >> job->outputShift;
+		outPtr[job->blueOffset]		=	ClampValue(blueValue, job->maxValue) >> job->outputShift;
+	}
+}
+
+//*****************************************************************************
+//*	pass 1 for the interior of a row (xxx = 2 .. width - 3, yyy = 2 .. height - 3),
+//*	same math as GreenPixel()/InterpolateGreen(). Every pixel is interpolated and
+//*	the green ones are selected back, that keeps the loop free of branches
+//*****************************************************************************
+static void	GreenRowInterior(const TYPE_DEBAYER_JOB *job, const int yyy)
+{
+const uint16_t	*rowM2;
+const uint16_t	*rowM1;
+const uint16_t	*row00;
+const uint16_t	*rowP1;
+const uint16_t	*rowP2;
+uint16_t		*greenRow;
+int				width;
+int				greenParity;
+int				edgeAware;
+int				maxValue;
+int				xxx;
+int				center;
+int				greenH;
+int				greenV;
+int				lapH;
+int				lapV;
+int				gradH;
+int				gradV;
+int				edgeValue;
+int				greenValue;
+
+	width		=	job->width;
+	row00		=	job->src16 + ((long)yyy * width);
+	rowM1		=	row00 - width;
+	rowM2		=	rowM1 - width;
+	rowP1		=	row00 + width;
+	rowP2		=	rowP1 + width;
+	greenRow	=	job->greenPlane + ((long)yyy * width);
+	edgeAware	=	job->edgeAware;
+	maxValue	=	job->maxValue;
+	//*	the column parity of the green samples on this row
+	greenParity	=	((yyy & 1) == job->redY) ? (job->redX ^ 1) : job->redX;
+
+	for (xxx=2; xxx<(width - 2); xxx++)
+	{
+		center		=	row00[xxx];
+		greenH		=	row00[xxx - 1] + row00[xxx + 1];
+		greenV		=	rowM1[xxx] + rowP1[xxx];
+		lapH		=	(2 * center) - row00[xxx - 2] - row00[xxx + 2];
+		lapV		=	(2 * center) - rowM2[xxx] - rowP2[xxx];
+		gradH		=	abs(row00[xxx - 1] - row00[xxx + 1]) + abs(lapH);
+		gradV		=	abs(rowM1[xxx] - rowP1[xxx]) + abs(lapV);
+		greenH		=	(2 * greenH) + lapH;
+		greenV		=	(2 * greenV) + lapV;
+		edgeValue	=	(gradH < gradV) ? (greenH / 4) : ((gradV < gradH) ? (greenV / 4) : ((greenH + greenV) / 8));
+		greenValue	=	edgeAware ? edgeValue : ((row00[xxx - 1] + row00[xxx + 1] + rowM1[xxx] + rowP1[xxx]) / 4);
+		greenValue	=	(greenValue < 0) ? 0 : ((greenValue > maxValue) ? maxValue : greenValue);
+		greenRow[xxx]	=	((xxx & 1) == greenParity) ? center : greenValue;
+	}
+}
+
+//*****************************************************************************
+//*	pass 2 for the interior of a row (xxx = 1 .. width - 2, yyy = 1 .. height - 2),
+//*	same math as ColorPixel(). On a red row the cell color is red, on a blue row
+//*	it is blue, the other color comes from the diagonals or the column.
+//*	cellColumn is 0 or 1 and the values are blended with it, a ?: here ends up as
+//*	control flow and the loop does not vectorize
+//*****************************************************************************
+static void	ColorRowPlanes(	const TYPE_DEBAYER_JOB		*job,
+							const int					yyy,
+							uint16_t *__restrict__		cellRow,
+							uint16_t *__restrict__		otherRow)
+{
+const uint16_t	*rowM1;
+const uint16_t	*row00;
+const uint16_t	*rowP1;
+const uint16_t	*greenM1;
+const uint16_t	*green00;
+const uint16_t	*greenP1;
+int				width;
+int				cellParity;
+int				edgeAware;
+int				maxValue;
+int				xxx;
+int				greenBase;
+int				diagValue;
+int				horzValue;
+int				vertValue;
+int				cellValue;
+int				otherValue;
+int				cellColumn;
+
+	width		=	job->width;
+	row00		=	job->src16 + ((long)yyy * width);
+	rowM1		=	row00 - width;
+	rowP1		=	row00 + width;
+	green00		=	job->greenPlane + ((long)yyy * width);
+	greenM1		=	green00 - width;
+	greenP1		=	green00 + width;
+	edgeAware	=	job->edgeAware;
+	maxValue	=	job->maxValue;
+	cellParity	=	((yyy & 1) == job->redY) ? job->redX : (job->redX ^ 1);
+
+	for (xxx=1; xxx<(width - 1); xxx++)
+	{
+		greenBase	=	edgeAware * green00[xxx];
+		diagValue	=	greenBase + ((rowM1[xxx - 1] + rowM1[xxx + 1] + rowP1[xxx - 1] + rowP1[xxx + 1] -
+									(edgeAware * (greenM1[xxx - 1] + greenM1[xxx + 1] + greenP1[xxx - 1] + greenP1[xxx + 1]))) / 4);
+		horzValue	=	greenBase + ((row00[xxx - 1] + row00[xxx + 1] - (edgeAware * (green00[xxx - 1] + green00[xxx + 1]))) / 2);
+		vertValue	=	greenBase + ((rowM1[xxx] + rowP1[xxx] - (edgeAware * (greenM1[xxx] + greenP1[xxx]))) / 2);
+		cellColumn	=	((xxx & 1) == cellParity);
+		cellValue	=	horzValue + (cellColumn * (row00[xxx] - horzValue));
+		otherValue	=	vertValue + (cellColumn * (diagValue - vertValue));
+		cellRow[xxx]	=	(cellValue < 0) ? 0 : ((cellValue > maxValue) ? maxValue : cellValue);
+		otherRow[xxx]	=	(otherValue < 0) ? 0 : ((otherValue > maxValue) ? maxValue : otherValue);
+	}
+}
+
+//*****************************************************************************
+//*	interleaves the 3 planes into the 8 bit output row
+//*****************************************************************************
+static void	InterleaveRow(	unsigned char *__restrict__		outRow,
+							const uint16_t *__restrict__	firstRow,
+							const uint16_t *__restrict__	greenRow,
+							const uint16_t *__restrict__	lastRow,
+							const int						xStart,
+							const int						xEnd,
+							const int						outputShift)
+{
+int		xxx;
+
+	for (xxx=xStart; xxx<xEnd; xxx++)
+	{
+		outRow[(xxx * 3)]		=	firstRow[xxx] >> outputShift;
+		outRow[(xxx * 3) + 1]	=	greenRow[xxx] >> outputShift;
+		outRow[(xxx * 3) + 2]	=	lastRow[xxx] >> outputShift;
+	}
+}
+
+//*****************************************************************************
+//*	same as InterleaveRow(), for the 16 bit output
+//*****************************************************************************
+static void	InterleaveRow16(uint16_t *__restrict__			outRow,
+							const uint16_t *__restrict__	firstRow,
+							const uint16_t *__restrict__	greenRow,
+							const uint16_t *__restrict__	lastRow,
+							const int						xStart,
+							const int						xEnd)
+{
+int		xxx;
+
+	for (xxx=xStart; xxx<xEnd; xxx++)
+	{
+		outRow[(xxx * 3)]		=	firstRow[xxx];
+		outRow[(xxx * 3) + 1]	=	greenRow[xxx];
+		outRow[(xxx * 3) + 2]	=	lastRow[xxx];
+	}
+}
+
+//*****************************************************************************
+static void	ColorRowInterior(const TYPE_DEBAYER_JOB *job, const int yyy)
+{
+bool	cellColorFirst;
+
+	ColorRowPlanes(job, yyy, job->cellRow, job->otherRow);
+	if ((yyy & 1) == job->redY)
+	{
+		cellColorFirst	=	(job->redOffset == 0);
+	}
+	else
+	{
+		cellColorFirst	=	(job->blueOffset == 0);
+	}
+	if (job->outputData16 != NULL)
+	{
+		InterleaveRow16(job->outputData16 + ((long)yyy * job->width * 3),
+						(cellColorFirst ? job->cellRow : job->otherRow),
+						job->greenPlane + ((long)yyy * job->width),
+						(cellColorFirst ? job->otherRow : job->cellRow),
+						1,
+						(job->width - 1));
+	}
+	else
+	{
+		InterleaveRow(	job->outputData + ((long)yyy * job->width * 3),
+						(cellColorFirst ? job->cellRow : job->otherRow),
+						job->greenPlane + ((long)yyy * job->width),
+						(cellColorFirst ? job->otherRow : job->cellRow),
+						1,
+						(job->width - 1),
+						job->outputShift);
+	}
+}
+
+//*****************************************************************************
+static void	ProcessRows(TYPE_DEBAYER_JOB *job)
+{
+int		xxx;
+int		yyy;
+int		width;
+int		height;
+bool	edgeRow;
+
+	width	=	job->width;
+	height	=	job->height;
+	for (yyy=job->rowStart; yyy<job->rowEnd; yyy++)
+	{
+		if (job->pass == 1)
+		{
+			edgeRow	=	(yyy < 2) || (yyy >= (height - 2));
+			if (edgeRow)
+			{
+				for (xxx=0; xxx<width; xxx++)
+				{
+					GreenPixel(job, xxx, yyy, true);
+				}
+			}
+			else
+			{
+				GreenPixel(job, 0,				yyy, true);
+				GreenPixel(job, 1,				yyy, true);
+				GreenRowInterior(job, yyy);
+				GreenPixel(job, (width - 2),	yyy, true);
+				GreenPixel(job, (width - 1),	yyy, true);
+			}
+		}
+		else
+		{
+			edgeRow	=	(yyy < 1) || (yyy >= (height - 1));
+			if (edgeRow)
+			{
+				for (xxx=0; xxx<width; xxx++)
+				{
+					ColorPixel(job,	Mirror(xxx - 1, width),		xxx,	Mirror(xxx + 1, width),
+									Mirror(yyy - 1, height),	yyy,	Mirror(yyy + 1, height));
+				}
+			}
+			else
+			{
+				ColorPixel(job,	1,	0,	1,	yyy - 1,	yyy,	yyy + 1);
+				ColorRowInterior(job, yyy);
+				ColorPixel(job,	(width - 2),	(width - 1),	(width - 2),	yyy - 1,	yyy,	yyy + 1);
+			}
+		}
+	}
+}
+
+//*****************************************************************************
+static void	*DebayerThread(void *arg)
+{
+	ProcessRows((TYPE_DEBAYER_JOB *)arg);
+	return(NULL);
+}
+
+//*****************************************************************************
+//*	runs one pass with the rows split up between threads,
+//*	the calling thread does the first band
+//*****************************************************************************
+static void	RunPass(TYPE_DEBAYER_JOB *jobList, const int threadCnt, const int pass)
+{
+pthread_t	threadID[kDebayer_MaxThreads];
+bool		threadOK[kDebayer_MaxThreads];
+int			ii;
+
+	for (ii=0; ii<threadCnt; ii++)
+	{
+		jobList[ii].pass	=	pass;
+		threadOK[ii]		=	false;
+	}
+	for (ii=1; ii<threadCnt; ii++)
+	{
+		threadOK[ii]	=	(pthread_create(&threadID[ii], NULL, &DebayerThread, &jobList[ii]) == 0);
+		if (threadOK[ii] == false)
+		{
+			//*	do it ourselves
+			ProcessRows(&jobList[ii]);
+		}
+	}
+	ProcessRows(&jobList[0]);
+	for (ii=1; ii<threadCnt; ii++)
+	{
+		if (threadOK[ii])
+		{
+			pthread_join(threadID[ii], NULL);
+		}
+	}
+}
+
+//*****************************************************************************
+//*	one of outputData and outputData16 is used, the other is NULL
+//*****************************************************************************
+static bool	DebayerRawData(	const void			*rawData,
+							const int			width,
+							const int			height,
+							const int			bytesPerPixel,
+							const int			bayerPattern,
+							TYPE_DEBAYER_METHOD	method,
+							const bool			bgrOrder,
+							unsigned char		*outputData,
+							uint16_t			*outputData16)
+{
+TYPE_DEBAYER_JOB	jobList[kDebayer_MaxThreads];
+uint16_t			*greenPlane;
+uint16_t			*widened;
+uint16_t			*rowBuffers;
+const uint8_t		*src8;
+long				pixelCnt;
+long				pixelIdx;
+int					threadCnt;
+int					rowsPerThread;
+int					ii;
+long				cpuCnt;
+
+	if ((rawData == NULL) || ((outputData == NULL) && (outputData16 == NULL)) || (width < 4) || (height < 4) ||
+		((bytesPerPixel != 1) && (bytesPerPixel != 2)))
+	{
+		return(false);
+	}
+	greenPlane	=	(uint16_t *)malloc((long)width * height * sizeof(uint16_t));
+	if (greenPlane == NULL)
+	{
+		CONSOLE_DEBUG("Failed to allocate green plane");
+		return(false);
+	}
+
+	cpuCnt		=	sysconf(_SC_NPROCESSORS_ONLN);
+	threadCnt	=	height / kDebayer_MinRowsPerThread;
+	if (threadCnt > cpuCnt)
+	{
+		threadCnt	=	cpuCnt;
+	}
+	if (threadCnt > kDebayer_MaxThreads)
+	{
+		threadCnt	=	kDebayer_MaxThreads;
+	}
+	if (threadCnt < 1)
+	{
+		threadCnt	=	1;
+	}
+	//*	keep the bands an even number of rows
+	rowsPerThread	=	((height / threadCnt) + 1) & ~1;
+
+	memset(&jobList[0], 0, sizeof(TYPE_DEBAYER_JOB));
+	widened	=	NULL;
+	if (bytesPerPixel == 2)
+	{
+		jobList[0].src16		=	(const uint16_t *)rawData;
+		jobList[0].maxValue		=	0xffff;
+		jobList[0].outputShift	=	8;
+	}
+	else
+	{
+		//*	RAW8 goes through the same 16 bit kernels
+		pixelCnt	=	(long)width * height;
+		widened		=	(uint16_t *)malloc(pixelCnt * sizeof(uint16_t));
+		if (widened == NULL)
+		{
+			CONSOLE_DEBUG("Failed to allocate 16 bit copy");
+			free(greenPlane);
+			return(false);
+		}
+		src8	=	(const uint8_t *)rawData;
+		for (pixelIdx=0; pixelIdx<pixelCnt; pixelIdx++)
+		{
+			widened[pixelIdx]	=	src8[pixelIdx];
+		}
+		jobList[0].src16		=	widened;
+		jobList[0].maxValue		=	0xff;
+		jobList[0].outputShift	=	0;
+	}
+	jobList[0].greenPlane	=	greenPlane;
+	jobList[0].outputData	=	outputData;
+	jobList[0].outputData16	=	outputData16;
+	jobList[0].width		=	width;
+	jobList[0].height		=	height;
+	jobList[0].edgeAware	=	(method == kDebayer_EdgeAware) ? 1 : 0;
+	jobList[0].redOffset	=	bgrOrder ? 2 : 0;
+	jobList[0].blueOffset	=	bgrOrder ? 0 : 2;
+	switch(bayerPattern)
+	{
+		case kDebayer_BGGR:	jobList[0].redX	=	1;	jobList[0].redY	=	1;	break;
+		case kDebayer_GRBG:	jobList[0].redX	=	1;	jobList[0].redY	=	0;	break;
+		case kDebayer_GBRG:	jobList[0].redX	=	0;	jobList[0].redY	=	1;	break;
+		case kDebayer_RGGB:
+		default:			jobList[0].redX	=	0;	jobList[0].redY	=	0;	break;
+	}
+
+	rowBuffers	=	(uint16_t *)malloc((long)threadCnt * 2 * width * sizeof(uint16_t));
+	if (rowBuffers == NULL)
+	{
+		CONSOLE_DEBUG("Failed to allocate row buffers");
+		free(greenPlane);
+		if (widened != NULL)
+		{
+			free(widened);
+		}
+		return(false);
+	}
+	for (ii=0; ii<threadCnt; ii++)
+	{
+		jobList[ii]				=	jobList[0];
+		jobList[ii].cellRow		=	rowBuffers + ((long)ii * 2 * width);
+		jobList[ii].otherRow	=	jobList[ii].cellRow + width;
+		jobList[ii].rowStart	=	ii * rowsPerThread;
+		jobList[ii].rowEnd		=	(ii + 1) * rowsPerThread;
+		if ((ii == (threadCnt - 1)) || (jobList[ii].rowEnd > height))
+		{
+			jobList[ii].rowEnd	=	height;
+		}
+		if (jobList[ii].rowStart > height)
+		{
+			jobList[ii].rowStart	=	height;
+		}
+	}
+
+	//*	the color pass needs the green rows above and below each band,
+	//*	so all of the green has to be finished first
+	RunPass(jobList, threadCnt, 1);
+	RunPass(jobList, threadCnt, 2);
+
+	free(rowBuffers);
+	free(greenPlane);
+	if (widened != NULL)
+	{
+		free(widened);
+	}
+	return(true);
+}
+
+//*****************************************************************************
+bool	Debayer_Image(	const void			*rawData,
+						const int			width,
+						const int			height,
+						const int			bytesPerPixel,
+						const int			bayerPattern,
+						TYPE_DEBAYER_METHOD	method,
+						const bool			bgrOrder,
+						unsigned char		*outputData)
+{
+	if (outputData == NULL)
+	{
+		return(false);
+	}
+	return(DebayerRawData(rawData, width, height, bytesPerPixel, bayerPattern, method, bgrOrder, outputData, NULL));
+}
+
+//*****************************************************************************
+bool	Debayer_Image16(const void			*rawData,
+						const int			width,
+						const int			height,
+						const int			bytesPerPixel,
+						const int			bayerPattern,
+						TYPE_DEBAYER_METHOD	method,
+						const bool			bgrOrder,
+						uint16_t			*outputData)
+{
+	if (outputData == NULL)
+	{
+		return(false);
+	}
+	return(DebayerRawData(rawData, width, height, bytesPerPixel, bayerPattern, method, bgrOrder, NULL, outputData));
+}
+
+//*****************************************************************************
+const char	*Debayer_GetMethodName(TYPE_DEBAYER_METHOD method)
+{
+	switch(method)
+	{
+		case kDebayer_Bilinear:		return("bilinear");
+		case kDebayer_EdgeAware:	return("edge");
+		default:					return("unknown");
+	}
+}
@@ -0,0 +1,77 @@
+//**************************************************************************
+//*	Name:			debayer.h
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Native debayer (demosaic) of RAW8/RAW16 color sensor data
+//*
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb  9,	2021	<MLS> Created debayer.h
+//*	Mar 30,	2021	<MLS> Added Debayer_Image16()
+//*****************************************************************************
+//#include	"debayer.h"
+
+#ifndef _DEBAYER_H_
+#define	_DEBAYER_H_
+
+#include	<stdint.h>
+#include	<stdbool.h>
+
+//*****************************************************************************
+//*	these are in the same order as TYPE_BAYER_PAT (and the ZWO values)
+//*	the name is the color of the first 2 pixels of the first 2 rows
+enum
+{
+	kDebayer_RGGB	=	0,
+	kDebayer_BGGR,
+	kDebayer_GRBG,
+	kDebayer_GBRG
+};
+
+//*****************************************************************************
+typedef enum
+{
+	kDebayer_Bilinear	=	0,
+	kDebayer_EdgeAware,			//*	gradient directed green, color difference red/blue
+
+	kDebayer_last
+} TYPE_DEBAYER_METHOD;
+
+#define	kDebayer_MaxThreads		8
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+//*	output is 8 bits per color, interleaved, RGB or BGR (OpenCV) order
+//*	returns false if the arguments are invalid or memory could not be allocated
+bool	Debayer_Image(	const void			*rawData,
+						const int			width,
+						const int			height,
+						const int			bytesPerPixel,		//*	1 = RAW8, 2 = RAW16
+						const int			bayerPattern,
+						TYPE_DEBAYER_METHOD	method,
+						const bool			bgrOrder,
+						unsigned char		*outputData);		//*	width * height * 3 bytes
+
+//*	same as above with 16 bits per color, RAW8 data comes out as 0 to 255
+bool	Debayer_Image16(const void			*rawData,
+						const int			width,
+						const int			height,
+						const int			bytesPerPixel,		//*	1 = RAW8, 2 = RAW16
+						const int			bayerPattern,
+						TYPE_DEBAYER_METHOD	method,
+						const bool			bgrOrder,
+						uint16_t			*outputData);		//*	width * height * 3 samples
+
+const char	*Debayer_GetMethodName(TYPE_DEBAYER_METHOD method);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//	_DEBAYER_H_
@@ -38,6 +38,7 @@
 //*	Apr  1,	2020	<MLS> Updated Get_Names() to deal with table starting at 0
 //*	Apr  1,	2020	<MLS> CONFORM-filterwheel -> PASSED!!!!!!!!!!!!!!!!!!!!!
 //*	May 22,	2020	<MLS> Fixed JSON formating error in filter wheel names output
+//*	Mar  8,	2021	<MLS> Position changes bump gDeviceStateChangeCnt
 //*****************************************************************************
 
 #ifdef _ENABLE_FILTERWHEEL_
@@ -514,6 +515,7 @@ char				commentString[128];
 			if (alpacaErrCode == 0)
 			{
 				cFilterWheelCurrPos	=	newPosition;
+				gDeviceStateChangeCnt++;
 			}
 			else
 			{
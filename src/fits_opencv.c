@@ -1,3 +1,20 @@
+//**************************************************************************
+//*	Name:			fits_opencv.c
+//*
+//*	Description:	Reads FITS images into OpenCV images
+//*
+//*					The data unit used to be read with one fits_read_img() per row,
+//*					thousands of small cfitsio calls on a large frame.
+//*
+//*					Uncompressed files are now memory mapped and converted straight
+//*					into the IplImage, the big endian to host byte swap and the
+//*					BZERO/BSCALE scaling are done in the same pass. The row loops are
+//*					written so that the compiler vectorizes them (NEON on the Pi,
+//*					SSE/AVX on x86), the same as imagebin.c.
+//*
+//*					Tile compressed files (and anything that can not be mapped) are
+//*					read with a single fits_read_img() call for the whole image.
+//*
 //*****************************************************************************
 //*	AlpacaPi is an open source project written in C/C++
 //*
@@ -11,9 +28,26 @@
 //*
 //*	Redistributions of this source code must retain this copyright notice.
 //*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Mar 22,	2021	<MLS> Read the whole data unit at once instead of one row at a time
+//*	Mar 22,	2021	<MLS> Uncompressed FITS files are memory mapped
+//*	Mar 22,	2021	<MLS> Byte swap and BZERO/BSCALE in one pass
+//*	Mar 22,	2021	<MLS> Now uses fits_open_image(), tile compressed files can be read
+//*	Mar 30,	2021	<MLS> ReadImageIntoOpenCVimage() sends .fz files to the FITS reader
+//*****************************************************************************
 
 #include	<string.h>
+#include	<strings.h>
 #include	<stdio.h>
+#include	<stdlib.h>
+#include	<stdint.h>
+#include	<unistd.h>
+#include	<fcntl.h>
+#include	<sys/mman.h>
+#include	<sys/stat.h>
 #include	<fitsio.h>
 #include	<stdbool.h>
 
@@ -27,6 +61,221 @@
 
 #include	"fits_opencv.h"
 
+//*****************************************************************************
+//*	FITS data is big endian, signed 16 bit with BZERO=32768 for unsigned data
+//*****************************************************************************
+static void	ConvertFITSrow16(	uint16_t *__restrict__			dstRow,
+								const uint16_t *__restrict__	srcRow,
+								const int						count,
+								const double					bzero,
+								const double					bscale)
+{
+int			ii;
+uint16_t	rawValue;
+int16_t		signedValue;
+double		physValue;
+
+	if ((bzero == 32768.0) && (bscale == 1.0))
+	{
+		//*	the normal case for camera data, swap and flip the sign bit
+		for (ii=0; ii<count; ii++)
+		{
+			rawValue	=	srcRow[ii];
+		#if (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+			rawValue	=	(uint16_t)((rawValue << 8) | (rawValue >> 8));
+		#endif
+			dstRow[ii]	=	rawValue ^ 0x8000;
+		}
+	}
+	else if ((bzero == 0.0) && (bscale == 1.0))
+	{
+		for (ii=0; ii<count; ii++)
+		{
+			rawValue	=	srcRow[ii];
+		#if (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+			rawValue	=	(uint16_t)((rawValue << 8) | (rawValue >> 8));
+		#endif
+			signedValue	=	(int16_t)rawValue;
+			dstRow[ii]	=	(signedValue < 0) ? 0 : signedValue;
+		}
+	}
+	else
+	{
+		for (ii=0; ii<count; ii++)
+		{
+			rawValue	=	srcRow[ii];
+		#if (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+			rawValue	=	(uint16_t)((rawValue << 8) | (rawValue >> 8));
+		#endif
+			physValue	=	((int16_t)rawValue * bscale) + bzero + 0.5;
+			if (physValue < 0.0)
+			{
+				physValue	=	0.0;
+			}
+			if (physValue > 65535.0)
+			{
+				physValue	=	65535.0;
+			}
+			dstRow[ii]	=	(uint16_t)physValue;
+		}
+	}
+}
+
+//*****************************************************************************
+static void	ConvertFITSrow8(	uint8_t *__restrict__		dstRow,
+								const uint8_t *__restrict__	srcRow,
+								const int					count,
+								const double				bzero,
+								const double				bscale)
+{
+int			ii;
+double		physValue;
+
+	if ((bzero == 0.0) && (bscale == 1.0))
+	{
+		memcpy(dstRow, srcRow, count);
+	}
+	else
+	{
+		for (ii=0; ii<count; ii++)
+		{
+			physValue	=	(srcRow[ii] * bscale) + bzero + 0.5;
+			if (physValue < 0.0)
+			{
+				physValue	=	0.0;
+			}
+			if (physValue > 255.0)
+			{
+				physValue	=	255.0;
+			}
+			dstRow[ii]	=	(uint8_t)physValue;
+		}
+	}
+}
+
+//*****************************************************************************
+//*	maps the data unit of an uncompressed file and converts it into the image
+//*	returns false if the file could not be mapped, the caller falls back to cfitsio
+//*****************************************************************************
+static bool	ReadFITSdata_mmap(	const char	*fitsFileName,
+								long long	dataStart,
+								IplImage	*openCvImgPtr,
+								const int	bytesPerPixel,
+								const double	bzero,
+								const double	bscale)
+{
+int				fileDesc;
+struct stat		fileStatus;
+char			simpleKeyWord[8];
+long			pageSize;
+off_t			mapOffset;
+size_t			mapLen;
+size_t			dataLen;
+size_t			srcRowLen;
+unsigned char	*mapPtr;
+unsigned char	*srcPtr;
+char			*pixelPtr;
+int				width;
+int				height;
+int				ii;
+bool			mapOK;
+
+	mapOK		=	false;
+	width		=	openCvImgPtr->width;
+	height		=	openCvImgPtr->height;
+	srcRowLen	=	(size_t)width * bytesPerPixel;
+	dataLen		=	srcRowLen * height;
+
+	fileDesc	=	open(fitsFileName, O_RDONLY);
+	if (fileDesc >= 0)
+	{
+		//*	cfitsio also opens gzip'd files, those can not be mapped
+		if ((fstat(fileDesc, &fileStatus) == 0) &&
+			(fileStatus.st_size >= (off_t)(dataStart + dataLen)) &&
+			(pread(fileDesc, simpleKeyWord, 6, 0) == 6) &&
+			(strncmp(simpleKeyWord, "SIMPLE", 6) == 0))
+		{
+			//*	the offset has to be on a page boundary
+			pageSize	=	sysconf(_SC_PAGESIZE);
+			mapOffset	=	dataStart & ~((off_t)pageSize - 1);
+			mapLen		=	(dataStart - mapOffset) + dataLen;
+			mapPtr		=	(unsigned char *)mmap(NULL, mapLen, PROT_READ, MAP_PRIVATE, fileDesc, mapOffset);
+			if (mapPtr != MAP_FAILED)
+			{
+				madvise(mapPtr, mapLen, MADV_SEQUENTIAL);
+
+				//*	the data unit starts on a 2880 byte boundary, 16 bit access is aligned
+				srcPtr		=	mapPtr + (dataStart - mapOffset);
+				pixelPtr	=	openCvImgPtr->imageData;
+				for (ii=0; ii<height; ii++)
+				{
+					if (bytesPerPixel == 2)
+					{
+						ConvertFITSrow16((uint16_t *)pixelPtr, (const uint16_t *)srcPtr, width, bzero, bscale);
+					}
+					else
+					{
+						ConvertFITSrow8((uint8_t *)pixelPtr, srcPtr, width, bzero, bscale);
+					}
+					srcPtr		+=	srcRowLen;
+					pixelPtr	+=	openCvImgPtr->widthStep;
+				}
+				munmap(mapPtr, mapLen);
+				mapOK	=	true;
+			}
+		}
+		close(fileDesc);
+	}
+	return(mapOK);
+}
+
+//*****************************************************************************
+//*	one fits_read_img() call for the whole image, cfitsio does the scaling
+//*****************************************************************************
+static int	ReadFITSdata_cfitsio(fitsfile *fptr, IplImage *openCvImgPtr, const int bytesPerPixel)
+{
+int				status;
+int				dataType;
+long			pixelCnt;
+size_t			rowLen;
+unsigned char	*tempBuffer;
+unsigned char	*srcPtr;
+char			*pixelPtr;
+int				ii;
+
+	dataType	=	(bytesPerPixel == 2) ? TUSHORT : TBYTE;
+	pixelCnt	=	(long)openCvImgPtr->width * openCvImgPtr->height;
+	rowLen		=	(size_t)openCvImgPtr->width * bytesPerPixel;
+	status		=	0;
+	if ((size_t)openCvImgPtr->widthStep == rowLen)
+	{
+		//*	no row padding, read straight into the image
+		fits_read_img(fptr, dataType, 1, pixelCnt, NULL, openCvImgPtr->imageData, NULL, &status);
+	}
+	else
+	{
+		tempBuffer	=	(unsigned char *)malloc(pixelCnt * bytesPerPixel);
+		if (tempBuffer != NULL)
+		{
+			fits_read_img(fptr, dataType, 1, pixelCnt, NULL, tempBuffer, NULL, &status);
+			srcPtr		=	tempBuffer;
+			pixelPtr	=	openCvImgPtr->imageData;
+			for (ii=0; ii<openCvImgPtr->height; ii++)
+			{
+				memcpy(pixelPtr, srcPtr, rowLen);
+				srcPtr		+=	rowLen;
+				pixelPtr	+=	openCvImgPtr->widthStep;
+			}
+			free(tempBuffer);
+		}
+		else
+		{
+			status	=	MEMORY_ALLOCATION;
+		}
+	}
+	return(status);
+}
+
 //*****************************************************************************
 IplImage	*ReadFITSimageIntoOpenCVimage(const char *fitsFileName)
 {
@@ -34,148 +283,130 @@ fitsfile		*fptr;
 int				fitsRetCode;
 int				status;
 IplImage		*openCvImgPtr;
-int				nfound;
+int				naxis;
 long			naxes[3];
-long			bitpix;
+int				bitpix;
 int				width;
 int				height;
-char			*pixelPtr;
-unsigned short	*uShortPtr;
-int				ii;
-int				jj;
-//short			nullval;
-long			firstPixel;
-//char			errorString[64];
-int				errorCnt;
+int				bytesPerPixel;
+int				isCompressed;
+double			bzero;
+double			bscale;
+long long		headStart;
+long long		dataStart;
+long long		dataEnd;
+bool			useMmap;
+bool			readOK;
 
 //	CONSOLE_DEBUG(__FUNCTION__);
 	CONSOLE_DEBUG_W_STR("File:", fitsFileName);
 
 
 	openCvImgPtr	=	NULL;
-	errorCnt		=	0;
+	readOK			=	false;
+	naxis			=	0;
 	naxes[0]		=	0;
 	naxes[1]		=	0;
 	naxes[2]		=	0;
+	bitpix			=	0;
 	status			=	0;
-	fitsRetCode		=	fits_open_file(&fptr, fitsFileName, READONLY, &status);
+	//*	fits_open_image() skips to the first image, tile compressed images are in an extension
+	fitsRetCode		=	fits_open_image(&fptr, fitsFileName, READONLY, &status);
 	if (fitsRetCode == 0)
 	{
-
-		//* read the NAXIS key words
 		status		=	0;
-		fitsRetCode	=	fits_read_keys_lng(fptr, "NAXIS", 1, 3, naxes, &nfound, &status);
-//		CONSOLE_DEBUG_W_NUM("nfound\t=",	nfound);
-//		CONSOLE_DEBUG_W_INT32("naxes[0]\t=",	naxes[0]);
-//		CONSOLE_DEBUG_W_INT32("naxes[1]\t=",	naxes[1]);
-//		CONSOLE_DEBUG_W_INT32("naxes[2]\t=",	naxes[2]);
-//		CONSOLE_DEBUG_W_NUM("TSHORT\t=", TSHORT);
-//		CONSOLE_DEBUG_W_NUM("TUSHORT\t=", TUSHORT);
-
-		status		=	0;
-		bitpix		=	0;	//*	set a default
-		fitsRetCode	=	fits_read_key_lng(fptr, "BITPIX", &bitpix, NULL, &status);
-//		CONSOLE_DEBUG_W_INT32("bitpix\t=",	bitpix);
+		fitsRetCode	=	fits_get_img_param(fptr, 3, &bitpix, &naxis, naxes, &status);
 
+		width			=	naxes[0];
+		height			=	naxes[1];
+		bytesPerPixel	=	0;
 		switch(bitpix)
 		{
 			case 8:
-		//		if (nfound == 2)
+				//*	8 bit B/W image, if there are more planes, only the first one is used
+				if (naxis >= 2)
 				{
-					//*	we have an 8 bit B/W image
-					width			=	naxes[0];
-					height			=	naxes[1];
-					firstPixel		=	1;
+					bytesPerPixel	=	1;
 					openCvImgPtr	=	cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 1);
-					if (openCvImgPtr != NULL)
-					{
-						pixelPtr	=	openCvImgPtr->imageData;
-						for (ii=0; ii<height; ii++)
-						{
-							//*	now we are going to read in the image a row at a time
-							status		=	0;
-							//nullval		=	0;
-							fitsRetCode	=	fits_read_img(	fptr,
-															TBYTE,
-															firstPixel,			//*	first pixel
-															width,
-															NULL,				//*	nullval,
-															pixelPtr,
-															NULL,
-															&status);
-							if (fitsRetCode != 0)
-							{
-								errorCnt++;
-								CONSOLE_DEBUG_W_NUM("fitsRetCode\t=",	fitsRetCode);
-							}
-							pixelPtr	+=	openCvImgPtr->widthStep;
-							firstPixel	+=	width;
-						}
-					}
 				}
 				break;
 
 			case 16:
-				if (nfound == 2)
+				if (naxis == 2)
 				{
 					//*	we have what we are expecting, a 16 bit B/W image
-
-					width			=	naxes[0];
-					height			=	naxes[1];
-					firstPixel		=	1;
+					bytesPerPixel	=	2;
 					openCvImgPtr	=	cvCreateImage(cvSize(width, height), IPL_DEPTH_16U, 1);
-					if (openCvImgPtr != NULL)
-					{
-						pixelPtr	=	openCvImgPtr->imageData;
-						for (ii=0; ii<height; ii++)
-						{
-							//*	now we are going to read in the image a row at a time
-							status		=	0;
-							//*	http://www.mssl.ucl.ac.uk/swift/om/sw/help/fitsio/node59.html
-							//*	https://heasarc.gsfc.nasa.gov/docs/software/fitsio/c/c_user/node20.html
-							fitsRetCode	=	fits_read_img(	fptr,
-															TUSHORT,			//	was TSHORT
-															firstPixel,			//*	first pixel
-															width,
-															NULL,				//*	nullval,
-															pixelPtr,
-															NULL,
-															&status);
-						#if 0
-							uShortPtr	=	(short *)pixelPtr;
-							for (jj=0; jj<width; jj++)
-							{
-								if (uShortPtr[jj] < 2000)
-								{
-									uShortPtr[jj]	=	0;
-								}
-							}
-						#endif
-							if (fitsRetCode != 0)
-							{
-								errorCnt++;
-						//		CONSOLE_DEBUG_W_NUM("fitsRetCode\t=",	fitsRetCode);
-						//		GetFitsErrorString(fitsRetCode, errorString);
-						//		CONSOLE_DEBUG_W_STR("fits_write_pix returned:", errorString);
-							}
-							pixelPtr	+=	openCvImgPtr->widthStep;
-							firstPixel	+=	width;
-						}
-					}
 				}
 				break;
 
 			default:
-				CONSOLE_DEBUG_W_LONG("Unsupported bit depth\t=",	bitpix);
+				CONSOLE_DEBUG_W_NUM("Unsupported bit depth\t=",	bitpix);
 				break;
 
 		}
-		status		=	0;
-		fits_close_file(fptr, &status);
-	}
-	if (errorCnt> 0)
-	{
-		CONSOLE_DEBUG_W_NUM("errorCnt\t=",	errorCnt);
+
+		if (openCvImgPtr != NULL)
+		{
+			useMmap			=	false;
+			dataStart		=	0;
+			bzero			=	0.0;
+			bscale			=	1.0;
+			status			=	0;
+			isCompressed	=	fits_is_compressed_image(fptr, &status);
+			if ((isCompressed == 0) && (status == 0))
+			{
+				fits_get_hduaddrll(fptr, &headStart, &dataStart, &dataEnd, &status);
+
+				//*	the file itself has the raw values, the scaling has to be done here
+				fits_read_key_dbl(fptr, "BZERO", &bzero, NULL, &status);
+				status	=	0;
+				fits_read_key_dbl(fptr, "BSCALE", &bscale, NULL, &status);
+				status	=	0;
+				useMmap	=	(dataStart > 0);
+			}
+
+			if (useMmap)
+			{
+				//*	done with cfitsio, do not keep the file open twice
+				status	=	0;
+				fits_close_file(fptr, &status);
+				fptr	=	NULL;
+
+				readOK	=	ReadFITSdata_mmap(fitsFileName, dataStart, openCvImgPtr, bytesPerPixel, bzero, bscale);
+				if (readOK == false)
+				{
+					status	=	0;
+					fits_open_image(&fptr, fitsFileName, READONLY, &status);
+					if (status != 0)
+					{
+						fptr	=	NULL;
+					}
+				}
+			}
+			if ((readOK == false) && (fptr != NULL))
+			{
+				fitsRetCode	=	ReadFITSdata_cfitsio(fptr, openCvImgPtr, bytesPerPixel);
+				if (fitsRetCode == 0)
+				{
+					readOK	=	true;
+				}
+				else
+				{
+					CONSOLE_DEBUG_W_NUM("fits_read_img returned\t=",	fitsRetCode);
+				}
+			}
+			if (readOK == false)
+			{
+				cvReleaseImage(&openCvImgPtr);
+				openCvImgPtr	=	NULL;
+			}
+		}
+		if (fptr != NULL)
+		{
+			status	=	0;
+			fits_close_file(fptr, &status);
+		}
 	}
 	return(openCvImgPtr);
 }
@@ -183,25 +414,29 @@ int				errorCnt;
 //*****************************************************************************
 //*	Function:	Reads an image into opencv data structure.
 //*				uses the extension to determine how to read it
+//*				.fz is fpack output (xxx.fits.fz), cfitsio reads it directly
 //*****************************************************************************
 IplImage	*ReadImageIntoOpenCVimage(const char *imageFileName)
 {
 IplImage	*openCvImgPtr;
-int			fnameLen;
-char		extension[8];
+const char	*extension;
 
 //	CONSOLE_DEBUG(__FUNCTION__);
 
 	openCvImgPtr	=	NULL;
-	fnameLen		=	strlen(imageFileName);
-	strcpy(extension, &imageFileName[fnameLen - 4]);
+	extension		=	strrchr(imageFileName, '.');
+	if (extension == NULL)
+	{
+		extension	=	"";
+	}
 //	CONSOLE_DEBUG_W_STR("extension\t=", extension);
-	if ((strcmp(extension, "fits") == 0) ||
-		(strcmp(extension, ".fit") == 0))
+	if ((strcasecmp(extension, ".fits") == 0) ||
+		(strcasecmp(extension, ".fit") == 0) ||
+		(strcasecmp(extension, ".fz") == 0))
 	{
 		openCvImgPtr	=	ReadFITSimageIntoOpenCVimage(imageFileName);
 	}
-	else if (strcmp(extension, "csv") == 0)
+	else if (strcasecmp(extension, ".csv") == 0)
 	{
 		openCvImgPtr	=	NULL;
 	}
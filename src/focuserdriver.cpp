@@ -36,6 +36,8 @@
 //*	Dec 19,	2019	<MLS> Added HaltFocuser()
 //*	Feb 29,	2020	<MLS> Added moonlite switch info to ReadAll
 //*	Apr  2,	2020	<MLS> CONFORM-focuser -> PASSED!!!!!!!!!!!!!!!!!!!!!
+//*	Feb 19,	2021	<MLS> Added GetFocuserIsMoving()
+//*	Mar 30,	2021	<MLS> Added GetFocuserMaxStep()
 //*****************************************************************************
 
 #ifdef _ENABLE_FOCUSER_
@@ -878,6 +880,18 @@ int32_t	FocuserDriver::GetFocuserPostion(void)
 	return(cFocuserPostion);
 }
 
+//*****************************************************************************
+bool	FocuserDriver::GetFocuserIsMoving(void)
+{
+	return(cFocusIsMoving);
+}
+
+//*****************************************************************************
+int32_t	FocuserDriver::GetFocuserMaxStep(void)
+{
+	return(cMaxStep);
+}
+
 //*****************************************************************************
 void	FocuserDriver::GetFocuserManufacturer(char *manufactString)
 {
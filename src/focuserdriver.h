@@ -9,6 +9,8 @@
 //*	<MLS>	=	Mark L Sproul
 //*****************************************************************************
 //*	Nov 28,	2020	<MLS> Updated return values to TYPE_ASCOM_STATUS
+//*	Feb 19,	2021	<MLS> Added GetFocuserIsMoving() for camera autofocus
+//*	Mar 30,	2021	<MLS> Added GetFocuserMaxStep() for camera autofocus
 //*****************************************************************************
 //#include	"focuserdriver.h"
 
@@ -88,6 +90,8 @@ class FocuserDriver: public AlpacaDriver
 
 		//*	these are access functions for FITS output
 		int32_t	GetFocuserPostion(void);
+		bool	GetFocuserIsMoving(void);
+		int32_t	GetFocuserMaxStep(void);
 		void	GetFocuserManufacturer(char *manufactString);
 		void	GetFocuserModel(char *modelName);
 		void	GetFocuserVersion(char *versionString);
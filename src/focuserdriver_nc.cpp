@@ -42,6 +42,7 @@
 //*	Jan  1,	2020	<MLS> Successfully tested 2 NiteCrawlers attached to the same R-Pi
 //*	Feb 29,	2020	<MLS> Switching over to using moonlite_com.c interface
 //*	Mar 17,	2020	<MLS> Fixed bug, /dev directory was not being closed
+//*	Mar  8,	2021	<MLS> Position changes bump gDeviceStateChangeCnt
 //*****************************************************************************
 
 #ifdef _ENABLE_FOCUSER_
@@ -336,6 +337,7 @@ uint32_t	currentSeconds;
 		if (cFocuserPostion != cPrevFocuserPostion)
 		{
 			cFocusIsMoving	=	true;
+			gDeviceStateChangeCnt++;
 			CONSOLE_DEBUG_W_NUM("pos1=", cFocuserPostion);
 		}
 		else
@@ -349,6 +351,7 @@ uint32_t	currentSeconds;
 		if (cRotatorPostion != cPrevRotatorPostion)
 		{
 			cRotatorIsMoving	=	true;
+			gDeviceStateChangeCnt++;
 //			CONSOLE_DEBUG_W_NUM("pos2=", cRotatorPostion);
 		}
 		else
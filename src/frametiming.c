@@ -0,0 +1,284 @@
+//**************************************************************************
+//*	Name:			frametiming.c
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Per frame latency timeline for the camera path
+//*
+//*					Each stage of a frame (exposure, readout, calibration, analysis,
+//*					openCV, save and download) gets a start and end time stamp from
+//*					the monotonic clock, so time of day changes (NTP, GPS) do not
+//*					show up as latency.
+//*
+//*					The frame in progress is only touched by the state machine. When
+//*					the frame is done it is copied into a ring buffer of the last
+//*					kFrameTiming_HistoryLen frames. Downloads happen later on the
+//*					command thread and are added to the frame in the ring buffer.
+//*
+//*					Percentiles are nearest rank, computed on request from a copy
+//*					of the ring buffer.
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb 22,	2021	<MLS> Created frametiming.c
+//*****************************************************************************
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<time.h>
+
+#include	"frametiming.h"
+
+//*****************************************************************************
+static const char	*gFrameStageNames[]	=
+{
+	"exposure",
+	"readout",
+	"calibration",
+	"analysis",
+	"opencv",
+	"save",
+	"download",
+	"total",
+};
+
+//*****************************************************************************
+const char	*FrameTiming_GetStageName(const TYPE_FRAME_STAGE stage)
+{
+	if ((stage >= 0) && (stage < kFrameStage_last))
+	{
+		return(gFrameStageNames[stage]);
+	}
+	return("unknown");
+}
+
+//*****************************************************************************
+uint64_t	FrameTiming_GetMonotonic_us(void)
+{
+struct timespec	monoTime;
+
+	clock_gettime(CLOCK_MONOTONIC, &monoTime);
+	return(((uint64_t)monoTime.tv_sec * 1000000) + (monoTime.tv_nsec / 1000));
+}
+
+//*****************************************************************************
+void	FrameTiming_Init(TYPE_FRAME_TIMING *frameTiming)
+{
+	memset(frameTiming, 0, sizeof(TYPE_FRAME_TIMING));
+	pthread_mutex_init(&frameTiming->timingMutex, NULL);
+}
+
+//*****************************************************************************
+void	FrameTiming_Reset(TYPE_FRAME_TIMING *frameTiming)
+{
+	pthread_mutex_lock(&frameTiming->timingMutex);
+	frameTiming->historyNext	=	0;
+	frameTiming->historyCnt		=	0;
+	pthread_mutex_unlock(&frameTiming->timingMutex);
+}
+
+//*****************************************************************************
+void	FrameTiming_StartFrame(TYPE_FRAME_TIMING *frameTiming, const int32_t exposureRequested_us)
+{
+	memset(&frameTiming->current, 0, sizeof(TYPE_FRAME_TIMELINE));
+	frameTiming->current.exposureRequested_us				=	exposureRequested_us;
+	frameTiming->current.stageStart_us[kFrameStage_Exposure]	=	FrameTiming_GetMonotonic_us();
+	frameTiming->currentActive								=	true;
+}
+
+//*****************************************************************************
+void	FrameTiming_StageBegin(TYPE_FRAME_TIMING *frameTiming, const TYPE_FRAME_STAGE stage)
+{
+	if (frameTiming->currentActive && (stage >= 0) && (stage < kFrameStage_last))
+	{
+		frameTiming->current.stageStart_us[stage]	=	FrameTiming_GetMonotonic_us();
+	}
+}
+
+//*****************************************************************************
+void	FrameTiming_StageEnd(TYPE_FRAME_TIMING *frameTiming, const TYPE_FRAME_STAGE stage)
+{
+	if (frameTiming->currentActive && (stage >= 0) && (stage < kFrameStage_last))
+	{
+		frameTiming->current.stageEnd_us[stage]	=	FrameTiming_GetMonotonic_us();
+	}
+}
+
+//*****************************************************************************
+void	FrameTiming_CommitFrame(TYPE_FRAME_TIMING *frameTiming, const uint32_t frameNumber)
+{
+TYPE_FRAME_TIMELINE	*timeLine;
+
+	if (frameTiming->currentActive)
+	{
+		timeLine								=	&frameTiming->current;
+		timeLine->frameNumber					=	frameNumber;
+		timeLine->stageStart_us[kFrameStage_Total]	=	timeLine->stageStart_us[kFrameStage_Exposure];
+		timeLine->stageEnd_us[kFrameStage_Total]	=	FrameTiming_GetMonotonic_us();
+
+		pthread_mutex_lock(&frameTiming->timingMutex);
+		frameTiming->history[frameTiming->historyNext]	=	*timeLine;
+		frameTiming->historyNext	=	(frameTiming->historyNext + 1) % kFrameTiming_HistoryLen;
+		if (frameTiming->historyCnt < kFrameTiming_HistoryLen)
+		{
+			frameTiming->historyCnt++;
+		}
+		pthread_mutex_unlock(&frameTiming->timingMutex);
+
+		frameTiming->currentActive	=	false;
+	}
+}
+
+//*****************************************************************************
+//*	a frame can be downloaded more than once, the last download is kept
+//*****************************************************************************
+void	FrameTiming_RecordDownload(	TYPE_FRAME_TIMING	*frameTiming,
+									const uint32_t		frameNumber,
+									const uint64_t		startTime_us,
+									const uint64_t		endTime_us)
+{
+int		ii;
+int		slotIdx;
+
+	pthread_mutex_lock(&frameTiming->timingMutex);
+	//*	search backwards from the newest, it is almost always the last one
+	for (ii=1; ii<=frameTiming->historyCnt; ii++)
+	{
+		slotIdx	=	(frameTiming->historyNext - ii + kFrameTiming_HistoryLen) % kFrameTiming_HistoryLen;
+		if (frameTiming->history[slotIdx].frameNumber == frameNumber)
+		{
+			frameTiming->history[slotIdx].stageStart_us[kFrameStage_Download]	=	startTime_us;
+			frameTiming->history[slotIdx].stageEnd_us[kFrameStage_Download]		=	endTime_us;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&frameTiming->timingMutex);
+}
+
+//*****************************************************************************
+uint32_t	FrameTiming_StageDuration(const TYPE_FRAME_TIMELINE *timeLine, const TYPE_FRAME_STAGE stage)
+{
+	if ((timeLine->stageStart_us[stage] == 0) || (timeLine->stageEnd_us[stage] < timeLine->stageStart_us[stage]))
+	{
+		return(0);
+	}
+	return(timeLine->stageEnd_us[stage] - timeLine->stageStart_us[stage]);
+}
+
+//*****************************************************************************
+//*	copies the history oldest first, returns the number of frames copied
+//*****************************************************************************
+int	FrameTiming_GetHistory(	TYPE_FRAME_TIMING	*frameTiming,
+							TYPE_FRAME_TIMELINE	*timeLines,
+							const int			maxFrames)
+{
+int		ii;
+int		frameCnt;
+int		slotIdx;
+
+	pthread_mutex_lock(&frameTiming->timingMutex);
+	frameCnt	=	frameTiming->historyCnt;
+	if (frameCnt > maxFrames)
+	{
+		frameCnt	=	maxFrames;
+	}
+	for (ii=0; ii<frameCnt; ii++)
+	{
+		slotIdx			=	(frameTiming->historyNext - frameCnt + ii + kFrameTiming_HistoryLen) % kFrameTiming_HistoryLen;
+		timeLines[ii]	=	frameTiming->history[slotIdx];
+	}
+	pthread_mutex_unlock(&frameTiming->timingMutex);
+	return(frameCnt);
+}
+
+//*****************************************************************************
+static int	CompareUint32(const void *aPtr, const void *bPtr)
+{
+uint32_t	aValue;
+uint32_t	bValue;
+
+	aValue	=	*((const uint32_t *)aPtr);
+	bValue	=	*((const uint32_t *)bPtr);
+	return((aValue > bValue) - (aValue < bValue));
+}
+
+//*****************************************************************************
+static uint32_t	Percentile(const uint32_t *sortedList, const uint32_t count, const int percent)
+{
+uint32_t	rank;
+
+	//*	nearest rank
+	rank	=	((count * percent) + 99) / 100;
+	if (rank < 1)
+	{
+		rank	=	1;
+	}
+	return(sortedList[rank - 1]);
+}
+
+//*****************************************************************************
+//*	stageStats must have kFrameStage_last entries, stages that did not run
+//*	on a frame are left out of that stage's statistics
+//*****************************************************************************
+void	FrameTiming_ComputeStats(	TYPE_FRAME_TIMING		*frameTiming,
+									TYPE_FRAME_STAGE_STATS	*stageStats)
+{
+TYPE_FRAME_TIMELINE	*timeLines;
+uint32_t			durationList[kFrameTiming_HistoryLen];
+uint32_t			count;
+int					frameCnt;
+int					stage;
+int					ii;
+double				sum;
+
+	memset(stageStats, 0, (kFrameStage_last * sizeof(TYPE_FRAME_STAGE_STATS)));
+	timeLines	=	(TYPE_FRAME_TIMELINE *)malloc(kFrameTiming_HistoryLen * sizeof(TYPE_FRAME_TIMELINE));
+	if (timeLines != NULL)
+	{
+		frameCnt	=	FrameTiming_GetHistory(frameTiming, timeLines, kFrameTiming_HistoryLen);
+		for (stage=0; stage<kFrameStage_last; stage++)
+		{
+			count	=	0;
+			sum		=	0.0;
+			for (ii=0; ii<frameCnt; ii++)
+			{
+				if (timeLines[ii].stageStart_us[stage] != 0)
+				{
+					durationList[count]	=	FrameTiming_StageDuration(&timeLines[ii], (TYPE_FRAME_STAGE)stage);
+					sum					+=	durationList[count];
+					count++;
+				}
+			}
+			if (count > 0)
+			{
+				qsort(durationList, count, sizeof(uint32_t), CompareUint32);
+				stageStats[stage].count		=	count;
+				stageStats[stage].min_us	=	durationList[0];
+				stageStats[stage].max_us	=	durationList[count - 1];
+				stageStats[stage].p50_us	=	Percentile(durationList, count, 50);
+				stageStats[stage].p90_us	=	Percentile(durationList, count, 90);
+				stageStats[stage].p99_us	=	Percentile(durationList, count, 99);
+				stageStats[stage].mean_us	=	sum / count;
+			}
+		}
+		free(timeLines);
+	}
+}
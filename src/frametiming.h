@@ -0,0 +1,108 @@
+//**************************************************************************
+//*	Name:			frametiming.h
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Per frame latency timeline for the camera path
+//*
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb 22,	2021	<MLS> Created frametiming.h
+//*****************************************************************************
+//#include	"frametiming.h"
+
+#ifndef _FRAMETIMING_H_
+#define	_FRAMETIMING_H_
+
+#include	<stdint.h>
+#include	<stdbool.h>
+
+#ifndef _PTHREAD_H
+	#include	<pthread.h>
+#endif // _PTHREAD_H
+
+//*****************************************************************************
+typedef enum
+{
+	kFrameStage_Exposure	=	0,		//*	start exposure until the driver reports success (includes SDK readout)
+	kFrameStage_Readout,				//*	Read_ImageData()
+	kFrameStage_Calibration,
+	kFrameStage_Analysis,				//*	live stack hand off and star detection
+	kFrameStage_OpenCV,					//*	CreateOpenCVImage()
+	kFrameStage_Save,					//*	SaveImageData()
+	kFrameStage_Download,				//*	imagearray / rgbarray sent to the client
+	kFrameStage_Total,					//*	exposure start until the frame was ready (download not included)
+
+	kFrameStage_last
+} TYPE_FRAME_STAGE;
+
+#define	kFrameTiming_HistoryLen		256
+
+//*****************************************************************************
+//*	all times are micro seconds from CLOCK_MONOTONIC, 0 means the stage did not run
+typedef struct
+{
+	uint32_t	frameNumber;
+	int32_t		exposureRequested_us;
+	uint64_t	stageStart_us[kFrameStage_last];
+	uint64_t	stageEnd_us[kFrameStage_last];
+} TYPE_FRAME_TIMELINE;
+
+//*****************************************************************************
+typedef struct
+{
+	uint32_t	count;
+	uint32_t	min_us;
+	uint32_t	p50_us;
+	uint32_t	p90_us;
+	uint32_t	p99_us;
+	uint32_t	max_us;
+	double		mean_us;
+} TYPE_FRAME_STAGE_STATS;
+
+//*****************************************************************************
+typedef struct
+{
+	pthread_mutex_t		timingMutex;		//*	downloads are recorded from the command thread
+	TYPE_FRAME_TIMELINE	current;			//*	frame in progress, only used by the state machine
+	bool				currentActive;
+	TYPE_FRAME_TIMELINE	history[kFrameTiming_HistoryLen];
+	int					historyNext;		//*	ring buffer, next slot to write
+	int					historyCnt;
+} TYPE_FRAME_TIMING;
+
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+void		FrameTiming_Init(			TYPE_FRAME_TIMING *frameTiming);
+void		FrameTiming_Reset(			TYPE_FRAME_TIMING *frameTiming);
+uint64_t	FrameTiming_GetMonotonic_us(void);
+
+void		FrameTiming_StartFrame(		TYPE_FRAME_TIMING *frameTiming, const int32_t exposureRequested_us);
+void		FrameTiming_StageBegin(		TYPE_FRAME_TIMING *frameTiming, const TYPE_FRAME_STAGE stage);
+void		FrameTiming_StageEnd(		TYPE_FRAME_TIMING *frameTiming, const TYPE_FRAME_STAGE stage);
+void		FrameTiming_CommitFrame(	TYPE_FRAME_TIMING *frameTiming, const uint32_t frameNumber);
+void		FrameTiming_RecordDownload(	TYPE_FRAME_TIMING	*frameTiming,
+										const uint32_t		frameNumber,
+										const uint64_t		startTime_us,
+										const uint64_t		endTime_us);
+
+int			FrameTiming_GetHistory(		TYPE_FRAME_TIMING	*frameTiming,
+										TYPE_FRAME_TIMELINE	*timeLines,
+										const int			maxFrames);
+void		FrameTiming_ComputeStats(	TYPE_FRAME_TIMING		*frameTiming,
+										TYPE_FRAME_STAGE_STATS	*stageStats);
+uint32_t	FrameTiming_StageDuration(	const TYPE_FRAME_TIMELINE *timeLine, const TYPE_FRAME_STAGE stage);
+
+const char	*FrameTiming_GetStageName(const TYPE_FRAME_STAGE stage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//	_FRAMETIMING_H_
@@ -0,0 +1,213 @@
+//**************************************************************************
+//*	Name:			imagebin.c
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Software binning / downscaling of image data
+//*
+//*					The binning is done in 2 steps for each output row
+//*						1) the source rows are added up into a 32 bit row accumulator
+//*						2) each group of binFactor columns is added up
+//*
+//*					Step 1 is where all of the memory traffic is and it is a straight
+//*					element by element add, which the compiler turns into vector
+//*					instructions (NEON on the Pi, SSE/AVX on x86).
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb 12,	2021	<MLS> Created imagebin.c
+//*	Mar 30,	2021	<MLS> Added BinRow(), the common bin factors vectorize at -O3
+//*****************************************************************************
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<stdint.h>
+#include	<stdbool.h>
+
+#include	"imagebin.h"
+
+//*****************************************************************************
+static void	AccumulateRow8(uint32_t *__restrict__ accumRow, const uint8_t *__restrict__ srcRow, const int count)
+{
+int		ii;
+
+	for (ii=0; ii<count; ii++)
+	{
+		accumRow[ii]	+=	srcRow[ii];
+	}
+}
+
+//*****************************************************************************
+static void	AccumulateRow16(uint32_t *__restrict__ accumRow, const uint16_t *__restrict__ srcRow, const int count)
+{
+int		ii;
+
+	for (ii=0; ii<count; ii++)
+	{
+		accumRow[ii]	+=	srcRow[ii];
+	}
+}
+
+//*****************************************************************************
+//*	adds up the columns of the accumulated rows, binFactor x binFactor blocks.
+//*	called with constants for binFactor and planes, once this is inlined the
+//*	inner loops are unrolled, the divide is by a constant and the loop vectorizes
+//*****************************************************************************
+static inline void	BinRow(	uint16_t *__restrict__			dstRow,
+							const uint32_t *__restrict__	accumRow,
+							const int						dstWidth,
+							const int						binFactor,
+							const int						planes,
+							const bool						sumMode)
+{
+int			xxx;
+int			ppp;
+int			bbb;
+uint32_t	blockSum;
+
+	for (xxx=0; xxx<dstWidth; xxx++)
+	{
+		for (ppp=0; ppp<planes; ppp++)
+		{
+			blockSum	=	0;
+			for (bbb=0; bbb<binFactor; bbb++)
+			{
+				blockSum	+=	accumRow[(((xxx * binFactor) + bbb) * planes) + ppp];
+			}
+			if (sumMode == false)
+			{
+				blockSum	=	blockSum / (binFactor * binFactor);
+			}
+			dstRow[(xxx * planes) + ppp]	=	(blockSum > 0xffff) ? 0xffff : blockSum;
+		}
+	}
+}
+
+//*****************************************************************************
+bool	ImageBin_Downsample(	const void		*srcData,
+								const int		srcWidth,
+								const int		srcHeight,
+								const int		bytesPerPixel,
+								const int		planes,
+								const int		binFactor,
+								const bool		sumMode,
+								uint16_t		*dstData)
+{
+uint32_t	*accumRow;
+int			dstWidth;
+int			dstHeight;
+int			rowLen;
+int			yyy;
+int			bbb;
+int			srcRowIdx;
+uint16_t	*dstPtr;
+
+	if ((srcData == NULL) || (dstData == NULL) || (binFactor < 1) || (binFactor > kImageBin_MaxFactor) ||
+		((bytesPerPixel != 1) && (bytesPerPixel != 2)) || (planes < 1))
+	{
+		return(false);
+	}
+	dstWidth	=	srcWidth / binFactor;
+	dstHeight	=	srcHeight / binFactor;
+	if ((dstWidth < 1) || (dstHeight < 1))
+	{
+		return(false);
+	}
+	rowLen		=	srcWidth * planes;
+	accumRow	=	(uint32_t *)malloc(rowLen * sizeof(uint32_t));
+	if (accumRow == NULL)
+	{
+		return(false);
+	}
+	dstPtr	=	dstData;
+	for (yyy=0; yyy<dstHeight; yyy++)
+	{
+		memset(accumRow, 0, rowLen * sizeof(uint32_t));
+		for (bbb=0; bbb<binFactor; bbb++)
+		{
+			srcRowIdx	=	(yyy * binFactor) + bbb;
+			if (bytesPerPixel == 2)
+			{
+				AccumulateRow16(accumRow, ((const uint16_t *)srcData) + ((long)srcRowIdx * rowLen), rowLen);
+			}
+			else
+			{
+				AccumulateRow8(accumRow, ((const uint8_t *)srcData) + ((long)srcRowIdx * rowLen), rowLen);
+			}
+		}
+
+		//*	the common sizes get constants so the row loop vectorizes
+		if ((binFactor == 2) && (planes == 1))
+		{
+			BinRow(dstPtr, accumRow, dstWidth, 2, 1, sumMode);
+		}
+		else if ((binFactor == 2) && (planes == 3))
+		{
+			BinRow(dstPtr, accumRow, dstWidth, 2, 3, sumMode);
+		}
+		else if ((binFactor == 3) && (planes == 1))
+		{
+			BinRow(dstPtr, accumRow, dstWidth, 3, 1, sumMode);
+		}
+		else if ((binFactor == 3) && (planes == 3))
+		{
+			BinRow(dstPtr, accumRow, dstWidth, 3, 3, sumMode);
+		}
+		else if ((binFactor == 4) && (planes == 1))
+		{
+			BinRow(dstPtr, accumRow, dstWidth, 4, 1, sumMode);
+		}
+		else if ((binFactor == 4) && (planes == 3))
+		{
+			BinRow(dstPtr, accumRow, dstWidth, 4, 3, sumMode);
+		}
+		else
+		{
+			BinRow(dstPtr, accumRow, dstWidth, binFactor, planes, sumMode);
+		}
+		dstPtr	+=	dstWidth * planes;
+	}
+	free(accumRow);
+	return(true);
+}
+
+//*****************************************************************************
+//*	smallest bin factor that gets both dimensions at or below maxDimension
+//*****************************************************************************
+int	ImageBin_FactorForMaxDim(const int width, const int height, const int maxDimension)
+{
+int		largest;
+int		binFactor;
+
+	largest	=	(width > height) ? width : height;
+	if (maxDimension <= 0)
+	{
+		return(1);
+	}
+	binFactor	=	(largest + maxDimension - 1) / maxDimension;
+	if (binFactor < 1)
+	{
+		binFactor	=	1;
+	}
+	if (binFactor > kImageBin_MaxFactor)
+	{
+		binFactor	=	kImageBin_MaxFactor;
+	}
+	return(binFactor);
+}
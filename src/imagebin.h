@@ -0,0 +1,47 @@
+//**************************************************************************
+//*	Name:			imagebin.h
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Software binning / downscaling of image data
+//*
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb 12,	2021	<MLS> Created imagebin.h
+//*****************************************************************************
+//#include	"imagebin.h"
+
+#ifndef _IMAGEBIN_H_
+#define	_IMAGEBIN_H_
+
+#include	<stdint.h>
+#include	<stdbool.h>
+
+#define	kImageBin_MaxFactor		64
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+//*	output is binFactor x binFactor blocks, 16 bits per sample, same number of planes
+//*	partial blocks at the right and bottom edges are dropped
+//*	in sum mode the result is clipped at 65535
+bool	ImageBin_Downsample(	const void		*srcData,
+								const int		srcWidth,
+								const int		srcHeight,
+								const int		bytesPerPixel,		//*	1 or 2
+								const int		planes,				//*	1 or 3, interleaved
+								const int		binFactor,
+								const bool		sumMode,
+								uint16_t		*dstData);			//*	(srcWidth / binFactor) * (srcHeight / binFactor) * planes
+
+int		ImageBin_FactorForMaxDim(const int width, const int height, const int maxDimension);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//	_IMAGEBIN_H_
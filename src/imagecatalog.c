@@ -0,0 +1,650 @@
+//**************************************************************************
+//*	Name:			imagecatalog.c
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	In memory index of the image data directory
+//*
+//*					filelist used to readdir() the whole directory on every request
+//*					and sort it, after a few nights of imaging that is tens of thousands
+//*					of files, it took seconds and the fixed size array cut it short.
+//*
+//*					The directory is scanned once by a background thread, after that
+//*					inotify keeps the index current. The save pipeline also adds its
+//*					files directly, with the exposure, filter and object, which inotify
+//*					has no way of knowing.
+//*
+//*					There are 2 arrays of pointers to the same entries, one sorted by
+//*					name and one by time, so a page of either order is a straight copy.
+//*					Filtered queries have to look at every entry until the page is full.
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Mar 10,	2021	<MLS> Created imagecatalog.c
+//*	Mar 30,	2021	<MLS> An inotify overflow rescans in place, unchanged files keep exposure, filter and object
+//*****************************************************************************
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<strings.h>
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<ctype.h>
+#include	<errno.h>
+#include	<unistd.h>
+#include	<dirent.h>
+#include	<pthread.h>
+#include	<sys/stat.h>
+
+#ifdef __linux__
+	#include	<sys/inotify.h>
+#endif
+
+#define _ENABLE_CONSOLE_DEBUG_
+#include	"ConsoleDebug.h"
+
+#include	"imagecatalog.h"
+
+#define	kImageCatalog_InitialSize	1024
+
+static pthread_mutex_t		gCatalogMutex		=	PTHREAD_MUTEX_INITIALIZER;
+static TYPE_CATALOG_ENTRY	**gCatalogByName	=	NULL;
+static TYPE_CATALOG_ENTRY	**gCatalogByTime	=	NULL;
+static int					gCatalogCnt			=	0;
+static int					gCatalogSize		=	0;		//*	allocated length of both arrays
+static char					gCatalogDirectory[256]	=	"";
+static bool					gCatalogInitialized	=	false;
+static bool					gCatalogWatching	=	false;
+static uint32_t				gCatalogScanPass	=	0;
+static pthread_t			gCatalogThreadID;
+
+//*****************************************************************************
+static int	CompareTime(const TYPE_CATALOG_ENTRY *entry1, const TYPE_CATALOG_ENTRY *entry2)
+{
+int	retValue;
+
+	if (entry1->timeStamp < entry2->timeStamp)
+	{
+		retValue	=	-1;
+	}
+	else if (entry1->timeStamp > entry2->timeStamp)
+	{
+		retValue	=	1;
+	}
+	else
+	{
+		retValue	=	strcmp(entry1->fileName, entry2->fileName);
+	}
+	return(retValue);
+}
+
+//*****************************************************************************
+//*	returns the index of the entry, or where it would go if it is not there
+//*****************************************************************************
+static int	FindByName(const char *fileName, bool *found)
+{
+int		low;
+int		high;
+int		mid;
+int		cmpResult;
+
+	*found	=	false;
+	low		=	0;
+	high	=	gCatalogCnt;
+	while (low < high)
+	{
+		mid			=	(low + high) / 2;
+		cmpResult	=	strcmp(gCatalogByName[mid]->fileName, fileName);
+		if (cmpResult == 0)
+		{
+			*found	=	true;
+			return(mid);
+		}
+		else if (cmpResult < 0)
+		{
+			low		=	mid + 1;
+		}
+		else
+		{
+			high	=	mid;
+		}
+	}
+	return(low);
+}
+
+//*****************************************************************************
+static int	FindByTime(const TYPE_CATALOG_ENTRY *catalogEntry)
+{
+int		low;
+int		high;
+int		mid;
+
+	low		=	0;
+	high	=	gCatalogCnt;
+	while (low < high)
+	{
+		mid		=	(low + high) / 2;
+		if (CompareTime(gCatalogByTime[mid], catalogEntry) < 0)
+		{
+			low		=	mid + 1;
+		}
+		else
+		{
+			high	=	mid;
+		}
+	}
+	return(low);
+}
+
+//*****************************************************************************
+static bool	GrowCatalog(void)
+{
+TYPE_CATALOG_ENTRY	**newByName;
+TYPE_CATALOG_ENTRY	**newByTime;
+int					newSize;
+
+	newSize		=	(gCatalogSize > 0) ? (gCatalogSize * 2) : kImageCatalog_InitialSize;
+	newByName	=	(TYPE_CATALOG_ENTRY **)realloc(gCatalogByName, newSize * sizeof(TYPE_CATALOG_ENTRY *));
+	if (newByName == NULL)
+	{
+		return(false);
+	}
+	gCatalogByName	=	newByName;
+
+	newByTime	=	(TYPE_CATALOG_ENTRY **)realloc(gCatalogByTime, newSize * sizeof(TYPE_CATALOG_ENTRY *));
+	if (newByTime == NULL)
+	{
+		return(false);
+	}
+	gCatalogByTime	=	newByTime;
+	gCatalogSize	=	newSize;
+	return(true);
+}
+
+//*****************************************************************************
+static bool	GetFileInfo(const char *fileName, int64_t *fileSize, time_t *fileTime)
+{
+struct stat	fileStatus;
+char		filePath[sizeof(gCatalogDirectory) + kImageCatalog_MaxNameLen + 2];
+bool		isFile;
+
+	snprintf(filePath, sizeof(filePath), "%s/%s", gCatalogDirectory, fileName);
+	isFile	=	false;
+	if (stat(filePath, &fileStatus) == 0)
+	{
+		if (S_ISREG(fileStatus.st_mode))
+		{
+			*fileSize	=	fileStatus.st_size;
+			*fileTime	=	fileStatus.st_mtime;
+			isFile		=	true;
+		}
+	}
+	return(isFile);
+}
+
+//*****************************************************************************
+//*	fileInfo can be NULL, the file time and size come from the file system.
+//*	An existing entry keeps its time stamp so it does not move in the time order
+//*****************************************************************************
+static void	AddOrUpdate_Locked(const char *fileName, const TYPE_CATALOG_ENTRY *fileInfo)
+{
+TYPE_CATALOG_ENTRY	*catalogEntry;
+int64_t				fileSize;
+time_t				fileTime;
+int					nameIdx;
+int					timeIdx;
+bool				found;
+
+	if ((fileName[0] == '.') || (strlen(fileName) >= kImageCatalog_MaxNameLen))
+	{
+		return;
+	}
+	if (GetFileInfo(fileName, &fileSize, &fileTime) == false)
+	{
+		//*	gone already, or a directory
+		return;
+	}
+
+	nameIdx	=	FindByName(fileName, &found);
+	if (found)
+	{
+		catalogEntry	=	gCatalogByName[nameIdx];
+	}
+	else
+	{
+		if ((gCatalogCnt >= gCatalogSize) && (GrowCatalog() == false))
+		{
+			CONSOLE_DEBUG("Image catalog is out of memory");
+			return;
+		}
+		catalogEntry	=	(TYPE_CATALOG_ENTRY *)calloc(1, sizeof(TYPE_CATALOG_ENTRY));
+		if (catalogEntry == NULL)
+		{
+			return;
+		}
+		strcpy(catalogEntry->fileName, fileName);
+		catalogEntry->timeStamp		=	fileTime;
+		catalogEntry->exposure_us	=	-1;
+
+		memmove(&gCatalogByName[nameIdx + 1],	&gCatalogByName[nameIdx],
+												(gCatalogCnt - nameIdx) * sizeof(TYPE_CATALOG_ENTRY *));
+		gCatalogByName[nameIdx]	=	catalogEntry;
+
+		timeIdx	=	FindByTime(catalogEntry);
+		memmove(&gCatalogByTime[timeIdx + 1],	&gCatalogByTime[timeIdx],
+												(gCatalogCnt - timeIdx) * sizeof(TYPE_CATALOG_ENTRY *));
+		gCatalogByTime[timeIdx]	=	catalogEntry;
+		gCatalogCnt++;
+	}
+	catalogEntry->fileSize	=	fileSize;
+	catalogEntry->fileTime	=	fileTime;
+	catalogEntry->scanPass	=	gCatalogScanPass;
+
+	if (fileInfo != NULL)
+	{
+		if (fileInfo->exposure_us >= 0)
+		{
+			catalogEntry->exposure_us	=	fileInfo->exposure_us;
+		}
+		if (strlen(fileInfo->filter) > 0)
+		{
+			strcpy(catalogEntry->filter, fileInfo->filter);
+		}
+		if (strlen(fileInfo->object) > 0)
+		{
+			strcpy(catalogEntry->object, fileInfo->object);
+		}
+	}
+}
+
+//*****************************************************************************
+static void	Remove_Locked(const char *fileName)
+{
+TYPE_CATALOG_ENTRY	*catalogEntry;
+int					nameIdx;
+int					timeIdx;
+bool				found;
+
+	nameIdx	=	FindByName(fileName, &found);
+	if (found)
+	{
+		catalogEntry	=	gCatalogByName[nameIdx];
+		timeIdx			=	FindByTime(catalogEntry);
+
+		memmove(&gCatalogByName[nameIdx],	&gCatalogByName[nameIdx + 1],
+											(gCatalogCnt - nameIdx - 1) * sizeof(TYPE_CATALOG_ENTRY *));
+		if ((timeIdx >= gCatalogCnt) || (gCatalogByTime[timeIdx] != catalogEntry))
+		{
+			//*	time and name are unique so this should not happen
+			for (timeIdx=0; (timeIdx < gCatalogCnt) && (gCatalogByTime[timeIdx] != catalogEntry); timeIdx++)
+			{
+			}
+		}
+		if (timeIdx < gCatalogCnt)
+		{
+			memmove(&gCatalogByTime[timeIdx],	&gCatalogByTime[timeIdx + 1],
+												(gCatalogCnt - timeIdx - 1) * sizeof(TYPE_CATALOG_ENTRY *));
+		}
+		gCatalogCnt--;
+		free(catalogEntry);
+	}
+}
+
+//*****************************************************************************
+//*	called during a rescan before the entry is updated.
+//*	A file with a new size or time was written again, what we knew about it
+//*	may be for a different image
+//*****************************************************************************
+static void	ForgetIfChanged_Locked(const char *fileName)
+{
+TYPE_CATALOG_ENTRY	*catalogEntry;
+int64_t				fileSize;
+time_t				fileTime;
+int					nameIdx;
+bool				found;
+
+	nameIdx	=	FindByName(fileName, &found);
+	if (found && GetFileInfo(fileName, &fileSize, &fileTime))
+	{
+		catalogEntry	=	gCatalogByName[nameIdx];
+		if ((catalogEntry->fileSize != fileSize) || (catalogEntry->fileTime != fileTime))
+		{
+			catalogEntry->exposure_us	=	-1;
+			catalogEntry->filter[0]		=	0;
+			catalogEntry->object[0]		=	0;
+		}
+	}
+}
+
+//*****************************************************************************
+//*	removes the entries the last scan did not see, returns how many
+//*****************************************************************************
+static int	RemoveUnseen_Locked(void)
+{
+int		nameIdx;
+int		removedCnt;
+
+	removedCnt	=	0;
+	for (nameIdx = (gCatalogCnt - 1); nameIdx >= 0; nameIdx--)
+	{
+		if (gCatalogByName[nameIdx]->scanPass != gCatalogScanPass)
+		{
+			Remove_Locked(gCatalogByName[nameIdx]->fileName);
+			removedCnt++;
+		}
+	}
+	return(removedCnt);
+}
+
+//*****************************************************************************
+static void	ScanDirectory(void)
+{
+DIR				*directory;
+struct dirent	*dir;
+int				fileCnt;
+
+	fileCnt		=	0;
+	directory	=	opendir(gCatalogDirectory);
+	if (directory != NULL)
+	{
+		while ((dir = readdir(directory)) != NULL)
+		{
+			if ((dir->d_name[0] != '.') && (dir->d_type != DT_DIR))
+			{
+				//*	one file at a time so requests are not held off for the whole scan
+				pthread_mutex_lock(&gCatalogMutex);
+				ForgetIfChanged_Locked(dir->d_name);
+				AddOrUpdate_Locked(dir->d_name, NULL);
+				pthread_mutex_unlock(&gCatalogMutex);
+				fileCnt++;
+			}
+		}
+		closedir(directory);
+	}
+	else
+	{
+		CONSOLE_DEBUG_W_STR("Failed to open", gCatalogDirectory);
+	}
+	CONSOLE_DEBUG_W_NUM("Image catalog files\t=", fileCnt);
+}
+
+//*****************************************************************************
+static void	*ImageCatalogThread(void *arg)
+{
+#ifdef __linux__
+int							inotifyFD;
+int							watchDesc;
+ssize_t						bytesRead;
+char						eventBuf[8192] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+char						*eventPtr;
+const struct inotify_event	*event;
+int							removedCnt;
+
+	//*	the watch goes on before the scan so nothing falls in between,
+	//*	a file seen by both is just updated
+	inotifyFD	=	inotify_init();
+	watchDesc	=	-1;
+	if (inotifyFD >= 0)
+	{
+		watchDesc	=	inotify_add_watch(inotifyFD, gCatalogDirectory,
+										(IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM));
+	}
+	if (watchDesc < 0)
+	{
+		CONSOLE_DEBUG_W_NUM("inotify failed, the catalog will only see saved files, errno\t=", errno);
+	}
+	ScanDirectory();
+	if (watchDesc >= 0)
+	{
+		gCatalogWatching	=	true;
+		while (1)
+		{
+			bytesRead	=	read(inotifyFD, eventBuf, sizeof(eventBuf));
+			if (bytesRead <= 0)
+			{
+				if ((bytesRead < 0) && (errno == EINTR))
+				{
+					continue;
+				}
+				break;
+			}
+			for (eventPtr = eventBuf; eventPtr < (eventBuf + bytesRead); eventPtr += sizeof(struct inotify_event) + event->len)
+			{
+				event	=	(const struct inotify_event *)eventPtr;
+				if (event->mask & IN_Q_OVERFLOW)
+				{
+					//*	events were lost, rescan without clearing so the entries
+					//*	keep what ImageCatalog_AddFile() told us about them
+					CONSOLE_DEBUG("inotify queue overflow, rescanning");
+					pthread_mutex_lock(&gCatalogMutex);
+					gCatalogScanPass++;
+					pthread_mutex_unlock(&gCatalogMutex);
+					ScanDirectory();
+					pthread_mutex_lock(&gCatalogMutex);
+					removedCnt	=	RemoveUnseen_Locked();
+					pthread_mutex_unlock(&gCatalogMutex);
+					CONSOLE_DEBUG_W_NUM("Files removed by the rescan\t=", removedCnt);
+				}
+				else if ((event->len > 0) && ((event->mask & IN_ISDIR) == 0))
+				{
+					pthread_mutex_lock(&gCatalogMutex);
+					if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+					{
+						Remove_Locked(event->name);
+					}
+					else
+					{
+						AddOrUpdate_Locked(event->name, NULL);
+					}
+					pthread_mutex_unlock(&gCatalogMutex);
+				}
+			}
+		}
+		gCatalogWatching	=	false;
+		CONSOLE_DEBUG("Image catalog stopped watching");
+	}
+	if (inotifyFD >= 0)
+	{
+		close(inotifyFD);
+	}
+#else
+	ScanDirectory();
+#endif	//	__linux__
+	return(NULL);
+}
+
+//*****************************************************************************
+//*	only the first call does anything, every camera saves to the same directory
+//*****************************************************************************
+void	ImageCatalog_Init(const char *directoryPath)
+{
+int		threadErr;
+
+	pthread_mutex_lock(&gCatalogMutex);
+	if (gCatalogInitialized == false)
+	{
+		gCatalogInitialized	=	true;
+		strncpy(gCatalogDirectory, directoryPath, (sizeof(gCatalogDirectory) - 1));
+		GrowCatalog();
+		threadErr	=	pthread_create(&gCatalogThreadID, NULL, &ImageCatalogThread, NULL);
+		if (threadErr == 0)
+		{
+			pthread_detach(gCatalogThreadID);
+		}
+		else
+		{
+			CONSOLE_DEBUG_W_NUM("Failed to start image catalog thread, threadErr\t=", threadErr);
+		}
+	}
+	pthread_mutex_unlock(&gCatalogMutex);
+}
+
+//*****************************************************************************
+//*	called by the save pipeline once the file is closed
+//*****************************************************************************
+void	ImageCatalog_AddFile(const char *fileName, const TYPE_CATALOG_ENTRY *fileInfo)
+{
+	if (gCatalogInitialized)
+	{
+		pthread_mutex_lock(&gCatalogMutex);
+		AddOrUpdate_Locked(fileName, fileInfo);
+		pthread_mutex_unlock(&gCatalogMutex);
+	}
+}
+
+//*****************************************************************************
+void	ImageCatalog_RemoveFile(const char *fileName)
+{
+	if (gCatalogInitialized)
+	{
+		pthread_mutex_lock(&gCatalogMutex);
+		Remove_Locked(fileName);
+		pthread_mutex_unlock(&gCatalogMutex);
+	}
+}
+
+//*****************************************************************************
+int	ImageCatalog_GetCount(void)
+{
+int		catalogCnt;
+
+	pthread_mutex_lock(&gCatalogMutex);
+	catalogCnt	=	gCatalogCnt;
+	pthread_mutex_unlock(&gCatalogMutex);
+	return(catalogCnt);
+}
+
+//*****************************************************************************
+bool	ImageCatalog_IsWatching(void)
+{
+	return(gCatalogWatching);
+}
+
+//*****************************************************************************
+static bool	ContainsNoCase(const char *theString, const char *subString)
+{
+size_t	subLen;
+bool	found;
+
+	found	=	false;
+	subLen	=	strlen(subString);
+	while ((*theString != 0) && (found == false))
+	{
+		if (strncasecmp(theString, subString, subLen) == 0)
+		{
+			found	=	true;
+		}
+		theString++;
+	}
+	return(found);
+}
+
+//*****************************************************************************
+static bool	EntryMatches(const TYPE_CATALOG_ENTRY *catalogEntry, const TYPE_CATALOG_QUERY *query)
+{
+size_t	nameLen;
+size_t	extLen;
+
+	if ((query->since > 0) && (catalogEntry->timeStamp < query->since))
+	{
+		return(false);
+	}
+	if (query->extension[0] != 0)
+	{
+		nameLen	=	strlen(catalogEntry->fileName);
+		extLen	=	strlen(query->extension);
+		if ((nameLen <= extLen) ||
+			(catalogEntry->fileName[nameLen - extLen - 1] != '.') ||
+			(strcasecmp(&catalogEntry->fileName[nameLen - extLen], query->extension) != 0))
+		{
+			return(false);
+		}
+	}
+	if ((query->filter[0] != 0) && (strcasecmp(catalogEntry->filter, query->filter) != 0))
+	{
+		return(false);
+	}
+	if ((query->object[0] != 0) && (ContainsNoCase(catalogEntry->object, query->object) == false))
+	{
+		return(false);
+	}
+	return(true);
+}
+
+//*****************************************************************************
+int	ImageCatalog_Query(	const TYPE_CATALOG_QUERY	*query,
+						TYPE_CATALOG_ENTRY			*results,
+						const int					maxResults,
+						bool						*moreAvailable)
+{
+TYPE_CATALOG_ENTRY	**sortedList;
+int					pageSize;
+int					resultCnt;
+int					matchCnt;
+int					iii;
+int					listIdx;
+bool				filtered;
+
+	pageSize	=	query->count;
+	if ((pageSize <= 0) || (pageSize > maxResults))
+	{
+		pageSize	=	maxResults;
+	}
+	filtered	=	((query->extension[0] != 0) || (query->filter[0] != 0) ||
+					(query->object[0] != 0) || (query->since > 0));
+
+	resultCnt		=	0;
+	*moreAvailable	=	false;
+	pthread_mutex_lock(&gCatalogMutex);
+
+	sortedList	=	(query->sortOrder == kCatalogSort_Time) ? gCatalogByTime : gCatalogByName;
+	if (filtered == false)
+	{
+		//*	a page is a straight copy starting at the offset
+		for (iii = query->offset; (iii < gCatalogCnt) && (resultCnt < pageSize); iii++)
+		{
+			listIdx	=	query->reverse ? (gCatalogCnt - 1 - iii) : iii;
+			results[resultCnt++]	=	*sortedList[listIdx];
+		}
+		*moreAvailable	=	(iii < gCatalogCnt);
+	}
+	else
+	{
+		matchCnt	=	0;
+		for (iii = 0; iii < gCatalogCnt; iii++)
+		{
+			listIdx	=	query->reverse ? (gCatalogCnt - 1 - iii) : iii;
+			if (EntryMatches(sortedList[listIdx], query))
+			{
+				if (resultCnt >= pageSize)
+				{
+					*moreAvailable	=	true;
+					break;
+				}
+				if (matchCnt >= query->offset)
+				{
+					results[resultCnt++]	=	*sortedList[listIdx];
+				}
+				matchCnt++;
+			}
+		}
+	}
+	pthread_mutex_unlock(&gCatalogMutex);
+	return(resultCnt);
+}
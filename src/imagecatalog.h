@@ -0,0 +1,88 @@
+//**************************************************************************
+//*	Name:			imagecatalog.h
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	In memory index of the image data directory
+//*
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Mar 10,	2021	<MLS> Created imagecatalog.h
+//*	Mar 30,	2021	<MLS> Added fileTime and scanPass to TYPE_CATALOG_ENTRY
+//*****************************************************************************
+//#include	"imagecatalog.h"
+
+#ifndef _IMAGECATALOG_H_
+#define	_IMAGECATALOG_H_
+
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<time.h>
+
+#define	kImageCatalog_MaxNameLen	128
+#define	kImageCatalog_MaxPageSize	500
+
+//*****************************************************************************
+//*	exposure, filter and object are only known for files saved by this process,
+//*	files found on disk or written by something else only have size and time
+typedef struct
+{
+	char		fileName[kImageCatalog_MaxNameLen];
+	int64_t		fileSize;
+	time_t		timeStamp;				//*	file time when first seen, does not change
+	time_t		fileTime;				//*	current file time, a rescan uses it to tell a rewritten file
+	uint32_t	scanPass;				//*	the last directory scan that saw the file
+	int32_t		exposure_us;			//*	-1 if not known
+	char		filter[48];
+	char		object[48];
+} TYPE_CATALOG_ENTRY;
+
+//*****************************************************************************
+typedef enum
+{
+	kCatalogSort_Name	=	0,
+	kCatalogSort_Time,
+
+	kCatalogSort_last
+} TYPE_CATALOG_SORT;
+
+//*****************************************************************************
+//*	empty strings match everything
+typedef struct
+{
+	TYPE_CATALOG_SORT	sortOrder;
+	bool				reverse;
+	int					offset;
+	int					count;
+	char				extension[16];	//*	"fits" matches .fits, case insensitive
+	char				filter[48];		//*	exact, case insensitive
+	char				object[48];		//*	sub string, case insensitive
+	time_t				since;			//*	0 = no limit
+} TYPE_CATALOG_QUERY;
+
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+void	ImageCatalog_Init(const char *directoryPath);
+void	ImageCatalog_AddFile(const char *fileName, const TYPE_CATALOG_ENTRY *fileInfo);
+void	ImageCatalog_RemoveFile(const char *fileName);
+int		ImageCatalog_GetCount(void);
+bool	ImageCatalog_IsWatching(void);
+
+//*	returns the number of entries copied to results, moreAvailable is set if there
+//*	are more matches past the end of this page
+int		ImageCatalog_Query(	const TYPE_CATALOG_QUERY	*query,
+							TYPE_CATALOG_ENTRY			*results,
+							const int					maxResults,
+							bool						*moreAvailable);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//	_IMAGECATALOG_H_
@@ -0,0 +1,788 @@
+//**************************************************************************
+//*	Name:			imagecompress.c
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Lossless Rice compression of image data for transfer
+//*
+//*					Full frames over a slow link (dome wifi) take several seconds
+//*					even as binary. 16 bit astro images are mostly sky background
+//*					with a small amount of noise, the difference from one pixel to
+//*					the next is small, which Rice coding handles very well.
+//*
+//*					This is the same scheme fpack / cfitsio use:
+//*						each pixel is replaced by the difference from the previous one,
+//*						differences are folded to unsigned (0, -1, 1, -2, 2 ...),
+//*						every 32 values get a split point (fs) from their mean, the
+//*						value >> fs is sent as unary, the low fs bits as is.
+//*					A group of 32 zeros is sent as just the fs code and a group that
+//*					would not get smaller is sent raw, so the output is never much
+//*					bigger than the input.
+//*
+//*					The image is cut into blocks of kImageCompress_BlockRows rows, each
+//*					block is coded on its own so that the blocks can be compressed and
+//*					decompressed on separate threads. Each plane of a block is its
+//*					own difference stream.
+//*
+//*	Limitations:	Little endian only (Pi, x86, Jetson)
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb 28,	2021	<MLS> Created imagecompress.c
+//*	Mar 30,	2021	<MLS> rawLength is checked in 64 bits and the dimensions are bounded
+//*****************************************************************************
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<unistd.h>
+#include	<time.h>
+#include	<pthread.h>
+
+#define _ENABLE_CONSOLE_DEBUG_
+#include	"ConsoleDebug.h"
+
+#include	"imagecompress.h"
+
+#define	kRice_GroupSize		32
+
+//*****************************************************************************
+typedef struct
+{
+	uint8_t		*ptr;
+	uint32_t	bitBuff;
+	int			bitCnt;
+} TYPE_BIT_WRITER;
+
+//*****************************************************************************
+typedef struct
+{
+	const uint8_t	*ptr;
+	const uint8_t	*endPtr;
+	uint32_t		bitBuff;
+	int				bitCnt;
+	bool			overrun;
+} TYPE_BIT_READER;
+
+//*****************************************************************************
+//*	one per thread, the thread does every threadCnt'th block
+typedef struct
+{
+	uint8_t		*pixelData;				//*	source for compress, destination for decode
+	int			width;
+	int			height;
+	int			bytesPerSample;
+	int			planes;
+	int			blockCnt;
+	int			firstBlock;
+	int			blockStep;
+	uint8_t		*blockData;				//*	compress: start of the slots, decode: start of the blocks
+	size_t		slotLen;
+	uint32_t	*blockLengths;
+	size_t		*blockOffsets;			//*	decode only
+	bool		decodeOK;
+} TYPE_COMPRESS_JOB;
+
+//*****************************************************************************
+static inline void	PutBits(TYPE_BIT_WRITER *writer, const uint32_t value, const int bitCnt)
+{
+	//*	bitCnt is never more than 16, so 7 left over + 16 fits
+	writer->bitBuff	=	(writer->bitBuff << bitCnt) | (value & ((1 << bitCnt) - 1));
+	writer->bitCnt	+=	bitCnt;
+	while (writer->bitCnt >= 8)
+	{
+		writer->bitCnt	-=	8;
+		*writer->ptr++	=	(writer->bitBuff >> writer->bitCnt) & 0x00ff;
+	}
+}
+
+//*****************************************************************************
+static void	PutUnary(TYPE_BIT_WRITER *writer, uint32_t zeroCnt)
+{
+	while (zeroCnt >= 16)
+	{
+		PutBits(writer, 0, 16);
+		zeroCnt	-=	16;
+	}
+	PutBits(writer, 1, zeroCnt + 1);
+}
+
+//*****************************************************************************
+static void	FlushBits(TYPE_BIT_WRITER *writer)
+{
+	if (writer->bitCnt > 0)
+	{
+		PutBits(writer, 0, 8 - writer->bitCnt);
+	}
+}
+
+//*****************************************************************************
+static inline uint32_t	GetBits(TYPE_BIT_READER *reader, const int bitCnt)
+{
+	while (reader->bitCnt < bitCnt)
+	{
+		reader->bitBuff	<<=	8;
+		if (reader->ptr < reader->endPtr)
+		{
+			reader->bitBuff	|=	*reader->ptr++;
+		}
+		else
+		{
+			reader->overrun	=	true;
+		}
+		reader->bitCnt	+=	8;
+	}
+	reader->bitCnt	-=	bitCnt;
+	return((reader->bitBuff >> reader->bitCnt) & ((1 << bitCnt) - 1));
+}
+
+//*****************************************************************************
+static uint32_t	GetUnary(TYPE_BIT_READER *reader)
+{
+uint32_t	zeroCnt;
+
+	zeroCnt	=	0;
+	while ((GetBits(reader, 1) == 0) && (reader->overrun == false))
+	{
+		zeroCnt++;
+	}
+	return(zeroCnt);
+}
+
+//*****************************************************************************
+static inline uint32_t	GetSample(const uint8_t *pixelData, const int bytesPerSample, const size_t index)
+{
+	if (bytesPerSample == 2)
+	{
+		return(((const uint16_t *)pixelData)[index]);
+	}
+	return(pixelData[index]);
+}
+
+//*****************************************************************************
+static inline void	SetSample(uint8_t *pixelData, const int bytesPerSample, const size_t index, const uint32_t value)
+{
+	if (bytesPerSample == 2)
+	{
+		((uint16_t *)pixelData)[index]	=	value;
+	}
+	else
+	{
+		pixelData[index]	=	value;
+	}
+}
+
+//*****************************************************************************
+//*	codes sampleCnt samples starting at startIdx, stepping by sampleStep
+//*****************************************************************************
+static void	RiceEncodeStream(	TYPE_BIT_WRITER	*writer,
+								const uint8_t	*pixelData,
+								const int		bytesPerSample,
+								const size_t	startIdx,
+								const size_t	sampleCnt,
+								const int		sampleStep)
+{
+uint32_t	foldedList[kRice_GroupSize];
+uint32_t	lastValue;
+uint32_t	currentValue;
+uint32_t	sampleMask;
+uint32_t	pixelSum;
+uint32_t	codedBits;
+uint32_t	rawBits;
+int32_t		difference;
+int32_t		meanValue;
+int			sampleBits;
+int			fsBits;
+int			fsMax;
+int			fs;
+int			groupCnt;
+int			ii;
+size_t		sampleIdx;
+size_t		doneCnt;
+
+	if (bytesPerSample == 2)
+	{
+		sampleBits	=	16;
+		fsBits		=	4;
+		fsMax		=	14;
+	}
+	else
+	{
+		sampleBits	=	8;
+		fsBits		=	3;
+		fsMax		=	6;
+	}
+	sampleMask	=	(1 << sampleBits) - 1;
+
+	//*	the first one goes as is
+	lastValue	=	GetSample(pixelData, bytesPerSample, startIdx);
+	PutBits(writer, lastValue, sampleBits);
+
+	sampleIdx	=	startIdx + sampleStep;
+	doneCnt		=	1;
+	while (doneCnt < sampleCnt)
+	{
+		groupCnt	=	kRice_GroupSize;
+		if ((sampleCnt - doneCnt) < kRice_GroupSize)
+		{
+			groupCnt	=	sampleCnt - doneCnt;
+		}
+
+		pixelSum	=	0;
+		for (ii=0; ii<groupCnt; ii++)
+		{
+			currentValue	=	GetSample(pixelData, bytesPerSample, sampleIdx);
+			//*	the difference wraps around the same as the sample does
+			difference		=	(currentValue - lastValue) & sampleMask;
+			if (difference & (1 << (sampleBits - 1)))
+			{
+				difference	-=	(1 << sampleBits);
+			}
+			foldedList[ii]	=	(difference < 0) ? ~(difference << 1) : (difference << 1);
+			pixelSum		+=	foldedList[ii];
+			lastValue		=	currentValue;
+			sampleIdx		+=	sampleStep;
+		}
+
+		//*	split point from the mean
+		meanValue	=	((int32_t)pixelSum - (groupCnt / 2) - 1) / groupCnt;
+		if (meanValue < 0)
+		{
+			meanValue	=	0;
+		}
+		meanValue	=	meanValue >> 1;
+		for (fs=0; meanValue > 0; fs++)
+		{
+			meanValue	>>=	1;
+		}
+
+		rawBits		=	groupCnt * sampleBits;
+		codedBits	=	rawBits + 1;
+		if (fs < fsMax)
+		{
+			codedBits	=	0;
+			for (ii=0; ii<groupCnt; ii++)
+			{
+				codedBits	+=	(foldedList[ii] >> fs) + 1 + fs;
+			}
+		}
+
+		if (pixelSum == 0)
+		{
+			PutBits(writer, 0, fsBits);
+		}
+		else if (codedBits > rawBits)
+		{
+			PutBits(writer, fsMax + 1, fsBits);
+			for (ii=0; ii<groupCnt; ii++)
+			{
+				PutBits(writer, foldedList[ii], sampleBits);
+			}
+		}
+		else
+		{
+			PutBits(writer, fs + 1, fsBits);
+			for (ii=0; ii<groupCnt; ii++)
+			{
+				PutUnary(writer, foldedList[ii] >> fs);
+				if (fs > 0)
+				{
+					PutBits(writer, foldedList[ii], fs);
+				}
+			}
+		}
+		doneCnt	+=	groupCnt;
+	}
+}
+
+//*****************************************************************************
+static void	RiceDecodeStream(	TYPE_BIT_READER	*reader,
+								uint8_t			*pixelData,
+								const int		bytesPerSample,
+								const size_t	startIdx,
+								const size_t	sampleCnt,
+								const int		sampleStep)
+{
+uint32_t	lastValue;
+uint32_t	sampleMask;
+uint32_t	foldedValue;
+int32_t		difference;
+int			sampleBits;
+int			fsBits;
+int			fsMax;
+int			fsCode;
+int			fs;
+int			groupCnt;
+int			ii;
+size_t		sampleIdx;
+size_t		doneCnt;
+
+	if (bytesPerSample == 2)
+	{
+		sampleBits	=	16;
+		fsBits		=	4;
+		fsMax		=	14;
+	}
+	else
+	{
+		sampleBits	=	8;
+		fsBits		=	3;
+		fsMax		=	6;
+	}
+	sampleMask	=	(1 << sampleBits) - 1;
+
+	lastValue	=	GetBits(reader, sampleBits);
+	SetSample(pixelData, bytesPerSample, startIdx, lastValue);
+
+	sampleIdx	=	startIdx + sampleStep;
+	doneCnt		=	1;
+	while ((doneCnt < sampleCnt) && (reader->overrun == false))
+	{
+		groupCnt	=	kRice_GroupSize;
+		if ((sampleCnt - doneCnt) < kRice_GroupSize)
+		{
+			groupCnt	=	sampleCnt - doneCnt;
+		}
+		fsCode	=	GetBits(reader, fsBits);
+		fs		=	fsCode - 1;
+		for (ii=0; ii<groupCnt; ii++)
+		{
+			if (fsCode == 0)
+			{
+				foldedValue	=	0;
+			}
+			else if (fsCode == (fsMax + 1))
+			{
+				foldedValue	=	GetBits(reader, sampleBits);
+			}
+			else
+			{
+				foldedValue	=	GetUnary(reader) << fs;
+				if (fs > 0)
+				{
+					foldedValue	|=	GetBits(reader, fs);
+				}
+			}
+			difference	=	(foldedValue & 1) ? ~(foldedValue >> 1) : (foldedValue >> 1);
+			lastValue	=	(lastValue + difference) & sampleMask;
+			SetSample(pixelData, bytesPerSample, sampleIdx, lastValue);
+			sampleIdx	+=	sampleStep;
+		}
+		doneCnt	+=	groupCnt;
+	}
+}
+
+//*****************************************************************************
+static void	GetBlockRows(const TYPE_COMPRESS_JOB *job, const int blockIdx, int *firstRow, int *rowCnt)
+{
+	*firstRow	=	blockIdx * kImageCompress_BlockRows;
+	*rowCnt		=	job->height - *firstRow;
+	if (*rowCnt > kImageCompress_BlockRows)
+	{
+		*rowCnt	=	kImageCompress_BlockRows;
+	}
+}
+
+//*****************************************************************************
+static void	CompressBlocks(TYPE_COMPRESS_JOB *job)
+{
+TYPE_BIT_WRITER	writer;
+int				blockIdx;
+int				firstRow;
+int				rowCnt;
+int				plane;
+uint8_t			*slotPtr;
+
+	for (blockIdx=job->firstBlock; blockIdx<job->blockCnt; blockIdx += job->blockStep)
+	{
+		GetBlockRows(job, blockIdx, &firstRow, &rowCnt);
+		slotPtr			=	job->blockData + (blockIdx * job->slotLen);
+		writer.ptr		=	slotPtr;
+		writer.bitBuff	=	0;
+		writer.bitCnt	=	0;
+		for (plane=0; plane<job->planes; plane++)
+		{
+			RiceEncodeStream(	&writer,
+								job->pixelData,
+								job->bytesPerSample,
+								((size_t)firstRow * job->width * job->planes) + plane,
+								(size_t)rowCnt * job->width,
+								job->planes);
+		}
+		FlushBits(&writer);
+		job->blockLengths[blockIdx]	=	writer.ptr - slotPtr;
+	}
+}
+
+//*****************************************************************************
+static void	DecodeBlocks(TYPE_COMPRESS_JOB *job)
+{
+TYPE_BIT_READER	reader;
+int				blockIdx;
+int				firstRow;
+int				rowCnt;
+int				plane;
+
+	job->decodeOK	=	true;
+	for (blockIdx=job->firstBlock; blockIdx<job->blockCnt; blockIdx += job->blockStep)
+	{
+		GetBlockRows(job, blockIdx, &firstRow, &rowCnt);
+		reader.ptr		=	job->blockData + job->blockOffsets[blockIdx];
+		reader.endPtr	=	reader.ptr + job->blockLengths[blockIdx];
+		reader.bitBuff	=	0;
+		reader.bitCnt	=	0;
+		reader.overrun	=	false;
+		for (plane=0; plane<job->planes; plane++)
+		{
+			RiceDecodeStream(	&reader,
+								job->pixelData,
+								job->bytesPerSample,
+								((size_t)firstRow * job->width * job->planes) + plane,
+								(size_t)rowCnt * job->width,
+								job->planes);
+		}
+		if (reader.overrun)
+		{
+			job->decodeOK	=	false;
+		}
+	}
+}
+
+//*****************************************************************************
+static void	*CompressThread(void *arg)
+{
+	CompressBlocks((TYPE_COMPRESS_JOB *)arg);
+	return(NULL);
+}
+
+//*****************************************************************************
+static void	*DecodeThread(void *arg)
+{
+	DecodeBlocks((TYPE_COMPRESS_JOB *)arg);
+	return(NULL);
+}
+
+//*****************************************************************************
+static int	GetThreadCount(const int blockCnt)
+{
+int		threadCnt;
+
+	threadCnt	=	sysconf(_SC_NPROCESSORS_ONLN);
+	if (threadCnt > kImageCompress_MaxThreads)
+	{
+		threadCnt	=	kImageCompress_MaxThreads;
+	}
+	if (threadCnt > blockCnt)
+	{
+		threadCnt	=	blockCnt;
+	}
+	if (threadCnt < 1)
+	{
+		threadCnt	=	1;
+	}
+	return(threadCnt);
+}
+
+//*****************************************************************************
+//*	the calling thread does the first set of blocks
+//*****************************************************************************
+static void	RunJobs(TYPE_COMPRESS_JOB *jobList, const int threadCnt, const bool decode)
+{
+pthread_t	threadID[kImageCompress_MaxThreads];
+bool		threadOK[kImageCompress_MaxThreads];
+int			ii;
+
+	threadOK[0]	=	false;
+	for (ii=1; ii<threadCnt; ii++)
+	{
+		threadOK[ii]	=	(pthread_create(&threadID[ii], NULL, (decode ? &DecodeThread : &CompressThread), &jobList[ii]) == 0);
+		if (threadOK[ii] == false)
+		{
+			//*	do it ourselves
+			if (decode)
+			{
+				DecodeBlocks(&jobList[ii]);
+			}
+			else
+			{
+				CompressBlocks(&jobList[ii]);
+			}
+		}
+	}
+	if (decode)
+	{
+		DecodeBlocks(&jobList[0]);
+	}
+	else
+	{
+		CompressBlocks(&jobList[0]);
+	}
+	for (ii=1; ii<threadCnt; ii++)
+	{
+		if (threadOK[ii])
+		{
+			pthread_join(threadID[ii], NULL);
+		}
+	}
+}
+
+//*****************************************************************************
+//*	the output buffer in compImage is reused from frame to frame
+//*****************************************************************************
+bool	ImageCompress_Rice(	TYPE_COMPRESSED_IMAGE	*compImage,
+							const void				*imageData,
+							const int				width,
+							const int				height,
+							const int				bytesPerSample,
+							const int				planes,
+							const uint32_t			frameNumber)
+{
+TYPE_COMPRESS_JOB		jobList[kImageCompress_MaxThreads];
+TYPE_COMPRESS_HEADER	compHeader;
+struct timespec			startTime;
+struct timespec			endTime;
+uint32_t				*blockLengths;
+uint8_t					*slotData;
+uint8_t					*outputPtr;
+size_t					samplesPerBlock;
+size_t					slotLen;
+size_t					neededLen;
+size_t					tableLen;
+uint64_t				rawLength;
+int						blockCnt;
+int						threadCnt;
+int						ii;
+
+	compImage->valid	=	false;
+	if ((imageData == NULL) || (width < 1) || (height < 1) ||
+		(width > kImageCompress_MaxDimension) || (height > kImageCompress_MaxDimension) ||
+		((bytesPerSample != 1) && (bytesPerSample != 2)) || (planes < 1) || (planes > 4))
+	{
+		return(false);
+	}
+	rawLength	=	(uint64_t)width * height * bytesPerSample * planes;
+	if (rawLength > UINT32_MAX)
+	{
+		CONSOLE_DEBUG("Image is too large for the compressed header");
+		return(false);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+	blockCnt		=	(height + kImageCompress_BlockRows - 1) / kImageCompress_BlockRows;
+	samplesPerBlock	=	(size_t)kImageCompress_BlockRows * width;
+	//*	worst case is every group sent raw, plus the fs code for every group
+	slotLen			=	planes * (((samplesPerBlock * bytesPerSample * 8) +
+									(((samplesPerBlock / kRice_GroupSize) + 1) * 4) + 7) / 8 + 2);
+	tableLen		=	blockCnt * sizeof(uint32_t);
+	neededLen		=	sizeof(TYPE_COMPRESS_HEADER) + tableLen + (blockCnt * slotLen);
+
+	if (compImage->buffLen < neededLen)
+	{
+		if (compImage->data != NULL)
+		{
+			free(compImage->data);
+		}
+		compImage->buffLen	=	0;
+		compImage->data		=	(uint8_t *)malloc(neededLen);
+		if (compImage->data == NULL)
+		{
+			CONSOLE_DEBUG("Failed to allocate compression buffer");
+			return(false);
+		}
+		compImage->buffLen	=	neededLen;
+	}
+	blockLengths	=	(uint32_t *)(compImage->data + sizeof(TYPE_COMPRESS_HEADER));
+	slotData		=	compImage->data + sizeof(TYPE_COMPRESS_HEADER) + tableLen;
+
+	threadCnt	=	GetThreadCount(blockCnt);
+	memset(&jobList[0], 0, sizeof(TYPE_COMPRESS_JOB));
+	jobList[0].pixelData		=	(uint8_t *)imageData;
+	jobList[0].width			=	width;
+	jobList[0].height			=	height;
+	jobList[0].bytesPerSample	=	bytesPerSample;
+	jobList[0].planes			=	planes;
+	jobList[0].blockCnt			=	blockCnt;
+	jobList[0].blockStep		=	threadCnt;
+	jobList[0].blockData		=	slotData;
+	jobList[0].slotLen			=	slotLen;
+	jobList[0].blockLengths		=	blockLengths;
+	for (ii=0; ii<threadCnt; ii++)
+	{
+		jobList[ii]				=	jobList[0];
+		jobList[ii].firstBlock	=	ii;
+	}
+	RunJobs(jobList, threadCnt, false);
+
+	//*	close up the gaps between the slots, everything moves toward the front
+	outputPtr	=	slotData;
+	for (ii=0; ii<blockCnt; ii++)
+	{
+		memmove(outputPtr, slotData + (ii * slotLen), blockLengths[ii]);
+		outputPtr	+=	blockLengths[ii];
+	}
+
+	memset(&compHeader, 0, sizeof(TYPE_COMPRESS_HEADER));
+	memcpy(compHeader.signature, kImageCompress_Signature, 4);
+	compHeader.version			=	kImageCompress_Version;
+	compHeader.width			=	width;
+	compHeader.height			=	height;
+	compHeader.bytesPerSample	=	bytesPerSample;
+	compHeader.planes			=	planes;
+	compHeader.blockRows		=	kImageCompress_BlockRows;
+	compHeader.blockCnt			=	blockCnt;
+	compHeader.frameNumber		=	frameNumber;
+	compHeader.rawLength		=	(uint32_t)rawLength;
+	memcpy(compImage->data, &compHeader, sizeof(TYPE_COMPRESS_HEADER));
+
+	clock_gettime(CLOCK_MONOTONIC, &endTime);
+	compImage->dataLen		=	outputPtr - compImage->data;
+	compImage->rawLength	=	compHeader.rawLength;
+	compImage->frameNumber	=	frameNumber;
+	compImage->compress_us	=	((endTime.tv_sec - startTime.tv_sec) * 1000000) +
+								((endTime.tv_nsec - startTime.tv_nsec) / 1000);
+	compImage->valid		=	true;
+	return(true);
+}
+
+//*****************************************************************************
+bool	ImageCompress_GetHeader(const uint8_t			*compData,
+								const size_t			compLen,
+								TYPE_COMPRESS_HEADER	*compHeader)
+{
+uint64_t	rawLength;
+
+	if ((compData == NULL) || (compLen < sizeof(TYPE_COMPRESS_HEADER)))
+	{
+		return(false);
+	}
+	memcpy(compHeader, compData, sizeof(TYPE_COMPRESS_HEADER));
+	if ((memcmp(compHeader->signature, kImageCompress_Signature, 4) != 0) ||
+		(compHeader->version != kImageCompress_Version))
+	{
+		return(false);
+	}
+	//*	the header comes off the network, bound it before anyone allocates rawLength bytes
+	if ((compHeader->width < 1) || (compHeader->height < 1) ||
+		(compHeader->width > kImageCompress_MaxDimension) ||
+		(compHeader->height > kImageCompress_MaxDimension) ||
+		((compHeader->bytesPerSample != 1) && (compHeader->bytesPerSample != 2)) ||
+		(compHeader->planes < 1) || (compHeader->planes > 4) ||
+		(compHeader->blockRows != kImageCompress_BlockRows) ||
+		(compHeader->blockCnt != ((compHeader->height + kImageCompress_BlockRows - 1) / kImageCompress_BlockRows)))
+	{
+		return(false);
+	}
+	rawLength	=	(uint64_t)compHeader->width * compHeader->height * compHeader->bytesPerSample * compHeader->planes;
+	if (rawLength != compHeader->rawLength)
+	{
+		return(false);
+	}
+	return(true);
+}
+
+//*****************************************************************************
+bool	ImageCompress_Decode(	const uint8_t	*compData,
+								const size_t	compLen,
+								void			*imageData,
+								const size_t	imageBuffLen)
+{
+TYPE_COMPRESS_JOB		jobList[kImageCompress_MaxThreads];
+TYPE_COMPRESS_HEADER	compHeader;
+uint32_t				*blockLengths;
+size_t					*blockOffsets;
+size_t					tableLen;
+size_t					totalLen;
+int						threadCnt;
+int						ii;
+bool					decodeOK;
+
+	if ((ImageCompress_GetHeader(compData, compLen, &compHeader) == false) ||
+		(imageData == NULL) || (imageBuffLen < compHeader.rawLength))
+	{
+		return(false);
+	}
+	tableLen	=	compHeader.blockCnt * sizeof(uint32_t);
+	if (compLen < (sizeof(TYPE_COMPRESS_HEADER) + tableLen))
+	{
+		return(false);
+	}
+	blockLengths	=	(uint32_t *)malloc(tableLen);
+	blockOffsets	=	(size_t *)malloc(compHeader.blockCnt * sizeof(size_t));
+	decodeOK		=	false;
+	if ((blockLengths != NULL) && (blockOffsets != NULL))
+	{
+		memcpy(blockLengths, compData + sizeof(TYPE_COMPRESS_HEADER), tableLen);
+		totalLen	=	0;
+		for (ii=0; ii<(int)compHeader.blockCnt; ii++)
+		{
+			blockOffsets[ii]	=	totalLen;
+			totalLen			+=	blockLengths[ii];
+		}
+		if ((sizeof(TYPE_COMPRESS_HEADER) + tableLen + totalLen) <= compLen)
+		{
+			threadCnt	=	GetThreadCount(compHeader.blockCnt);
+			memset(&jobList[0], 0, sizeof(TYPE_COMPRESS_JOB));
+			jobList[0].pixelData		=	(uint8_t *)imageData;
+			jobList[0].width			=	compHeader.width;
+			jobList[0].height			=	compHeader.height;
+			jobList[0].bytesPerSample	=	compHeader.bytesPerSample;
+			jobList[0].planes			=	compHeader.planes;
+			jobList[0].blockCnt			=	compHeader.blockCnt;
+			jobList[0].blockStep		=	threadCnt;
+			jobList[0].blockData		=	(uint8_t *)compData + sizeof(TYPE_COMPRESS_HEADER) + tableLen;
+			jobList[0].blockLengths		=	blockLengths;
+			jobList[0].blockOffsets		=	blockOffsets;
+			for (ii=0; ii<threadCnt; ii++)
+			{
+				jobList[ii]				=	jobList[0];
+				jobList[ii].firstBlock	=	ii;
+			}
+			RunJobs(jobList, threadCnt, true);
+
+			decodeOK	=	true;
+			for (ii=0; ii<threadCnt; ii++)
+			{
+				if (jobList[ii].decodeOK == false)
+				{
+					decodeOK	=	false;
+				}
+			}
+		}
+	}
+	if (blockLengths != NULL)
+	{
+		free(blockLengths);
+	}
+	if (blockOffsets != NULL)
+	{
+		free(blockOffsets);
+	}
+	return(decodeOK);
+}
+
+//*****************************************************************************
+void	ImageCompress_Free(TYPE_COMPRESSED_IMAGE *compImage)
+{
+	if (compImage->data != NULL)
+	{
+		free(compImage->data);
+	}
+	memset(compImage, 0, sizeof(TYPE_COMPRESSED_IMAGE));
+}
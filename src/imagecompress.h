@@ -0,0 +1,91 @@
+//**************************************************************************
+//*	Name:			imagecompress.h
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Lossless Rice compression of image data for transfer
+//*
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb 28,	2021	<MLS> Created imagecompress.h
+//*	Mar 30,	2021	<MLS> Added kImageCompress_MaxDimension
+//*****************************************************************************
+//#include	"imagecompress.h"
+
+#ifndef _IMAGECOMPRESS_H_
+#define	_IMAGECOMPRESS_H_
+
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<stddef.h>
+
+#define	kImageCompress_Signature		"ARCE"		//*	AlpacaPi Rice Compressed Encoding
+#define	kImageCompress_Version			1
+#define	kImageCompress_BlockRows		64			//*	rows per independently coded block
+#define	kImageCompress_MaxThreads		8
+#define	kImageCompress_MaxDimension		32768		//*	larger than any sensor, limits what a bad header can make us allocate
+#define	kImageCompress_ContentType		"application/x-alpacapi-rice"
+
+//*****************************************************************************
+//*	the stream starts with this header, followed by blockCnt uint32_t block
+//*	lengths, followed by the blocks. Everything is little endian.
+//*	The pixels are row major, planes interleaved, the same as the camera buffer.
+typedef struct
+{
+	char		signature[4];
+	uint32_t	version;
+	uint32_t	width;
+	uint32_t	height;
+	uint32_t	bytesPerSample;			//*	1 or 2
+	uint32_t	planes;					//*	1 = mono/raw, 3 = RGB24
+	uint32_t	blockRows;
+	uint32_t	blockCnt;
+	uint32_t	frameNumber;
+	uint32_t	rawLength;				//*	bytes after decompression
+} TYPE_COMPRESS_HEADER;
+
+//*****************************************************************************
+typedef struct
+{
+	bool		valid;
+	uint32_t	frameNumber;
+	uint8_t		*data;					//*	header + block table + blocks
+	size_t		dataLen;
+	size_t		buffLen;				//*	allocated size of data, kept between frames
+	uint32_t	rawLength;
+	uint32_t	compress_us;
+} TYPE_COMPRESSED_IMAGE;
+
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+bool	ImageCompress_Rice(		TYPE_COMPRESSED_IMAGE	*compImage,
+								const void				*imageData,
+								const int				width,
+								const int				height,
+								const int				bytesPerSample,
+								const int				planes,
+								const uint32_t			frameNumber);
+
+bool	ImageCompress_GetHeader(const uint8_t			*compData,
+								const size_t			compLen,
+								TYPE_COMPRESS_HEADER	*compHeader);
+
+//*	imageData must hold compHeader.rawLength bytes
+bool	ImageCompress_Decode(	const uint8_t			*compData,
+								const size_t			compLen,
+								void					*imageData,
+								const size_t			imageBuffLen);
+
+void	ImageCompress_Free(		TYPE_COMPRESSED_IMAGE	*compImage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//	_IMAGECOMPRESS_H_
@@ -0,0 +1,381 @@
+//**************************************************************************
+//*	Name:			imagepool.c
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Process wide pool of aligned image buffers
+//*
+//*					Image buffers are large and every camera used to free and malloc
+//*					them whenever the image size went up, and openCV images were
+//*					created and released on every frame. On a Pi with 1 or 2 gig of
+//*					memory a long session ends up with a badly fragmented heap.
+//*
+//*					Buffers handed out by the pool are 64 byte aligned and are kept
+//*					when they are released, the next request of the same or smaller
+//*					size gets the same memory back. Sizes are rounded up so that
+//*					small changes (ROI, image type) still reuse the buffer.
+//*
+//*					If huge pages are enabled (-H on the command line) buffers of
+//*					2 meg or more are mapped with MAP_HUGETLB, if the kernel does not
+//*					have any reserved we fall back to aligned memory and ask for
+//*					transparent huge pages.
+//*
+//*					When all of the slots are in use the request is not failed, the
+//*					buffer is allocated outside of the pool and kept on an overflow
+//*					list so ImagePool_Release() knows to free it instead of keeping it.
+//*
+//*					ImagePool_Trim() is called by the camera when the image size
+//*					goes up, the smaller buffers would never be used again.
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb 26,	2021	<MLS> Created imagepool.c
+//*	Mar 30,	2021	<MLS> Falls back to a plain allocation when all of the slots are in use
+//*	Mar 30,	2021	<MLS> Removed ImagePool_GetLength(), nobody used it
+//*****************************************************************************
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<pthread.h>
+#include	<sys/mman.h>
+
+#define _ENABLE_CONSOLE_DEBUG_
+#include	"ConsoleDebug.h"
+
+#include	"imagepool.h"
+
+//*	a free buffer more than this many times the request is left for someone else
+#define	kImagePool_MaxOversize		4
+#define	kImagePool_OverflowGrow		16
+
+//*****************************************************************************
+typedef struct
+{
+	void		*address;				//*	NULL if the slot is empty
+	size_t		length;
+	bool		inUse;
+	bool		hugePage;				//*	mmap'd, has to be munmap'd
+} TYPE_POOL_BUFFER;
+
+static TYPE_POOL_BUFFER			gPoolBuffers[kImagePool_MaxBuffers];
+static TYPE_POOL_BUFFER			*gOverflowBuffers	=	NULL;		//*	not kept, freed on release
+static int						gOverflowSlots		=	0;
+static TYPE_IMAGE_POOL_STATS	gPoolStats;
+static pthread_mutex_t			gPoolMutex	=	PTHREAD_MUTEX_INITIALIZER;
+
+//*****************************************************************************
+void	ImagePool_EnableHugePages(const bool enable)
+{
+	pthread_mutex_lock(&gPoolMutex);
+	gPoolStats.hugePagesEnabled	=	enable;
+	pthread_mutex_unlock(&gPoolMutex);
+}
+
+//*****************************************************************************
+static void	FreePoolBuffer(TYPE_POOL_BUFFER *poolBuffer)
+{
+	if (poolBuffer->hugePage)
+	{
+		munmap(poolBuffer->address, poolBuffer->length);
+		gPoolStats.hugePageCnt--;
+	}
+	else
+	{
+		free(poolBuffer->address);
+	}
+	gPoolStats.bytesAllocated	-=	poolBuffer->length;
+	gPoolStats.bufferCnt--;
+	memset(poolBuffer, 0, sizeof(TYPE_POOL_BUFFER));
+}
+
+//*****************************************************************************
+static bool	AllocatePoolBuffer(TYPE_POOL_BUFFER *poolBuffer, const size_t length)
+{
+void	*newBuffer;
+bool	hugePage;
+
+	newBuffer	=	NULL;
+	hugePage	=	false;
+	if (gPoolStats.hugePagesEnabled && (length >= kImagePool_HugePageSize))
+	{
+		newBuffer	=	mmap(NULL, length, (PROT_READ | PROT_WRITE),
+								(MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB), -1, 0);
+		if (newBuffer == MAP_FAILED)
+		{
+			newBuffer	=	NULL;
+		}
+		else
+		{
+			hugePage	=	true;
+		}
+	}
+	if (newBuffer == NULL)
+	{
+		if (posix_memalign(&newBuffer, kImagePool_Alignment, length) != 0)
+		{
+			newBuffer	=	NULL;
+		}
+	#ifdef MADV_HUGEPAGE
+		else if (gPoolStats.hugePagesEnabled && (length >= kImagePool_HugePageSize))
+		{
+			madvise(newBuffer, length, MADV_HUGEPAGE);
+		}
+	#endif
+	}
+	if (newBuffer != NULL)
+	{
+		poolBuffer->address		=	newBuffer;
+		poolBuffer->length		=	length;
+		poolBuffer->hugePage	=	hugePage;
+		gPoolStats.bufferCnt++;
+		gPoolStats.bytesAllocated	+=	length;
+		if (hugePage)
+		{
+			gPoolStats.hugePageCnt++;
+		}
+		if (gPoolStats.bytesAllocated > gPoolStats.highWater_allocated)
+		{
+			gPoolStats.highWater_allocated	=	gPoolStats.bytesAllocated;
+		}
+	}
+	return(newBuffer != NULL);
+}
+
+//*****************************************************************************
+//*	all of the slots are in use, the buffer goes on the overflow list, mutex is held
+//*****************************************************************************
+static void	*AllocateOverflowBuffer(const size_t length)
+{
+TYPE_POOL_BUFFER	*newList;
+int					overflowIdx;
+int					ii;
+void				*newBuffer;
+
+	overflowIdx	=	-1;
+	for (ii=0; ii<gOverflowSlots; ii++)
+	{
+		if (gOverflowBuffers[ii].address == NULL)
+		{
+			overflowIdx	=	ii;
+			break;
+		}
+	}
+	if (overflowIdx < 0)
+	{
+		newList	=	(TYPE_POOL_BUFFER *)realloc(gOverflowBuffers,
+											(gOverflowSlots + kImagePool_OverflowGrow) * sizeof(TYPE_POOL_BUFFER));
+		if (newList == NULL)
+		{
+			return(NULL);
+		}
+		memset(&newList[gOverflowSlots], 0, (kImagePool_OverflowGrow * sizeof(TYPE_POOL_BUFFER)));
+		overflowIdx			=	gOverflowSlots;
+		gOverflowBuffers	=	newList;
+		gOverflowSlots		+=	kImagePool_OverflowGrow;
+	}
+	newBuffer	=	NULL;
+	if (posix_memalign(&newBuffer, kImagePool_Alignment, length) != 0)
+	{
+		return(NULL);
+	}
+	gOverflowBuffers[overflowIdx].address	=	newBuffer;
+	gOverflowBuffers[overflowIdx].length	=	length;
+	gOverflowBuffers[overflowIdx].inUse		=	true;
+	gPoolStats.overflowInUse++;
+	gPoolStats.overflowCnt++;
+	return(newBuffer);
+}
+
+//*****************************************************************************
+//*	the memory is not cleared, same as malloc
+//*****************************************************************************
+void	*ImagePool_Alloc(const size_t length)
+{
+size_t				roundedLen;
+size_t				granule;
+int					ii;
+int					bestIdx;
+int					emptyIdx;
+TYPE_POOL_BUFFER	*poolBuffer;
+void				*returnPtr;
+
+	if (length == 0)
+	{
+		return(NULL);
+	}
+	pthread_mutex_lock(&gPoolMutex);
+	gPoolStats.allocCnt++;
+
+	granule		=	kImagePool_Granule;
+	if (gPoolStats.hugePagesEnabled && (length >= kImagePool_HugePageSize))
+	{
+		granule	=	kImagePool_HugePageSize;
+	}
+	roundedLen	=	((length + granule - 1) / granule) * granule;
+
+	//*	best fit from the buffers that are not being used
+	bestIdx		=	-1;
+	emptyIdx	=	-1;
+	for (ii=0; ii<kImagePool_MaxBuffers; ii++)
+	{
+		poolBuffer	=	&gPoolBuffers[ii];
+		if (poolBuffer->address == NULL)
+		{
+			if (emptyIdx < 0)
+			{
+				emptyIdx	=	ii;
+			}
+		}
+		else if ((poolBuffer->inUse == false) &&
+				(poolBuffer->length >= length) &&
+				(poolBuffer->length <= (roundedLen * kImagePool_MaxOversize)))
+		{
+			if ((bestIdx < 0) || (poolBuffer->length < gPoolBuffers[bestIdx].length))
+			{
+				bestIdx	=	ii;
+			}
+		}
+	}
+
+	if (bestIdx >= 0)
+	{
+		gPoolStats.reuseCnt++;
+	}
+	else
+	{
+		if (emptyIdx < 0)
+		{
+			//*	all of the slots are taken, give back a buffer nobody is using
+			for (ii=0; (ii<kImagePool_MaxBuffers) && (emptyIdx < 0); ii++)
+			{
+				if (gPoolBuffers[ii].inUse == false)
+				{
+					FreePoolBuffer(&gPoolBuffers[ii]);
+					emptyIdx	=	ii;
+				}
+			}
+		}
+		if ((emptyIdx >= 0) && AllocatePoolBuffer(&gPoolBuffers[emptyIdx], roundedLen))
+		{
+			bestIdx	=	emptyIdx;
+		}
+	}
+
+	returnPtr	=	NULL;
+	if (bestIdx >= 0)
+	{
+		poolBuffer			=	&gPoolBuffers[bestIdx];
+		poolBuffer->inUse	=	true;
+		returnPtr			=	poolBuffer->address;
+		gPoolStats.buffersInUse++;
+		gPoolStats.bytesInUse	+=	poolBuffer->length;
+		if (gPoolStats.bytesInUse > gPoolStats.highWater_bytes)
+		{
+			gPoolStats.highWater_bytes	=	gPoolStats.bytesInUse;
+		}
+	}
+	else if (emptyIdx < 0)
+	{
+		returnPtr	=	AllocateOverflowBuffer(length);
+		if (returnPtr == NULL)
+		{
+			gPoolStats.failCnt++;
+			CONSOLE_DEBUG_W_LONG("Image pool overflow allocation failed, length\t=", (long)length);
+		}
+	}
+	else
+	{
+		gPoolStats.failCnt++;
+		CONSOLE_DEBUG_W_LONG("Image pool allocation failed, length\t=", (long)length);
+	}
+	pthread_mutex_unlock(&gPoolMutex);
+	return(returnPtr);
+}
+
+//*****************************************************************************
+//*	the buffer stays in the pool for the next request, an overflow buffer is
+//*	freed. NULL is ok
+//*****************************************************************************
+void	ImagePool_Release(void *address)
+{
+int		ii;
+bool	foundIt;
+
+	if (address != NULL)
+	{
+		foundIt	=	false;
+		pthread_mutex_lock(&gPoolMutex);
+		for (ii=0; (ii<kImagePool_MaxBuffers) && (foundIt == false); ii++)
+		{
+			if (gPoolBuffers[ii].address == address)
+			{
+				foundIt	=	true;
+				if (gPoolBuffers[ii].inUse)
+				{
+					gPoolBuffers[ii].inUse	=	false;
+					gPoolStats.buffersInUse--;
+					gPoolStats.bytesInUse	-=	gPoolBuffers[ii].length;
+				}
+			}
+		}
+		for (ii=0; (ii<gOverflowSlots) && (foundIt == false); ii++)
+		{
+			if (gOverflowBuffers[ii].address == address)
+			{
+				foundIt	=	true;
+				free(gOverflowBuffers[ii].address);
+				memset(&gOverflowBuffers[ii], 0, sizeof(TYPE_POOL_BUFFER));
+				gPoolStats.overflowInUse--;
+			}
+		}
+		pthread_mutex_unlock(&gPoolMutex);
+		if (foundIt == false)
+		{
+			CONSOLE_DEBUG("Buffer is not from the image pool");
+		}
+	}
+}
+
+//*****************************************************************************
+//*	give the memory of all of the unused buffers back to the system
+//*****************************************************************************
+void	ImagePool_Trim(void)
+{
+int		ii;
+
+	pthread_mutex_lock(&gPoolMutex);
+	for (ii=0; ii<kImagePool_MaxBuffers; ii++)
+	{
+		if ((gPoolBuffers[ii].address != NULL) && (gPoolBuffers[ii].inUse == false))
+		{
+			FreePoolBuffer(&gPoolBuffers[ii]);
+		}
+	}
+	pthread_mutex_unlock(&gPoolMutex);
+}
+
+//*****************************************************************************
+void	ImagePool_GetStats(TYPE_IMAGE_POOL_STATS *poolStats)
+{
+	pthread_mutex_lock(&gPoolMutex);
+	*poolStats	=	gPoolStats;
+	pthread_mutex_unlock(&gPoolMutex);
+}
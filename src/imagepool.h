@@ -0,0 +1,63 @@
+//**************************************************************************
+//*	Name:			imagepool.h
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Process wide pool of aligned image buffers
+//*
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb 26,	2021	<MLS> Created imagepool.h
+//*	Mar 30,	2021	<MLS> Removed ImagePool_GetLength(), added overflow stats
+//*****************************************************************************
+//#include	"imagepool.h"
+
+#ifndef _IMAGEPOOL_H_
+#define	_IMAGEPOOL_H_
+
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<stddef.h>
+
+#define	kImagePool_Alignment		64					//*	cache line, also good for NEON/AVX loads
+#define	kImagePool_MaxBuffers		64
+#define	kImagePool_Granule			(64 * 1024)			//*	sizes are rounded up to this
+#define	kImagePool_HugePageSize		(2 * 1024 * 1024)
+
+//*****************************************************************************
+typedef struct
+{
+	bool		hugePagesEnabled;
+	uint32_t	bufferCnt;				//*	buffers the pool owns
+	uint32_t	buffersInUse;
+	uint32_t	hugePageCnt;			//*	buffers that actually got huge pages
+	size_t		bytesAllocated;
+	size_t		bytesInUse;
+	size_t		highWater_bytes;		//*	most bytes ever in use at one time
+	size_t		highWater_allocated;	//*	most bytes ever owned by the pool
+	uint32_t	allocCnt;				//*	requests
+	uint32_t	reuseCnt;				//*	requests satisfied with an existing buffer
+	uint32_t	failCnt;
+	uint32_t	overflowInUse;			//*	malloc'd because all of the slots were in use
+	uint32_t	overflowCnt;			//*	requests that had to overflow
+} TYPE_IMAGE_POOL_STATS;
+
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+void		ImagePool_EnableHugePages(const bool enable);
+void		*ImagePool_Alloc(const size_t length);
+void		ImagePool_Release(void *address);
+void		ImagePool_Trim(void);
+void		ImagePool_GetStats(TYPE_IMAGE_POOL_STATS *poolStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//	_IMAGEPOOL_H_
@@ -0,0 +1,286 @@
+//**************************************************************************
+//*	Name:			imagepyramid.c
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Multi level 2x2 reduced copies of an image
+//*
+//*					Live view, the sidebar histogram, the JPEG preview and the
+//*					thumbnails all want a small version of the same frame. Each of
+//*					them used to scale the full resolution image on its own.
+//*					The pyramid is built once per frame and they all pick a level.
+//*
+//*					Level 0 is made from the source with ImageBin_Downsample(),
+//*					that is the only pass over the full frame. Each level after
+//*					that is made from the one before it, so the whole pyramid
+//*					costs about 1 1/3 times the first level.
+//*
+//*					The 2x2 reduction is done like the binning, the two source rows
+//*					are added element by element (vector instructions, NEON on the
+//*					Pi, SSE/AVX on x86) and then the column pairs are added.
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Mar 18,	2021	<MLS> Created imagepyramid.c
+//*	Mar 30,	2021	<MLS> Added AddColumns(), the 2x2 reduce vectorizes at -O3
+//*****************************************************************************
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<stdint.h>
+#include	<stdbool.h>
+
+#include	"imagebin.h"
+#include	"imagepyramid.h"
+
+//*****************************************************************************
+static void	AddRows16(	uint32_t *__restrict__			sumRow,
+						const uint16_t *__restrict__	srcRow1,
+						const uint16_t *__restrict__	srcRow2,
+						const int						count)
+{
+int		ii;
+
+	for (ii=0; ii<count; ii++)
+	{
+		sumRow[ii]	=	(uint32_t)srcRow1[ii] + srcRow2[ii];
+	}
+}
+
+//*****************************************************************************
+//*	called with planes as a constant, once inlined the loop vectorizes
+//*****************************************************************************
+static inline void	AddColumns(	uint16_t *__restrict__			dstRow,
+								const uint32_t *__restrict__	sumRow,
+								const int						dstWidth,
+								const int						planes)
+{
+int		xxx;
+int		ppp;
+
+	for (xxx=0; xxx<dstWidth; xxx++)
+	{
+		for (ppp=0; ppp<planes; ppp++)
+		{
+			//*	+2 rounds instead of truncating, otherwise each level gets darker
+			dstRow[(xxx * planes) + ppp]	=	(sumRow[(2 * xxx * planes) + ppp] + sumRow[(((2 * xxx) + 1) * planes) + ppp] + 2) >> 2;
+		}
+	}
+}
+
+//*****************************************************************************
+static void	Reduce2x2(	const uint16_t	*srcData,
+						const int		srcWidth,
+						const int		planes,
+						uint16_t		*dstData,
+						const int		dstWidth,
+						const int		dstHeight,
+						uint32_t		*sumRow)
+{
+int			srcRowLen;
+int			yyy;
+uint16_t	*dstPtr;
+
+	srcRowLen	=	srcWidth * planes;
+	dstPtr		=	dstData;
+	for (yyy=0; yyy<dstHeight; yyy++)
+	{
+		AddRows16(	sumRow,
+					srcData + ((long)(2 * yyy) * srcRowLen),
+					srcData + ((long)((2 * yyy) + 1) * srcRowLen),
+					(2 * dstWidth * planes));
+		if (planes == 3)
+		{
+			AddColumns(dstPtr, sumRow, dstWidth, 3);
+		}
+		else
+		{
+			AddColumns(dstPtr, sumRow, dstWidth, 1);
+		}
+		dstPtr	+=	dstWidth * planes;
+	}
+}
+
+//*****************************************************************************
+//*	makes sure the level buffer can hold width x height x planes samples
+//*****************************************************************************
+static bool	AllocateLevel(TYPE_IMAGE_PYRAMID *pyramid, const int level, const int width, const int height)
+{
+long		levelSize;
+uint16_t	*newBuffer;
+
+	levelSize	=	(long)width * height * pyramid->planes;
+	if (pyramid->levelBufLen[level] < levelSize)
+	{
+		newBuffer	=	(uint16_t *)realloc(pyramid->levelData[level], levelSize * sizeof(uint16_t));
+		if (newBuffer == NULL)
+		{
+			return(false);
+		}
+		pyramid->levelData[level]	=	newBuffer;
+		pyramid->levelBufLen[level]	=	levelSize;
+	}
+	pyramid->width[level]	=	width;
+	pyramid->height[level]	=	height;
+	return(true);
+}
+
+//*****************************************************************************
+bool	ImagePyramid_Build(	TYPE_IMAGE_PYRAMID	*pyramid,
+							const void			*srcData,
+							const int			srcWidth,
+							const int			srcHeight,
+							const int			bytesPerPixel,
+							const int			planes,
+							const bool			swapRedBlue)
+{
+uint32_t	*sumRow;
+long		levelSize;
+long		ii;
+uint16_t	*levelPtr;
+uint16_t	tempValue;
+int			level;
+int			newWidth;
+int			newHeight;
+bool		binOK;
+
+	pyramid->valid		=	false;
+	pyramid->levelCnt	=	0;
+	if ((srcData == NULL) || ((srcWidth / 2) < kPyramid_MinDimension) || ((srcHeight / 2) < kPyramid_MinDimension) ||
+		((bytesPerPixel != 1) && (bytesPerPixel != 2)) || ((planes != 1) && (planes != 3)))
+	{
+		return(false);
+	}
+	pyramid->planes		=	planes;
+	pyramid->bitDepth	=	bytesPerPixel * 8;
+
+	//*	level 0, straight from the source
+	if (AllocateLevel(pyramid, 0, (srcWidth / 2), (srcHeight / 2)) == false)
+	{
+		return(false);
+	}
+	binOK	=	ImageBin_Downsample(	srcData,
+										srcWidth,
+										srcHeight,
+										bytesPerPixel,
+										planes,
+										2,
+										false,
+										pyramid->levelData[0]);
+	if (binOK == false)
+	{
+		return(false);
+	}
+	if (swapRedBlue && (planes == 3))
+	{
+		levelPtr	=	pyramid->levelData[0];
+		levelSize	=	(long)pyramid->width[0] * pyramid->height[0] * planes;
+		for (ii=0; ii<levelSize; ii+=3)
+		{
+			tempValue			=	levelPtr[ii];
+			levelPtr[ii]		=	levelPtr[ii + 2];
+			levelPtr[ii + 2]	=	tempValue;
+		}
+	}
+	pyramid->levelCnt	=	1;
+
+	//*	the rest of the levels, each from the one before it
+	sumRow	=	(uint32_t *)malloc((long)pyramid->width[0] * planes * sizeof(uint32_t));
+	if (sumRow != NULL)
+	{
+		for (level=1; level<kPyramid_MaxLevels; level++)
+		{
+			newWidth	=	pyramid->width[level - 1] / 2;
+			newHeight	=	pyramid->height[level - 1] / 2;
+			if ((newWidth < kPyramid_MinDimension) || (newHeight < kPyramid_MinDimension))
+			{
+				break;
+			}
+			if (AllocateLevel(pyramid, level, newWidth, newHeight) == false)
+			{
+				break;
+			}
+			Reduce2x2(	pyramid->levelData[level - 1],
+						pyramid->width[level - 1],
+						planes,
+						pyramid->levelData[level],
+						newWidth,
+						newHeight,
+						sumRow);
+			pyramid->levelCnt++;
+		}
+		free(sumRow);
+	}
+	pyramid->valid	=	true;
+	return(true);
+}
+
+//*****************************************************************************
+void	ImagePyramid_Release(TYPE_IMAGE_PYRAMID *pyramid)
+{
+int		level;
+
+	for (level=0; level<kPyramid_MaxLevels; level++)
+	{
+		if (pyramid->levelData[level] != NULL)
+		{
+			free(pyramid->levelData[level]);
+		}
+	}
+	memset(pyramid, 0, sizeof(TYPE_IMAGE_PYRAMID));
+}
+
+//*****************************************************************************
+int	ImagePyramid_LevelForFactor(const TYPE_IMAGE_PYRAMID *pyramid, const int binFactor)
+{
+int		level;
+int		levelFactor;
+
+	if (pyramid->valid)
+	{
+		levelFactor	=	2;
+		for (level=0; level<pyramid->levelCnt; level++)
+		{
+			if (levelFactor == binFactor)
+			{
+				return(level);
+			}
+			levelFactor	*=	2;
+		}
+	}
+	return(-1);
+}
+
+//*****************************************************************************
+int	ImagePyramid_LevelForSize(const TYPE_IMAGE_PYRAMID *pyramid, const int width, const int height)
+{
+int		level;
+
+	if (pyramid->valid)
+	{
+		for (level=0; level<pyramid->levelCnt; level++)
+		{
+			if ((pyramid->width[level] == width) && (pyramid->height[level] == height))
+			{
+				return(level);
+			}
+		}
+	}
+	return(-1);
+}
@@ -0,0 +1,67 @@
+//**************************************************************************
+//*	Name:			imagepyramid.h
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Multi level 2x2 reduced copies of an image
+//*
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Mar 18,	2021	<MLS> Created imagepyramid.h
+//*****************************************************************************
+//#include	"imagepyramid.h"
+
+#ifndef _IMAGEPYRAMID_H_
+#define	_IMAGEPYRAMID_H_
+
+#include	<stdint.h>
+#include	<stdbool.h>
+
+#define	kPyramid_MaxLevels		10
+#define	kPyramid_MinDimension	16		//*	no level is made smaller than this
+
+//*****************************************************************************
+//*	level 0 is 1/2 of the source, level 1 is 1/4 and so on.
+//*	all levels are 16 bits per sample, the values are in the range of the source
+typedef struct
+{
+	bool		valid;
+	int			levelCnt;
+	int			planes;					//*	1 or 3, interleaved, RGB order
+	int			bitDepth;				//*	8 or 16, of the source data
+	int			width[kPyramid_MaxLevels];
+	int			height[kPyramid_MaxLevels];
+	uint16_t	*levelData[kPyramid_MaxLevels];
+	long		levelBufLen[kPyramid_MaxLevels];	//*	in samples
+} TYPE_IMAGE_PYRAMID;
+
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+//*	the buffers from the last build are reused if they are big enough
+bool	ImagePyramid_Build(	TYPE_IMAGE_PYRAMID	*pyramid,
+							const void			*srcData,
+							const int			srcWidth,
+							const int			srcHeight,
+							const int			bytesPerPixel,		//*	1 or 2
+							const int			planes,				//*	1 or 3, interleaved
+							const bool			swapRedBlue);		//*	source is BGR
+
+void	ImagePyramid_Release(TYPE_IMAGE_PYRAMID *pyramid);
+
+//*	returns the level that is reduced by binFactor, -1 if there is none
+int		ImagePyramid_LevelForFactor(const TYPE_IMAGE_PYRAMID *pyramid, const int binFactor);
+
+//*	returns the level that is exactly width x height, -1 if there is none
+int		ImagePyramid_LevelForSize(const TYPE_IMAGE_PYRAMID *pyramid, const int width, const int height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//	_IMAGEPYRAMID_H_
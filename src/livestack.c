@@ -0,0 +1,1118 @@
+//**************************************************************************
+//*	Name:			livestack.c
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Server side live stacking
+//*
+//*					Frames are handed over by the camera state machine and processed
+//*					on a separate thread. The capture side only does a memcpy, if the
+//*					stacking thread is still busy the older pending frame is replaced.
+//*
+//*					Registration is translation only. Stars are found on a 2x2 binned
+//*					luminance image, the offset to the reference frame is found by
+//*					voting over all star pair differences and refined by averaging
+//*					the matched pairs.
+//*
+//*					The accumulator is a float running mean per sample. In sigma clip
+//*					mode a running variance is also kept (Welford) and once a pixel has
+//*					3 samples, new values more than kappa * sigma from the mean are rejected.
+//*
+//*					RAW frames from a color sensor are debayered (bilinear) before they
+//*					are registered and stacked, so the stack is always mono or BGR.
+//*					RAW16 stays 16 bits, the stack keeps the full depth of the camera.
+//*
+//*					Frames with fewer than kLiveStack_MinStars stars are rejected, a frame
+//*					that cannot be registered is never added at a guessed offset.
+//*
+//*					After each stacked frame a stretched JPEG is written.
+//*
+//*	Limitations:	No rotation or field de-rotation (alt-az mounts will smear at the edges)
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb  6,	2021	<MLS> Created livestack.c
+//*	Feb  6,	2021	<MLS> Added star detection and offset voting for registration
+//*	Feb  7,	2021	<MLS> Added sigma clip mode
+//*	Feb  7,	2021	<MLS> Added stretched jpeg output of the stack
+//*	Mar 30,	2021	<MLS> Mutexes are now created once in LiveStack_Init(), Stop no longer destroys them
+//*	Mar 30,	2021	<MLS> RAW color frames are debayered instead of stacked as a mosaic
+//*	Mar 30,	2021	<MLS> Frames with too few stars are rejected instead of stacked unregistered
+//*	Mar 30,	2021	<MLS> Added jpegWritten so the path is only reported once the file exists
+//*	Mar 30,	2021	<MLS> RAW16 is debayered to 16 bits, the jpeg white point is the 99.9 percentile
+//*****************************************************************************
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<math.h>
+#include	<unistd.h>
+#include	<sys/time.h>
+#include	<pthread.h>
+
+#ifdef _ENABLE_JPEGLIB_
+	#include	<jpeglib.h>
+#endif
+
+#define _ENABLE_CONSOLE_DEBUG_
+#include	"ConsoleDebug.h"
+
+#include	"livestack.h"
+#include	"debayer.h"
+
+#define	kDetectThresholdSigma	5.0		//*	star detection threshold above the background
+#define	kCentroidRadius			3
+#define	kMatchTolerance			1.5		//*	pixels in the binned detection image
+#define	kMaxBackgroundSamples	20000
+#define	kStretchLUTsize			4096
+#define	kStretchTargetBkgnd		0.25	//*	where the background ends up after the stretch
+#define	kStretchWhiteFraction	0.999	//*	0.1 % of the samples go to white, hot pixels do not set the range
+
+//*****************************************************************************
+static int	CompareFloats(const void *e1, const void *e2)
+{
+float	value1	=	*((float *)e1);
+float	value2	=	*((float *)e2);
+
+	if (value1 < value2)
+	{
+		return(-1);
+	}
+	else if (value1 > value2)
+	{
+		return(1);
+	}
+	return(0);
+}
+
+//*****************************************************************************
+//*	median and noise (from the median absolute deviation) of a sampled image
+//*****************************************************************************
+static void	CalcBackground(	const float	*imageData,
+							const long	sampleCount,
+							float		*median,
+							float		*sigma)
+{
+float	*samples;
+long	stride;
+long	numSamples;
+long	ii;
+
+	*median	=	0.0;
+	*sigma	=	1.0;
+	stride	=	(sampleCount / kMaxBackgroundSamples) + 1;
+	samples	=	(float *)malloc(kMaxBackgroundSamples * sizeof(float));
+	if (samples != NULL)
+	{
+		numSamples	=	0;
+		for (ii=0; (ii < sampleCount) && (numSamples < kMaxBackgroundSamples); ii += stride)
+		{
+			samples[numSamples++]	=	imageData[ii];
+		}
+		if (numSamples > 0)
+		{
+			qsort(samples, numSamples, sizeof(float), CompareFloats);
+			*median	=	samples[numSamples / 2];
+			for (ii=0; ii<numSamples; ii++)
+			{
+				samples[ii]	=	fabsf(samples[ii] - *median);
+			}
+			qsort(samples, numSamples, sizeof(float), CompareFloats);
+			*sigma	=	1.4826 * samples[numSamples / 2];
+			if (*sigma <= 0.0)
+			{
+				*sigma	=	1.0;
+			}
+		}
+		free(samples);
+	}
+}
+
+//*****************************************************************************
+//*	value that fraction of the (sampled) image is below
+//*****************************************************************************
+static float	CalcPercentile(	const float	*imageData,
+								const long	sampleCount,
+								const float	fraction)
+{
+float	*samples;
+float	percentileValue;
+long	stride;
+long	numSamples;
+long	sampleIdx;
+long	ii;
+
+	percentileValue	=	0.0;
+	stride			=	(sampleCount / kMaxBackgroundSamples) + 1;
+	samples			=	(float *)malloc(kMaxBackgroundSamples * sizeof(float));
+	if (samples != NULL)
+	{
+		numSamples	=	0;
+		for (ii=0; (ii < sampleCount) && (numSamples < kMaxBackgroundSamples); ii += stride)
+		{
+			samples[numSamples++]	=	imageData[ii];
+		}
+		if (numSamples > 0)
+		{
+			qsort(samples, numSamples, sizeof(float), CompareFloats);
+			sampleIdx		=	fraction * (numSamples - 1);
+			percentileValue	=	samples[sampleIdx];
+		}
+		free(samples);
+	}
+	return(percentileValue);
+}
+
+//*****************************************************************************
+//*	sums each 2x2 block over all color planes,
+//*	this also takes care of the bayer pattern for color sensors
+//*****************************************************************************
+static void	BuildDetectionImage(TYPE_LIVESTACK *liveStack)
+{
+int			detWidth;
+int			detHeight;
+int			xxx;
+int			yyy;
+int			ppp;
+int			planes;
+long		srcIdx;
+float		pixelSum;
+uint8_t		*src8;
+uint16_t	*src16;
+
+	detWidth	=	liveStack->width / 2;
+	detHeight	=	liveStack->height / 2;
+	planes		=	liveStack->planes;
+	src8		=	(uint8_t *)liveStack->workBuffer;
+	src16		=	(uint16_t *)liveStack->workBuffer;
+
+	for (yyy=0; yyy<detHeight; yyy++)
+	{
+		for (xxx=0; xxx<detWidth; xxx++)
+		{
+			pixelSum	=	0.0;
+			srcIdx		=	((2 * yyy) * liveStack->width + (2 * xxx)) * planes;
+			for (ppp=0; ppp < (2 * planes); ppp++)
+			{
+				if (liveStack->workBytesPerPixel == 2)
+				{
+					pixelSum	+=	src16[srcIdx + ppp];
+					pixelSum	+=	src16[srcIdx + (liveStack->width * planes) + ppp];
+				}
+				else
+				{
+					pixelSum	+=	src8[srcIdx + ppp];
+					pixelSum	+=	src8[srcIdx + (liveStack->width * planes) + ppp];
+				}
+			}
+			liveStack->detectBuffer[(yyy * detWidth) + xxx]	=	pixelSum;
+		}
+	}
+}
+
+//*****************************************************************************
+//*	keeps the brightest stars, sorted by flux
+//*****************************************************************************
+static void	InsertStar(TYPE_STACK_STAR *starList, int *starCnt, TYPE_STACK_STAR *newStar)
+{
+int		ii;
+int		insertIdx;
+double	dx;
+double	dy;
+
+	//*	ignore a second peak on the same star
+	for (ii=0; ii < *starCnt; ii++)
+	{
+		dx	=	starList[ii].xCenter - newStar->xCenter;
+		dy	=	starList[ii].yCenter - newStar->yCenter;
+		if (((dx * dx) + (dy * dy)) < (kCentroidRadius * kCentroidRadius))
+		{
+			if (newStar->flux > starList[ii].flux)
+			{
+				starList[ii]	=	*newStar;
+			}
+			return;
+		}
+	}
+
+	insertIdx	=	*starCnt;
+	while ((insertIdx > 0) && (starList[insertIdx - 1].flux < newStar->flux))
+	{
+		if (insertIdx < kLiveStack_MaxStars)
+		{
+			starList[insertIdx]	=	starList[insertIdx - 1];
+		}
+		insertIdx--;
+	}
+	if (insertIdx < kLiveStack_MaxStars)
+	{
+		starList[insertIdx]	=	*newStar;
+		if (*starCnt < kLiveStack_MaxStars)
+		{
+			(*starCnt)++;
+		}
+	}
+}
+
+//*****************************************************************************
+static int	FindStars(TYPE_LIVESTACK *liveStack, TYPE_STACK_STAR *starList)
+{
+int				detWidth;
+int				detHeight;
+int				xxx;
+int				yyy;
+int				cx;
+int				cy;
+int				starCnt;
+float			*img;
+float			pixelValue;
+float			bkgndMedian;
+float			bkgndSigma;
+float			threshold;
+float			weight;
+double			sumW;
+double			sumX;
+double			sumY;
+TYPE_STACK_STAR	newStar;
+
+	detWidth	=	liveStack->width / 2;
+	detHeight	=	liveStack->height / 2;
+	img			=	liveStack->detectBuffer;
+	starCnt		=	0;
+
+	CalcBackground(img, ((long)detWidth * detHeight), &bkgndMedian, &bkgndSigma);
+	threshold	=	bkgndMedian + (kDetectThresholdSigma * bkgndSigma);
+
+	for (yyy=kCentroidRadius; yyy < (detHeight - kCentroidRadius); yyy++)
+	{
+		for (xxx=kCentroidRadius; xxx < (detWidth - kCentroidRadius); xxx++)
+		{
+			pixelValue	=	img[(yyy * detWidth) + xxx];
+			if (pixelValue <= threshold)
+			{
+				continue;
+			}
+			//*	local maximum check, ties go to the first pixel found
+			if ((pixelValue <= img[((yyy - 1) * detWidth) + xxx - 1])	||
+				(pixelValue <= img[((yyy - 1) * detWidth) + xxx])		||
+				(pixelValue <= img[((yyy - 1) * detWidth) + xxx + 1])	||
+				(pixelValue <= img[(yyy * detWidth) + xxx - 1])			||
+				(pixelValue <  img[(yyy * detWidth) + xxx + 1])			||
+				(pixelValue <  img[((yyy + 1) * detWidth) + xxx - 1])	||
+				(pixelValue <  img[((yyy + 1) * detWidth) + xxx])		||
+				(pixelValue <  img[((yyy + 1) * detWidth) + xxx + 1]))
+			{
+				continue;
+			}
+			//*	background subtracted centroid
+			sumW	=	0.0;
+			sumX	=	0.0;
+			sumY	=	0.0;
+			for (cy = -kCentroidRadius; cy <= kCentroidRadius; cy++)
+			{
+				for (cx = -kCentroidRadius; cx <= kCentroidRadius; cx++)
+				{
+					weight	=	img[((yyy + cy) * detWidth) + xxx + cx] - bkgndMedian;
+					if (weight > 0.0)
+					{
+						sumW	+=	weight;
+						sumX	+=	weight * (xxx + cx);
+						sumY	+=	weight * (yyy + cy);
+					}
+				}
+			}
+			if (sumW > 0.0)
+			{
+				newStar.xCenter	=	sumX / sumW;
+				newStar.yCenter	=	sumY / sumW;
+				newStar.flux	=	sumW;
+				InsertStar(starList, &starCnt, &newStar);
+			}
+		}
+	}
+	return(starCnt);
+}
+
+//*****************************************************************************
+//*	counts how many reference stars line up with the current stars for a given offset
+//*****************************************************************************
+static int	CountMatches(	TYPE_STACK_STAR	*refStars,
+							int				refCnt,
+							TYPE_STACK_STAR	*curStars,
+							int				curCnt,
+							double			offsetX,
+							double			offsetY,
+							double			*sumDX,
+							double			*sumDY)
+{
+int		ii;
+int		jj;
+int		matchCnt;
+double	dx;
+double	dy;
+
+	matchCnt	=	0;
+	*sumDX		=	0.0;
+	*sumDY		=	0.0;
+	for (ii=0; ii<refCnt; ii++)
+	{
+		for (jj=0; jj<curCnt; jj++)
+		{
+			dx	=	refStars[ii].xCenter - curStars[jj].xCenter;
+			dy	=	refStars[ii].yCenter - curStars[jj].yCenter;
+			if ((fabs(dx - offsetX) < kMatchTolerance) && (fabs(dy - offsetY) < kMatchTolerance))
+			{
+				matchCnt++;
+				*sumDX	+=	dx;
+				*sumDY	+=	dy;
+				break;
+			}
+		}
+	}
+	return(matchCnt);
+}
+
+//*****************************************************************************
+//*	returns true if an offset (in detection image pixels) was found
+//*****************************************************************************
+static bool	MatchStars(	TYPE_STACK_STAR	*refStars,
+						int				refCnt,
+						TYPE_STACK_STAR	*curStars,
+						int				curCnt,
+						double			*offsetX,
+						double			*offsetY)
+{
+int		ii;
+int		jj;
+int		matchCnt;
+int		bestCnt;
+int		minMatches;
+double	sumDX;
+double	sumDY;
+double	bestDX;
+double	bestDY;
+
+	bestCnt	=	0;
+	bestDX	=	0.0;
+	bestDY	=	0.0;
+	//*	every pair is a candidate offset, the true offset gets the most votes
+	for (ii=0; ii<refCnt; ii++)
+	{
+		for (jj=0; jj<curCnt; jj++)
+		{
+			matchCnt	=	CountMatches(	refStars, refCnt,
+											curStars, curCnt,
+											(refStars[ii].xCenter - curStars[jj].xCenter),
+											(refStars[ii].yCenter - curStars[jj].yCenter),
+											&sumDX, &sumDY);
+			if (matchCnt > bestCnt)
+			{
+				bestCnt	=	matchCnt;
+				bestDX	=	sumDX / matchCnt;
+				bestDY	=	sumDY / matchCnt;
+			}
+		}
+	}
+	minMatches	=	((refCnt < curCnt) ? refCnt : curCnt) / 3;
+	if (minMatches < 3)
+	{
+		minMatches	=	3;
+	}
+	*offsetX	=	bestDX;
+	*offsetY	=	bestDY;
+	return(bestCnt >= minMatches);
+}
+
+//*****************************************************************************
+static void	FreeAccumulator(TYPE_LIVESTACK *liveStack)
+{
+	if (liveStack->meanBuffer != NULL)
+	{
+		free(liveStack->meanBuffer);
+		liveStack->meanBuffer	=	NULL;
+	}
+	if (liveStack->m2Buffer != NULL)
+	{
+		free(liveStack->m2Buffer);
+		liveStack->m2Buffer	=	NULL;
+	}
+	if (liveStack->countBuffer != NULL)
+	{
+		free(liveStack->countBuffer);
+		liveStack->countBuffer	=	NULL;
+	}
+	if (liveStack->detectBuffer != NULL)
+	{
+		free(liveStack->detectBuffer);
+		liveStack->detectBuffer	=	NULL;
+	}
+	liveStack->detectBufLen		=	0;
+	liveStack->width			=	0;
+	liveStack->height			=	0;
+	liveStack->planes			=	0;
+	liveStack->bytesPerPixel	=	0;
+	liveStack->refStarCnt		=	0;
+	liveStack->framesStacked	=	0;
+}
+
+//*****************************************************************************
+static bool	AllocateAccumulator(TYPE_LIVESTACK *liveStack, int width, int height, int planes)
+{
+long	sampleCnt;
+bool	successFlag;
+
+	FreeAccumulator(liveStack);
+	sampleCnt					=	(long)width * height * planes;
+	liveStack->meanBuffer		=	(float *)calloc(sampleCnt, sizeof(float));
+	liveStack->countBuffer		=	(uint16_t *)calloc(sampleCnt, sizeof(uint16_t));
+	if (liveStack->stackMode == kLiveStack_SigmaClip)
+	{
+		liveStack->m2Buffer		=	(float *)calloc(sampleCnt, sizeof(float));
+	}
+	liveStack->detectBufLen		=	(long)(width / 2) * (height / 2);
+	liveStack->detectBuffer		=	(float *)malloc(liveStack->detectBufLen * sizeof(float));
+
+	successFlag	=	(liveStack->meanBuffer != NULL) &&
+					(liveStack->countBuffer != NULL) &&
+					(liveStack->detectBuffer != NULL) &&
+					((liveStack->stackMode != kLiveStack_SigmaClip) || (liveStack->m2Buffer != NULL));
+	if (successFlag)
+	{
+		liveStack->width	=	width;
+		liveStack->height	=	height;
+		liveStack->planes			=	planes;
+		liveStack->bytesPerPixel	=	liveStack->workBytesPerPixel;
+	}
+	else
+	{
+		CONSOLE_DEBUG("Failed to allocate live stack buffers");
+		FreeAccumulator(liveStack);
+	}
+	return(successFlag);
+}
+
+//*****************************************************************************
+//*	adds the work buffer to the accumulator, shifted by offsetX,offsetY
+//*****************************************************************************
+static void	AccumulateFrame(TYPE_LIVESTACK *liveStack, int offsetX, int offsetY)
+{
+int			xxx;
+int			yyy;
+int			ppp;
+int			srcX;
+int			srcY;
+int			width;
+int			planes;
+long		dstIdx;
+long		srcIdx;
+float		pixelValue;
+float		delta;
+float		meanValue;
+float		stdDev;
+uint16_t	sampleCnt;
+uint8_t		*src8;
+uint16_t	*src16;
+bool		sigmaClip;
+
+	width		=	liveStack->width;
+	planes		=	liveStack->planes;
+	src8		=	(uint8_t *)liveStack->workBuffer;
+	src16		=	(uint16_t *)liveStack->workBuffer;
+	sigmaClip	=	(liveStack->stackMode == kLiveStack_SigmaClip) && (liveStack->m2Buffer != NULL);
+
+	for (yyy=0; yyy < liveStack->height; yyy++)
+	{
+		srcY	=	yyy - offsetY;
+		if ((srcY < 0) || (srcY >= liveStack->height))
+		{
+			continue;
+		}
+		for (xxx=0; xxx < width; xxx++)
+		{
+			srcX	=	xxx - offsetX;
+			if ((srcX < 0) || (srcX >= width))
+			{
+				continue;
+			}
+			dstIdx	=	(((long)yyy * width) + xxx) * planes;
+			srcIdx	=	(((long)srcY * width) + srcX) * planes;
+			for (ppp=0; ppp<planes; ppp++, dstIdx++, srcIdx++)
+			{
+				if (liveStack->workBytesPerPixel == 2)
+				{
+					pixelValue	=	src16[srcIdx];
+				}
+				else
+				{
+					pixelValue	=	src8[srcIdx];
+				}
+				sampleCnt	=	liveStack->countBuffer[dstIdx];
+				meanValue	=	liveStack->meanBuffer[dstIdx];
+				if (sigmaClip && (sampleCnt >= 3))
+				{
+					stdDev	=	sqrtf(liveStack->m2Buffer[dstIdx] / (sampleCnt - 1));
+					if (fabsf(pixelValue - meanValue) > (liveStack->sigmaKappa * stdDev))
+					{
+						continue;
+					}
+				}
+				if (sampleCnt < 0xffff)
+				{
+					sampleCnt++;
+				}
+				delta		=	pixelValue - meanValue;
+				meanValue	+=	delta / sampleCnt;
+				liveStack->meanBuffer[dstIdx]	=	meanValue;
+				liveStack->countBuffer[dstIdx]	=	sampleCnt;
+				if (sigmaClip)
+				{
+					liveStack->m2Buffer[dstIdx]	+=	delta * (pixelValue - meanValue);
+				}
+			}
+		}
+	}
+}
+
+#ifdef _ENABLE_JPEGLIB_
+//*****************************************************************************
+//*	auto stretch (midtones transfer function) and write the jpeg
+//*	the file is written to a temp name and renamed so a web client never sees a partial file
+//*****************************************************************************
+static void	WriteStretchedJpeg(TYPE_LIVESTACK *liveStack)
+{
+struct jpeg_compress_struct	jinfo;
+struct jpeg_error_mgr		jerr;
+FILE						*outputFile;
+JSAMPROW					rowPointer[1];
+unsigned char				*rowBuffer;
+unsigned char				stretchLUT[kStretchLUTsize];
+char						tempFilePath[280];
+long						sampleCnt;
+long						rowIdx;
+float						bkgndMedian;
+float						bkgndSigma;
+float						blackPoint;
+float						whitePoint;
+float						normValue;
+float						normMedian;
+float						midTone;
+float						pixelValue;
+int							lutIdx;
+int							xxx;
+int							ppp;
+int							ii;
+
+	sampleCnt	=	(long)liveStack->width * liveStack->height * liveStack->planes;
+
+	//*	black point just below the background, white point near the top,
+	//*	a single hot pixel or satellite trail does not flatten the whole stretch
+	CalcBackground(liveStack->meanBuffer, sampleCnt, &bkgndMedian, &bkgndSigma);
+	blackPoint	=	bkgndMedian - (2.8 * bkgndSigma);
+	whitePoint	=	CalcPercentile(liveStack->meanBuffer, sampleCnt, kStretchWhiteFraction);
+	if (whitePoint < bkgndMedian)
+	{
+		whitePoint	=	bkgndMedian;
+	}
+	if (blackPoint < 0.0)
+	{
+		blackPoint	=	0.0;
+	}
+	if (whitePoint <= blackPoint)
+	{
+		whitePoint	=	blackPoint + 1.0;
+	}
+
+	//*	pick the mid tone balance that puts the background at the target level
+	normMedian	=	(bkgndMedian - blackPoint) / (whitePoint - blackPoint);
+	midTone		=	0.5;
+	if ((normMedian > 0.0) && (normMedian < 1.0))
+	{
+		midTone	=	(normMedian * (1.0 - kStretchTargetBkgnd)) /
+					(normMedian - (2.0 * kStretchTargetBkgnd * normMedian) + kStretchTargetBkgnd);
+	}
+	for (ii=0; ii<kStretchLUTsize; ii++)
+	{
+		normValue		=	(ii * 1.0) / (kStretchLUTsize - 1);
+		normValue		=	((midTone - 1.0) * normValue) / ((((2.0 * midTone) - 1.0) * normValue) - midTone);
+		stretchLUT[ii]	=	(unsigned char)(255.0 * normValue + 0.5);
+	}
+
+	rowBuffer	=	(unsigned char *)malloc(liveStack->width * liveStack->planes);
+	if (rowBuffer != NULL)
+	{
+		sprintf(tempFilePath, "%s.tmp", liveStack->jpegFilePath);
+		outputFile	=	fopen(tempFilePath, "wb");
+		if (outputFile != NULL)
+		{
+			jinfo.err	=	jpeg_std_error(&jerr);
+			jpeg_create_compress(&jinfo);
+			jpeg_stdio_dest(&jinfo, outputFile);
+
+			jinfo.image_width		=	liveStack->width;
+			jinfo.image_height		=	liveStack->height;
+			jinfo.input_components	=	liveStack->planes;
+			jinfo.in_color_space	=	(liveStack->planes == 3) ? JCS_RGB : JCS_GRAYSCALE;
+
+			jpeg_set_defaults(&jinfo);
+			jpeg_set_quality(&jinfo, 90, TRUE);
+			jpeg_start_compress(&jinfo, TRUE);
+
+			while (jinfo.next_scanline < jinfo.image_height)
+			{
+				rowIdx	=	(long)jinfo.next_scanline * liveStack->width * liveStack->planes;
+				for (xxx=0; xxx < liveStack->width; xxx++)
+				{
+					for (ppp=0; ppp < liveStack->planes; ppp++)
+					{
+						pixelValue	=	liveStack->meanBuffer[rowIdx + (xxx * liveStack->planes) + ppp];
+						normValue	=	(pixelValue - blackPoint) / (whitePoint - blackPoint);
+						lutIdx		=	normValue * (kStretchLUTsize - 1);
+						if (lutIdx < 0)
+						{
+							lutIdx	=	0;
+						}
+						else if (lutIdx >= kStretchLUTsize)
+						{
+							lutIdx	=	kStretchLUTsize - 1;
+						}
+						//*	color frames are BGR, jpeg wants RGB
+						if (liveStack->planes == 3)
+						{
+							rowBuffer[(xxx * 3) + (2 - ppp)]	=	stretchLUT[lutIdx];
+						}
+						else
+						{
+							rowBuffer[xxx]	=	stretchLUT[lutIdx];
+						}
+					}
+				}
+				rowPointer[0]	=	rowBuffer;
+				jpeg_write_scanlines(&jinfo, rowPointer, 1);
+			}
+			jpeg_finish_compress(&jinfo);
+			jpeg_destroy_compress(&jinfo);
+			fclose(outputFile);
+			if (rename(tempFilePath, liveStack->jpegFilePath) == 0)
+			{
+				liveStack->jpegWritten	=	true;
+			}
+		}
+		free(rowBuffer);
+	}
+}
+#endif // _ENABLE_JPEGLIB_
+
+//*****************************************************************************
+//*	debayers the RAW work buffer into BGR, the two buffers are then swapped.
+//*	RAW16 stays 16 bits, RAW8 stays 8 bits
+//*****************************************************************************
+static bool	DebayerWorkBuffer(TYPE_LIVESTACK *liveStack, int width, int height)
+{
+long			rgbSize;
+unsigned char	*newBuffer;
+unsigned char	*tempBufPtr;
+long			tempBufLen;
+bool			successFlag;
+
+	successFlag	=	false;
+	rgbSize		=	(long)width * height * 3 * liveStack->workBytesPerPixel;
+	if (liveStack->debayerBufLen < rgbSize)
+	{
+		newBuffer	=	(unsigned char *)realloc(liveStack->debayerBuffer, rgbSize);
+		if (newBuffer != NULL)
+		{
+			liveStack->debayerBuffer	=	newBuffer;
+			liveStack->debayerBufLen	=	rgbSize;
+		}
+	}
+	if ((liveStack->debayerBufLen >= rgbSize) && (liveStack->workBytesPerPixel == 2))
+	{
+		successFlag	=	Debayer_Image16(liveStack->workBuffer,
+										width,
+										height,
+										liveStack->workBytesPerPixel,
+										liveStack->bayerPattern,
+										kDebayer_Bilinear,
+										true,
+										(uint16_t *)liveStack->debayerBuffer);
+	}
+	else if (liveStack->debayerBufLen >= rgbSize)
+	{
+		successFlag	=	Debayer_Image(	liveStack->workBuffer,
+										width,
+										height,
+										liveStack->workBytesPerPixel,
+										liveStack->bayerPattern,
+										kDebayer_Bilinear,
+										true,
+										liveStack->debayerBuffer);
+	}
+	if (successFlag)
+	{
+		tempBufPtr						=	liveStack->workBuffer;
+		tempBufLen						=	liveStack->workBufLen;
+		liveStack->workBuffer			=	liveStack->debayerBuffer;
+		liveStack->workBufLen			=	liveStack->debayerBufLen;
+		liveStack->debayerBuffer		=	tempBufPtr;
+		liveStack->debayerBufLen		=	tempBufLen;
+	}
+	return(successFlag);
+}
+
+//*****************************************************************************
+static void	StackWorkBuffer(TYPE_LIVESTACK *liveStack, int width, int height, int planes)
+{
+TYPE_STACK_STAR	curStars[kLiveStack_MaxStars];
+int				curStarCnt;
+int				offsetX;
+int				offsetY;
+double			detOffsetX;
+double			detOffsetY;
+bool			registered;
+struct timeval	startTime;
+struct timeval	endTime;
+
+	gettimeofday(&startTime, NULL);
+
+	if ((liveStack->bayerPattern != kLiveStack_NoBayer) && (planes == 1))
+	{
+		if (DebayerWorkBuffer(liveStack, width, height) == false)
+		{
+			CONSOLE_DEBUG("Live stack: failed to debayer frame");
+			liveStack->framesRejected++;
+			return;
+		}
+		planes	=	3;
+	}
+
+	if ((liveStack->meanBuffer == NULL) ||
+		(liveStack->workBytesPerPixel != liveStack->bytesPerPixel) ||
+		(width != liveStack->width) ||
+		(height != liveStack->height) ||
+		(planes != liveStack->planes))
+	{
+		//*	first frame or the image format changed, start over
+		pthread_mutex_lock(&liveStack->stackMutex);
+		AllocateAccumulator(liveStack, width, height, planes);
+		pthread_mutex_unlock(&liveStack->stackMutex);
+	}
+	if (liveStack->meanBuffer == NULL)
+	{
+		return;
+	}
+
+	BuildDetectionImage(liveStack);
+	curStarCnt				=	FindStars(liveStack, curStars);
+	liveStack->lastStarCnt	=	curStarCnt;
+
+	offsetX		=	0;
+	offsetY		=	0;
+	registered	=	false;
+	if (curStarCnt < kLiveStack_MinStars)
+	{
+		//*	not enough stars to register, this also keeps a poor frame from becoming the reference
+	}
+	else if (liveStack->framesStacked == 0)
+	{
+		//*	this is the reference frame
+		memcpy(liveStack->refStars, curStars, (curStarCnt * sizeof(TYPE_STACK_STAR)));
+		liveStack->refStarCnt	=	curStarCnt;
+		registered				=	true;
+	}
+	else if (liveStack->refStarCnt >= kLiveStack_MinStars)
+	{
+		registered	=	MatchStars(	liveStack->refStars, liveStack->refStarCnt,
+									curStars, curStarCnt,
+									&detOffsetX, &detOffsetY);
+		//*	the detection image is 2x2 binned
+		offsetX		=	lround(2.0 * detOffsetX);
+		offsetY		=	lround(2.0 * detOffsetY);
+	}
+
+	if (registered)
+	{
+		pthread_mutex_lock(&liveStack->stackMutex);
+		AccumulateFrame(liveStack, offsetX, offsetY);
+		liveStack->framesStacked++;
+		liveStack->lastOffsetX	=	offsetX;
+		liveStack->lastOffsetY	=	offsetY;
+		pthread_mutex_unlock(&liveStack->stackMutex);
+
+	#ifdef _ENABLE_JPEGLIB_
+		if (strlen(liveStack->jpegFilePath) > 0)
+		{
+			WriteStretchedJpeg(liveStack);
+		}
+	#endif // _ENABLE_JPEGLIB_
+	}
+	else
+	{
+		liveStack->framesRejected++;
+		CONSOLE_DEBUG_W_NUM("Live stack: frame could not be registered, stars\t=", curStarCnt);
+	}
+
+	gettimeofday(&endTime, NULL);
+	liveStack->lastStackTime_ms	=	((endTime.tv_sec - startTime.tv_sec) * 1000) +
+									((endTime.tv_usec - startTime.tv_usec) / 1000);
+}
+
+//*****************************************************************************
+static void	*LiveStackThread(void *arg)
+{
+TYPE_LIVESTACK	*liveStack;
+unsigned char	*tempBufPtr;
+long			tempBufLen;
+int				width;
+int				height;
+int				planes;
+
+	liveStack	=	(TYPE_LIVESTACK *)arg;
+
+	pthread_mutex_lock(&liveStack->frameMutex);
+	while (liveStack->keepRunning)
+	{
+		while ((liveStack->pendingValid == false) &&
+				(liveStack->resetRequested == false) &&
+				liveStack->keepRunning)
+		{
+			pthread_cond_wait(&liveStack->frameCond, &liveStack->frameMutex);
+		}
+		if (liveStack->keepRunning == false)
+		{
+			break;
+		}
+		if (liveStack->resetRequested)
+		{
+			liveStack->resetRequested	=	false;
+			pthread_mutex_lock(&liveStack->stackMutex);
+			FreeAccumulator(liveStack);
+			pthread_mutex_unlock(&liveStack->stackMutex);
+			continue;
+		}
+
+		//*	swap the pending buffer with the work buffer, no copy needed
+		tempBufPtr					=	liveStack->workBuffer;
+		tempBufLen					=	liveStack->workBufLen;
+		liveStack->workBuffer		=	liveStack->pendingBuffer;
+		liveStack->workBufLen		=	liveStack->pendingBufLen;
+		liveStack->pendingBuffer	=	tempBufPtr;
+		liveStack->pendingBufLen	=	tempBufLen;
+		liveStack->pendingValid		=	false;
+		width						=	liveStack->pendingWidth;
+		height						=	liveStack->pendingHeight;
+		planes						=	liveStack->pendingPlanes;
+		liveStack->workBytesPerPixel	=	liveStack->pendingBytesPerPixel;
+		pthread_mutex_unlock(&liveStack->frameMutex);
+
+		StackWorkBuffer(liveStack, width, height, planes);
+
+		pthread_mutex_lock(&liveStack->frameMutex);
+	}
+	pthread_mutex_unlock(&liveStack->frameMutex);
+	return(NULL);
+}
+
+//*****************************************************************************
+//*	called once when the owner is created, the mutexes stay valid until LiveStack_Release()
+//*	so a reader that checked threadActive can never lock a destroyed mutex
+//*****************************************************************************
+void	LiveStack_Init(TYPE_LIVESTACK *liveStack)
+{
+	memset(liveStack, 0, sizeof(TYPE_LIVESTACK));
+	liveStack->bayerPattern	=	kLiveStack_NoBayer;
+	pthread_mutex_init(&liveStack->frameMutex, NULL);
+	pthread_mutex_init(&liveStack->stackMutex, NULL);
+	pthread_cond_init(&liveStack->frameCond, NULL);
+}
+
+//*****************************************************************************
+void	LiveStack_Release(TYPE_LIVESTACK *liveStack)
+{
+	LiveStack_Stop(liveStack);
+	pthread_mutex_destroy(&liveStack->frameMutex);
+	pthread_mutex_destroy(&liveStack->stackMutex);
+	pthread_cond_destroy(&liveStack->frameCond);
+}
+
+//*****************************************************************************
+bool	LiveStack_Start(	TYPE_LIVESTACK		*liveStack,
+							TYPE_LIVESTACK_MODE	stackMode,
+							double				sigmaKappa,
+							int					bayerPattern,
+							const char			*jpegFilePath)
+{
+int		threadErr;
+bool	successFlag;
+
+	successFlag	=	false;
+	if (liveStack->threadActive == false)
+	{
+		liveStack->stackMode		=	stackMode;
+		liveStack->sigmaKappa		=	sigmaKappa;
+		liveStack->bayerPattern		=	bayerPattern;
+		liveStack->jpegFilePath[0]	=	0;
+		liveStack->jpegWritten		=	false;
+		if (jpegFilePath != NULL)
+		{
+			strncpy(liveStack->jpegFilePath, jpegFilePath, (sizeof(liveStack->jpegFilePath) - 1));
+		}
+		liveStack->pendingValid		=	false;
+		liveStack->resetRequested	=	false;
+		liveStack->framesOffered	=	0;
+		liveStack->framesRejected	=	0;
+		liveStack->framesSkipped	=	0;
+		liveStack->lastStarCnt		=	0;
+		liveStack->lastOffsetX		=	0;
+		liveStack->lastOffsetY		=	0;
+		liveStack->lastStackTime_ms	=	0;
+
+		liveStack->keepRunning	=	true;
+		threadErr	=	pthread_create(&liveStack->threadID, NULL, &LiveStackThread, liveStack);
+		if (threadErr == 0)
+		{
+			pthread_mutex_lock(&liveStack->frameMutex);
+			liveStack->threadActive	=	true;
+			pthread_mutex_unlock(&liveStack->frameMutex);
+			successFlag				=	true;
+		}
+		else
+		{
+			CONSOLE_DEBUG_W_NUM("Failed to create live stack thread, err\t=", threadErr);
+			liveStack->keepRunning	=	false;
+		}
+	}
+	return(successFlag);
+}
+
+//*****************************************************************************
+//*	the buffers are freed under their mutexes, readers find them NULL afterwards
+//*****************************************************************************
+void	LiveStack_Stop(TYPE_LIVESTACK *liveStack)
+{
+bool	wasActive;
+
+	pthread_mutex_lock(&liveStack->frameMutex);
+	wasActive				=	liveStack->threadActive;
+	liveStack->threadActive	=	false;
+	liveStack->keepRunning	=	false;
+	pthread_cond_signal(&liveStack->frameCond);
+	pthread_mutex_unlock(&liveStack->frameMutex);
+
+	if (wasActive)
+	{
+		pthread_join(liveStack->threadID, NULL);
+
+		pthread_mutex_lock(&liveStack->stackMutex);
+		FreeAccumulator(liveStack);
+		pthread_mutex_unlock(&liveStack->stackMutex);
+
+		pthread_mutex_lock(&liveStack->frameMutex);
+		if (liveStack->pendingBuffer != NULL)
+		{
+			free(liveStack->pendingBuffer);
+			liveStack->pendingBuffer	=	NULL;
+		}
+		liveStack->pendingBufLen	=	0;
+		liveStack->pendingValid		=	false;
+		pthread_mutex_unlock(&liveStack->frameMutex);
+
+		//*	only the stacking thread uses these and it is gone
+		if (liveStack->workBuffer != NULL)
+		{
+			free(liveStack->workBuffer);
+			liveStack->workBuffer	=	NULL;
+		}
+		liveStack->workBufLen	=	0;
+		if (liveStack->debayerBuffer != NULL)
+		{
+			free(liveStack->debayerBuffer);
+			liveStack->debayerBuffer	=	NULL;
+		}
+		liveStack->debayerBufLen	=	0;
+	}
+}
+
+//*****************************************************************************
+//*	throws away the current stack, the next frame becomes the new reference
+//*****************************************************************************
+void	LiveStack_Reset(TYPE_LIVESTACK *liveStack)
+{
+	pthread_mutex_lock(&liveStack->frameMutex);
+	if (liveStack->threadActive)
+	{
+		liveStack->resetRequested	=	true;
+		liveStack->framesOffered	=	0;
+		liveStack->framesRejected	=	0;
+		liveStack->framesSkipped	=	0;
+		pthread_cond_signal(&liveStack->frameCond);
+	}
+	pthread_mutex_unlock(&liveStack->frameMutex);
+}
+
+//*****************************************************************************
+//*	called from the capture side, only copies the data
+//*****************************************************************************
+void	LiveStack_AddFrame(	TYPE_LIVESTACK		*liveStack,
+							const unsigned char	*imageData,
+							const int			width,
+							const int			height,
+							const int			bytesPerPixel,
+							const int			planes)
+{
+long			frameSize;
+unsigned char	*newBuffer;
+
+	if ((imageData != NULL) && (width > 1) && (height > 1))
+	{
+		frameSize	=	(long)width * height * bytesPerPixel * planes;
+		pthread_mutex_lock(&liveStack->frameMutex);
+		if (liveStack->threadActive == false)
+		{
+			//*	stopped since the caller checked
+			frameSize	=	0;
+		}
+		else if (liveStack->pendingValid)
+		{
+			//*	the stacking thread has not gotten to the last one yet
+			liveStack->framesSkipped++;
+		}
+		if (liveStack->pendingBufLen < frameSize)
+		{
+			newBuffer	=	(unsigned char *)realloc(liveStack->pendingBuffer, frameSize);
+			if (newBuffer != NULL)
+			{
+				liveStack->pendingBuffer	=	newBuffer;
+				liveStack->pendingBufLen	=	frameSize;
+			}
+		}
+		if ((frameSize > 0) && (liveStack->pendingBufLen >= frameSize))
+		{
+			memcpy(liveStack->pendingBuffer, imageData, frameSize);
+			liveStack->pendingWidth			=	width;
+			liveStack->pendingHeight		=	height;
+			liveStack->pendingBytesPerPixel	=	bytesPerPixel;
+			liveStack->pendingPlanes		=	planes;
+			liveStack->pendingValid			=	true;
+			liveStack->framesOffered++;
+			pthread_cond_signal(&liveStack->frameCond);
+		}
+		pthread_mutex_unlock(&liveStack->frameMutex);
+	}
+}
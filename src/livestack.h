@@ -0,0 +1,132 @@
+//**************************************************************************
+//*	Name:			livestack.h
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	Server side live stacking
+//*
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb  6,	2021	<MLS> Created livestack.h
+//*	Mar 30,	2021	<MLS> Added LiveStack_Init() and LiveStack_Release(), mutexes live as long as the camera
+//*	Mar 30,	2021	<MLS> RAW color frames are now debayered before stacking
+//*****************************************************************************
+//#include	"livestack.h"
+
+#ifndef _LIVESTACK_H_
+#define	_LIVESTACK_H_
+
+#include	<stdint.h>
+#include	<stdbool.h>
+
+#ifndef _PTHREAD_H
+	#include	<pthread.h>
+#endif // _PTHREAD_H
+
+//*****************************************************************************
+typedef enum
+{
+	kLiveStack_Mean	=	0,
+	kLiveStack_SigmaClip
+
+} TYPE_LIVESTACK_MODE;
+
+#define	kLiveStack_MaxStars		40
+#define	kLiveStack_MinStars		3		//*	frames with fewer stars are rejected, they cannot be registered
+#define	kLiveStack_NoBayer		-1
+
+//*****************************************************************************
+typedef struct
+{
+	double		xCenter;
+	double		yCenter;
+	double		flux;
+} TYPE_STACK_STAR;
+
+//*****************************************************************************
+typedef struct
+{
+	//*	configuration
+	TYPE_LIVESTACK_MODE	stackMode;
+	double				sigmaKappa;				//*	rejection threshold for sigma clip mode
+	int					bayerPattern;			//*	kDebayer_xxxx for RAW color data, else kLiveStack_NoBayer
+	char				jpegFilePath[256];		//*	stretched result is written here after each frame
+	bool				jpegWritten;			//*	true once jpegFilePath actually exists
+
+	//*	frame hand-off from the capture side, single slot, newest frame wins
+	pthread_mutex_t		frameMutex;
+	pthread_cond_t		frameCond;
+	unsigned char		*pendingBuffer;
+	long				pendingBufLen;
+	bool				pendingValid;
+	int					pendingWidth;
+	int					pendingHeight;
+	int					pendingBytesPerPixel;
+	int					pendingPlanes;
+
+	pthread_t			threadID;
+	bool				threadActive;
+	bool				keepRunning;
+	bool				resetRequested;
+
+	//*	accumulator, owned by the stacking thread
+	//*	stackMutex must be held by anyone else reading it
+	pthread_mutex_t		stackMutex;
+	int					width;
+	int					height;
+	int					planes;
+	int					bytesPerPixel;
+	float				*meanBuffer;			//*	running mean per pixel
+	float				*m2Buffer;				//*	running sum of squared deviations (sigma clip only)
+	uint16_t			*countBuffer;			//*	samples per pixel
+	unsigned char		*workBuffer;			//*	copy of the frame being stacked
+	long				workBufLen;
+	int					workBytesPerPixel;
+	float				*detectBuffer;			//*	2x2 binned luminance used for star detection
+	long				detectBufLen;
+	unsigned char		*debayerBuffer;			//*	swapped with workBuffer after debayering
+	long				debayerBufLen;
+
+	TYPE_STACK_STAR		refStars[kLiveStack_MaxStars];
+	int					refStarCnt;
+
+	//*	statistics
+	uint32_t			framesOffered;
+	uint32_t			framesStacked;
+	uint32_t			framesRejected;			//*	could not be registered
+	uint32_t			framesSkipped;			//*	replaced by a newer frame before we got to it
+	int					lastStarCnt;
+	int					lastOffsetX;
+	int					lastOffsetY;
+	uint32_t			lastStackTime_ms;
+} TYPE_LIVESTACK;
+
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+void	LiveStack_Init(		TYPE_LIVESTACK *liveStack);
+void	LiveStack_Release(	TYPE_LIVESTACK *liveStack);
+bool	LiveStack_Start(	TYPE_LIVESTACK		*liveStack,
+							TYPE_LIVESTACK_MODE	stackMode,
+							double				sigmaKappa,
+							int					bayerPattern,
+							const char			*jpegFilePath);
+void	LiveStack_Stop(		TYPE_LIVESTACK *liveStack);
+void	LiveStack_Reset(	TYPE_LIVESTACK *liveStack);
+void	LiveStack_AddFrame(	TYPE_LIVESTACK		*liveStack,
+							const unsigned char	*imageData,
+							const int			width,
+							const int			height,
+							const int			bytesPerPixel,
+							const int			planes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//	_LIVESTACK_H_
@@ -0,0 +1,70 @@
+//**************************************************************************
+//*	Name:			mjpegstream.h
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	MJPEG (multipart/x-mixed-replace) live view stream
+//*
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Mar 20,	2021	<MLS> Created mjpegstream.h
+//*	Mar 30,	2021	<MLS> Added threadDone
+//*****************************************************************************
+//#include	"mjpegstream.h"
+
+#ifndef _MJPEGSTREAM_H_
+#define	_MJPEGSTREAM_H_
+
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<pthread.h>
+
+#define	kMJPEG_Boundary			"alpacapiframe"
+#define	kMJPEG_MaxSubscribers	8
+#define	kMJPEG_MaxScales		4			//*	different preview sizes encoded per frame
+#define	kMJPEG_DefaultMaxDim	800
+
+//*****************************************************************************
+typedef struct
+{
+	int			socket;					//*	-1 if the slot is empty
+	int			scaleIdx;				//*	which encoded size this client gets
+	uint32_t	lastFrameSent;
+	uint32_t	droppedFrames;
+	uint32_t	framesSent;
+} TYPE_MJPEG_SUBSCRIBER;
+
+//*****************************************************************************
+//*	the most recent JPEG for one preview size, encoded once for all of the
+//*	subscribers that asked for that size
+typedef struct
+{
+	int				binFactor;			//*	0 if the slot is not used
+	uint32_t		frameNumber;		//*	0 until the first frame has been encoded
+	unsigned char	*jpegData;
+	unsigned long	jpegLen;
+	unsigned long	jpegBufLen;
+} TYPE_MJPEG_SCALE;
+
+//*****************************************************************************
+typedef struct
+{
+	bool					keepRunning;
+	bool					threadActive;
+	bool					threadDone;			//*	the thread has let go of the stream, it only has to be joined
+	pthread_t				threadID;
+	pthread_mutex_t			streamMutex;
+	pthread_cond_t			frameCond;			//*	signaled when a new frame has been encoded
+
+	TYPE_MJPEG_SUBSCRIBER	subscribers[kMJPEG_MaxSubscribers];
+	int						subscriberCnt;
+	TYPE_MJPEG_SCALE		scales[kMJPEG_MaxScales];
+
+	uint32_t				frameCnt;			//*	frames encoded
+	uint32_t				droppedCnt;			//*	frames skipped by slow subscribers, all of them
+} TYPE_MJPEG_STREAM;
+
+#endif	//	_MJPEGSTREAM_H_
@@ -18,6 +18,10 @@
 //*	Nov  8,	2019	<MLS> Multicam working with 2 cameras, a ZWO and ATIK
 //*	Nov 13,	2019	<MLS> Added setexposuretime, and setlivemode
 //*	Nov 13,	2019	<MLS> Added SetExposureTime() & ExtractDurationList()
+//*	Mar  4,	2021	<MLS> Each camera now has a worker thread, exposures start on a barrier
+//*	Mar  4,	2021	<MLS> startexposure reports the start skew between the cameras
+//*	Mar 30,	2021	<MLS> StartWorkers() fails if a worker cannot be created, the barrier count is always right
+//*	Mar 30,	2021	<MLS> startexposure is refused while a worker is still in the last start
 //==============================
 //*	Mar 29,	2120	<TODO> Change multicam commands to match updated camera commands
 //*****************************************************************************
@@ -30,6 +34,9 @@
 #include	<stdbool.h>
 #include	<ctype.h>
 #include	<stdint.h>
+#include	<time.h>
+#include	<pthread.h>
+#include	<sys/time.h>
 
 #define _ENABLE_CONSOLE_DEBUG_
 #include	"ConsoleDebug.h"
@@ -56,6 +63,8 @@
 #define	kStopRightNow	true
 #define	kStopNormal		false
 
+#define	kWorkerStartTimeout_secs	10		//*	how long to wait for the SDK calls to return
+
 
 
 //*****************************************************************************
@@ -110,6 +119,18 @@ MultiCam::MultiCam(const int argDevNum)
 
 	strcpy(cDeviceName, "MultiCam");
 
+	cCameraCnt			=	0;
+	cMultiCamState		=	0;
+	cWorkersRunning		=	false;
+	cWorkerKeepRunning	=	false;
+	cStartGeneration	=	0;
+	cWorkersDone		=	0;
+	cLastStartSkew_us	=	0;
+	cLastEndSkew_us		=	0;
+	cLastMaxLatency_us	=	0;
+	memset(cWorkers, 0, sizeof(cWorkers));
+	pthread_mutex_init(&cWorkerMutex, NULL);
+	pthread_cond_init(&cWorkerCond, NULL);
 }
 
 //**************************************************************************************
@@ -117,6 +138,144 @@ MultiCam::MultiCam(const int argDevNum)
 //**************************************************************************************
 MultiCam::~MultiCam( void )
 {
+	StopWorkers();
+}
+
+//*****************************************************************************
+static void	*MultiCamWorkerThread(void *arg)
+{
+TYPE_MULTICAM_WORKER	*worker;
+
+	worker	=	(TYPE_MULTICAM_WORKER *)arg;
+	worker->multiCam->RunWorkerThread(worker);
+	return(NULL);
+}
+
+//*****************************************************************************
+//*	the cameras all exist by the time the first exposure is requested.
+//*	The barrier needs every worker, if one of them cannot be created the ones
+//*	that were are stopped again and this returns false
+//*****************************************************************************
+bool	MultiCam::StartWorkers(void)
+{
+int		ii;
+int		threadErr;
+bool	workersOK;
+
+	cCameraCnt	=	0;
+	for (ii=0; ii<gDeviceCnt; ii++)
+	{
+		if ((gAlpacaDeviceList[ii] != NULL) && (gAlpacaDeviceList[ii]->cDeviceType == kDeviceType_Camera))
+		{
+			cWorkers[cCameraCnt].multiCam		=	this;
+			cWorkers[cCameraCnt].cameraObj		=	(CameraDriver *)gAlpacaDeviceList[ii];
+			cWorkers[cCameraCnt].generation		=	0;
+			cWorkers[cCameraCnt].threadActive	=	false;
+			cCameraCnt++;
+		}
+	}
+	CONSOLE_DEBUG_W_NUM("Starting MultiCam workers, cCameraCnt\t=", cCameraCnt);
+
+	//*	the workers do not get to the barrier until the first start request,
+	//*	it is set up after they have all been created
+	workersOK			=	true;
+	cWorkerKeepRunning	=	true;
+	cStartGeneration	=	0;
+	cWorkersDone		=	cCameraCnt;		//*	nobody is busy
+	for (ii=0; (ii<cCameraCnt) && workersOK; ii++)
+	{
+		threadErr	=	pthread_create(&cWorkers[ii].threadID, NULL, &MultiCamWorkerThread, &cWorkers[ii]);
+		if (threadErr == 0)
+		{
+			cWorkers[ii].threadActive	=	true;
+		}
+		else
+		{
+			CONSOLE_DEBUG_W_NUM("Failed to create MultiCam worker, err\t=", threadErr);
+			workersOK	=	false;
+		}
+	}
+	if (workersOK)
+	{
+		//*	the request thread is the last one to arrive at the barrier
+		pthread_barrier_init(&cStartBarrier, NULL, (cCameraCnt + 1));
+		cWorkersRunning	=	true;
+	}
+	else
+	{
+		pthread_mutex_lock(&cWorkerMutex);
+		cWorkerKeepRunning	=	false;
+		pthread_cond_broadcast(&cWorkerCond);
+		pthread_mutex_unlock(&cWorkerMutex);
+
+		for (ii=0; ii<cCameraCnt; ii++)
+		{
+			if (cWorkers[ii].threadActive)
+			{
+				pthread_join(cWorkers[ii].threadID, NULL);
+				cWorkers[ii].threadActive	=	false;
+			}
+		}
+	}
+	return(workersOK);
+}
+
+//*****************************************************************************
+void	MultiCam::StopWorkers(void)
+{
+int		ii;
+
+	if (cWorkersRunning)
+	{
+		pthread_mutex_lock(&cWorkerMutex);
+		cWorkerKeepRunning	=	false;
+		pthread_cond_broadcast(&cWorkerCond);
+		pthread_mutex_unlock(&cWorkerMutex);
+
+		for (ii=0; ii<cCameraCnt; ii++)
+		{
+			if (cWorkers[ii].threadActive)
+			{
+				pthread_join(cWorkers[ii].threadID, NULL);
+				cWorkers[ii].threadActive	=	false;
+			}
+		}
+		pthread_barrier_destroy(&cStartBarrier);
+		cWorkersRunning	=	false;
+	}
+}
+
+//*****************************************************************************
+//*	waits for a start request, then for everyone else at the barrier, then starts
+//*	the exposure. The readout is done by each camera's own capture thread.
+//*****************************************************************************
+void	MultiCam::RunWorkerThread(TYPE_MULTICAM_WORKER *worker)
+{
+	while (cWorkerKeepRunning)
+	{
+		pthread_mutex_lock(&cWorkerMutex);
+		while (cWorkerKeepRunning && (worker->generation == cStartGeneration))
+		{
+			pthread_cond_wait(&cWorkerCond, &cWorkerMutex);
+		}
+		worker->generation	=	cStartGeneration;
+		pthread_mutex_unlock(&cWorkerMutex);
+
+		if (cWorkerKeepRunning)
+		{
+			pthread_barrier_wait(&cStartBarrier);
+
+			worker->callStart_us	=	FrameTiming_GetMonotonic_us();
+			worker->alpacaErrCode	=	worker->cameraObj->Start_CameraExposure(worker->exposure_usecs);
+			worker->callEnd_us		=	FrameTiming_GetMonotonic_us();
+			worker->cameraObj->SaveNextImage();
+
+			pthread_mutex_lock(&cWorkerMutex);
+			cWorkersDone++;
+			pthread_cond_broadcast(&cWorkerCond);
+			pthread_mutex_unlock(&cWorkerMutex);
+		}
+	}
 }
 
 
@@ -366,7 +525,6 @@ int			sLen;
 TYPE_ASCOM_STATUS	MultiCam::StartExposure(TYPE_GetPutRequestData *reqData, char *alpacaErrMsg)
 {
 TYPE_ASCOM_STATUS	alpacaErrCode	=	kASCOM_Err_NotImplemented;
-double				exposureDuration_usecs;
 double				expDurationValues_secs[kMaxDevices];
 int					ii;
 int					cc;
@@ -374,6 +532,12 @@ CameraDriver		*cameraObj;
 struct timeval		currentTime;
 long				curr_millisec;
 long				prev_millisec;
+struct timespec		timeoutTime;
+int					workersDone;
+uint64_t			firstStart_us;
+uint64_t			lastStart_us;
+uint64_t			firstEnd_us;
+uint64_t			lastEnd_us;
 bool				durationFound;
 char				durationString[128];
 bool				objectNameFound;
@@ -473,6 +637,39 @@ char				myFileNameSuffix[kFileNamePrefixMaxLen];
 			}
 		}
 
+		//****************************************************
+		//*	hand the exposure times to the workers and wake them up,
+		//*	they wait at the barrier until we get there
+		//****************************************************
+		if (cWorkersRunning == false)
+		{
+			if (StartWorkers() == false)
+			{
+				alpacaErrCode	=	kASCOM_Err_FailedUnknown;
+				GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Failed to create the camera worker threads");
+				return(alpacaErrCode);
+			}
+		}
+		pthread_mutex_lock(&cWorkerMutex);
+		//*	a worker that timed out last time is still in the SDK call,
+		//*	it would hold everyone at the barrier
+		if (cWorkersDone < cCameraCnt)
+		{
+			pthread_mutex_unlock(&cWorkerMutex);
+			alpacaErrCode	=	kASCOM_Err_InvalidOperation;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "The last start has not finished on all cameras");
+			return(alpacaErrCode);
+		}
+		for (cc=0; cc<cCameraCnt; cc++)
+		{
+			cWorkers[cc].exposure_usecs	=	expDurationValues_secs[cc] * 1000 * 1000;
+			cWorkers[cc].alpacaErrCode	=	kASCOM_Err_Success;
+		}
+		cWorkersDone	=	0;
+		cStartGeneration++;
+		pthread_cond_broadcast(&cWorkerCond);
+		pthread_mutex_unlock(&cWorkerMutex);
+
 		//****************************************************
 		//*	sit here and waste time until we change millisecs
 		//*	this way, the 2 images will have the same time stamp
@@ -486,30 +683,96 @@ char				myFileNameSuffix[kFileNamePrefixMaxLen];
 		}
 
 		//****************************************************
-		//*	now start the exposures
+		//*	now start the exposures, all of the workers go at once
 		//****************************************************
-		cc	=	0;		//*	set the camera counter to zero
-		for (ii=0; ii<gDeviceCnt; ii++)
+		pthread_barrier_wait(&cStartBarrier);
+
+		clock_gettime(CLOCK_REALTIME, &timeoutTime);
+		timeoutTime.tv_sec	+=	kWorkerStartTimeout_secs;
+		pthread_mutex_lock(&cWorkerMutex);
+		while (cWorkersDone < cCameraCnt)
 		{
-			if (gAlpacaDeviceList[ii] != NULL)
+			if (pthread_cond_timedwait(&cWorkerCond, &cWorkerMutex, &timeoutTime) != 0)
 			{
-				if (gAlpacaDeviceList[ii]->cDeviceType == kDeviceType_Camera)
-				{
-				//	CONSOLE_DEBUG("We have a camera");
-				//	exposureDuration_usecs	=	exposureDuration_secs * 1000 * 1000;
-					exposureDuration_usecs	=	expDurationValues_secs[cc] * 1000 * 1000;
-					cameraObj		=	(CameraDriver *)gAlpacaDeviceList[ii];
-					alpacaErrCode	=	cameraObj->Start_CameraExposure(exposureDuration_usecs);
-					cameraObj->SaveNextImage();
-
-					if (alpacaErrCode != 0)
-					{
-						CONSOLE_DEBUG_W_NUM("Start_CameraExposure->alpacaErrCode\t=",	alpacaErrCode);
-					}
+				break;
+			}
+		}
+		workersDone	=	cWorkersDone;
+		pthread_mutex_unlock(&cWorkerMutex);
 
-					cc++;
+		if (workersDone == cCameraCnt)
+		{
+			alpacaErrCode	=	kASCOM_Err_Success;
+			firstStart_us	=	cWorkers[0].callStart_us;
+			lastStart_us	=	cWorkers[0].callStart_us;
+			firstEnd_us		=	cWorkers[0].callEnd_us;
+			lastEnd_us		=	cWorkers[0].callEnd_us;
+			cLastMaxLatency_us	=	0;
+			for (cc=0; cc<cCameraCnt; cc++)
+			{
+				if (cWorkers[cc].callStart_us < firstStart_us)
+				{
+					firstStart_us	=	cWorkers[cc].callStart_us;
+				}
+				if (cWorkers[cc].callStart_us > lastStart_us)
+				{
+					lastStart_us	=	cWorkers[cc].callStart_us;
+				}
+				if (cWorkers[cc].callEnd_us < firstEnd_us)
+				{
+					firstEnd_us	=	cWorkers[cc].callEnd_us;
+				}
+				if (cWorkers[cc].callEnd_us > lastEnd_us)
+				{
+					lastEnd_us	=	cWorkers[cc].callEnd_us;
+				}
+				if ((cWorkers[cc].callEnd_us - cWorkers[cc].callStart_us) > cLastMaxLatency_us)
+				{
+					cLastMaxLatency_us	=	cWorkers[cc].callEnd_us - cWorkers[cc].callStart_us;
+				}
+				if (cWorkers[cc].alpacaErrCode != kASCOM_Err_Success)
+				{
+					CONSOLE_DEBUG_W_NUM("Start_CameraExposure->alpacaErrCode\t=",	cWorkers[cc].alpacaErrCode);
+					alpacaErrCode	=	cWorkers[cc].alpacaErrCode;
+					GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, cWorkers[cc].cameraObj->cDeviceName);
 				}
 			}
+			cLastStartSkew_us	=	lastStart_us - firstStart_us;
+			cLastEndSkew_us		=	lastEnd_us - firstEnd_us;
+
+			JsonResponse_Add_Int32(	reqData->socket,
+									reqData->jsonTextBuffer,
+									kMaxJsonBuffLen,
+									"cameras",
+									cCameraCnt,
+									INCLUDE_COMMA);
+
+			JsonResponse_Add_Int32(	reqData->socket,
+									reqData->jsonTextBuffer,
+									kMaxJsonBuffLen,
+									"startskew-us",
+									cLastStartSkew_us,
+									INCLUDE_COMMA);
+
+			JsonResponse_Add_Int32(	reqData->socket,
+									reqData->jsonTextBuffer,
+									kMaxJsonBuffLen,
+									"endskew-us",
+									cLastEndSkew_us,
+									INCLUDE_COMMA);
+
+			JsonResponse_Add_Int32(	reqData->socket,
+									reqData->jsonTextBuffer,
+									kMaxJsonBuffLen,
+									"maxlatency-us",
+									cLastMaxLatency_us,
+									INCLUDE_COMMA);
+		}
+		else
+		{
+			alpacaErrCode	=	kASCOM_Err_FailedUnknown;
+			GENERATE_ALPACAPI_ERRMSG(alpacaErrMsg, "Timed out waiting for the cameras to start");
+			CONSOLE_DEBUG(alpacaErrMsg);
 		}
 //		CONSOLE_DEBUG_W_INT32("currentTime\t=",		millis());
 	}
@@ -623,6 +886,12 @@ CameraDriver	*cameraObj;
 		SocketWriteData(mySocketFD,	"</TABLE>\r\n");
 		SocketWriteData(mySocketFD,	"<P>\r\n");
 
+		sprintf(lineBuffer, "Last start skew: %u us, SDK return skew: %u us, slowest SDK call: %u us<P>\r\n",
+												cLastStartSkew_us,
+												cLastEndSkew_us,
+												cLastMaxLatency_us);
+		SocketWriteData(mySocketFD,	lineBuffer);
+
 
 		SocketWriteData(mySocketFD,	"</CENTER>\r\n");
 
@@ -17,16 +17,38 @@
 //*****************************************************************************
 //*	<MLS>	=	Mark L Sproul
 //*****************************************************************************
+//*	Mar  4,	2021	<MLS> Added per camera start workers and start skew
+//*	Mar 30,	2021	<MLS> StartWorkers() returns false if the workers could not all be created
 //*****************************************************************************
 //#include	"multicam.h"
 
 #ifndef _DOME_DRIVER_H_
 #define	_DOME_DRIVER_H_
 
+#include	<pthread.h>
+
 #ifndef _ALPACA_DRIVER_H_
 	#include	"alpacadriver.h"
 #endif
 
+class	CameraDriver;
+class	MultiCam;
+
+//**************************************************************************************
+//*	one per camera, they all wait on the same barrier so the exposures start together
+typedef struct
+{
+	MultiCam			*multiCam;
+	CameraDriver		*cameraObj;
+	pthread_t			threadID;
+	bool				threadActive;
+	uint32_t			generation;			//*	last start request this worker handled
+	double				exposure_usecs;
+	uint64_t			callStart_us;		//*	monotonic, just before the SDK call
+	uint64_t			callEnd_us;			//*	monotonic, when the SDK call returned
+	TYPE_ASCOM_STATUS	alpacaErrCode;
+} TYPE_MULTICAM_WORKER;
+
 
 
 //**************************************************************************************
@@ -47,9 +69,28 @@ class MultiCam: public AlpacaDriver
 			TYPE_ASCOM_STATUS		StartExposure(			TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
 			TYPE_ASCOM_STATUS		SetExposureTime(		TYPE_GetPutRequestData *reqData, char *alpacaErrMsg);
 
+				void				RunWorkerThread(TYPE_MULTICAM_WORKER *worker);
+
 	protected:
+				bool				StartWorkers(void);
+				void				StopWorkers(void);
+
 				int		cCameraCnt;
 				int		cMultiCamState;
+
+				TYPE_MULTICAM_WORKER	cWorkers[kMaxDevices];
+				pthread_barrier_t		cStartBarrier;
+				pthread_mutex_t			cWorkerMutex;
+				pthread_cond_t			cWorkerCond;
+				bool					cWorkersRunning;
+				bool					cWorkerKeepRunning;
+				uint32_t				cStartGeneration;
+				int						cWorkersDone;			//*	of the last start, cCameraCnt when nobody is busy
+
+				//*	results of the last synchronized start
+				uint32_t				cLastStartSkew_us;		//*	first to last SDK call
+				uint32_t				cLastEndSkew_us;		//*	first to last SDK return
+				uint32_t				cLastMaxLatency_us;		//*	longest SDK call
 };
 
 
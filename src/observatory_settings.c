@@ -35,6 +35,7 @@
 //*	Dec  9.	2019	<MLS> Added secondary diameter to telescope settings
 //*	Dec 16,	2019	<MLS> Added email to observatory settings
 //*	Dec 16,	2019	<MLS> Added ObservatorySettings_CreateTemplateFile()
+//*	Mar  6,	2021	<MLS> Added fitscompression to telescope settings
 //*****************************************************************************
 
 #include	<stdlib.h>
@@ -80,6 +81,7 @@ enum
 	kObservatory_Comment,
 	kObservatory_FilterName,
 	kObservatory_Filterwheel,
+	kObservatory_FitsCompression,
 	kObservatory_FocalLength,
 	kObservatory_Focuser,
 	kObservatory_Instrument,
@@ -140,6 +142,7 @@ const TYPE_SETTINGS_DEF	gSettingsList[]	=
 	{	"filterwheel",								kObservatory_Filterwheel		},
 	{	"focuser",									kObservatory_Focuser			},
 	{	"instrument",								kObservatory_Instrument			},
+	{	"fitscompression",							kObservatory_FitsCompression	},
 	{	"manufacturer",								kObservatory_Manufacturer		},
 	{	"model",									kObservatory_Model				},
 	{	"#up to N comments per telescope entry",	kObservatory_ignored			},
@@ -188,6 +191,7 @@ char	separaterLine[]	=	"########################################################
 		fprintf(filePointer, "#	All of these fields are optional\n");
 		fprintf(filePointer, "#	Elevation is in feet above sea level\n");
 		fprintf(filePointer, "#	The telescopenum value can be '+' to bump to the next index\n");
+		fprintf(filePointer, "#	fitscompression is none, rice or hcompress for cameras using that telescope\n");
 		fprintf(filePointer, "#	\n");
 		fprintf(filePointer, "#	Note: this template file gets regenerated every time you run this program\n");
 		fprintf(filePointer, "%s",	separaterLine);
@@ -405,6 +409,17 @@ TYPE_TELESCOPE_INFO	*ts_infoPtr;
 			strcpy(ts_infoPtr->filterName,				valueString);
 			break;
 
+		case kObservatory_FitsCompression:
+			if (strlen(valueString) < sizeof(ts_infoPtr->fitsCompression))
+			{
+				strcpy(ts_infoPtr->fitsCompression,		valueString);
+			}
+			else
+			{
+				CONSOLE_DEBUG_W_STR("Invalid fitscompression", valueString)
+			}
+			break;
+
 		case kObservatory_FocalLength:
 			ts_infoPtr->focalLen_mm				=	atof(valueString);
 			break;
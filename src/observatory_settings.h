@@ -41,6 +41,7 @@ typedef struct
 	char			filterwheel[kTelescopeDefMaxStrLen];
 	char			filterName[kTelescopeDefMaxStrLen];		//*	only used if filterwheel is NOT being controlled
 	char			instrument[kInstrumentNameMaxLen];
+	char			fitsCompression[16];	//*	none, rice or hcompress, blank = camera default
 	TYPE_COMMENT	comments[kMaxComments];
 
 } TYPE_TELESCOPE_INFO;
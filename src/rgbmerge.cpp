@@ -1,15 +1,43 @@
 //*****************************************************************************
 //*	rgb Merge
+//*
+//*	Interactive
+//*		rgbmerge red.fits green.fits blue.fits
+//*		the 3 files are loaded and stretched in parallel, one thread each
+//*
+//*	Batch
+//*		rgbmerge -d <directory> [-o <output directory>] [-g <max seconds>]
+//*		merges every R/G/B triplet in the directory, one triplet per core.
+//*		The filter letter is the last thing in the file name before the extension,
+//*		i.e. xxxx-R.fits, the way the camera driver names them.
+//*		The time stamp in the name is ignored for grouping, within a group the
+//*		files are taken in time order and a R, G and B taken within -g seconds
+//*		(default 600) of each other are merged into xxxx-RGB.png.
+//*		Files that do not end up in a set are listed.
 //*****************************************************************************
 //*	Edit History
 //*****************************************************************************
 //*	Mar 25,	2020	<MLS> Started on rgbmerge.cpp
 //*	Apr  9,	2020	<MLS> Now works with 8 bit images
+//*	Mar 24,	2021	<MLS> The 3 color files are now loaded and stretched in parallel
+//*	Mar 24,	2021	<MLS> Stretch and merge loops re-written a row at a time so they vectorize
+//*	Mar 24,	2021	<MLS> Merge now honors widthStep and clips the alignment offsets
+//*	Mar 24,	2021	<MLS> Added batch mode (-d), uses all of the cores
+//*	Mar 30,	2021	<MLS> Batch mode groups the files by name root, incomplete sets are reported
+//*	Mar 30,	2021	<MLS> Batch mode ignores the time stamp in the name, pairs in time order (-g)
 //*****************************************************************************
 
 #include	<string.h>
+#include	<strings.h>
 #include	<stdio.h>
+#include	<stdlib.h>
+#include	<stdint.h>
 #include	<stdbool.h>
+#include	<math.h>
+#include	<time.h>
+#include	<unistd.h>
+#include	<dirent.h>
+#include	<pthread.h>
 
 #include "opencv/highgui.h"
 #include "opencv2/highgui/highgui_c.h"
@@ -23,13 +51,8 @@
 #define _ENABLE_CONSOLE_DEBUG_
 #include	"ConsoleDebug.h"
 
-int	gTranslationMap8bit[256];
-int	gHistogram16bit[1 << 16];
-int	gTranslationMap16bit[1 << 16];
-
-int	gPixelWidth		=	0;
-int	gPixelHeight	=	0;
-int	gPixelDepth		=	0;
+//*	16 bits so that the table stays in the cache with 3 threads using it
+uint16_t	gTranslationMap16bit[1 << 16];
 
 //**************************************************************************************
 static void	InitTranisitionMap(void)
@@ -41,14 +64,6 @@ double		radianValue;
 
 	CONSOLE_DEBUG(__FUNCTION__);
 
-	for (iii=0; iii<256; iii++)
-	{
-		gTranslationMap8bit[iii]	=	iii*16;
-		if (gTranslationMap8bit[iii] > 255)
-		{
-			gTranslationMap8bit[iii]	=	255;
-		}
-	}
 	iii	=	0;
 	while (iii<65535)
 	{
@@ -97,14 +112,17 @@ class FitsImage
 		//
 					FitsImage(const char *filePath, int whichColor);
 		virtual		~FitsImage(void);
+			bool	LoadImage(void);
+			void	ShowImage(void);
 			void	Adjust8bitImage(void);
 			void	Adjust16bitImage(void);
 			void	Adjust16bitImageLinear(void);
 
+			void	GetShiftedRow(int rowNum, unsigned char *rowBuffer);
 			void	CopyIntoColorPlane(IplImage	*colorCV_Image);
 
 			int			cWhichColor;	//	0=red, 1=green, 2=blue
-			char		cFileName[64];
+			char		cFileName[256];
 			IplImage	*cOpenCV_Image;
 			IplImage	*cSmallCV_Image;
 			int			cXoffset;			//*	these are the offsets for aligning the image
@@ -122,11 +140,107 @@ enum
 };
 
 //*****************************************************************************
-FitsImage::FitsImage(const char *filePath, int whichColor)
+//*	the row kernels, plain loops with no aliasing so that the compiler
+//*	vectorizes them (NEON on the Pi, SSE/AVX on x86)
+//*****************************************************************************
+//*	same curve as the old 8 bit translation map, x16 and clipped
+static void	StretchRow8(uint8_t *__restrict__ pixelRow, const int count)
 {
-int		newWidth;
-int		newHeight;
+int		ii;
+uint8_t	pixelValue;
+
+	for (ii=0; ii<count; ii++)
+	{
+		pixelValue		=	pixelRow[ii];
+		pixelRow[ii]	=	(pixelValue > 15) ? 255 : (pixelValue << 4);
+	}
+}
+
+//*****************************************************************************
+//*	everything at or below the histogram peak goes to 0, the rest is x3
+static void	ClipAndScaleRow16(uint16_t *__restrict__ pixelRow, const int count, const uint16_t peakValue)
+{
+int			ii;
+uint32_t	pixelValue;
+uint32_t	newPixValue;
+
+	for (ii=0; ii<count; ii++)
+	{
+		pixelValue	=	pixelRow[ii];
+		newPixValue	=	pixelValue * 3;
+		if (newPixValue > 0x0ffff)
+		{
+			newPixValue	=	0x0ffff;
+		}
+		if (pixelValue <= peakValue)
+		{
+			newPixValue	=	0;
+		}
+		pixelRow[ii]	=	newPixValue;
+	}
+}
+
+//*****************************************************************************
+//*	openCV is BGR instead of RGB
+static void	InterleaveRow8(	uint8_t *__restrict__		colorRow,
+							const uint8_t *__restrict__	redRow,
+							const uint8_t *__restrict__	grnRow,
+							const uint8_t *__restrict__	bluRow,
+							const int					count)
+{
+int		ii;
+
+	for (ii=0; ii<count; ii++)
+	{
+		colorRow[(3 * ii) + 0]	=	bluRow[ii];
+		colorRow[(3 * ii) + 1]	=	grnRow[ii];
+		colorRow[(3 * ii) + 2]	=	redRow[ii];
+	}
+}
+
+//*****************************************************************************
+static void	InterleaveRow16(uint16_t *__restrict__			colorRow,
+							const uint16_t *__restrict__	redRow,
+							const uint16_t *__restrict__	grnRow,
+							const uint16_t *__restrict__	bluRow,
+							const int						count)
+{
+int		ii;
+
+	for (ii=0; ii<count; ii++)
+	{
+		colorRow[(3 * ii) + 0]	=	bluRow[ii];
+		colorRow[(3 * ii) + 1]	=	grnRow[ii];
+		colorRow[(3 * ii) + 2]	=	redRow[ii];
+	}
+}
+
+//*****************************************************************************
+//*	colorRow already points at the plane
+static void	CopyRowIntoPlane8(uint8_t *__restrict__ colorRow, const uint8_t *__restrict__ planeRow, const int count)
+{
+int		ii;
+
+	for (ii=0; ii<count; ii++)
+	{
+		colorRow[3 * ii]	=	planeRow[ii];
+	}
+}
+
+//*****************************************************************************
+static void	CopyRowIntoPlane16(uint16_t *__restrict__ colorRow, const uint16_t *__restrict__ planeRow, const int count)
+{
+int		ii;
+
+	for (ii=0; ii<count; ii++)
+	{
+		colorRow[3 * ii]	=	planeRow[ii];
+	}
+}
 
+//*****************************************************************************
+FitsImage::FitsImage(const char *filePath, int whichColor)
+{
 	CONSOLE_DEBUG(__FUNCTION__);
 	cWhichColor	=	whichColor;
 	cYoffset	=	0;
@@ -138,15 +252,35 @@ int		newHeight;
 	}
 	cXoffset	=	0;
 
-	strcpy(cFileName, filePath);
-	cOpenCV_Image	=	ReadImageIntoOpenCVimage(filePath);
+	strncpy(cFileName, filePath, (sizeof(cFileName) - 1));
+	cFileName[sizeof(cFileName) - 1]	=	0;
+	cOpenCV_Image	=	NULL;
+	cSmallCV_Image	=	NULL;
+}
+
+//**************************************************************************************
+// Destructor
+//**************************************************************************************
+FitsImage::~FitsImage( void )
+{
 	if (cOpenCV_Image != NULL)
 	{
-		//*	save for the color image creation
-		gPixelWidth		=	cOpenCV_Image->width;
-		gPixelHeight	=	cOpenCV_Image->height;
-		gPixelDepth		=	cOpenCV_Image->depth;
+		cvReleaseImage(&cOpenCV_Image);
+	}
+	if (cSmallCV_Image != NULL)
+	{
+		cvReleaseImage(&cSmallCV_Image);
+	}
+}
 
+//**************************************************************************************
+//*	reads and stretches the image, does not touch the display so it can run on any thread
+//**************************************************************************************
+bool	FitsImage::LoadImage(void)
+{
+	cOpenCV_Image	=	ReadImageIntoOpenCVimage(cFileName);
+	if (cOpenCV_Image != NULL)
+	{
 		if (cOpenCV_Image->depth == 16)
 		{
 		//	Adjust16bitImage();
@@ -156,8 +290,22 @@ int		newHeight;
 		{
 			Adjust8bitImage();
 		}
-		CONSOLE_DEBUG(__FUNCTION__);
+		return(true);
+	}
+	CONSOLE_DEBUG_W_STR("Failed to read", cFileName);
+	return(false);
+}
+
+//**************************************************************************************
+//*	openCV windows have to be handled from the main thread
+//**************************************************************************************
+void	FitsImage::ShowImage(void)
+{
+int		newWidth;
+int		newHeight;
 
+	if (cOpenCV_Image != NULL)
+	{
 		newWidth		=	cOpenCV_Image->width / 4;
 		newHeight		=	cOpenCV_Image->height / 4;
 		if (cOpenCV_Image->depth == 16)
@@ -168,9 +316,8 @@ int		newHeight;
 		{
 			cSmallCV_Image	=	cvCreateImage(cvSize(newWidth, newHeight), IPL_DEPTH_8U, 1);
 		}
-		CONSOLE_DEBUG(__FUNCTION__);
 		cvResize(cOpenCV_Image, cSmallCV_Image, CV_INTER_LINEAR);
-		cvNamedWindow(	filePath,
+		cvNamedWindow(	cFileName,
 					//	(CV_WINDOW_NORMAL)
 					//	(CV_WINDOW_NORMAL | CV_WINDOW_FULLSCREEN | CV_WINDOW_KEEPRATIO | CV_GUI_NORMAL)
 					//+	(CV_WINDOW_NORMAL | CV_WINDOW_KEEPRATIO | CV_GUI_EXPANDED)
@@ -180,18 +327,7 @@ int		newHeight;
 						);
 
 		cvShowImage(cFileName, cSmallCV_Image);
-		CONSOLE_DEBUG(__FUNCTION__);
 	}
-		CONSOLE_DEBUG(__FUNCTION__);
-}
-
-//**************************************************************************************
-// Destructor
-//**************************************************************************************
-FitsImage::~FitsImage( void )
-{
-
-
 }
 
 //**************************************************************************************
@@ -199,36 +335,21 @@ void FitsImage::Adjust8bitImage(void)
 {
 int			myWidth;
 int			myHeight;
-int			pixelCount;
-int			ii;
+int			jjj;
 uint8_t		*myBytePtr;
-uint8_t		myPixelValue;
 
 	CONSOLE_DEBUG(__FUNCTION__);
 
-	if (cOpenCV_Image != NULL)
+	if ((cOpenCV_Image != NULL) && (cOpenCV_Image->imageData != NULL))
 	{
 		myWidth			=	cOpenCV_Image->width;
 		myHeight		=	cOpenCV_Image->height;
-		pixelCount		=	myWidth * myHeight;
-		CONSOLE_DEBUG_W_NUM("myWidth\t=", myWidth);
-		CONSOLE_DEBUG_W_NUM("myHeight\t=", myHeight);
-		CONSOLE_DEBUG_W_NUM("pixelCount\t=", pixelCount);
-		myBytePtr		=	(uint8_t *)cOpenCV_Image->imageData;
-		if (myBytePtr != NULL)
-		{
-			for (ii=0; ii<pixelCount; ii++)
-			{
-				myPixelValue	=	myBytePtr[ii] & 0x00ff;
-				myBytePtr[ii]	=	gTranslationMap8bit[myPixelValue];
-			}
-		}
-		else
+		for (jjj=0; jjj<myHeight; jjj++)
 		{
-			CONSOLE_DEBUG("myBytePtr is NULL");
+			myBytePtr	=	(uint8_t *)cOpenCV_Image->imageData + ((long)jjj * cOpenCV_Image->widthStep);
+			StretchRow8(myBytePtr, myWidth);
 		}
 	}
-	CONSOLE_DEBUG(__FUNCTION__);
 }
 
 //**************************************************************************************
@@ -236,10 +357,9 @@ void FitsImage::Adjust16bitImageLinear(void)
 {
 int			myWidth;
 int			myHeight;
-int			pixelCount;
 int			ii;
+int			jjj;
 uint16_t	*myShortPtr;
-int			myPixelValue;
 
 	CONSOLE_DEBUG(__FUNCTION__);
 
@@ -247,12 +367,14 @@ int			myPixelValue;
 	{
 		myWidth			=	cOpenCV_Image->width;
 		myHeight		=	cOpenCV_Image->height;
-		pixelCount		=	myWidth * myHeight;
-		myShortPtr		=	(uint16_t *)cOpenCV_Image->imageData;
-		for (ii=0; ii<pixelCount; ii++)
+		for (jjj=0; jjj<myHeight; jjj++)
 		{
-			myPixelValue	=	myShortPtr[ii] & 0x00ffff;
-			myShortPtr[ii]	=	gTranslationMap16bit[myPixelValue];
+			//*	a table lookup, this one does not vectorize
+			myShortPtr	=	(uint16_t *)(cOpenCV_Image->imageData + ((long)jjj * cOpenCV_Image->widthStep));
+			for (ii=0; ii<myWidth; ii++)
+			{
+				myShortPtr[ii]	=	gTranslationMap16bit[myShortPtr[ii]];
+			}
 		}
 	}
 }
@@ -262,87 +384,104 @@ void FitsImage::Adjust16bitImage(void)
 {
 int			myWidth;
 int			myHeight;
-int			pixelCount;
 int			ii;
+int			jjj;
 uint16_t	*myShortPtr;
-int			pixelValue16;
-int			peakPixelValue;
+uint32_t	*histogram;
+uint32_t	peakPixelValue;
 int			peakPixelIdx;
-int			newPixValue;
 
 	CONSOLE_DEBUG(__FUNCTION__);
 
 	if (cOpenCV_Image != NULL)
 	{
-
-		for (ii=0; ii<65536; ii++)
+		//*	not a global any more, the 3 colors are done at the same time
+		histogram	=	(uint32_t *)calloc(65536, sizeof(uint32_t));
+		if (histogram == NULL)
 		{
-			gHistogram16bit[ii]	=	0;
+			return;
 		}
 		myWidth			=	cOpenCV_Image->width;
 		myHeight		=	cOpenCV_Image->height;
-		pixelCount		=	myWidth * myHeight;
-		myShortPtr		=	(uint16_t *)cOpenCV_Image->imageData;
-		for (ii=0; ii<pixelCount; ii++)
+		for (jjj=0; jjj<myHeight; jjj++)
 		{
-			pixelValue16		=	myShortPtr[ii] & 0x00ffff;
-			gHistogram16bit[pixelValue16]++;
+			myShortPtr	=	(uint16_t *)(cOpenCV_Image->imageData + ((long)jjj * cOpenCV_Image->widthStep));
+			for (ii=0; ii<myWidth; ii++)
+			{
+				histogram[myShortPtr[ii]]++;
+			}
 		}
 		//*	now find the peak value
 		peakPixelValue	=	0;
 		peakPixelIdx	=	0;
 		for (ii=0; ii<65536; ii++)
 		{
-			if (gHistogram16bit[ii] > peakPixelValue)
+			if (histogram[ii] > peakPixelValue)
 			{
-				peakPixelValue	=	gHistogram16bit[ii];
+				peakPixelValue	=	histogram[ii];
 				peakPixelIdx	=	ii;
 			}
 		}
-		//*	now go through and set every thing below that peak to 0
-		for (ii=0; ii<pixelCount; ii++)
-		{
-			pixelValue16		=	myShortPtr[ii] & 0x00ffff;
-			if (pixelValue16 <= peakPixelIdx)
-			{
-				myShortPtr[ii]	=	0;
-			}
-		}
-		for (ii=0; ii<pixelCount; ii++)
+		free(histogram);
+
+		//*	set every thing at or below that peak to 0 and scale the rest, one pass
+		for (jjj=0; jjj<myHeight; jjj++)
 		{
-			pixelValue16		=	myShortPtr[ii] & 0x00ffff;
-			newPixValue			=	pixelValue16 * 3;
-			if (newPixValue > 0x0ffff)
-			{
-				newPixValue		=	0x0ffff;
-			}
-			myShortPtr[ii]	=	newPixValue;
+			myShortPtr	=	(uint16_t *)(cOpenCV_Image->imageData + ((long)jjj * cOpenCV_Image->widthStep));
+			ClipAndScaleRow16(myShortPtr, myWidth, peakPixelIdx);
 		}
+	}
+}
+
+//*****************************************************************************
+//*	one row of this image moved by the alignment offsets, what is outside is 0
+//*****************************************************************************
+void	FitsImage::GetShiftedRow(int rowNum, unsigned char *rowBuffer)
+{
+int		myWidth;
+int		bytesPerPixel;
+int		srcRowNum;
+int		shiftCnt;
+char	*srcRowPtr;
 
+	myWidth			=	cOpenCV_Image->width;
+	bytesPerPixel	=	cOpenCV_Image->depth / 8;
+	srcRowNum		=	rowNum + cYoffset;
+	if ((srcRowNum < 0) || (srcRowNum >= cOpenCV_Image->height))
+	{
+		memset(rowBuffer, 0, (myWidth * bytesPerPixel));
+		return;
+	}
+	srcRowPtr	=	cOpenCV_Image->imageData + ((long)srcRowNum * cOpenCV_Image->widthStep);
+	shiftCnt	=	abs(cXoffset);
+	if (shiftCnt > myWidth)
+	{
+		shiftCnt	=	myWidth;
+	}
+	if (cXoffset >= 0)
+	{
+		memcpy(rowBuffer, srcRowPtr + (shiftCnt * bytesPerPixel), ((myWidth - shiftCnt) * bytesPerPixel));
+		memset(rowBuffer + ((myWidth - shiftCnt) * bytesPerPixel), 0, (shiftCnt * bytesPerPixel));
+	}
+	else
+	{
+		memset(rowBuffer, 0, (shiftCnt * bytesPerPixel));
+		memcpy(rowBuffer + (shiftCnt * bytesPerPixel), srcRowPtr, ((myWidth - shiftCnt) * bytesPerPixel));
 	}
 }
 
+//*****************************************************************************
+//*	updates just this color, used when the alignment is changed
 //*****************************************************************************
 void FitsImage::CopyIntoColorPlane(IplImage	*colorCV_Image)
 {
-int			myWidth;
-int			myHeight;
-int			myDepth;
-int			pixelCount;
-int			iii;
-int			jjj;
-uint16_t	*myShortPtr;
-uint16_t	*colorShortPtr;
-uint8_t		*myBytePtr;
-uint8_t		*colorBytePtr;
-int			colorWidth;
-int			colorHeight;
-int			colorDepth;
-int			ccc;
-int			myPixelValue16;
-int			myPixelValue8;
-int			myPixIdx;
-int			clrPixIdx;
+int				myWidth;
+int				myHeight;
+int				myDepth;
+int				jjj;
+unsigned char	*rowBuffer;
+char			*colorRowPtr;
+int				planeIdx;
 
 	CONSOLE_DEBUG(__FUNCTION__);
 
@@ -350,135 +489,576 @@ int			clrPixIdx;
 	myHeight		=	cOpenCV_Image->height;
 	myDepth			=	cOpenCV_Image->depth;
 
-	colorWidth		=	colorCV_Image->width;
-	colorHeight		=	colorCV_Image->height;
-	colorDepth		=	colorCV_Image->depth;
-	CONSOLE_DEBUG_W_NUM("myDepth\t=", myDepth);
-	CONSOLE_DEBUG_W_NUM("colorDepth\t=", colorDepth);
-
-
-
-	if ((myWidth == colorWidth) && (myHeight == colorHeight) && (myDepth == colorDepth))
+	if ((myWidth == colorCV_Image->width) && (myHeight == colorCV_Image->height) && (myDepth == colorCV_Image->depth))
 	{
-		if (myDepth == 8)
+		rowBuffer	=	(unsigned char *)malloc(myWidth * (myDepth / 8));
+		if (rowBuffer != NULL)
 		{
-			CONSOLE_DEBUG("Processing 8 bit image");
-			pixelCount		=	myWidth * myHeight;
-	//		CONSOLE_DEBUG_W_NUM("pixelCount\t=", pixelCount);
-
-			myBytePtr		=	(uint8_t *)cOpenCV_Image->imageData;
-			colorBytePtr	=	(uint8_t *)colorCV_Image->imageData;
-			ccc				=	0;
-
-			//*	this has to be done a row at a time so that we can shift an image
-	//		CONSOLE_DEBUG_W_NUM("cOpenCV_Image->widthStep\t=", cOpenCV_Image->widthStep);
-	//		CONSOLE_DEBUG_W_NUM("colorCV_Image->widthStep\t=", colorCV_Image->widthStep);
-
-			//*	jjj is which row (Y directon)
+			//*	openCV is BGR instead of RGB
+			planeIdx	=	2 - cWhichColor;
 			for (jjj=0; jjj<myHeight; jjj++)
 			{
-				if ((jjj + cYoffset) >= 0)
+				GetShiftedRow(jjj, rowBuffer);
+				colorRowPtr	=	colorCV_Image->imageData + ((long)jjj * colorCV_Image->widthStep);
+				if (myDepth == 8)
 				{
-					//*	iii is which colum (X direction)
-					for (iii=0; iii<myWidth; iii++)
-					{
-						clrPixIdx			=	(jjj * colorCV_Image->widthStep) + iii;
-						myPixIdx			=	((jjj + cYoffset) * myWidth) + (iii + cXoffset);
-						myPixelValue8		=	myBytePtr[myPixIdx] & 0x00ff;
-						switch(cWhichColor)
-						{
-							//*	openCV is GBR instead of RBG
-							case kColorRed:
-								colorBytePtr[ccc + 2]	=	myPixelValue8;
-								break;
-
-							case kColorGrn:
-								colorBytePtr[ccc + 1]	=	myPixelValue8;
-								break;
-
-							case kColorBlu:
-								colorBytePtr[ccc + 0]	=	myPixelValue8;
-								break;
-						}
-						ccc	+=	3;
-					}
+					CopyRowIntoPlane8((uint8_t *)colorRowPtr + planeIdx, rowBuffer, myWidth);
 				}
 				else
 				{
-					ccc	+=	3 * myWidth;
+					CopyRowIntoPlane16((uint16_t *)colorRowPtr + planeIdx, (uint16_t *)rowBuffer, myWidth);
 				}
 			}
+			free(rowBuffer);
+		}
+	}
+	else
+	{
+		CONSOLE_DEBUG("Image mis match");
+	}
+}
+
+//*****************************************************************************
+//*	all 3 colors in one pass over the color image
+//*****************************************************************************
+static bool	MergeColorImage(FitsImage *redImage, FitsImage *grnImage, FitsImage *bluImage, IplImage *colorCV_Image)
+{
+IplImage		*redCV_Image;
+IplImage		*grnCV_Image;
+IplImage		*bluCV_Image;
+int				myWidth;
+int				myHeight;
+int				myDepth;
+size_t			rowLen;
+unsigned char	*rowBuffer;
+char			*colorRowPtr;
+int				jjj;
+
+	redCV_Image	=	redImage->cOpenCV_Image;
+	grnCV_Image	=	grnImage->cOpenCV_Image;
+	bluCV_Image	=	bluImage->cOpenCV_Image;
+	myWidth		=	redCV_Image->width;
+	myHeight	=	redCV_Image->height;
+	myDepth		=	redCV_Image->depth;
+	if ((grnCV_Image->width != myWidth) || (grnCV_Image->height != myHeight) || (grnCV_Image->depth != myDepth) ||
+		(bluCV_Image->width != myWidth) || (bluCV_Image->height != myHeight) || (bluCV_Image->depth != myDepth) ||
+		(colorCV_Image->width != myWidth) || (colorCV_Image->height != myHeight) || (colorCV_Image->depth != myDepth))
+	{
+		CONSOLE_DEBUG("Image mis match");
+		return(false);
+	}
+
+	rowLen		=	myWidth * (myDepth / 8);
+	rowBuffer	=	(unsigned char *)malloc(3 * rowLen);
+	if (rowBuffer == NULL)
+	{
+		return(false);
+	}
+	for (jjj=0; jjj<myHeight; jjj++)
+	{
+		redImage->GetShiftedRow(jjj, rowBuffer);
+		grnImage->GetShiftedRow(jjj, rowBuffer + rowLen);
+		bluImage->GetShiftedRow(jjj, rowBuffer + (2 * rowLen));
+		colorRowPtr	=	colorCV_Image->imageData + ((long)jjj * colorCV_Image->widthStep);
+		if (myDepth == 8)
+		{
+			InterleaveRow8(	(uint8_t *)colorRowPtr,
+							rowBuffer,
+							rowBuffer + rowLen,
+							rowBuffer + (2 * rowLen),
+							myWidth);
 		}
 		else
 		{
-			CONSOLE_DEBUG("Processing 16 bit image");
-			pixelCount		=	myWidth * myHeight;
-	//		CONSOLE_DEBUG_W_NUM("pixelCount\t=", pixelCount);
+			InterleaveRow16((uint16_t *)colorRowPtr,
+							(uint16_t *)rowBuffer,
+							(uint16_t *)(rowBuffer + rowLen),
+							(uint16_t *)(rowBuffer + (2 * rowLen)),
+							myWidth);
+		}
+	}
+	free(rowBuffer);
+	return(true);
+}
 
-			myShortPtr		=	(uint16_t *)cOpenCV_Image->imageData;
-			colorShortPtr	=	(uint16_t *)colorCV_Image->imageData;
-			ccc				=	0;
+//*****************************************************************************
+static IplImage	*CreateColorImage(FitsImage *redImage)
+{
+IplImage	*colorCV_Image;
+CvSize		imageSize;
 
-			//*	this has to be done a row at a time so that we can shift an image
-	//		CONSOLE_DEBUG_W_NUM("cOpenCV_Image->widthStep\t=", cOpenCV_Image->widthStep);
-	//		CONSOLE_DEBUG_W_NUM("colorCV_Image->widthStep\t=", colorCV_Image->widthStep);
+	imageSize	=	cvSize(redImage->cOpenCV_Image->width, redImage->cOpenCV_Image->height);
+	if (redImage->cOpenCV_Image->depth == 16)
+	{
+		colorCV_Image	=	cvCreateImage(imageSize, IPL_DEPTH_16U, 3);
+	}
+	else
+	{
+		colorCV_Image	=	cvCreateImage(imageSize, IPL_DEPTH_8U, 3);
+	}
+	return(colorCV_Image);
+}
 
-			//*	jjj is which row (Y directon)
-			for (jjj=0; jjj<myHeight; jjj++)
+//*****************************************************************************
+static void	*LoadImageThread(void *arg)
+{
+	((FitsImage *)arg)->LoadImage();
+	return(NULL);
+}
+
+//*****************************************************************************
+//*	the 3 colors are read and stretched at the same time
+//*****************************************************************************
+static bool	LoadColorImages(FitsImage *imageList[3])
+{
+pthread_t	threadID[2];
+bool		threadOK[2];
+int			ii;
+
+	for (ii=0; ii<2; ii++)
+	{
+		threadOK[ii]	=	(pthread_create(&threadID[ii], NULL, &LoadImageThread, imageList[ii]) == 0);
+		if (threadOK[ii] == false)
+		{
+			//*	do it here instead
+			imageList[ii]->LoadImage();
+		}
+	}
+	imageList[2]->LoadImage();
+	for (ii=0; ii<2; ii++)
+	{
+		if (threadOK[ii])
+		{
+			pthread_join(threadID[ii], NULL);
+		}
+	}
+	return((imageList[0]->cOpenCV_Image != NULL) &&
+			(imageList[1]->cOpenCV_Image != NULL) &&
+			(imageList[2]->cOpenCV_Image != NULL));
+}
+
+//*****************************************************************************
+void	SaveImage(IplImage	*colorCV_Image, const char *imageFileName)
+{
+int			openCVerr;
+//int		quality[3] = {CV_IMWRITE_PNG_COMPRESSION, 200, 0};
+int			quality[3] = {16, 200, 0};
+
+	openCVerr	=	cvSaveImage(imageFileName, colorCV_Image, quality);
+	if (openCVerr == 0)
+	{
+		CONSOLE_DEBUG_W_STR("Failed to save", imageFileName);
+	}
+}
+
+#pragma mark -
+
+//*****************************************************************************
+typedef struct
+{
+	char	fileName[3][256];		//*	red, green, blue
+	char	outputFile[256];
+} TYPE_RGB_TRIPLET;
+
+//*****************************************************************************
+//*	one fits file found in the batch directory
+//*****************************************************************************
+typedef struct
+{
+	char	*fileName;
+	char	pairingKey[256];		//*	name root without the time stamp and the filter letter
+	double	timeStamp;				//*	seconds, 0 if the name has no time stamp
+	int		whichColor;
+} TYPE_BATCH_FILE;
+
+//*	the camera driver puts the exposure start time in every name,
+//*	YYYY-MM-DDTHH_MM_SS.mmm (FormatTimeStringFileName)
+#define	kFileNameTimeStampLen	23
+
+static TYPE_RGB_TRIPLET	*gTripletList		=	NULL;
+static int				gTripletCnt			=	0;
+static int				gNextTriplet		=	0;
+static int				gMergeErrorCnt		=	0;
+static double			gMaxTripletGap_secs	=	600.0;
+static pthread_mutex_t	gTripletMutex		=	PTHREAD_MUTEX_INITIALIZER;
+
+//*****************************************************************************
+//*	xxxx-R.fits returns kColorRed, -1 if the name does not end in a filter letter
+//*****************************************************************************
+static int	GetFileNameColor(const char *fileName)
+{
+const char	*extPtr;
+int			whichColor;
+
+	whichColor	=	-1;
+	extPtr		=	strrchr(fileName, '.');
+	if ((extPtr != NULL) && ((extPtr - fileName) >= 2) &&
+		((strcasecmp(extPtr, ".fits") == 0) || (strcasecmp(extPtr, ".fit") == 0)) &&
+		((extPtr[-2] == '-') || (extPtr[-2] == '_')))
+	{
+		switch(extPtr[-1])
+		{
+			case 'R':
+			case 'r':
+				whichColor	=	kColorRed;
+				break;
+
+			case 'G':
+			case 'g':
+				whichColor	=	kColorGrn;
+				break;
+
+			case 'B':
+			case 'b':
+				whichColor	=	kColorBlu;
+				break;
+		}
+	}
+	return(whichColor);
+}
+
+//*****************************************************************************
+//*	length of the name without the -R.fits, only for names GetFileNameColor() accepted
+//*****************************************************************************
+static int	GetFileNameRootLen(const char *fileName)
+{
+	return((strrchr(fileName, '.') - fileName) - 2);
+}
+
+//*****************************************************************************
+//*	The 3 colors of a set are taken one after the other, so the time stamp is
+//*	different in each name. The pairing key is the root with the time stamp
+//*	taken out, the time stamp itself is returned in seconds.
+//*****************************************************************************
+static void	ParseBatchFileName(TYPE_BATCH_FILE *batchFile)
+{
+const char	*fileName;
+int			rootLen;
+int			stampOffset;
+int			charsRead;
+struct tm	timeStruct;
+int			milliSecs;
+int			ii;
+
+	fileName				=	batchFile->fileName;
+	rootLen					=	GetFileNameRootLen(fileName);
+	batchFile->whichColor	=	GetFileNameColor(fileName);
+	batchFile->timeStamp	=	0.0;
+	stampOffset				=	-1;
+	for (ii=0; ii<=(rootLen - kFileNameTimeStampLen); ii++)
+	{
+		memset(&timeStruct, 0, sizeof(struct tm));
+		charsRead	=	0;
+		if ((fileName[ii] >= '0') && (fileName[ii] <= '9') &&
+			(sscanf(&fileName[ii], "%4d-%2d-%2dT%2d_%2d_%2d.%3d%n",	&timeStruct.tm_year,
+																	&timeStruct.tm_mon,
+																	&timeStruct.tm_mday,
+																	&timeStruct.tm_hour,
+																	&timeStruct.tm_min,
+																	&timeStruct.tm_sec,
+																	&milliSecs,
+																	&charsRead) == 7) &&
+			(charsRead == kFileNameTimeStampLen))
+		{
+			timeStruct.tm_year		-=	1900;
+			timeStruct.tm_mon		-=	1;
+			batchFile->timeStamp	=	timegm(&timeStruct) + (milliSecs / 1000.0);
+			stampOffset				=	ii;
+			break;
+		}
+	}
+	if (stampOffset >= 0)
+	{
+		snprintf(batchFile->pairingKey, sizeof(batchFile->pairingKey), "%.*s%.*s",
+																	stampOffset,
+																	fileName,
+																	(rootLen - stampOffset - kFileNameTimeStampLen),
+																	&fileName[stampOffset + kFileNameTimeStampLen]);
+	}
+	else
+	{
+		snprintf(batchFile->pairingKey, sizeof(batchFile->pairingKey), "%.*s", rootLen, fileName);
+	}
+}
+
+//*****************************************************************************
+//*	same key together, in time order
+//*****************************************************************************
+static int	CompareBatchFiles(const void *entry1, const void *entry2)
+{
+const TYPE_BATCH_FILE	*batchFile1;
+const TYPE_BATCH_FILE	*batchFile2;
+int						returnValue;
+
+	batchFile1	=	(const TYPE_BATCH_FILE *)entry1;
+	batchFile2	=	(const TYPE_BATCH_FILE *)entry2;
+	returnValue	=	strcmp(batchFile1->pairingKey, batchFile2->pairingKey);
+	if (returnValue == 0)
+	{
+		if (batchFile1->timeStamp < batchFile2->timeStamp)
+		{
+			returnValue	=	-1;
+		}
+		else if (batchFile1->timeStamp > batchFile2->timeStamp)
+		{
+			returnValue	=	1;
+		}
+	}
+	if (returnValue == 0)
+	{
+		returnValue	=	batchFile1->whichColor - batchFile2->whichColor;
+	}
+	if (returnValue == 0)
+	{
+		returnValue	=	strcmp(batchFile1->fileName, batchFile2->fileName);
+	}
+	return(returnValue);
+}
+
+//*****************************************************************************
+static void	ReportOrphans(TYPE_BATCH_FILE *pendingFile[3])
+{
+int		whichColor;
+
+	for (whichColor=0; whichColor<3; whichColor++)
+	{
+		if (pendingFile[whichColor] != NULL)
+		{
+			printf("No complete R/G/B set, skipped: %s\r\n", pendingFile[whichColor]->fileName);
+			pendingFile[whichColor]	=	NULL;
+		}
+	}
+}
+
+//*****************************************************************************
+//*	returns the number of triplets found.
+//*	The files are grouped by the name without the time stamp and the -R/-G/-B.fits,
+//*	within a group they are taken in time order and a R, G and B that are all
+//*	within gMaxTripletGap_secs of the first one make a set.
+//*	Anything left over is reported as an orphan and skipped
+//*****************************************************************************
+static int	FindColorTriplets(const char *directoryPath, const char *outputDirectory)
+{
+DIR					*directory;
+struct dirent		*dir;
+TYPE_BATCH_FILE		*fileList;
+TYPE_BATCH_FILE		*newList;
+TYPE_BATCH_FILE		*batchFile;
+TYPE_BATCH_FILE		*pendingFile[3];
+int					fileCnt;
+int					fileListSize;
+int					whichColor;
+double				firstTimeStamp;
+int					ii;
+TYPE_RGB_TRIPLET	*triplet;
+
+	fileList		=	NULL;
+	fileCnt			=	0;
+	fileListSize	=	0;
+	directory		=	opendir(directoryPath);
+	if (directory == NULL)
+	{
+		CONSOLE_DEBUG_W_STR("Failed to open", directoryPath);
+		return(0);
+	}
+	while ((dir = readdir(directory)) != NULL)
+	{
+		if ((dir->d_name[0] != '.') && (GetFileNameColor(dir->d_name) >= 0))
+		{
+			if (fileCnt >= fileListSize)
 			{
-				if ((jjj + cYoffset) >= 0)
-				{
-					//*	iii is which colum (X direction)
-					for (iii=0; iii<myWidth; iii++)
-					{
-						clrPixIdx			=	(jjj * colorCV_Image->widthStep) + iii;
-						myPixIdx			=	((jjj + cYoffset) * myWidth) + (iii + cXoffset);
-						myPixelValue16		=	myShortPtr[myPixIdx] & 0x00ffff;
-						switch(cWhichColor)
-						{
-							//*	openCV is GBR instead of RBG
-							case kColorRed:
-								colorShortPtr[ccc + 2]	=	myPixelValue16;
-								break;
-
-							case kColorGrn:
-								colorShortPtr[ccc + 1]	=	myPixelValue16;
-								break;
-
-							case kColorBlu:
-								colorShortPtr[ccc + 0]	=	myPixelValue16;
-								break;
-						}
-						ccc	+=	3;
-					}
-				}
-				else
+				fileListSize	+=	256;
+				newList			=	(TYPE_BATCH_FILE *)realloc(fileList, fileListSize * sizeof(TYPE_BATCH_FILE));
+				if (newList == NULL)
 				{
-					ccc	+=	3 * myWidth;
+					break;
 				}
+				fileList	=	newList;
+			}
+			fileList[fileCnt].fileName	=	strdup(dir->d_name);
+			if (fileList[fileCnt].fileName != NULL)
+			{
+				ParseBatchFileName(&fileList[fileCnt]);
+				fileCnt++;
 			}
 		}
 	}
-	else
+	closedir(directory);
+
+	qsort(fileList, fileCnt, sizeof(TYPE_BATCH_FILE), CompareBatchFiles);
+
+	gTripletList	=	(TYPE_RGB_TRIPLET *)calloc((fileCnt / 3) + 1, sizeof(TYPE_RGB_TRIPLET));
+	gTripletCnt		=	0;
+	pendingFile[0]	=	NULL;
+	pendingFile[1]	=	NULL;
+	pendingFile[2]	=	NULL;
+	firstTimeStamp	=	0.0;
+	for (ii=0; (ii<fileCnt) && (gTripletList != NULL); ii++)
 	{
-		CONSOLE_DEBUG("Image mis match");
+		batchFile	=	&fileList[ii];
+		whichColor	=	batchFile->whichColor;
+		if ((pendingFile[0] != NULL) || (pendingFile[1] != NULL) || (pendingFile[2] != NULL))
+		{
+			//*	a new group, a repeated color or too long since the first one
+			//*	all mean the pending files will never make a set
+			if ((strcmp(batchFile->pairingKey, fileList[ii - 1].pairingKey) != 0) ||
+				(pendingFile[whichColor] != NULL) ||
+				((batchFile->timeStamp - firstTimeStamp) > gMaxTripletGap_secs))
+			{
+				ReportOrphans(pendingFile);
+			}
+		}
+		if ((pendingFile[0] == NULL) && (pendingFile[1] == NULL) && (pendingFile[2] == NULL))
+		{
+			firstTimeStamp	=	batchFile->timeStamp;
+		}
+		pendingFile[whichColor]	=	batchFile;
+
+		if ((pendingFile[kColorRed] != NULL) && (pendingFile[kColorGrn] != NULL) && (pendingFile[kColorBlu] != NULL))
+		{
+			triplet	=	&gTripletList[gTripletCnt];
+			//*	xxxx-R.fits -> xxxx-RGB.png, named after the red one
+			snprintf(triplet->outputFile, sizeof(triplet->outputFile), "%s/%.*sRGB.png",
+																	outputDirectory,
+																	(GetFileNameRootLen(pendingFile[kColorRed]->fileName) + 1),
+																	pendingFile[kColorRed]->fileName);
+			for (whichColor=0; whichColor<3; whichColor++)
+			{
+				snprintf(triplet->fileName[whichColor], sizeof(triplet->fileName[0]), "%s/%s", directoryPath, pendingFile[whichColor]->fileName);
+				pendingFile[whichColor]	=	NULL;
+			}
+			gTripletCnt++;
+		}
 	}
+	ReportOrphans(pendingFile);
+
+	for (ii=0; ii<fileCnt; ii++)
+	{
+		free(fileList[ii].fileName);
+	}
+	free(fileList);
+	return(gTripletCnt);
 }
 
 //*****************************************************************************
-void	SaveImage(IplImage	*colorCV_Image)
+static bool	MergeTriplet(TYPE_RGB_TRIPLET *triplet)
 {
-int			openCVerr;
-char		imageFileName[64];
-char		imageFilePath[128];
-//int		quality[3] = {CV_IMWRITE_PNG_COMPRESSION, 200, 0};
-int			quality[3] = {16, 200, 0};
+FitsImage	*imageList[3];
+IplImage	*colorCV_Image;
+bool		mergeOK;
+int			ii;
+
+	mergeOK	=	false;
+	for (ii=0; ii<3; ii++)
+	{
+		imageList[ii]	=	new FitsImage(triplet->fileName[ii], ii);
+	}
+	//*	one triplet per core, the colors are loaded one after the other here
+	if (imageList[0]->LoadImage() && imageList[1]->LoadImage() && imageList[2]->LoadImage())
+	{
+		colorCV_Image	=	CreateColorImage(imageList[0]);
+		if (colorCV_Image != NULL)
+		{
+			mergeOK	=	MergeColorImage(imageList[0], imageList[1], imageList[2], colorCV_Image);
+			if (mergeOK)
+			{
+				SaveImage(colorCV_Image, triplet->outputFile);
+			}
+			cvReleaseImage(&colorCV_Image);
+		}
+	}
+	for (ii=0; ii<3; ii++)
+	{
+		delete imageList[ii];
+	}
+	return(mergeOK);
+}
 
-	openCVerr	=	cvSaveImage("color.png", colorCV_Image, quality);
-//	openCVerr	=	cvSaveImage("color.jpg", colorCV_Image, quality);
+//*****************************************************************************
+static void	*BatchMergeThread(void *arg)
+{
+int		tripletIdx;
+bool	mergeOK;
 
+	while (true)
+	{
+		pthread_mutex_lock(&gTripletMutex);
+		tripletIdx	=	gNextTriplet++;
+		pthread_mutex_unlock(&gTripletMutex);
+		if (tripletIdx >= gTripletCnt)
+		{
+			break;
+		}
+		mergeOK	=	MergeTriplet(&gTripletList[tripletIdx]);
+		printf("%s %s\r\n", (mergeOK ? "Created" : "FAILED "), gTripletList[tripletIdx].outputFile);
+		if (mergeOK == false)
+		{
+			pthread_mutex_lock(&gTripletMutex);
+			gMergeErrorCnt++;
+			pthread_mutex_unlock(&gTripletMutex);
+		}
+	}
+	return(NULL);
 }
 
+//*****************************************************************************
+static int	RunBatchMerge(const char *directoryPath, const char *outputDirectory)
+{
+pthread_t	*threadID;
+bool		*threadOK;
+int			threadCnt;
+int			ii;
+
+	if (outputDirectory == NULL)
+	{
+		outputDirectory	=	directoryPath;
+	}
+	FindColorTriplets(directoryPath, outputDirectory);
+	printf("%d R/G/B triplets found in %s\r\n", gTripletCnt, directoryPath);
+	if (gTripletCnt == 0)
+	{
+		return(0);
+	}
+
+	threadCnt	=	sysconf(_SC_NPROCESSORS_ONLN);
+	if (threadCnt > gTripletCnt)
+	{
+		threadCnt	=	gTripletCnt;
+	}
+	if (threadCnt < 1)
+	{
+		threadCnt	=	1;
+	}
+	threadID	=	(pthread_t *)calloc(threadCnt, sizeof(pthread_t));
+	threadOK	=	(bool *)calloc(threadCnt, sizeof(bool));
+	if ((threadID != NULL) && (threadOK != NULL))
+	{
+		for (ii=1; ii<threadCnt; ii++)
+		{
+			threadOK[ii]	=	(pthread_create(&threadID[ii], NULL, &BatchMergeThread, NULL) == 0);
+		}
+	}
+	//*	this thread does its share too
+	BatchMergeThread(NULL);
+	if ((threadID != NULL) && (threadOK != NULL))
+	{
+		for (ii=1; ii<threadCnt; ii++)
+		{
+			if (threadOK[ii])
+			{
+				pthread_join(threadID[ii], NULL);
+			}
+		}
+	}
+	free(threadID);
+	free(threadOK);
+	free(gTripletList);
+	printf("%d merged, %d errors\r\n", (gTripletCnt - gMergeErrorCnt), gMergeErrorCnt);
+	return((gMergeErrorCnt > 0) ? 1 : 0);
+}
+
+#pragma mark -
+
 //*****************************************************************************
 int	HandleKeyDownEvents(void)
 {
@@ -518,20 +1098,19 @@ bool			keepGoing;
 int main(int argc, char *argv[])
 {
 int				ii;
-int				fileIdx;
+FitsImage		*imageList[3];
 FitsImage		*fitsImageRed;
 FitsImage		*fitsImageGrn;
 FitsImage		*fitsImageBlu;
 IplImage		*colorCV_Image;
 int				keyPressed;
-char			myWindowName[128];
-bool			createWindow;
 bool			keepGoing;
 char			firstChar;
 char			argChar;
 bool			keepLooping;
-bool			fileIsFits;
 int				imgCnt;
+const char		*batchDirectory;
+const char		*outputDirectory;
 char			colorWindowName[]	=	"color";
 char			currentPlane	=	'g';
 bool	updateFlag;
@@ -541,15 +1120,11 @@ bool	updateFlag;
 	CONSOLE_DEBUG_W_NUM("argc\t\t=", argc);
 	InitTranisitionMap();
 
-	if (argc < 3)
-	{
-		CONSOLE_DEBUG("Must specify 3 files");
-		exit(0);
-	}
-
-	fitsImageRed	=	NULL;
-	fitsImageGrn	=	NULL;
-	fitsImageBlu	=	NULL;
+	batchDirectory	=	NULL;
+	outputDirectory	=	NULL;
+	keepLooping		=	false;
+	updateFlag		=	false;
+	imgCnt			=	0;
 
 	//*	check for cmd line parameters
 	for (ii=1; ii<argc; ii++)
@@ -563,70 +1138,76 @@ bool	updateFlag;
 				case 'a':
 					break;
 
-				case 'l':
-					keepLooping	=	true;
+				case 'd':
+					if ((ii + 1) < argc)
+					{
+						ii++;
+						batchDirectory	=	argv[ii];
+					}
 					break;
 
-			}
-		}
-	}
-
-	//*	there should be 3 files specified
-
-	createWindow	=	true;
-	keepGoing		=	true;
-	fileIdx			=	1;
-	imgCnt			=	0;
-	while ((fileIdx < argc) && (imgCnt < 3))
-	{
-		CONSOLE_DEBUG(__FUNCTION__);
-		if (strstr(argv[fileIdx], "fits") != NULL)
-		{
-			fileIsFits	=	true;
-			switch(imgCnt)
-			{
-				case 0:
-					fitsImageRed	=	new FitsImage(argv[fileIdx], kColorRed);
+				case 'g':
+					if ((ii + 1) < argc)
+					{
+						ii++;
+						gMaxTripletGap_secs	=	atof(argv[ii]);
+					}
 					break;
 
-				case 1:
-					fitsImageGrn	=	new FitsImage(argv[fileIdx], kColorGrn);
+				case 'l':
+					keepLooping	=	true;
 					break;
 
-				case 2:
-					fitsImageBlu	=	new FitsImage(argv[fileIdx], kColorBlu);
+				case 'o':
+					if ((ii + 1) < argc)
+					{
+						ii++;
+						outputDirectory	=	argv[ii];
+					}
 					break;
+
 			}
-			imgCnt++;
 		}
-		else
+		else if ((strstr(argv[ii], "fits") != NULL) && (imgCnt < 3))
 		{
-			fileIsFits	=	false;
+			//*	there should be 3 files specified, red, green, blue
+			imageList[imgCnt]	=	new FitsImage(argv[ii], imgCnt);
+			imgCnt++;
 		}
+	}
 
+	if (batchDirectory != NULL)
+	{
+		return(RunBatchMerge(batchDirectory, outputDirectory));
+	}
 
-		fileIdx++;
+	if (imgCnt < 3)
+	{
+		CONSOLE_DEBUG("Must specify 3 files");
+		exit(0);
 	}
-	CONSOLE_DEBUG(__FUNCTION__);
+	fitsImageRed	=	imageList[kColorRed];
+	fitsImageGrn	=	imageList[kColorGrn];
+	fitsImageBlu	=	imageList[kColorBlu];
 
-	//*	now create the merge image
-	if (gPixelDepth == 16)
+	if (LoadColorImages(imageList) == false)
 	{
-		CONSOLE_DEBUG("16 bit color image");
-		colorCV_Image	=	cvCreateImage(cvSize(gPixelWidth, gPixelHeight), IPL_DEPTH_16U, 3);
+		CONSOLE_DEBUG("Failed to load the 3 files");
+		exit(0);
 	}
-	else
+	for (ii=0; ii<3; ii++)
 	{
-		CONSOLE_DEBUG("8 bit color image");
-		colorCV_Image	=	cvCreateImage(cvSize(gPixelWidth, gPixelHeight), IPL_DEPTH_8U, 3);
+		imageList[ii]->ShowImage();
 	}
+	CONSOLE_DEBUG(__FUNCTION__);
+
+	//*	now create the merge image
+	keepGoing		=	true;
+	colorCV_Image	=	CreateColorImage(fitsImageRed);
 	if (colorCV_Image != NULL)
 	{
 		CONSOLE_DEBUG(__FUNCTION__);
-		fitsImageRed->CopyIntoColorPlane(colorCV_Image);
-		fitsImageGrn->CopyIntoColorPlane(colorCV_Image);
-		fitsImageBlu->CopyIntoColorPlane(colorCV_Image);
-
+		MergeColorImage(fitsImageRed, fitsImageGrn, fitsImageBlu, colorCV_Image);
 
 		cvNamedWindow(	colorWindowName,
 					//	(CV_WINDOW_NORMAL)
@@ -639,6 +1220,10 @@ bool	updateFlag;
 
 		cvShowImage(colorWindowName, colorCV_Image);
 	}
+	else
+	{
+		keepGoing	=	false;
+	}
 
 	while (keepGoing)
 	{
@@ -726,7 +1311,7 @@ bool	updateFlag;
 					break;
 
 				case 's':
-					SaveImage(colorCV_Image);
+					SaveImage(colorCV_Image, "color.png");
 					break;
 			}
 		}
@@ -0,0 +1,101 @@
+//**************************************************************************
+//*	Name:			roistream.h
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	High rate region of interest streaming for focusing and guiding
+//*
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Mar  2,	2021	<MLS> Created roistream.h
+//*****************************************************************************
+//#include	"roistream.h"
+
+#ifndef _ROISTREAM_H_
+#define	_ROISTREAM_H_
+
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<pthread.h>
+
+#define	kROIstream_Signature		"AROI"		//*	AlpacaPi Region Of Interest
+#define	kROIstream_ContentType		"application/x-alpacapi-roistream"
+#define	kROIstream_MaxSubscribers	8
+#define	kROIstream_MinSize			16			//*	smallest ROI width/height
+#define	kROIstream_MaxSize			1024		//*	largest ROI width/height
+#define	kROIstream_CentroidBox		16			//*	half width of the centroid box around the peak
+
+//*****************************************************************************
+//*	every frame on the subscriber connection starts with this header, followed by
+//*	dataLength bytes of pixels, row major, little endian.
+//*	headerLength lets fields be added to the end without breaking old clients.
+//*	centroid values are in full sensor coordinates, -1 if nothing was found
+typedef struct
+{
+	char		signature[4];
+	uint32_t	headerLength;
+	uint32_t	frameNumber;
+	uint32_t	startX;
+	uint32_t	startY;
+	uint32_t	width;
+	uint32_t	height;
+	uint32_t	bytesPerPixel;			//*	1 or 2
+	uint64_t	timeStamp_us;			//*	wall clock, micro seconds since 1970
+	uint64_t	monotonic_us;			//*	same clock as the frame timing
+	uint32_t	exposure_us;
+	uint32_t	dataLength;
+	float		centroidX;
+	float		centroidY;
+	float		peakValue;
+	float		background;
+	float		noise;					//*	std deviation of the background
+	float		flux;					//*	sum above the background inside the centroid box
+	uint32_t	starPixels;				//*	pixels that were used for the centroid
+	uint32_t	droppedFrames;			//*	frames this subscriber missed because it fell behind
+} TYPE_ROI_FRAME_HEADER;
+
+//*****************************************************************************
+typedef struct
+{
+	int			socket;					//*	-1 if the slot is empty
+	uint32_t	droppedFrames;
+	uint32_t	framesSent;
+} TYPE_ROI_SUBSCRIBER;
+
+//*****************************************************************************
+typedef struct
+{
+	bool				active;
+	bool				keepRunning;
+	bool				threadActive;
+	pthread_t			threadID;
+	pthread_mutex_t		streamMutex;
+	pthread_cond_t		frameCond;			//*	signaled by drivers that have a frame callback
+
+	int					startX;
+	int					startY;
+	int					width;
+	int					height;
+	int					bytesPerPixel;
+	int32_t				exposure_us;
+	double				duration_secs;		//*	0 = until stopped
+	uint64_t			startTime_us;
+
+	unsigned char		*frameBuffer;		//*	from the image pool
+	long				frameBufLen;
+	bool				framePosted;		//*	a callback driver has filled frameBuffer
+	uint64_t			frameTime_us;		//*	monotonic time the frame arrived, set by the driver
+
+	TYPE_ROI_SUBSCRIBER	subscribers[kROIstream_MaxSubscribers];
+	int					subscriberCnt;
+
+	uint32_t			frameCnt;
+	uint32_t			readErrCnt;
+	double				framesPerSec;
+	TYPE_ROI_FRAME_HEADER	lastFrame;		//*	header of the most recent frame, for status requests
+} TYPE_ROI_STREAM;
+
+#endif	//	_ROISTREAM_H_
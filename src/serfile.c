@@ -0,0 +1,547 @@
+//**************************************************************************
+//*	Name:			serfile.c
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	SER video file writer
+//*
+//*					The capture loop asks for an empty frame buffer, has the camera SDK
+//*					fill it directly and then queues it with its time stamp.
+//*					A separate thread copies the queued frames into a large staging
+//*					buffer and writes it to disk in big aligned blocks so the capture
+//*					loop never waits on the file system.
+//*					If the queue is full the frame is counted as dropped.
+//*					The queue gets as many frames as fit in kSER_QueueMemory, a
+//*					small ROI gets a deep queue, a full frame of a big sensor does
+//*					not use up all of the memory on a Raspberry Pi.
+//*
+//*					The frame time stamps (UTC) are written as the SER trailer when
+//*					the file is closed and the header is updated with the frame count.
+//*					If the time stamp list can not grow, the ones already recorded
+//*					are kept and the rest of the trailer is written as 0 (unknown).
+//*
+//*	Limitations:	Assumes a little endian machine (Raspberry Pi, x86, Jetson)
+//*
+//*****************************************************************************
+//*	AlpacaPi is an open source project written in C/C++
+//*
+//*	Use of this source code for private or individual use is granted
+//*	Use of this source code, in whole or in part for commercial purpose requires
+//*	written agreement in advance.
+//*
+//*	You may use or modify this source code in any way you find useful, provided
+//*	that you agree that the author(s) have no warranty, obligations or liability.  You
+//*	must determine the suitability of this source code for your use.
+//*
+//*	Redistributions of this source code must retain this copyright notice.
+//*****************************************************************************
+//*
+//*	References:
+//*		http://www.grischa-hahn.homepage.t-online.de/astro/ser/SER%20Doc%20V3b.pdf
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb  2,	2021	<MLS> Created serfile.c
+//*	Feb  2,	2021	<MLS> Added SER_Open(), SER_GetFrameBuffer(), SER_QueueFrame(), SER_Close()
+//*	Feb  3,	2021	<MLS> Added writer thread and staging buffer for aligned writes
+//*	Feb  3,	2021	<MLS> Added optional O_DIRECT output
+//*	Mar 30,	2021	<MLS> The queue depth comes from kSER_QueueMemory, not a fixed 16 frames
+//*	Mar 30,	2021	<MLS> A failed time stamp realloc is logged, the trailer keeps what was recorded
+//*****************************************************************************
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<errno.h>
+#include	<fcntl.h>
+#include	<unistd.h>
+#include	<time.h>
+#include	<sys/time.h>
+#include	<sys/types.h>
+#include	<sys/stat.h>
+#include	<pthread.h>
+
+#define _ENABLE_CONSOLE_DEBUG_
+#include	"ConsoleDebug.h"
+
+#include	"serfile.h"
+
+//*	number of 100ns ticks between Jan 1, 0001 and Jan 1, 1970
+#define	kSER_TicksToUnixEpoch	621355968000000000LL
+
+//*****************************************************************************
+int64_t	SER_ConvertTimeval(struct timeval *timeStamp)
+{
+int64_t	serTicks;
+
+	serTicks	=	(int64_t)timeStamp->tv_sec * 10000000LL;
+	serTicks	+=	(int64_t)timeStamp->tv_usec * 10LL;
+	serTicks	+=	kSER_TicksToUnixEpoch;
+	return(serTicks);
+}
+
+//*****************************************************************************
+static uint32_t	RoundUpToAlignment(uint32_t byteCount)
+{
+	return(((byteCount + kSER_Alignment - 1) / kSER_Alignment) * kSER_Alignment);
+}
+
+//*****************************************************************************
+//*	write the entire staging buffer to disk
+//*	with O_DIRECT the length must be a multiple of the alignment,
+//*	only the very last block gets padded
+//*****************************************************************************
+static void	FlushBlockBuffer(TYPE_SER_WRITER *serWriter, bool lastBlock)
+{
+uint32_t	bytesToWrite;
+ssize_t		bytesWritten;
+
+	bytesToWrite	=	serWriter->blockBytes;
+	if (lastBlock && serWriter->directIO)
+	{
+		bytesToWrite	=	RoundUpToAlignment(serWriter->blockBytes);
+		memset(serWriter->blockBuffer + serWriter->blockBytes, 0, (bytesToWrite - serWriter->blockBytes));
+	}
+	if (bytesToWrite > 0)
+	{
+		bytesWritten	=	write(serWriter->fileDesc, serWriter->blockBuffer, bytesToWrite);
+		if (bytesWritten != (ssize_t)bytesToWrite)
+		{
+			serWriter->writeErrors++;
+			CONSOLE_DEBUG_W_NUM("SER write failed, errno\t=", errno);
+		}
+	}
+	//*	the padding does not count, the file gets truncated to the real size on close
+	serWriter->fileBytesWritten	+=	serWriter->blockBytes;
+	serWriter->blockBytes		=	0;
+}
+
+//*****************************************************************************
+static void	AppendToBlockBuffer(TYPE_SER_WRITER *serWriter, unsigned char *dataPtr, uint32_t byteCount)
+{
+uint32_t	bytesThisPass;
+
+	while (byteCount > 0)
+	{
+		bytesThisPass	=	kSER_WriteBlockSize - serWriter->blockBytes;
+		if (bytesThisPass > byteCount)
+		{
+			bytesThisPass	=	byteCount;
+		}
+		memcpy(serWriter->blockBuffer + serWriter->blockBytes, dataPtr, bytesThisPass);
+		serWriter->blockBytes	+=	bytesThisPass;
+		dataPtr					+=	bytesThisPass;
+		byteCount				-=	bytesThisPass;
+
+		if (serWriter->blockBytes >= kSER_WriteBlockSize)
+		{
+			FlushBlockBuffer(serWriter, false);
+		}
+	}
+}
+
+//*****************************************************************************
+//*	once the list fails to grow no more are recorded, the trailer has to be in
+//*	frame order so there can not be a gap in the middle
+//*****************************************************************************
+static void	SaveFrameTimeStamp(TYPE_SER_WRITER *serWriter, int64_t frameTimeStamp)
+{
+int64_t		*newList;
+uint32_t	newAlloc;
+
+	if (serWriter->timeStampCnt != serWriter->framesWritten)
+	{
+		//*	already ran out
+		return;
+	}
+	if (serWriter->timeStampCnt >= serWriter->timeStampAlloc)
+	{
+		newAlloc	=	serWriter->timeStampAlloc * 2;
+		newList		=	(int64_t *)realloc(serWriter->timeStampList, newAlloc * sizeof(int64_t));
+		if (newList != NULL)
+		{
+			serWriter->timeStampList	=	newList;
+			serWriter->timeStampAlloc	=	newAlloc;
+		}
+		else
+		{
+			CONSOLE_DEBUG_W_NUM("Failed to grow the SER time stamp list, time stamps kept\t=", serWriter->timeStampCnt);
+		}
+	}
+	if (serWriter->timeStampCnt < serWriter->timeStampAlloc)
+	{
+		serWriter->timeStampList[serWriter->timeStampCnt]	=	frameTimeStamp;
+		serWriter->timeStampCnt++;
+	}
+}
+
+//*****************************************************************************
+static void	*SER_WriterThread(void *arg)
+{
+TYPE_SER_WRITER	*serWriter;
+int				slotIdx;
+
+	serWriter	=	(TYPE_SER_WRITER *)arg;
+
+	pthread_mutex_lock(&serWriter->queueMutex);
+	while (serWriter->keepRunning || (serWriter->queueCount > 0))
+	{
+		while ((serWriter->queueCount == 0) && serWriter->keepRunning)
+		{
+			pthread_cond_wait(&serWriter->queueCond, &serWriter->queueMutex);
+		}
+		if (serWriter->queueCount == 0)
+		{
+			break;
+		}
+		slotIdx	=	serWriter->queueTail;
+		pthread_mutex_unlock(&serWriter->queueMutex);
+
+		//*	the slot belongs to us until queueTail is advanced
+		AppendToBlockBuffer(serWriter, serWriter->frameBuffer[slotIdx], serWriter->frameSize);
+		SaveFrameTimeStamp(serWriter, serWriter->frameTimeStamp[slotIdx]);
+
+		pthread_mutex_lock(&serWriter->queueMutex);
+		serWriter->framesWritten++;
+		serWriter->queueTail	=	(serWriter->queueTail + 1) % serWriter->queueDepth;
+		serWriter->queueCount--;
+	}
+	pthread_mutex_unlock(&serWriter->queueMutex);
+	return(NULL);
+}
+
+//*****************************************************************************
+static void	FreeWriterBuffers(TYPE_SER_WRITER *serWriter)
+{
+int	ii;
+
+	for (ii=0; ii<kSER_MaxQueueDepth; ii++)
+	{
+		if (serWriter->frameBuffer[ii] != NULL)
+		{
+			free(serWriter->frameBuffer[ii]);
+			serWriter->frameBuffer[ii]	=	NULL;
+		}
+	}
+	if (serWriter->blockBuffer != NULL)
+	{
+		free(serWriter->blockBuffer);
+		serWriter->blockBuffer	=	NULL;
+	}
+	if (serWriter->timeStampList != NULL)
+	{
+		free(serWriter->timeStampList);
+		serWriter->timeStampList	=	NULL;
+	}
+}
+
+//*****************************************************************************
+//*	returns 0 on success, -1 on failure
+//*	bitsPerPixel is per plane, 8 or 16
+//*****************************************************************************
+int	SER_Open(	TYPE_SER_WRITER	*serWriter,
+				const char		*filePath,
+				const int		width,
+				const int		height,
+				const int		bitsPerPixel,
+				const int		colorID,
+				const char		*observer,
+				const char		*instrument,
+				const char		*telescope,
+				const bool		useDirectIO)
+{
+int				returnCode;
+int				openFlags;
+int				planeCnt;
+int				bytesPerPlane;
+int				ii;
+int				threadErr;
+bool			buffersOK;
+struct timeval	timeNow;
+struct tm		localTm;
+
+	CONSOLE_DEBUG_W_STR("SER file\t=", filePath);
+	returnCode	=	-1;
+	memset(serWriter, 0, sizeof(TYPE_SER_WRITER));
+	serWriter->fileDesc	=	-1;
+	strncpy(serWriter->filePath, filePath, (sizeof(serWriter->filePath) - 1));
+
+	planeCnt		=	(colorID >= kSER_COLOR_RGB) ? 3 : 1;
+	bytesPerPlane	=	(bitsPerPixel > 8) ? 2 : 1;
+	serWriter->frameSize	=	width * height * planeCnt * bytesPerPlane;
+
+	serWriter->queueDepth	=	kSER_MinQueueDepth;
+	if (serWriter->frameSize > 0)
+	{
+		serWriter->queueDepth	=	kSER_QueueMemory / RoundUpToAlignment(serWriter->frameSize);
+	}
+	if (serWriter->queueDepth < kSER_MinQueueDepth)
+	{
+		serWriter->queueDepth	=	kSER_MinQueueDepth;
+	}
+	if (serWriter->queueDepth > kSER_MaxQueueDepth)
+	{
+		serWriter->queueDepth	=	kSER_MaxQueueDepth;
+	}
+	CONSOLE_DEBUG_W_NUM("SER queue depth\t=", serWriter->queueDepth);
+
+	//*	allocate the frame queue and staging buffer on aligned boundaries
+	buffersOK	=	true;
+	for (ii=0; ii<serWriter->queueDepth; ii++)
+	{
+		if (posix_memalign((void **)&serWriter->frameBuffer[ii],
+							kSER_Alignment,
+							RoundUpToAlignment(serWriter->frameSize)) != 0)
+		{
+			serWriter->frameBuffer[ii]	=	NULL;
+			buffersOK					=	false;
+		}
+	}
+	if (posix_memalign((void **)&serWriter->blockBuffer, kSER_Alignment, kSER_WriteBlockSize) != 0)
+	{
+		serWriter->blockBuffer	=	NULL;
+		buffersOK				=	false;
+	}
+	serWriter->timeStampAlloc	=	1024;
+	serWriter->timeStampList	=	(int64_t *)malloc(serWriter->timeStampAlloc * sizeof(int64_t));
+	if (serWriter->timeStampList == NULL)
+	{
+		buffersOK	=	false;
+	}
+
+	if (buffersOK && (serWriter->frameSize > 0))
+	{
+		openFlags	=	O_WRONLY | O_CREAT | O_TRUNC;
+	#ifdef O_DIRECT
+		if (useDirectIO)
+		{
+			serWriter->fileDesc	=	open(filePath, (openFlags | O_DIRECT), 0644);
+			if (serWriter->fileDesc >= 0)
+			{
+				serWriter->directIO	=	true;
+			}
+			else
+			{
+				//*	not all file systems support O_DIRECT (tmpfs for example)
+				CONSOLE_DEBUG("O_DIRECT not supported, using normal I/O");
+			}
+		}
+	#endif // O_DIRECT
+		if (serWriter->fileDesc < 0)
+		{
+			serWriter->fileDesc	=	open(filePath, openFlags, 0644);
+		}
+	}
+
+	if (serWriter->fileDesc >= 0)
+	{
+		//*	fill in the header, the frame count gets updated on close
+		memcpy(serWriter->header.FileID, "LUCAM-RECORDER", 14);
+		serWriter->header.LuID					=	0;
+		serWriter->header.ColorID				=	colorID;
+		//*	the spec says 1 is little endian, but all the common software
+		//*	(FireCapture, SharpCap, AutoStakkert) use 0 for little endian data
+		serWriter->header.LittleEndian			=	0;
+		serWriter->header.ImageWidth			=	width;
+		serWriter->header.ImageHeight			=	height;
+		serWriter->header.PixelDepthPerPlane	=	bitsPerPixel;
+		serWriter->header.FrameCount			=	0;
+		if (observer != NULL)
+		{
+			strncpy(serWriter->header.Observer, observer, (sizeof(serWriter->header.Observer) - 1));
+		}
+		if (instrument != NULL)
+		{
+			strncpy(serWriter->header.Instrument, instrument, (sizeof(serWriter->header.Instrument) - 1));
+		}
+		if (telescope != NULL)
+		{
+			strncpy(serWriter->header.Telescope, telescope, (sizeof(serWriter->header.Telescope) - 1));
+		}
+		gettimeofday(&timeNow, NULL);
+		serWriter->header.DateTime_UTC	=	SER_ConvertTimeval(&timeNow);
+		localtime_r(&timeNow.tv_sec, &localTm);
+		serWriter->header.DateTime		=	serWriter->header.DateTime_UTC +
+											((int64_t)localTm.tm_gmtoff * 10000000LL);
+
+		//*	reserve space for the header at the front of the first block
+		memcpy(serWriter->blockBuffer, &serWriter->header, kSER_HeaderSize);
+		serWriter->blockBytes	=	kSER_HeaderSize;
+
+		pthread_mutex_init(&serWriter->queueMutex, NULL);
+		pthread_cond_init(&serWriter->queueCond, NULL);
+		serWriter->keepRunning	=	true;
+		threadErr	=	pthread_create(&serWriter->threadID, NULL, &SER_WriterThread, serWriter);
+		if (threadErr == 0)
+		{
+			serWriter->threadActive	=	true;
+			returnCode				=	0;
+		}
+		else
+		{
+			CONSOLE_DEBUG_W_NUM("Failed to create SER writer thread, err\t=", threadErr);
+			pthread_mutex_destroy(&serWriter->queueMutex);
+			pthread_cond_destroy(&serWriter->queueCond);
+			close(serWriter->fileDesc);
+			serWriter->fileDesc	=	-1;
+		}
+	}
+	else
+	{
+		CONSOLE_DEBUG_W_STR("Failed to create SER file\t=", filePath);
+	}
+
+	if (returnCode != 0)
+	{
+		FreeWriterBuffers(serWriter);
+	}
+	return(returnCode);
+}
+
+//*****************************************************************************
+//*	returns a buffer for the next frame or NULL if the writer has fallen behind
+//*	in which case the frame is counted as dropped
+//*****************************************************************************
+unsigned char	*SER_GetFrameBuffer(TYPE_SER_WRITER *serWriter)
+{
+unsigned char	*frameBufPtr;
+
+	frameBufPtr	=	NULL;
+	if (serWriter->threadActive)
+	{
+		pthread_mutex_lock(&serWriter->queueMutex);
+		if (serWriter->queueCount < serWriter->queueDepth)
+		{
+			frameBufPtr	=	serWriter->frameBuffer[serWriter->queueHead];
+		}
+		else
+		{
+			serWriter->framesDropped++;
+		}
+		pthread_mutex_unlock(&serWriter->queueMutex);
+	}
+	return(frameBufPtr);
+}
+
+//*****************************************************************************
+//*	hands the buffer returned by SER_GetFrameBuffer() to the writer thread
+//*****************************************************************************
+void	SER_QueueFrame(TYPE_SER_WRITER *serWriter, struct timeval *timeStamp)
+{
+	if (serWriter->threadActive)
+	{
+		pthread_mutex_lock(&serWriter->queueMutex);
+		if (serWriter->queueCount < serWriter->queueDepth)
+		{
+			serWriter->frameTimeStamp[serWriter->queueHead]	=	SER_ConvertTimeval(timeStamp);
+			serWriter->queueHead	=	(serWriter->queueHead + 1) % serWriter->queueDepth;
+			serWriter->queueCount++;
+			serWriter->framesQueued++;
+			if (serWriter->queueCount > serWriter->maxQueueCount)
+			{
+				serWriter->maxQueueCount	=	serWriter->queueCount;
+			}
+			pthread_cond_signal(&serWriter->queueCond);
+		}
+		pthread_mutex_unlock(&serWriter->queueMutex);
+	}
+}
+
+//*****************************************************************************
+//*	waits for the queue to drain, then writes the header and trailer
+//*	returns 0 on success, -1 on failure
+//*****************************************************************************
+int	SER_Close(TYPE_SER_WRITER *serWriter)
+{
+int		returnCode;
+int		fileDesc;
+ssize_t	bytesWritten;
+size_t	trailerSize;
+off_t	trailerOffset;
+int64_t	zeroStamps[256];
+
+	returnCode	=	-1;
+	if (serWriter->threadActive)
+	{
+		pthread_mutex_lock(&serWriter->queueMutex);
+		serWriter->keepRunning	=	false;
+		pthread_cond_signal(&serWriter->queueCond);
+		pthread_mutex_unlock(&serWriter->queueMutex);
+
+		pthread_join(serWriter->threadID, NULL);
+		serWriter->threadActive	=	false;
+		pthread_mutex_destroy(&serWriter->queueMutex);
+		pthread_cond_destroy(&serWriter->queueCond);
+
+		FlushBlockBuffer(serWriter, true);
+		if (serWriter->directIO)
+		{
+			//*	get rid of the alignment padding
+			if (ftruncate(serWriter->fileDesc, serWriter->fileBytesWritten) != 0)
+			{
+				serWriter->writeErrors++;
+			}
+		}
+		close(serWriter->fileDesc);
+		serWriter->fileDesc	=	-1;
+
+		//*	the header and trailer are small and unaligned, re-open with normal I/O
+		fileDesc	=	open(serWriter->filePath, O_WRONLY);
+		if (fileDesc >= 0)
+		{
+			serWriter->header.FrameCount	=	serWriter->framesWritten;
+			bytesWritten	=	pwrite(fileDesc, &serWriter->header, kSER_HeaderSize, 0);
+			if (bytesWritten != kSER_HeaderSize)
+			{
+				serWriter->writeErrors++;
+			}
+
+			trailerOffset	=	serWriter->fileBytesWritten;
+			trailerSize		=	serWriter->timeStampCnt * sizeof(int64_t);
+			if (trailerSize > 0)
+			{
+				bytesWritten	=	pwrite(fileDesc, serWriter->timeStampList, trailerSize, trailerOffset);
+				if (bytesWritten != (ssize_t)trailerSize)
+				{
+					serWriter->writeErrors++;
+				}
+				trailerOffset	+=	trailerSize;
+			}
+			if (serWriter->timeStampCnt < serWriter->framesWritten)
+			{
+				//*	the trailer has to have one entry per frame, 0 is no time stamp
+				CONSOLE_DEBUG_W_NUM("SER frames without a time stamp\t=", (serWriter->framesWritten - serWriter->timeStampCnt));
+				memset(zeroStamps, 0, sizeof(zeroStamps));
+				trailerSize	=	(serWriter->framesWritten - serWriter->timeStampCnt) * sizeof(int64_t);
+				while (trailerSize > 0)
+				{
+					bytesWritten	=	pwrite(fileDesc,
+											zeroStamps,
+											((trailerSize < sizeof(zeroStamps)) ? trailerSize : sizeof(zeroStamps)),
+											trailerOffset);
+					if (bytesWritten <= 0)
+					{
+						serWriter->writeErrors++;
+						break;
+					}
+					trailerSize		-=	bytesWritten;
+					trailerOffset	+=	bytesWritten;
+				}
+			}
+			close(fileDesc);
+			if (serWriter->writeErrors == 0)
+			{
+				returnCode	=	0;
+			}
+		}
+		CONSOLE_DEBUG_W_NUM("SER frames written\t=",	serWriter->framesWritten);
+		CONSOLE_DEBUG_W_NUM("SER frames dropped\t=",	serWriter->framesDropped);
+		CONSOLE_DEBUG_W_NUM("SER max queue depth\t=",	serWriter->maxQueueCount);
+	}
+	FreeWriterBuffers(serWriter);
+	return(returnCode);
+}
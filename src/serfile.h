@@ -0,0 +1,135 @@
+//**************************************************************************
+//*	Name:			serfile.h
+//*
+//*	Author:			Mark Sproul (C) 2021
+//*
+//*	Description:	SER video file writer with a dedicated disk writer thread
+//*
+//*	References:
+//*		http://www.grischa-hahn.homepage.t-online.de/astro/ser/SER%20Doc%20V3b.pdf
+//*****************************************************************************
+//*	Edit History
+//*****************************************************************************
+//*	<MLS>	=	Mark L Sproul
+//*****************************************************************************
+//*	Feb  2,	2021	<MLS> Created serfile.h
+//*	Mar 30,	2021	<MLS> The queue depth comes from a memory budget (queueDepth)
+//*	Mar 30,	2021	<MLS> Added timeStampCnt, time stamps are kept if the list can not grow
+//*****************************************************************************
+//#include	"serfile.h"
+
+#ifndef _SERFILE_H_
+#define	_SERFILE_H_
+
+#include	<stdint.h>
+#include	<stdbool.h>
+#include	<sys/time.h>
+
+#ifndef _PTHREAD_H
+	#include	<pthread.h>
+#endif // _PTHREAD_H
+
+//*****************************************************************************
+//*	SER color ID values
+enum
+{
+	kSER_COLOR_MONO			=	0,
+	kSER_COLOR_BAYER_RGGB	=	8,
+	kSER_COLOR_BAYER_GRBG	=	9,
+	kSER_COLOR_BAYER_GBRG	=	10,
+	kSER_COLOR_BAYER_BGGR	=	11,
+	kSER_COLOR_RGB			=	100,
+	kSER_COLOR_BGR			=	101
+};
+
+#define	kSER_HeaderSize			178
+#define	kSER_QueueMemory		(256 * 1024 * 1024)	//*	memory for the frames waiting for the disk
+#define	kSER_MinQueueDepth		4					//*	even if that is more than kSER_QueueMemory
+#define	kSER_MaxQueueDepth		64
+#define	kSER_WriteBlockSize		(4 * 1024 * 1024)	//*	size of each write() call
+#define	kSER_Alignment			4096				//*	buffer/size alignment, required for O_DIRECT
+
+//*****************************************************************************
+//*	the header is exactly 178 bytes, it must be packed
+typedef struct
+{
+	char		FileID[14];				//*	"LUCAM-RECORDER"
+	int32_t		LuID;
+	int32_t		ColorID;
+	int32_t		LittleEndian;
+	int32_t		ImageWidth;
+	int32_t		ImageHeight;
+	int32_t		PixelDepthPerPlane;
+	int32_t		FrameCount;
+	char		Observer[40];
+	char		Instrument[40];
+	char		Telescope[40];
+	int64_t		DateTime;				//*	local time, 100ns ticks since Jan 1, year 1
+	int64_t		DateTime_UTC;			//*	UTC time, 100ns ticks since Jan 1, year 1
+} __attribute__((packed)) TYPE_SER_HEADER;
+
+//*****************************************************************************
+typedef struct
+{
+	int				fileDesc;
+	bool			directIO;				//*	true if the file was opened with O_DIRECT
+	char			filePath[256];
+	TYPE_SER_HEADER	header;
+	uint32_t		frameSize;				//*	bytes per frame
+
+	//*	frame queue, filled by the capture loop, emptied by the writer thread
+	int				queueDepth;				//*	slots in use, kSER_QueueMemory / frameSize
+	unsigned char	*frameBuffer[kSER_MaxQueueDepth];
+	int64_t			frameTimeStamp[kSER_MaxQueueDepth];
+	int				queueHead;				//*	next slot to be filled
+	int				queueTail;				//*	next slot to be written
+	int				queueCount;
+	pthread_mutex_t	queueMutex;
+	pthread_cond_t	queueCond;
+	pthread_t		threadID;
+	bool			threadActive;
+	bool			keepRunning;
+
+	//*	staging buffer so that all writes are large and aligned
+	unsigned char	*blockBuffer;
+	uint32_t		blockBytes;
+	uint64_t		fileBytesWritten;
+
+	//*	per frame UTC time stamps, written as the trailer
+	int64_t			*timeStampList;
+	uint32_t		timeStampAlloc;
+	uint32_t		timeStampCnt;			//*	less than framesWritten if the list could not grow
+
+	//*	statistics
+	uint32_t		framesQueued;
+	uint32_t		framesWritten;
+	uint32_t		framesDropped;
+	uint32_t		writeErrors;
+	int				maxQueueCount;			//*	high water mark of the queue
+} TYPE_SER_WRITER;
+
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+int				SER_Open(		TYPE_SER_WRITER	*serWriter,
+								const char		*filePath,
+								const int		width,
+								const int		height,
+								const int		bitsPerPixel,
+								const int		colorID,
+								const char		*observer,
+								const char		*instrument,
+								const char		*telescope,
+								const bool		useDirectIO);
+unsigned char	*SER_GetFrameBuffer(TYPE_SER_WRITER *serWriter);
+void			SER_QueueFrame(		TYPE_SER_WRITER *serWriter, struct timeval *timeStamp);
+int				SER_Close(			TYPE_SER_WRITER *serWriter);
+int64_t			SER_ConvertTimeval(	struct timeval *timeStamp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	//	_SERFILE_H_
@@ -22,6 +22,7 @@
 //*	Mar 31,	2020	<MLS> Updated socket receive code to have a timeout and do multiple reads
 //*	Apr  7,	2020	<MLS> Added _FIX_ESCAPE_CHARS_ compile flag
 //*	Apr  7,	2020	<MLS> Added bytesRead to callback function
+//*	Mar  2,	2021	<MLS> Added SocketListen_DetachSocket() for streaming connections
 //*****************************************************************************
 
 #define	_USE_POLLING_
@@ -56,6 +57,7 @@ SocketData_Callback			gSocketCallbackProcPtr		=	NULL;
 //*****************************************************************************
 //*	globals so we can make this code non-blocking
 static	int		gSocketFD;		//*	socket File Descriptor
+static	int		gDetachedSocket	=	-1;	//*	the callback kept this socket, do not close it
 
 void SendDataToSocket(int sock);
 
@@ -112,6 +114,15 @@ void	SocketListen_SetCallback(SocketData_Callback callBackPtr)
 
 
 
+//*****************************************************************************
+//*	called from inside the callback when the socket is going to be kept open
+//*	(streaming), the caller is now responsible for shutting it down and closing it
+//*****************************************************************************
+void	SocketListen_DetachSocket(const int socket)
+{
+	gDetachedSocket	=	socket;
+}
+
 //*****************************************************************************
 int SocketListen_Poll(void)
 {
@@ -131,19 +142,27 @@ int					shutDownRetCode;
 //	if (newsockfd > 0)
 	if (newsockfd >= 0)
 	{
+		gDetachedSocket	=	-1;
 		SendDataToSocket(newsockfd);
 
-		shutDownRetCode	=	shutdown(newsockfd, SHUT_RDWR);
-		if (shutDownRetCode != 0)
+		if (newsockfd == gDetachedSocket)
 		{
-			CONSOLE_DEBUG_W_NUM("shutDownRetCode\t=", shutDownRetCode);
-			CONSOLE_DEBUG_W_NUM("errno\t=", errno);
+			gDetachedSocket	=	-1;
 		}
-		closeRetCode	=	close(newsockfd);
-		if (closeRetCode != 0)
+		else
 		{
-			CONSOLE_DEBUG_W_NUM("Error closing socket\t=",	closeRetCode);
-			CONSOLE_DEBUG_W_NUM("errno\t=", errno);
+			shutDownRetCode	=	shutdown(newsockfd, SHUT_RDWR);
+			if (shutDownRetCode != 0)
+			{
+				CONSOLE_DEBUG_W_NUM("shutDownRetCode\t=", shutDownRetCode);
+				CONSOLE_DEBUG_W_NUM("errno\t=", errno);
+			}
+			closeRetCode	=	close(newsockfd);
+			if (closeRetCode != 0)
+			{
+				CONSOLE_DEBUG_W_NUM("Error closing socket\t=",	closeRetCode);
+				CONSOLE_DEBUG_W_NUM("errno\t=", errno);
+			}
 		}
 	}
 	else if (newsockfd < 0)
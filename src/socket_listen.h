@@ -9,6 +9,7 @@
 //*	<MLS>	=	Mark L Sproul
 //*****************************************************************************
 //*	Feb 14,	2019	<MLS> Started on socket_listen.h
+//*	Mar  2,	2021	<MLS> Added SocketListen_DetachSocket()
 //*****************************************************************************
 
 
@@ -24,6 +25,7 @@ typedef	int (*SocketData_Callback)(int socket, char *htmlData, long bytesRead);
 int		SocketListen_Init(const int listenPortNum);
 int		SocketListen_Poll(void);
 void	SocketListen_SetCallback(SocketData_Callback callBackPtr);
+void	SocketListen_DetachSocket(const int socket);
 
 #ifdef __cplusplus
 }